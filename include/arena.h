@@ -0,0 +1,172 @@
+/***************************************************************************
+ * PHAST: PHylogenetic Analysis with Space/Time models
+ * Copyright (c) 2002-2005 University of California, 2006-2010 Cornell
+ * University.  All rights reserved.
+ *
+ * This source code is distributed under a BSD-style license.  See the
+ * file LICENSE.txt for details.
+ ***************************************************************************/
+
+/** @file arena.h
+   Bump-pointer ("arena" or "region") allocator for short-lived scratch
+   memory.
+
+   An arena hands out memory from a chain of large blocks by advancing
+   a pointer, so an allocation costs a few instructions and individual
+   allocations are never freed.  Instead, the state of the arena can be
+   saved with ar_mark and restored with ar_release, which discards
+   everything allocated since the mark in O(1) time.  Blocks are kept
+   for reuse, so a routine that is called many times with the same
+   dimensions (e.g., from within an optimizer) stops allocating from
+   the heap after the first call.
+
+   Routines that need temporary arrays for the duration of a call can
+   use the per-thread scratch arena:
+   @code
+   ArenaMark mark;
+   Arena *ar = ar_scratch_begin(&mark);
+   double **m = ar_alloc_dbl_matrix(ar, nrows, ncols);
+   ...
+   ar_scratch_end(ar, mark);
+   @endcode
+   Calls may be nested, since each call only releases what it allocated
+   itself.
+
+   All blocks are obtained with smalloc, so arenas are compatible with
+   the memory handler used by RPHAST.  Allocation counters are kept for
+   profiling (see ar_print_stats).
+   @ingroup base
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/** Default size in bytes of the first block of an arena */
+#define AR_DEFAULT_BLOCK_SIZE 65536
+
+/** Scratch arenas (see ar_scratch_begin) that grow beyond this many
+    bytes give back their extra blocks when no longer in use */
+#define AR_SCRATCH_RETAIN 16777216
+
+/** Alignment in bytes of every allocation */
+#define AR_ALIGN 16
+
+/** One block of memory in an arena (internal) */
+typedef struct arena_block {
+  struct arena_block *next;     /**< Next block in chain */
+  size_t size;                  /**< Usable size of block in bytes */
+  size_t base;                  /**< Total size of all preceding blocks */
+  char *data;                   /**< Start of usable memory */
+} ArenaBlock;
+
+/** Arena object */
+typedef struct {
+  ArenaBlock *first;            /**< First block in chain */
+  ArenaBlock *curr;             /**< Block currently being allocated from */
+  size_t offset;                /**< Bytes used in current block */
+  size_t block_size;            /**< Minimum size of new blocks */
+  /* counters, for profiling */
+  unsigned long nallocs;        /**< Number of allocations since creation */
+  size_t nbytes;                /**< Total bytes requested since creation */
+  int nblocks;                  /**< Number of blocks in chain */
+  size_t capacity;              /**< Total size of all blocks */
+  size_t high_water;            /**< Maximum number of bytes in use at
+                                   any one time */
+} Arena;
+
+/** Saved state of an arena (see ar_mark) */
+typedef struct {
+  ArenaBlock *block;
+  size_t offset;
+} ArenaMark;
+
+/** Create a new arena.
+    @param block_size Size in bytes of first block; if 0,
+    AR_DEFAULT_BLOCK_SIZE is used.  Later blocks are at least twice as
+    large as their predecessors.
+    @result Newly allocated arena
+ */
+Arena *ar_new(size_t block_size);
+
+/** Allocate memory from an arena.
+    @param ar Arena
+    @param size Number of bytes
+    @result Pointer to uninitialized memory aligned to AR_ALIGN bytes,
+    valid until the arena is released past this allocation, reset, or
+    freed
+ */
+void *ar_alloc(Arena *ar, size_t size);
+
+/** Allocate a matrix of doubles from an arena.  The rows are stored
+    contiguously.
+    @param ar Arena
+    @param nrows Number of rows
+    @param ncols Number of columns
+    @result Array of nrows pointers to rows of ncols uninitialized
+    doubles
+ */
+double **ar_alloc_dbl_matrix(Arena *ar, int nrows, size_t ncols);
+
+/** Allocate a matrix of ints from an arena.  The rows are stored
+    contiguously.
+    @param ar Arena
+    @param nrows Number of rows
+    @param ncols Number of columns
+    @result Array of nrows pointers to rows of ncols uninitialized ints
+ */
+int **ar_alloc_int_matrix(Arena *ar, int nrows, size_t ncols);
+
+/** Save the current state of an arena, so that later allocations can be
+    discarded with ar_release. */
+ArenaMark ar_mark(Arena *ar);
+
+/** Discard all allocations made since a mark was taken, in O(1) time.
+    Memory is retained by the arena for later use.
+    @param ar Arena
+    @param mark Value returned by ar_mark on the same arena
+ */
+void ar_release(Arena *ar, ArenaMark mark);
+
+/** Discard all allocations from an arena, in O(1) time.  Memory is
+    retained by the arena for later use. */
+void ar_reset(Arena *ar);
+
+/** Free all blocks of an arena that follow the block currently in use.
+    Useful after an unusually large allocation has been released. */
+void ar_trim(Arena *ar);
+
+/** Free an arena and all of its memory. */
+void ar_free(Arena *ar);
+
+/** Number of bytes currently in use in an arena (including padding) */
+size_t ar_in_use(Arena *ar);
+
+/** Print allocation counters of an arena.
+    @param F File to print to
+    @param name Label to print with counters
+    @param ar Arena
+ */
+void ar_print_stats(FILE *F, const char *name, Arena *ar);
+
+/** Begin use of the scratch arena of the calling thread.  The arena is
+    created on first use.
+    @param mark Set to the current state of the arena, to be passed to
+    ar_scratch_end
+    @result Scratch arena
+ */
+Arena *ar_scratch_begin(ArenaMark *mark);
+
+/** End use of the scratch arena, discarding all allocations made since
+    the corresponding call to ar_scratch_begin.  If the arena is no
+    longer in use and holds more than AR_SCRATCH_RETAIN bytes, the
+    extra memory is freed. */
+void ar_scratch_end(Arena *ar, ArenaMark mark);
+
+/** Get the scratch arena of the calling thread, or NULL if it has not
+    been used.  Intended for profiling. */
+Arena *ar_scratch_arena();
+
+#endif
@@ -73,7 +73,7 @@ struct bgchmm_struct {
 struct bgchmm_data_struct {
   MSA *msa;
   int *bgc_informative;
-  int nsite;
+  phast_pos nsite;
   int *msa_ixd;
   int estimate_cons_transitions;
   int estimate_bgc_target_coverage, estimate_bgc_expected_length;
@@ -93,9 +93,9 @@ TreeModel **bgchmm_setup_mods(TreeModel *init_mod, char *foregd_branch,
 			      int eqfreqs_from_msa, MSA *align, int *npar);
 
 void bgchmm_compute_emissions(double **emissions, void **models, int nmodels,
-			      void *data, int sample, int length);
+			      void *data, int sample, phast_pos length);
 
-int bgchmm_get_obs_idx(void *data, int i, int j);
+int bgchmm_get_obs_idx(void *data, int i, phast_pos j);
 
 void bgchmm_set_hmm(HMM *hmm, double bgc_in, double bgc_out, double cons_in, double cons_out);
 
@@ -111,7 +111,7 @@ void bgchmm_print_informative(MSA *msa, int *bgc_informative, ListOfLists *resul
 
 char *bgchmm_get_state_name(int state, int do_bgc);
 
-void bgchmm_output_path(int *path, int nsite, MSA *msa, int do_bgc,
+void bgchmm_output_path(int *path, phast_pos nsite, MSA *msa, int do_bgc,
          		char *name, char *outfn, ListOfLists *results);
 
 #endif
@@ -0,0 +1,136 @@
+/***************************************************************************
+ * PHAST: PHylogenetic Analysis with Space/Time models
+ * Copyright (c) 2002-2005 University of California, 2006-2010 Cornell
+ * University.  All rights reserved.
+ *
+ * This source code is distributed under a BSD-style license.  See the
+ * file LICENSE.txt for details.
+ ***************************************************************************/
+
+/** @file bigwig.h
+    Writing of base-by-base scores in bigWig format.  Obeys the file
+    specification of Kent et al., Bioinformatics 26:2204-2207 (2010),
+    which is also the format produced by the UCSC tool wigToBigWig.
+    Data are written as fixedStep sections of single-base spans,
+    together with zoom levels of summary statistics and R-tree indices
+    for both.  Sections are compressed with zlib if PHAST was compiled
+    with USE_ZLIB (see make-include.mk), and stored uncompressed
+    otherwise, which is also valid bigWig.
+    @ingroup feature
+*/
+
+#ifndef BIGWIG_H
+#define BIGWIG_H
+
+#include <misc.h>
+#include <hashtable.h>
+
+/** Maximum number of values per data section and of records per
+    zoom block */
+#define BW_ITEMS_PER_SLOT 1024
+
+/** Number of children per node of the R-tree indices */
+#define BW_BLOCK_SIZE 256
+
+/** Number of zoom levels computed */
+#define BW_NZOOM 10
+
+/** Bases per summary record in the first zoom level; each
+    following level is BW_ZOOM_FACTOR times coarser */
+#define BW_ZOOM_FIRST 40
+
+/** Ratio of successive zoom level reductions */
+#define BW_ZOOM_FACTOR 4
+
+/** Location and extent of a block of data, for the R-tree index */
+typedef struct {
+  uint32_t start_chrom,		/**< Chromosome id of first base */
+    start,			/**< First base (0-based) */
+    end_chrom,			/**< Chromosome id of last base */
+    end;			/**< One past last base */
+  uint64_t offset,		/**< File offset of block */
+    size;			/**< Size of block in file */
+} BigWigBlock;
+
+/** Summary of the values in an interval of a chromosome */
+typedef struct {
+  uint32_t chrom,		/**< Chromosome id */
+    start,			/**< First base (0-based) */
+    end,			/**< One past last base */
+    count;			/**< Number of bases with data */
+  double min, max, sum, sumsq;	/**< Statistics of values */
+} BigWigSummary;
+
+/** One zoom level under construction */
+typedef struct {
+  uint32_t reduction;		/**< Bases per summary record */
+  BigWigSummary cur;		/**< Record being accumulated (cur.count
+				   is zero if none) */
+  BigWigSummary *recs;		/**< Completed records not yet written */
+  int nrecs;			/**< Number of completed records */
+  uint32_t total;		/**< Total number of records */
+  BigWigBlock *blocks;		/**< Blocks written so far */
+  int nblocks, blocks_alloc;
+} BigWigZoom;
+
+/** bigWig file under construction */
+typedef struct {
+  FILE *F;			/**< Output file */
+  FILE *zoomF;			/**< Temporary file holding zoom blocks
+				   until bw_close */
+  char **chroms;		/**< Chromosome names, indexed by id */
+  uint32_t *sizes;		/**< One past last base seen, per
+				   chromosome (raised to the size given
+				   by bw_set_chrom_size, if larger, when
+				   the file is closed) */
+  Hashtable *chrom_sizes;	/**< Sizes given by bw_set_chrom_size
+				   (uint32_t*), by chromosome name */
+  int nchroms, chroms_alloc;
+  float *vals;			/**< Values of current data section */
+  int nvals;			/**< Number of values in current section */
+  uint32_t sec_start;		/**< First base of current section */
+  BigWigBlock *blocks;		/**< Data sections written so far */
+  int nblocks, blocks_alloc;
+  BigWigZoom zoom[BW_NZOOM];	/**< Zoom levels */
+  uint64_t bases;		/**< Total number of bases with data */
+  double min, max, sum, sumsq;	/**< Statistics of all values */
+  uint32_t max_block;		/**< Largest uncompressed block, in bytes */
+  unsigned char *buf;		/**< Buffer for serializing blocks */
+  unsigned char *zbuf;		/**< Buffer for compressed blocks */
+  unsigned long zbuf_size;	/**< Size of zbuf */
+} BigWig;
+
+/** Open a bigWig file for writing.
+    @param fname Name of file to create; must be a regular (seekable)
+    file
+    @return Newly allocated BigWig object
+*/
+BigWig *bw_new(const char *fname);
+
+/** Add the value of a single base.  Calls must be grouped by
+    chromosome and, within a chromosome, sorted by position.
+    @param bw BigWig object
+    @param chrom Name of chromosome
+    @param pos Position of base (1-based, as in wig files)
+    @param val Value of base
+*/
+void bw_add(BigWig *bw, const char *chrom, phast_pos pos, double val);
+
+/** Set the size of a chromosome, as written to the chromosome index
+    of the file.  By default the size of a chromosome is one past the
+    last base with data, which is too small if the sequence ends with
+    bases without scores.  Sizes smaller than that are ignored.  May
+    be called before or after the values of the chromosome are added.
+    @param bw BigWig object
+    @param chrom Name of chromosome
+    @param size Length of chromosome
+*/
+void bw_set_chrom_size(BigWig *bw, const char *chrom, phast_pos size);
+
+/** Write the remaining data, zoom levels, and indices, close the
+    file, and free the BigWig object.
+    @param bw BigWig object
+*/
+void bw_close(BigWig *bw);
+
+#endif
@@ -90,6 +90,7 @@
 #define CAT_MAP_H
 
 #include "gff.h"
+#include "gff_compact.h"
 #include "lists.h"
 #include "stringsplus.h"
 
@@ -188,6 +189,13 @@ CategoryMap* cm_create_trivial(int ncats, char *feature_prefix);
 */
 CategoryMap* cm_new_from_features(GFF_Set *feats);
 
+/** Create a Category Map with a category for each feature type in a
+    GFF_CompactSet, as cm_new_from_features does for a GFF_Set.
+    @param feats Compact feature set to base new categories on
+    @result newly created Category Map with populated categories
+*/
+CategoryMap* cm_new_from_compact_features(GFF_CompactSet *feats);
+
 /** Copy an existing Category Map.
   @param Category Map to copy
   @result Copied category map */
@@ -331,7 +339,7 @@ UnspoolNode *cm_new_unspool_node(int oldstate);
    @param[in] pathlen Number of category numbers in path
    @warning Original sequence (in path) is overwritten
 */
-void cm_spooled_to_unspooled(CategoryMap *cm, int *path, int pathlen);
+void cm_spooled_to_unspooled(CategoryMap *cm, int *path, phast_pos pathlen);
 
 /** Maps category numbers from the unspooled space to spooled space.
    @pre cm->unspooler must exist
@@ -340,7 +348,7 @@ void cm_spooled_to_unspooled(CategoryMap *cm, int *path, int pathlen);
    @param[in] pathlen Number of category numbers in path
    @warning Original sequence (in path) is overwritten
 */
-void cm_unspooled_to_spooled(CategoryMap *cm, int *path, int pathlen);
+void cm_unspooled_to_spooled(CategoryMap *cm, int *path, phast_pos pathlen);
 
 /** Translate unspooled category number to spooled category number
    @param cm Category map
@@ -395,7 +403,7 @@ void cm_free_unspooler(Unspooler *unsp);
    @param idpref (Optional) Prefix for ids of predicted elements. Can be used to ensure ids are unique
    @result Newly created Feature Set
     */
-GFF_Set *cm_labeling_as_gff(CategoryMap *cm, int *path, int length, int *path_to_cat, int *reverse_compl, char *seqname, char *source, List *frame_cats, char *grouptag,char *idpref);
+GFF_Set *cm_labeling_as_gff(CategoryMap *cm, int *path, phast_pos length, int *path_to_cat, int *reverse_compl, char *seqname, char *source, List *frame_cats, char *grouptag,char *idpref);
 
 /** \} \name Category Range Allocation functions 
  \{ */
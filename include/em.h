@@ -21,6 +21,26 @@
 //#define EM_CONVERGENCE_THRESHOLD 0.01
 #define EM_CONVERGENCE_THRESHOLD 0.1 /* TEMPORARY! */
 
+/** Callbacks that allow hmm_train_by_em_threaded to accelerate EM by
+    SQUAREM extrapolation (see opt_squarem_update).  Parameters must
+    be representable as a vector in which an EM update behaves
+    smoothly. */
+typedef struct {
+  /** Copy current parameters into params and their bounds into
+      lower_bounds and upper_bounds, resizing them with vec_realloc as
+      needed.  Called only after M steps. */
+  void (*get_params)(Vector *params, Vector *lower_bounds, 
+                     Vector *upper_bounds, HMM *hmm, void *models, 
+                     void *data);
+  /** Set parameters, updating anything that depends on them */
+  void (*set_params)(Vector *params, HMM *hmm, void *models, void *data);
+  int niterations;              /**< Number of E steps (on return) */
+  int nextrap;                  /**< Number of extrapolations (on return) */
+  int nrejected;                /**< Number of extrapolations rejected
+                                   for decreasing the likelihood (on
+                                   return) */
+} EmAccel;
+
 /** Train a Hidden Markov Model by using EM algorithm.
     @param hmm Hidden Markov Model to train
     @param models ???
@@ -42,14 +62,75 @@
     @warning This function is experimental
 */
 double hmm_train_by_em(HMM *hmm, void *models, void *data, int nsamples, 
-                       int *sample_lens, Matrix *pseudocounts, 
+                       phast_pos *sample_lens, Matrix *pseudocounts, 
                        void (*compute_emissions)(double**, void**, int, void*, 
-                                                 int, int), 
+                                                 int, phast_pos), 
                        void (*estimate_state_models)(TreeModel**, int, void*, 
                                                      double**, int, FILE*),
                        void (*estimate_transitions)(HMM*, void*, double**),
-                       int (*get_observation_index)(void*, int, int),
+                       int (*get_observation_index)(void*, int, phast_pos),
                        void (*log_function)(FILE*, double, HMM*, void*, int),
                        double **emissions_alloc, FILE *logf);
 
+/** Train a Hidden Markov Model by EM, computing the E step in
+    parallel.  Training samples are divided into contiguous blocks,
+    one per thread, and expected counts are summed over blocks in a
+    fixed order.  Parameters are as for hmm_train_by_em, plus:
+    @param nthreads Number of threads (<= 0 means one per processor).
+    With nthreads == 1 results are identical to hmm_train_by_em.
+    @param accel (Optional) If non-NULL, accelerate EM by SQUAREM
+    extrapolation, using the callbacks provided.  Iteration counts are
+    returned in accel.
+    @result Log likelihood of optimized model
+    @note compute_emissions and the models it uses must be safe to
+    call concurrently on different samples.  Emissions for the first
+    sample are computed before any threads are started, so models may
+    initialize internal state on first use.
+    @note Only samples are divided among threads, so with a single
+    sample this is equivalent to hmm_train_by_em.
+*/
+double hmm_train_by_em_threaded(HMM *hmm, void *models, void *data, 
+                                int nsamples, phast_pos *sample_lens, 
+                                Matrix *pseudocounts, 
+                                void (*compute_emissions)(double**, void**, 
+                                                          int, void*, 
+                                                          int, phast_pos), 
+                                void (*estimate_state_models)(TreeModel**, 
+                                                              int, void*, 
+                                                              double**, int,
+                                                              FILE*),
+                                void (*estimate_transitions)(HMM*, void*, 
+                                                             double**),
+                                int (*get_observation_index)(void*, int, 
+                                                             phast_pos),
+                                void (*log_function)(FILE*, double, HMM*, 
+                                                     void*, int),
+                                double **emissions_alloc, FILE *logf,
+                                int nthreads, EmAccel *accel);
+
+/** Compute expected sufficient statistics for EM under the current
+    parameters (a single E step), without updating anything.  Because
+    counts for disjoint portions of the data can simply be summed, this
+    allows the E step to be distributed across processes, with the M
+    step performed on the summed counts.  Parameters are as for
+    hmm_train_by_em_threaded, plus:
+    @param[out] A Expected number of transitions between each pair of
+    states (nstates x nstates, preallocated)
+    @param[out] E (Optional) Expected number of times each state emits
+    each distinct observation (nstates x nobs, where nobs =
+    get_observation_index(data, -1, -1), preallocated).  If NULL, not
+    computed, and get_observation_index may be NULL.
+    @result Log likelihood (base 2) of the data under the current
+    parameters
+*/
+double hmm_em_expected_counts(HMM *hmm, void *models, void *data, 
+                              int nsamples, phast_pos *sample_lens, 
+                              void (*compute_emissions)(double**, void**, 
+                                                        int, void*, 
+                                                        int, phast_pos), 
+                              int (*get_observation_index)(void*, int, 
+                                                           phast_pos),
+                              double **emissions_alloc, int nthreads,
+                              double **A, double **E);
+
 #endif
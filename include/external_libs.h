@@ -26,6 +26,15 @@
 #define PHAST_INLINE inline
 #endif
 
+/* POSIX threads (see thread_pool.h).  Not used in RPHAST or with the
+   memory handler, neither of which is thread safe */
+#if defined(USE_PTHREADS) && !defined(RPHAST) && !defined(USE_PHAST_MEMORY_HANDLER)
+#define PHAST_THREADS
+#define PHAST_THREAD_LOCAL __thread
+#else
+#define PHAST_THREAD_LOCAL
+#endif
+
 #ifdef R_LAPACK
 #include <R_ext/Lapack.h>
 #define LAPACK_INT int
@@ -139,7 +139,7 @@ double col_likelihood_wrapper_1d(double x, void *data);
   @param tupleidx Which column to compute log likelihood for
   @param scratch Pre-allocated memory used as scratch space when computing likelihood
   @result Estimated log likelihood
-  @note This function is simply a wrapper for col_compute_likelihood and computes log() on the result
+  @note This function is a wrapper for col_compute_scaled_likelihood and does not underflow
   @note Uses log rather than log2
 */
 
@@ -160,10 +160,32 @@ double col_compute_log_likelihood(TreeModel *mod, MSA *msa, int tupleidx,
   @param tupleidx Which column to compute likelihood for
   @param scratch Pre-allocated memory used as scratch space when computing likelihood
   @result Estimated Log likelihood
+  @note The result underflows to zero when the likelihood is very
+  small (e.g., on large trees); use col_compute_log_likelihood or
+  col_compute_scaled_likelihood in that case
 */
 double col_compute_likelihood(TreeModel *mod, MSA *msa, int tupleidx,
 		              double **scratch);
 
+/** Compute the likelihood of a tree model with respect to a single
+   column tuple in an alignment, in scaled form.
+
+   Partial likelihoods are rescaled by powers of two whenever they
+   become small during the pruning algorithm, so the result cannot
+   underflow.  Rescaling is exact, so results agree with the unscaled
+   computation whenever the latter does not underflow.  The same
+   scheme is used by col_scale_derivs and col_scale_derivs_subtree.
+   Assumptions are as for col_compute_likelihood.
+  @param mod Substitution model, rates and its metadata
+  @param msa Sequence data and its metadata
+  @param tupleidx Which column to compute likelihood for
+  @param scratch Pre-allocated memory used as scratch space when computing likelihood
+  @param[out] lscale Scale exponent
+  @result Scaled likelihood; the likelihood is result * 2^(-lscale)
+*/
+double col_compute_scaled_likelihood(TreeModel *mod, MSA *msa, int tupleidx,
+                                     double **scratch, int *lscale);
+
 /** \name Column Fit Data likelihood ratio test functions
  \{ */
 
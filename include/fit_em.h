@@ -28,12 +28,18 @@
    @param params Parameters to fit
    @param cat Site category in MSA
    @param precision Precision with which to fit to model
+   @param max_its Maximum number of EM iterations, or -1 for no limit
+   @param accelerate Whether to accelerate EM by SQUAREM extrapolation
+   (see opt_squarem_update).  Extrapolation usually reduces the number
+   of iterations but can change the estimates slightly; pass FALSE to
+   obtain plain EM.  Ignored when the weights of empirical rate
+   categories are estimated, which always uses plain EM.
    @param logf output file to write to
    @param error_file If non-NULL, write estimate, variance, and 95% 
    confidence interval for each parameter to this file.
 */
 int tm_fit_em(TreeModel *mod, MSA *msa, Vector *params, int cat, 
-              opt_precision_type precision, int max_its, FILE *logf,
-	      FILE *error_file);
+              opt_precision_type precision, int max_its, int accelerate,
+              FILE *logf, FILE *error_file);
 
 #endif
@@ -21,10 +21,22 @@
 
 #include <fit_column.h>
 
-/** metadata for fitting scale factors to individual alignment columns. */
+/** metadata for fitting scale factors to individual features.  The
+    columns of the current feature are summarized as a histogram of
+    distinct tuples, so that likelihoods and derivatives are computed
+    once per distinct tuple and weighted by its count.  The feature
+    must be set with ff_set_feature, which builds the histogram. */
 typedef struct {
   GFF_Feature *feat; /**< Feature */
   ColFitData *cdata; /**< Column Fit */
+  int ntuples;       /**< Number of distinct tuples in feature */
+  int *tuples;       /**< Indices of distinct tuples, in order of
+                        first appearance */
+  int *counts;       /**< Number of columns of feature having each
+                        tuple */
+  int hist_alloc;    /**< Allocated size of tuples and counts */
+  int *tuple_pos;    /**< Position of each tuple of the alignment in
+                        tuples, or -1 (scratch memory) */
 } FeatFitData;
 
 /** \name Feature Fit Data allocation function
@@ -40,6 +52,13 @@ typedef struct {
 FeatFitData *ff_init_fit_data(TreeModel *mod,  MSA *msa, scale_type stype, 
                               mode_type mode, int second_derivs);
 
+/** Set the current feature and build its histogram of distinct
+    tuples.  Takes time proportional to the length of the feature.
+  @param d Feature Fit Data
+  @param feat Feature to be analyzed
+*/
+void ff_set_feature(FeatFitData *d, GFF_Feature *feat);
+
 /** \name Feature Fit Data cleanup function
  \{ */
 
@@ -79,12 +98,15 @@ double ff_compute_log_likelihood(TreeModel *mod, MSA *msa, GFF_Feature *feat,
   @param[out] feat_scales (Optional) Computed scale factors for each feature
   @param[out] feat_llrs (Optional) raw likelihood ratios
   @param logf Location to save output
+  @param nthreads Number of threads among which to divide the
+    features (<= 0 means one per processor).  Ignored if logf is
+    non-NULL.  Results do not depend on the number of threads.
   @note Assumes a 0th order model, leaf-to-sequence mapping 
     already available, probability matrices computed, sufficient statistics available.
 */
 void ff_lrts(TreeModel *mod, MSA *msa, GFF_Set *feats, mode_type mode, 
              double *feat_pvals, double *feat_scales, double *feat_llrs, 
-             FILE *logf);
+             FILE *logf, int nthreads);
 
 /**  Perform a likelihood ratio test for multiple features on a subtree.  
   Compares the given null model with an alternative model
@@ -99,6 +121,7 @@ void ff_lrts(TreeModel *mod, MSA *msa, GFF_Set *feats, mode_type mode,
   @param[out] feat_sub_scales (Optional) Scales for sub optimal alternative hypothesis
   @param[out] feat_llrs (Optional) raw likelihood ratios
   @param logf Location to save output
+  @param nthreads Number of threads (see ff_lrts)
   @note Assumes a 0th order model, leaf-to-sequence mapping 
     already available, probability matrices computed, sufficient statistics available.
 
@@ -106,7 +129,7 @@ void ff_lrts(TreeModel *mod, MSA *msa, GFF_Set *feats, mode_type mode,
 void ff_lrts_sub(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode, 
                  double *feat_pvals, double *feat_null_scales, 
                  double *feat_scales, double *feat_sub_scales, 
-                 double *feat_llrs, FILE *logf);
+                 double *feat_llrs, FILE *logf, int nthreads);
 
 /** \name Feature Fit Data derivative calculation functions 
  \{ */
@@ -159,11 +182,12 @@ void ff_grad_wrapper(Vector *grad, Vector *params, void *data,
   @param[out] feat_pvals (Optional) Computed p-values 
   @param[out] feat_derivs (Optional) Computed first derivatives by feature
   @param[out] feat_teststats (Optional) Statistics for each test (first_derivative^2/fim)
+  @param nthreads Number of threads (see ff_lrts)
   @see col_score_tests_sub
 */
 void ff_score_tests(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode, 
                     double *feat_pvals, double *feat_derivs, 
-                    double *feat_teststats);
+                    double *feat_teststats, int nthreads);
 
 /** Calculate scores of subtree using feature fit data.
   @param mod[in Tree model to perform likelihood test on
@@ -174,11 +198,12 @@ void ff_score_tests(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode,
   @param[out] feat_derivs (Optional) first derivatives by tuple column
   @param[out] feat_sub_derivs (Optional) derivatives for sub optimal
   @param[out] feat_teststats (Optional) statistics or each test (first_derivative^2/fit)
+  @param nthreads Number of threads (see ff_lrts)
 */
 void ff_score_tests_sub(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode,
                         double *feat_pvals, double *feat_null_scales, 
                         double *feat_derivs, double *feat_sub_derivs, 
-                        double *feat_teststats, FILE *logf);
+                        double *feat_teststats, FILE *logf, int nthreads);
 
 
 /** Perform a GERP-like computation to compute conservation scores for each feature.
@@ -189,11 +214,12 @@ void ff_score_tests_sub(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode,
    @param[out] feat_nobs (Optional) expected number of substitutions after re-scaling
    @param[out] feat_nrejected (Optional) expected number of rejected substitutions
    @param[out] feat_nspec (Optional) number of species with data
+   @param nthreads Number of threads (see ff_lrts)
    @note Gaps and missing data are handled by working with the induced subtree.
  */
 void ff_gerp(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode, 
              double *feat_nneut, double *feat_nobs, double *feat_nrejected, 
-             double *feat_nspec, FILE *logf);
+             double *feat_nspec, FILE *logf, int nthreads);
 
 /** \name Feature Fit Data check sufficient data to perform analysis functions
  \{ */
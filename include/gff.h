@@ -18,6 +18,7 @@
 #ifndef GFF_H
 #define GFF_H
 
+#include <misc.h>
 #include <stringsplus.h>
 
 #include <stdio.h>
@@ -34,7 +35,7 @@ typedef struct {
                                    semi-standardized.  One suggestion
                                    is to use the EMBL/DDBJ/GenBank
                                    feature table as a standard */
-  int start,					/**< Start position.  Convention
+  phast_pos start,				/**< Start position.  Convention
 									is to start numbering with 1 */
   end;              		 	/**< End positions.
                                    Convention is make the range
@@ -87,7 +88,7 @@ typedef struct {
 typedef struct {
   String *name;
   List *features;
-  int start, end;
+  phast_pos start, end;
 } GFF_FeatureGroup;
 
 /** total number of columns */
@@ -138,8 +139,9 @@ typedef struct {
     @result Returns newly allocated GFF_Feature object.
 */
 GFF_Feature *gff_new_feature(String *seqname, String *source, String *feature,
-                             int start, int end, double score, char strand,
-                             int frame, String *attribute, int score_is_null);
+                             phast_pos start, phast_pos end, double score, 
+                             char strand, int frame, String *attribute, 
+                             int score_is_null);
 
 
 /** Create an exact copy of a GFF_Feature object.
@@ -166,7 +168,7 @@ GFF_Feature *gff_new_feature_copy(GFF_Feature *orig);
  */
 GFF_Feature *gff_new_feature_copy_chars(const char *seqname, const char *source,
 					const char *feature,
-					int start, int end, double score,
+					phast_pos start, phast_pos end, double score,
 					char strand, int frame,
 					const char *attribute,
 					int score_is_null);
@@ -405,7 +407,7 @@ int gff_group_comparator(const void* ptr1, const void* ptr2);
     @param reset_indices Used to set indices of features in result relative to startcol
     @result new GFF_Set with features within startcol to endcol
  */
-GFF_Set *gff_subset_range(GFF_Set *set, int startcol, int endcol,
+GFF_Set *gff_subset_range(GFF_Set *set, phast_pos startcol, phast_pos endcol,
                           int reset_indices);
 
 /** Create a new GFF_Set representing the features partially or fully in a
@@ -416,7 +418,8 @@ GFF_Set *gff_subset_range(GFF_Set *set, int startcol, int endcol,
     @param endcol All subset features must have one or more sites at or before this colum number
     @result new GFF_Set with features partially or fully within startcol to endcol
  */
-GFF_Set *gff_subset_range_overlap(GFF_Set *set, int startcol, int endcol);
+GFF_Set *gff_subset_range_overlap(GFF_Set *set, phast_pos startcol, 
+                                  phast_pos endcol);
 
 /** Create a new GFF_Set representing the features partially or fully in a
     particular coordinate range, starting at a specific index in GFF.
@@ -430,7 +433,8 @@ GFF_Set *gff_subset_range_overlap(GFF_Set *set, int startcol, int endcol);
     @note For features to be included, they must not overlap startSearchIdx
     @note startSearchIdx set to first match if any found
 */
-GFF_Set *gff_subset_range_overlap_sorted(GFF_Set *set, int startcol, int endcol,
+GFF_Set *gff_subset_range_overlap_sorted(GFF_Set *set, phast_pos startcol, 
+                                         phast_pos endcol,
 					 int *startSearchIdx);
 
 
@@ -493,7 +497,8 @@ int gff_reverse_strand_only(List *features);
    @param start_range First coordinate of internal (inclusive, 1-based indexing, as in features)
    @param end_range Last coordinate of interval (inclusive, 1-based indexing, as in features)
 */
-void gff_reverse_compl(List *features, int start_range, int end_range);
+void gff_reverse_compl(List *features, phast_pos start_range, 
+                       phast_pos end_range);
 
 /** Sort features primarily by start position, and secondarily by end
     position (ascending order).
@@ -542,7 +547,7 @@ void gff_partition_by_type(GFF_Set *feats, List *types, List *subsets);
    may be truncated to be in the range [1,maxCoord] (or
    [1, infinity) if maxCoord < 0
 */
-void gff_add_offset(GFF_Set *gff, int offset, int maxCoord);
+void gff_add_offset(GFF_Set *gff, phast_pos offset, phast_pos maxCoord);
 
 /**
   Create a new GFF by overlaps two existing GFFs and specifying the amount of overlap desired.
@@ -596,7 +601,8 @@ GFF_Set *gff_split(GFF_Set *gff, int *maxlen, int nmaxlen,
   @param featureName The name to give each feature
   @result A GFF_Set with features representing all regions with scores >= threshold.
 */
-GFF_Set *gff_from_wig_threshold(char *seqname, int firstIdx, double *scores,
+GFF_Set *gff_from_wig_threshold(char *seqname, phast_pos firstIdx, 
+                                double *scores,
 				int numscore, double threshold, char *src,
 				char *featureName);
 
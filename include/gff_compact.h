@@ -0,0 +1,275 @@
+/***************************************************************************
+ * PHAST: PHylogenetic Analysis with Space/Time models
+ * Copyright (c) 2002-2005 University of California, 2006-2010 Cornell
+ * University.  All rights reserved.
+ *
+ * This source code is distributed under a BSD-style license.  See the
+ * file LICENSE.txt for details.
+ ***************************************************************************/
+
+/** @file gff_compact.h
+    Compact, column-oriented storage of large sets of features.
+
+    A GFF_CompactSet holds the same information as a GFF_Set, but
+    rather than allocating a GFF_Feature object and several String
+    objects per feature, it stores each field in a packed array, with
+    sequence names, sources, and feature types interned in a single
+    string table and attributes packed in a single character buffer.
+    This is intended for very large feature sets (e.g., millions of
+    conserved elements or features to be scored).  An interval index
+    (an implicit augmented interval tree over features sorted by
+    sequence name and start) allows fast overlap queries.
+
+    Adapters are provided to convert to and from GFF_Set objects; see
+    also msa_label_categories_compact (msa.h) and
+    sub_p_value_many_ranges (subst_distrib.h).
+    @ingroup feature
+*/
+
+#ifndef GFF_COMPACT_H
+#define GFF_COMPACT_H
+
+#include <stdio.h>
+#include <gff.h>
+#include <hashtable.h>
+#include <lists.h>
+#include <stringsplus.h>
+
+/** Compact, column-oriented set of features.  Field i of each array
+    describes feature i; see GFF_Feature for the meaning of each
+    field. */
+typedef struct {
+  int nfeatures;                /**< number of features */
+  int alloc;                    /**< allocated size of per-feature
+                                   arrays */
+  List *names;                  /**< interned strings (char*) for
+                                   seqnames, sources, and feature
+                                   types */
+  Hashtable *name_idx;          /**< index of each string in names */
+  int *seqname;                 /**< index in names of sequence name */
+  int *source;                  /**< index in names of source */
+  int *feature;                 /**< index in names of feature type */
+  phast_pos *start;             /**< start position (1-based) */
+  phast_pos *end;               /**< end position (inclusive) */
+  double *score;                /**< score (meaningless if
+                                   score_is_null) */
+  char *score_is_null;          /**< whether score is null */
+  char *strand;                 /**< one of '+', '-', and '.' */
+  signed char *frame;           /**< frame, in internal representation
+                                   (see GFF_Feature) or GFF_NULL_FRAME */
+  long *attr_offset;            /**< offset of attribute in attr_buf */
+  char *attr_buf;               /**< null-terminated attributes, packed
+                                   end to end */
+  long attr_len,                /**< number of chars used in attr_buf */
+    attr_alloc;                 /**< allocated size of attr_buf */
+  int indexed;                  /**< whether interval index is current */
+  phast_pos *max_end;           /**< interval index: max end in subtree
+                                   rooted at each feature (NULL if not
+                                   indexed) */
+  int nseqs;                    /**< number of names covered by index */
+  int *seq_first;               /**< index of first feature for each
+                                   seqname, by name index */
+  int *seq_nfeatures;           /**< number of features for each
+                                   seqname, by name index (0 if name is
+                                   not a seqname) */
+  int *seq_max_level;           /**< height of implicit interval tree
+                                   for each seqname */
+  String *gff_version;          /**< version of GFF in use */
+  String *source_name;          /**< program used to generate file */
+  String *source_version;       /**< version of program used to
+                                   generate file */
+  String *date;                 /**< date of generation */
+} GFF_CompactSet;
+
+/** Get an interned string by index
+  @param set Compact feature set
+  @param idx Index of string (e.g., set->seqname[i])
+  @result String, owned by set
+*/
+static PHAST_INLINE
+char *gffc_name(GFF_CompactSet *set, int idx) {
+  return (char*)lst_get_ptr(set->names, idx);
+}
+
+/** Get attribute of a feature
+  @param set Compact feature set
+  @param i Index of feature
+  @result Attribute string, owned by set
+*/
+static PHAST_INLINE
+char *gffc_attribute(GFF_CompactSet *set, int i) {
+  return &set->attr_buf[set->attr_offset[i]];
+}
+
+/** \name Compact feature set allocation functions
+ \{ */
+
+/** Create a new, empty compact feature set
+  @param est_size Estimated number of features
+  @result New compact feature set
+*/
+GFF_CompactSet *gffc_new_set(int est_size);
+
+/** Free a compact feature set
+  @param set Compact feature set to free
+*/
+void gffc_free_set(GFF_CompactSet *set);
+
+/** Get the index of a string in the string table of a compact
+    feature set, adding it if necessary
+  @param set Compact feature set
+  @param str String to intern (copied)
+  @result Index of string
+*/
+int gffc_intern(GFF_CompactSet *set, const char *str);
+
+/** Add a feature to a compact feature set.  All strings are copied.
+    Invalidates the interval index.
+  @param set Compact feature set
+  @param seqname Sequence name
+  @param source Source of feature
+  @param feature Feature type
+  @param start Start position (1-based)
+  @param end End position (inclusive)
+  @param score Score
+  @param strand One of '+', '-', and '.'
+  @param frame Frame in internal representation, or GFF_NULL_FRAME
+  @param attribute Attribute string
+  @param score_is_null Whether score is null
+  @result Index of new feature
+*/
+int gffc_add_feature(GFF_CompactSet *set, const char *seqname,
+                     const char *source, const char *feature, 
+                     phast_pos start, phast_pos end, double score, char strand, int frame,
+                     const char *attribute, int score_is_null);
+
+/** Copy a feature from one compact feature set to another
+  @param dest Compact feature set to add feature to
+  @param src Compact feature set containing feature
+  @param i Index of feature in src
+  @result Index of new feature in dest
+*/
+int gffc_add_copy(GFF_CompactSet *dest, GFF_CompactSet *src, int i);
+
+/** Remove features from a compact feature set, preserving the order
+    of the others.  Space used by attributes of removed features is
+    not reclaimed.  Invalidates the interval index.
+  @param set Compact feature set
+  @param keep Array of length set->nfeatures; feature i is retained
+  iff keep[i] is nonzero
+*/
+void gffc_filter(GFF_CompactSet *set, char *keep);
+
+/** Add an offset to the coordinates of all features of a compact
+    feature set.  Same as gff_add_offset.
+  @param set Compact feature set
+  @param offset Offset to add to start and end of each feature
+  @param maxCoord If positive, features starting after maxCoord are
+  removed and ends are truncated at maxCoord.  Features ending
+  before 1 are removed, and starts are truncated at 1.
+*/
+void gffc_add_offset(GFF_CompactSet *set, phast_pos offset, 
+                     phast_pos maxCoord);
+
+/** \} \name Compact feature set conversion functions
+ \{ */
+
+/** Create a compact feature set from a GFF_Set
+  @param gff Feature set to convert (unchanged)
+  @result New compact feature set
+*/
+GFF_CompactSet *gffc_new_from_gff_set(GFF_Set *gff);
+
+/** Create a GFF_Set from a compact feature set
+  @param set Compact feature set to convert (unchanged)
+  @result New feature set
+*/
+GFF_Set *gffc_to_gff_set(GFF_CompactSet *set);
+
+/** Create a GFF_Feature object for a feature of a compact feature set
+  @param set Compact feature set
+  @param i Index of feature
+  @result Newly allocated GFF_Feature
+*/
+GFF_Feature *gffc_get_feature(GFF_CompactSet *set, int i);
+
+/** \} \name Compact feature set read/print functions
+ \{ */
+
+/** Read a compact feature set from a file.  GFF files are parsed
+    directly, without creating intermediate objects for each line;
+    other formats accepted by gff_read_set (BED, genepred, wig) are
+    read with gff_read_set and converted.
+  @param F File to read from
+  @result New compact feature set
+*/
+GFF_CompactSet *gffc_read_set(FILE *F);
+
+/** Print a compact feature set in GFF.  Output is identical to that
+    of gff_print_set on the equivalent GFF_Set.
+  @param F File to print to
+  @param set Compact feature set to print
+*/
+void gffc_print_set(FILE *F, GFF_CompactSet *set);
+
+/** Print a single feature of a compact feature set as a GFF line
+  @param F File to print to
+  @param set Compact feature set
+  @param i Index of feature
+*/
+void gffc_print_feat(FILE *F, GFF_CompactSet *set, int i);
+
+/** \} \name Compact feature set interval functions
+ \{ */
+
+/** Sort the features of a compact feature set by sequence name (in
+    order of first appearance), start, and end, and build an interval
+    index for use by gffc_overlaps.  Does nothing if the index is
+    already current.
+  @param set Compact feature set
+  @note Reorders features
+*/
+void gffc_index(GFF_CompactSet *set);
+
+/** Find all features of a compact feature set that overlap a given
+    interval.  Requires O(log n + k) time, where k is the number of
+    overlapping features.
+  @param set Compact feature set; will be indexed if necessary (see
+  gffc_index)
+  @param seqname Sequence name of interval
+  @param start Start of interval (1-based)
+  @param end End of interval (inclusive)
+  @param result List of ints to which indices of overlapping features
+  will be added, in increasing order (i.e., by start position)
+  @result Number of overlapping features
+*/
+int gffc_overlaps(GFF_CompactSet *set, const char *seqname, 
+                  phast_pos start, phast_pos end, List *result);
+
+/** Filter a compact feature set by overlap with another, using the
+    interval index.  Same as gff_overlap_gff, except that features are
+    returned in sorted order (see gffc_index).
+  @param gff Features to filter; will be indexed if necessary
+  @param filter_gff Features to compare against; will be indexed if
+  necessary
+  @param numbaseOverlap Minimum number of bases of overlap, or -1 to
+  ignore
+  @param percentOverlap Minimum fraction of overlap, or -1 to ignore
+  @param nonOverlapping If TRUE, return features that do not satisfy
+  the overlap criteria instead
+  @param overlappingFragments If TRUE, return the fragments of
+  features that overlap each feature in filter_gff
+  @param overlapping_frags If non-NULL and overlappingFragments, will
+  be cleared and filled with the filter_gff feature corresponding to
+  each returned fragment
+  @result New compact feature set
+*/
+GFF_CompactSet *gffc_overlap_gff(GFF_CompactSet *gff,
+                                 GFF_CompactSet *filter_gff,
+                                 int numbaseOverlap, double percentOverlap,
+                                 int nonOverlapping, int overlappingFragments,
+                                 GFF_CompactSet *overlapping_frags);
+
+/** \} */
+
+#endif
@@ -36,6 +36,10 @@
 #define BEGIN_STATE -99
 /** Used to identify finished state */
 #define END_STATE -98
+/** Largest amount of memory, in bytes, used for Viterbi back pointers
+    before hmm_viterbi switches to a block-checkpointed traceback,
+    which recomputes the back pointers one block at a time */
+#define HMM_VITERBI_MAX_BACKPTR_BYTES (256 * 1024 * 1024)
 
 #define BEGIN_TRANSITIONS_TAG "BEGIN_TRANSITIONS:"
 #define END_TRANSITIONS_TAG "END_TRANSITIONS:"
@@ -48,9 +52,10 @@ typedef enum {VITERBI, /**< Viterbi for speedy HMM solving */
 	      BACKWARD /**< Backward method of posterior decoding*/
 } hmm_mode;
 
-/* NOTE: eventually need to be able to support an "adjacency list"
- * rather than an "adjacency matrix" representation of an HMM, for
- * better efficiency when there are many states and they are not fully
+/* NOTE: transitions are specified by an "adjacency matrix", but
+ * hmm_reset also builds a compressed sparse row (adjacency list)
+ * representation, which the dynamic programming routines use for
+ * efficiency when there are many states and they are not fully
  * connected  */
 /** Hidden Markov Model and meta data  */
 typedef struct {
@@ -67,6 +72,20 @@ typedef struct {
   **successors;			/**< List of successor states in HMM, for each state i, the list of states that state i has a transition to */
   List *begin_successors, /**< List of states for which the begin state has a transition to */
  *end_predecessors;	  /**< List of states that have a transition to the end state */
+  int *pred_ptr,          /**< Compressed sparse row (CSR) form of the
+                             predecessor lists, excluding the begin
+                             state, built by hmm_reset: the
+                             predecessors of state i are
+                             pred_idx[pred_ptr[i]] through
+                             pred_idx[pred_ptr[i+1]-1] */
+    *pred_idx,            /**< Predecessor states (see pred_ptr) */
+    *succ_ptr,            /**< CSR form of the successor lists,
+                             excluding the end state (see pred_ptr) */
+    *succ_idx;            /**< Successor states (see succ_ptr) */
+  double *pred_score,     /**< Log transition probabilities
+                             corresponding to pred_idx */
+    *succ_score;          /**< Log transition probabilities
+                             corresponding to succ_idx */
 } HMM;
 
 
@@ -144,8 +163,15 @@ void hmm_print(FILE *F, HMM *hmm);
   @param emission_scores Output scores, 2D array, hmm->nstates rows & columns
   @param[in] seqlen Length of path
   @param[out] path Array of integers indicating state numbers in the HMM
+  @note Only two columns of scores are kept, and back pointers are
+  stored in one or two bytes per state and column.  If these would
+  exceed HMM_VITERBI_MAX_BACKPTR_BYTES, the forward pass instead saves
+  the scores at the start of blocks of about sqrt(seqlen) columns, and
+  the back pointers are recomputed block by block during the traceback
+  (about twice the time, but memory proportional to sqrt(seqlen)).
 */
-void hmm_viterbi(HMM *hmm, double **emission_scores, int seqlen, int *path);
+void hmm_viterbi(HMM *hmm, double **emission_scores, phast_pos seqlen, 
+                 int *path);
 
 /** 
    Fills matrix of "forward" scores and returns total log probability
@@ -156,7 +182,7 @@ void hmm_viterbi(HMM *hmm, double **emission_scores, int seqlen, int *path);
    @param[out] foward_scores must be allocated to same size as emission_scores 
    @result total log probability of sequence
 */
-double hmm_forward(HMM *hmm, double **emission_scores, int seqlen, 
+double hmm_forward(HMM *hmm, double **emission_scores, phast_pos seqlen, 
                    double **forward_scores);
 /** 
    Fills matrix of "backward" scores and returns total log probability
@@ -167,7 +193,7 @@ double hmm_forward(HMM *hmm, double **emission_scores, int seqlen,
    @param[out] backward_scores Must be allocated to same size as emission_scores
    @result Total log probability of sequence
 */
-double hmm_backward(HMM *hmm, double **emission_scores, int seqlen,
+double hmm_backward(HMM *hmm, double **emission_scores, phast_pos seqlen,
                     double **backward_scores);
 
 /** Fills matrix of posterior probabilities.
@@ -177,13 +203,49 @@ double hmm_backward(HMM *hmm, double **emission_scores, int seqlen,
    @param posterior_probs  (Optional) Must be allocated to same size as emission_scores
    @result Total log probability of sequence
 */
-double hmm_posterior_probs(HMM *hmm, double **emission_scores, int seqlen,
-                           double **posterior_probs);
+double hmm_posterior_probs(HMM *hmm, double **emission_scores, 
+                           phast_pos seqlen, double **posterior_probs);
 
-void hmm_do_dp_forward(HMM *hmm, double **emission_scores, int seqlen, 
+/** Single-precision version of hmm_viterbi.  Scores are accumulated
+   in double precision, and memory is managed as in hmm_viterbi.
+   @param[in] hmm Model to use
+   @param emission_scores Emission scores (log base 2), hmm->nstates rows & seqlen columns
+   @param[in] seqlen Length of path
+   @param[out] path Array of integers indicating state numbers in the HMM
+*/
+void hmm_viterbi_float(HMM *hmm, float **emission_scores, phast_pos seqlen,
+                       int *path);
+
+/** Single-precision version of hmm_forward.  The forward recursion
+   is carried out in probability space with rescaling at each column,
+   and the forward matrix is not stored.
+   @param[in] hmm Model to use
+   @param emission_scores Emission scores (log base 2), hmm->nstates rows & seqlen columns
+   @param[in] seqlen Number of columns in emission_scores
+   @result Total log (base 2) probability of sequence
+*/
+double hmm_forward_float(HMM *hmm, float **emission_scores, 
+                         phast_pos seqlen);
+
+/** Single-precision version of hmm_posterior_probs.  Emissions and
+   posteriors are stored as floats; forward and backward
+   probabilities are rescaled at each column and accumulated in double
+   precision.  The rows of posterior_probs that are provided are also
+   used to hold the scaled forward probabilities, so no other
+   nstates x seqlen matrix is needed unless some rows are NULL.
+   @param hmm Model to use
+   @param emission_scores Emission scores (log base 2), hmm->nstates rows & seqlen columns
+   @param seqlen Number of columns in emission_scores and posterior_probs
+   @param posterior_probs Rows of length seqlen; set posterior_probs[i] = NULL if posteriors for state i are not desired
+   @result Total log (base 2) probability of sequence
+*/
+double hmm_posterior_probs_float(HMM *hmm, float **emission_scores,
+                                 phast_pos seqlen, float **posterior_probs);
+
+void hmm_do_dp_forward(HMM *hmm, double **emission_scores, phast_pos seqlen, 
                        hmm_mode mode, double **full_scores, int **backptr);
-void hmm_do_dp_backward(HMM *hmm, double **emission_scores, int seqlen, 
-                        double **full_scores);
+void hmm_do_dp_backward(HMM *hmm, double **emission_scores, 
+                        phast_pos seqlen, double **full_scores);
 /** 
     Finds max or sum of score/transition combination over all previous
    states (max for Viterbi, sum for forward/backward).
@@ -196,10 +258,10 @@ void hmm_do_dp_backward(HMM *hmm, double **emission_scores, int seqlen,
    @result Max or sum of score/transition combination over all previous states
 */
 double hmm_max_or_sum(HMM *hmm, double **full_scores, double **emission_scores,
-                      int **backptr, int i, int j, hmm_mode mode);
+                      int **backptr, int i, phast_pos j, hmm_mode mode);
 
 
-void hmm_dump_matrices(HMM *hmm, double **emission_scores, int seqlen,
+void hmm_dump_matrices(HMM *hmm, double **emission_scores, phast_pos seqlen,
                        double **full_scores, int **backptr);
 /**
    Reset arcs of HMM according to a matrix of counts and optionally,
@@ -246,7 +308,7 @@ void hmm_train_from_paths(HMM *hmm, int **path, int npaths,
 */
 void hmm_train_update_counts(Matrix *trans_counts, Vector *state_counts, 
                              Vector *beg_counts,
-                             int *path, int len, int nstates);
+                             int *path, phast_pos len, int nstates);
 /** Create a trivial HMM.
    Starts with a single state that transitions to itself with probability 1.
    @note This if useful for causing general HMM-based models to collapse to simpler models
@@ -261,8 +323,8 @@ HMM *hmm_create_trivial();
     @param seqlen Length of path
     @param path Path to calculate total log likelihood for
  */
-double hmm_path_likelihood(HMM *hmm, double **emission_scores, int seqlen, 
-                           int *path);
+double hmm_path_likelihood(HMM *hmm, double **emission_scores, 
+                           phast_pos seqlen, int *path);
 
 /** Compute the total log likelihood of a subsequence of the input,
    using only the specified states.  Useful for scoring candidate
@@ -275,7 +337,7 @@ double hmm_path_likelihood(HMM *hmm, double **emission_scores, int seqlen,
    @result Log likelihood or subsequence identified by parameter 'states'
  */
 double hmm_score_subset(HMM *hmm, double **emission_scores, List *states,
-                        int begidx, int len);
+                        phast_pos begidx, phast_pos len);
 
 /** 
    Compute the log odds score for a subsequence of the input, comparing
@@ -292,7 +354,7 @@ double hmm_score_subset(HMM *hmm, double **emission_scores, List *states,
 */
 double hmm_log_odds_subset(HMM *hmm, double **emission_scores, 
                            List *test_states, List *null_states,
-                           int begidx, int len);
+                           phast_pos begidx, phast_pos len);
 
 /**
    Perform a cross product of two HMMs.  
@@ -345,7 +407,7 @@ void hmm_renormalize(HMM *hmm);
    @param path List of steps through the model
  */
 void hmm_stochastic_traceback(HMM *hmm, double **forward_scores, 
-			      int seqlen, int *path);
+			      phast_pos seqlen, int *path);
 
 /** Set the transition_score_matrix in an hmm object. 
   @param hmm Model to prepare
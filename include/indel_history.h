@@ -18,6 +18,8 @@
 #include <stdio.h>
 #include <trees.h>
 #include <msa.h>
+#include <hashtable.h>
+#include <misc.h>
 
 /** Number of Indel types i.e. insert, delete, none */
 #define NINDEL_CHARS 3
@@ -41,23 +43,74 @@ typedef struct {
   List **indels; /**< List of each indel */
 } CompactIndelHistory;
 
-/** Indel history of a Multiple Sequence Alignment */
+/** Indel history of a Multiple Sequence Alignment.  The history of
+    a column depends only on its pattern of gaps, and neighboring
+    columns usually have the same history, so the history is stored as
+    a table of distinct column histories ("patterns") plus a
+    run-length encoding of the patterns along the alignment.  Memory
+    is proportional to the number of runs, not to nnodes x ncols. */
 typedef struct {
   TreeNode *tree; /**< Tree describing structure of data */
   int ncols;      /**< Number of sites from data */
-  char **indel_strings;    /**< list of strings describing each indel */        /* make bin vector later */
+  int npatterns;  /**< Number of distinct column histories */
+  char **patterns; /**< Distinct column histories; patterns[p][id] is
+                      the indel_char of the node with the given id in
+                      columns having pattern p */
+  int nruns;      /**< Number of runs of columns with the same pattern */
+  int *run_start; /**< First column of each run; each run extends to
+                     the start of the next (the last to ncols) */
+  int *run_pattern; /**< Pattern of each run */
+  int alloc_patterns, /**< Allocated size of patterns */
+    alloc_runs;       /**< Allocated size of run_start and run_pattern */
+  Hashtable *pattern_hash; /**< Index of each pattern, for use in
+                              ih_add_pattern */
 } IndelHistory;
 
+/** Number of columns in a run of an indel history */
+static PHAST_INLINE
+int ih_run_len(IndelHistory *ih, int run) {
+  return (run == ih->nruns - 1 ? ih->ncols : ih->run_start[run+1]) - 
+    ih->run_start[run];
+}
+
 /** \name Indel History allocation functions 
  \{ */
 
 /** Create an Indel History object for a dataset 
   @param tree Representing dataset structure
-  @param ncols Number of columns in dataset
+  @param ncols Number of columns in dataset, all of which will be
+  initialized to bases.  Use ncols = 0 to build a history column by
+  column with ih_add_pattern and ih_append_cols.
   @result New indel history object
 */
 IndelHistory *ih_new(TreeNode *tree, int ncols);
 
+/** Add a column history to the table of patterns of an indel
+    history, if not already present.
+  @param ih Indel history
+  @param pattern Column history, giving the indel_char of each node
+  by id (copied)
+  @result Index of pattern
+*/
+int ih_add_pattern(IndelHistory *ih, char *pattern);
+
+/** Append columns to an indel history
+  @param ih Indel history
+  @param pattern Index of column history (see ih_add_pattern)
+  @param len Number of columns to append
+*/
+void ih_append_cols(IndelHistory *ih, int pattern, int len);
+
+/** Get the indel character of a node in a column of an indel
+    history.  Requires a binary search over runs; to visit all
+    columns, iterate over runs instead.
+  @param ih Indel history
+  @param node_id Id of node in tree
+  @param col Column of alignment
+  @result Indel character (INS, DEL, or BASE)
+*/
+char ih_get_char(IndelHistory *ih, int node_id, int col);
+
 /** Create a compact Indel history object for a dataset 
   @param tree Representing dataset structure
   @param ncols Number of columns in dataset
@@ -73,8 +126,11 @@ CompactIndelHistory *ih_new_compact(TreeNode *tree, int ncols);
 */
 IndelHistory *ih_extract_from_alignment(MSA *msa, TreeNode *tree);
 
-/**  Reconstruct an indel history by parsimony from an alignment, given a tree 
-  @param msa Multiple Sequence Alignment sequence data
+/**  Reconstruct an indel history by parsimony from an alignment, given a tree.
+  The reconstruction is computed once for each distinct pattern of
+  gaps and missing data among column tuples.
+  @param msa Multiple Sequence Alignment sequence data (with ordered
+  sufficient statistics)
   @param tree Tree structure
   @result Indel history object from sequence and tree data
 */
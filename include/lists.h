@@ -35,6 +35,7 @@
 
 #include <string.h>
 #include <stdlib.h> 
+#include <stdint.h>
 #include <external_libs.h>
 
 /** Basic List object */
@@ -109,6 +110,15 @@ List* lst_new(int nelements,	/* Starting number of elements */
 */
 List* lst_new_int(int nelements); /* Starting number of elements */
 
+/** Create new list of coordinates (phast_pos, a 64-bit integer; see misc.h).
+  Returns newly allocated List object, with starting size fixed at sizeof(int64_t).
+
+  @param nelements Starting number of elements.
+  
+  \sa lst_new, lst_new_int, lst_get_pos, lst_push_pos.
+*/
+List* lst_new_pos(int nelements); /* Starting number of elements */
+
 /** Create new list of doubles.
   Returns newly allocated List object, with starting size fixed at sizeof(double).
 
@@ -283,6 +293,20 @@ int lst_get_int(List* l, int i) {
   return (ptr == NULL ? 0 : *ptr);
 }
 
+/** Retrieve ith coordinate in list.
+   Returns coordinate at ith position in list or 0 if i is out of bounds.
+
+  @param l List containing the desired object (see lst_new_pos).
+  @param i Index of the object to be retrieved.   
+
+  \sa lst_get, lst_get_int.
+*/
+static PHAST_INLINE
+int64_t lst_get_pos(List* l, int i) {
+  int64_t *ptr = (int64_t*)lst_get(l, i);
+  return (ptr == NULL ? 0 : *ptr);
+}
+
 /** Retrieve the ith integer in list.
    Returns integer at ith position in list or 0 if i is out of bounds.
 
@@ -390,6 +414,19 @@ void lst_set_int(List *l, int idx, int i)
 {  int ii[10]; ii[0]=i; lst_set(l, idx, ii); }
 
 
+/** Set value of ith coordinate in list. 
+
+  @param l List where the element is to be copied into.
+  @param idx Index of the object to be replaced.
+  @param i Coordinate value.
+
+  \sa lst_set, lst_set_int.
+*/
+static PHAST_INLINE
+void lst_set_pos(List *l, int idx, int64_t i)
+{  lst_set(l, idx, &i); }
+
+
 /** Set value of ith double in list. 
 
   @param l List where the element is to be copied into.
@@ -512,6 +549,18 @@ void lst_push_int(List *l, int i)
 {  int ii[10]; ii[0]=i; lst_push(l, ii); }
 
 
+/** Push coordinate onto end of list.
+
+  @param l List where object is to be appended.
+  @param i Coordinate value.
+  
+  \sa lst_push, lst_push_int.
+*/
+static PHAST_INLINE
+void lst_push_pos(List *l, int64_t i) 
+{  lst_push(l, &i); }
+
+
 /** Push double onto end of list .
   @param l List where object is to be appended.
   @param d Double value.
@@ -745,6 +794,13 @@ int lst_find_compare(List *l,
 */
 int lst_bsearch_int(List *lst, int val);
 
+/** Binary search of a list of coordinates.  Same as
+   lst_bsearch_int, but for lists created with lst_new_pos.
+  @param lst Target list.
+  @param val Value to be searched.   
+*/
+int lst_bsearch_pos(List *lst, int64_t val);
+
 
 /** \} */
 
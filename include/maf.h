@@ -427,7 +427,7 @@ MSA *maf_read_old(FILE *F, FILE *REFSEQF, int tuple_size, char *alphabet,
    @result 0 if successful, EOF if no more blocks available
 */
 int maf_read_block(FILE *F, MSA *mini_msa, Hashtable *name_hash,
-                   int *start_idx, int *length, int do_toupper);
+                   phast_pos *start_idx, int *length, int do_toupper);
 
 /** Add sequences from a MAF file to an existing MAF block
    @param[in] F File containing MAF data to read
@@ -442,7 +442,7 @@ int maf_read_block(FILE *F, MSA *mini_msa, Hashtable *name_hash,
    @result 0 if successful, EOF if no more blocks available
 */
 int maf_read_block_addseq(FILE *f, MSA *mini_msa, Hashtable *name_hash,
-			  int *start_idx, int *length, int do_toupper,
+			  phast_pos *start_idx, int *length, int do_toupper,
 			  int skip_new_species);
 
 /** Get partial list of sequence names (roots of names only) and length of refseq.
@@ -455,7 +455,7 @@ int maf_read_block_addseq(FILE *f, MSA *mini_msa, Hashtable *name_hash,
    @warning May re-order names to put refseq first even if add_seqs == 0
  */
 void maf_quick_peek(FILE *f, char ***names, Hashtable *name_hash,
-		    int *nseqs, int *refseqlen, int add_seqs);
+		    int *nseqs, phast_pos *refseqlen, int add_seqs);
 
 /** Get complete list of sequence names (roots of names only) and length of refseq.
    @param[in] F File containing MAF Block contents
@@ -470,7 +470,7 @@ void maf_quick_peek(FILE *f, char ***names, Hashtable *name_hash,
 */
 void maf_peek(FILE *F, char ***names, Hashtable *name_hash, 
               int *nseqs, msa_coord_map *map, List *redundant_blocks,
-              int keep_overlapping, int *refseqlen);
+              int keep_overlapping, phast_pos *refseqlen);
 /** \} */
 
 /** Extracts features from gff relevant to a specified interval.
@@ -486,8 +486,8 @@ void maf_peek(FILE *F, char ***names, Hashtable *name_hash,
    @param[in] tuple_size Size of tuples, used in reverse complementing
    @note Shifts all coords such that start_idx is position 1 
 */
-void maf_block_sub_gff(GFF_Set *sub_gff, GFF_Set *gff, int start_idx, 
-                       int end_idx, int *gff_idx, CategoryMap *cm,
+void maf_block_sub_gff(GFF_Set *sub_gff, GFF_Set *gff, phast_pos start_idx, 
+                       phast_pos end_idx, int *gff_idx, CategoryMap *cm,
                        int reverse_compl, int tuple_size);
 
 #endif
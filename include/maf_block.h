@@ -30,10 +30,10 @@ typedef struct {
   String *seq;  /**< Sequence data of sub block */
   String *src,   /**< Source of sequence data */
     *specName;  /**< Part of src before the first '.' */
-  long start;   /**< Starting column */
+  phast_pos start;   /**< Starting column */
   int size;    /**< Length of the block */
   char strand; /**< Type of strand of the sequence*/
-  long srcSize; /**< Size of the source */
+  phast_pos srcSize; /**< Size of the source */
   int numLine;  /**< Number of lines corresponding to this 
 			species in this block. */
   char lineType[4];  /**< type of line i, either 's', 'q', 'i', 'e' */
@@ -142,8 +142,8 @@ void mafBlock_subSpec(MafBlock *block, List *specNameList, int include);
     @result 0 if block is empty, otherwise 1
     @note (1-based, endcol inclusive).
 */
-int mafBlock_trim(MafBlock *block, int startcol, int endcol,
-		  String *refseq, int offset);
+int mafBlock_trim(MafBlock *block, phast_pos startcol, phast_pos endcol,
+		  String *refseq, phast_pos offset);
 
 /** Sets block to the sub-alignment from alignment column start to end.
     @param block Maf Block to perform sub alignment on
@@ -199,7 +199,7 @@ String *mafBlock_get_refSpec(MafBlock *block);
     @param specName Name of the species to get starting index of
     @result Starting index of species, OR -1 if species does not exist in given$
 */
-long mafBlock_get_start(MafBlock *block, String *specName);
+phast_pos mafBlock_get_start(MafBlock *block, String *specName);
 
 /** Get number of bases (non-gaps) in alignment for a given species. 
     @param block Maf Block containing species specName sequence data
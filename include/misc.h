@@ -24,6 +24,8 @@
 #include <time.h>
 #include <string.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <limits.h>
 #include <sys/time.h>
 #include <external_libs.h>
 struct hash_table;
@@ -67,6 +69,23 @@ struct hash_table;
 /** Safe divide, checks for div by 0 so no arithmetic errors are thrown */
 #define safediv(x, y) ((y) != 0 ? (x) / (y) : ((x) == 0 ? 0 : ((x) > 0 ? INFTY : NEGINFTY)))
 
+/** Type for sequence and alignment coordinates (positions, lengths,
+    and offsets).  A 64-bit integer on all platforms (a long has
+    only 32 bits on Windows), so that coordinates on chromosomes and
+    concatenated alignments longer than 2^31 bases can be
+    represented; print with PHAST_POS_FMT and parse with str_as_pos.
+    Per-column arrays (e.g., tuple indices or categories) need not
+    use this type */
+typedef int64_t phast_pos;
+
+/** printf conversion for a phast_pos, e.g., printf("%" PHAST_POS_FMT
+    "\n", pos) */
+#define PHAST_POS_FMT PRId64
+
+/** Coordinate larger than any valid phast_pos (INFTY is too small
+    for this purpose) */
+#define POS_INFTY INT64_MAX
+
 /** Amino Acid alphabet */
 #define AA_ALPHABET "ARNDCQEGHILKMFPSTWYV$"
 
@@ -404,6 +423,12 @@ List *get_arg_list_dbl(char *arg);
  */
 int get_arg_int(char *arg);
 
+/** Argument conversion with error checking (sequence coordinate)
+   @param arg String to convert to phast_pos
+   @result Coordinate parsed from string
+ */
+phast_pos get_arg_pos(char *arg);
+
 /** Argument conversion with error checking (double)
    @param arg String to convert to double
    @result Double parsed from string
@@ -25,6 +25,9 @@
 #define MTF_EPSILON 0.001
 /** Threshold met for convergence when finding a motif */
 #define MTF_EM_CONVERGENCE_THRESHOLD 0.1
+/** Minimum number of EM iterations before a restart may be abandoned
+    (see mtf_find) */
+#define MTF_ABANDON_MIN_ITER 5
 /** URL to use when creating links on output HTML webpages */
 #define HGTRACKS_URL "http://hgwdev-acs.cse.ucsc.edu/cgi-bin/hgTracks?db=hg16"
 
@@ -106,12 +109,23 @@ void mtf_free(Motif *m);
                      pseudocounts. If == 0 Do a deterministic
                      initialization based on a consensus sequence
    @param npseudocounts Number of Pseudo counts for consensus bases
+   @param nthreads Number of threads (<= 0 means one per processor).
+   Restarts (and candidates from init_list) are trained in parallel;
+   if there is only one, the threads are used for the E step of EM
+   instead (see mtf_em).  Initial parameters are drawn before training
+   begins, so results do not depend on the number of threads.
+   @param abandon_margin If > 0, EM training of a restart is abandoned
+   once, after at least #MTF_ABANDON_MIN_ITER iterations, its log
+   likelihood trails that of the best restart completed so far by more
+   than this amount.  Abandoned restarts are not reported.  With
+   several threads, which restarts are abandoned may depend on the
+   order in which they complete.
    @result List of Motif objects. 
 */
 List* mtf_find(void *data, int multiseq, int motif_size, int nmotifs, 
                TreeNode *tree, void *backgd, double *has_motif, double prior, 
                int nrestarts, List *init_list, int sample_parms, 
-               int npseudocounts);
+               int npseudocounts, int nthreads, double abandon_margin);
 
 /** This is the function that is optimized in discriminative training;
    see Segal et al., RECOMB '02 */
@@ -133,6 +147,7 @@ double mtf_compute_conditional(Vector *params, void *data);
    @param get_observation_index Function to get observation index
    @param postprob (Optional) Array of size nsamples to be populated with Posterior probabilities that a motif appears
    @param bestposition (Optional) Array of size nsamples to be populated with starting position of the best instance of the motif
+   @param nthreads Number of threads for the E step (<= 0 means one per processor).  Samples are divided into contiguous blocks, one per thread, and expected counts are summed over blocks in order, so results do not depend on scheduling; with nthreads == 1 they are identical to a serial E step
    @result Maximized log likelihood.  
    @note This function can be used with phylogenetic models or ordinary multinomial models.  
    @note The first model is assumed to represent the background distribution and its parameter
@@ -145,7 +160,7 @@ double mtf_em(void *models, void *data, int nsamples,
               void (*estimate_state_models)(void**, int, void*, 
                                             double**, int),
               int (*get_observation_index)(void*, int, int),
-              double *postprob, int *bestposition);
+              double *postprob, int *bestposition, int nthreads);
 
 /** Estimate a (multinomial) background model from a set of sequences.
    @param[in] s Set of sequences to estimate background model from
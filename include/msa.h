@@ -16,7 +16,9 @@
 #define MSA_H
 
 #include <stdio.h>
+#include <misc.h>
 #include <gff.h>
+#include <gff_compact.h>
 #include <category_map.h>
 #include <markov_matrix.h>
 #include <vector.h>
@@ -36,7 +38,7 @@ struct msa_ss_struct;
 /** Multiple sequence alignment object */
 typedef struct {
   int nseqs;                    /**< Number of sequences */
-  unsigned int length;          /**< Number of columns */
+  phast_pos length;             /**< Number of columns */
   char *alphabet;               /**< Alphabet (see #DEFAULT_ALPHABET) */
   int inv_alphabet[NCHARS];     /**< Inverse of 'alphabet' (maps characters to their index in 'alphabet') */
   char *missing;                /**< Recognized missing data characters */
@@ -47,8 +49,8 @@ typedef struct {
   int *categories;		/**< Categories for each coordinate */
   struct msa_ss_struct *ss;	/**< Sufficient Statistics */
   int ncats;			/**< Number of categories */
-  int alloc_len;		/**< Length of memory allocated for sequence */
-  int idx_offset;		/**< Index offset */
+  phast_pos alloc_len;		/**< Length of memory allocated for sequence */
+  phast_pos idx_offset;		/**< Index offset */
   int *is_informative;          /**< If non-NULL, indicates which
                                    sequences are to be considered
                                    "informative", e.g., for
@@ -99,15 +101,15 @@ typedef enum {PHYLIP,           /**< PHYLIP format  */
     and the coordinate frame of one of the sequences in the
     alignment.  */
 typedef struct {
-  List *seq_list;               /**< list of indexes in sequence
+  List *seq_list;               /**< list (of phast_pos) of indexes in sequence
                                    immediately following gaps,
                                    expressed in the coordinate frame
                                    of the sequence (starting with
                                    position 1) */
-  List *msa_list;               /**< list of corresponding indices in
+  List *msa_list;               /**< list (of phast_pos) of corresponding indices in
                                    the frame of the MSA */
-  int seq_len;                  /**< length of sequence */
-  int msa_len;                  /**< length of alignment */
+  phast_pos seq_len;            /**< length of sequence */
+  phast_pos msa_len;            /**< length of alignment */
 } msa_coord_map;
 
 
@@ -122,7 +124,7 @@ typedef struct {
    @result Newly allocated MSA with provided sequences
    @note No new memory is allocated for seqs or names 
  */
-MSA *msa_new(char **seqs, char **names, int nseqs, int length, 
+MSA *msa_new(char **seqs, char **names, int nseqs, phast_pos length, 
              char *alphabet);
 
 /** Re-allocate if sequence length increases
@@ -133,7 +135,8 @@ If the number of sequences increases, call msa_add_seq.
     @param do_cats reallocate to accommodate more categories
     @param store_order reallocate to accommodate more tuple orders
  */
-void msa_realloc(MSA *msa, int new_length, int new_alloclen, int do_cats, int store_order);
+void msa_realloc(MSA *msa, phast_pos new_length, phast_pos new_alloclen, 
+                 int do_cats, int store_order);
 
 /** Create a copy of an MSA.  
     @param msa MSA to copy data from
@@ -215,8 +218,8 @@ void msa_print_to_file(const char *filename, MSA *msa, msa_format_type format,
     @note Start and end are half-open, 0-based
     @note All following MSAs must have the same alphabet
 */
-void msa_print_stats(MSA *msa, FILE *F, char *label, int header, int start,
-                     int end);
+void msa_print_stats(MSA *msa, FILE *F, char *label, int header, 
+                     phast_pos start, phast_pos end);
 
 /** \} \name MSA cleanup functions 
    \{ */
@@ -273,8 +276,8 @@ void msa_project(MSA *msa, int refseq);
    @note All memory is copied
    @note First character at index 0
 */
-MSA* msa_sub_alignment(MSA *msa, List *seqlist, int include, int start_col, 
-                       int end_col);
+MSA* msa_sub_alignment(MSA *msa, List *seqlist, int include, 
+                       phast_pos start_col, phast_pos end_col);
 /** Creates a "coordinate map" object with respect to the designated sequence.  
    @param msa MSA containing reference sequence to create coordinate map from
    @param refseq Index of sequence within MSA to treat as refseq
@@ -298,13 +301,13 @@ void msa_coord_map_print(FILE *F, msa_coord_map *map);
    @result Returns -1 if sequence coordinate is out of bounds, otherwise msa coordinate
    @note Indexing begins with 1. 
 */
-int msa_map_seq_to_msa(msa_coord_map *map, int seq_pos);
+phast_pos msa_map_seq_to_msa(msa_coord_map *map, phast_pos seq_pos);
 /** Converts an MSA coordinate to a sequence coordinate using a coordinate map object.
     @param map Coordinate Map
     @param pos MSA sequence position
     @result Returns -1 if MSA coordinate is out of bounds, otherwise sequence coordinate
 */
-int msa_map_msa_to_seq(msa_coord_map *map, int pos);
+phast_pos msa_map_msa_to_seq(msa_coord_map *map, phast_pos pos);
 
 /**  Converts coordinates of all features in a GFF_Set from one frame of
    reference to another. 
@@ -316,7 +319,20 @@ int msa_map_msa_to_seq(msa_coord_map *map, int pos);
    @note Features whose start and end coords are out of range will be dropped; if only the start or the end is out of range, they will be truncated.
 */
 void msa_map_gff_coords(MSA *msa, GFF_Set *set, int from_seq, int to_seq, 
-                        int offset);
+                        phast_pos offset);
+
+/**  Converts coordinates of all features in a compact feature set
+   from one frame of reference to another.  Same as
+   msa_map_gff_coords, but for a GFF_CompactSet.
+   @param msa MSA 
+   @param gff Compact feature set to convert
+   @param from_seq Starting part of an index between 1 and nseqs, or 0 (for the frame of the entire alignment), or -1 (to infer feature by feature by sequence name)
+   @param to_seq Ending part of an index between 1 and nseqs, or 0 (for the frame of the entire alignment)
+   @param offset Added to start and end of each feature coords
+   @note Features whose start and end coords are out of range will be dropped; if only the start or the end is out of range, they will be truncated.
+*/
+void msa_map_gffc_coords(MSA *msa, GFF_CompactSet *gff, int from_seq, 
+                         int to_seq, phast_pos offset);
 
 
 /** Returns an array of msa objects, one for each feature.
@@ -335,8 +351,8 @@ MSA **msa_split_by_gff(MSA *msa, GFF_Set *gff);
     @param coord Coordinate to map from from_map to to_map
     @result coordinate on to_map OR returns -1 if out of range.
 */
-int msa_map_seq_to_seq(msa_coord_map *from_map, msa_coord_map *to_map, 
-                       int coord);
+phast_pos msa_map_seq_to_seq(msa_coord_map *from_map, msa_coord_map *to_map, 
+                             phast_pos coord);
 
 /** \} */
 
@@ -356,6 +372,18 @@ void msa_map_free(msa_coord_map *map);
 */
 void msa_label_categories(MSA *msa, GFF_Set *gff, CategoryMap *cm);
 
+/** 
+   Add labels to MSA categories based on a compact feature set.
+   Equivalent to msa_label_categories, but avoids creating a
+   GFF_Feature per feature.
+   @pre Coordinates of features must be in frame of ref of entire alignment
+   @param msa MSA to set categories for (msa->categories may be null)
+   @param gff Compact feature set to map categories to
+   @param cm Category Map from features to categories
+*/
+void msa_label_categories_compact(MSA *msa, GFF_CompactSet *gff, 
+                                  CategoryMap *cm);
+
 /** Return sequence index of given sequence name or -1 if not found.
     @param msa MSA containing desired sequence
     @param name Sequence name to get index of
@@ -393,14 +421,14 @@ char msa_compl_char(char c);
     @param seq Sequence data to reverse complement
     @param length Length of sequence data in chars 
 */
-void msa_reverse_compl_seq(char *seq, int length);
+void msa_reverse_compl_seq(char *seq, phast_pos length);
 
 /** Reverse complements a segment of a sequence 
     @param seq Sequence data containing segment to reverse complement
     @param start Starting index of sequence to reverse complement
     @param end Ending index of sequence to reverse complement
 */
-void msa_reverse_compl_seq_segment(char *seq, int start, int end);
+void msa_reverse_compl_seq_segment(char *seq, phast_pos start, phast_pos end);
 
 /** Reverse complements an entire MSA. 
     @param msa MSA to reverse complement
@@ -412,7 +440,7 @@ void msa_reverse_compl(MSA *msa);
    @param start Starting index of sequences in MSA to reverse complement
    @param end Ending index of sequences in MSA to reverse complement
  */
-void msa_reverse_compl_segment(MSA *msa, int start, int end);
+void msa_reverse_compl_segment(MSA *msa, phast_pos start, phast_pos end);
 
 /** Reverse complements all segments of an MSA corresponding to "groups"
    in a GFF that appear to be completely on the reverse strand.  
@@ -459,7 +487,7 @@ void msa_partition_by_category(MSA *msa, List *submsas, List *cats_to_do,
    @note start and end are half-open, 0-based
    @result Newly allocated vector containing base counts (size of strlen(alphabet) listed in order of the alphabet)
  */
-Vector *msa_get_base_counts(MSA *msa, int start, int end);
+Vector *msa_get_base_counts(MSA *msa, phast_pos start, phast_pos end);
 
 
 /** Get frequencies for each base.
@@ -468,7 +496,7 @@ Vector *msa_get_base_counts(MSA *msa, int start, int end);
    @note start and end are half-open, 0-based
    @result Newly allocated vector containing base frequencies (size of strlen(alphabet) listed in order of the alphabet)
  */
-Vector *msa_get_base_freqs(MSA *msa, int start, int end);
+Vector *msa_get_base_freqs(MSA *msa, phast_pos start, phast_pos end);
 
 /** Get frequencies of k-tuples of bases, rather than of individual bases.  
    By convention, it is the *last* character in each
@@ -610,7 +638,7 @@ void msa_reorder_rows(MSA *msa, List *target_order);
     @param pos Position within sequence to get data from
     @result Char at position 'pos' of sequence 'seq' in MSA 'msa'
  */
-char msa_get_char(MSA *msa, int seq, int pos);
+char msa_get_char(MSA *msa, int seq, phast_pos pos);
 
 /** \name MSA File Format functions 
    \{ */
@@ -719,7 +747,7 @@ void msa_find_noaln(MSA *msa, int refseqidx, int min_block_size, int *noaln);
    @param pos Column to test for missing data
    @result TRUE if all sequences (except refseq) in column are missing data, false otherwise
 */
-int msa_missing_col(MSA *msa, int ref, int pos);
+int msa_missing_col(MSA *msa, int ref, phast_pos pos);
 
 /** Strip ANY or ALL gaps or perform projection.
    @param msa MSA to strip gaps from or projection
@@ -740,7 +768,8 @@ void msa_strip_gaps(MSA *msa, int gap_strip_mode);
    @note if mode ==
    STRIP_ALL_GAPS, a gapped column is one containing only gaps
 */
-int msa_num_gapped_cols(MSA *msa, int gap_strip_mode, int start, int end);
+phast_pos msa_num_gapped_cols(MSA *msa, int gap_strip_mode, phast_pos start, 
+                              phast_pos end);
 
 
 /**\} */
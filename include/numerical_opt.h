@@ -38,6 +38,23 @@ typedef enum {
   OPT_UNKNOWN_PREC
 } opt_precision_type; 
 
+/* state for SQUAREM acceleration of an EM (or other fixed-point)
+   iteration; see opt_squarem_update and opt_squarem_check */
+typedef struct {
+  Vector *hist[3];              /* successive EM updates since the
+                                   last extrapolation */
+  int nhist;
+  Vector *fallback;             /* plain EM update to revert to if an
+                                   extrapolated point is rejected */
+  double ref_ll;                /* log likelihood an extrapolated
+                                   point must reach to be accepted */
+  int pending;                  /* extrapolated point awaiting
+                                   evaluation */
+  double step_max;              /* bound on extrapolation step length */
+  int nextrap, nrejected;       /* counts of extrapolation steps taken
+                                   and rejected */
+} OptSquarem;
+
 opt_precision_type get_precision(const char *prec);
 
 void opt_gradient(Vector *grad, double (*f)(Vector*, void*), 
@@ -92,4 +109,15 @@ int opt_min_sigfig(Vector *p1, Vector *p2);
 
 int opt_sigfig(double val1, double val2);
 
+OptSquarem *opt_squarem_new();
+
+void opt_squarem_free(OptSquarem *sq);
+
+void opt_squarem_reset(OptSquarem *sq);
+
+int opt_squarem_update(OptSquarem *sq, Vector *params, double ll,
+                       Vector *lower_bounds, Vector *upper_bounds);
+
+int opt_squarem_check(OptSquarem *sq, Vector *params, double ll);
+
 #endif
@@ -54,7 +54,9 @@ struct phastCons_struct {
     estim_rho,		/**< Whether to estimate the rho parameter */
     set_transitions,	/**< Whether user supplies mu, nu for transition information, otherwise estimated */
     viterbi,		/**< Whether to use Viterbi algorithm to predict discrete elements */
-    compute_likelihood; /**< Whether to compute the likelihood */
+    compute_likelihood, /**< Whether to compute the likelihood */
+    single_prec,	/**< Whether to store emissions and posterior probabilities in single precision (see phmm_set_single_prec) */
+    no_accel;		/**< Whether to disable SQUAREM extrapolation in EM and use plain EM updates */
   int nrates,		/**< Number of rates for first tree model */
     nrates2,		/**< Number of rates for second tree model */
     refidx,		/**< Index of reference sequence */
@@ -77,18 +79,21 @@ struct phastCons_struct {
     *log_f,		/**< File descriptor to save general info */
     *post_probs_f,	/**< File descriptor to save posterior probs */
     *results_f,		/**< File descriptor to save results */
-    *progress_f;	/**< File descriptor to save progress */
+    *progress_f,	/**< File descriptor to save progress */
+    *em_stats_f;	/**< If non-NULL, compute expected sufficient statistics for EM (a single E step), write them here and stop */
   List *states,		/**< List of states of interest in the phylo-HMM, specified by number (starts at 0), or if --catmap, by category name */
     *pivot_states,	/**< List of "pivot" states to "reflect" forward strand HMM around specified by number (starts at 0), or if --catmap, by category name*/
     *inform_reqd,	/**< List of states that must have "informative" columns (i.e., columns with more than two non-missing-data characters) use "none" to disable  */
-    *not_informative;	/**< List of sequences not to consider when deciding if a column is "informative" or not */ 
+    *not_informative,	/**< List of sequences not to consider when deciding if a column is "informative" or not */ 
+    *em_merge;		/**< If non-NULL, list of files of sufficient statistics written with em_stats_f, to be summed for an M step of EM (no alignment is used) */
   TreeModel **mod;	/**< List of tree models for MSAs */
   int nummod;		/**< Number of tree models for MSAs */
   char *seqname,	/**< Sequence name for reference sequence */
     *idpref,		/**< Prefix for assigned ids */
     *estim_trees_fname_root,	/**< Root part of filename for tree models i.e. %s.cons.mod or %s.noncons.mod */
     *extrapolate_tree_fname,	/**< Filepath to tree file used to extrapolate a larger set of species*/
-    *bgc_branch;        /**< If not NULL, assume a two-state HMM with and without bgc on the named branch*/
+    *bgc_branch,        /**< If not NULL, assume a two-state HMM with and without bgc on the named branch*/
+    *bigwig_fname;      /**< If not NULL, write posterior probs to this file in bigWig format instead of to post_probs_f */
   HMM *hmm;		       /**< Hidden Markov Model */
   Hashtable *alias_hash;       /**< Sequence name aliases e.g., "hg17=human; mm5=mouse; rn3=rat" */
   TreeNode *extrapolate_tree;	/**< Root of tree used for extrapolation of larget set of species */
@@ -110,6 +115,17 @@ int phastCons(struct phastCons_struct *p);
  */
 struct phastCons_struct* phastCons_struct_new(int rphast);
 
+/** Perform an M step of two-state EM from expected sufficient
+    statistics computed separately for portions of the data (see
+    em_stats_f), then output the new parameters as phastCons would
+    after estimation.  Called by phastCons when p->em_merge is
+    non-NULL.
+   @param p All settings; the tree model, if any, is the starting
+   point for the tree-model parameters
+   @result 0 on success
+ */
+int phastCons_em_merge(struct phastCons_struct *p);
+
 /* Functions implemented below and used internally */
 /** \} \name Supporting functions 
 \{ */
@@ -142,6 +158,8 @@ void setup_two_state(HMM **hmm, CategoryMap **cm, double mu, double nu);
    @param tau_1 (Optional) Approximately the inverse of the expected indel length in Non-Conserved state 
    @param rho (Optional) Rho parameter value
    @param gamma Gamma parameter
+   @param accelerate Whether to accelerate EM by SQUAREM extrapolation
+   (see EmAccel)
    @param logf File descriptor of where to save log info 
    @result Log Likelihood. */
 double fit_two_state(PhyloHmm *phmm, MSA *msa, int estim_func, int estim_indels,
@@ -149,7 +167,13 @@ double fit_two_state(PhyloHmm *phmm, MSA *msa, int estim_func, int estim_indels,
 		     double *mu, double *nu, 
                      double *alpha_0, double *beta_0, double *tau_0, 
                      double *alpha_1, double *beta_1, double *tau_1, 
-                     double *rho, double gamma, FILE *logf);
+                     double *rho, double gamma, int accelerate, FILE *logf);
+
+/** Unpack all parameters for the two-state phylo-HMM (used in M step of EM)
+   @param phmm PhyloHmm object
+   @param params Tree-model parameters, with rho last
+*/
+void unpack_params_phmm(PhyloHmm *phmm, Vector *params);
 
 /** Re-estimate phylogenetic model based on expected counts (M step of EM) 
    @param models NOT USED
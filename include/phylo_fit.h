@@ -47,7 +47,8 @@ struct phyloFit_struct {
     no_freqs, no_rates, assume_clock, 
     init_parsimony, parsimony_only, no_branchlens,
     label_categories, symfreq, init_backgd_from_data,
-    use_selection, max_em_its;
+    use_selection, max_em_its,
+    nthreads, window_warm_start, no_accel;
   unsigned int nsites_threshold;
   TreeNode *tree;
   CategoryMap *cm;
@@ -58,6 +59,7 @@ struct phyloFit_struct {
     *label_str, *label_type;
   double alpha, selection;
   GFF_Set *gff;
+  GFF_CompactSet *gff_compact;
   TreeModel *input_mod;
   FILE *logf;
 
@@ -42,6 +42,9 @@ typedef struct {
   double gamma;			/**< Target coverage for two-state
                                    rate-variation phylo-HMM */
   Matrix *H;                    /**< Inverse Hessian for BFGS  */
+  Vector *tree_params;          /**< Tree-model parameters from last
+                                   M step (with rho last), for
+                                   accelerated EM */
 } EmData;
 
 /** Phylo HMM object */
@@ -78,8 +81,15 @@ typedef struct {
   int reflected;                /**< Whether "reflected" for reverse complement */
   double **emissions;           /**< Values computed by
                                    phmm_compute_emissions */
+  float **emissions_float;      /**< Values computed by
+                                   phmm_compute_emissions in
+                                   single-precision mode (used instead
+                                   of emissions) */
+  int single_prec;              /**< Whether emissions are stored in
+                                   single precision (see
+                                   phmm_set_single_prec) */
   double **forward;             /**< Forward scores */
-  int alloc_len;                /**< Length for which emissions and/or
+  phast_pos alloc_len;          /**< Length for which emissions and/or
                                    forward are (or are to be) allocated */
   int *state_pos, 		/**< Contain positive tracking data for emissions */
   *state_neg;   		/**< Contain negative tracking data for emissions */
@@ -197,6 +207,20 @@ void phmm_update_cross_prod(PhyloHmm *phmm, double lambda);
 */
 void phmm_compute_emissions(PhyloHmm *phmm, MSA *msa, int quiet);
 
+/** Store emissions in single precision.  Emissions computed
+    subsequently by phmm_compute_emissions are stored in
+    phmm->emissions_float rather than phmm->emissions, and any that
+    have already been computed are converted (and the double-precision
+    copies freed).  Viterbi, likelihood, posterior and scoring
+    functions use single-precision versions of the HMM algorithms,
+    which accumulate in double precision.  This halves the memory
+    required for emissions and posteriors, but parameter estimation
+    (phmm_fit_lambda, phmm_fit_em) is not supported in this mode, so
+    it should be done first.
+    @param phmm Phylo-HMM
+*/
+void phmm_set_single_prec(PhyloHmm *phmm);
+
 /** Calculate Log Likelihood for given Phylo-HMM and Lambda.
     @param phmm Phylo-HMM to get LogL for
     @param lambda Lambda probability
@@ -271,6 +295,28 @@ double **phmm_new_postprobs(PhyloHmm *phmm);
  */
 double* phmm_postprobs_cats(PhyloHmm *phmm, List *cats, double *lnl);
 
+/** Computes single-precision posterior probabilities for a PhyloHmm
+    whose emissions are stored in single precision.
+    @pre Emissions must have already been computed, with
+    phmm->single_prec set
+    @param[in] phmm PhyloHMM object
+    @param[out] post_probs Calculated post probabilities (rows may be
+    NULL for states that are not of interest)
+    @result Log likelihood.
+    @see phmm_set_single_prec
+*/
+double phmm_postprobs_float(PhyloHmm *phmm, float **post_probs);
+
+/** Returns new object with single-precision posterior probabilities
+    for a PhyloHmm whose emissions are stored in single precision.
+    @pre Emissions must have already been computed, with
+    phmm->single_prec set
+    @param[in] phmm PhyloHMM object
+    @result Array of phmm->hmm->nstates rows of posterior probabilities
+    @see phmm_postprobs_float
+*/
+float **phmm_new_postprobs_float(PhyloHmm *phmm);
+
 /** Score a set of predicted features using log odds scoring.
     @param phmm Phylo-HMM object 
     @param preds Predicted features to score
@@ -318,7 +364,7 @@ void phmm_compute_emissions_copy_em(double **emissions, void **models,
    @param length NOT USED
 */
 void phmm_compute_emissions_em(double **emissions, void **models, int nmodels,
-                               void *data, int sample, int length);
+                               void *data, int sample, phast_pos length);
 
 /** Re-estimate phylogenetic models based on expected counts 
     @param models NOT USED
@@ -337,7 +383,7 @@ void phmm_estim_mods_em(TreeModel **models, int nmodels, void *data,
    @param position Index of tuple_idx array
    @result Index of tuple
  */
-int phmm_get_obs_idx_em(void *data, int sample, int position);
+int phmm_get_obs_idx_em(void *data, int sample, phast_pos position);
 
 /** General routine to estimate the parameters of a phylo-HMM by EM.
    Can be used with or without the indel model, and for estimation of
@@ -41,6 +41,8 @@ struct phyloP_struct {
   char *subtree_name, *chrom;
   List *branch_name;
   GFF_Set *feats;
+  GFF_CompactSet *feats_compact; /* alternative to feats for large
+                                    feature sets (SPH only) */
   method_type method;
   mode_type mode;
   FILE *outfile, *logf;
@@ -50,6 +52,8 @@ struct phyloP_struct {
   char *help, *mod_fname, *msa_fname;
   ListOfLists *results;
   int no_prune;
+  int nthreads;
+  char *bigwig_fname;
 };
 
 struct phyloP_struct *phyloP_struct_new(int rphast);
@@ -15,6 +15,7 @@
 #define PHYLO_P_PRINT_H
 
 #include <list_of_lists.h>
+#include <wig.h>
 
 void print_prior_only(FILE *outfile, int nsites, char *mod_fname, 
 		      Vector *prior_distrib, ListOfLists *result);
@@ -44,11 +45,15 @@ void print_p_joint(FILE *outfile, char *node_name, char *mod_fname,
 void print_feats_sph(FILE *outfile, p_value_stats *stats, GFF_Set *gff, 
                      mode_type mode, double epsilon, int output_gff,
 		     ListOfLists *result);
+void print_feats_sph_compact(FILE *outfile, p_value_stats *stats, 
+                             GFF_CompactSet *gff, mode_type mode, 
+                             double epsilon, int output_gff, 
+                             ListOfLists *result);
 void print_feats_sph_subtree(FILE *outfile, p_value_joint_stats *stats, 
 			     GFF_Set *gff, mode_type mode, double epsilon, 
 			     int output_gff, ListOfLists *result);
 void print_quantiles(FILE *outfile, Vector *distrib, ListOfLists *result);
-void print_wig(FILE *outfile, MSA *msa, double *tuple_pvals, char *chrom, 
+void print_wig(WigWriter *wig, MSA *msa, double *tuple_pvals, char *chrom, 
 	       int refidx, int log_trans, ListOfLists *result);
 void print_base_by_base(FILE *outfile, char *header, char *chrom, MSA *msa, 
                         char **formatstr, int refidx, ListOfLists *result,
@@ -56,7 +61,13 @@ void print_base_by_base(FILE *outfile, char *header, char *chrom, MSA *msa,
 void print_feats_generic(FILE *outfile, char *header, GFF_Set *gff, 
 			 char **formatstr, ListOfLists *result, 
 			 int log_trans_outfile, int log_trans_results, int ncols, ...);
+void print_feats_generic_compact(FILE *outfile, char *header, 
+                                 GFF_CompactSet *gff, char **formatstr, 
+                                 ListOfLists *result, int log_trans_outfile,
+                                 int log_trans_results, int ncols, ...);
 void print_gff_scores(FILE *outfile, GFF_Set *gff, double *pvals, 
 		      int log_trans);
+void print_gff_scores_compact(FILE *outfile, GFF_CompactSet *gff, 
+                              double *pvals, int log_trans);
 
 #endif
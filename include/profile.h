@@ -0,0 +1,116 @@
+/***************************************************************************
+ * PHAST: PHylogenetic Analysis with Space/Time models
+ * Copyright (c) 2002-2005 University of California, 2006-2010 Cornell
+ * University.  All rights reserved.
+ *
+ * This source code is distributed under a BSD-style license.  See the
+ * file LICENSE.txt for details.
+ ***************************************************************************/
+
+/** @file profile.h
+   Lightweight timers and counters for the main computational stages
+   (alignment parsing, sufficient statistics, substitution matrices,
+   emissions, forward/backward, optimization, etc.).
+
+   Library routines mark the beginning and end of each stage:
+   @code
+   PROF_BEGIN(PROF_FORWARD);
+   ...
+   PROF_END(PROF_FORWARD, seqlen);
+   @endcode
+   PROF_BEGIN declares a local variable, so it can be used at most once
+   per stage in a block, and PROF_END must be reached on every path out
+   of the block.  Nothing is recorded unless profiling has been turned
+   on with prof_enable (e.g., by the --profile option of the main
+   programs), in which case each stage accumulates the number of calls,
+   the elapsed wall-clock time, and an amount of work (in
+   stage-specific units).  Nested calls of the same stage (e.g., a
+   routine that calls itself) are counted once, at the outermost
+   level.  Different stages may be nested, so their times need not add
+   up to the total.  Times of stages run in parallel threads are
+   summed over threads.
+
+   If PHAST is compiled with -DPHAST_NO_PROFILE (see make-include.mk),
+   the macros expand to nothing and the instrumentation has no cost
+   at all.  Otherwise its cost when profiling is off is one test of a
+   global flag per stage.
+   @ingroup base
+*/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+
+/** Instrumented stages */
+typedef enum {
+  PROF_MAF_READ,                /**< Reading MAF files */
+  PROF_SS_READ,                 /**< Reading files in SS format */
+  PROF_SS_BUILD,                /**< Building sufficient statistics
+                                   (ss_from_msas) */
+  PROF_PMATRIX,                 /**< Computing substitution probability
+                                   matrices (tm_set_subst_matrices) */
+  PROF_LIKELIHOOD,              /**< Tree-model likelihoods
+                                   (tl_compute_log_likelihood) */
+  PROF_EMISSIONS,               /**< Phylo-HMM emissions
+                                   (phmm_compute_emissions) */
+  PROF_FORWARD,                 /**< HMM forward algorithm */
+  PROF_BACKWARD,                /**< HMM backward algorithm */
+  PROF_VITERBI,                 /**< HMM Viterbi algorithm */
+  PROF_SUBST_DISTRIB,           /**< Posterior distributions of numbers
+                                   of substitutions (phyloP) */
+  PROF_EM,                      /**< EM training (HMMs and tree
+                                   models) */
+  PROF_BFGS,                    /**< BFGS optimization */
+  PROF_OPT_1D,                  /**< One-dimensional optimization */
+  PROF_NSTAGES                  /**< Number of stages */
+} prof_stage;
+
+/** Whether profiling is on (use prof_enable to set) */
+extern int prof_enabled;
+
+/** Turn on profiling.  Counters are reset and the total elapsed time
+    is measured from this call. */
+void prof_enable();
+
+/** Begin a stage (called by PROF_BEGIN).
+    @param stage Stage
+    @result Start time in seconds, or -1 if the stage is already in
+    progress in the calling thread
+ */
+double prof_begin(prof_stage stage);
+
+/** End a stage (called by PROF_END).
+    @param stage Stage
+    @param start Value returned by the matching call to prof_begin,
+    or -2 if profiling was off at the beginning of the stage (in which
+    case nothing is recorded)
+    @param units Amount of work done in this call
+ */
+void prof_end(prof_stage stage, double start, double units);
+
+/** Print a table of calls, times, and work per stage, followed by the
+    total elapsed and CPU times and the peak resident set size of the
+    process.
+    @param F File to print to
+ */
+void prof_print(FILE *F);
+
+/** Peak resident set size of the process in bytes, or -1 if not
+    available on this platform */
+long prof_peak_rss();
+
+#ifdef PHAST_NO_PROFILE
+#define PROF_BEGIN(stage)
+#define PROF_END(stage, units)
+#else
+/** Begin timing a stage */
+#define PROF_BEGIN(stage) \
+  double prof_start_##stage = (prof_enabled ? prof_begin(stage) : -2)
+/** End timing a stage, crediting it with the given amount of work */
+#define PROF_END(stage, units) do {                                     \
+    if (prof_enabled) prof_end(stage, prof_start_##stage, (double)(units)); \
+  } while (0)
+#endif
+
+#endif
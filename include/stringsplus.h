@@ -145,6 +145,15 @@ void str_nappend_charstr(String *s, const char *charstr, int len);
   */
 void str_append_int(String *s, int i);
 
+/** Append a coordinate (phast_pos, a 64-bit integer; see misc.h) to
+    a String object.
+    @pre Destination String s must be initialized externally.  
+    @param s Destination string
+    @param i Coordinate to append as a string
+    @note All memory is copied. 
+  */
+void str_append_pos(String *s, int64_t i);
+
 /** Append a double to a String object.
     @pre Destination String s must be initialized externally.  
     @param s Destination string
@@ -548,6 +557,14 @@ int str_list_overlap(List *dest, List *src1, List *src2);
  */
 int str_as_int(String *s, int *i);
 
+/** Attempt to convert a String to a coordinate (phast_pos).
+   @param s String to convert to a coordinate
+   @param l Coordinate converted from string
+   @result 0 on success, 1 on failure, and 2 on partial success
+    (only a prefix of the string could be converted).
+ */
+int str_as_pos(String *s, int64_t *l);
+
 /** Attempt to convert a String to a double.  
    @param s String to convert to a double
    @param d Double converted from string
@@ -78,6 +78,9 @@ void sub_posterior_joint_stats_alignment(JumpProcess *jp, MSA *msa,
                                          double *mean_right, double *var_right);
 p_value_stats *sub_p_value_many(JumpProcess *jp, MSA *msa, List *feats, 
                                 double ci);
+p_value_stats *sub_p_value_many_ranges(JumpProcess *jp, MSA *msa, int nfeats,
+                                       phast_pos *starts, phast_pos *ends,
+                                       double ci);
 p_value_joint_stats* sub_p_value_joint_many(JumpProcess *jp, MSA *msa, 
                                             List *feats, double ci,
                                             int max_convolve_size,
@@ -59,6 +59,35 @@ typedef struct {
                                    source msas to those of pooled msa */
 } PooledMSA;
 
+/** Sliding window over an alignment with ordered sufficient
+    statistics.  The window is represented by its own alignment
+    object ('msa'), whose (unordered) sufficient statistics describe
+    the columns currently in the window.  When the window is moved,
+    the statistics are updated incrementally, by removing the columns
+    that have left the window and adding those that have entered it.
+    @note The column tuples of the window are shared with the source
+    alignment, which must not be modified or freed while the window
+    is in use.  The window alignment has no sequences.
+    @see ss_window_new, ss_window_set
+*/
+typedef struct {
+  MSA *source;                  /**< Source alignment */
+  MSA *msa;                     /**< Alignment representing current
+                                   window */
+  int *full_to_win;             /**< Mapping from tuple indices of
+                                   source to those of window (-1 if
+                                   absent) */
+  int *win_to_full;             /**< Mapping from tuple indices of
+                                   window to those of source */
+  int start, end;               /**< Current window is [start, end) in
+                                   columns of source */
+  int do_cats;                  /**< Whether category-specific counts
+                                   are maintained */
+  int order_by_appearance;      /**< Whether tuples are ordered by
+                                   first appearance in window rather
+                                   than by index in source */
+} SSWindow;
+
 /** \name Calculate (populate) Sufficient Statistics functions */
 
 /**  Calculate Sufficient Statistics for an MSA.
@@ -145,7 +174,7 @@ typedef struct {
 */
 void ss_from_msas(MSA *msa, int tuple_size, int store_order, 
                   List *cats_to_do, MSA *source_msa, 
-                  Hashtable *existing_hash, int idx_offset,
+                  Hashtable *existing_hash, phast_pos idx_offset,
 		  int non_overlapping);
 
 /** Pool multiple MSAs into a single object of type PooledMSA.  
@@ -298,7 +327,36 @@ MSA* ss_alt_msa(MSA *orig_msa, int new_tuple_size, int store_order,
    @note The new alignment will represent the interval [start_col, end_col).
 */
 MSA *ss_sub_alignment(MSA *msa, char **new_names, List *include_list, 
-                      int start_col, int end_col);
+                      phast_pos start_col, phast_pos end_col);
+
+/** Create a new (empty) sliding window over an alignment.
+   @param source Alignment with ordered sufficient statistics
+   @param order_by_appearance If TRUE, the tuples of the window are
+   kept in order of first appearance in the window, as with
+   ss_from_msas; otherwise they are kept in the order of the source
+   alignment, as with ss_sub_alignment
+   @result New window, initially containing no columns
+   @note Category-specific counts are maintained if source->categories
+   is non-NULL.  Columns whose tuple index is negative are ignored.
+*/
+SSWindow *ss_window_new(MSA *source, int order_by_appearance);
+
+/** Move a sliding window to a new interval of the source alignment.
+   Counts are updated only for the columns that enter or leave the
+   window; no column tuples are compared or copied.
+   @param win Sliding window
+   @param start_col First column of new window
+   @param end_col Column after last column of new window
+   @note The order of the tuples of win->msa does not depend on
+   previous positions of the window (see ss_window_new).
+   @note The new window will represent the interval [start_col, end_col).
+*/
+void ss_window_set(SSWindow *win, int start_col, int end_col);
+
+/** Free a sliding window (but not its source alignment).
+   @param win Sliding window to free
+*/
+void ss_window_free(SSWindow *win);
 
 /** \name Sufficient Statistics modification functions
 \{ */
@@ -420,7 +478,7 @@ void ss_make_ordered(MSA *msa);
    only missing data have been added to the msa yet or not
  */
 static PHAST_INLINE 
-void col_to_string(char *str, MSA *msa, int col, int tuple_size) {
+void col_to_string(char *str, MSA *msa, phast_pos col, int tuple_size) {
   int col_offset, j, pos = 0;
   for (j = 0; j < msa->nseqs; j++) 
     for (col_offset = -1 * (tuple_size-1); col_offset <= 0; col_offset++)
@@ -497,7 +555,7 @@ char ss_get_char_tuple(MSA *msa, int tupleidx, int seqidx,
   @result Base char from tuple in alignment
 */
 static PHAST_INLINE
-char ss_get_char_pos(MSA *msa, int position, int seqidx,
+char ss_get_char_pos(MSA *msa, phast_pos position, int seqidx,
                      int col_offset) {
   if (msa->ss->tuple_idx == NULL)
     die("ERROR ss_get_char_pos: msa->ss->tuple_idx is NULL\n");
@@ -0,0 +1,72 @@
+/***************************************************************************
+ * PHAST: PHylogenetic Analysis with Space/Time models
+ * Copyright (c) 2002-2005 University of California, 2006-2010 Cornell
+ * University.  All rights reserved.
+ *
+ * This source code is distributed under a BSD-style license.  See the
+ * file LICENSE.txt for details.
+ ***************************************************************************/
+
+/** @file thread_pool.h
+   Simple pool of worker threads for running independent jobs in parallel.
+
+   A pool is created once with a fixed number of threads and then used
+   for any number of calls to tp_run, each of which executes a batch
+   of jobs and returns when all of them have finished.  Jobs are handed
+   out dynamically, so they need not take equal time.  The calling
+   thread takes part in the work, so a pool with one thread simply
+   runs the jobs in order.
+
+   Threads are only used if PHAST was compiled with USE_PTHREADS (see
+   make-include.mk), and never in RPHAST or with the memory handler,
+   whose allocation lists are not thread safe.  Otherwise every pool
+   has a single thread and all functions below still work as
+   described.
+
+   Jobs must not share writable state except through their own
+   job-indexed slots of 'data'.  The 'thread' argument passed to each
+   job can be used to select per-thread scratch space.
+   @ingroup base
+*/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "external_libs.h"
+
+/** Function executed for each job of a batch.
+    @param data Pointer passed to tp_run
+    @param job Index of job, in [0, njobs)
+    @param thread Index of thread running the job, in [0, nthreads)
+ */
+typedef void (*tp_job_fn)(void *data, int job, int thread);
+
+/** Thread pool object (opaque) */
+typedef struct thread_pool_struct ThreadPool;
+
+/** Create a new thread pool.
+    @param nthreads Number of threads to use (including the calling
+    thread).  If nthreads <= 0, the number of online processors is used.
+    The value is silently reduced to 1 if threads are not supported.
+    @result Newly allocated thread pool
+ */
+ThreadPool *tp_new(int nthreads);
+
+/** Run a batch of jobs and wait for all of them to finish.
+    @param tp Thread pool
+    @param njobs Number of jobs
+    @param fn Function to call for each job
+    @param data Passed to each call of fn
+ */
+void tp_run(ThreadPool *tp, int njobs, tp_job_fn fn, void *data);
+
+/** Get the number of threads in a pool (always >= 1). */
+int tp_nthreads(ThreadPool *tp);
+
+/** Stop all worker threads and free the pool. */
+void tp_free(ThreadPool *tp);
+
+/** Number of processors available, or 1 if threads are not supported. */
+int tp_nprocessors();
+
+#endif
@@ -30,36 +30,43 @@
    associated with the edge that connects it to its parent), and
    column tuples in a "sufficient statistics" representation of the
    alignment (all quantities will be the same for all instances of a
-   column tuple). */
+   column tuple).
+
+   The per-tuple arrays (base_probs, subst_probs, expected_nsubst,
+   expected_nsubst_col) are each stored in a single contiguous block,
+   in node-major order: all values for one node are adjacent, and
+   within a node, values for one rate category and tuple are adjacent.
+   They should be accessed with the TP_* macros below. */
 struct tp_struct {
-  double ****base_probs;        /**< Posterior probability of each base
+  int nratecats;                /**< Number of rate categories */
+  int nstates;                  /**< Number of states (bases or tuples) */
+  int nnodes;                   /**< Number of nodes in tree */
+  int ntuples;                  /**< Number of column tuples */
+  double *base_probs;           /**< Posterior probability of each base
                                    given a node, a column
-                                   tuple, and a rate category.  
-					- First index is rate category
-					- Second is base
-					- Third is node
-					- Fourth is column tuple
-				 */
-  double *****subst_probs;      /**< Posterior probability of a
+                                   tuple, and a rate category.
+                                   Indexed by node, rate category,
+                                   column tuple, and base (see
+                                   TP_BASE_PROB) */
+  float *base_probs_f;          /**< Single-precision version of
+                                   base_probs, used instead of it if
+                                   non-NULL (see tl_new_tree_posteriors) */
+  double *subst_probs;          /**< Posterior probability of a
                                    substitution of each base for each
                                    other, given a branch, column
-                                   tuple, and rate category.  
-					- First index is rate category
-					- Second is original base
-					- Third is replacement base
-					- Fourth is branch
-					- Fifth is column tuple 
-				*/
-  double ***expected_nsubst;    /**< Expected number of substitutions for each
+                                   tuple, and rate category.
+                                   Indexed by branch, rate category,
+                                   column tuple, original base, and
+                                   replacement base (see TP_SUBST_PROB) */
+  double *expected_nsubst;      /**< Expected number of substitutions for each
                                    branch x column tuple, given a rate
                                    category (conditioned on rate
                                    category in case posterior
                                    probabilities of rate categories
                                    depend on an HMM or similar).
-                                   	- First index is rate category
-					- Second is branch 
-					- Third is column tuple 
-				*/ 
+                                   Indexed by branch, rate category,
+                                   and column tuple (see
+                                   TP_EXPECTED_NSUBST) */
   double ****expected_nsubst_tot; 
                                 /**< Total expected number of
                                    substitutions of each type along
@@ -80,16 +87,13 @@ struct tp_struct {
 					- Third is replacement base
 					- Fourth is branch 
  */
-  double *****expected_nsubst_col;
-                                /**< Expected number of substitutions of each
+  double *expected_nsubst_col;  /**< Expected number of substitutions of each
                                    type along each branch for each rate 
 				   category, for each tuple column.
-				   	- First index is rate category
-					- Second is branch 
-					- Third is tuple
-					- Fourth is original base
-					- Fifth is replacement base 
-				*/
+                                   Indexed by branch, rate category,
+                                   column tuple, original base, and
+                                   replacement base (see
+                                   TP_EXPECTED_NSUBST_COL) */
   double **rcat_probs;          /**< Posterior probability of each rate
                                    category for each column tuple.
                                     	- First index is rate category
@@ -102,6 +106,111 @@ struct tp_struct {
 typedef struct tp_struct TreePosteriors;
                                 /* see incomplete type in tree_model.h */
 
+/** Index of a (node, rate category, tuple) block in a per-tuple array
+    of a TreePosteriors object */
+#define TP_BLOCK(tp, rcat, node, tup) \
+  (((size_t)(node) * (tp)->nratecats + (rcat)) * (tp)->ntuples + (tup))
+
+/** Posterior probability of base 'i' at node 'node' for tuple 'tup'
+    and rate category 'rcat' (an rvalue; see TP_SET_BASE_PROB) */
+#define TP_BASE_PROB(tp, rcat, i, node, tup) \
+  ((tp)->base_probs_f != NULL ? \
+   (double)(tp)->base_probs_f[TP_BLOCK(tp, rcat, node, tup) * (tp)->nstates + (i)] : \
+   (tp)->base_probs[TP_BLOCK(tp, rcat, node, tup) * (tp)->nstates + (i)])
+
+/** Set posterior probability of base 'i' at node 'node' for tuple
+    'tup' and rate category 'rcat' */
+#define TP_SET_BASE_PROB(tp, rcat, i, node, tup, val) do { \
+    size_t tp_idx_ = TP_BLOCK(tp, rcat, node, tup) * (tp)->nstates + (i); \
+    if ((tp)->base_probs_f != NULL) (tp)->base_probs_f[tp_idx_] = (float)(val); \
+    else (tp)->base_probs[tp_idx_] = (val); \
+  } while (0)
+
+/** TRUE if base probabilities are allocated, in either precision */
+#define TP_HAS_BASE_PROBS(tp) \
+  ((tp)->base_probs != NULL || (tp)->base_probs_f != NULL)
+
+/** Posterior probability of a substitution of base 'j' for base 'i'
+    on the branch above 'node' (an lvalue) */
+#define TP_SUBST_PROB(tp, rcat, i, j, node, tup) \
+  ((tp)->subst_probs[(TP_BLOCK(tp, rcat, node, tup) * (tp)->nstates + (i)) * \
+                     (tp)->nstates + (j)])
+
+/** Expected number of substitutions on the branch above 'node' (an
+    lvalue) */
+#define TP_EXPECTED_NSUBST(tp, rcat, node, tup) \
+  ((tp)->expected_nsubst[TP_BLOCK(tp, rcat, node, tup)])
+
+/** Expected number of substitutions of base 'j' for base 'i' on the
+    branch above 'node' (an lvalue) */
+#define TP_EXPECTED_NSUBST_COL(tp, rcat, node, tup, i, j) \
+  ((tp)->expected_nsubst_col[(TP_BLOCK(tp, rcat, node, tup) * (tp)->nstates + (i)) * \
+                             (tp)->nstates + (j)])
+
+/** Maximum size in bytes of a partial-likelihood cache (see
+    tl_new_cache); larger caches are not created */
+#define TL_CACHE_MAX_BYTES 268435456
+
+/** Cache of per-tuple partial likelihoods, for repeated evaluation of
+   the likelihood of a model with respect to the same alignment (e.g.,
+   within an optimizer).  A snapshot of the substitution probability
+   matrices is kept along with the inside vectors of every node, for
+   every column tuple and rate category.  On each call to
+   tl_compute_log_likelihood, the matrices are compared with the
+   snapshot, and only the nodes above a changed branch are recomputed;
+   the partial likelihoods of all other nodes are reused.  Only used
+   when posterior probabilities are not required and conditional
+   probabilities are not in use (see tl_new_cache).
+*/
+struct tl_cache_struct {
+  MSA *msa;                     /**< Alignment for which partial
+                                   likelihoods are stored */
+  struct msa_ss_struct *ss;     /**< Sufficient statistics of msa at
+                                   time of creation */
+  int ntuples;                  /**< Number of column tuples */
+  int nnodes;                   /**< Number of nodes in tree */
+  int nstates;                  /**< Number of states in model */
+  int nratecats;                /**< Number of rate categories */
+  double *partials;             /**< Inside vectors, indexed by tuple,
+                                   node, state, and rate category (rate
+                                   categories are interleaved, so that
+                                   all are updated together; see
+                                   tl_compute_log_likelihood) */
+  double *P_snapshot;           /**< Substitution probabilities for
+                                   which partials were computed,
+                                   indexed by node, rate category,
+                                   and matrix element */
+  int *dirty;                   /**< Nodes that must be recomputed in
+                                   the current call, indexed by node id */
+  int *stamp;                   /**< Epoch at which each tuple was last
+                                   computed */
+  int epoch;                    /**< Incremented each time the
+                                   substitution matrices change */
+  int primed;                   /**< Whether P_snapshot is defined */
+  int *batch_tuples;            /**< With codon models, tuples in the
+                                   order in which they were batched
+                                   (see tl_compute_log_likelihood);
+                                   partials are then stored by batch,
+                                   rate category, node, tuple within
+                                   batch, and state (among the states
+                                   in 'active') */
+  int nbatch_tuples;            /**< Number of batched tuples */
+  int *active;                  /**< With codon models, states for
+                                   which partials are stored */
+  int nactive;                  /**< Number of such states */
+  struct tl_patterns_struct *patterns;
+                                /**< Distinct leaf patterns below
+                                   nodes of the tree, with their
+                                   inside vectors, and trees pruned
+                                   of missing data, for the tuples
+                                   last evaluated (NULL if not yet
+                                   computed; see
+                                   tl_compute_log_likelihood) */
+};
+
+typedef struct tl_cache_struct TreeLikCache;
+                                /* see incomplete type in tree_model.h */
+
 #define NULL_LOG_LIKELIHOOD 1   /** Safe value for null when dealing with
                                    log likelihoods (should always be <= 0) FIXME? */
 
@@ -121,6 +230,22 @@ void tl_dump_matrices(TreeModel *mod, double **inside_vals,
    If non-NULL each of its attributes must either be NULL or
    previously allocated to the required size. 
    @result Log likelihood of entire tree model specified
+   @note With codon models, when posterior probabilities are not
+   required, column tuples are processed in batches, so that pruning
+   reduces to products of dense matrices, and states that cannot
+   occur (stop codons with zero frequency) are left out.
+   @note With other models, when posterior probabilities are not
+   required and conditional probabilities are not in use, the inside
+   vectors of a node are computed once for each distinct pattern of
+   characters at the leaves below it, rather than once per tuple, at
+   nodes where patterns recur often enough to make this worthwhile.
+   In addition, subtrees in which all leaves are missing data are
+   skipped, and nodes left with a single child are bypassed using
+   products of substitution matrices.  Since the skipped factors are
+   equal to one only up to rounding error, results may differ in the
+   last digits.
+   @note Weight matrices (mod->tree == NULL) are scored by
+   tl_compute_log_likelihood_weight_matrix; post is ignored in this case.
 */
 double tl_compute_log_likelihood(TreeModel *mod, MSA *msa, 
                                  double *col_scores, 
@@ -128,6 +253,60 @@ double tl_compute_log_likelihood(TreeModel *mod, MSA *msa,
 				 int cat,
                                  TreePosteriors *post);
 
+/** Compute the likelihood of a weight matrix (a model without a
+   tree, possibly of higher order) with respect to an alignment.
+   Sequences are scored independently.  The score of every tuple of
+   character classes (alphabet characters, missing data, gaps, other
+   characters) is precomputed in a lookup table, and, if sufficient
+   statistics are available, the score of every distinct alignment
+   tuple is computed once and looked up for each column.
+   @param[in] mod Weight matrix (mod->tree must be NULL)
+   @param[in] msa Multiple Alignment
+   @param[out] col_scores (Optional) Log likelihood score per column
+   (zero for columns not in category cat)
+   @param[out] tuple_scores (Optional) Log likelihood score per
+   tuple; requires sufficient statistics
+   @param[in] cat Category to score, or -1 for all columns
+   @result Log likelihood (base 2), NEGINFTY if any column considered is
+   prohibited
+*/
+double tl_compute_log_likelihood_weight_matrix(TreeModel *mod, MSA *msa,
+                                               double *col_scores,
+                                               double *tuple_scores,
+                                               int cat);
+
+/** Create a partial-likelihood cache for a tree model and an
+   alignment.  Sufficient statistics must already be available for
+   the alignment.
+   @param mod Tree Model
+   @param msa Multiple Alignment
+   @result Newly allocated cache, or NULL if the model is not
+   eligible (weight matrix, or conditional probabilities in use) or
+   the cache would be larger than TL_CACHE_MAX_BYTES
+   @note The cache must be attached to the model (mod->lik_cache) to
+   be used; see tl_attach_cache
+*/
+TreeLikCache *tl_new_cache(TreeModel *mod, MSA *msa);
+
+/** Free a partial-likelihood cache
+   @param cache Cache to free
+ */
+void tl_free_cache(TreeLikCache *cache);
+
+/** Attach a partial-likelihood cache to a tree model for use with a
+   given alignment, unless one is already attached.
+   @param mod Tree Model
+   @param msa Multiple Alignment
+   @result TRUE if a new cache was attached, in which case the caller
+   should call tl_detach_cache when done; FALSE otherwise
+*/
+int tl_attach_cache(TreeModel *mod, MSA *msa);
+
+/** Free and detach the partial-likelihood cache of a tree model, if any
+   @param mod Tree Model
+*/
+void tl_detach_cache(TreeModel *mod);
+
 /** Create a new TreePosteriors object.
     @param mod Tree Model of which the posterior probabilities are calculated
     @param msa Multiple Alignment
@@ -138,13 +317,16 @@ double tl_compute_log_likelihood(TreeModel *mod, MSA *msa,
     @param do_expected_nsubst_col Whether to allocate space for expected number of substitutions per column
     @param do_rate_cats Whether to allocate space for rate categories
     @param do_rate_cats_exp Whether to allocate space for expected rate categories
+    @param float_bases Whether to store base probabilities in single
+    precision (halves their memory; ignored if !do_bases)
     @result Newly allocated TreePosteriors object
 */
 TreePosteriors *tl_new_tree_posteriors(TreeModel *mod, MSA *msa, int do_bases, 
                                        int do_substs, int do_expected_nsubst, 
                                        int do_expected_nsubst_tot,
 				       int do_expected_nsubst_col,
-                                       int do_rate_cats, int do_rate_cats_exp);
+                                       int do_rate_cats, int do_rate_cats_exp,
+                                       int float_bases);
 
 /** Free TreePosteriors object
    @param mod Tree model of which posterior are calculated
@@ -84,6 +84,7 @@ typedef enum {
 } scale_bound_type; 
 
 struct tp_struct;
+struct tl_cache_struct;
 
 
 /** Defines alternative substitution model for a particular branch */
@@ -219,6 +220,11 @@ struct tm_struct {
 				 Normally 0, but 1 if TM_BRANCHLENS_NONE, or
 				 if TM_SCALE and alt_subst_mods!=NULL */
   int **iupac_inv_map;          /**< Inverse map for IUPAC ambiguity characters */
+  struct tl_cache_struct *lik_cache;
+                                /**< (Optional) cache of per-tuple
+                                   partial likelihoods, used by
+                                   tl_compute_log_likelihood when
+                                   non-NULL (see tl_attach_cache) */
 };
 
 typedef struct tm_struct TreeModel;
@@ -19,6 +19,26 @@
 #define WIG_H
 
 #include <gff.h>
+#include <bigwig.h>
+
+/** Size of the output buffer of a WigWriter */
+#define WIG_BUFSIZE 65536
+
+/** Writer for base-by-base scores in fixedStep wig or bigWig format.
+    Text output is formatted with wig_format_fixed and buffered; a new
+    fixedStep header is started whenever the chromosome changes or a
+    position does not follow the previous one. */
+typedef struct {
+  FILE *F;			/**< Text output stream, or NULL */
+  BigWig *bw;			/**< bigWig output, or NULL */
+  int digits;			/**< Digits after the decimal point in
+				   text output */
+  String *chrom;		/**< Chromosome of current fixedStep block */
+  phast_pos next;		/**< Position that would continue the
+				   current fixedStep block (-1 if none) */
+  char *buf;			/**< Output buffer for text */
+  int len;			/**< Number of characters in buf */
+} WigWriter;
 
 
 /** Check if a string is a wig file header and parse the arguments.
@@ -35,7 +55,7 @@
       be set if line is not a wig header.
     @return 1 if line is a wig header, 0 otherwise.  None 
  */
-int wig_parse_header(String *line, int *fixed, char *chrom, int *start, int *step, int *span);
+int wig_parse_header(String *line, int *fixed, char *chrom, phast_pos *start, int *step, int *span);
 
 /** Read a wig file and store as a GFF.  Can read either fixed or variable wig files.
   @param F wig file to read
@@ -52,5 +72,55 @@ GFF_Set *gff_read_wig(FILE *F);
  */
 void wig_print(FILE *outfile, GFF_Set *set);
 
+/** Format a number with a fixed number of digits after the decimal
+    point.  Produces exactly the same characters as printf("%.*f"),
+    but much faster for the moderate values typical of conservation
+    scores (other values are passed to snprintf).
+  @param buf Buffer to write to (not null-terminated)
+  @param size Size of buf
+  @param val Value to format
+  @param digits Digits after the decimal point
+  @return Number of characters written, or, if buf is too small, the
+  number that would have been written (as with snprintf)
+ */
+int wig_format_fixed(char *buf, int size, double val, int digits);
+
+/** Create a writer of fixedStep wig text.
+  @param F Output stream
+  @param digits Digits after the decimal point in scores
+  @return Newly allocated WigWriter
+ */
+WigWriter *wig_writer_new(FILE *F, int digits);
+
+/** Create a writer of a bigWig file.
+  @param fname Name of file to create
+  @return Newly allocated WigWriter
+ */
+WigWriter *wig_writer_new_bigwig(const char *fname);
+
+/** Write the score of a single base.
+  @param w WigWriter
+  @param chrom Chromosome name
+  @param pos Position (1-based); must be increasing within a
+  chromosome for bigWig output
+  @param val Score
+ */
+void wig_writer_add(WigWriter *w, const char *chrom, phast_pos pos,
+		    double val);
+
+/** Set the size of a chromosome.  Used for the chromosome index of
+    bigWig output (see bw_set_chrom_size); ignored for text output.
+  @param w WigWriter
+  @param chrom Chromosome name
+  @param size Length of chromosome
+ */
+void wig_writer_set_chrom_size(WigWriter *w, const char *chrom,
+			       phast_pos size);
+
+/** Flush any buffered output (finishing the file for bigWig output)
+    and free a WigWriter.  Does not close text output streams.
+ */
+void wig_writer_free(WigWriter *w);
+
 #endif
 
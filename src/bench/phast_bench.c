@@ -0,0 +1,689 @@
+/***************************************************************************
+ * PHAST: PHylogenetic Analysis with Space/Time models
+ * Copyright (c) 2002-2005 University of California, 2006-2010 Cornell
+ * University.  All rights reserved.
+ *
+ * This source code is distributed under a BSD-style license.  See the
+ * file LICENSE.txt for details.
+ ***************************************************************************/
+
+/* Benchmarks of core kernels and end-to-end runs on synthetic data.
+   See phast_bench.help_src for a description.  Each benchmark
+   generates its own data from a fixed seed (so selecting a subset of
+   benchmarks with --only does not change the data seen by the
+   others), runs each case once untimed, then --reps times timed, and
+   records the results, which are printed at the end in CSV or JSON. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <sys/time.h>
+#include <misc.h>
+#include <lists.h>
+#include <stringsplus.h>
+#include <msa.h>
+#include <maf.h>
+#include <sufficient_stats.h>
+#include <tree_model.h>
+#include <tree_likelihoods.h>
+#include <markov_matrix.h>
+#include <prob_vector.h>
+#include <hmm.h>
+#include <phast_cons.h>
+#include <phylo_p.h>
+#include "phast_bench.help"
+
+/* nucleotide background used for all models other than JC69 */
+static double bench_backgd[4] = {0.3, 0.2, 0.2, 0.3};
+
+/* exchangeabilities for REV, in the order AC, AG, AT, CG, CT, GT */
+static double bench_rev_exch[6] = {1.0, 4.0, 0.8, 1.1, 3.8, 1.0};
+
+/* kappa used for HKY85 */
+#define BENCH_KAPPA 4.0
+
+typedef enum {CSV_FORMAT, JSON_FORMAT} bench_format_type;
+
+/* options and accumulated results for a benchmark run */
+typedef struct {
+  int nreps;
+  double scale;
+  int seed;
+  char *only;
+  int quiet;
+  List *results;                /* list of BenchResult* */
+} BenchRun;
+
+/* timings for one benchmark case */
+typedef struct {
+  char *benchmark;
+  char *params;
+  char *status;                 /* "ok" or "skipped" */
+  int nreps;
+  double min, median, mean;     /* wall-clock seconds per run */
+  double units;                 /* amount of work per run */
+  char *unit_name;
+} BenchResult;
+
+/* return TRUE if benchmark should be run */
+static int bench_selected(BenchRun *br, const char *name) {
+  return (br->only == NULL || strstr(name, br->only) != NULL);
+}
+
+/* scale a problem size, keeping it at least minval */
+static int bench_size(BenchRun *br, int size, int minval) {
+  int retval = (int)(size * br->scale);
+  return retval < minval ? minval : retval;
+}
+
+static int bench_dbl_compare(const void *ptr1, const void *ptr2) {
+  double d1 = *(double*)ptr1, d2 = *(double*)ptr2;
+  return (d1 > d2) - (d1 < d2);
+}
+
+/* announce start of a benchmark case */
+static void bench_start(BenchRun *br, const char *name, const char *params) {
+  if (!br->quiet)
+    fprintf(stderr, "Running %s (%s)...\n", name, params);
+}
+
+/* record timings of a benchmark case.  Times are in seconds; times
+   will be sorted */
+static void bench_record(BenchRun *br, const char *name, const char *params,
+                         double *times, double units, const char *unit_name) {
+  BenchResult *r = smalloc(sizeof(BenchResult));
+  int i;
+  r->benchmark = copy_charstr(name);
+  r->params = copy_charstr(params);
+  r->status = copy_charstr(times == NULL ? "skipped" : "ok");
+  r->units = units;
+  r->unit_name = copy_charstr(unit_name);
+  r->nreps = times == NULL ? 0 : br->nreps;
+  r->min = r->median = r->mean = 0;
+  if (times != NULL) {
+    qsort(times, br->nreps, sizeof(double), bench_dbl_compare);
+    r->min = times[0];
+    r->median = br->nreps % 2 == 1 ? times[br->nreps/2] :
+      (times[br->nreps/2 - 1] + times[br->nreps/2]) / 2;
+    for (i = 0; i < br->nreps; i++) r->mean += times[i];
+    r->mean /= br->nreps;
+  }
+  lst_push_ptr(br->results, r);
+}
+
+static void bench_print_csv(FILE *F, BenchRun *br) {
+  int i;
+  fprintf(F, "benchmark,params,status,reps,min_sec,median_sec,mean_sec,units,unit_name,units_per_sec\n");
+  for (i = 0; i < lst_size(br->results); i++) {
+    BenchResult *r = lst_get_ptr(br->results, i);
+    fprintf(F, "%s,%s,%s,%d,%.6f,%.6f,%.6f,%.0f,%s,%.6g\n", r->benchmark,
+            r->params, r->status, r->nreps, r->min, r->median, r->mean,
+            r->units, r->unit_name,
+            r->median > 0 ? r->units / r->median : 0);
+  }
+}
+
+static void bench_print_json(FILE *F, BenchRun *br) {
+  int i;
+  fprintf(F, "{\n  \"program\": \"phast_bench\",\n  \"version\": \"%s\",\n",
+          PHAST_VERSION);
+#ifdef SKIP_LAPACK
+  fprintf(F, "  \"lapack\": false,\n");
+#else
+  fprintf(F, "  \"lapack\": true,\n");
+#endif
+  fprintf(F, "  \"seed\": %d,\n  \"reps\": %d,\n  \"scale\": %g,\n",
+          br->seed, br->nreps, br->scale);
+  fprintf(F, "  \"results\": [");
+  for (i = 0; i < lst_size(br->results); i++) {
+    BenchResult *r = lst_get_ptr(br->results, i);
+    fprintf(F, "%s\n    {\"benchmark\": \"%s\", \"params\": \"%s\", \"status\": \"%s\", \"reps\": %d, \"min_sec\": %.6f, \"median_sec\": %.6f, \"mean_sec\": %.6f, \"units\": %.0f, \"unit_name\": \"%s\", \"units_per_sec\": %.6g}",
+            i == 0 ? "" : ",", r->benchmark, r->params, r->status, r->nreps,
+            r->min, r->median, r->mean, r->units, r->unit_name,
+            r->median > 0 ? r->units / r->median : 0);
+  }
+  fprintf(F, "\n  ]\n}\n");
+}
+
+/* append Newick string for a balanced tree with leaves s<first+1>
+   .. s<first+n> to s */
+static void bench_tree_append(String *s, int first, int n, int is_root) {
+  if (n == 1) {
+    str_append_char(s, 's');
+    str_append_int(s, first + 1);
+  }
+  else {
+    str_append_char(s, '(');
+    bench_tree_append(s, first, n/2, FALSE);
+    str_append_char(s, ',');
+    bench_tree_append(s, first + n/2, n - n/2, FALSE);
+    str_append_char(s, ')');
+  }
+  if (!is_root) str_append_charstr(s, ":0.1");
+}
+
+/* returns TRUE if model can be used in this build (models other than
+   JC69 and F81 require matrix diagonalization) */
+static int bench_model_available(const char *subst_mod) {
+#ifdef SKIP_LAPACK
+  return (!strcmp(subst_mod, "JC69") || !strcmp(subst_mod, "F81"));
+#else
+  return TRUE;
+#endif
+}
+
+/* create a nucleotide tree model for a balanced tree with the given
+   number of leaves.  The model is written in the .mod format and read
+   back, as if from a file */
+static TreeModel *bench_model(int nleaves, const char *subst_mod,
+                              int nratecats) {
+  FILE *F = tmpfile();
+  String *tree = str_new(STR_MED_LEN);
+  double pi[4], Q[4][4], exch, scale = 0;
+  int is_jc = !strcmp(subst_mod, "JC69"), i, j;
+  TreeModel *mod;
+
+  if (F == NULL) die("ERROR: cannot create temporary file.\n");
+
+  for (i = 0; i < 4; i++) pi[i] = is_jc ? 0.25 : bench_backgd[i];
+
+  /* general reversible rate matrix, normalized to one expected
+     substitution per unit time */
+  for (i = 0; i < 4; i++) {
+    Q[i][i] = 0;
+    for (j = 0; j < 4; j++) {
+      if (i == j) continue;
+      if (!strcmp(subst_mod, "HKY85"))
+        exch = ((i == 0 && j == 2) || (i == 2 && j == 0) ||
+                (i == 1 && j == 3) || (i == 3 && j == 1)) ? BENCH_KAPPA : 1;
+      else if (!strcmp(subst_mod, "REV"))
+        exch = bench_rev_exch[i < j ? (i == 0 ? j-1 : i+j) :
+                              (j == 0 ? i-1 : i+j)];
+      else exch = 1;
+      Q[i][j] = exch * pi[j];
+      Q[i][i] -= Q[i][j];
+    }
+    scale -= pi[i] * Q[i][i];
+  }
+
+  bench_tree_append(tree, 0, nleaves, TRUE);
+
+  fprintf(F, "ALPHABET: A C G T \nORDER: 0\nSUBST_MOD: %s\n", subst_mod);
+  if (nratecats > 1)
+    fprintf(F, "NRATECATS: %d\nALPHA: 0.5\n", nratecats);
+  fprintf(F, "BACKGROUND:");
+  for (i = 0; i < 4; i++) fprintf(F, " %f", pi[i]);
+  fprintf(F, "\nRATE_MAT:\n");
+  for (i = 0; i < 4; i++) {
+    for (j = 0; j < 4; j++) fprintf(F, " %f", Q[i][j] / scale);
+    fprintf(F, "\n");
+  }
+  fprintf(F, "TREE: %s;\n", tree->chars);
+  rewind(F);
+
+  mod = tm_new_from_file(F, 1);
+  fclose(F);
+  str_free(tree);
+  return mod;
+}
+
+/* generate an alignment of the given length under mod */
+static MSA *bench_msa(TreeModel *mod, int ncols) {
+  return tm_generate_msa(ncols, NULL, &mod, NULL);
+}
+
+/* create an HMM with the given number of states and random, dense
+   transition probabilities */
+static HMM *bench_hmm(int nstates) {
+  MarkovMatrix *mm = mm_new(nstates, NULL, DISCRETE);
+  int i, j;
+  double sum;
+  for (i = 0; i < nstates; i++) {
+    sum = 0;
+    for (j = 0; j < nstates; j++) {
+      mm_set(mm, i, j, 0.01 + unif_rand() + (i == j ? nstates : 0));
+      sum += mm_get(mm, i, j);
+    }
+    for (j = 0; j < nstates; j++)
+      mm_set(mm, i, j, mm_get(mm, i, j) / sum);
+  }
+  return hmm_new(mm, NULL, NULL, NULL);
+}
+
+static void bench_likelihood(BenchRun *br) {
+  static char *mods[] = {"JC69", "F81", "HKY85", "REV"};
+  static int nleaves[] = {4, 16, 64};
+  int m, n, g, rep, ncols = bench_size(br, 100000, 1000);
+  double *times = smalloc(br->nreps * sizeof(double));
+  char params[STR_MED_LEN];
+  struct timeval start;
+
+  for (n = 0; n < 3; n++) {
+    for (m = 0; m < 4; m++) {
+      for (g = 1; g <= 4; g += 3) {
+        TreeModel *mod;
+        MSA *msa;
+        double units;
+
+        sprintf(params, "nleaves=%d;model=%s;ratecats=%d;ncols=%d",
+                nleaves[n], mods[m], g, ncols);
+        if (!bench_model_available(mods[m])) {
+          bench_record(br, "tl_compute_log_likelihood", params, NULL, 0,
+                       "tuple_nodes");
+          continue;
+        }
+        bench_start(br, "tl_compute_log_likelihood", params);
+
+        set_seed(br->seed);
+        mod = bench_model(nleaves[n], mods[m], g);
+        msa = bench_msa(mod, ncols);
+        ss_from_msas(msa, 1, FALSE, NULL, NULL, NULL, -1, 0);
+        units = (double)msa->ss->ntuples * mod->tree->nnodes * g;
+
+        tl_compute_log_likelihood(mod, msa, NULL, NULL, -1, NULL);
+        for (rep = 0; rep < br->nreps; rep++) {
+          gettimeofday(&start, NULL);
+          tl_compute_log_likelihood(mod, msa, NULL, NULL, -1, NULL);
+          times[rep] = get_elapsed_time(&start);
+        }
+        bench_record(br, "tl_compute_log_likelihood", params, times, units,
+                     "tuple_nodes");
+        msa_free(msa);
+        tm_free(mod);
+      }
+    }
+  }
+  sfree(times);
+}
+
+static void bench_hmm_dp(BenchRun *br) {
+  static int nstates[] = {2, 10, 50};
+  static int lens[] = {5000, 20000};
+  int s, l, i, j, rep, len, do_forward = bench_selected(br, "hmm_forward"),
+    do_viterbi = bench_selected(br, "hmm_viterbi");
+  double *times = smalloc(br->nreps * sizeof(double));
+  char params[STR_MED_LEN];
+  struct timeval start;
+
+  for (s = 0; s < 3; s++) {
+    for (l = 0; l < 2; l++) {
+      HMM *hmm;
+      double **emissions, **fwd;
+      int *path;
+
+      len = bench_size(br, lens[l], 100);
+      sprintf(params, "nstates=%d;len=%d", nstates[s], len);
+
+      set_seed(br->seed);
+      hmm = bench_hmm(nstates[s]);
+      emissions = smalloc(nstates[s] * sizeof(double*));
+      fwd = smalloc(nstates[s] * sizeof(double*));
+      for (i = 0; i < nstates[s]; i++) {
+        emissions[i] = smalloc(len * sizeof(double));
+        fwd[i] = smalloc(len * sizeof(double));
+        for (j = 0; j < len; j++)
+          emissions[i][j] = log(0.01 + unif_rand());
+      }
+      path = smalloc(len * sizeof(int));
+
+      if (do_forward) {
+        bench_start(br, "hmm_forward", params);
+        hmm_forward(hmm, emissions, len, fwd);
+        for (rep = 0; rep < br->nreps; rep++) {
+          gettimeofday(&start, NULL);
+          hmm_forward(hmm, emissions, len, fwd);
+          times[rep] = get_elapsed_time(&start);
+        }
+        bench_record(br, "hmm_forward", params, times,
+                     (double)len * nstates[s] * nstates[s], "transitions");
+      }
+      if (do_viterbi) {
+        bench_start(br, "hmm_viterbi", params);
+        hmm_viterbi(hmm, emissions, len, path);
+        for (rep = 0; rep < br->nreps; rep++) {
+          gettimeofday(&start, NULL);
+          hmm_viterbi(hmm, emissions, len, path);
+          times[rep] = get_elapsed_time(&start);
+        }
+        bench_record(br, "hmm_viterbi", params, times,
+                     (double)len * nstates[s] * nstates[s], "transitions");
+      }
+
+      for (i = 0; i < nstates[s]; i++) {
+        sfree(emissions[i]);
+        sfree(fwd[i]);
+      }
+      sfree(emissions);
+      sfree(fwd);
+      sfree(path);
+      hmm_free(hmm);
+    }
+  }
+  sfree(times);
+}
+
+static void bench_ss(BenchRun *br) {
+  static int tuple_sizes[] = {1, 1, 3};
+  static int store_order[] = {FALSE, TRUE, TRUE};
+  int c, rep, ncols = bench_size(br, 1000000, 1000);
+  double *times = smalloc(br->nreps * sizeof(double));
+  char params[STR_MED_LEN];
+  struct timeval start;
+  TreeModel *mod;
+  MSA *msa;
+
+  set_seed(br->seed);
+  mod = bench_model(8, "JC69", 1);
+  msa = bench_msa(mod, ncols);
+
+  for (c = 0; c < 3; c++) {
+    sprintf(params, "nseqs=8;ncols=%d;tuple_size=%d;store_order=%d", ncols,
+            tuple_sizes[c], store_order[c]);
+    bench_start(br, "ss_from_msas", params);
+    for (rep = -1; rep < br->nreps; rep++) {
+      MSA *copy = msa_create_copy(msa, FALSE);
+      gettimeofday(&start, NULL);
+      ss_from_msas(copy, tuple_sizes[c], store_order[c], NULL, NULL, NULL,
+                   -1, 0);
+      if (rep >= 0) times[rep] = get_elapsed_time(&start);
+      msa_free(copy);
+    }
+    bench_record(br, "ss_from_msas", params, times, ncols, "columns");
+  }
+  msa_free(msa);
+  tm_free(mod);
+  sfree(times);
+}
+
+static void bench_maf(BenchRun *br) {
+  int i, j, k, rep, ncols = bench_size(br, 200000, 1000), blocklen = 1000;
+  double *times = smalloc(br->nreps * sizeof(double));
+  char params[STR_MED_LEN];
+  struct timeval start;
+  TreeModel *mod;
+  MSA *msa;
+  FILE *F = tmpfile();
+
+  if (F == NULL) die("ERROR: cannot create temporary file.\n");
+
+  set_seed(br->seed);
+  mod = bench_model(8, "JC69", 1);
+  msa = bench_msa(mod, ncols);
+
+  /* write alignment as a MAF with fixed-length blocks */
+  fprintf(F, "##maf version=1\n");
+  for (j = 0; j < ncols; j += blocklen) {
+    int len = min(blocklen, ncols - j);
+    fprintf(F, "a score=0.0\n");
+    for (i = 0; i < msa->nseqs; i++) {
+      fprintf(F, "s %s.chr1 %d %d + %d ", msa->names[i], j, len, ncols);
+      for (k = 0; k < len; k++) fputc(msa->seqs[i][j+k], F);
+      fputc('\n', F);
+    }
+    fputc('\n', F);
+  }
+
+  sprintf(params, "nseqs=8;ncols=%d;blocklen=%d;store_order=1", ncols,
+          blocklen);
+  bench_start(br, "maf_read", params);
+  for (rep = -1; rep < br->nreps; rep++) {
+    MSA *m;
+    rewind(F);
+    gettimeofday(&start, NULL);
+    m = maf_read(F, NULL, 1, NULL, NULL, NULL, -1, TRUE, NULL, NO_STRIP,
+                 FALSE);
+    if (rep >= 0) times[rep] = get_elapsed_time(&start);
+    msa_free(m);
+  }
+  bench_record(br, "maf_read", params, times, ncols, "columns");
+
+  fclose(F);
+  msa_free(msa);
+  tm_free(mod);
+  sfree(times);
+}
+
+static void bench_mm_exp(BenchRun *br) {
+  static int sizes[] = {4, 20, 64};
+  int s, nexp = bench_size(br, 1000, 10);
+  double *times = smalloc(br->nreps * sizeof(double));
+  char params[STR_MED_LEN];
+
+  for (s = 0; s < 3; s++) {
+    sprintf(params, "size=%d;nexp=%d", sizes[s], nexp);
+#ifdef SKIP_LAPACK
+    bench_record(br, "mm_exp", params, NULL, 0, "exponentiations");
+#else
+    {
+      int n = sizes[s], i, j, k, rep;
+      MarkovMatrix *Q = mm_new(n, NULL, CONTINUOUS),
+        *P = mm_new(n, NULL, DISCRETE);
+      double *pi = smalloc(n * sizeof(double)), sum = 0, exch;
+      struct timeval start;
+
+      bench_start(br, "mm_exp", params);
+
+      /* random reversible rate matrix */
+      set_seed(br->seed);
+      for (i = 0; i < n; i++) sum += (pi[i] = 0.5 + unif_rand());
+      for (i = 0; i < n; i++) pi[i] /= sum;
+      for (i = 0; i < n; i++) mm_set(Q, i, i, 0);
+      for (i = 0; i < n; i++) {
+        for (j = i+1; j < n; j++) {
+          exch = 0.1 + unif_rand();
+          mm_set(Q, i, j, exch * pi[j]);
+          mm_set(Q, j, i, exch * pi[i]);
+          mm_set(Q, i, i, mm_get(Q, i, i) - exch * pi[j]);
+          mm_set(Q, j, j, mm_get(Q, j, j) - exch * pi[i]);
+        }
+      }
+      mm_diagonalize(Q);
+
+      for (rep = -1; rep < br->nreps; rep++) {
+        gettimeofday(&start, NULL);
+        for (k = 0; k < nexp; k++)
+          mm_exp(P, Q, 0.001 + 2.0 * k / nexp);
+        if (rep >= 0) times[rep] = get_elapsed_time(&start);
+      }
+      bench_record(br, "mm_exp", params, times, nexp, "exponentiations");
+      mm_free(Q);
+      mm_free(P);
+      sfree(pi);
+    }
+#endif
+  }
+  sfree(times);
+}
+
+static void bench_convolve(BenchRun *br) {
+  static int ns[] = {10, 100, 1000};
+  int c, i, rep, n, size = 21;
+  double *times = smalloc(br->nreps * sizeof(double));
+  char params[STR_MED_LEN];
+  struct timeval start;
+  Vector *p = vec_new(size);
+
+  /* discretized bell-shaped distribution */
+  for (i = 0; i < size; i++)
+    vec_set(p, i, exp(-0.5 * (i - 6.0) * (i - 6.0) / 4.0));
+  pv_normalize(p);
+
+  for (c = 0; c < 3; c++) {
+    n = bench_size(br, ns[c], 2);
+    sprintf(params, "size=%d;n=%d", size, n);
+    bench_start(br, "pv_convolve", params);
+    for (rep = -1; rep < br->nreps; rep++) {
+      Vector *q;
+      gettimeofday(&start, NULL);
+      q = pv_convolve(p, n, 1e-10);
+      if (rep >= 0) times[rep] = get_elapsed_time(&start);
+      vec_free(q);
+    }
+    bench_record(br, "pv_convolve", params, times, n, "convolutions");
+  }
+  vec_free(p);
+  sfree(times);
+}
+
+static void bench_phastCons(BenchRun *br) {
+  int rep, nleaves = 16, ncols = bench_size(br, 200000, 1000);
+  double *times = smalloc(br->nreps * sizeof(double));
+  char params[STR_MED_LEN];
+  struct timeval start;
+  FILE *devnull = phast_fopen("/dev/null", "w");
+  TreeModel *mod;
+  MSA *msa;
+
+  sprintf(params, "nleaves=%d;model=F81;ncols=%d", nleaves, ncols);
+  bench_start(br, "phastCons", params);
+
+  set_seed(br->seed);
+  mod = bench_model(nleaves, "F81", 1);
+  msa = bench_msa(mod, ncols);
+
+  for (rep = -1; rep < br->nreps; rep++) {
+    struct phastCons_struct *p = phastCons_struct_new(0);
+    p->msa = msa_create_copy(msa, FALSE);
+    p->nummod = 1;
+    p->mod = smalloc(sizeof(TreeModel*));
+    p->mod[0] = tm_create_copy(mod);
+    p->mod[0]->use_conditionals = 1;
+    p->post_probs_f = devnull;
+    p->results_f = NULL;
+    p->progress_f = NULL;
+    gettimeofday(&start, NULL);
+    phastCons(p);
+    if (rep >= 0) times[rep] = get_elapsed_time(&start);
+  }
+  bench_record(br, "phastCons", params, times, ncols, "columns");
+
+  phast_fclose(devnull);
+  msa_free(msa);
+  tm_free(mod);
+  sfree(times);
+}
+
+static void bench_phyloP(BenchRun *br) {
+  static char *method_names[] = {"SPH", "LRT"};
+  static method_type methods[] = {SPH, LRT};
+  int m, rep, nleaves = 8, ncols = bench_size(br, 10000, 100);
+  double *times = smalloc(br->nreps * sizeof(double));
+  char params[STR_MED_LEN];
+  struct timeval start;
+  FILE *devnull = phast_fopen("/dev/null", "w");
+  TreeModel *mod;
+  MSA *msa;
+
+  set_seed(br->seed);
+  mod = bench_model(nleaves, "F81", 1);
+  msa = bench_msa(mod, ncols);
+
+  for (m = 0; m < 2; m++) {
+    sprintf(params, "nleaves=%d;model=F81;ncols=%d;method=%s;wig=1", nleaves,
+            ncols, method_names[m]);
+    bench_start(br, "phyloP", params);
+    for (rep = -1; rep < br->nreps; rep++) {
+      struct phyloP_struct *p = phyloP_struct_new(0);
+      p->msa = msa_create_copy(msa, FALSE);
+      p->mod = tm_create_copy(mod);
+      p->method = methods[m];
+      p->base_by_base = TRUE;
+      p->output_wig = TRUE;
+      p->chrom = "bench";
+      p->outfile = devnull;
+      gettimeofday(&start, NULL);
+      phyloP(p);
+      if (rep >= 0) times[rep] = get_elapsed_time(&start);
+    }
+    bench_record(br, "phyloP", params, times, ncols, "columns");
+  }
+
+  phast_fclose(devnull);
+  msa_free(msa);
+  tm_free(mod);
+  sfree(times);
+}
+
+int main(int argc, char *argv[]) {
+  char c, *out_fname = NULL;
+  int opt_idx;
+  bench_format_type format = CSV_FORMAT;
+  BenchRun br;
+  FILE *outf = stdout;
+
+  struct option long_opts[] = {
+    {"format", 1, 0, 'f'},
+    {"output", 1, 0, 'o'},
+    {"reps", 1, 0, 'r'},
+    {"scale", 1, 0, 's'},
+    {"only", 1, 0, 'n'},
+    {"seed", 1, 0, 'd'},
+    {"quiet", 0, 0, 'q'},
+    {"help", 0, 0, 'h'},
+    {0, 0, 0, 0}
+  };
+
+  br.nreps = 5;
+  br.scale = 1;
+  br.seed = 1;
+  br.only = NULL;
+  br.quiet = FALSE;
+
+  while ((c = (char)getopt_long(argc, argv, "f:o:r:s:n:d:qh", long_opts, &opt_idx)) != -1) {
+    switch (c) {
+    case 'f':
+      if (!strcmp(optarg, "CSV") || !strcmp(optarg, "csv"))
+        format = CSV_FORMAT;
+      else if (!strcmp(optarg, "JSON") || !strcmp(optarg, "json"))
+        format = JSON_FORMAT;
+      else die("ERROR: --format must be CSV or JSON.\n");
+      break;
+    case 'o':
+      out_fname = optarg;
+      break;
+    case 'r':
+      br.nreps = get_arg_int_bounds(optarg, 1, INFTY);
+      break;
+    case 's':
+      br.scale = get_arg_dbl_bounds(optarg, 1e-6, INFTY);
+      break;
+    case 'n':
+      br.only = optarg;
+      break;
+    case 'd':
+      br.seed = get_arg_int_bounds(optarg, 1, INFTY);
+      break;
+    case 'q':
+      br.quiet = TRUE;
+      break;
+    case 'h':
+      printf("%s", HELP);
+      exit(0);
+    case '?':
+      die("Bad argument.  Try 'phast_bench -h'.\n");
+    }
+  }
+
+  if (optind != argc)
+    die("ERROR: phast_bench takes no arguments.  Try 'phast_bench -h'.\n");
+
+  br.results = lst_new_ptr(100);
+
+  if (bench_selected(&br, "tl_compute_log_likelihood")) bench_likelihood(&br);
+  if (bench_selected(&br, "hmm_forward") || bench_selected(&br, "hmm_viterbi"))
+    bench_hmm_dp(&br);
+  if (bench_selected(&br, "ss_from_msas")) bench_ss(&br);
+  if (bench_selected(&br, "maf_read")) bench_maf(&br);
+  if (bench_selected(&br, "mm_exp")) bench_mm_exp(&br);
+  if (bench_selected(&br, "pv_convolve")) bench_convolve(&br);
+  if (bench_selected(&br, "phastCons")) bench_phastCons(&br);
+  if (bench_selected(&br, "phyloP")) bench_phyloP(&br);
+
+  if (out_fname != NULL) outf = phast_fopen(out_fname, "w");
+  if (format == JSON_FORMAT) bench_print_json(outf, &br);
+  else bench_print_csv(outf, &br);
+  if (outf != stdout) phast_fclose(outf);
+
+  return 0;
+}
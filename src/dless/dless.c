@@ -22,6 +22,7 @@
 #include <indel_mod.h>
 #include <subst_distrib.h>
 #include <bd_phylo_hmm.h>
+#include <profile.h>
 #include "dless.help"
 
 #define DEFAULT_RHO 0.3
@@ -53,6 +54,7 @@ int main(int argc, char *argv[]) {
     {"idpref", 1, 0, 'P'},
     {"indel-model", 1, 0, 'I'},
     {"indel-history", 1, 0, 'H'},
+    {"profile", 0, 0, 0},
     {"help", 0, 0, 'h'},
     {0, 0, 0, 0}
   };
@@ -148,6 +150,10 @@ int main(int argc, char *argv[]) {
     case 'h':
       printf("%s", HELP);
       exit(0);
+    case 0:
+      if (strcmp(long_opts[opt_idx].name, "profile") == 0)
+        prof_enable();
+      break;
     case '?':
       die("Bad argument.  Try 'dless -h'.\n");
     }
@@ -312,6 +318,7 @@ int main(int argc, char *argv[]) {
 
   fprintf(stderr, "Done.\n");
 
+  if (prof_enabled) prof_print(stderr);
   return 0;
 }
 
@@ -405,7 +405,7 @@ void write_stats(FILE *F, GFF_Feature *feat, void *stats,
     s_bd = stats;
 
   if (type == CONS) 
-    fprintf(F, "%s\t%d\t%d\t%s\t%.1f\t%s\t%s\t%.3e\t%.3e\t%.3e\t%.3e\t%s\t%.2f\t%.2f\t%d\t%d\t%.2f\t%.2f\t%.2f\t%.2f\t%d\t%d\t%.2f\t%.2f\n",
+    fprintf(F, "%s\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\t%s\t%.1f\t%s\t%s\t%.3e\t%.3e\t%.3e\t%.3e\t%s\t%.2f\t%.2f\t%d\t%d\t%.2f\t%.2f\t%.2f\t%.2f\t%d\t%d\t%.2f\t%.2f\n",
             feat->seqname->chars, feat->start-1, feat->end, id->chars, 
             feat->score, "conserved", "NA", 
             s_cons->p_cons, (double)1, (double)1, (double)1, "exact", 
@@ -414,7 +414,7 @@ void write_stats(FILE *F, GFF_Feature *feat, void *stats,
             s_cons->post_mean, s_cons->post_var, 
             (double)0, (double)0, 0, 0, (double)0, (double)0);
   else 
-    fprintf(F, "%s\t%d\t%d\t%s\t%.1f\t%s\t%s\t%.3e\t%.3e\t%.3e\t%.3e\t%s\t%.2f\t%.2f\t%d\t%d\t%.2f\t%.2f\t%.2f\t%.2f\t%d\t%d\t%.2f\t%.2f\n", 
+    fprintf(F, "%s\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\t%s\t%.1f\t%s\t%s\t%.3e\t%.3e\t%.3e\t%.3e\t%s\t%.2f\t%.2f\t%d\t%d\t%.2f\t%.2f\t%.2f\t%.2f\t%d\t%d\t%.2f\t%.2f\n", 
             feat->seqname->chars, feat->start-1, feat->end, id->chars, 
             feat->score, type == BIRTH ? "gain" : "loss", subtree_root_name, 
             s_bd->p_cons_left, s_bd->p_cons_right, 
@@ -18,6 +18,7 @@
 #include <sufficient_stats.h>
 #include <stringsplus.h>
 #include <maf.h>
+#include <profile.h>
 #include "exoniphy.help"
 
 /* default background feature types; used when scoring predictions and
@@ -48,7 +49,7 @@ int main(int argc, char* argv[]) {
   /* variables for options, with defaults */
   int msa_format = UNKNOWN_FORMAT;
   int quiet = FALSE, reflect_hmm = FALSE, score = FALSE, indels = FALSE, 
-    no_cns = FALSE;
+    no_cns = FALSE, single_prec = FALSE;
   double bias = NEGINFTY;
   char *seqname = NULL, *grouptag = "transcript_id", *sens_spec_fname_root = NULL,
     *idpref = NULL, *extrapolate_tree_fname = NULL, *newname;
@@ -86,6 +87,8 @@ int main(int argc, char* argv[]) {
     {"extrapolate", 1, 0, 'e'},
     {"alias", 1, 0, 'A'},
     {"quiet", 0, 0, 'q'},
+    {"profile", 0, 0, 0},
+    {"single-precision", 0, 0, 0},
     {"help", 0, 0, 'h'},
     {0, 0, 0, 0}
   };
@@ -186,6 +189,12 @@ int main(int argc, char* argv[]) {
     case 'h':
       printf("%s", HELP);
       exit(0);
+    case 0:
+      if (strcmp(long_opts[opt_idx].name, "profile") == 0)
+        prof_enable();
+      else if (strcmp(long_opts[opt_idx].name, "single-precision") == 0)
+        single_prec = TRUE;
+      break;
     case '?':
       die("ERROR: unrecognized option.  Try 'exoniphy -h' for help.\n");
     }
@@ -420,6 +429,7 @@ int main(int argc, char* argv[]) {
   }
 
   /* compute emissions */
+  if (single_prec) phmm_set_single_prec(phmm);
   phmm_compute_emissions(phmm, msa, quiet);
 
   /* now produce predictions.  Need to do this in a loop because
@@ -477,5 +487,6 @@ int main(int argc, char* argv[]) {
   if (!quiet)
     fprintf(stderr, "Done.\n");
 
+  if (prof_enabled) prof_print(stderr);
   return 0;
 }
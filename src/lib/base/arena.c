@@ -0,0 +1,173 @@
+/***************************************************************************
+ * PHAST: PHylogenetic Analysis with Space/Time models
+ * Copyright (c) 2002-2005 University of California, 2006-2010 Cornell
+ * University.  All rights reserved.
+ *
+ * This source code is distributed under a BSD-style license.  See the
+ * file LICENSE.txt for details.
+ ***************************************************************************/
+
+/* Bump-pointer allocator for scratch memory.  See arena.h for details */
+
+#include <arena.h>
+#include <misc.h>
+#include <external_libs.h>
+
+static size_t ar_round(size_t size) {
+  return (size + AR_ALIGN - 1) & ~((size_t)AR_ALIGN - 1);
+}
+
+/* allocate a block with at least 'size' usable bytes; header and data
+   are obtained in a single call, with data aligned to AR_ALIGN */
+static ArenaBlock *ar_new_block(size_t size) {
+  size_t hdr = ar_round(sizeof(ArenaBlock));
+  ArenaBlock *b;
+  size = ar_round(size);
+  b = smalloc(hdr + size + AR_ALIGN);
+  b->data = (char*)ar_round((size_t)((char*)b + hdr));
+  b->size = size;
+  b->next = NULL;
+  b->base = 0;
+  return b;
+}
+
+Arena *ar_new(size_t block_size) {
+  Arena *ar = smalloc(sizeof(Arena));
+  ar->block_size = block_size > 0 ? block_size : AR_DEFAULT_BLOCK_SIZE;
+  ar->first = ar->curr = ar_new_block(ar->block_size);
+  ar->offset = 0;
+  ar->nallocs = 0;
+  ar->nbytes = 0;
+  ar->nblocks = 1;
+  ar->capacity = ar->first->size;
+  ar->high_water = 0;
+  return ar;
+}
+
+void *ar_alloc(Arena *ar, size_t size) {
+  void *retval;
+  size_t in_use;
+  size = ar_round(size == 0 ? 1 : size);
+
+  if (ar->offset + size > ar->curr->size) {
+    /* move to next block, inserting a new one if the next is missing or
+       too small.  Existing later blocks are kept for reuse */
+    ArenaBlock *b = ar->curr->next;
+    if (b == NULL || b->size < size) {
+      size_t newsize = 2 * ar->curr->size;
+      if (newsize < size) newsize = size;
+      if (newsize < ar->block_size) newsize = ar->block_size;
+      b = ar_new_block(newsize);
+      b->next = ar->curr->next;
+      ar->curr->next = b;
+      ar->nblocks++;
+      ar->capacity += b->size;
+      /* update cumulative sizes of this and later blocks */
+      for (b = ar->curr; b->next != NULL; b = b->next)
+        b->next->base = b->base + b->size;
+      b = ar->curr->next;
+    }
+    ar->curr = b;
+    ar->offset = 0;
+  }
+
+  retval = ar->curr->data + ar->offset;
+  ar->offset += size;
+  ar->nallocs++;
+  ar->nbytes += size;
+  in_use = ar->curr->base + ar->offset;
+  if (in_use > ar->high_water) ar->high_water = in_use;
+  return retval;
+}
+
+double **ar_alloc_dbl_matrix(Arena *ar, int nrows, size_t ncols) {
+  double **m = ar_alloc(ar, nrows * sizeof(double*));
+  double *data = ar_alloc(ar, (size_t)nrows * ncols * sizeof(double));
+  int i;
+  for (i = 0; i < nrows; i++)
+    m[i] = data + (size_t)i * ncols;
+  return m;
+}
+
+int **ar_alloc_int_matrix(Arena *ar, int nrows, size_t ncols) {
+  int **m = ar_alloc(ar, nrows * sizeof(int*));
+  int *data = ar_alloc(ar, (size_t)nrows * ncols * sizeof(int));
+  int i;
+  for (i = 0; i < nrows; i++)
+    m[i] = data + (size_t)i * ncols;
+  return m;
+}
+
+ArenaMark ar_mark(Arena *ar) {
+  ArenaMark mark;
+  mark.block = ar->curr;
+  mark.offset = ar->offset;
+  return mark;
+}
+
+void ar_release(Arena *ar, ArenaMark mark) {
+  ar->curr = mark.block;
+  ar->offset = mark.offset;
+}
+
+void ar_reset(Arena *ar) {
+  ar->curr = ar->first;
+  ar->offset = 0;
+}
+
+void ar_trim(Arena *ar) {
+  ArenaBlock *b = ar->curr->next, *next;
+  ar->curr->next = NULL;
+  while (b != NULL) {
+    next = b->next;
+    ar->nblocks--;
+    ar->capacity -= b->size;
+    sfree(b);
+    b = next;
+  }
+}
+
+void ar_free(Arena *ar) {
+  ArenaBlock *b = ar->first, *next;
+  while (b != NULL) {
+    next = b->next;
+    sfree(b);
+    b = next;
+  }
+  sfree(ar);
+}
+
+size_t ar_in_use(Arena *ar) {
+  return ar->curr->base + ar->offset;
+}
+
+void ar_print_stats(FILE *F, const char *name, Arena *ar) {
+  fprintf(F, "%s: %lu allocations, %lu bytes requested, %i blocks, %lu bytes capacity, %lu bytes high water\n",
+          name, ar->nallocs, (unsigned long)ar->nbytes, ar->nblocks,
+          (unsigned long)ar->capacity, (unsigned long)ar->high_water);
+}
+
+/* one scratch arena per thread.  With the memory handler, blocks are
+   freed by phast_free_all, which also resets the pointer to NULL (see
+   set_static_var) */
+static PHAST_THREAD_LOCAL Arena *scratch = NULL;
+
+Arena *ar_scratch_begin(ArenaMark *mark) {
+  if (scratch == NULL) {
+    scratch = ar_new(0);
+    set_static_var((void**)&scratch);
+  }
+  *mark = ar_mark(scratch);
+  return scratch;
+}
+
+void ar_scratch_end(Arena *ar, ArenaMark mark) {
+  ar_release(ar, mark);
+  if (ar->curr == ar->first && ar->offset == 0 &&
+      ar->capacity > AR_SCRATCH_RETAIN)
+    ar_trim(ar);
+}
+
+Arena *ar_scratch_arena() {
+  return scratch;
+}
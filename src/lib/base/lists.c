@@ -174,6 +174,27 @@ int lst_bsearch_int(List *lst, int val) {
   return(l - 1);
 }
 
+/* same as lst_bsearch_int, for lists of coordinates */
+int lst_bsearch_pos(List *lst, phast_pos val) {
+  int l = 0;
+  int r = lst_size(lst) - 1;
+  if (r < 0 || val < lst_get_pos(lst, l)) return -1;
+  if (val > lst_get_pos(lst, r)) return r;      
+  while (l <= r) {
+    int m = (l + r)/2;
+    phast_pos candidate = lst_get_pos(lst, m);
+    if (val == candidate) 
+      return m;
+    else if (val < candidate) 
+      r = m - 1;
+    else                        /* val > candidate */
+      l = m + 1;
+  }
+  if (val > lst_get_pos(lst, r))
+    return r;
+  return(l - 1);
+}
+
 void lst_qsort(List *l, int (*compare)(const void *, const void *)) {
   /* will we need to use max(elementsz, sizeof(void*))? */
   qsort(&l->array[l->lidx], lst_size(l), l->elementsz, compare);
@@ -288,6 +309,9 @@ List* lst_new_int(int nelements)
 /* have to be sure size isn't smaller than size of void*; can be an
    issue with 64-bit architectures */
 
+List* lst_new_pos(int nelements) 
+{ return lst_new(nelements, max(sizeof(phast_pos), sizeof(void*))); }
+
 List* lst_new_dbl(int nelements) 
 { return lst_new(nelements, max(sizeof(double), sizeof(void*))); }
 
@@ -464,9 +464,9 @@ void mm_exp_higham(MarkovMatrix *P, MarkovMatrix *Q, double t, int do_mu) {
 /* general version allowing for complex eigenvalues/eigenvectors */
 void mm_exp_complex(MarkovMatrix *P, MarkovMatrix *Q, double t) {
 
-  static Zmatrix *Eexp = NULL; /* reuse these if possible */
-  static Zmatrix *tmp = NULL;
-  static int last_size = 0;
+  static PHAST_THREAD_LOCAL Zmatrix *Eexp = NULL; /* reuse these if possible */
+  static PHAST_THREAD_LOCAL Zmatrix *tmp = NULL;
+  static PHAST_THREAD_LOCAL int last_size = 0;
   int n = Q->size;
   int i, j;
 
@@ -520,8 +520,8 @@ void mm_exp_complex(MarkovMatrix *P, MarkovMatrix *Q, double t) {
 
 /* version that assumes real eigenvalues/eigenvectors */
 void mm_exp_real(MarkovMatrix *P, MarkovMatrix *Q, double t) {
-  static Vector *exp_evals = NULL; /* reuse if possible */
-  static int last_size = -1;
+  static PHAST_THREAD_LOCAL Vector *exp_evals = NULL; /* reuse if possible */
+  static PHAST_THREAD_LOCAL int last_size = -1;
   int n = Q->size;
   int i;
 
@@ -663,10 +663,10 @@ void mm_diagonalize_real(MarkovMatrix *M) {
 
   /* keep temp storage around -- this function will be called many
      times repeatedly */
-  static Zmatrix *evecs_z = NULL;
-  static Zmatrix *evecs_inv_z = NULL;
-  static Zvector *evals_z = NULL;
-  static int size = -1;
+  static PHAST_THREAD_LOCAL Zmatrix *evecs_z = NULL;
+  static PHAST_THREAD_LOCAL Zmatrix *evecs_inv_z = NULL;
+  static PHAST_THREAD_LOCAL Zvector *evals_z = NULL;
+  static PHAST_THREAD_LOCAL int size = -1;
 
   if (evecs_z == NULL || size != M->size) {
     if (evecs_z != NULL) {
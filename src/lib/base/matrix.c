@@ -293,12 +293,19 @@ int mat_invert(Matrix *M_inv, Matrix *M) {
    same dimension, and C is diagonal.  C is described by a vector
    representing its diagonal elements.  */
 void mat_mult_diag(Matrix *A, Matrix *B, Vector *C, Matrix *D) {
-  int i, j, k;
-  for (i = 0; i < C->size; i++) {
-    for (j = 0; j < C->size; j++) {
-      A->data[i][j] = 0;
-      for (k = 0; k < C->size; k++)
-        A->data[i][j] += B->data[i][k] * C->data[k] * D->data[k][j];
+  int i, j, k, n = C->size;
+  double bc, *a, *d;
+  /* loop over columns of D in the innermost loop, so that memory is
+     accessed sequentially; each element of A is still accumulated in
+     order of k */
+  for (i = 0; i < n; i++) {
+    a = A->data[i];
+    for (j = 0; j < n; j++) a[j] = 0;
+    for (k = 0; k < n; k++) {
+      bc = B->data[i][k] * C->data[k];
+      d = D->data[k];
+      for (j = 0; j < n; j++)
+        a[j] += bc * d[j];
     }
   }
 }
@@ -752,6 +752,12 @@ void hmm_protect(HMM *hmm) {
   phast_mem_protect(hmm->successors);
   lst_protect(hmm->begin_successors);
   lst_protect(hmm->end_predecessors);
+  phast_mem_protect(hmm->pred_ptr);
+  phast_mem_protect(hmm->pred_idx);
+  phast_mem_protect(hmm->pred_score);
+  phast_mem_protect(hmm->succ_ptr);
+  phast_mem_protect(hmm->succ_idx);
+  phast_mem_protect(hmm->succ_score);
 }
 
 
@@ -823,6 +829,7 @@ void phmm_protect(PhyloHmm *p) {
   if (p->em_data != NULL) {
     phast_mem_protect(p->em_data);
     mat_protect(p->em_data->H);
+    vec_protect(p->em_data->tree_params);
     //msa_protect(p->em_data->msa);  //assume this is protected elsewhere/
   }
 
@@ -417,6 +417,14 @@ int get_arg_int(char *arg) {
   return retval;
 }
 
+/* argument conversion with error checking (sequence coordinate) */
+phast_pos get_arg_pos(char *arg) {
+  char *endptr;
+  phast_pos retval = strtoll(arg, &endptr, 0);
+  if (*endptr != '\0') die("ERROR: cannot parse integer '%s'\n", arg);
+  return retval;
+}
+
 /* argument conversion with error checking (double) */
 double get_arg_dbl(char *arg) {
   char *endptr;
@@ -543,9 +551,9 @@ int bn_draw(int N, double p) {
    externally. */
 int bn_draw_fast(int n, double pp) {
   int j;
-  static int nold = -1;
+  static PHAST_THREAD_LOCAL int nold = -1;
   double am, em, g, angle, p, bn1, sq, t, y;
-  static double pold = -1, pc, plog, pclog, en, oldg;
+  static PHAST_THREAD_LOCAL double pold = -1, pc, plog, pclog, en, oldg;
 
   if (n < 25) return bn_draw(n, pp);
 
@@ -1133,7 +1141,7 @@ static char **build_iupac_map() {
 
 /* accessor for static mapping */
 char **get_iupac_map() {
-  static char **iupac_map = NULL;
+  static PHAST_THREAD_LOCAL char **iupac_map = NULL;
   if (iupac_map == NULL) {
     iupac_map = build_iupac_map();
     set_static_var((void**)(&iupac_map));
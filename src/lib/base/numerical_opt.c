@@ -18,6 +18,7 @@
 #include <sys/time.h>
 #include <vector.h>
 #include <external_libs.h>
+#include <profile.h>
 
 /* Numerical optimization of one-dimensional and multi-dimensional functions */
 
@@ -71,6 +72,12 @@
 #define ITMAX 200               /* maximum allowed number of
                                    iterations (opt_bfgs) */
 
+#define SQUAREM_STEP_MAX0 4     /* initial bound on SQUAREM step length
+                                   (more aggressive than the published
+                                   default of 1, which pays off in the
+                                   short EM runs typical here) */
+#define SQUAREM_MSTEP 4         /* factor by which bound is adjusted */
+
 #define STEP_SCALE 100          /* scale factor for maximum step size
                                    in line searches (opt_bfgs) */
 
@@ -402,6 +409,7 @@ int opt_bfgs(double (*f)(Vector*, void*), Vector *params,
   Matrix *H, *first_frac, *sec_frac, *bfgs_term;
   opt_deriv_method deriv_method = OPT_DERIV_FORWARD;
   struct timeval start_time, end_time;
+  PROF_BEGIN(PROF_BFGS);
 
   if (precision == OPT_UNKNOWN_PREC)
     die("unknown precision in opt_bfgs");
@@ -801,6 +809,7 @@ int opt_bfgs(double (*f)(Vector*, void*), Vector *params,
   mat_free(bfgs_term);
   if (num_evals != NULL)
     *num_evals = nevals;
+  PROF_END(PROF_BFGS, nevals);
 
   if (success == 0) {
     if (logf != NULL)
@@ -971,6 +980,7 @@ double opt_brent(double ax, double bx, double cx,
   double a, b, d=0, etemp, fu, fv, fw, fx, p, q, r, tol1, tol2, u, v, w, x, xm;
   double e = 0.0;                  /*  This will be the distance moved on
                                        the step before last. */
+  PROF_BEGIN(PROF_OPT_1D);
   a = (ax < cx ? ax : cx);        /* a and b must be in ascending order, 
                                      but input abscissas need not be. */
   b = (ax > cx ? ax : cx);
@@ -987,6 +997,7 @@ double opt_brent(double ax, double bx, double cx,
       *xmin = x;
       if (logf != NULL) 
         fprintf(logf, "Returning x_min = %f, f(x_min) = %f\n", x, fx);
+      PROF_END(PROF_OPT_1D, iter);
       return fx;
     }
     if (fabs(e) > tol1) { 
@@ -1144,6 +1155,7 @@ int opt_newton_1d(double (*f)(double, void*), double (*x), void *data,
   double xold, fxold, d, d2, direction, lambda = -1;
   int its, nevals = 0, converged = FALSE;
   struct timeval start_time, end_time;
+  PROF_BEGIN(PROF_OPT_1D);
 
   if (!(*x > lb && *x < ub && ub > lb))
     die("ERROR opt_newton_1d: x=%e, lb=%e, ub=%e\n", x, lb, ub);
@@ -1207,6 +1219,7 @@ int opt_newton_1d(double (*f)(double, void*), double (*x), void *data,
       fprintf(logf, "WARNING: exceeded maximum number of iterations.\n");
   }
 
+  PROF_END(PROF_OPT_1D, nevals);
   return(!converged);
 }
 
@@ -1366,3 +1379,137 @@ int opt_sigfig(double val1, double val2) {
   }    
   return sf;
 }
+
+/* SQUAREM acceleration of EM (Varadhan & Roland, Scand J Stat
+   35:335-353, 2008).  Given three successive EM iterates p0, p1 =
+   M(p0), and p2 = M(p1), the point p0 - 2*a*r + a^2*v, with r = p1 -
+   p0, v = p2 - 2*p1 + p0, and a = -|r|/|v|, approximates a much
+   longer sequence of EM steps.  The caller evaluates the
+   extrapolated point in its next E step, and rejects it in favor of
+   p2 if the likelihood has decreased.  Usage is:
+
+     for (;;) {
+       E step at params, giving ll
+       if (!opt_squarem_check(sq, params, ll)) continue;
+       check convergence
+       M step, updating params
+       opt_squarem_update(sq, params, ll, lb, ub);
+     }
+
+   where params must be unpacked into the model whenever either
+   function changes them (they return TRUE and FALSE, respectively,
+   in that case).  Call opt_squarem_reset whenever the M step changes
+   in a way that breaks the sequence of iterates (e.g., a change in
+   the parameterization). */
+OptSquarem *opt_squarem_new() {
+  OptSquarem *sq = smalloc(sizeof(OptSquarem));
+  int i;
+  for (i = 0; i < 3; i++) sq->hist[i] = NULL;
+  sq->fallback = NULL;
+  sq->nextrap = sq->nrejected = 0;
+  sq->step_max = SQUAREM_STEP_MAX0;
+  opt_squarem_reset(sq);
+  return sq;
+}
+
+void opt_squarem_free(OptSquarem *sq) {
+  int i;
+  for (i = 0; i < 3; i++)
+    if (sq->hist[i] != NULL) vec_free(sq->hist[i]);
+  if (sq->fallback != NULL) vec_free(sq->fallback);
+  sfree(sq);
+}
+
+/* forget previous iterates */
+void opt_squarem_reset(OptSquarem *sq) {
+  sq->nhist = 0;
+  sq->pending = FALSE;
+}
+
+/* store a copy of v in *dest, reallocating if necessary */
+static void squarem_save(Vector **dest, Vector *v) {
+  if (*dest != NULL && (*dest)->size != v->size) {
+    vec_free(*dest);
+    *dest = NULL;
+  }
+  if (*dest == NULL) *dest = vec_new(v->size);
+  vec_copy(*dest, v);
+}
+
+/* Record an EM update 'params' (the result of an M step); 'll' is the
+   log likelihood at the point from which it was obtained.  If three
+   successive updates are available, replace params with an
+   extrapolated point and return TRUE; otherwise leave params
+   unchanged and return FALSE.  The extrapolation is shortened as
+   necessary to keep it within the (optional) bounds. */
+int opt_squarem_update(OptSquarem *sq, Vector *params, double ll,
+                       Vector *lower_bounds, Vector *upper_bounds) {
+  Vector *p0, *p1, *p2;
+  double rr = 0, vv = 0, alpha, r, v, x;
+  int i, feasible;
+
+  if (sq->nhist > 0 && sq->hist[0]->size != params->size)
+    opt_squarem_reset(sq);      /* dimension has changed */
+
+  squarem_save(&sq->hist[sq->nhist++], params);
+  if (sq->nhist < 3) return FALSE;
+
+  p0 = sq->hist[0]; p1 = sq->hist[1]; p2 = sq->hist[2];
+  for (i = 0; i < params->size; i++) {
+    r = vec_get(p1, i) - vec_get(p0, i);
+    v = vec_get(p2, i) - 2 * vec_get(p1, i) + vec_get(p0, i);
+    rr += r * r;
+    vv += v * v;
+  }
+  sq->nhist = 0;                /* start a new cycle in any case */
+  if (vv == 0 || rr == 0) return FALSE;
+
+  alpha = -sqrt(rr / vv);
+  if (alpha > -1) alpha = -1;
+  if (alpha < -sq->step_max) alpha = -sq->step_max;
+
+  /* back off toward the plain EM update (alpha = -1) until the point
+     is within bounds */
+  do {
+    feasible = TRUE;
+    for (i = 0; feasible && i < params->size; i++) {
+      r = vec_get(p1, i) - vec_get(p0, i);
+      v = vec_get(p2, i) - 2 * vec_get(p1, i) + vec_get(p0, i);
+      x = vec_get(p0, i) - 2 * alpha * r + alpha * alpha * v;
+      if (isnan(x) || isinf(x) || 
+          (lower_bounds != NULL && x < vec_get(lower_bounds, i)) ||
+          (upper_bounds != NULL && x > vec_get(upper_bounds, i)))
+        feasible = FALSE;
+      else vec_set(params, i, x);
+    }
+    if (!feasible) alpha = (alpha - 1) / 2;
+  } while (!feasible && alpha < -1.01);
+
+  if (alpha == -sq->step_max) sq->step_max *= SQUAREM_MSTEP;
+
+  if (!feasible || alpha == -1) {
+    vec_copy(params, p2);       /* plain EM update */
+    return FALSE;
+  }
+
+  squarem_save(&sq->fallback, p2);
+  sq->ref_ll = ll;
+  sq->pending = TRUE;
+  sq->nextrap++;
+  return TRUE;
+}
+
+/* Check the log likelihood 'll' at the current point 'params'
+   following an E step.  If the point was obtained by extrapolation
+   and the likelihood is lower than before extrapolation, replace
+   params with the plain EM update and return FALSE, in which case
+   the E step must be repeated.  Otherwise return TRUE. */
+int opt_squarem_check(OptSquarem *sq, Vector *params, double ll) {
+  if (!sq->pending) return TRUE;
+  sq->pending = FALSE;
+  if (ll >= sq->ref_ll) return TRUE;     /* (also rejects NaN) */
+  vec_copy(params, sq->fallback);
+  sq->nrejected++;
+  sq->step_max = max(SQUAREM_STEP_MAX0, sq->step_max / SQUAREM_MSTEP);
+  return FALSE;
+}
@@ -0,0 +1,136 @@
+/***************************************************************************
+ * PHAST: PHylogenetic Analysis with Space/Time models
+ * Copyright (c) 2002-2005 University of California, 2006-2010 Cornell
+ * University.  All rights reserved.
+ *
+ * This source code is distributed under a BSD-style license.  See the
+ * file LICENSE.txt for details.
+ ***************************************************************************/
+
+/* Timers and counters for the main computational stages.  See
+   profile.h for details */
+
+#include <stdio.h>
+#include <sys/time.h>
+#include <profile.h>
+#include <external_libs.h>
+#include <misc.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#ifdef PHAST_THREADS
+#include <pthread.h>
+static pthread_mutex_t prof_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+int prof_enabled = FALSE;
+
+/* descriptions of stages and of their units of work, in the order of
+   prof_stage */
+static const char *prof_stage_names[PROF_NSTAGES] = {
+  "MAF parsing", "SS parsing", "sufficient statistics",
+  "substitution matrices", "tree likelihood", "emissions",
+  "forward", "backward", "viterbi", "substitution distributions",
+  "EM training", "BFGS optimization", "1-d optimization"};
+
+static const char *prof_unit_names[PROF_NSTAGES] = {
+  "blocks", "tuples", "columns", "matrices", "tuples", "state-columns",
+  "columns", "columns", "columns", "tuples", "iterations",
+  "evaluations", "evaluations"};
+
+/* accumulated counters */
+static long prof_calls[PROF_NSTAGES];
+static double prof_secs[PROF_NSTAGES];
+static double prof_units[PROF_NSTAGES];
+
+/* depth of nesting of each stage in the calling thread */
+static PHAST_THREAD_LOCAL int prof_depth[PROF_NSTAGES];
+
+static struct timeval prof_start_time;
+
+static double prof_now() {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec + now.tv_usec/1.0e6;
+}
+
+void prof_enable() {
+  int i;
+  for (i = 0; i < PROF_NSTAGES; i++) {
+    prof_calls[i] = 0;
+    prof_secs[i] = prof_units[i] = 0;
+  }
+  gettimeofday(&prof_start_time, NULL);
+  prof_enabled = TRUE;
+}
+
+double prof_begin(prof_stage stage) {
+  if (prof_depth[stage]++ > 0) return -1;
+  return prof_now();
+}
+
+void prof_end(prof_stage stage, double start, double units) {
+  double elapsed;
+  if (start == -2) return;      /* profiling was off at beginning */
+  prof_depth[stage]--;
+  if (start < 0) return;        /* nested call */
+  elapsed = prof_now() - start;
+#ifdef PHAST_THREADS
+  pthread_mutex_lock(&prof_lock);
+#endif
+  prof_calls[stage]++;
+  prof_secs[stage] += elapsed;
+  prof_units[stage] += units;
+#ifdef PHAST_THREADS
+  pthread_mutex_unlock(&prof_lock);
+#endif
+}
+
+long prof_peak_rss() {
+#ifdef _WIN32
+  return -1;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#ifdef __APPLE__
+  return usage.ru_maxrss;       /* bytes */
+#else
+  return usage.ru_maxrss * 1024L; /* kilobytes */
+#endif
+#endif
+}
+
+void prof_print(FILE *F) {
+  double total = get_elapsed_time(&prof_start_time);
+  long rss = prof_peak_rss();
+  int i;
+
+  fprintf(F, "\nPROFILE (stages may be nested; times of parallel threads are summed)\n");
+  fprintf(F, "%-28s %10s %12s %7s %14s  %s\n", "stage", "calls", "seconds",
+          "%total", "work", "units");
+  for (i = 0; i < PROF_NSTAGES; i++) {
+    if (prof_calls[i] == 0) continue;
+    fprintf(F, "%-28s %10li %12.3f %6.1f%% %14.0f  %s\n", prof_stage_names[i],
+            prof_calls[i], prof_secs[i],
+            total > 0 ? 100 * prof_secs[i] / total : 0, prof_units[i],
+            prof_unit_names[i]);
+  }
+  fprintf(F, "%-28s %10s %12.3f\n", "total elapsed", "", total);
+#ifndef _WIN32
+  {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+      fprintf(F, "%-28s %10s %12.3f\n%-28s %10s %12.3f\n", "user CPU", "",
+              usage.ru_utime.tv_sec + usage.ru_utime.tv_usec/1.0e6,
+              "system CPU", "",
+              usage.ru_stime.tv_sec + usage.ru_stime.tv_usec/1.0e6);
+  }
+#endif
+  if (rss >= 0)
+    fprintf(F, "%-28s %10s %12.1f MB\n", "peak resident set size", "",
+            rss / 1048576.0);
+  else
+    fprintf(F, "%-28s %10s %12s\n", "peak resident set size", "", "NA");
+}
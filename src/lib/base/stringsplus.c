@@ -95,6 +95,12 @@ void str_append_int(String *s, int i) {
   str_append_charstr(s, tmp);
 }
 
+void str_append_pos(String *s, phast_pos i) {
+  char tmp[STR_SHORT_LEN];
+  sprintf(tmp, "%" PHAST_POS_FMT, i);
+  str_append_charstr(s, tmp);
+}
+
 /* defaults to 9 digits beyond decimal pt */
 void str_append_dbl(String *s, double d) {
   char tmp[(int)ceil(log10(d)) + 1 + 10];
@@ -431,6 +437,14 @@ int str_as_int(String *s, int *i) {
   return (endptr - s->chars == s->length ? 0 : 2);
 }
 
+int str_as_pos(String *s, phast_pos *l) {
+  char *endptr;
+  phast_pos tmp = strtoll(s->chars, &endptr, 0);
+  if (endptr == s->chars) return 1;
+  *l = tmp;
+  return (endptr - s->chars == s->length ? 0 : 2);
+}
+
 int str_as_dbl(String *s, double *d) {
   char *endptr;
   double tmp = (double)strtod(s->chars, &endptr);
@@ -0,0 +1,165 @@
+/***************************************************************************
+ * PHAST: PHylogenetic Analysis with Space/Time models
+ * Copyright (c) 2002-2005 University of California, 2006-2010 Cornell
+ * University.  All rights reserved.
+ *
+ * This source code is distributed under a BSD-style license.  See the
+ * file LICENSE.txt for details.
+ ***************************************************************************/
+
+/* Simple pool of worker threads.  See thread_pool.h for details */
+
+#include <stdlib.h>
+#include <thread_pool.h>
+#include <misc.h>
+
+#ifdef PHAST_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+struct thread_pool_struct {
+  int nthreads;
+#ifdef PHAST_THREADS
+  pthread_t *threads;
+  pthread_mutex_t lock;
+  pthread_cond_t work_ready;    /* signalled when a batch starts or
+                                   the pool shuts down */
+  pthread_cond_t work_done;     /* signalled when the last busy worker
+                                   finishes a batch */
+  int generation;               /* incremented for each batch */
+  int shutdown;
+  int nbusy;                    /* workers still working on current
+                                   batch */
+  int next_job, njobs;
+  tp_job_fn fn;
+  void *data;
+#endif
+};
+
+#ifdef PHAST_THREADS
+/* argument to each worker thread */
+typedef struct {
+  ThreadPool *tp;
+  int thread;
+} WorkerArg;
+
+/* claim and run jobs of current batch until none are left.  Must be
+   called with lock held; returns with lock held */
+static void tp_do_jobs(ThreadPool *tp, int thread) {
+  int job;
+  while (tp->next_job < tp->njobs) {
+    job = tp->next_job++;
+    pthread_mutex_unlock(&tp->lock);
+    tp->fn(tp->data, job, thread);
+    pthread_mutex_lock(&tp->lock);
+  }
+}
+
+static void *tp_worker(void *arg) {
+  ThreadPool *tp = ((WorkerArg*)arg)->tp;
+  int thread = ((WorkerArg*)arg)->thread, seen_generation = 0;
+  sfree(arg);
+
+  pthread_mutex_lock(&tp->lock);
+  while (1) {
+    while (tp->generation == seen_generation && !tp->shutdown)
+      pthread_cond_wait(&tp->work_ready, &tp->lock);
+    if (tp->shutdown) break;
+    seen_generation = tp->generation;
+    tp_do_jobs(tp, thread);
+    if (--tp->nbusy == 0)
+      pthread_cond_signal(&tp->work_done);
+  }
+  pthread_mutex_unlock(&tp->lock);
+  return NULL;
+}
+#endif
+
+int tp_nprocessors() {
+#if defined(PHAST_THREADS) && defined(_SC_NPROCESSORS_ONLN)
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n >= 1 ? (int)n : 1;
+#else
+  return 1;
+#endif
+}
+
+ThreadPool *tp_new(int nthreads) {
+  ThreadPool *tp = smalloc(sizeof(ThreadPool));
+#ifdef PHAST_THREADS
+  int i;
+  if (nthreads <= 0) nthreads = tp_nprocessors();
+  tp->nthreads = nthreads;
+  tp->generation = 0;
+  tp->shutdown = FALSE;
+  tp->nbusy = 0;
+  tp->next_job = tp->njobs = 0;
+  tp->fn = NULL;
+  tp->data = NULL;
+  pthread_mutex_init(&tp->lock, NULL);
+  pthread_cond_init(&tp->work_ready, NULL);
+  pthread_cond_init(&tp->work_done, NULL);
+
+  /* thread 0 is the caller of tp_run; start the others */
+  tp->threads = smalloc(nthreads * sizeof(pthread_t));
+  for (i = 1; i < nthreads; i++) {
+    WorkerArg *arg = smalloc(sizeof(WorkerArg));
+    arg->tp = tp;
+    arg->thread = i;
+    if (pthread_create(&tp->threads[i], NULL, tp_worker, arg) != 0)
+      die("ERROR: tp_new could not create thread %i\n", i);
+  }
+#else
+  tp->nthreads = 1;
+#endif
+  return tp;
+}
+
+void tp_run(ThreadPool *tp, int njobs, tp_job_fn fn, void *data) {
+#ifdef PHAST_THREADS
+  if (tp->nthreads > 1 && njobs > 1) {
+    pthread_mutex_lock(&tp->lock);
+    tp->fn = fn;
+    tp->data = data;
+    tp->njobs = njobs;
+    tp->next_job = 0;
+    tp->nbusy = tp->nthreads - 1;
+    tp->generation++;
+    pthread_cond_broadcast(&tp->work_ready);
+    tp_do_jobs(tp, 0);
+    while (tp->nbusy > 0)
+      pthread_cond_wait(&tp->work_done, &tp->lock);
+    tp->fn = NULL;
+    tp->data = NULL;
+    pthread_mutex_unlock(&tp->lock);
+    return;
+  }
+#endif
+  {
+    int job;
+    for (job = 0; job < njobs; job++)
+      fn(data, job, 0);
+  }
+}
+
+int tp_nthreads(ThreadPool *tp) {
+  return tp->nthreads;
+}
+
+void tp_free(ThreadPool *tp) {
+#ifdef PHAST_THREADS
+  int i;
+  pthread_mutex_lock(&tp->lock);
+  tp->shutdown = TRUE;
+  pthread_cond_broadcast(&tp->work_ready);
+  pthread_mutex_unlock(&tp->lock);
+  for (i = 1; i < tp->nthreads; i++)
+    pthread_join(tp->threads[i], NULL);
+  sfree(tp->threads);
+  pthread_mutex_destroy(&tp->lock);
+  pthread_cond_destroy(&tp->work_ready);
+  pthread_cond_destroy(&tp->work_done);
+#endif
+  sfree(tp);
+}
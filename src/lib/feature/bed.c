@@ -42,13 +42,14 @@ void gff_read_from_bed(GFF_Set *gff, FILE *F) {
       /* for now do nothing with Track info */
     }
     else {
-      int start = 0, end = 0, score = 0, score_is_null = 1;
+      phast_pos start = 0, end = 0;
+      int score = 0, score_is_null = 1;
       String *chrom = NULL;
       char strand = '.';
 
       if (lst_size(l) < 3 ||
-          str_as_int(lst_get_ptr(l, 1), &start) != 0 ||
-          str_as_int(lst_get_ptr(l, 2), &end) != 0)  
+          str_as_pos(lst_get_ptr(l, 1), &start) != 0 ||
+          str_as_pos(lst_get_ptr(l, 2), &end) != 0)  
         is_error = 1;
       else {
         chrom = lst_get_ptr(l, 0);
@@ -166,7 +167,7 @@ void gff_print_bed(FILE *OUTF,  GFF_Set *gff, int use_groups) {
       }
         
       /* required four columns */
-      fprintf(OUTF, "%s\t%d\t%d\t%s", feat->seqname->chars, feat->start - 1, 
+      fprintf(OUTF, "%s\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\t%s", feat->seqname->chars, feat->start - 1, 
               feat->end, name == NULL ? "" : name->chars);
 
       /* optional additional columns */
@@ -210,20 +211,20 @@ void gff_print_bed(FILE *OUTF,  GFF_Set *gff, int use_groups) {
       }
 
       feat = lst_get_ptr(group->features, 0);
-      fprintf(OUTF, "%s\t%d\t%d\t%s\t%.0f\t%c\t%d\t%d\t0\t%d\t", 
+      fprintf(OUTF, "%s\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\t%s\t%.0f\t%c\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\t0\t%d\t", 
               feat->seqname->chars, group->start - 1, group->end, 
               group->name->chars, score, feat->strand, 
               group->start - 1, group->end, lst_size(group->features));
 
       for (j = 0; j < lst_size(group->features); j++) {
         feat = lst_get_ptr(group->features, j);
-        fprintf(OUTF, "%d,", feat->end - feat->start + 1);
+        fprintf(OUTF, "%" PHAST_POS_FMT ",", feat->end - feat->start + 1);
       }    
 
       fprintf(OUTF, "\t");
 
       for (j = 0; j < lst_size(group->features); j++) 
-        fprintf(OUTF, "%d,", 
+        fprintf(OUTF, "%" PHAST_POS_FMT ",", 
                 ((GFF_Feature*)lst_get_ptr(group->features, j))->start - 
                 group->start);
 
@@ -0,0 +1,515 @@
+/***************************************************************************
+ * PHAST: PHylogenetic Analysis with Space/Time models
+ * Copyright (c) 2002-2005 University of California, 2006-2010 Cornell
+ * University.  All rights reserved.
+ *
+ * This source code is distributed under a BSD-style license.  See the
+ * file LICENSE.txt for details.
+ ***************************************************************************/
+
+/* Writing of bigWig files.  The layout is
+
+     header | zoom headers | total summary | data | chromosome B+ tree |
+     data index | zoom level 1 data | zoom level 1 index | ... | magic
+
+   Data sections are written as values arrive; zoom blocks are
+   accumulated in a temporary file and copied into place by bw_close,
+   which then goes back to fill in the header.  Numbers are written in
+   native byte order, which readers detect from the magic number. */
+
+#include <misc.h>
+#include <bigwig.h>
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#define BW_MAGIC 0x888FFC26
+#define BW_CHROM_TREE_MAGIC 0x78CA8C91
+#define BW_INDEX_MAGIC 0x2468ACE0
+#define BW_VERSION 4
+#define BW_HEADER_SIZE 64
+#define BW_ZOOM_HEADER_SIZE 24
+#define BW_SUMMARY_SIZE 40
+#define BW_SECTION_HEADER_SIZE 24
+#define BW_ZOOM_RECORD_SIZE 32
+#define BW_LEAF_ITEM_SIZE 32
+#define BW_NODE_ITEM_SIZE 24
+#define BW_FIXED_STEP 3
+#define BW_MAX_BLOCK (BW_ITEMS_PER_SLOT * BW_ZOOM_RECORD_SIZE)
+
+static void bw_write(FILE *F, const void *x, size_t n) {
+  if (fwrite(x, 1, n, F) != n)
+    die("ERROR: write to bigWig file failed\n");
+}
+
+static void bw_write8(FILE *F, uint8_t v) { bw_write(F, &v, 1); }
+static void bw_write16(FILE *F, uint16_t v) { bw_write(F, &v, 2); }
+static void bw_write32(FILE *F, uint32_t v) { bw_write(F, &v, 4); }
+static void bw_write64(FILE *F, uint64_t v) { bw_write(F, &v, 8); }
+static void bw_write_dbl(FILE *F, double v) { bw_write(F, &v, 8); }
+
+static unsigned char *bw_put16(unsigned char *p, uint16_t v) {
+  memcpy(p, &v, 2);
+  return p + 2;
+}
+
+static unsigned char *bw_put32(unsigned char *p, uint32_t v) {
+  memcpy(p, &v, 4);
+  return p + 4;
+}
+
+static unsigned char *bw_put_flt(unsigned char *p, float v) {
+  memcpy(p, &v, 4);
+  return p + 4;
+}
+
+static uint64_t bw_tell(FILE *F) {
+  long pos = ftell(F);
+  if (pos < 0) die("ERROR: bigWig output must go to a regular file\n");
+  return (uint64_t)pos;
+}
+
+static void bw_seek(FILE *F, uint64_t pos) {
+  if (fseek(F, (long)pos, SEEK_SET) != 0)
+    die("ERROR: bigWig output must go to a regular file\n");
+}
+
+BigWig *bw_new(const char *fname) {
+  BigWig *bw = smalloc(sizeof(BigWig));
+  unsigned char zero[BW_HEADER_SIZE + BW_NZOOM * BW_ZOOM_HEADER_SIZE +
+		     BW_SUMMARY_SIZE + 8];
+  int z;
+
+  bw->F = phast_fopen(fname, "wb");
+  bw->zoomF = tmpfile();
+  if (bw->zoomF == NULL)
+    die("ERROR: cannot create temporary file for bigWig zoom levels\n");
+  bw->chroms_alloc = 16;
+  bw->chroms = smalloc(bw->chroms_alloc * sizeof(char*));
+  bw->sizes = smalloc(bw->chroms_alloc * sizeof(uint32_t));
+  bw->nchroms = 0;
+  bw->chrom_sizes = hsh_new(16);
+  bw->vals = smalloc(BW_ITEMS_PER_SLOT * sizeof(float));
+  bw->nvals = 0;
+  bw->sec_start = 0;
+  bw->blocks_alloc = 1024;
+  bw->blocks = smalloc(bw->blocks_alloc * sizeof(BigWigBlock));
+  bw->nblocks = 0;
+  for (z = 0; z < BW_NZOOM; z++) {
+    BigWigZoom *zm = &bw->zoom[z];
+    zm->reduction = (z == 0 ? BW_ZOOM_FIRST :
+		     bw->zoom[z-1].reduction * BW_ZOOM_FACTOR);
+    zm->cur.count = 0;
+    zm->recs = smalloc(BW_ITEMS_PER_SLOT * sizeof(BigWigSummary));
+    zm->nrecs = 0;
+    zm->total = 0;
+    zm->blocks_alloc = 64;
+    zm->blocks = smalloc(zm->blocks_alloc * sizeof(BigWigBlock));
+    zm->nblocks = 0;
+  }
+  bw->bases = 0;
+  bw->min = bw->max = bw->sum = bw->sumsq = 0;
+  bw->max_block = 0;
+  bw->buf = smalloc(BW_MAX_BLOCK);
+#ifdef USE_ZLIB
+  bw->zbuf_size = compressBound(BW_MAX_BLOCK);
+#else
+  bw->zbuf_size = BW_MAX_BLOCK;
+#endif
+  bw->zbuf = smalloc(bw->zbuf_size);
+
+  /* placeholders for header, zoom headers, total summary, and data
+     count, which are filled in by bw_close */
+  memset(zero, 0, sizeof(zero));
+  bw_write(bw->F, zero, sizeof(zero));
+  return bw;
+}
+
+/* write a block of len bytes from bw->buf to F (compressed if
+   possible) and return its size in the file */
+static uint64_t bw_write_block(BigWig *bw, FILE *F, unsigned long len) {
+  if (len > bw->max_block) bw->max_block = (uint32_t)len;
+#ifdef USE_ZLIB
+  {
+    uLongf zlen = bw->zbuf_size;
+    if (compress(bw->zbuf, &zlen, bw->buf, len) != Z_OK)
+      die("ERROR: compression of bigWig block failed\n");
+    bw_write(F, bw->zbuf, zlen);
+    return zlen;
+  }
+#else
+  bw_write(F, bw->buf, len);
+  return len;
+#endif
+}
+
+static BigWigBlock *bw_new_block(BigWigBlock **blocks, int *n, int *alloc) {
+  if (*n == *alloc) {
+    *alloc *= 2;
+    *blocks = srealloc(*blocks, *alloc * sizeof(BigWigBlock));
+  }
+  return &(*blocks)[(*n)++];
+}
+
+/* write the current data section as a fixedStep section */
+static void bw_flush_section(BigWig *bw) {
+  unsigned char *p = bw->buf;
+  uint32_t chrom = bw->nchroms - 1;
+  BigWigBlock *b;
+  int i;
+
+  if (bw->nvals == 0) return;
+  p = bw_put32(p, chrom);
+  p = bw_put32(p, bw->sec_start);
+  p = bw_put32(p, bw->sec_start + bw->nvals);
+  p = bw_put32(p, 1);		/* step */
+  p = bw_put32(p, 1);		/* span */
+  *p++ = BW_FIXED_STEP;
+  *p++ = 0;
+  p = bw_put16(p, bw->nvals);
+  for (i = 0; i < bw->nvals; i++)
+    p = bw_put_flt(p, bw->vals[i]);
+
+  b = bw_new_block(&bw->blocks, &bw->nblocks, &bw->blocks_alloc);
+  b->start_chrom = b->end_chrom = chrom;
+  b->start = bw->sec_start;
+  b->end = bw->sec_start + bw->nvals;
+  b->offset = bw_tell(bw->F);
+  b->size = bw_write_block(bw, bw->F, p - bw->buf);
+  bw->nvals = 0;
+}
+
+/* write the completed records of a zoom level to the temporary file */
+static void bw_zoom_write_block(BigWig *bw, BigWigZoom *zm) {
+  unsigned char *p = bw->buf;
+  BigWigBlock *b;
+  int i;
+
+  if (zm->nrecs == 0) return;
+  for (i = 0; i < zm->nrecs; i++) {
+    BigWigSummary *s = &zm->recs[i];
+    p = bw_put32(p, s->chrom);
+    p = bw_put32(p, s->start);
+    p = bw_put32(p, s->end);
+    p = bw_put32(p, s->count);
+    p = bw_put_flt(p, (float)s->min);
+    p = bw_put_flt(p, (float)s->max);
+    p = bw_put_flt(p, (float)s->sum);
+    p = bw_put_flt(p, (float)s->sumsq);
+  }
+  b = bw_new_block(&zm->blocks, &zm->nblocks, &zm->blocks_alloc);
+  b->start_chrom = zm->recs[0].chrom;
+  b->start = zm->recs[0].start;
+  b->end_chrom = zm->recs[zm->nrecs-1].chrom;
+  b->end = zm->recs[zm->nrecs-1].end;
+  b->offset = bw_tell(bw->zoomF);
+  b->size = bw_write_block(bw, bw->zoomF, p - bw->buf);
+  zm->nrecs = 0;
+}
+
+/* move the record being accumulated to the completed records */
+static void bw_zoom_flush(BigWig *bw, BigWigZoom *zm) {
+  if (zm->cur.count == 0) return;
+  zm->recs[zm->nrecs++] = zm->cur;
+  zm->total++;
+  zm->cur.count = 0;
+  if (zm->nrecs == BW_ITEMS_PER_SLOT)
+    bw_zoom_write_block(bw, zm);
+}
+
+static void bw_zoom_add(BigWig *bw, BigWigZoom *zm, uint32_t chrom,
+			uint32_t pos, double val) {
+  BigWigSummary *s = &zm->cur;
+  if (s->count > 0 && (s->chrom != chrom ||
+		       s->start / zm->reduction != pos / zm->reduction))
+    bw_zoom_flush(bw, zm);
+  if (s->count == 0) {
+    s->chrom = chrom;
+    s->start = pos;
+    s->min = s->max = val;
+    s->sum = s->sumsq = 0;
+  }
+  s->end = pos + 1;
+  s->count++;
+  if (val < s->min) s->min = val;
+  if (val > s->max) s->max = val;
+  s->sum += val;
+  s->sumsq += val * val;
+}
+
+void bw_add(BigWig *bw, const char *chrom, phast_pos pos, double val) {
+  int c = bw->nchroms - 1, i, z;
+  uint32_t p;
+
+  if (pos < 1 || pos > UINT32_MAX)
+    die("ERROR: bad position for bigWig output (%s:%" PHAST_POS_FMT ")\n", chrom, pos);
+  p = (uint32_t)(pos - 1);
+
+  if (c < 0 || strcmp(bw->chroms[c], chrom) != 0) {
+    for (i = 0; i < bw->nchroms; i++)
+      if (strcmp(bw->chroms[i], chrom) == 0)
+	die("ERROR: bigWig output must be grouped by chromosome (%s)\n",
+	    chrom);
+    bw_flush_section(bw);
+    if (bw->nchroms == bw->chroms_alloc) {
+      bw->chroms_alloc *= 2;
+      bw->chroms = srealloc(bw->chroms, bw->chroms_alloc * sizeof(char*));
+      bw->sizes = srealloc(bw->sizes, bw->chroms_alloc * sizeof(uint32_t));
+    }
+    c = bw->nchroms++;
+    bw->chroms[c] = copy_charstr(chrom);
+    bw->sizes[c] = 0;
+  }
+  else if (p < bw->sizes[c])
+    die("ERROR: bigWig output must be sorted by position (%s:%" PHAST_POS_FMT ")\n",
+	chrom, pos);
+
+  if (bw->nvals > 0 && (p != bw->sec_start + bw->nvals ||
+			bw->nvals == BW_ITEMS_PER_SLOT))
+    bw_flush_section(bw);
+  if (bw->nvals == 0) bw->sec_start = p;
+  bw->vals[bw->nvals++] = (float)val;
+  bw->sizes[c] = p + 1;
+
+  /* summaries use the value as stored */
+  val = (double)(float)val;
+  if (bw->bases == 0 || val < bw->min) bw->min = val;
+  if (bw->bases == 0 || val > bw->max) bw->max = val;
+  bw->bases++;
+  bw->sum += val;
+  bw->sumsq += val * val;
+  for (z = 0; z < BW_NZOOM; z++)
+    bw_zoom_add(bw, &bw->zoom[z], c, p, val);
+}
+
+/* write a one-level B+ tree mapping chromosome names to ids and sizes */
+static int bw_chrom_compare(const void *a, const void *b) {
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static void bw_write_chrom_tree(BigWig *bw) {
+  char **sorted;
+  char *key;
+  uint32_t keysize = 1;
+  int i, j;
+
+  if (bw->nchroms > UINT16_MAX)
+    die("ERROR: too many chromosomes for bigWig output\n");
+  for (i = 0; i < bw->nchroms; i++)
+    if (strlen(bw->chroms[i]) > keysize) keysize = strlen(bw->chroms[i]);
+
+  bw_write32(bw->F, BW_CHROM_TREE_MAGIC);
+  bw_write32(bw->F, bw->nchroms > 0 ? bw->nchroms : 1);	/* block size */
+  bw_write32(bw->F, keysize);
+  bw_write32(bw->F, 8);		/* value size */
+  bw_write64(bw->F, bw->nchroms);
+  bw_write64(bw->F, 0);
+
+  bw_write8(bw->F, 1);		/* leaf */
+  bw_write8(bw->F, 0);
+  bw_write16(bw->F, bw->nchroms);
+  if (bw->nchroms == 0) return;
+  sorted = smalloc(bw->nchroms * sizeof(char*));
+  for (i = 0; i < bw->nchroms; i++) sorted[i] = bw->chroms[i];
+  qsort(sorted, bw->nchroms, sizeof(char*), bw_chrom_compare);
+  key = smalloc(keysize);
+  for (i = 0; i < bw->nchroms; i++) {
+    memset(key, 0, keysize);
+    memcpy(key, sorted[i], strlen(sorted[i]));
+    bw_write(bw->F, key, keysize);
+    for (j = 0; bw->chroms[j] != sorted[i]; j++);
+    bw_write32(bw->F, j);
+    bw_write32(bw->F, bw->sizes[j]);
+  }
+  sfree(key);
+  sfree(sorted);
+}
+
+/* write an R-tree index of blocks (sorted by position).  Nodes are
+   written level by level from the root down, and all but the last
+   node of each level are full, so the offset of every node follows
+   from its index */
+static void bw_write_index(FILE *F, BigWigBlock *blocks, int n,
+			   uint64_t end_offset) {
+  int nnodes[32], nitems[32], nlevels, l, j, k, count;
+  uint64_t level_start[32], pos;
+  BigWigBlock *bounds[32], *child;
+
+  bw_write32(F, BW_INDEX_MAGIC);
+  bw_write32(F, BW_BLOCK_SIZE);
+  bw_write64(F, n);
+  bw_write32(F, n > 0 ? blocks[0].start_chrom : 0);
+  bw_write32(F, n > 0 ? blocks[0].start : 0);
+  bw_write32(F, n > 0 ? blocks[n-1].end_chrom : 0);
+  bw_write32(F, n > 0 ? blocks[n-1].end : 0);
+  bw_write64(F, end_offset);
+  bw_write32(F, BW_ITEMS_PER_SLOT);
+  bw_write32(F, 0);
+
+  if (n == 0) {			/* empty root */
+    bw_write8(F, 1);
+    bw_write8(F, 0);
+    bw_write16(F, 0);
+    return;
+  }
+
+  /* level 0 holds the leaves; higher levels summarize the one below */
+  nitems[0] = n;
+  nnodes[0] = (n + BW_BLOCK_SIZE - 1) / BW_BLOCK_SIZE;
+  for (nlevels = 1; nnodes[nlevels-1] > 1; nlevels++) {
+    nitems[nlevels] = nnodes[nlevels-1];
+    nnodes[nlevels] = (nitems[nlevels] + BW_BLOCK_SIZE - 1) / BW_BLOCK_SIZE;
+  }
+  for (l = 0; l < nlevels; l++) {
+    BigWigBlock *below = (l == 0 ? blocks : bounds[l-1]);
+    bounds[l] = smalloc(nnodes[l] * sizeof(BigWigBlock));
+    for (j = 0; j < nnodes[l]; j++) {
+      count = min(BW_BLOCK_SIZE, nitems[l] - j * BW_BLOCK_SIZE);
+      bounds[l][j] = below[j * BW_BLOCK_SIZE];
+      bounds[l][j].end_chrom = below[j * BW_BLOCK_SIZE + count - 1].end_chrom;
+      bounds[l][j].end = below[j * BW_BLOCK_SIZE + count - 1].end;
+    }
+  }
+  pos = bw_tell(F);
+  for (l = nlevels - 1; l >= 0; l--) {
+    level_start[l] = pos;
+    pos += (uint64_t)nnodes[l] * 4 + (uint64_t)nitems[l] *
+      (l == 0 ? BW_LEAF_ITEM_SIZE : BW_NODE_ITEM_SIZE);
+  }
+
+  for (l = nlevels - 1; l >= 0; l--) {
+    for (j = 0; j < nnodes[l]; j++) {
+      count = min(BW_BLOCK_SIZE, nitems[l] - j * BW_BLOCK_SIZE);
+      bw_write8(F, l == 0);
+      bw_write8(F, 0);
+      bw_write16(F, count);
+      for (k = j * BW_BLOCK_SIZE; k < j * BW_BLOCK_SIZE + count; k++) {
+	child = (l == 0 ? &blocks[k] : &bounds[l-1][k]);
+	bw_write32(F, child->start_chrom);
+	bw_write32(F, child->start);
+	bw_write32(F, child->end_chrom);
+	bw_write32(F, child->end);
+	if (l == 0) {
+	  bw_write64(F, child->offset);
+	  bw_write64(F, child->size);
+	}
+	else
+	  bw_write64(F, level_start[l-1] + (uint64_t)k *
+		     (4 + BW_BLOCK_SIZE * (l == 1 ? BW_LEAF_ITEM_SIZE :
+					   BW_NODE_ITEM_SIZE)));
+      }
+    }
+  }
+  for (l = 0; l < nlevels; l++) sfree(bounds[l]);
+}
+
+void bw_set_chrom_size(BigWig *bw, const char *chrom, phast_pos size) {
+  uint32_t *val = hsh_get(bw->chrom_sizes, chrom);
+
+  if (size < 0 || size > UINT32_MAX)
+    die("ERROR: bad chromosome size for bigWig output (%s:%" PHAST_POS_FMT ")\n", chrom,
+	size);
+  if (val == (void*)-1) {
+    val = smalloc(sizeof(uint32_t));
+    *val = 0;
+    hsh_put(bw->chrom_sizes, chrom, val);
+  }
+  if ((uint32_t)size > *val) *val = (uint32_t)size;
+}
+
+void bw_close(BigWig *bw) {
+  uint64_t data_end, chrom_tree_offset, index_offset,
+    zoom_data[BW_NZOOM], zoom_index[BW_NZOOM];
+  uint32_t max_size = 0;
+  int nzoom, z, i;
+
+  bw_flush_section(bw);
+  for (z = 0; z < BW_NZOOM; z++) {
+    bw_zoom_flush(bw, &bw->zoom[z]);
+    bw_zoom_write_block(bw, &bw->zoom[z]);
+  }
+
+  for (i = 0; i < bw->nchroms; i++) {
+    uint32_t *size = hsh_get(bw->chrom_sizes, bw->chroms[i]);
+    if (size != (void*)-1 && *size > bw->sizes[i]) bw->sizes[i] = *size;
+  }
+
+  data_end = bw_tell(bw->F);
+  chrom_tree_offset = data_end;
+  bw_write_chrom_tree(bw);
+  index_offset = bw_tell(bw->F);
+  bw_write_index(bw->F, bw->blocks, bw->nblocks, data_end);
+
+  /* keep zoom levels that are coarser than the data but not coarser
+     than the largest chromosome */
+  for (i = 0; i < bw->nchroms; i++)
+    if (bw->sizes[i] > max_size) max_size = bw->sizes[i];
+  for (nzoom = 1; nzoom < BW_NZOOM &&
+	 bw->zoom[nzoom].reduction < max_size; nzoom++);
+
+  for (z = 0; z < nzoom; z++) {
+    BigWigZoom *zm = &bw->zoom[z];
+    zoom_data[z] = bw_tell(bw->F);
+    bw_write32(bw->F, zm->total);
+    for (i = 0; i < zm->nblocks; i++) {
+      BigWigBlock *b = &zm->blocks[i];
+      bw_seek(bw->zoomF, b->offset);
+      if (fread(bw->zbuf, 1, b->size, bw->zoomF) != b->size)
+	die("ERROR: read from temporary bigWig file failed\n");
+      b->offset = bw_tell(bw->F);
+      bw_write(bw->F, bw->zbuf, b->size);
+    }
+    zoom_index[z] = bw_tell(bw->F);
+    bw_write_index(bw->F, zm->blocks, zm->nblocks, zoom_index[z]);
+  }
+  bw_write32(bw->F, BW_MAGIC);
+
+  /* now go back and fill in the header */
+  bw_seek(bw->F, 0);
+  bw_write32(bw->F, BW_MAGIC);
+  bw_write16(bw->F, BW_VERSION);
+  bw_write16(bw->F, nzoom);
+  bw_write64(bw->F, chrom_tree_offset);
+  bw_write64(bw->F, BW_HEADER_SIZE + BW_NZOOM * BW_ZOOM_HEADER_SIZE +
+	     BW_SUMMARY_SIZE);	/* data */
+  bw_write64(bw->F, index_offset);
+  bw_write16(bw->F, 0);		/* field count */
+  bw_write16(bw->F, 0);		/* defined field count */
+  bw_write64(bw->F, 0);		/* autoSql */
+  bw_write64(bw->F, BW_HEADER_SIZE + BW_NZOOM * BW_ZOOM_HEADER_SIZE);
+#ifdef USE_ZLIB
+  bw_write32(bw->F, bw->max_block);
+#else
+  bw_write32(bw->F, 0);		/* uncompressed */
+#endif
+  bw_write64(bw->F, 0);		/* extension */
+  for (z = 0; z < nzoom; z++) {
+    bw_write32(bw->F, bw->zoom[z].reduction);
+    bw_write32(bw->F, 0);
+    bw_write64(bw->F, zoom_data[z]);
+    bw_write64(bw->F, zoom_index[z]);
+  }
+  bw_seek(bw->F, BW_HEADER_SIZE + BW_NZOOM * BW_ZOOM_HEADER_SIZE);
+  bw_write64(bw->F, bw->bases);
+  bw_write_dbl(bw->F, bw->min);
+  bw_write_dbl(bw->F, bw->max);
+  bw_write_dbl(bw->F, bw->sum);
+  bw_write_dbl(bw->F, bw->sumsq);
+  bw_write64(bw->F, bw->nblocks);	/* data count */
+
+  phast_fclose(bw->F);
+  fclose(bw->zoomF);
+  for (i = 0; i < bw->nchroms; i++) sfree(bw->chroms[i]);
+  sfree(bw->chroms);
+  sfree(bw->sizes);
+  hsh_free_with_vals(bw->chrom_sizes);
+  sfree(bw->vals);
+  sfree(bw->blocks);
+  for (z = 0; z < BW_NZOOM; z++) {
+    sfree(bw->zoom[z].recs);
+    sfree(bw->zoom[z].blocks);
+  }
+  sfree(bw->buf);
+  sfree(bw->zbuf);
+  sfree(bw);
+}
@@ -17,7 +17,7 @@
 //this has a conflict with RPHAST
 #undef prec
 
-static int *prec;
+static PHAST_THREAD_LOCAL int *prec;
 
 /* Read a CategoryMap from a file */
 CategoryMap *cm_read(FILE *F) {
@@ -470,6 +470,36 @@ CategoryMap* cm_new_from_features(GFF_Set *feats) {
   return retval;
 }
 
+/* same as cm_new_from_features, for a compact feature set */
+CategoryMap* cm_new_from_compact_features(GFF_CompactSet *feats) {
+  int i, ntypes = 0;
+  CategoryMap *retval;
+  int *types = smalloc(max(lst_size(feats->names), 1) * sizeof(int));
+  char *seen = smalloc(max(lst_size(feats->names), 1) * sizeof(char));
+
+  /* first scan features for all types; names are interned, so an
+     index flag suffices */
+  for (i = 0; i < lst_size(feats->names); i++) seen[i] = FALSE;
+  for (i = 0; i < feats->nfeatures; i++) {
+    checkInterruptN(i, 10000);
+    if (!seen[feats->feature[i]]) {
+      types[ntypes++] = feats->feature[i];
+      seen[feats->feature[i]] = TRUE;
+    }
+  }
+  sfree(seen);
+
+  /* now create a simple category map */
+  retval = cm_new(ntypes);
+  for (i = 0; i <= retval->ncats; i++) {
+    String *type = str_new_charstr(i == 0 ? BACKGD_CAT_NAME : 
+                                   gffc_name(feats, types[i-1]));
+    retval->ranges[i] = cm_new_category_range(type, i, i);
+  }
+  sfree(types);
+  return retval;
+}
+
 /* Create a new category map from a string that can
     either be a filename or a brief "inlined" category map, e.g.,
     "NCATS = 3 ; CDS 1-3".  Useful for command-line arguments. */
@@ -610,12 +640,13 @@ void cm_add_feature_type(CategoryMap *cm, String *type, int cycle_size) {
    a specified category map and mapping from raw state numbers to
    category numbers.  */
 GFF_Set *cm_labeling_as_gff(CategoryMap *cm, int *path, 
-                            int length, int *path_to_cat, 
+                            phast_pos length, int *path_to_cat, 
                             int *reverse_compl, char *seqname, 
                             char *source, List *frame_cats, 
                             char *grouptag,  char *idpref
                             ) {
-  int beg, end, i, cat, frame, groupno;
+  int k, cat, frame, groupno;
+  phast_pos beg, end, i;
   GFF_Set *gff = gff_new_set_init("PHAST", PHAST_VERSION);
   int do_frame[cm->ncats+1];
   char strand;
@@ -625,10 +656,10 @@ GFF_Set *cm_labeling_as_gff(CategoryMap *cm, int *path,
 
   if (length <= 0) return gff;
 
-  for (i = 0; i <= cm->ncats; i++) do_frame[i] = 0;
+  for (k = 0; k <= cm->ncats; k++) do_frame[k] = 0;
   if (frame_cats != NULL)
-    for (i = 0; i < lst_size(frame_cats); i++) {
-      int cat = cm_get_category(cm, lst_get_ptr(frame_cats, i));
+    for (k = 0; k < lst_size(frame_cats); k++) {
+      int cat = cm_get_category(cm, lst_get_ptr(frame_cats, k));
       if (cat != 0)             /* ignore background or unrecognized name */
         do_frame[cat] = 1;
     }
@@ -684,8 +715,9 @@ GFF_Set *cm_labeling_as_gff(CategoryMap *cm, int *path,
 /** maps a sequence (array) of category numbers from the spooled space to
    the unspooled space, using the current unspooler.  Original
    sequence is overwritten */
-void cm_spooled_to_unspooled(CategoryMap *cm, int *path, int pathlen) {
-  int j, sp_state, prev_sp_state;
+void cm_spooled_to_unspooled(CategoryMap *cm, int *path, phast_pos pathlen) {
+  int sp_state, prev_sp_state;
+  phast_pos j;
   List *pred;
 
   if (cm->unspooler == NULL) return;
@@ -694,14 +726,14 @@ void cm_spooled_to_unspooled(CategoryMap *cm, int *path, int pathlen) {
   prev_sp_state = -1;
   for (j = 0; j < pathlen; j++) {
     if (!(path[j] >= 0 && path[j] <= cm->unspooler->nstates_spooled))
-      die("ERROR cm_spooled_to_unspooled: path[%i]=%i, should be in [0, %i]\n",
+      die("ERROR cm_spooled_to_unspooled: path[%" PHAST_POS_FMT "]=%i, should be in [0, %i]\n",
 	  j, path[j], cm->unspooler->nstates_spooled);
 
     sp_state = path[j];
     path[j] = cm_get_unspooled_state(cm, path[j], pred);
 
     if (path[j] == -1) 
-      die("ERROR: failure mapping to uspooled state at position %d.\n", j);
+      die("ERROR: failure mapping to uspooled state at position %" PHAST_POS_FMT ".\n", j);
 
     if (sp_state != prev_sp_state) {
       /* if the current (spooled) state is not conditioned on any
@@ -722,12 +754,12 @@ void cm_spooled_to_unspooled(CategoryMap *cm, int *path, int pathlen) {
 /* maps a sequence (array) of category numbers from the unspooled space to
    the spooled space, using the current unspooler.  Original
    sequence is overwritten */
-void cm_unspooled_to_spooled(CategoryMap *cm, int *path, int pathlen) {
-  int j;
+void cm_unspooled_to_spooled(CategoryMap *cm, int *path, phast_pos pathlen) {
+  phast_pos j;
   if (cm->unspooler == NULL) return;
   for (j = 0; j < pathlen; j++) {
     if (!(path[j] >= 0 && path[j] <= cm->unspooler->nstates_unspooled))
-      die("ERROR cm_unspooled_to_spooled: path[%i]=%i, should be in [0,%i]\n",
+      die("ERROR cm_unspooled_to_spooled: path[%" PHAST_POS_FMT "]=%i, should be in [0,%i]\n",
 	  j, path[j], cm->unspooler->nstates_unspooled);
     path[j] = cm->unspooler->unspooled_to_spooled[path[j]];
   }
@@ -23,8 +23,8 @@ void gff_read_from_genepred(GFF_Set *gff, FILE *F) {
   Hashtable *hash = hsh_new(10000);
 
   while (str_readline(line, F) != EOF) {
-    int txStart = 0, txEnd = 0, cdsStart = 0, cdsEnd = 0, 
-      exonCount = 0, num = 0;
+    phast_pos txStart = 0, txEnd = 0, cdsStart = 0, cdsEnd = 0;
+    int exonCount = 0, num = 0;
     String *name, *chrom, *tmpstr;
     GFF_Feature *f;
     char group[STR_MED_LEN];
@@ -70,10 +70,10 @@ void gff_read_from_genepred(GFF_Set *gff, FILE *F) {
 
     strand = tmpstr->chars[0];
 
-    if (str_as_int(lst_get_ptr(l, 3+hasbin), &txStart) != 0 ||
-        str_as_int(lst_get_ptr(l, 4+hasbin), &txEnd) != 0 ||
-        str_as_int(lst_get_ptr(l, 5+hasbin), &cdsStart) != 0 ||
-        str_as_int(lst_get_ptr(l, 6+hasbin), &cdsEnd) != 0)
+    if (str_as_pos(lst_get_ptr(l, 3+hasbin), &txStart) != 0 ||
+        str_as_pos(lst_get_ptr(l, 4+hasbin), &txEnd) != 0 ||
+        str_as_pos(lst_get_ptr(l, 5+hasbin), &cdsStart) != 0 ||
+        str_as_pos(lst_get_ptr(l, 6+hasbin), &cdsEnd) != 0)
       die("ERROR (line %d): can't parse txStart, txEnd, cdsStart, or cdsEnd in genepred file.\n", lineno);
 
     txStart++; cdsStart++;      /* switch to GFF coord convention */
@@ -105,10 +105,10 @@ void gff_read_from_genepred(GFF_Set *gff, FILE *F) {
 
     lst_clear(framefeats);
     for (i = 0; i < exonCount; i++) {
-      int eStart = 0, eEnd = 0;
+      phast_pos eStart = 0, eEnd = 0;
 
-      if (str_as_int(lst_get_ptr(tmpl1, i), &eStart) != 0 ||
-              str_as_int(lst_get_ptr(tmpl2, i), &eEnd) != 0)
+      if (str_as_pos(lst_get_ptr(tmpl1, i), &eStart) != 0 ||
+              str_as_pos(lst_get_ptr(tmpl2, i), &eEnd) != 0)
         die("ERROR (line %d): can't parse exonStarts or exonEnds in genepred file.\n", lineno);
 
       eStart++;
@@ -145,7 +145,7 @@ void gff_read_from_genepred(GFF_Set *gff, FILE *F) {
       for (i = 0; i < lst_size(framefeats); i++) {
         f = lst_get_ptr(framefeats, i);
         f->frame = frame;
-        frame = ((frame + f->end - f->start + 1) % 3);
+        frame = (int)((frame + f->end - f->start + 1) % 3);
       }
     }
 
@@ -174,7 +174,8 @@ void gff_print_genepred(FILE *OUTF, GFF_Set *feats) {
     die("ERROR: features must be grouped to print as genepred.\n");
 
   for (i = 0; i < lst_size(feats->groups); i++) {
-    int cdsStart = -1, cdsEnd = -1, nexons = 0, ncds_exons = 0;
+    phast_pos cdsStart = -1, cdsEnd = -1;
+    int nexons = 0, ncds_exons = 0;
     char strand = '\0';
     String *seqname = NULL;
     GFF_FeatureGroup *g = lst_get_ptr(feats->groups, i);
@@ -190,9 +191,9 @@ void gff_print_genepred(FILE *OUTF, GFF_Set *feats) {
     for (j = 0; j < lst_size(g->features); j++) {
       GFF_Feature *f = lst_get_ptr(g->features, j);
       if (str_equals_charstr(f->feature, GFF_EXON_TYPE)) {
-        str_append_int(exonStarts, f->start-1);
+        str_append_pos(exonStarts, f->start-1);
         str_append_char(exonStarts, ',');
-        str_append_int(exonEnds, f->end);
+        str_append_pos(exonEnds, f->end);
         str_append_char(exonEnds, ',');
         if (nexons == 0) {
           strand = f->strand;
@@ -206,9 +207,9 @@ void gff_print_genepred(FILE *OUTF, GFF_Set *feats) {
         if (cdsStart == -1) cdsStart = f->start-1;
         if (f->end > cdsEnd) cdsEnd = f->end;
 
-        str_append_int(cdsStarts, f->start-1);
+        str_append_pos(cdsStarts, f->start-1);
         str_append_char(cdsStarts, ',');
-        str_append_int(cdsEnds, f->end);
+        str_append_pos(cdsEnds, f->end);
         str_append_char(cdsEnds, ',');
         if (nexons == 0 && ncds_exons == 0) {
           strand = f->strand;
@@ -221,12 +222,12 @@ void gff_print_genepred(FILE *OUTF, GFF_Set *feats) {
     }
 
     if (nexons > 0)
-      fprintf(OUTF, "%s\t%s\t%c\t%d\t%d\t%d\t%d\t%d\t%s\t%s\n", 
+      fprintf(OUTF, "%s\t%s\t%c\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\t%d\t%s\t%s\n", 
               g->name->chars, seqname->chars, strand, g->start-1, g->end, 
               cdsStart, cdsEnd, nexons, exonStarts->chars, exonEnds->chars);
 
     else if (ncds_exons > 0)    /* this is in case only CDS is specified */
-      fprintf(OUTF, "%s\t%s\t%c\t%d\t%d\t%d\t%d\t%d\t%s\t%s\n", 
+      fprintf(OUTF, "%s\t%s\t%c\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\t%d\t%s\t%s\n", 
               g->name->chars, seqname->chars, strand, g->start-1, g->end, 
               cdsStart, cdsEnd, ncds_exons, cdsStarts->chars, cdsEnds->chars);
 
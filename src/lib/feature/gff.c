@@ -31,7 +31,8 @@
    attribute is the empty string ('').  Columns must be separated by
    tabs.  */
 GFF_Set* gff_read_set(FILE *F) {
-  int start, end, frame, score_is_null, lineno, isGFF = TRUE;
+  int frame, score_is_null, lineno, isGFF = TRUE;
+  phast_pos start, end;
   double score;
   char strand;
   String *attr, *line;
@@ -87,20 +88,20 @@ GFF_Set* gff_read_set(FILE *F) {
     */
     str_split(line, "\t", l);
     if (((lst_size(l) >= 3 && lst_size(l) <= 8) || lst_size(l)==12) &&
-	str_as_int(lst_get_ptr(l, 1), &start)==0 &&
-	str_as_int(lst_get_ptr(l, 2), &end)==0) {
+	str_as_pos(lst_get_ptr(l, 1), &start)==0 &&
+	str_as_pos(lst_get_ptr(l, 2), &end)==0) {
       gff_read_from_bed(set, F);
     } else if ((lst_size(l) >= 10 &&
-		str_as_int(lst_get_ptr(l, 3), &start) == 0 &&
-		str_as_int(lst_get_ptr(l, 4), &end) == 0 &&
-		str_as_int(lst_get_ptr(l, 5), &start) == 0 &&
-		str_as_int(lst_get_ptr(l, 6), &end) == 0) ||
+		str_as_pos(lst_get_ptr(l, 3), &start) == 0 &&
+		str_as_pos(lst_get_ptr(l, 4), &end) == 0 &&
+		str_as_pos(lst_get_ptr(l, 5), &start) == 0 &&
+		str_as_pos(lst_get_ptr(l, 6), &end) == 0) ||
 	       (lst_size(l) >= 11 &&  //this is genepred with bin column
-		str_as_int(lst_get_ptr(l, 0), &start) == 0 &&
-		str_as_int(lst_get_ptr(l, 4), &start) == 0 &&
-		str_as_int(lst_get_ptr(l, 5), &start) == 0 &&
-		str_as_int(lst_get_ptr(l, 6), &start) == 0 &&
-		str_as_int(lst_get_ptr(l, 7), &start) == 0)) {
+		str_as_pos(lst_get_ptr(l, 0), &start) == 0 &&
+		str_as_pos(lst_get_ptr(l, 4), &start) == 0 &&
+		str_as_pos(lst_get_ptr(l, 5), &start) == 0 &&
+		str_as_pos(lst_get_ptr(l, 6), &start) == 0 &&
+		str_as_pos(lst_get_ptr(l, 7), &start) == 0)) {
       isGFF=FALSE;
       gff_read_from_genepred(set, F);
       break;
@@ -135,11 +136,11 @@ GFF_Set* gff_read_set(FILE *F) {
 	die("ERROR at line %d (gff_read_set): minimum of %d columns are required.\n",
 	    lineno, GFF_MIN_NCOLS);
 
-      if (str_as_int(lst_get_ptr(l, 3), &start) != 0)
+      if (str_as_pos(lst_get_ptr(l, 3), &start) != 0)
 	die("ERROR at line %d (gff_read_set): non-numeric 'start' value ('%s').\n",
 	    lineno, ((String*)lst_get_ptr(l, 3))->chars);
 
-      if (str_as_int((String*)lst_get_ptr(l, 4), &end) != 0)
+      if (str_as_pos((String*)lst_get_ptr(l, 4), &end) != 0)
 	die("ERROR at line %d (gff_read_set): non-numeric 'end' value ('%s').\n",
 	    lineno, ((String*)lst_get_ptr(l, 4))->chars);
 
@@ -201,7 +202,8 @@ GFF_Set* gff_read_set(FILE *F) {
    are copied by reference.  Returns newly allocated GFF_Feature
    object. */
 GFF_Feature *gff_new_feature(String *seqname, String *source, String *feature,
-                             int start, int end, double score, char strand,
+                             phast_pos start, phast_pos end, double score, 
+                             char strand,
                              int frame, String *attribute,
                              int score_is_null) {
   GFF_Feature *feat = (GFF_Feature*)smalloc(sizeof(GFF_Feature));
@@ -230,7 +232,8 @@ GFF_Feature *gff_new_feature(String *seqname, String *source, String *feature,
    object. */
 GFF_Feature *gff_new_feature_copy_chars(const char *seqname, const char *source,
 					const char *feature,
-					int start, int end, double score, char strand,
+					phast_pos start, phast_pos end, double score, 
+                                        char strand,
 					int frame, const char *attribute,
 					int score_is_null) {
   GFF_Feature *feat = (GFF_Feature*)smalloc(sizeof(GFF_Feature));
@@ -272,12 +275,12 @@ GFF_Feature *gff_new_feature_genomic_pos(String *position, String *source,
     posre = str_re_new("(chr[_a-zA-Z0-9]+):([0-9]+)-([0-9]+)([-+])?");
 
   if (str_re_match(position, posre, substrs, 4) >= 3) {
-    int start, end;
+    phast_pos start, end;
     char strand= '.';
     String *chr = str_dup(lst_get_ptr(substrs, 1)),
       *tmpstr = lst_get_ptr(substrs, 4);
-    str_as_int(lst_get_ptr(substrs, 2), &start);
-    str_as_int(lst_get_ptr(substrs, 3), &end);
+    str_as_pos(lst_get_ptr(substrs, 2), &start);
+    str_as_pos(lst_get_ptr(substrs, 3), &end);
     if (tmpstr != NULL) strand = tmpstr->chars[0];
     return gff_new_feature(chr, source, feature, start, end, score,
                            strand, frame, attribute, score_is_null);
@@ -413,7 +416,7 @@ void gff_print_feat(FILE *F, GFF_Feature *feat) {
                                    representation to GFF
                                    representation */
 
-  fprintf(F, "%s\t%s\t%s\t%d\t%d\t%s\t%c\t%s\t%s\n",
+  fprintf(F, "%s\t%s\t%s\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\t%s\t%c\t%s\t%s\n",
           feat->seqname->chars, feat->source->chars, feat->feature->chars,
           feat->start, feat->end, score_str, feat->strand, frame_str,
           feat->attribute->chars);
@@ -449,7 +452,7 @@ GFF_Set *gff_copy_set_no_groups(GFF_Set *orig) {
 /* Create a new GFF_Set representing the features in a particular
     coordinate range.  Keeps features such that feat->start >= startcol
     and feat->end <= endcol. */
-GFF_Set *gff_subset_range(GFF_Set *set, int startcol, int endcol,
+GFF_Set *gff_subset_range(GFF_Set *set, phast_pos startcol, phast_pos endcol,
                           int reset_indices) {
   GFF_Set *subset = gff_new_set();
   int i;
@@ -478,7 +481,8 @@ GFF_Set *gff_subset_range(GFF_Set *set, int startcol, int endcol,
 /* Like gff_subset_range, except keep any featuers that
     overlap with range (even if parts of the feature fall outside
     range) **/
-GFF_Set *gff_subset_range_overlap(GFF_Set *set, int startcol, int endcol) {
+GFF_Set *gff_subset_range_overlap(GFF_Set *set, phast_pos startcol, 
+                                  phast_pos endcol) {
   GFF_Set *subset = NULL;
   int i;
 
@@ -507,7 +511,8 @@ GFF_Set *gff_subset_range_overlap(GFF_Set *set, int startcol, int endcol) {
     that there are no overlapping features before this index.  Reset
     startSearchIdx to the first matching feature (or leave it alone if no
     matches).  Stop searching gff when indices in gff exceed endcol */
-GFF_Set *gff_subset_range_overlap_sorted(GFF_Set *set, int startcol, int endcol,
+GFF_Set *gff_subset_range_overlap_sorted(GFF_Set *set, phast_pos startcol, 
+                                         phast_pos endcol,
 					 int *startSearchIdx) {
   GFF_Set *subset = NULL;
   int i;
@@ -581,11 +586,12 @@ int gff_reverse_strand_only(List *features) {
    reverses order of appearance of features.  The features, the
    start_range, and the end_range are all assumed to use the same
    coordinate frame. */
-void gff_reverse_compl(List *features, int start_range, int end_range ) {
+void gff_reverse_compl(List *features, phast_pos start_range, 
+                       phast_pos end_range) {
   int i;
   for (i = 0; i < lst_size(features); i++) {
     GFF_Feature *feat = lst_get_ptr(features, i);
-    int tmp = feat->start;
+    phast_pos tmp = feat->start;
     checkInterruptN(i, 1000);
     feat->start = end_range - feat->end + start_range;
     feat->end = end_range - tmp + start_range;
@@ -607,8 +613,10 @@ int gff_feature_comparator(const void* ptr1, const void* ptr2) {
   GFF_Feature *feat1 = *((GFF_Feature**)ptr1);
   GFF_Feature *feat2 = *((GFF_Feature**)ptr2);
   if (feat1->start != feat2->start)
-    return (feat1->start - feat2->start);
-  return (feat1->end - feat2->end);
+    return (feat1->start < feat2->start ? -1 : 1);
+  if (feat1->end != feat2->end)
+    return (feat1->end < feat2->end ? -1 : 1);
+  return 0;
                                 /* note that this rule has the effect
                                    of putting short features that
                                    overlap the ends of longer ones in
@@ -624,8 +632,10 @@ int gff_group_comparator(const void* ptr1, const void* ptr2) {
     return 0;                   /* just to be safe... */
 
   if (group1->start != group2->start)
-    return (group1->start - group2->start);
-  return (group1->end - group2->end);
+    return (group1->start < group2->start ? -1 : 1);
+  if (group1->end != group2->end)
+    return (group1->end < group2->end ? -1 : 1);
+  return 0;
 }
 
 /* Sort features primarily by start position, and secondarily by end
@@ -932,14 +942,15 @@ void gff_exon_group(GFF_Set *set, char *tag) {
 /** Identify overlapping groups and remove all but the first
    one encountered.  Features must already be grouped. */
 void gff_remove_overlaps(GFF_Set *gff, FILE *discards_f) {
-  int i, j, k, last_end = -1;
+  int i, j, k;
+  phast_pos last_end = -1;
   List *starts, *ends, *scores, *keepers, *discards;
 
   if (gff->groups == NULL)
     die("ERROR: gff_remove_overlaps requires groups.\n");
 
-  starts = lst_new_int(lst_size(gff->groups));
-  ends = lst_new_int(lst_size(gff->groups));
+  starts = lst_new_pos(lst_size(gff->groups));
+  ends = lst_new_pos(lst_size(gff->groups));
   scores = lst_new_dbl(lst_size(gff->groups));
   keepers = lst_new_ptr(lst_size(gff->groups));
   discards = lst_new_ptr(10);   /* handle only a few at a time */
@@ -961,19 +972,19 @@ void gff_remove_overlaps(GFF_Set *gff, FILE *discards_f) {
 
     /* check for overlap */
     if (group->start > last_end) {   /* common case, has to be safe */
-      lst_push_int(starts, group->start);
-      lst_push_int(ends, group->end);
+      lst_push_pos(starts, group->start);
+      lst_push_pos(ends, group->end);
       lst_push_dbl(scores, score);
       lst_push_ptr(keepers, group);
       last_end = group->end;
     }
     else {                      /* have to search list */
-      int list_idx = lst_bsearch_int(starts, group->start);
+      int list_idx = lst_bsearch_pos(starts, group->start);
                                 /* indicates *previous* feature (-1 if
                                    'group' belongs at front of list)  */
-      int prev_end = list_idx >= 0 ? lst_get_int(ends, list_idx) : -1;
-      int next_start = list_idx+1 < lst_size(starts) ?
-        lst_get_int(starts, list_idx+1) : INFTY;
+      phast_pos prev_end = list_idx >= 0 ? lst_get_pos(ends, list_idx) : -1;
+      phast_pos next_start = list_idx+1 < lst_size(starts) ?
+        lst_get_pos(starts, list_idx+1) : POS_INFTY;
       int add_this_group = TRUE;
       lst_clear(discards);
 
@@ -984,12 +995,12 @@ void gff_remove_overlaps(GFF_Set *gff, FILE *discards_f) {
         int minidx, maxidx;
         double altscore = 0;
         for (minidx = list_idx;
-             minidx >= 0 && lst_get_int(ends, minidx) >= group->start;
+             minidx >= 0 && lst_get_pos(ends, minidx) >= group->start;
              minidx--)
           altscore += lst_get_dbl(scores, minidx);
         minidx++;               /* will always go one too far */
         for (maxidx = list_idx + 1;
-             maxidx < lst_size(starts) && lst_get_int(starts, maxidx) <= group->end;
+             maxidx < lst_size(starts) && lst_get_pos(starts, maxidx) <= group->end;
              maxidx++)
           altscore += lst_get_dbl(scores, maxidx);
         maxidx--;
@@ -1013,8 +1024,8 @@ void gff_remove_overlaps(GFF_Set *gff, FILE *discards_f) {
 
       /* add group, if necessary */
       if (add_this_group) {
-        lst_insert_idx_int(starts, list_idx, group->start);
-        lst_insert_idx_int(ends, list_idx, group->end);
+        lst_insert_idx(starts, list_idx, &group->start);
+        lst_insert_idx(ends, list_idx, &group->end);
         lst_insert_idx_dbl(scores, list_idx, score);
         lst_insert_idx_ptr(keepers, list_idx, group);
         if (group->end > last_end) last_end = group->end;
@@ -1210,7 +1221,7 @@ void gff_create_utrs(GFF_Set *feats) {
 
   for (i = 0; i < lst_size(feats->groups); i++) {
     GFF_FeatureGroup *g = lst_get_ptr(feats->groups, i);
-    int cds_start = INFTY, cds_end = -1;
+    phast_pos cds_start = POS_INFTY, cds_end = -1;
     char strand = '\0';
 
     /* first scan for exon features, strand, and start/end of cds */
@@ -1305,7 +1316,8 @@ void gff_create_signals(GFF_Set *feats) {
 
   for (i = 0; i < lst_size(feats->groups); i++) {
     GFF_FeatureGroup *g = lst_get_ptr(feats->groups, i);
-    int cds_start = INFTY, cds_end = -1, trans_start = INFTY, trans_end = -1;
+    phast_pos cds_start = POS_INFTY, cds_end = -1, trans_start = POS_INFTY, 
+      trans_end = -1;
     char strand = '\0';
 
     /* first scan for strand and start/end of cds and transcript */
@@ -1594,7 +1606,7 @@ void gff_clear_set(GFF_Set *gff) {
    If part of feature is out of bounds, start and end
    may be truncated to be in the range [1,maxCoord] (or
    [1, infinity) if maxCoord < 0 */
-void gff_add_offset(GFF_Set *gff, int offset, int maxCoord) {
+void gff_add_offset(GFF_Set *gff, phast_pos offset, phast_pos maxCoord) {
   List *keepers = lst_new_ptr(lst_size(gff->features));
   GFF_Feature *feat;
   int i;
@@ -1812,7 +1824,8 @@ GFF_Set *gff_inverse(GFF_Set *gff, GFF_Set *region0) {
   GFF_Set *region = gff_set_copy(region0), *notGff;
   GFF_Feature *newfeat, *regionFeat, *currFeat;
   GFF_FeatureGroup *regionG, *gffG;
-  int i, g, currStart, currEnd, regionStart, regionEnd, regionIdx;
+  int i, g, regionIdx;
+  phast_pos currStart, currEnd, regionStart, regionEnd;
 
   gff_flatten_mergeAll(region);
   gff_group_by_seqname(region);
@@ -1904,7 +1917,8 @@ GFF_Set *gff_split(GFF_Set *gff, int *maxlen, int nmaxlen, int drop,
 		   int *splitFromRight, int splitFromRight_len) {
   GFF_Set *newgff = gff_new_set();
   GFF_Feature *feat, *newfeat;
-  int i, idx=0, start, end, sidx=0;
+  int i, idx=0, sidx=0;
+  phast_pos start, end;
   for (i=0; i < lst_size(gff->features); i++) {
     checkInterruptN(i, 1000);
     feat = lst_get_ptr(gff->features, i);
@@ -1943,7 +1957,7 @@ GFF_Set *gff_split(GFF_Set *gff, int *maxlen, int nmaxlen, int drop,
 //create GFF_Set by thresholding an array of scores.
 //firstIdx should be 1-based coordinate
 //set feature score to sum of scores in each element
-GFF_Set *gff_from_wig_threshold(char *seqname, int firstIdx,
+GFF_Set *gff_from_wig_threshold(char *seqname, phast_pos firstIdx,
 				double *scores, int numscore,
 				double threshold, char *src, char *featureName) {
   GFF_Set *rv=gff_new_set();
@@ -0,0 +1,710 @@
+/***************************************************************************
+ * PHAST: PHylogenetic Analysis with Space/Time models
+ * Copyright (c) 2002-2005 University of California, 2006-2010 Cornell
+ * University.  All rights reserved.
+ *
+ * This source code is distributed under a BSD-style license.  See the
+ * file LICENSE.txt for details.
+ ***************************************************************************/
+
+/* Compact, column-oriented storage of large feature sets, with an
+   interval index.  See gff_compact.h for details */
+
+#include <gff_compact.h>
+#include <misc.h>
+
+/* size of traversal stack for gffc_overlaps; each level of the
+   implicit interval tree contributes at most two entries */
+#define GFFC_MAX_LEVEL 64
+
+GFF_CompactSet *gffc_new_set(int est_size) {
+  GFF_CompactSet *set = smalloc(sizeof(GFF_CompactSet));
+  if (est_size < GFF_SET_START_SIZE) est_size = GFF_SET_START_SIZE;
+  set->nfeatures = 0;
+  set->alloc = est_size;
+  set->names = lst_new_ptr(100);
+  set->name_idx = hsh_new(1000);
+  set->seqname = smalloc(est_size * sizeof(int));
+  set->source = smalloc(est_size * sizeof(int));
+  set->feature = smalloc(est_size * sizeof(int));
+  set->start = smalloc(est_size * sizeof(phast_pos));
+  set->end = smalloc(est_size * sizeof(phast_pos));
+  set->score = smalloc(est_size * sizeof(double));
+  set->score_is_null = smalloc(est_size * sizeof(char));
+  set->strand = smalloc(est_size * sizeof(char));
+  set->frame = smalloc(est_size * sizeof(signed char));
+  set->attr_offset = smalloc(est_size * sizeof(long));
+  set->attr_alloc = 10 * (long)est_size;
+  set->attr_buf = smalloc(set->attr_alloc * sizeof(char));
+  set->attr_len = 0;
+  set->indexed = FALSE;
+  set->max_end = NULL;
+  set->nseqs = 0;
+  set->seq_first = set->seq_nfeatures = set->seq_max_level = NULL;
+  set->gff_version = str_new(STR_SHORT_LEN);
+  set->source_name = str_new(STR_SHORT_LEN);
+  set->source_version = str_new(STR_SHORT_LEN);
+  set->date = str_new(STR_SHORT_LEN);
+  return set;
+}
+
+void gffc_free_set(GFF_CompactSet *set) {
+  int i;
+  for (i = 0; i < lst_size(set->names); i++)
+    sfree(lst_get_ptr(set->names, i));
+  lst_free(set->names);
+  hsh_free(set->name_idx);
+  sfree(set->seqname);
+  sfree(set->source);
+  sfree(set->feature);
+  sfree(set->start);
+  sfree(set->end);
+  sfree(set->score);
+  sfree(set->score_is_null);
+  sfree(set->strand);
+  sfree(set->frame);
+  sfree(set->attr_offset);
+  sfree(set->attr_buf);
+  if (set->max_end != NULL) sfree(set->max_end);
+  if (set->seq_first != NULL) {
+    sfree(set->seq_first);
+    sfree(set->seq_nfeatures);
+    sfree(set->seq_max_level);
+  }
+  str_free(set->gff_version);
+  str_free(set->source_name);
+  str_free(set->source_version);
+  str_free(set->date);
+  sfree(set);
+}
+
+/* remove all features, retaining string table and metadata */
+static void gffc_clear_set(GFF_CompactSet *set) {
+  set->nfeatures = 0;
+  set->attr_len = 0;
+  set->indexed = FALSE;
+}
+
+int gffc_intern(GFF_CompactSet *set, const char *str) {
+  int idx = hsh_get_int(set->name_idx, str);
+  if (idx < 0) {
+    idx = lst_size(set->names);
+    lst_push_ptr(set->names, copy_charstr(str));
+    hsh_put_int(set->name_idx, str, idx);
+  }
+  return idx;
+}
+
+/* add a feature whose strings have already been interned */
+static int gffc_add_interned(GFF_CompactSet *set, int seqname, int source,
+                             int feature, phast_pos start, phast_pos end, 
+                             double score,
+                             char strand, int frame, const char *attribute,
+                             int score_is_null) {
+  int i, len = strlen(attribute);
+  long attr_src = -1;
+
+  if (!((strand == '+' || strand == '-' || strand == '.') &&
+        (frame == GFF_NULL_FRAME || (0 <= frame && frame <= 2))))
+    die("ERROR gffc_add_feature: bad arguments\n");
+
+  if (set->nfeatures == set->alloc) {
+    set->alloc *= 2;
+    set->seqname = srealloc(set->seqname, set->alloc * sizeof(int));
+    set->source = srealloc(set->source, set->alloc * sizeof(int));
+    set->feature = srealloc(set->feature, set->alloc * sizeof(int));
+    set->start = srealloc(set->start, set->alloc * sizeof(phast_pos));
+    set->end = srealloc(set->end, set->alloc * sizeof(phast_pos));
+    set->score = srealloc(set->score, set->alloc * sizeof(double));
+    set->score_is_null = srealloc(set->score_is_null,
+                                  set->alloc * sizeof(char));
+    set->strand = srealloc(set->strand, set->alloc * sizeof(char));
+    set->frame = srealloc(set->frame, set->alloc * sizeof(signed char));
+    set->attr_offset = srealloc(set->attr_offset, set->alloc * sizeof(long));
+  }
+  if (set->attr_len + len + 1 > set->attr_alloc) {
+    /* attribute may belong to this set (see gffc_add_copy) */
+    if (attribute >= set->attr_buf && 
+        attribute < set->attr_buf + set->attr_len)
+      attr_src = attribute - set->attr_buf;
+    set->attr_alloc = max(2 * set->attr_alloc, set->attr_len + len + 1);
+    set->attr_buf = srealloc(set->attr_buf, set->attr_alloc * sizeof(char));
+    if (attr_src >= 0) attribute = &set->attr_buf[attr_src];
+  }
+
+  i = set->nfeatures++;
+  set->seqname[i] = seqname;
+  set->source[i] = source;
+  set->feature[i] = feature;
+  set->start[i] = start;
+  set->end[i] = end;
+  set->score[i] = score;
+  set->score_is_null[i] = (char)score_is_null;
+  set->strand[i] = strand;
+  set->frame[i] = (signed char)frame;
+  set->attr_offset[i] = set->attr_len;
+  memcpy(&set->attr_buf[set->attr_len], attribute, (len + 1) * sizeof(char));
+  set->attr_len += len + 1;
+  set->indexed = FALSE;
+  return i;
+}
+
+int gffc_add_feature(GFF_CompactSet *set, const char *seqname,
+                     const char *source, const char *feature, 
+                     phast_pos start, phast_pos end, double score, 
+                     char strand, int frame,
+                     const char *attribute, int score_is_null) {
+  int seqname_idx = gffc_intern(set, seqname);
+  int source_idx = gffc_intern(set, source);
+  int feature_idx = gffc_intern(set, feature);
+  return gffc_add_interned(set, seqname_idx, source_idx, feature_idx,
+                           start, end, score, strand, frame, attribute,
+                           score_is_null);
+}
+
+int gffc_add_copy(GFF_CompactSet *dest, GFF_CompactSet *src, int i) {
+  if (dest == src)
+    return gffc_add_interned(dest, src->seqname[i], src->source[i],
+                             src->feature[i], src->start[i], src->end[i],
+                             src->score[i], src->strand[i], src->frame[i],
+                             gffc_attribute(src, i), src->score_is_null[i]);
+  return gffc_add_feature(dest, gffc_name(src, src->seqname[i]),
+                          gffc_name(src, src->source[i]),
+                          gffc_name(src, src->feature[i]), src->start[i],
+                          src->end[i], src->score[i], src->strand[i],
+                          src->frame[i], gffc_attribute(src, i),
+                          src->score_is_null[i]);
+}
+
+void gffc_filter(GFF_CompactSet *set, char *keep) {
+  int i, n = 0;
+  for (i = 0; i < set->nfeatures; i++) {
+    if (!keep[i]) continue;
+    if (n != i) {
+      set->seqname[n] = set->seqname[i];
+      set->source[n] = set->source[i];
+      set->feature[n] = set->feature[i];
+      set->start[n] = set->start[i];
+      set->end[n] = set->end[i];
+      set->score[n] = set->score[i];
+      set->score_is_null[n] = set->score_is_null[i];
+      set->strand[n] = set->strand[i];
+      set->frame[n] = set->frame[i];
+      set->attr_offset[n] = set->attr_offset[i];
+    }
+    n++;
+  }
+  set->nfeatures = n;
+  set->indexed = FALSE;
+}
+
+void gffc_add_offset(GFF_CompactSet *set, phast_pos offset, 
+                     phast_pos maxCoord) {
+  int i;
+  char *keep = smalloc(max(set->nfeatures, 1) * sizeof(char));
+  for (i = 0; i < set->nfeatures; i++) {
+    checkInterruptN(i, 10000);
+    set->start[i] += offset;
+    set->end[i] += offset;
+    keep[i] = !(set->end[i] < 1 || (maxCoord > 0 && set->start[i] > maxCoord));
+    if (set->start[i] < 1) set->start[i] = 1;
+    if (maxCoord > 0 && set->end[i] > maxCoord) set->end[i] = maxCoord;
+  }
+  gffc_filter(set, keep);
+  sfree(keep);
+}
+
+GFF_CompactSet *gffc_new_from_gff_set(GFF_Set *gff) {
+  int i;
+  GFF_CompactSet *set = gffc_new_set(lst_size(gff->features));
+  str_cpy(set->gff_version, gff->gff_version);
+  str_cpy(set->source_name, gff->source);
+  str_cpy(set->source_version, gff->source_version);
+  str_cpy(set->date, gff->date);
+  for (i = 0; i < lst_size(gff->features); i++) {
+    GFF_Feature *f = lst_get_ptr(gff->features, i);
+    checkInterruptN(i, 10000);
+    gffc_add_feature(set, f->seqname->chars, f->source->chars,
+                     f->feature->chars, f->start, f->end, f->score,
+                     f->strand, f->frame, f->attribute->chars,
+                     f->score_is_null);
+  }
+  return set;
+}
+
+GFF_Feature *gffc_get_feature(GFF_CompactSet *set, int i) {
+  return gff_new_feature_copy_chars(gffc_name(set, set->seqname[i]),
+                                    gffc_name(set, set->source[i]),
+                                    gffc_name(set, set->feature[i]),
+                                    set->start[i], set->end[i],
+                                    set->score[i], set->strand[i],
+                                    set->frame[i], gffc_attribute(set, i),
+                                    set->score_is_null[i]);
+}
+
+GFF_Set *gffc_to_gff_set(GFF_CompactSet *set) {
+  int i;
+  GFF_Set *gff = gff_new_set_len(set->nfeatures);
+  str_cpy(gff->gff_version, set->gff_version);
+  str_cpy(gff->source, set->source_name);
+  str_cpy(gff->source_version, set->source_version);
+  str_cpy(gff->date, set->date);
+  for (i = 0; i < set->nfeatures; i++) {
+    checkInterruptN(i, 10000);
+    lst_push_ptr(gff->features, gffc_get_feature(set, i));
+  }
+  return gff;
+}
+
+/* parse an integer occupying an entire field, as in str_as_int.
+   Returns 0 on success */
+static int gffc_parse_pos(char *s, phast_pos *val) {
+  char *endptr;
+  phast_pos tmp = strtoll(s, &endptr, 0);
+  if (endptr == s) return 1;
+  *val = tmp;
+  return (*endptr == '\0' ? 0 : 2);
+}
+
+/* split a line in place at tabs; fills at most maxfields pointers but
+   returns the total number of fields */
+static int gffc_split_fields(char *line, char **fields, int maxfields) {
+  int n = 0;
+  char *p = line;
+  while (TRUE) {
+    char *tab = strchr(p, '\t');
+    if (n < maxfields) fields[n] = p;
+    n++;
+    if (tab == NULL) break;
+    *tab = '\0';
+    p = tab + 1;
+  }
+  return n;
+}
+
+/* parse a "##tag val1 [val2]" comment into the metadata of a set */
+static void gffc_parse_meta(GFF_CompactSet *set, String *line) {
+  List *l = lst_new_ptr(4);
+  String *tmp = str_new_charstr(&line->chars[2]);
+  String *tag, *val1, *val2;
+
+  str_split(tmp, NULL, l);
+  if (lst_size(l) >= 2) {
+    tag = lst_get_ptr(l, 0);
+    val1 = lst_get_ptr(l, 1);
+    val2 = lst_size(l) > 2 ? lst_get_ptr(l, 2) : NULL;
+    if (str_equals_nocase_charstr(tag, GFF_VERSION_TAG))
+      str_cpy(set->gff_version, val1);
+    else if (str_equals_nocase_charstr(tag, GFF_SOURCE_VERSION_TAG) &&
+             val2 != NULL) {
+      str_cpy(set->source_name, val1);
+      str_cpy(set->source_version, val2);
+    }
+    else if (str_equals_nocase_charstr(tag, GFF_DATE_TAG))
+      str_cpy(set->date, val1);
+  }
+  lst_free_strings(l);
+  lst_free(l);
+  str_free(tmp);
+}
+
+/* whether the first non-comment line of a file looks like GFF rather
+   than one of the other formats recognized by gff_read_set */
+static int gffc_is_gff_line(String *line) {
+  char *fields[GFF_NCOLS];
+  int n;
+  phast_pos tmp;
+  String *copy = str_dup(line);
+  int retval;
+
+  n = gffc_split_fields(copy->chars, fields, GFF_NCOLS);
+  retval = (n >= GFF_MIN_NCOLS &&
+            gffc_parse_pos(fields[3], &tmp) == 0 &&
+            gffc_parse_pos(fields[4], &tmp) == 0 &&
+            !(gffc_parse_pos(fields[1], &tmp) == 0 &&
+              gffc_parse_pos(fields[2], &tmp) == 0));
+  str_free(copy);
+  return retval;
+}
+
+GFF_CompactSet *gffc_read_set(FILE *F) {
+  phast_pos start = 0, end = 0, frame;
+  int score_is_null, lineno = 0, nfields;
+  double score;
+  char strand, *endptr, *fields[GFF_NCOLS];
+  String *line = str_new(STR_LONG_LEN);
+  GFF_CompactSet *set = gffc_new_set(GFF_SET_START_SIZE);
+
+  /* scan header comments; if the first non-comment line is not GFF,
+     defer to gff_read_set */
+  while (str_peek_next_line(line, F) != EOF) {
+    str_double_trim(line);
+    if (str_starts_with_charstr(line, "##"))
+      gffc_parse_meta(set, line);
+    if (line->length == 0 || line->chars[0] == '#') {
+      str_readline(line, F);
+      lineno++;
+      continue;
+    }
+    if (!gffc_is_gff_line(line)) {
+      GFF_Set *gff = gff_read_set(F);
+      gffc_free_set(set);
+      set = gffc_new_from_gff_set(gff);
+      gff_free_set(gff);
+      str_free(line);
+      return set;
+    }
+    break;
+  }
+
+  while (str_readline(line, F) != EOF) {
+    checkInterruptN(lineno, 10000);
+    lineno++;
+
+    str_double_trim(line);
+    if (line->length == 0) continue;
+    if (line->chars[0] == '#') continue; /* just skip ordinary comments */
+
+    nfields = gffc_split_fields(line->chars, fields, GFF_NCOLS);
+
+    if (nfields < GFF_MIN_NCOLS)
+      die("ERROR at line %d (gffc_read_set): minimum of %d columns are required.\n",
+          lineno, GFF_MIN_NCOLS);
+
+    if (gffc_parse_pos(fields[3], &start) != 0)
+      die("ERROR at line %d (gffc_read_set): non-numeric 'start' value ('%s').\n",
+          lineno, fields[3]);
+
+    if (gffc_parse_pos(fields[4], &end) != 0)
+      die("ERROR at line %d (gffc_read_set): non-numeric 'end' value ('%s').\n",
+          lineno, fields[4]);
+
+    score = 0;
+    score_is_null = 1;
+    if (nfields > 5 && strcmp(fields[5], ".") != 0) {
+      score = strtod(fields[5], &endptr);
+      if (endptr == fields[5] || *endptr != '\0')
+        die("ERROR at line %d (gffc_read_set): non-numeric and non-null 'score' value ('%s').\n",
+            lineno, fields[5]);
+      score_is_null = 0;
+    }
+
+    strand = '.';
+    if (nfields > 6) {
+      if (strlen(fields[6]) != 1 ||
+          (fields[6][0] != '+' && fields[6][0] != '-' && fields[6][0] != '.'))
+        die("ERROR at line %d: illegal 'strand' ('%s').\n",
+            lineno, fields[6]);
+      strand = fields[6][0];
+    }
+
+    frame = GFF_NULL_FRAME;
+    if (nfields > 7 && strcmp(fields[7], ".") != 0) {
+      if (gffc_parse_pos(fields[7], &frame) != 0 || frame < 0 || frame > 2)
+        die("ERROR at line %d: illegal 'frame' ('%s').\n",
+            lineno, fields[7]);
+      frame = (3 - frame) % 3;  /* convert to internal representation */
+    }
+
+    gffc_add_feature(set, fields[0], fields[1], fields[2], start, end, score,
+                     strand, (int)frame, nfields > 8 ? fields[8] : "",
+                     score_is_null);
+  }
+
+  str_free(line);
+  return set;
+}
+
+void gffc_print_feat(FILE *F, GFF_CompactSet *set, int i) {
+  char score_str[50], frame_str[50];
+
+  if (set->score_is_null[i]) strcpy(score_str, ".");
+  else sprintf(score_str, "%.3f", set->score[i]);
+
+  if (set->frame[i] == GFF_NULL_FRAME) strcpy(frame_str, ".");
+  else sprintf(frame_str, "%d", (3 - set->frame[i]) % 3);
+
+  fprintf(F, "%s\t%s\t%s\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\t%s\t%c\t%s\t%s\n",
+          gffc_name(set, set->seqname[i]), gffc_name(set, set->source[i]),
+          gffc_name(set, set->feature[i]), set->start[i], set->end[i],
+          score_str, set->strand[i], frame_str, gffc_attribute(set, i));
+}
+
+void gffc_print_set(FILE *F, GFF_CompactSet *set) {
+  int i;
+
+  if (set->gff_version->length > 0)
+    fprintf(F, "##%s %s\n", GFF_VERSION_TAG, set->gff_version->chars);
+
+  if (set->source_version->length > 0)
+    fprintf(F, "##%s %s %s\n", GFF_SOURCE_VERSION_TAG,
+            set->source_name->chars, set->source_version->chars);
+
+  if (set->date->length > 0)
+    fprintf(F, "##%s %s\n", GFF_DATE_TAG, set->date->chars);
+
+  for (i = 0; i < set->nfeatures; i++) {
+    checkInterruptN(i, 10000);
+    gffc_print_feat(F, set, i);
+  }
+}
+
+/* sort key for gffc_index */
+typedef struct {
+  int seqname;
+  phast_pos start, end;
+  int idx;
+} GFFC_SortKey;
+
+static int gffc_sort_key_compare(const void *ptr1, const void *ptr2) {
+  const GFFC_SortKey *k1 = ptr1, *k2 = ptr2;
+  if (k1->seqname != k2->seqname) return k1->seqname - k2->seqname;
+  if (k1->start != k2->start) return (k1->start < k2->start ? -1 : 1);
+  if (k1->end != k2->end) return (k1->end < k2->end ? -1 : 1);
+  return k1->idx - k2->idx;     /* keep sort stable */
+}
+
+/* apply a permutation to a per-feature array; perm[i] is the old
+   index of the feature that is to be placed at index i */
+static void *gffc_permute(void *arr, size_t size, int *perm, int n) {
+  char *new_arr = smalloc((n > 0 ? n : 1) * size);
+  int i;
+  for (i = 0; i < n; i++)
+    memcpy(&new_arr[i * size], &((char*)arr)[perm[i] * size], size);
+  sfree(arr);
+  return new_arr;
+}
+
+/* build an implicit augmented interval tree over n features sorted
+   by start, beginning at index first.  Nodes are array positions; a
+   node at level k (k trailing 1 bits) has children at +/- 2^(k-1),
+   and max_end holds the largest end in its subtree.  Returns the
+   level of the root */
+static int gffc_index_block(GFF_CompactSet *set, int first, int n) {
+  int i, k, last_i = 0;
+  phast_pos last = 0;
+  phast_pos *end = &set->end[first], *max_end = &set->max_end[first];
+
+  if (n == 0) return -1;
+  for (i = 0; i < n; i += 2) {  /* leaves */
+    last_i = i;
+    last = max_end[i] = end[i];
+  }
+  for (k = 1; 1 << k <= n; k++) { /* internal nodes, bottom up */
+    int x = 1 << (k-1), i0 = (x << 1) - 1, step = x << 2;
+    for (i = i0; i < n; i += step) {
+      phast_pos el = max_end[i - x];
+      phast_pos er = i + x < n ? max_end[i + x] : last;
+      phast_pos e = end[i];
+      if (el > e) e = el;
+      if (er > e) e = er;
+      max_end[i] = e;
+    }
+    /* move last_i to parent of rightmost node */
+    last_i = (last_i >> k & 1) ? last_i - x : last_i + x;
+    if (last_i < n && max_end[last_i] > last)
+      last = max_end[last_i];
+  }
+  return k - 1;
+}
+
+void gffc_index(GFF_CompactSet *set) {
+  int i, n = set->nfeatures;
+  GFFC_SortKey *keys;
+  int *perm;
+
+  if (set->indexed) return;
+
+  keys = smalloc((n > 0 ? n : 1) * sizeof(GFFC_SortKey));
+  perm = smalloc((n > 0 ? n : 1) * sizeof(int));
+  for (i = 0; i < n; i++) {
+    keys[i].seqname = set->seqname[i];
+    keys[i].start = set->start[i];
+    keys[i].end = set->end[i];
+    keys[i].idx = i;
+  }
+  qsort(keys, n, sizeof(GFFC_SortKey), gffc_sort_key_compare);
+  for (i = 0; i < n; i++) perm[i] = keys[i].idx;
+  sfree(keys);
+
+  set->seqname = gffc_permute(set->seqname, sizeof(int), perm, n);
+  set->source = gffc_permute(set->source, sizeof(int), perm, n);
+  set->feature = gffc_permute(set->feature, sizeof(int), perm, n);
+  set->start = gffc_permute(set->start, sizeof(phast_pos), perm, n);
+  set->end = gffc_permute(set->end, sizeof(phast_pos), perm, n);
+  set->score = gffc_permute(set->score, sizeof(double), perm, n);
+  set->score_is_null = gffc_permute(set->score_is_null, sizeof(char), perm, n);
+  set->strand = gffc_permute(set->strand, sizeof(char), perm, n);
+  set->frame = gffc_permute(set->frame, sizeof(signed char), perm, n);
+  set->attr_offset = gffc_permute(set->attr_offset, sizeof(long), perm, n);
+  set->alloc = max(n, 1);
+  sfree(perm);
+
+  /* find block of features for each seqname and index it */
+  if (set->max_end != NULL) sfree(set->max_end);
+  if (set->seq_first != NULL) {
+    sfree(set->seq_first);
+    sfree(set->seq_nfeatures);
+    sfree(set->seq_max_level);
+  }
+  set->max_end = smalloc(set->alloc * sizeof(phast_pos));
+  set->nseqs = lst_size(set->names);
+  set->seq_first = smalloc((set->nseqs + 1) * sizeof(int));
+  set->seq_nfeatures = smalloc((set->nseqs + 1) * sizeof(int));
+  set->seq_max_level = smalloc((set->nseqs + 1) * sizeof(int));
+  for (i = 0; i < set->nseqs; i++) {
+    set->seq_first[i] = set->seq_nfeatures[i] = 0;
+    set->seq_max_level[i] = -1;
+  }
+  for (i = 0; i < n; i++) {
+    int s = set->seqname[i];
+    if (set->seq_nfeatures[s]++ == 0) set->seq_first[s] = i;
+  }
+  for (i = 0; i < set->nseqs; i++)
+    set->seq_max_level[i] = gffc_index_block(set, set->seq_first[i],
+                                             set->seq_nfeatures[i]);
+
+  set->indexed = TRUE;
+}
+
+int gffc_overlaps(GFF_CompactSet *set, const char *seqname, 
+                  phast_pos start, phast_pos end, List *result) {
+  struct { int x, k, w; } stack[GFFC_MAX_LEVEL], z;
+  int s, n, first, t = 0, count = 0;
+  phast_pos *st, *en, *mx;
+
+  gffc_index(set);
+  s = hsh_get_int(set->name_idx, seqname);
+  if (s < 0 || s >= set->nseqs || set->seq_nfeatures[s] == 0) return 0;
+
+  first = set->seq_first[s];
+  n = set->seq_nfeatures[s];
+  st = &set->start[first];
+  en = &set->end[first];
+  mx = &set->max_end[first];
+
+  /* top-down traversal; visits overlapping features in order */
+  stack[t].k = set->seq_max_level[s];
+  stack[t].x = (1 << stack[t].k) - 1;
+  stack[t++].w = 0;
+  while (t > 0) {
+    z = stack[--t];
+    if (z.k <= 3) {             /* small subtree; scan all nodes */
+      int i, i0 = z.x >> z.k << z.k, i1 = i0 + (1 << (z.k+1)) - 1;
+      if (i1 >= n) i1 = n;
+      for (i = i0; i < i1 && st[i] <= end; i++)
+        if (en[i] >= start) {
+          lst_push_int(result, first + i);
+          count++;
+        }
+    }
+    else if (z.w == 0) {        /* left child not yet processed */
+      int y = z.x - (1 << (z.k-1));
+      stack[t].k = z.k;
+      stack[t].x = z.x;
+      stack[t++].w = 1;
+      if (y >= n || mx[y] >= start) {
+        stack[t].k = z.k - 1;
+        stack[t].x = y;
+        stack[t++].w = 0;
+      }
+    }
+    else if (z.x < n && st[z.x] <= end) {
+      if (en[z.x] >= start) {
+        lst_push_int(result, first + z.x);
+        count++;
+      }
+      stack[t].k = z.k - 1;     /* right child */
+      stack[t].x = z.x + (1 << (z.k-1));
+      stack[t++].w = 0;
+    }
+  }
+  return count;
+}
+
+GFF_CompactSet *gffc_overlap_gff(GFF_CompactSet *gff,
+                                 GFF_CompactSet *filter_gff,
+                                 int numbaseOverlap, double percentOverlap,
+                                 int nonOverlapping, int overlappingFragments,
+                                 GFF_CompactSet *overlapping_frags) {
+  int i, j, k, f;
+  phast_pos numbase, overlap_total, overlapStart, overlapEnd,
+    currOverlapStart, currOverlapEnd;
+  double frac;
+  GFF_CompactSet *rv = gffc_new_set(GFF_SET_START_SIZE);
+  List *hits = lst_new_int(100);
+
+  if (nonOverlapping && overlappingFragments)
+    die("gffc_overlap_gff cannot be used with non-overlapping and overlappingFragments");
+  if (numbaseOverlap <= 0 && percentOverlap <= 0)
+    die("either numbaseOverlap should be >=1 or percentOverlap should be in (0, 1)");
+  if (overlapping_frags != NULL && !overlappingFragments)
+    phast_warning("overlapping_frags arg only used when overlappingFragments==TRUE");
+
+  gffc_index(gff);
+  gffc_index(filter_gff);
+  if (overlapping_frags != NULL)
+    gffc_clear_set(overlapping_frags);
+
+  for (i = 0; i < gff->nfeatures; i++) {
+    checkInterruptN(i, 1000);
+    lst_clear(hits);
+    gffc_overlaps(filter_gff, gffc_name(gff, gff->seqname[i]),
+                  gff->start[i], gff->end[i], hits);
+
+    if (overlappingFragments) {
+      for (j = 0; j < lst_size(hits); j++) {
+        f = lst_get_int(hits, j);
+        currOverlapStart = max(gff->start[i], filter_gff->start[f]);
+        currOverlapEnd = min(gff->end[i], filter_gff->end[f]);
+        numbase = currOverlapEnd - currOverlapStart + 1;
+        frac = (double)numbase /
+          (double)(filter_gff->end[f] - filter_gff->start[f] + 1);
+        if ((percentOverlap < 0 || frac >= percentOverlap) &&
+            (numbaseOverlap < 0 || numbase >= numbaseOverlap)) {
+          k = gffc_add_copy(rv, gff, i);
+          rv->start[k] = currOverlapStart;
+          rv->end[k] = currOverlapEnd;
+          if (overlapping_frags != NULL)
+            gffc_add_copy(overlapping_frags, filter_gff, f);
+        }
+      }
+      continue;
+    }
+
+    /* total length of union of overlaps; hits are sorted by start */
+    overlapStart = overlapEnd = -1;
+    overlap_total = 0;
+    for (j = 0; j < lst_size(hits); j++) {
+      f = lst_get_int(hits, j);
+      currOverlapStart = max(gff->start[i], filter_gff->start[f]);
+      currOverlapEnd = min(gff->end[i], filter_gff->end[f]);
+      if (overlapEnd != -1 && overlapEnd < currOverlapStart) {
+        overlap_total += (overlapEnd - overlapStart + 1);
+        overlapStart = currOverlapStart;
+        overlapEnd = currOverlapEnd;
+      }
+      else if (overlapEnd != -1) {
+        if (currOverlapEnd > overlapEnd) overlapEnd = currOverlapEnd;
+      }
+      else {
+        overlapStart = currOverlapStart;
+        overlapEnd = currOverlapEnd;
+      }
+    }
+    if (overlapEnd != -1)
+      overlap_total += (overlapEnd - overlapStart + 1);
+    frac = (double)overlap_total / (double)(gff->end[i] - gff->start[i] + 1);
+
+    if ((nonOverlapping == 0 &&
+         (percentOverlap < 0 || frac >= percentOverlap) &&
+         (numbaseOverlap < 0 || overlap_total >= numbaseOverlap)) ||
+        (nonOverlapping &&
+         (percentOverlap < 0 || frac < percentOverlap) &&
+         (numbaseOverlap < 0 || overlap_total < numbaseOverlap)))
+      gffc_add_copy(rv, gff, i);
+  }
+
+  lst_free(hits);
+  return rv;
+}
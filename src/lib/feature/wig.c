@@ -24,11 +24,12 @@
    test a line to see if it is a wig header.
  */
 int wig_parse_header(String *line, int *fixed, char *chrom, 
-		     int *start, int *step, int *span) {
+		     phast_pos *start, int *step, int *span) {
   List *substrs=NULL, *fieldEquals=NULL;
   String *field,  *val;
   int haveChrom=0, haveStart=0, haveStep=0, isValidWig=1, isFixed, 
-    spanVal=1, startVal, stepVal, numfield, i;
+    spanVal=1, stepVal, numfield, i;
+  phast_pos startVal;
   char chromVal[STR_LONG_LEN];
 
   if (str_starts_with_charstr(line, "fixedStep"))
@@ -62,7 +63,7 @@ int wig_parse_header(String *line, int *fixed, char *chrom,
       }
     } else if (str_equals_charstr(field, "start") && isFixed) {
       haveStart = 1;
-      if (0 != str_as_int(val, &startVal)) {
+      if (0 != str_as_pos(val, &startVal)) {
 	isValidWig=0; goto parseHeader_return;
       }
     } else if (str_equals_charstr(field, "step") && isFixed) {
@@ -103,7 +104,8 @@ int wig_parse_header(String *line, int *fixed, char *chrom,
 GFF_Set *gff_read_wig(FILE *F) {
   String *line = str_new(STR_LONG_LEN);
   char chrom[STR_LONG_LEN];
-  int span, fixed, start, step, numfield;
+  int span, fixed, step, numfield;
+  phast_pos start;
   double score;
   GFF_Set *gff = gff_new_set();
   GFF_Feature *newfeat;
@@ -123,7 +125,7 @@ GFF_Set *gff_read_wig(FILE *F) {
 	numfield = str_split(line, NULL, substrs);
 	if (numfield != 2) 
 	  die("Error parsing variableStep wig file, expected 2 fields, got line=%s\n", line->chars);
-	if (0 != str_as_int(lst_get_ptr(substrs, 0), &start))
+	if (0 != str_as_pos(lst_get_ptr(substrs, 0), &start))
 	  die("Error parsing variableStep wig file; first column should be integer in line %s\n", line->chars);
 	if (0 != str_as_dbl(lst_get_ptr(substrs, 1), &score))
 	  die("Error parsing variableStep wig file; second column should be score in line %s\n", line->chars);
@@ -152,7 +154,8 @@ GFF_Set *gff_read_wig(FILE *F) {
 void wig_print(FILE *outfile, GFF_Set *set) {
   GFF_FeatureGroup *group;
   GFF_Feature *feat;
-  int i, j, span=-1, step=-1, lastStart;
+  int i, j, span=-1;
+  phast_pos step=-1, lastStart;
   gff_group_by_seqname(set);
   gff_sort(set);
   
@@ -181,7 +184,7 @@ void wig_print(FILE *outfile, GFF_Set *set) {
     for (j=0; j < lst_size(group->features); j++) {
       feat = lst_get_ptr(group->features, j);
       if (j==0 || lastStart + step != feat->start) {
-	fprintf(outfile, "fixedStep chrom=%s start=%i step=%i",
+	fprintf(outfile, "fixedStep chrom=%s start=%" PHAST_POS_FMT " step=%" PHAST_POS_FMT,
 		feat->seqname->chars, feat->start, step);
 	if (span != 1) fprintf(outfile, " span=%i\n", span);
 	else fprintf(outfile, "\n");
@@ -194,3 +197,123 @@ void wig_print(FILE *outfile, GFF_Set *set) {
 }
 
 	
+
+
+/* Fast equivalent of snprintf(buf, size, "%.*f", digits, val).  Values
+   are rounded by scaling to an integer, which agrees with printf's
+   exact decimal rounding unless the scaled value lies very close to a
+   half-integer; such values, and those too large for the scaled value
+   to be accurate, go to snprintf */
+int wig_format_fixed(char *buf, int size, double val, int digits) {
+  static const double pow10[] = {1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+				 1e8, 1e9};
+  char tmp[32];
+  double x, frac;
+  unsigned long u, ipart, fpart;
+  int n = 0, i, len;
+
+  if (digits < 0 || digits > 9 ||
+      !((x = fabs(val) * pow10[digits]) < 1e9))
+    return snprintf(buf, size, "%.*f", digits, val);
+  frac = x - floor(x);
+  if (fabs(frac - 0.5) < 1e-6)
+    return snprintf(buf, size, "%.*f", digits, val);
+  u = (unsigned long)floor(x + 0.5);
+  ipart = u / (unsigned long)pow10[digits];
+  fpart = u % (unsigned long)pow10[digits];
+
+  /* build the string backwards in tmp */
+  for (i = 0; i < digits; i++) {
+    tmp[n++] = (char)('0' + fpart % 10);
+    fpart /= 10;
+  }
+  if (digits > 0) tmp[n++] = '.';
+  do {
+    tmp[n++] = (char)('0' + ipart % 10);
+    ipart /= 10;
+  } while (ipart > 0);
+  if (signbit(val)) tmp[n++] = '-';	/* printf gives "-0.000" too */
+
+  len = n;
+  if (len > size) return len;
+  for (i = 0; i < len; i++) buf[i] = tmp[--n];
+  return len;
+}
+
+
+WigWriter *wig_writer_new(FILE *F, int digits) {
+  WigWriter *w = smalloc(sizeof(WigWriter));
+  w->F = F;
+  w->bw = NULL;
+  w->digits = digits;
+  w->chrom = str_new(STR_SHORT_LEN);
+  w->next = -1;
+  w->buf = smalloc(WIG_BUFSIZE);
+  w->len = 0;
+  return w;
+}
+
+
+WigWriter *wig_writer_new_bigwig(const char *fname) {
+  WigWriter *w = smalloc(sizeof(WigWriter));
+  w->F = NULL;
+  w->bw = bw_new(fname);
+  w->digits = 0;
+  w->chrom = NULL;
+  w->next = -1;
+  w->buf = NULL;
+  w->len = 0;
+  return w;
+}
+
+
+static void wig_writer_flush(WigWriter *w) {
+  if (w->len > 0 && fwrite(w->buf, 1, w->len, w->F) != (size_t)w->len)
+    die("ERROR: write of wig output failed\n");
+  w->len = 0;
+}
+
+
+void wig_writer_add(WigWriter *w, const char *chrom, phast_pos pos,
+		    double val) {
+  int n;
+
+  if (w->bw != NULL) {
+    bw_add(w->bw, chrom, pos, val);
+    return;
+  }
+
+  if (pos != w->next || !str_equals_charstr(w->chrom, chrom)) {
+    wig_writer_flush(w);
+    fprintf(w->F, "fixedStep chrom=%s start=%" PHAST_POS_FMT " step=1\n", chrom, pos);
+    str_cpy_charstr(w->chrom, chrom);
+  }
+  w->next = pos + 1;
+
+  /* leave room for a typical value; longer ones are retried below */
+  if (w->len > WIG_BUFSIZE - 64) wig_writer_flush(w);
+  n = wig_format_fixed(w->buf + w->len, WIG_BUFSIZE - w->len - 1, val,
+		       w->digits);
+  if (n > WIG_BUFSIZE - w->len - 1) {
+    wig_writer_flush(w);
+    fprintf(w->F, "%.*f\n", w->digits, val);
+    return;
+  }
+  w->len += n;
+  w->buf[w->len++] = '\n';
+}
+
+
+void wig_writer_set_chrom_size(WigWriter *w, const char *chrom,
+			       phast_pos size) {
+  if (w->bw != NULL) bw_set_chrom_size(w->bw, chrom, size);
+}
+
+
+void wig_writer_free(WigWriter *w) {
+  if (w->bw != NULL) bw_close(w->bw);
+  else wig_writer_flush(w);
+  if (w->chrom != NULL) str_free(w->chrom);
+  sfree(w->buf);
+  sfree(w);
+}
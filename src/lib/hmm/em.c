@@ -17,6 +17,9 @@
 #include <sufficient_stats.h>
 #include <fit_em.h>
 #include <sys/time.h>
+#include <thread_pool.h>
+#include <numerical_opt.h>
+#include <profile.h>
 
 /* generic log function: show log likelihood and all HMM transitions
    probs */
@@ -42,6 +45,200 @@ void default_log_function(FILE *logf, double total_logl, HMM *hmm,
   fflush(logf);
 }
 
+/* per-block working storage for the E step.  Training samples are
+   divided into contiguous blocks, one per thread; each block has its
+   own forward/backward matrices and its own expected counts, which
+   are summed in block order after all blocks are done, so results
+   depend on the number of threads but not on scheduling */
+typedef struct {
+  int first_sample, nsamples;   /* samples in block */
+  double **emissions, **forward_scores, **backward_scores;
+  double **A, **tempA, *totalA, **E;
+  double logl;
+  List *val_list;
+  int skip_first;               /* emissions for first sample already
+                                   computed */
+} EmBlock;
+
+/* data shared by all blocks of an E step */
+typedef struct {
+  HMM *hmm;
+  void *models, *data;
+  phast_pos *sample_lens;
+  int nsamples, nobs, it;
+  EmBlock *blocks;
+  void (*compute_emissions)(double**, void**, int, void*, int, phast_pos);
+  int estimate_state_models;
+  int (*get_observation_index)(void*, int, phast_pos);
+  FILE *logf;
+} EmStep;
+
+/* E step for one block of samples: accumulate log likelihood and
+   expected counts of transitions ('A') and emissions ('E') */
+static void em_estep_block(void *data, int job, int thread) {
+  EmStep *es = data;
+  EmBlock *b = &es->blocks[job];
+  HMM *hmm = es->hmm;
+  int k, l, s, obsidx;
+  phast_pos i;
+  double sum, val;
+
+  b->logl = 0;
+  for (k = 0; k < hmm->nstates; k++) {
+    for (l = 0; l < hmm->nstates; l++) 
+      b->A[k][l] = 0;
+    b->totalA[k] = 0;
+  }
+  if (es->estimate_state_models) {
+    for (k = 0; k < hmm->nstates; k++)
+      for (obsidx = 0; obsidx < es->nobs; obsidx++) 
+        b->E[k][obsidx] = 0;
+  }
+
+  for (s = b->first_sample; s < b->first_sample + b->nsamples; s++) {
+    double logp_fw, logp_bw;
+      
+    if (es->compute_emissions == NULL || 
+        (!es->estimate_state_models && es->nsamples == 1 && es->it > 1) ||
+        (s == b->first_sample && b->skip_first))
+      ;			/* no need to compute emissions */
+    else
+      es->compute_emissions(b->emissions, es->models, hmm->nstates, 
+                            es->data, s, es->sample_lens[s]);
+
+    logp_fw = hmm_forward(hmm, b->emissions, es->sample_lens[s], 
+                          b->forward_scores);
+    logp_bw = hmm_backward(hmm, b->emissions, es->sample_lens[s], 
+                           b->backward_scores);
+
+    if (fabs(logp_fw - logp_bw) > 1.0)
+      if (es->logf != NULL) 
+        fprintf(es->logf, "WARNING: forward and backward algorithms returned different total log\nprobabilities (%f and %f, respectively).\n", logp_fw, logp_bw);
+
+    b->logl += logp_fw;
+
+    for (i = 0; i < es->sample_lens[s]; i++) {
+      double this_logp;
+
+      /* to avoid rounding errors, estimate total log prob
+         separately for each column */
+      if (es->estimate_state_models) {
+        lst_clear(b->val_list);
+        for (l = 0; l < hmm->nstates; l++) 
+          lst_push_dbl(b->val_list, (b->forward_scores[l][i] + 
+                                     b->backward_scores[l][i]));
+        this_logp = log_sum(b->val_list);
+        obsidx = es->get_observation_index(es->data, s, i);
+        if (obsidx == -1) continue;
+        for (k = 0; k < hmm->nstates; k++) {
+          /* compute expected number of times each state emits each
+             distinct observation ('E' in Durbin et al.'s notation; see
+             pp. 63-64) */
+          val = exp2(b->forward_scores[k][i] + b->backward_scores[k][i] - 
+                     this_logp);
+          b->E[k][obsidx] += val;
+        }
+      }
+   
+      /* compute expected number of transitions from each state to
+         each other ('A' in Durbin et al.'s notation, pp. 63-64) */
+      if (i != es->sample_lens[s]-1) {
+        int m;
+        /* only transitions with nonzero probability contribute, so
+           use the CSR successor lists (see hmm_reset) */
+        sum = 0.0;
+        for (k = 0; k < hmm->nstates; k++) {
+          for (m = hmm->succ_ptr[k]; m < hmm->succ_ptr[k+1]; m++) {
+            l = hmm->succ_idx[m];
+            val = exp2(b->forward_scores[k][i] + hmm->succ_score[m] + 
+                       b->emissions[l][i+1] + b->backward_scores[l][i+1] - 
+                       logp_fw);
+            /* FIXME: begin and end states? start
+               and end idx */
+            sum += (b->tempA[k][l] = val);
+          }
+        }
+        for (k=0; k < hmm->nstates; k++) {
+          for (m = hmm->succ_ptr[k]; m < hmm->succ_ptr[k+1]; m++) {
+            l = hmm->succ_idx[m];
+            b->A[k][l] += b->tempA[k][l]/sum;
+            b->totalA[k] += b->tempA[k][l]/sum;
+          }
+        }
+      }
+    }
+  }
+}
+
+/* allocate nblocks blocks dividing nsamples samples as evenly as
+   possible; expected emission counts are allocated only if nobs >= 0.
+   If emissions_alloc is non-NULL it is used by the first block */
+static EmBlock *em_blocks_new(HMM *hmm, int nsamples, phast_pos *sample_lens,
+                              int nblocks, phast_pos maxlen, int nobs,
+                              double **emissions_alloc) {
+  EmBlock *blocks = smalloc(nblocks * sizeof(EmBlock));
+  int b, i, k;
+  for (b = 0; b < nblocks; b++) {
+    EmBlock *blk = &blocks[b];
+    blk->first_sample = (int)((long)b * nsamples / nblocks);
+    blk->nsamples = (int)((long)(b+1) * nsamples / nblocks) - 
+      blk->first_sample;
+    blk->forward_scores = (double**)smalloc(hmm->nstates * sizeof(double*));
+    blk->backward_scores = (double**)smalloc(hmm->nstates * sizeof(double*));
+    if (b == 0 && emissions_alloc != NULL)
+      blk->emissions = emissions_alloc;
+    else 
+      blk->emissions = (double**)smalloc(hmm->nstates * sizeof(double*));
+    for (i = 0; i < hmm->nstates; i++){
+      blk->forward_scores[i] = (double*)smalloc(maxlen * sizeof(double));
+      blk->backward_scores[i] = (double*)smalloc(maxlen * sizeof(double));
+      if (blk->emissions != emissions_alloc) 
+        blk->emissions[i] = (double*)smalloc(maxlen * sizeof(double));
+    }
+    blk->A = (double**)smalloc(hmm->nstates * sizeof(double*));
+    blk->tempA = (double**)smalloc(hmm->nstates * sizeof(double*));
+    blk->totalA = (double*)smalloc(hmm->nstates * sizeof(double));
+    for (k = 0; k < hmm->nstates; k++) {
+      blk->A[k] = (double*)smalloc(hmm->nstates * sizeof(double));
+      blk->tempA[k] = (double*)smalloc(hmm->nstates * sizeof(double));
+    }
+    blk->E = NULL;
+    if (nobs >= 0) {
+      blk->E = (double**)smalloc(hmm->nstates * sizeof(double*));
+      for (k = 0; k < hmm->nstates; k++) 
+        blk->E[k] = (double*)smalloc(max(nobs, 1) * sizeof(double));
+    }
+    blk->val_list = lst_new_dbl(hmm->nstates);
+    blk->skip_first = FALSE;
+  }
+  return blocks;
+}
+
+static void em_blocks_free(EmBlock *blocks, int nblocks, int nstates,
+                           double **emissions_alloc) {
+  int b, i;
+  for (b = 0; b < nblocks; b++) {
+    EmBlock *blk = &blocks[b];
+    for (i = 0; i < nstates; i++) {
+      sfree(blk->forward_scores[i]);
+      sfree(blk->backward_scores[i]);
+      if (blk->emissions != emissions_alloc) sfree(blk->emissions[i]);
+      sfree(blk->A[i]);
+      sfree(blk->tempA[i]);
+      if (blk->E != NULL) sfree(blk->E[i]);
+    }
+    sfree(blk->forward_scores);
+    sfree(blk->backward_scores);
+    if (blk->emissions != emissions_alloc) sfree(blk->emissions);
+    sfree(blk->A);
+    sfree(blk->tempA);
+    sfree(blk->totalA);
+    if (blk->E != NULL) sfree(blk->E);
+    lst_free(blk->val_list);
+  }
+  sfree(blocks);
+}
+
 /* hmm and models must be initialized appropriately */
 /* must be one model for every state in the HMM */
 /* the ith training sample in data must be of length 'sample_lens[i]' */
@@ -59,23 +256,55 @@ void default_log_function(FILE *logf, double total_logl, HMM *hmm,
    sense if estimate_state_models == NULL, nsamples == 1, and
    emissions are precomputed & passed in as emissions_alloc */
 double hmm_train_by_em(HMM *hmm, void *models, void *data, int nsamples, 
-                       int *sample_lens, Matrix *pseudocounts, 
+                       phast_pos *sample_lens, Matrix *pseudocounts, 
                        void (*compute_emissions)(double**, void**, int, void*, 
-                                                 int, int), 
+                                                 int, phast_pos), 
                        void (*estimate_state_models)(TreeModel**, int, void*, 
                                                      double**, int, FILE*),
                        void (*estimate_transitions)(HMM*, void*, double**),
-                       int (*get_observation_index)(void*, int, int),
+                       int (*get_observation_index)(void*, int, phast_pos),
                        void (*log_function)(FILE*, double, HMM*, void*, int),
 		       double **emissions_alloc, FILE *logf) { 
+  return hmm_train_by_em_threaded(hmm, models, data, nsamples, sample_lens,
+                                  pseudocounts, compute_emissions, 
+                                  estimate_state_models, estimate_transitions,
+                                  get_observation_index, log_function,
+                                  emissions_alloc, logf, 1, NULL);
+}
 
-  int i, k, l, s, obsidx, nobs=0, maxlen = 0, done, it;
-  double **emissions, **forward_scores, **backward_scores, **E = NULL, **A;
-  double *totalA, **tempA, sum;
-  double total_logl, prev_total_logl, val;
-  List *val_list;
+/* Version of hmm_train_by_em with a parallel E step; samples are
+   divided among up to nthreads threads (see EmBlock above) */
+double hmm_train_by_em_threaded(HMM *hmm, void *models, void *data, 
+                                int nsamples, phast_pos *sample_lens, 
+                                Matrix *pseudocounts, 
+                                void (*compute_emissions)(double**, void**, 
+                                                          int, void*, 
+                                                          int, phast_pos), 
+                                void (*estimate_state_models)(TreeModel**, 
+                                                              int, void*, 
+                                                              double**, int,
+                                                              FILE*),
+                                void (*estimate_transitions)(HMM*, void*, 
+                                                             double**),
+                                int (*get_observation_index)(void*, int, 
+                                                             phast_pos),
+                                void (*log_function)(FILE*, double, HMM*, 
+                                                     void*, int),
+                                double **emissions_alloc, FILE *logf,
+                                int nthreads, EmAccel *accel) { 
+
+  int k, l, s, b, obsidx, nobs=0, done, it, nblocks;
+  phast_pos maxlen = 0;
+  double **E = NULL, **A;
+  double *totalA;
+  double total_logl, prev_total_logl;
+  ThreadPool *tp;
+  EmStep es;
+  OptSquarem *sq = NULL;
+  Vector *accel_params = NULL, *accel_lb = NULL, *accel_ub = NULL;
 
   struct timeval start_time, end_time;
+  PROF_BEGIN(PROF_EM);
 
   if (estimate_state_models != NULL && 
       (get_observation_index == NULL || compute_emissions == NULL))
@@ -92,128 +321,103 @@ double hmm_train_by_em(HMM *hmm, void *models, void *data, int nsamples,
     if (sample_lens[s] > maxlen) 
       maxlen = sample_lens[s];
 
-  forward_scores = (double**)smalloc(hmm->nstates * sizeof(double*));
-  backward_scores = (double**)smalloc(hmm->nstates * sizeof(double*));
-
-  if (emissions_alloc != NULL)
-    emissions = emissions_alloc;
-  else 
-    emissions = (double**)smalloc(hmm->nstates * sizeof(double*));
-
-  for (i = 0; i < hmm->nstates; i++){
-    forward_scores[i] = (double*)smalloc(maxlen * sizeof(double));
-    backward_scores[i] = (double*)smalloc(maxlen * sizeof(double));
-    if (emissions_alloc == NULL) 
-      emissions[i] = (double*)smalloc(maxlen * sizeof(double));
-  }
-  A = (double**)smalloc(hmm->nstates * sizeof(double*));
-  tempA = (double**)smalloc(hmm->nstates * sizeof(double*));
-  totalA = (double*)smalloc(hmm->nstates * sizeof(double));
-  for (k = 0; k < hmm->nstates; k++) {
-    A[k] = (double*)smalloc(hmm->nstates * sizeof(double));
-    tempA[k] = (double*)smalloc(hmm->nstates * sizeof(double));
-  }
-
-  if (estimate_state_models) {
+  if (estimate_state_models)
     nobs = get_observation_index(data, -1, -1); /* this is a bit
                                                    clumsy, but will do
                                                    for now */
-    E = (double**)smalloc(hmm->nstates * sizeof(double*));
+
+  tp = tp_new(nthreads <= 0 ? nthreads : min(nthreads, nsamples));
+  nblocks = min(tp_nthreads(tp), nsamples);
+
+  es.blocks = em_blocks_new(hmm, nsamples, sample_lens, nblocks, maxlen,
+                            estimate_state_models ? nobs : -1, 
+                            emissions_alloc);
+
+  /* with a single block, its counts are used directly */
+  if (nblocks == 1) {
+    A = es.blocks[0].A;
+    totalA = es.blocks[0].totalA;
+    E = es.blocks[0].E;
+  }
+  else {
+    A = (double**)smalloc(hmm->nstates * sizeof(double*));
+    totalA = (double*)smalloc(hmm->nstates * sizeof(double));
     for (k = 0; k < hmm->nstates; k++) 
-      E[k] = (double*)smalloc(nobs * sizeof(double));
+      A[k] = (double*)smalloc(hmm->nstates * sizeof(double));
+    if (estimate_state_models) {
+      E = (double**)smalloc(hmm->nstates * sizeof(double*));
+      for (k = 0; k < hmm->nstates; k++) 
+        E[k] = (double*)smalloc(nobs * sizeof(double));
+    }
   }
 
-  val_list = lst_new_dbl(hmm->nstates);
+  es.hmm = hmm;
+  es.models = models;
+  es.data = data;
+  es.sample_lens = sample_lens;
+  es.nsamples = nsamples;
+  es.nobs = nobs;
+  es.compute_emissions = compute_emissions;
+  es.estimate_state_models = (estimate_state_models != NULL);
+  es.get_observation_index = get_observation_index;
+  es.logf = logf;
+
+  if (accel != NULL) {
+    sq = opt_squarem_new();
+    accel_params = vec_new(1);
+    accel_lb = vec_new(1);
+    accel_ub = vec_new(1);
+  }
 
   prev_total_logl = NEGINFTY;
   done = FALSE;
 
   for (it = 1; !done; it++) {
     checkInterrupt();
-    total_logl = 0;
-
-    /* initialize 'A' and 'E' counts (see below) */
-    for (k = 0; k < hmm->nstates; k++) {
-      for (l = 0; l < hmm->nstates; l++) 
-	A[k][l] = 0;
-      totalA[k] = 0;
-    }
-    if (estimate_state_models != NULL) {
-      for (k = 0; k < hmm->nstates; k++)
-        for (obsidx = 0; obsidx < nobs; obsidx++) 
-	  E[k][obsidx] = 0;
+    es.it = it;
+
+    if (nblocks > 1 && compute_emissions != NULL) {
+      /* compute emissions for the first sample before starting the
+         threads, so that any state the models initialize on first
+         use is set up serially */
+      compute_emissions(es.blocks[0].emissions, models, hmm->nstates,
+                        data, 0, sample_lens[0]);
+      es.blocks[0].skip_first = TRUE;
     }
 
-    for (s = 0; s < nsamples; s++) {
-      double logp_fw, logp_bw;
-      
-      if (compute_emissions == NULL || 
-	  (estimate_state_models == NULL && nsamples == 1 && it > 1))
-	;			/* no need to compute emissions */
-      else
-	compute_emissions(emissions, models, hmm->nstates, data, 
-			  s, sample_lens[s]);
-
-      logp_fw = hmm_forward(hmm, emissions, sample_lens[s], 
-                            forward_scores);
-      logp_bw = hmm_backward(hmm, emissions, sample_lens[s], 
-                             backward_scores);
-
-      if (fabs(logp_fw - logp_bw) > 1.0)
-        if (logf != NULL) 
-          fprintf(logf, "WARNING: forward and backward algorithms returned different total log\nprobabilities (%f and %f, respectively).\n", logp_fw, logp_bw);
-
-      total_logl += logp_fw;
-
-      for (i = 0; i < sample_lens[s]; i++) {
-        double this_logp;
+    tp_run(tp, nblocks, em_estep_block, &es);
 
-        /* to avoid rounding errors, estimate total log prob
-           separately for each column */
+    /* sum counts over blocks, in order */
+    total_logl = 0;
+    for (b = 0; b < nblocks; b++) 
+      total_logl += es.blocks[b].logl;
+    if (nblocks > 1) {
+      for (k = 0; k < hmm->nstates; k++) {
+        for (l = 0; l < hmm->nstates; l++) {
+          A[k][l] = 0;
+          for (b = 0; b < nblocks; b++) 
+            A[k][l] += es.blocks[b].A[k][l];
+        }
+        totalA[k] = 0;
+        for (b = 0; b < nblocks; b++) 
+          totalA[k] += es.blocks[b].totalA[k];
         if (estimate_state_models != NULL) {
-          lst_clear(val_list);
-          for (l = 0; l < hmm->nstates; l++) 
-            lst_push_dbl(val_list, (forward_scores[l][i] + 
-                                    backward_scores[l][i]));
-          this_logp = log_sum(val_list);
-          obsidx = get_observation_index(data, s, i);
-	  if (obsidx == -1) continue;
-          for (k = 0; k < hmm->nstates; k++) {
-            /* compute expected number of times each state emits each
-               distinct observation ('E' in Durbin et al.'s notation; see
-               pp. 63-64) */
-            val = exp2(forward_scores[k][i] + backward_scores[k][i] - 
-                       this_logp);
-            E[k][obsidx] += val;
+          for (obsidx = 0; obsidx < nobs; obsidx++) {
+            E[k][obsidx] = 0;
+            for (b = 0; b < nblocks; b++) 
+              E[k][obsidx] += es.blocks[b].E[k][obsidx];
           }
-	}
-   
-        /* compute expected number of transitions from each state to
-           each other ('A' in Durbin et al.'s notation, pp. 63-64) */
-	if (i != sample_lens[s]-1) {
-	  sum = 0.0;
-	  for (k = 0; k < hmm->nstates; k++) {
-	    for (l = 0; l < hmm->nstates; l++) {
-	      val = exp2(forward_scores[k][i] + 
-			 hmm_get_transition_score(hmm, k, l) + 
-			 emissions[l][i+1] + backward_scores[l][i+1] - 
-			 logp_fw);
-	      /* FIXME: begin and end states? start
-		 and end idx */
-	      sum += (tempA[k][l] = val);
-	      //	      totalA[k] += val;
-	    }
-	  }
-	  for (k=0; k < hmm->nstates; k++) {
-	    for (l = 0; l < hmm->nstates; l++) {
-	      A[k][l] += tempA[k][l]/sum;
-	      totalA[k] += tempA[k][l]/sum;
-	    }
-	  }
-	}
+        }
       }
     }
 
+    /* if an extrapolated point has decreased the likelihood, fall
+       back to the plain EM update and redo the E step */
+    if (accel != NULL && !opt_squarem_check(sq, accel_params, total_logl)) {
+      accel->set_params(accel_params, hmm, models, data);
+      continue;
+    }
+
     if (logf != NULL) {         /* do this before updating params;
                                    otherwise you're outputting the current
                                    likelihood with the new params,
@@ -253,34 +457,133 @@ double hmm_train_by_em(HMM *hmm, void *models, void *data, int nsamples,
       /* re-estimate state models */
       if (estimate_state_models  != NULL)
         estimate_state_models(models, hmm->nstates, data, E, nobs, logf);
+
+      /* extrapolate from recent updates, if possible */
+      if (accel != NULL) {
+        accel->get_params(accel_params, accel_lb, accel_ub, hmm, models, 
+                          data);
+        if (opt_squarem_update(sq, accel_params, total_logl, accel_lb, 
+                               accel_ub))
+          accel->set_params(accel_params, hmm, models, data);
+      }
     }
   }
   //  fprintf(stderr, "done it=%i ll=%f\n", it, total_logl);
   if (logf != NULL) {
     gettimeofday(&end_time, NULL);
-    fprintf(logf, "\nNumber of iterations: %d\nTotal time: %.4f sec.\n", it, 
+    fprintf(logf, "\nNumber of iterations: %d\n", it);
+    if (accel != NULL)
+      fprintf(logf, "Number of extrapolations: %d (%d rejected)\n", 
+              sq->nextrap, sq->nrejected);
+    fprintf(logf, "Total time: %.4f sec.\n", 
             end_time.tv_sec - start_time.tv_sec + 
             (end_time.tv_usec - start_time.tv_usec)/1.0e6);
   }
 
-  for (i = 0; i < hmm->nstates; i++) {
-    sfree(forward_scores[i]);
-    sfree(backward_scores[i]);
-    if (emissions_alloc == NULL) sfree(emissions[i]);
-    sfree(A[i]);
-    sfree(tempA[i]);
-    if (estimate_state_models != NULL) sfree(E[i]);
+  if (accel != NULL) {
+    accel->niterations = it - 1;
+    accel->nextrap = sq->nextrap;
+    accel->nrejected = sq->nrejected;
+    opt_squarem_free(sq);
+    vec_free(accel_params);
+    vec_free(accel_lb);
+    vec_free(accel_ub);
   }
-  sfree(forward_scores);
-  sfree(backward_scores);
-  if (emissions_alloc == NULL) sfree(emissions);
-  sfree(A);
-  sfree(tempA);
-  sfree(totalA);
-  if (estimate_state_models != NULL)
-    sfree(E);
-  lst_free(val_list);
 
+  em_blocks_free(es.blocks, nblocks, hmm->nstates, emissions_alloc);
+  if (nblocks > 1) {
+    for (k = 0; k < hmm->nstates; k++) {
+      sfree(A[k]);
+      if (E != NULL) sfree(E[k]);
+    }
+    sfree(A);
+    sfree(totalA);
+    if (E != NULL) sfree(E);
+  }
+  tp_free(tp);
+
+  PROF_END(PROF_EM, it);
   return total_logl;
 }
 
+
+/* Single E step: compute expected counts of transitions (A) and, if E
+   is non-NULL, of emissions of each distinct observation (E), under
+   the current parameters, without updating anything.  Counts from
+   independent portions of the data may simply be summed, which allows
+   EM to be distributed (see phastCons --em-stats).  Returns log
+   likelihood (base 2) */
+double hmm_em_expected_counts(HMM *hmm, void *models, void *data, 
+                              int nsamples, phast_pos *sample_lens, 
+                              void (*compute_emissions)(double**, void**, 
+                                                        int, void*, 
+                                                        int, phast_pos), 
+                              int (*get_observation_index)(void*, int, 
+                                                           phast_pos),
+                              double **emissions_alloc, int nthreads,
+                              double **A, double **E) {
+  int k, l, s, b, obsidx, nobs = 0, nblocks;
+  phast_pos maxlen = 0;
+  double total_logl = 0;
+  ThreadPool *tp;
+  EmStep es;
+
+  if (E != NULL && get_observation_index == NULL)
+    die("ERROR: (hmm_em_expected_counts) get_observation_index required for expected emission counts.\n");
+
+  if (compute_emissions == NULL && (nsamples > 1 || emissions_alloc == NULL))
+    die("ERROR: (hmm_em_expected_counts) compute_emissions function required.\n");
+
+  for (s = 0; s < nsamples; s++)
+    if (sample_lens[s] > maxlen) 
+      maxlen = sample_lens[s];
+
+  if (E != NULL)
+    nobs = get_observation_index(data, -1, -1);
+
+  tp = tp_new(nthreads <= 0 ? nthreads : min(nthreads, nsamples));
+  nblocks = min(tp_nthreads(tp), nsamples);
+  es.blocks = em_blocks_new(hmm, nsamples, sample_lens, nblocks, maxlen,
+                            E != NULL ? nobs : -1, emissions_alloc);
+  es.hmm = hmm;
+  es.models = models;
+  es.data = data;
+  es.sample_lens = sample_lens;
+  es.nsamples = nsamples;
+  es.nobs = nobs;
+  es.it = 1;
+  es.compute_emissions = compute_emissions;
+  es.estimate_state_models = (E != NULL);
+  es.get_observation_index = get_observation_index;
+  es.logf = NULL;
+
+  if (nblocks > 1 && compute_emissions != NULL) {
+    compute_emissions(es.blocks[0].emissions, models, hmm->nstates,
+                      data, 0, sample_lens[0]);
+    es.blocks[0].skip_first = TRUE;
+  }
+
+  tp_run(tp, nblocks, em_estep_block, &es);
+
+  for (k = 0; k < hmm->nstates; k++) {
+    for (l = 0; l < hmm->nstates; l++) {
+      A[k][l] = 0;
+      for (b = 0; b < nblocks; b++) 
+        A[k][l] += es.blocks[b].A[k][l];
+    }
+    if (E != NULL) {
+      for (obsidx = 0; obsidx < nobs; obsidx++) {
+        E[k][obsidx] = 0;
+        for (b = 0; b < nblocks; b++) 
+          E[k][obsidx] += es.blocks[b].E[k][obsidx];
+      }
+    }
+  }
+  for (b = 0; b < nblocks; b++) 
+    total_logl += es.blocks[b].logl;
+
+  em_blocks_free(es.blocks, nblocks, hmm->nstates, emissions_alloc);
+  tp_free(tp);
+
+  return total_logl;
+}
@@ -17,6 +17,8 @@
 #include <vector.h>
 #include <prob_vector.h>
 #include <time.h>
+#include <arena.h>
+#include <profile.h>
 
 /* Library of functions for manipulation of hidden Markov models.
    Includes simple reading and writing routines, as well as
@@ -53,6 +55,8 @@ HMM* hmm_new(MarkovMatrix *mm, Vector *eq_freqs,
   hmm->begin_transition_scores = hmm->end_transition_scores = NULL;
   hmm->predecessors = hmm->successors = NULL;
   hmm->begin_successors = hmm->end_predecessors = NULL;
+  hmm->pred_ptr = hmm->pred_idx = hmm->succ_ptr = hmm->succ_idx = NULL;
+  hmm->pred_score = hmm->succ_score = NULL;
 
   /* if begin_transitions are NULL, make them uniform */
   if (begin_transitions == NULL) {
@@ -139,6 +143,12 @@ void hmm_free(HMM *hmm) {
   lst_free(hmm->end_predecessors);
   sfree(hmm->predecessors);
   sfree(hmm->successors);
+  sfree(hmm->pred_ptr);
+  sfree(hmm->pred_idx);
+  sfree(hmm->pred_score);
+  sfree(hmm->succ_ptr);
+  sfree(hmm->succ_idx);
+  sfree(hmm->succ_score);
   sfree(hmm);
 }
 
@@ -266,62 +276,160 @@ double hmm_get_transition_score(HMM *hmm, int from_state, int to_state) {
   return (mat_get(hmm->transition_score_matrix, from_state, to_state));
 }
 
-/* Finds most probable path, according to the Viterbi algorithm.
-   Emission scores must be passed in as a two dimensional matrix, with
-   hmm->nstates rows and seqlen columns.  The array "path" must be
-   allocated externally and be of length seqlen.  This array will be
-   filled with integers indicating state numbers in the HMM. */
-void hmm_viterbi(HMM *hmm, double **emission_scores, int seqlen, int *path) {
+/* Viterbi algorithm shared by hmm_viterbi and hmm_viterbi_float.
+   Only two columns of scores are kept.  Back pointers are stored
+   column by column in the smallest unsigned type that can hold every
+   state number, with the largest value of the type standing for "no
+   predecessor".  If the back pointers for the whole sequence would
+   take more than HMM_VITERBI_MAX_BACKPTR_BYTES, the sequence is
+   divided into blocks of about sqrt(seqlen) columns; the forward pass
+   saves the score column preceding each block, and the traceback
+   recomputes the back pointers of one block at a time, starting from
+   the last. */
+
+/* one column of the Viterbi recursion; exactly one of emission_scores
+   and emission_scores_float must be non-NULL */
+static void hmm_viterbi_column(HMM *hmm, double **emission_scores,
+                               float **emission_scores_float, phast_pos j,
+                               double *prev, double *cur, int *bp) {
+  int i, k;
+  for (i = 0; i < hmm->nstates; i++) {
+    double best = NEGINFTY, emis = (emission_scores != NULL ?
+                                    emission_scores[i][j] :
+                                    emission_scores_float[i][j]);
+    bp[i] = -1;
+    if (j == 0)
+      best = hmm_get_transition_score(hmm, BEGIN_STATE, i);
+    else {
+      for (k = hmm->pred_ptr[i]; k < hmm->pred_ptr[i+1]; k++) {
+        double candidate = prev[hmm->pred_idx[k]] + hmm->pred_score[k];
+        if (candidate > best) {
+          best = candidate;
+          bp[i] = hmm->pred_idx[k];
+        }
+      }
+    }
+    cur[i] = emis + best;
+  }
+}
 
-  double **full_scores;
-  int **backptr;
-  int i, j, len, bestidx;
-  double besttran;
+static void hmm_set_backptrs(void *backptr, int width, size_t offset,
+                             int *bp, int n) {
+  int i;
+  if (width == 1) {
+    uint8_t *b = (uint8_t*)backptr + offset;
+    for (i = 0; i < n; i++) b[i] = (bp[i] == -1 ? UINT8_MAX : bp[i]);
+  }
+  else if (width == 2) {
+    uint16_t *b = (uint16_t*)backptr + offset;
+    for (i = 0; i < n; i++) b[i] = (bp[i] == -1 ? UINT16_MAX : bp[i]);
+  }
+  else memcpy((int*)backptr + offset, bp, n * sizeof(int));
+}
 
-  /* set up necessary arrays */
-  full_scores = (double**)smalloc(hmm->nstates * sizeof(double*));
-  backptr = (int**)smalloc(hmm->nstates * sizeof(int*));
-  len = seqlen;
-  for (i = 0; i < hmm->nstates; i++) {
-    full_scores[i] = (double*)smalloc(len * sizeof(double));
-    backptr[i] = (int*)smalloc(len * sizeof(int));
+static int hmm_get_backptr(void *backptr, int width, size_t idx) {
+  if (width == 1) {
+    uint8_t b = ((uint8_t*)backptr)[idx];
+    return (b == UINT8_MAX ? -1 : b);
   }
+  else if (width == 2) {
+    uint16_t b = ((uint16_t*)backptr)[idx];
+    return (b == UINT16_MAX ? -1 : b);
+  }
+  return ((int*)backptr)[idx];
+}
 
-  /* fill array using DP */
-  hmm_do_dp_forward(hmm, emission_scores, seqlen, VITERBI, full_scores, 
-                    backptr);
+static void hmm_do_viterbi(HMM *hmm, double **emission_scores,
+                           float **emission_scores_float, phast_pos seqlen,
+                           int *path) {
+  int i, n = hmm->nstates, bestidx;
+  phast_pos j, b, blocklen, nblocks, start, stop;
+  int width = (n < UINT8_MAX ? 1 : (n < UINT16_MAX ? 2 : (int)sizeof(int)));
+  int bp[n];
+  double col0[n], col1[n], end[n], *prev = col0, *cur = col1, *tmp, best;
+  double *checkpoints = NULL;
+  void *backptr;
+  ArenaMark mark;
+  Arena *ar;
+
+  if (!(seqlen > 0 && n > 0))
+    die("ERROR hmm_viterbi: bad params\n");
+
+  if ((size_t)n * seqlen * width <= HMM_VITERBI_MAX_BACKPTR_BYTES)
+    blocklen = seqlen;
+  else
+    blocklen = (phast_pos)ceil(sqrt((double)seqlen));
+  nblocks = (seqlen + blocklen - 1) / blocklen;
 
-  /* find path by backtracing */
+  ar = ar_scratch_begin(&mark);
+  backptr = ar_alloc(ar, (size_t)n * blocklen * width);
+  if (nblocks > 1)
+    checkpoints = ar_alloc(ar, (size_t)n * nblocks * sizeof(double));
 
-  /* first find starting place */
-  bestidx = 0; 
-  besttran = hmm_get_transition_score(hmm, 0, END_STATE);
-  for (i = 1; i < hmm->nstates; i++) {
-    double thistran = hmm_get_transition_score(hmm, i, END_STATE);
-    if (full_scores[i][len-1] + thistran > 
-        full_scores[bestidx][len-1] + besttran) 
-      bestidx = i;
+  /* forward pass */
+  for (j = 0; j < seqlen; j++) {
+    checkInterruptN(j, 1000);
+    hmm_viterbi_column(hmm, emission_scores, emission_scores_float, j,
+                       prev, cur, bp);
+    if (nblocks == 1)
+      hmm_set_backptrs(backptr, width, (size_t)j * n, bp, n);
+    else if ((j + 1) % blocklen == 0 && j + 1 < seqlen)
+      memcpy(&checkpoints[(size_t)((j + 1) / blocklen) * n], cur,
+             n * sizeof(double));
+    tmp = prev; prev = cur; cur = tmp;
+  }
+
+  /* find starting place for traceback */
+  for (i = 0; i < n; i++)
+    end[i] = hmm_get_transition_score(hmm, i, END_STATE);
                                 /* note: when hmm->end_transitions ==
-                                   NULL, besttran and thistran will
-                                   always be zero (see function
+                                   NULL, these will always be zero
+                                   (see function
                                    hmm_get_transition_score) */
+  bestidx = 0;
+  best = prev[0] + end[0];
+  for (i = 1; i < n; i++) {
+    if (prev[i] + end[i] > best) {
+      best = prev[i] + end[i];
+      bestidx = i;
+    }
   }
 
-  /* now backtrace recursively */
+  /* now backtrace, block by block */
   i = bestidx;
-  j = seqlen - 1;
-  while (i != -1) {
-    path[j] = i;
-    i = backptr[i][j];
-    j--;
+  for (b = nblocks - 1; b >= 0 && i != -1; b--) {
+    start = b * blocklen;
+    stop = min(start + blocklen, seqlen);
+    if (nblocks > 1) {          /* recompute back pointers of block */
+      if (b > 0)
+        memcpy(prev, &checkpoints[(size_t)b * n], n * sizeof(double));
+      for (j = start; j < stop; j++) {
+        checkInterruptN(j, 1000);
+        hmm_viterbi_column(hmm, emission_scores, emission_scores_float, j,
+                           prev, cur, bp);
+        hmm_set_backptrs(backptr, width, (size_t)(j - start) * n, bp, n);
+        tmp = prev; prev = cur; cur = tmp;
+      }
+    }
+    for (j = stop - 1; j >= start && i != -1; j--) {
+      path[j] = i;
+      i = hmm_get_backptr(backptr, width, (size_t)(j - start) * n + i);
+    }
   }
 
-  for (i = 0; i < hmm->nstates; i++) {
-    sfree(full_scores[i]);
-    sfree(backptr[i]);
-  }
-  sfree(full_scores);
-  sfree(backptr);
+  ar_scratch_end(ar, mark);
+}
+
+/* Finds most probable path, according to the Viterbi algorithm.
+   Emission scores must be passed in as a two dimensional matrix, with
+   hmm->nstates rows and seqlen columns.  The array "path" must be
+   allocated externally and be of length seqlen.  This array will be
+   filled with integers indicating state numbers in the HMM. */
+void hmm_viterbi(HMM *hmm, double **emission_scores, phast_pos seqlen, 
+                 int *path) {
+  PROF_BEGIN(PROF_VITERBI);
+  hmm_do_viterbi(hmm, emission_scores, NULL, seqlen, path);
+  PROF_END(PROF_VITERBI, seqlen);
 }
 
 /* Fills matrix of "forward" scores and returns total log probability
@@ -329,9 +437,10 @@ void hmm_viterbi(HMM *hmm, double **emission_scores, int seqlen, int *path) {
    dimensional matrix with hmm->nstates rows and seqlen columns.  Here
    the array forward_scores must be allocated externally as well, to
    the same size.  It will be filled by this function. */
-double hmm_forward(HMM *hmm, double **emission_scores, int seqlen, 
+double hmm_forward(HMM *hmm, double **emission_scores, phast_pos seqlen, 
                    double **forward_scores) {
   double llh;
+  PROF_BEGIN(PROF_FORWARD);
 /*   int t0, t1; */
 
 /*   t0 = (int)time(0); */
@@ -341,6 +450,7 @@ double hmm_forward(HMM *hmm, double **emission_scores, int seqlen,
                         seqlen, FORWARD);
 /*   t1 = (int)time(0); */
 /*   fprintf(stderr, "Forward algorithm time elapsed: %d seconds\n", (t1 - t0)); */
+  PROF_END(PROF_FORWARD, seqlen);
   return llh;
 }
 
@@ -349,13 +459,17 @@ double hmm_forward(HMM *hmm, double **emission_scores, int seqlen,
    dimensional matrix with hmm->nstates rows and seqlen columns.  Here
    the array backward_scores must be allocated externally as well, to
    the same size.  It will be filled by this function. */
-double hmm_backward(HMM *hmm, double **emission_scores, int seqlen,
+double hmm_backward(HMM *hmm, double **emission_scores, phast_pos seqlen,
                     double **backward_scores) {
+  double llh;
+  PROF_BEGIN(PROF_BACKWARD);
 
   hmm_do_dp_backward(hmm, emission_scores, seqlen, backward_scores);
 
-  return hmm_max_or_sum(hmm, backward_scores, emission_scores, NULL, 
-                        BEGIN_STATE, -1, BACKWARD);
+  llh = hmm_max_or_sum(hmm, backward_scores, emission_scores, NULL, 
+                       BEGIN_STATE, -1, BACKWARD);
+  PROF_END(PROF_BACKWARD, seqlen);
+  return llh;
 }
 
 /* Fills matrix of posterior probabilities.  As above, emission scores
@@ -367,22 +481,21 @@ double hmm_backward(HMM *hmm, double **emission_scores, int seqlen,
    arrays used by those routines.  NOTE: if the posterior probs for
    any state i are not desired, set posterior_probs[i] = NULL.  The
    return value is the log likelihood.  */
-double hmm_posterior_probs(HMM *hmm, double **emission_scores, int seqlen,
-                         double **posterior_probs) {
-  int i, j, len;
+double hmm_posterior_probs(HMM *hmm, double **emission_scores, 
+                           phast_pos seqlen, double **posterior_probs) {
+  int i;
+  phast_pos j, len;
   double logp_fw, logp_bw;
   double **forward_scores, **backward_scores;
   List *val_list;
+  ArenaMark mark;
+  Arena *ar = ar_scratch_begin(&mark);
 
   len = seqlen;
 
   /* allocate arrays for forward and backward algs */
-  forward_scores = (double**)smalloc(hmm->nstates * sizeof(double*));
-  backward_scores = (double**)smalloc(hmm->nstates * sizeof(double*));
-  for (i = 0; i < hmm->nstates; i++) {
-    forward_scores[i] = (double*)smalloc(len * sizeof(double));
-    backward_scores[i] = (double*)smalloc(len * sizeof(double));
-  }
+  forward_scores = ar_alloc_dbl_matrix(ar, hmm->nstates, len);
+  backward_scores = ar_alloc_dbl_matrix(ar, hmm->nstates, len);
 
   /* run forward and backward algs */
   logp_fw = hmm_forward(hmm, emission_scores, seqlen, forward_scores); 
@@ -395,7 +508,7 @@ double hmm_posterior_probs(HMM *hmm, double **emission_scores, int seqlen,
   val_list = lst_new_dbl(hmm->nstates);
   for (j = 0; j < len; j++) {
     double this_logp;
-    checkInterruptN(i, 1000);
+    checkInterruptN(j, 1000);
 
     /* to avoid rounding errors, estimate total log prob
        separately for each column */
@@ -411,23 +524,224 @@ double hmm_posterior_probs(HMM *hmm, double **emission_scores, int seqlen,
                                      backward_scores[i][j] - this_logp);
   }
 
-  for (i = 0; i < hmm->nstates; i++) {
-    sfree(forward_scores[i]);
-    sfree(backward_scores[i]);
-  }
-  sfree(forward_scores);
-  sfree(backward_scores);
+  ar_scratch_end(ar, mark);
   lst_free(val_list);
 
   return logp_fw;
 }
 
+/* Single-precision versions of the Viterbi, forward, and
+   forward/backward algorithms.  Emission scores (log2, as above) and
+   posterior probabilities are stored as floats, halving the memory
+   required for the nstates x seqlen matrices, but all accumulation is
+   done in double precision.  The forward and backward recursions are
+   carried out in probability space and rescaled at each column (with
+   the log scale factors summed in double precision), so they do not
+   underflow. */
+
+/* Set up arrays of transition probabilities consistent with
+   hmm_get_transition_score.  The arrays pred_prob and succ_prob
+   correspond to the CSR arrays hmm->pred_score and hmm->succ_score
+   (see hmm_reset) and must be of the same size; begin and end must
+   have nstates elements. */
+static void hmm_get_transition_probs(HMM *hmm, double *pred_prob, 
+                                     double *succ_prob, double *begin,
+                                     double *end) {
+  int i, k, n = hmm->nstates;
+  for (k = 0; k < hmm->pred_ptr[n]; k++) {
+    pred_prob[k] = exp2(hmm->pred_score[k]);
+    succ_prob[k] = exp2(hmm->succ_score[k]);
+  }
+  for (i = 0; i < n; i++) {
+    begin[i] = exp2(hmm_get_transition_score(hmm, BEGIN_STATE, i));
+    end[i] = exp2(hmm_get_transition_score(hmm, i, END_STATE));
+  }
+}
+
+/* Scaled forward recursion shared by hmm_forward_float and
+   hmm_posterior_probs_float.  If forward_scores is non-NULL, it must
+   have hmm->nstates rows of length seqlen; on return, column j will
+   contain the forward probabilities of column j normalized to sum to
+   one.  Returns the total log (base 2) probability of the
+   sequence. */
+static double hmm_do_scaled_forward(HMM *hmm, float **emission_scores,
+                                    phast_pos seqlen, float **forward_scores,
+                                    double *pred_prob, double *begin,
+                                    double *end) {
+  int i, k, n = hmm->nstates;
+  phast_pos j;
+  double logp = 0, maxe, sum;
+  double prev[n], cur[n];
+
+  for (j = 0; j < seqlen; j++) {
+    checkInterruptN(j, 1000);
+
+    /* emission probabilities are rescaled by the largest in the
+       column, so that at least one is equal to one */
+    maxe = NEGINFTY;
+    for (i = 0; i < n; i++)
+      if (emission_scores[i][j] > maxe) maxe = emission_scores[i][j];
+
+    sum = 0;
+    for (i = 0; i < n; i++) {
+      double p = 0;
+      if (j == 0) p = begin[i];
+      else {
+        for (k = hmm->pred_ptr[i]; k < hmm->pred_ptr[i+1]; k++)
+          p += prev[hmm->pred_idx[k]] * pred_prob[k];
+      }
+      cur[i] = (p == 0 ? 0 : p * exp2(emission_scores[i][j] - maxe));
+      sum += cur[i];
+    }
+    if (sum == 0)               /* also catches maxe == NEGINFTY */
+      return NEGINFTY;
+    logp += maxe + log2(sum);
+
+    for (i = 0; i < n; i++) {
+      prev[i] = cur[i] / sum;
+      if (forward_scores != NULL) forward_scores[i][j] = prev[i];
+    }
+  }
+
+  sum = 0;
+  for (i = 0; i < n; i++) sum += prev[i] * end[i];
+  return logp + log2(sum);
+}
+
+/* Single-precision version of hmm_viterbi */
+void hmm_viterbi_float(HMM *hmm, float **emission_scores, phast_pos seqlen,
+                       int *path) {
+  PROF_BEGIN(PROF_VITERBI);
+  hmm_do_viterbi(hmm, NULL, emission_scores, seqlen, path);
+  PROF_END(PROF_VITERBI, seqlen);
+}
+
+/* Single-precision version of hmm_forward.  Only the total log
+   probability of the sequence is returned; the forward matrix is not
+   stored. */
+double hmm_forward_float(HMM *hmm, float **emission_scores, 
+                         phast_pos seqlen) {
+  int n = hmm->nstates, nnz = hmm->pred_ptr[hmm->nstates];
+  double llh, *pred_prob, *succ_prob, begin[n], end[n];
+  ArenaMark mark;
+  Arena *ar = ar_scratch_begin(&mark);
+  PROF_BEGIN(PROF_FORWARD);
+  pred_prob = ar_alloc(ar, max(nnz, 1) * sizeof(double));
+  succ_prob = ar_alloc(ar, max(nnz, 1) * sizeof(double));
+  hmm_get_transition_probs(hmm, pred_prob, succ_prob, begin, end);
+  llh = hmm_do_scaled_forward(hmm, emission_scores, seqlen, NULL, pred_prob,
+                              begin, end);
+  PROF_END(PROF_FORWARD, seqlen);
+  ar_scratch_end(ar, mark);
+  return llh;
+}
+
+/* Single-precision version of hmm_posterior_probs.  As there, set
+   posterior_probs[i] = NULL if the posterior probs for state i are
+   not desired.  The rows of posterior_probs that are provided are
+   used to store the scaled forward probabilities before they are
+   overwritten by the posteriors, so that no additional nstates x
+   seqlen matrix is needed unless some rows are NULL.  Returns the
+   log likelihood. */
+double hmm_posterior_probs_float(HMM *hmm, float **emission_scores,
+                                 phast_pos seqlen, float **posterior_probs) {
+  int i, k, n = hmm->nstates, nnz = hmm->pred_ptr[hmm->nstates];
+  phast_pos j;
+  double logp, maxe, sum, *pred_prob, *succ_prob, begin[n], end[n];
+  double bw[n], next[n], post[n];
+  float **forward_scores;
+  ArenaMark mark;
+  Arena *ar = ar_scratch_begin(&mark);
+
+  forward_scores = ar_alloc(ar, n * sizeof(float*));
+  for (i = 0; i < n; i++)
+    forward_scores[i] = (posterior_probs[i] != NULL ? posterior_probs[i] :
+                         ar_alloc(ar, seqlen * sizeof(float)));
+
+  pred_prob = ar_alloc(ar, max(nnz, 1) * sizeof(double));
+  succ_prob = ar_alloc(ar, max(nnz, 1) * sizeof(double));
+  hmm_get_transition_probs(hmm, pred_prob, succ_prob, begin, end);
+
+  {
+    PROF_BEGIN(PROF_FORWARD);
+    logp = hmm_do_scaled_forward(hmm, emission_scores, seqlen, forward_scores,
+                                 pred_prob, begin, end);
+    PROF_END(PROF_FORWARD, seqlen);
+  }
+  if (logp == NEGINFTY)
+    die("ERROR hmm_posterior_probs_float: sequence has probability zero\n");
+
+  /* backward recursion, rescaled so that each column sums to one;
+     posteriors are computed as each column is completed */
+  {
+    PROF_BEGIN(PROF_BACKWARD);
+    for (i = 0; i < n; i++) bw[i] = end[i];
+    for (j = seqlen - 1; j >= 0; j--) {
+      checkInterruptN(j, 1000);
+      if (j < seqlen - 1) {
+        maxe = NEGINFTY;
+        for (i = 0; i < n; i++)
+          if (emission_scores[i][j+1] > maxe) maxe = emission_scores[i][j+1];
+        for (i = 0; i < n; i++)
+          next[i] = (bw[i] == 0 ? 0 :
+                     bw[i] * exp2(emission_scores[i][j+1] - maxe));
+        sum = 0;
+        for (i = 0; i < n; i++) {
+          bw[i] = 0;
+          for (k = hmm->succ_ptr[i]; k < hmm->succ_ptr[i+1]; k++)
+            bw[i] += succ_prob[k] * next[hmm->succ_idx[k]];
+          sum += bw[i];
+        }
+        for (i = 0; i < n; i++) bw[i] /= sum;
+      }
+
+      sum = 0;
+      for (i = 0; i < n; i++) {
+        post[i] = forward_scores[i][j] * bw[i];
+        sum += post[i];
+      }
+      for (i = 0; i < n; i++)
+        if (posterior_probs[i] != NULL)
+          posterior_probs[i][j] = post[i] / sum;
+    }
+    PROF_END(PROF_BACKWARD, seqlen);
+  }
+
+  ar_scratch_end(ar, mark);
+  return logp;
+}
+
+/* Equivalent of log_sum (see misc.h) for an array of n > 0 values,
+   used by the dynamic programming routines.  The array is sorted in
+   descending order as a side effect, and the values are summed in
+   that order, so that results are identical to those of log_sum */
+static PHAST_INLINE
+double hmm_log_sum_array(double *vals, int n) {
+  double maxval, expsum, tmp;
+  int k, m;
+
+  for (k = 1; k < n; k++) {     /* insertion sort; n is usually small */
+    tmp = vals[k];
+    for (m = k; m > 0 && vals[m-1] < tmp; m--) vals[m] = vals[m-1];
+    vals[m] = tmp;
+  }
+
+  maxval = vals[0];
+  expsum = 1;
+  k = 1;
+  while (k < n && vals[k] - maxval > SUM_LOG_THRESHOLD)
+    expsum += exp2(vals[k++] - maxval);
+
+  return maxval + log2(expsum);
+}
+
 /* This is the core dynamic programming routine used by hmm_viterbi
    and hmm_forward.  It is not intended to be called directly. */
-void hmm_do_dp_forward(HMM *hmm, double **emission_scores, int seqlen, 
+void hmm_do_dp_forward(HMM *hmm, double **emission_scores, phast_pos seqlen, 
                        hmm_mode mode, double **full_scores, int **backptr) {  
 
-  int i, j;
+  int i;
+  phast_pos j;
 
   if (!(seqlen > 0 && hmm != NULL && hmm->nstates > 0 && 
 	(mode == VITERBI || mode == FORWARD) && 
@@ -441,12 +755,32 @@ void hmm_do_dp_forward(HMM *hmm, double **emission_scores, int seqlen,
     if (mode == VITERBI) backptr[i][0] = -1;
   }
 
-  /* recursion */
+  /* recursion; uses the CSR form of the predecessor lists (see
+     hmm_reset) rather than hmm_max_or_sum, to avoid a call to
+     hmm_get_transition_score per edge */
   for (j = 1; j < seqlen; j++) {
     for (i = 0; i < hmm->nstates; i++) {
-      full_scores[i][j] = emission_scores[i][j] + 
-        hmm_max_or_sum(hmm, full_scores, emission_scores, backptr, 
-                       i, j, mode);
+      int k, beg = hmm->pred_ptr[i], end = hmm->pred_ptr[i+1];
+      double best = NEGINFTY;
+
+      if (mode == VITERBI) {
+        for (k = beg; k < end; k++) {
+          double candidate = full_scores[hmm->pred_idx[k]][j-1] + 
+            hmm->pred_score[k];
+          if (candidate > best) {
+            best = candidate;
+            backptr[i][j] = hmm->pred_idx[k];
+          }
+        }
+      }
+      else if (end > beg) {
+        double cand[end - beg];
+        for (k = beg; k < end; k++)
+          cand[k - beg] = full_scores[hmm->pred_idx[k]][j-1] + 
+            hmm->pred_score[k];
+        best = hmm_log_sum_array(cand, end - beg);
+      }
+      full_scores[i][j] = emission_scores[i][j] + best;
     }
   }
 
@@ -457,10 +791,11 @@ void hmm_do_dp_forward(HMM *hmm, double **emission_scores, int seqlen,
 
 /* This is the core dynamic programming routine used by hmm_backward.
    It is not intended to be called directly. */
-void hmm_do_dp_backward(HMM *hmm, double **emission_scores,  int seqlen, 
-                        double **full_scores) {  
+void hmm_do_dp_backward(HMM *hmm, double **emission_scores,  
+                        phast_pos seqlen, double **full_scores) {  
 
-  int i, j;
+  int i;
+  phast_pos j;
 
   if (!(seqlen > 0 && hmm != NULL && hmm->nstates > 0 && 
 	full_scores != NULL))
@@ -471,13 +806,19 @@ void hmm_do_dp_backward(HMM *hmm, double **emission_scores,  int seqlen,
     full_scores[i][seqlen-1] = hmm_get_transition_score(hmm, i, END_STATE);
                                 /*  will be 0 when no end state */
 
-  /* recursion */
+  /* recursion (using CSR successor lists; see hmm_do_dp_forward) */
   for (j = seqlen - 2; j >= 0; j--) {
     checkInterruptN(j, 1000);
     for (i = 0; i < hmm->nstates; i++) {
-      full_scores[i][j] = 
-        hmm_max_or_sum(hmm, full_scores, emission_scores, NULL, 
-                       i, j, BACKWARD);
+      int k, beg = hmm->succ_ptr[i], end = hmm->succ_ptr[i+1];
+      double cand[end > beg ? end - beg : 1];
+      for (k = beg; k < end; k++) {
+        int succ = hmm->succ_idx[k];
+        cand[k - beg] = emission_scores[succ][j+1] + full_scores[succ][j+1] +
+          hmm->succ_score[k];
+      }
+      full_scores[i][j] = (end > beg ? hmm_log_sum_array(cand, end - beg) :
+                           NEGINFTY);
     }
   }
 }
@@ -489,11 +830,11 @@ void hmm_do_dp_backward(HMM *hmm, double **emission_scores,  int seqlen,
    (only if mode == FORWARD) or BEGIN_STATE (only if mode ==
    BACKWARD).  */  
 double hmm_max_or_sum(HMM *hmm, double **full_scores, double **emission_scores,
-                      int **backptr, int i, int j, hmm_mode mode) { 
+                      int **backptr, int i, phast_pos j, hmm_mode mode) { 
   int k;
   double retval = NEGINFTY;
   
-  static List *l = NULL;
+  static PHAST_THREAD_LOCAL List *l = NULL;
 
   if (l == NULL) {
     l = lst_new_dbl(hmm->nstates);
@@ -692,12 +1033,12 @@ void hmm_train_from_paths(HMM *hmm, int **path, int npaths,
 
 /* update counts according to new path */
 void hmm_train_update_counts(Matrix *trans_counts, Vector *state_counts, 
-                             Vector *beg_counts, int *path, int len, 
+                             Vector *beg_counts, int *path, phast_pos len, 
                              int nstates) {
-  int j;
+  phast_pos j;
   for (j = 0; j < len; j++) {
     if (!(path[j] >= 0 && path[j] < nstates))
-      die("ERROR hmm_train_update_counts: path[%i]=%i, should be in [0, %i)\n",
+      die("ERROR hmm_train_update_counts: path[%" PHAST_POS_FMT "]=%i, should be in [0, %i)\n",
 	  j, path[j], nstates);
     vec_set(state_counts, path[j], 
                    vec_get(state_counts, path[j]) + 1);
@@ -711,21 +1052,22 @@ void hmm_train_update_counts(Matrix *trans_counts, Vector *state_counts,
   /* temporary */
   for (j = 0; j < state_counts->size; j++) 
     if (vec_get(state_counts, j) < 0)
-      die("ERROR hmm_train_update_counts: state_counts[%j]=%f\n",
+      die("ERROR hmm_train_update_counts: state_counts[%" PHAST_POS_FMT "]=%f\n",
 	  j, vec_get(state_counts, j));
 }
 
 /* for debugging */
-void hmm_dump_matrices(HMM *hmm, double **emission_scores, int seqlen,
+void hmm_dump_matrices(HMM *hmm, double **emission_scores, phast_pos seqlen,
                        double **full_scores, int **backptr) {
   FILE *F = phast_fopen("hmm.debug", "w+");
-  int i, j;
+  int i;
+  phast_pos j;
   char tmpstr[50];
 
   fprintf(F, "EMISSION SCORES:\n");
   fprintf(F, "    ");
   for (j = 0; j < seqlen; j++) 
-    fprintf(F, "%10d ", j);
+    fprintf(F, "%10" PHAST_POS_FMT " ", j);
   fprintf(F, "\n");
   for (i = 0; i < hmm->nstates; i++) { 
     fprintf(F, "%2d: ", i);
@@ -742,7 +1084,7 @@ void hmm_dump_matrices(HMM *hmm, double **emission_scores, int seqlen,
   fprintf(F, "\nFULL SCORES:\n");
   fprintf(F, "    ");
   for (j = 0; j < seqlen; j++) 
-    fprintf(F, "%10d ", j);
+    fprintf(F, "%10" PHAST_POS_FMT " ", j);
   fprintf(F, "\n");
   for (i = 0; i < hmm->nstates; i++) { 
     fprintf(F, "%2d: ", i);
@@ -760,7 +1102,7 @@ void hmm_dump_matrices(HMM *hmm, double **emission_scores, int seqlen,
     fprintf(F, "\nBACK POINTERS:\n");
     fprintf(F, "    ");
     for (j = 0; j < seqlen; j++) 
-      fprintf(F, "%10d ", j);
+      fprintf(F, "%10" PHAST_POS_FMT " ", j);
     fprintf(F, "\n");
     for (i = 0; i < hmm->nstates; i++) { 
       fprintf(F, "%2d: ", i);
@@ -832,9 +1174,9 @@ void hmm_cross_product(HMM *dest, HMM *src1, HMM *src2) {
 
 
 /* compute the total log likelihood of a specified path */
-double hmm_path_likelihood(HMM *hmm, double **emission_scores, int seqlen, 
-                           int *path) {
-  int i;
+double hmm_path_likelihood(HMM *hmm, double **emission_scores, 
+                           phast_pos seqlen, int *path) {
+  phast_pos i;
   double l = 0;
   if (seqlen <= 0) return 0;
   l = hmm_get_transition_score(hmm, BEGIN_STATE, path[0]) +
@@ -852,7 +1194,7 @@ double hmm_path_likelihood(HMM *hmm, double **emission_scores, int seqlen,
    states.  This routine is not as efficient as it could be (trying to
    reuse code).  */
 double hmm_score_subset(HMM *hmm, double **emission_scores, List *states,
-                        int begidx, int len) {
+                        phast_pos begidx, phast_pos len) {
   double **forward_scores;
   double **dummy_emissions;
   int do_state[hmm->nstates];
@@ -860,11 +1202,11 @@ double hmm_score_subset(HMM *hmm, double **emission_scores, List *states,
   double retval;
   Vector *orig_begin;
   MarkovMatrix *orig_trans;
+  ArenaMark mark;
+  Arena *ar = ar_scratch_begin(&mark);
 
-  forward_scores = smalloc(hmm->nstates * sizeof(double*));
-  dummy_emissions = smalloc(hmm->nstates * sizeof(double*));
-  for (i = 0; i < hmm->nstates; i++) 
-    forward_scores[i] = smalloc(len * sizeof(double));
+  forward_scores = ar_alloc_dbl_matrix(ar, hmm->nstates, len);
+  dummy_emissions = ar_alloc(ar, hmm->nstates * sizeof(double*));
 
   for (i = 0; i < hmm->nstates; i++) do_state[i] = 0;
   for (i = 0; i < lst_size(states); i++) do_state[lst_get_int(states, i)] = 1;
@@ -905,10 +1247,7 @@ double hmm_score_subset(HMM *hmm, double **emission_scores, List *states,
   hmm->transition_matrix = orig_trans;
   hmm_reset(hmm);
 
-  for (i = 0; i < hmm->nstates; i++) 
-    sfree(forward_scores[i]);
-  sfree(forward_scores);
-  sfree(dummy_emissions);
+  ar_scratch_end(ar, mark);
 
   return retval;
 }
@@ -919,12 +1258,61 @@ double hmm_score_subset(HMM *hmm, double **emission_scores, List *states,
    scoring candidate predictions. */
 double hmm_log_odds_subset(HMM *hmm, double **emission_scores, 
                                    List *test_states, List *null_states,
-                                   int begidx, int len) {
+                                   phast_pos begidx, phast_pos len) {
   return (hmm_score_subset(hmm, emission_scores, test_states, begidx, len) -
           hmm_score_subset(hmm, emission_scores, null_states, begidx, len));
 }
 
 
+/* Build compressed sparse row (CSR) versions of the predecessor and
+   successor lists, excluding the begin and end states, together with
+   the corresponding log transition probabilities, for use by the
+   dynamic programming routines.  States are listed in the same order
+   as in hmm->predecessors and hmm->successors.  Called by
+   hmm_reset. */
+static void hmm_build_csr(HMM *hmm) {
+  int i, j, k, nnz = 0, n = hmm->nstates;
+  double prob;
+
+  for (i = 0; i < n; i++)
+    for (j = 0; j < n; j++)
+      if (mm_get(hmm->transition_matrix, i, j) > 0) nnz++;
+
+  sfree(hmm->pred_idx); sfree(hmm->pred_score);
+  sfree(hmm->succ_idx); sfree(hmm->succ_score);
+  if (hmm->pred_ptr == NULL) {
+    hmm->pred_ptr = smalloc((n+1) * sizeof(int));
+    hmm->succ_ptr = smalloc((n+1) * sizeof(int));
+  }
+  hmm->pred_idx = smalloc(max(nnz, 1) * sizeof(int));
+  hmm->succ_idx = smalloc(max(nnz, 1) * sizeof(int));
+  hmm->pred_score = smalloc(max(nnz, 1) * sizeof(double));
+  hmm->succ_score = smalloc(max(nnz, 1) * sizeof(double));
+
+  /* log2 computed as in hmm_get_transition_score */
+  for (i = 0, k = 0; i < n; i++) {
+    hmm->pred_ptr[i] = k;
+    for (j = 0; j < n; j++) {
+      if ((prob = mm_get(hmm->transition_matrix, j, i)) > 0) {
+        hmm->pred_idx[k] = j;
+        hmm->pred_score[k++] = log2(prob);
+      }
+    }
+  }
+  hmm->pred_ptr[n] = k;
+
+  for (i = 0, k = 0; i < n; i++) {
+    hmm->succ_ptr[i] = k;
+    for (j = 0; j < n; j++) {
+      if ((prob = mm_get(hmm->transition_matrix, i, j)) > 0) {
+        hmm->succ_idx[k] = j;
+        hmm->succ_score[k++] = log2(prob);
+      }
+    }
+  }
+  hmm->succ_ptr[n] = k;
+}
+
 /* Reset various attributes that are derived from the underlying
    matrix of transitions.  Should be called after the matrix is
    changed for any reason.  Note: this routine assumes that
@@ -986,6 +1374,8 @@ void hmm_reset(HMM *hmm) {
        this simplifies coding somewhat ... */
   }
 
+  hmm_build_csr(hmm);
+
   /* below is inefficient on repeated calls, but shouldn't be used
      heavily */
   if (hmm->transition_score_matrix != NULL) {
@@ -1143,9 +1533,10 @@ void hmm_renormalize(HMM *hmm) {
 
 /* Sample a state path through a sequence using the stochastic traceback
    algorithm. */
-void hmm_stochastic_traceback(HMM *hmm, double **forward_scores, int seqlen,
-			      int *path) {
-  int i, j, k, pass, maxidx, state;
+void hmm_stochastic_traceback(HMM *hmm, double **forward_scores, 
+                              phast_pos seqlen, int *path) {
+  int j, k, pass, maxidx, state;
+  phast_pos i;
   double max, score, z;
   List *predecessors;
   Vector *pv;
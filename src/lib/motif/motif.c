@@ -23,6 +23,13 @@
 #include "ctype.h"
 #include "external_libs.h"
 #include "misc.h"
+#include "thread_pool.h"
+
+#ifdef PHAST_THREADS
+#include <pthread.h>
+/* protects best scores shared by restarts in mtf_find */
+static pthread_mutex_t mtf_search_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
 
 #define DERIV_EPSILON 1e-6
 
@@ -60,6 +67,210 @@ int score_compare(const void* ptr1, const void* ptr2) {
   return 0;
 }
 
+/* one restart of the motif search in mtf_find: a candidate (initial
+   consensus string or random start) and a trial number.  Initial
+   parameters are drawn before any restart is trained, in the same
+   order as for a serial search, so results do not depend on the
+   number of threads */
+typedef struct {
+  int cons, trial;
+  Vector **freqs;               /* initial parameters */
+  Motif *m;                     /* trained motif, or NULL if abandoned */
+} MtfRestart;
+
+/* data shared by the restarts of mtf_find */
+typedef struct {
+  void *data;
+  int multiseq, motif_size, nrestarts;
+  void *backgd;
+  double *has_motif, prior;
+  int em_threads;               /* threads for each E step */
+  int print_now;                /* report restarts as they begin
+                                   (serial case) */
+  MtfRestart *restarts;
+  PooledMSA **thread_pmsa;      /* private copies of data for each
+                                   thread (multiseq EM only) */
+  double best_score;            /* best score of a completed restart */
+  double abandon_margin;        /* abandon restarts trailing the best
+                                   by more than this (<= 0 means
+                                   never) */
+} MtfSearch;
+
+static double mtf_em_run(void *models, void *data, int nsamples, 
+                         int *sample_lens, int width, double motif_prior,
+                         void (*compute_emissions)(double**, void**, int, 
+                                                   void*, int, int), 
+                         void (*estimate_state_models)(void**, int, void*, 
+                                                       double**, int),
+                         int (*get_observation_index)(void*, int, int),
+                         double *postprob, int *bestposition, int nthreads,
+                         MtfSearch *search, int *abandoned);
+
+/* Create a copy of a PooledMSA that shares everything with the
+   original except the category counts of the pooled alignment, which
+   are overwritten in each M step of EM (see phy_estim_mods) */
+static PooledMSA *mtf_pooled_msa_private(PooledMSA *pmsa) {
+  PooledMSA *retval = smalloc(sizeof(PooledMSA));
+  MSA *msa = smalloc(sizeof(MSA));
+  MSA_SS *ss = smalloc(sizeof(MSA_SS));
+  int j, ncats = pmsa->pooled_msa->ncats;
+
+  *retval = *pmsa;
+  *msa = *pmsa->pooled_msa;
+  *ss = *pmsa->pooled_msa->ss;
+  ss->msa = msa;
+  msa->ss = ss;
+  retval->pooled_msa = msa;
+  ss->cat_counts = smalloc((ncats+1) * sizeof(double*));
+  for (j = 0; j <= ncats; j++) {
+    ss->cat_counts[j] = smalloc(ss->ntuples * sizeof(double));
+    memcpy(ss->cat_counts[j], pmsa->pooled_msa->ss->cat_counts[j], 
+           ss->ntuples * sizeof(double));
+  }
+  return retval;
+}
+
+/* Free a copy created by mtf_pooled_msa_private */
+static void mtf_pooled_msa_private_free(PooledMSA *pmsa) {
+  int j;
+  for (j = 0; j <= pmsa->pooled_msa->ncats; j++)
+    sfree(pmsa->pooled_msa->ss->cat_counts[j]);
+  sfree(pmsa->pooled_msa->ss->cat_counts);
+  sfree(pmsa->pooled_msa->ss);
+  sfree(pmsa->pooled_msa);
+  sfree(pmsa);
+}
+
+/* Train the motif for one restart of mtf_find (job of a thread pool) */
+static void mtf_find_restart(void *data, int job, int thread) {
+  MtfSearch *ms = data;
+  MtfRestart *r = &ms->restarts[job];
+  int motif_size = ms->motif_size, abandoned = FALSE, i, j, k;
+  char *cons_str = smalloc((motif_size + 1) * sizeof(char));
+  Motif *m;
+
+  if (ms->print_now) {
+    if (ms->nrestarts == 1)
+      fprintf(stderr, "Trying candidate %d ... ", r->cons+1);
+    else 
+      fprintf(stderr, "Trying candidate %d, trial %d ... ", 
+              r->cons+1, r->trial+1);
+  }
+
+  /* create a new motif object */
+  m = ms->multiseq ? 
+    mtf_new(motif_size, 1, r->freqs, ms->data, ms->backgd, 0.25) :
+    mtf_new(motif_size, 0, r->freqs, ms->data, NULL, 0);
+
+  /* now train */
+  if (ms->has_motif == NULL) {  /* EM training */
+    if (ms->multiseq) {
+      PooledMSA *pmsa = ms->thread_pmsa != NULL ? ms->thread_pmsa[thread] :
+        ms->data;
+      m->score = mtf_em_run(m->ph_mods, pmsa, lst_size(pmsa->source_msas), 
+                            pmsa->lens, m->motif_size, ms->prior, 
+                            phy_compute_emissions, phy_estim_mods, 
+                            phy_get_obs_idx, m->postprob, m->bestposition,
+                            ms->em_threads, ms, &abandoned);
+    }
+    else {
+      SeqSet *seqset = ms->data;
+      m->score = mtf_em_run(m->freqs, seqset, seqset->set->nseqs, 
+                            seqset->lens, m->motif_size, ms->prior, 
+                            mn_compute_emissions, mn_estim_mods, 
+                            mn_get_obs_idx, m->postprob, m->bestposition, 
+                            ms->em_threads, ms, &abandoned);
+    }
+  }
+  else {                        /* discriminative training */
+    double retval;
+    int params_per_model = ms->multiseq ? 
+      tm_get_nparams(m->ph_mods[1]) : /* assume all are the same */
+      m->alph_size;
+    int nparams = params_per_model * m->motif_size + 1;
+                                /* one more for motif threshold */
+    Vector *params = vec_new(nparams), *lower_bounds = vec_new(nparams),
+      *upper_bounds = vec_new(nparams);
+
+    m->has_motif = ms->has_motif;
+    vec_set_all(lower_bounds, 0.00001);
+    vec_set_all(upper_bounds, 1);
+    vec_set(lower_bounds, 0, NEGINFTY); /* threshold */
+    vec_set(upper_bounds, 0, INFTY);
+    /* no upper bounds */
+
+    /* initialize params */
+    j = 0;
+    vec_set(params, j++, 2 * motif_size);
+                                /* approx 2 nats per model seems to be
+                                   a reasonable initialization for the
+                                   threshold */
+    for (i = 1; i <= m->motif_size; i++) {
+      if (ms->multiseq) {
+        Vector *tm_params = tm_params_new_init_from_model(m->ph_mods[i]);
+/*         vec_set(upper_bounds, j, 20); */ /* FIXME: have to relax upper bound for rate constant */
+/*         vec_set(lower_bounds, j, .25); */ /* FIXME: avoid degenerate case */
+        for (k = 0; k < tm_params->size; k++)
+          vec_set(params, j++, vec_get(tm_params, k));
+        vec_free(tm_params);
+      }
+      else 
+        for (k = 0; k < m->alph_size; k++)
+          vec_set(params, j++, vec_get(m->freqs[i], k));
+    }
+    if (j != nparams)
+      die("ERROR mtf_find j (%i) != nparams (%i)\n", j, nparams);
+          
+    retval = opt_bfgs(mtf_compute_conditional, params, m, &m->score, 
+                      lower_bounds, upper_bounds, NULL,
+                      NUMERICAL_DERIVS ? NULL : 
+                      mtf_compute_conditional_grad, 
+                      OPT_LOW_PREC, NULL, NULL);
+
+    m->score *= -1;
+
+    if (retval != 0 && ms->print_now) 
+      /* (the opt_bfgs code produces an error message) */
+      fprintf(stderr, " ... continuing ... ");
+
+    vec_free(params);
+    vec_free(lower_bounds);
+    vec_free(upper_bounds);
+  }      
+
+  mtf_get_consensus(m, cons_str);
+  cons_str[motif_size] = '\0';
+  if (ms->print_now)
+    fprintf(stderr, "(consensus = '%s', score = %.3f%s)\n", cons_str, 
+            m->score, abandoned ? ", abandoned" : "");
+  else if (ms->nrestarts == 1)
+    fprintf(stderr, "Candidate %d: consensus = '%s', score = %.3f%s\n", 
+            r->cons+1, cons_str, m->score, abandoned ? ", abandoned" : "");
+  else
+    fprintf(stderr, "Candidate %d, trial %d: consensus = '%s', score = %.3f%s\n",
+            r->cons+1, r->trial+1, cons_str, m->score, 
+            abandoned ? ", abandoned" : "");
+  sfree(cons_str);
+
+  if (abandoned) {
+    mtf_free(m);
+    r->m = NULL;
+    return;
+  }
+
+  mtf_predict(m, m->training_data, m->bestposition, m->samplescore, 
+              ms->has_motif);   /* predict and score best motif */
+  r->m = m;
+
+#ifdef PHAST_THREADS
+  pthread_mutex_lock(&mtf_search_lock);
+#endif
+  if (m->score > ms->best_score) ms->best_score = m->score;
+#ifdef PHAST_THREADS
+  pthread_mutex_unlock(&mtf_search_lock);
+#endif
+}
+
 /* Find motifs in a collection individual sequences or multiple
    alignments, either using EM or discriminative training.  If
    'multiseq' == 1 then 'data' must be a PooledMSA object; otherwise,
@@ -75,55 +286,59 @@ int score_compare(const void* ptr1, const void* ptr2) {
    The 'prior' argument indicates an initial value for the prior
    probability that a motif instance appears in each sequence (used
    with EM only).  See calling code in phast_motif.c regarding
-   'init_list,' 'sample_parms,' and 'npseudocounts.' */
+   'init_list,' 'sample_parms,' and 'npseudocounts.'  Restarts are
+   trained in parallel by up to 'nthreads' threads; with a single
+   restart, the threads are used for the E step instead.  If
+   'abandon_margin' > 0, EM restarts whose log likelihood trails that
+   of the best completed restart by more than this amount are
+   abandoned (see mtf_em_run) */
 List* mtf_find(void *data, int multiseq, int motif_size, int nmotifs, 
                TreeNode *tree, void *backgd, double *has_motif, double prior, 
                int nrestarts, List *init_list, int sample_parms, 
-               int npseudocounts) {
+               int npseudocounts, int nthreads, double abandon_margin) {
 
-  int i, j, k, cons, trial, alph_size, nparams = -1;
+  int i, r, t, cons, trial, alph_size, nruns;
   double *alpha;
-  List *motifs = lst_new_ptr(nrestarts * 
-                             (init_list != NULL ? lst_size(init_list) : 1));
+  List *motifs;
   List *tmpl;
   char *cons_str = smalloc((motif_size + 1) * sizeof(char));
   SeqSet *seqset = !multiseq ? data : NULL;
   PooledMSA *pmsa = multiseq ? data : NULL;
-  Vector **freqs = smalloc((motif_size + 1) * sizeof(void*));
-  Vector *params = NULL, *lower_bounds = NULL, *upper_bounds = NULL;
+  Vector *backgd_freqs;
   int *inv_alphabet = multiseq ? pmsa->pooled_msa->inv_alphabet :
     seqset->set->inv_alphabet;
   Hashtable *hash;
+  ThreadPool *tp;
+  MtfSearch ms;
 
   cons_str[motif_size] = '\0';
   alph_size = multiseq ? (int)strlen(pmsa->pooled_msa->alphabet) : 
     (int)strlen(seqset->set->alphabet);
   alpha = smalloc(alph_size * sizeof(double));
   for (i = 0; i < alph_size; i++) alpha[i] = 1;      
-  for (i = 0; i <= motif_size; i++) freqs[i] = vec_new(alph_size);
+  backgd_freqs = vec_new(alph_size);
           
   if (has_motif == NULL) {      /* non-discriminative case only */
     if (multiseq) 
-      vec_copy(freqs[0], ((TreeModel*)backgd)->backgd_freqs);
+      vec_copy(backgd_freqs, ((TreeModel*)backgd)->backgd_freqs);
     else 
-      vec_copy(freqs[0], backgd);
+      vec_copy(backgd_freqs, backgd);
   }
 
-  for (cons = 0; 
+  /* draw initial parameters for all restarts */
+  nruns = nrestarts * (init_list != NULL ? lst_size(init_list) : 1);
+  ms.restarts = smalloc(nruns * sizeof(MtfRestart));
+  for (cons = 0, r = 0; 
        cons < (init_list == NULL ? 1 : lst_size(init_list)); 
        cons++) {              /* (loop only once if no init_list) */
 
     String *initstr = init_list == NULL ? NULL : 
       lst_get_ptr(init_list, cons);
 
-    for (trial = 0; trial < nrestarts; trial++) {
-      Motif *m;
-
-      if (nrestarts == 1)
-        fprintf(stderr, "Trying candidate %d ... ", cons+1);
-      else 
-        fprintf(stderr, "Trying candidate %d, trial %d ... ", 
-                cons+1, trial+1);
+    for (trial = 0; trial < nrestarts; trial++, r++) {
+      Vector **freqs = smalloc((motif_size + 1) * sizeof(void*));
+      for (i = 0; i <= motif_size; i++) freqs[i] = vec_new(alph_size);
+      vec_copy(freqs[0], backgd_freqs);
 
       if (initstr == NULL)
         for (i = 1; i <= motif_size; i++) 
@@ -133,89 +348,49 @@ List* mtf_find(void *data, int multiseq, int motif_size, int nmotifs,
         mtf_init_from_consensus(initstr, freqs, inv_alphabet,
                                 npseudocounts, sample_parms, motif_size);
 
-      /* create a new motif object */
-      m = multiseq ? 
-        mtf_new(motif_size, 1, freqs, pmsa, backgd, 0.25) :
-        mtf_new(motif_size, 0, freqs, seqset, NULL, 0);
-
-      /* now train */
-      if (has_motif == NULL) {  /* EM training */
-        if (multiseq)           
-          m->score = mtf_em(m->ph_mods, pmsa, lst_size(pmsa->source_msas), 
-                           pmsa->lens, m->motif_size, prior, 
-                           phy_compute_emissions, phy_estim_mods, 
-                           phy_get_obs_idx, m->postprob, m->bestposition);
-        else 
-          m->score = mtf_em(m->freqs, seqset, seqset->set->nseqs, seqset->lens, 
-                           m->motif_size, prior, mn_compute_emissions, 
-                           mn_estim_mods, mn_get_obs_idx, m->postprob,
-                           m->bestposition);
-      }
-      else {                    /* discriminative training */
-        double retval;
-        m->has_motif = has_motif;
-
-        if (nparams == -1) {    /* first time only */
-          int params_per_model = multiseq ? 
-            tm_get_nparams(m->ph_mods[1]) : /* assume all are the same */
-            m->alph_size;
-    
-          nparams = params_per_model * m->motif_size + 1;
-                                /* one more for motif threshold */
-          params = vec_new(nparams);
-          lower_bounds = vec_new(nparams); 
-          vec_set_all(lower_bounds, 0.00001);
-          upper_bounds = vec_new(nparams);
-          vec_set_all(upper_bounds, 1);
-          vec_set(lower_bounds, 0, NEGINFTY); /* threshold */
-          vec_set(upper_bounds, 0, INFTY);
-          /* no upper bounds */
-        }
-
-        /* initialize params */
-        j = 0;
-        vec_set(params, j++, 2 * motif_size);
-                                /* approx 2 nats per model seems to be
-                                   a reasonable initialization for the
-                                   threshold */
-        for (i = 1; i <= m->motif_size; i++) {
-          if (multiseq) {
-            Vector *tm_params = tm_params_new_init_from_model(m->ph_mods[i]);
-/*             vec_set(upper_bounds, j, 20); */ /* FIXME: have to relax upper bound for rate constant */
-/*             vec_set(lower_bounds, j, .25); */ /* FIXME: avoid degenerate case */
-            for (k = 0; k < tm_params->size; k++)
-              vec_set(params, j++, vec_get(tm_params, k));
-            vec_free(tm_params);
-          }
-          else 
-            for (k = 0; k < m->alph_size; k++)
-              vec_set(params, j++, vec_get(m->freqs[i], k));
-        }
-	if (j != nparams)
-	  die("ERROR mtf_find j (%i) != nparams (%i)\n", j, nparams);
-          
-        retval = opt_bfgs(mtf_compute_conditional, params, m, &m->score, 
-                          lower_bounds, upper_bounds, NULL,
-                          NUMERICAL_DERIVS ? NULL : 
-                          mtf_compute_conditional_grad, 
-                          OPT_LOW_PREC, NULL, NULL);
-
-        m->score *= -1;
-
-        if (retval != 0) 
-          /* (the opt_bfgs code produces an error message) */
-          fprintf(stderr, " ... continuing ... ");
-      }      
+      ms.restarts[r].cons = cons;
+      ms.restarts[r].trial = trial;
+      ms.restarts[r].freqs = freqs;
+      ms.restarts[r].m = NULL;
+    }
+  }
 
-      mtf_get_consensus(m, cons_str);
-      fprintf(stderr, "(consensus = '%s', score = %.3f)\n", cons_str, m->score);
+  /* use threads for restarts if there are several, otherwise for the
+     E step */
+  tp = tp_new(nruns > 1 ? nthreads : 1);
+  ms.data = data;
+  ms.multiseq = multiseq;
+  ms.motif_size = motif_size;
+  ms.nrestarts = nrestarts;
+  ms.backgd = backgd;
+  ms.has_motif = has_motif;
+  ms.prior = prior;
+  ms.em_threads = (nruns > 1 ? 1 : nthreads);
+  ms.print_now = (tp_nthreads(tp) == 1);
+  ms.best_score = NEGINFTY;
+  ms.abandon_margin = abandon_margin;
+  ms.thread_pmsa = NULL;
+  if (multiseq && has_motif == NULL && tp_nthreads(tp) > 1) {
+    ms.thread_pmsa = smalloc(tp_nthreads(tp) * sizeof(PooledMSA*));
+    for (t = 0; t < tp_nthreads(tp); t++)
+      ms.thread_pmsa[t] = mtf_pooled_msa_private(pmsa);
+  }
 
-      mtf_predict(m, m->training_data, m->bestposition, m->samplescore, 
-                  has_motif);   /* predict and score best motif */
+  tp_run(tp, nruns, mtf_find_restart, &ms);
 
-      lst_push_ptr(motifs, m);
-    }
+  motifs = lst_new_ptr(nruns);
+  for (r = 0; r < nruns; r++) {
+    if (ms.restarts[r].m != NULL) lst_push_ptr(motifs, ms.restarts[r].m);
+    for (i = 0; i <= motif_size; i++) vec_free(ms.restarts[r].freqs[i]);
+    sfree(ms.restarts[r].freqs);
+  }
+  sfree(ms.restarts);
+  if (ms.thread_pmsa != NULL) {
+    for (t = 0; t < tp_nthreads(tp); t++)
+      mtf_pooled_msa_private_free(ms.thread_pmsa[t]);
+    sfree(ms.thread_pmsa);
   }
+  tp_free(tp);
 
   lst_qsort(motifs, score_compare);
 
@@ -236,12 +411,7 @@ List* mtf_find(void *data, int multiseq, int motif_size, int nmotifs,
   lst_free(motifs);
   motifs = tmpl;
 
-  for (i = 0; i <= motif_size; i++) vec_free(freqs[i]);
-  sfree(freqs);
-
-  if (params != NULL) vec_free(params);
-  if (lower_bounds != NULL) vec_free(lower_bounds);
-  if (upper_bounds != NULL) vec_free(upper_bounds);
+  vec_free(backgd_freqs);
   sfree(cons_str);
   sfree(alpha);
 
@@ -697,6 +867,128 @@ void mtf_estim_backgd_mn(SeqSet *s, Vector *model) {
   vec_scale(model, 1.0/count);
 }
 
+/* per-block working storage for the E step of mtf_em; samples are
+   divided into contiguous blocks, one per thread, and the block
+   totals are summed in order after all blocks are done */
+typedef struct {
+  int first_sample, nsamples;
+  double **emissions, **E, *logpY, *postpY;
+  double logl, expected_nmotifs;
+  List *tmplst;
+} MtfEmBlock;
+
+/* data shared by all blocks of an E step of mtf_em */
+typedef struct {
+  void *models, *data;
+  int *sample_lens, width, nobs;
+  double motif_prior, *postprob;
+  int *bestposition;
+  MtfEmBlock *blocks;
+  void (*compute_emissions)(double**, void**, int, void*, int, int);
+  int (*get_observation_index)(void*, int, int);
+} MtfEmStep;
+
+/* E step of mtf_em for one block of samples */
+static void mtf_em_block(void *data, int job, int thread) {
+  MtfEmStep *es = data;
+  MtfEmBlock *b = &es->blocks[job];
+  double **emissions = b->emissions, *logpY = b->logpY, 
+    *postpY = b->postpY, max = 0, window_sum;
+  int i, j, k, s, obsidx, width = es->width;
+
+  b->logl = b->expected_nmotifs = 0;
+  for (k = 1; k <= width; k++) 
+    for (obsidx = 0; obsidx < es->nobs; obsidx++)
+      b->E[k][obsidx] = 0;
+
+  for (s = b->first_sample; s < b->first_sample + b->nsamples; s++) {
+    double tot_ll_backgd, tot_ll_motif, sample_logl, postpZ;
+    int len = es->sample_lens[s];
+
+    es->compute_emissions(emissions, es->models, width+1, es->data, s, len);
+
+    tot_ll_backgd = 0;
+    for (i = 0; i < len; i++)
+      tot_ll_backgd += emissions[0][i]; /* log likelihood of backgd
+                                           model (for this sample);
+                                           for the moment, leave out
+                                           the prior */
+
+    /* let the ith element of logpY be the log of the joint (prior)
+       probability that there is a motif and it starts at position i
+       in the current sample */
+    lst_clear(b->tmplst);
+    for (i = 0; i < len - width; i++) {
+      logpY[i] = log(es->motif_prior/(len - width)) + tot_ll_backgd;
+      /* (use backgd model for all positions but motif; motif
+         positions factored out below) */
+      for (j = 0; j < width; j++)
+        logpY[i] += emissions[j+1][i+j] - emissions[0][i+j];
+      lst_push_dbl(b->tmplst, logpY[i]);
+    }
+    tot_ll_motif = log_sum_e(b->tmplst); /* log likelihood of motif model
+                                            (sum over all starting points
+                                            for the motif) */
+
+    /* now put in the prior for the backgd model */
+    tot_ll_backgd += log(1-es->motif_prior);
+
+    if (tot_ll_motif < NEGINFTY) 
+      sample_logl = tot_ll_backgd;
+    else
+      sample_logl = tot_ll_motif + log(1 + exp(tot_ll_backgd - tot_ll_motif));
+                                /* do it this way to avoid underflow */
+      
+    if (isinf(sample_logl) || isnan(sample_logl)) 
+      die("ERROR mtf_em sample_logl not finite\n");
+
+    /* now let postpY[i] be the posterior probability that there is a
+       motif and it starts at position i */
+    if (es->bestposition != NULL) { es->bestposition[s] = -1; max = 0; }
+    window_sum = 0;
+    for (i = 0; i < len - width; i++) {
+      postpY[i] = exp(logpY[i] - sample_logl);
+
+      /* this is a hack used by MEME to avoid giving preference to
+         repetitive motifs: force sum to be at most one within each 
+         window of size width */
+      window_sum += postpY[i];
+      if (i >= width) window_sum -= postpY[i-width];
+      if (window_sum > 1) {
+        for (j = max(0, i-width+1); j <= i; j++)
+          postpY[j] /= window_sum;
+        window_sum = 1;
+      }
+    }
+
+    /* have to do this on a separate pass because of the
+       scaling hack */
+    for (i = 0; i < len - width; i++) {
+      if (es->bestposition != NULL && postpY[i] > max) { 
+        es->bestposition[s] = i;
+        max = postpY[i];
+      }
+    }
+
+    /* postpZ is the posterior probability that there is a motif in
+       this sample (a sum over all postpYs) */
+    postpZ = exp(tot_ll_motif - sample_logl);
+    b->expected_nmotifs += postpZ;
+    if (es->postprob != NULL) es->postprob[s] = postpZ;
+      
+    b->logl += sample_logl;     /* running total across samples */
+
+    /* now update expected numbers of each type of character
+       generated by each motif state */
+    for (i = 0; i < len - width; i++) {
+      for (k = 0; k < width; k++) {
+        obsidx = es->get_observation_index(es->data, s, i+k);
+        b->E[k+1][obsidx] += postpY[i];
+      }
+    }
+  }
+}
+
 /* find a single motif by EM, given a pre-initialized set of models.
    Functions must be provided for computing "emission" probabilities
    under all models, for updating model parameters given posterior
@@ -713,7 +1005,8 @@ void mtf_estim_backgd_mn(SeqSet *s, Vector *model) {
    are expected to be arrays of size nsamples; they will be populated
    with values indicating, respectively for each sample, the posterior
    prob. that a motif appears, and the starting position of the best
-   instance of the motif.  */
+   instance of the motif.  The E step is divided among nthreads
+   threads (<= 0 means one per processor) by sample. */
 double mtf_em(void *models, void *data, int nsamples, 
               int *sample_lens, int width, double motif_prior,
               void (*compute_emissions)(double**, void**, int, void*, 
@@ -721,13 +1014,34 @@ double mtf_em(void *models, void *data, int nsamples,
               void (*estimate_state_models)(void**, int, void*, 
                                             double**, int),
               int (*get_observation_index)(void*, int, int),
-              double *postprob, int *bestposition) {
+              double *postprob, int *bestposition, int nthreads) {
+  return mtf_em_run(models, data, nsamples, sample_lens, width, motif_prior,
+                    compute_emissions, estimate_state_models, 
+                    get_observation_index, postprob, bestposition, nthreads,
+                    NULL, NULL);
+}
+
+/* Implementation of mtf_em.  If search is non-NULL and has a positive
+   abandon_margin, training stops early once at least
+   MTF_ABANDON_MIN_ITER iterations have been done and the log
+   likelihood trails the best score of a completed restart by more
+   than the margin; in this case *abandoned is set to TRUE and the
+   current log likelihood is returned */
+static double mtf_em_run(void *models, void *data, int nsamples, 
+                         int *sample_lens, int width, double motif_prior,
+                         void (*compute_emissions)(double**, void**, int, 
+                                                   void*, int, int), 
+                         void (*estimate_state_models)(void**, int, void*, 
+                                                       double**, int),
+                         int (*get_observation_index)(void*, int, int),
+                         double *postprob, int *bestposition, int nthreads,
+                         MtfSearch *search, int *abandoned) {
   
-  int i, j, k, s, obsidx, nobs, maxlen = 0;
-  double **emissions, **E;
-  double *logpY, *postpY;
-  double total_logl, prev_total_logl, expected_nmotifs, max=0, window_sum;
-  List *tmplst;
+  int i, k, b, obsidx, nobs, maxlen = 0, nblocks, s, iter;
+  double **E;
+  double total_logl, prev_total_logl, expected_nmotifs;
+  ThreadPool *tp;
+  MtfEmStep es;
 
   for (s = 0; s < nsamples; s++)
     if (sample_lens[s] > maxlen) maxlen = sample_lens[s];
@@ -736,105 +1050,71 @@ double mtf_em(void *models, void *data, int nsamples,
                                                  return total number
                                                  in this case */
 
-  emissions = (double**)smalloc((width+1) * sizeof(double*));
-  for (i = 0; i <= width; i++)
-    emissions[i] = (double*)smalloc(maxlen * sizeof(double));
-  E = (double**)smalloc((width+1) * sizeof(double*));
-  for (k = 1; k <= width; k++) 
-    E[k] = (double*)smalloc(nobs * sizeof(double));
-  tmplst = lst_new_dbl(maxlen);
-  logpY = smalloc(maxlen * sizeof(double));
-  postpY = smalloc(maxlen * sizeof(double));
-
-  prev_total_logl = NEGINFTY;
-  while (1) {
-    total_logl = expected_nmotifs = 0;
+  tp = tp_new(nthreads <= 0 ? nthreads : min(nthreads, nsamples));
+  nblocks = min(tp_nthreads(tp), nsamples);
+
+  es.blocks = smalloc(nblocks * sizeof(MtfEmBlock));
+  for (b = 0; b < nblocks; b++) {
+    MtfEmBlock *blk = &es.blocks[b];
+    blk->first_sample = (int)((long)b * nsamples / nblocks);
+    blk->nsamples = (int)((long)(b+1) * nsamples / nblocks) - 
+      blk->first_sample;
+    blk->emissions = (double**)smalloc((width+1) * sizeof(double*));
+    for (i = 0; i <= width; i++)
+      blk->emissions[i] = (double*)smalloc(maxlen * sizeof(double));
+    blk->E = (double**)smalloc((width+1) * sizeof(double*));
     for (k = 1; k <= width; k++) 
-      for (obsidx = 0; obsidx < nobs; obsidx++)
-        E[k][obsidx] = 0;
-
-    for (s = 0; s < nsamples; s++) {
-      double tot_ll_backgd, tot_ll_motif, sample_logl, postpZ;
-
-      compute_emissions(emissions, models, width+1, data, s, sample_lens[s]);
-
-      tot_ll_backgd = 0;
-      for (i = 0; i < sample_lens[s]; i++)
-        tot_ll_backgd += emissions[0][i]; /* log likelihood of backgd
-                                             model (for this sample);
-                                             for the moment, leave out
-                                             the prior */
+      blk->E[k] = (double*)smalloc(nobs * sizeof(double));
+    blk->tmplst = lst_new_dbl(maxlen);
+    blk->logpY = smalloc(maxlen * sizeof(double));
+    blk->postpY = smalloc(maxlen * sizeof(double));
+  }
 
-      /* let the ith element of logpY be the log of the joint (prior)
-         probability that there is a motif and it starts at position i
-         in the current sample */
-      lst_clear(tmplst);
-      for (i = 0; i < sample_lens[s] - width; i++) {
-        logpY[i] = log(motif_prior/(sample_lens[s] - width)) + tot_ll_backgd;
-        /* (use backgd model for all positions but motif; motif
-           positions factored out below) */
-        for (j = 0; j < width; j++)
-          logpY[i] += emissions[j+1][i+j] - emissions[0][i+j];
-        lst_push_dbl(tmplst, logpY[i]);
-      }
-      tot_ll_motif = log_sum_e(tmplst); /* log likelihood of motif model
-                                         (sum over all starting points
-                                         for the motif) */
+  /* with a single block, its counts are used directly */
+  if (nblocks == 1)
+    E = es.blocks[0].E;
+  else {
+    E = (double**)smalloc((width+1) * sizeof(double*));
+    for (k = 1; k <= width; k++) 
+      E[k] = (double*)smalloc(nobs * sizeof(double));
+  }
 
-      /* now put in the prior for the backgd model */
-      tot_ll_backgd += log(1-motif_prior);
+  es.models = models;
+  es.data = data;
+  es.sample_lens = sample_lens;
+  es.width = width;
+  es.nobs = nobs;
+  es.postprob = postprob;
+  es.bestposition = bestposition;
+  es.compute_emissions = compute_emissions;
+  es.get_observation_index = get_observation_index;
+
+  if (abandoned != NULL) *abandoned = FALSE;
+  prev_total_logl = NEGINFTY;
+  for (iter = 1; ; iter++) {
+    es.motif_prior = motif_prior;
 
-      if (tot_ll_motif < NEGINFTY) 
-        sample_logl = tot_ll_backgd;
-      else
-        sample_logl = tot_ll_motif + log(1 + exp(tot_ll_backgd - tot_ll_motif));
-                                /* do it this way to avoid underflow */
-      
-      if (isinf(sample_logl) || isnan(sample_logl)) 
-	die("ERROR mtf_em sample_logl not finite\n");
-
-      /* now let postpY[i] be the posterior probability that there is a
-         motif and it starts at position i */
-      if (bestposition != NULL) { bestposition[s] = -1; max = 0; }
-      window_sum = 0;
-      for (i = 0; i < sample_lens[s] - width; i++) {
-        postpY[i] = exp(logpY[i] - sample_logl);
-
-        /* this is a hack used by MEME to avoid giving preference to
-           repetitive motifs: force sum to be at most one within each 
-           window of size width */
-        window_sum += postpY[i];
-        if (i >= width) window_sum -= postpY[i-width];
-        if (window_sum > 1) {
-          for (j = max(0, i-width+1); j <= i; j++)
-            postpY[j] /= window_sum;
-          window_sum = 1;
-        }
-      }
+    /* models may set up internal state on first use (e.g.,
+       substitution matrices), so compute the first sample's emissions
+       before starting threads */
+    if (nblocks > 1)
+      compute_emissions(es.blocks[0].emissions, models, width+1, data, 0, 
+                        sample_lens[0]);
 
-      /* have to do this on a separate pass because of the
-         scaling hack */
-      for (i = 0; i < sample_lens[s] - width; i++) {
-        if (bestposition != NULL && postpY[i] > max) { 
-          bestposition[s] = i;
-          max = postpY[i];
-        }
-      }
+    tp_run(tp, nblocks, mtf_em_block, &es);
 
-      /* postpZ is the posterior probability that there is a motif in
-         this sample (a sum over all postpYs) */
-      postpZ = exp(tot_ll_motif - sample_logl);
-      expected_nmotifs += postpZ;
-      if (postprob != NULL) postprob[s] = postpZ;
-      
-      total_logl += sample_logl; /* running total across samples */
-
-      /* now update expected numbers of each type of character
-         generated by each motif state */
-      for (i = 0; i < sample_lens[s] - width; i++) {
-        for (k = 0; k < width; k++) {
-          obsidx = get_observation_index(data, s, i+k);
-          E[k+1][obsidx] += postpY[i];
+    /* sum over blocks, in order */
+    total_logl = expected_nmotifs = 0;
+    for (b = 0; b < nblocks; b++) {
+      total_logl += es.blocks[b].logl;
+      expected_nmotifs += es.blocks[b].expected_nmotifs;
+    }
+    if (nblocks > 1) {
+      for (k = 1; k <= width; k++) {
+        for (obsidx = 0; obsidx < nobs; obsidx++) {
+          E[k][obsidx] = 0;
+          for (b = 0; b < nblocks; b++)
+            E[k][obsidx] += es.blocks[b].E[k][obsidx];
         }
       }
     }
@@ -845,6 +1125,23 @@ double mtf_em(void *models, void *data, int nsamples,
     if (total_logl - prev_total_logl <= MTF_EM_CONVERGENCE_THRESHOLD)
       break;              
 
+    /* give up if far behind the best completed restart */
+    if (search != NULL && search->abandon_margin > 0 && 
+        iter >= MTF_ABANDON_MIN_ITER) {
+      double best;
+#ifdef PHAST_THREADS
+      pthread_mutex_lock(&mtf_search_lock);
+#endif
+      best = search->best_score;
+#ifdef PHAST_THREADS
+      pthread_mutex_unlock(&mtf_search_lock);
+#endif
+      if (total_logl < best - search->abandon_margin) {
+        *abandoned = TRUE;
+        break;
+      }
+    }
+
     prev_total_logl = total_logl;
 
     /* re-estimate state models */
@@ -855,15 +1152,24 @@ double mtf_em(void *models, void *data, int nsamples,
                                 /* don't let it go quite to 1 */
   }
 
-  for (i = 0; i <= width; i++) {
-    sfree(emissions[i]);
-    if (i > 0) sfree(E[i]);
+  for (b = 0; b < nblocks; b++) {
+    MtfEmBlock *blk = &es.blocks[b];
+    for (i = 0; i <= width; i++) {
+      sfree(blk->emissions[i]);
+      if (i > 0) sfree(blk->E[i]);
+    }
+    sfree(blk->emissions);
+    sfree(blk->E);
+    sfree(blk->postpY);
+    sfree(blk->logpY);
+    lst_free(blk->tmplst);
   }
-  sfree(emissions);
-  sfree(E);
-  sfree(postpY);
-  sfree(logpY);
-  lst_free(tmplst);
+  if (nblocks > 1) {
+    for (k = 1; k <= width; k++) sfree(E[k]);
+    sfree(E);
+  }
+  sfree(es.blocks);
+  tp_free(tp);
 
   return total_logl;
 }
@@ -1459,7 +1765,7 @@ void mtf_print_html(FILE *F, Motif *m) {
   SeqSet *ss = m->multiseq ? NULL : (SeqSet*)m->training_data;
   int *inv_alphabet = m->multiseq ? pmsa->pooled_msa->inv_alphabet :
     ss->set->inv_alphabet;
-  int *motstart, *motend;
+  phast_pos *motstart, *motend;
   char **color = smalloc(m->alph_size * sizeof(char*));
   GFF_Feature **posfeat;
 
@@ -1506,8 +1812,8 @@ void mtf_print_html(FILE *F, Motif *m) {
     mtf_build_coord_maps(m);
   posfeat = smalloc(nobs * sizeof(void*));
   for (i = 0; i < nobs; i++) posfeat[i] = NULL;
-  motstart = smalloc(nobs * sizeof(int));
-  motend = smalloc(nobs * sizeof(int));
+  motstart = smalloc(nobs * sizeof(phast_pos));
+  motend = smalloc(nobs * sizeof(phast_pos));
 
   notfound = lst_new_ptr(nobs);
   if (m->multiseq)
@@ -1564,7 +1870,7 @@ void mtf_print_html(FILE *F, Motif *m) {
     /* now print row in table */
     fprintf(F, "<tr><td>");
     if (posfeat[i] != NULL)
-      fprintf(F, "<a href=\"%s&position=%s:%d-%d\" TARGET=_blank>", 
+      fprintf(F, "<a href=\"%s&position=%s:%" PHAST_POS_FMT "-%" PHAST_POS_FMT "\" TARGET=_blank>", 
               HGTRACKS_URL, posfeat[i]->seqname->chars, 
               posfeat[i]->start, posfeat[i]->end);
     fprintf(F, "%s", name);
@@ -1581,7 +1887,7 @@ void mtf_print_html(FILE *F, Motif *m) {
         fprintf(F, "%c", tolower(seq[j]));
       else {
         if (j == m->bestposition[i] && posfeat[i] != NULL)
-          fprintf(F, "<a href=\"%s&position=%s:%d-%d\" TARGET=_blank>", 
+          fprintf(F, "<a href=\"%s&position=%s:%" PHAST_POS_FMT "-%" PHAST_POS_FMT "\" TARGET=_blank>", 
                   HGTRACKS_URL, posfeat[i]->seqname->chars, motstart[i], 
                   motend[i]);
         fprintf(F, "<font color=\"%s\">%c</font>", 
@@ -1618,7 +1924,7 @@ void mtf_print_html(FILE *F, Motif *m) {
         if (k == m->refseq-1) {
           fprintf(F, "<tr><td>");
           if (posfeat[i] != NULL)
-            fprintf(F, "<a href=\"%s&position=%s:%d-%d\" TARGET=_blank>", 
+            fprintf(F, "<a href=\"%s&position=%s:%" PHAST_POS_FMT "-%" PHAST_POS_FMT "\" TARGET=_blank>", 
                     HGTRACKS_URL, posfeat[i]->seqname->chars, 
                     posfeat[i]->start, posfeat[i]->end);
           fprintf(F, "%s", msa->names[k]);
@@ -1639,7 +1945,7 @@ void mtf_print_html(FILE *F, Motif *m) {
             fprintf(F, "%c", tolower(msa->seqs[k][j]));
           else {
             if (j == m->bestposition[i] && posfeat[i] != NULL)
-              fprintf(F, "<a href=\"%s&position=%s:%d-%d\" TARGET=_blank>", 
+              fprintf(F, "<a href=\"%s&position=%s:%" PHAST_POS_FMT "-%" PHAST_POS_FMT "\" TARGET=_blank>", 
                       HGTRACKS_URL, posfeat[i]->seqname->chars, motstart[i], 
                       motend[i]);
             fprintf(F, "<font color=\"%s\">%c</font>", 
@@ -13,6 +13,7 @@
 #include <ctype.h>
 #include <maf_block.h>
 #include <misc.h>
+#include <profile.h>
 
 
 /** Read An Alignment from a MAF file.  The alignment won't be
@@ -26,19 +27,22 @@ MSA *maf_read_cats_subset(FILE *F, FILE *REFSEQF, int tuple_size,
    int store_order, char *reverse_groups, int gap_strip_mode, 
    int keep_overlapping, List *cats_to_do, List *seqnames, int seq_keep ) {
 
-  int i, start_idx, length, max_tuples, block_no,  
-    refseqlen = -1, do_toupper, last_refseqpos = -1;
+  int i, length, max_tuples, block_no, do_toupper;
+  phast_pos start_idx, refseqlen = -1, last_refseqpos = -1;
   Hashtable *tuple_hash;
   Hashtable *name_hash = hsh_new(25);
   MSA *msa, *mini_msa;
   GFF_Set *mini_gff = NULL;
   int gff_idx = 0, refseq_sorted = 1;
   msa_coord_map *map = NULL;
-  List *block_starts = lst_new_int(1000), *block_ends = lst_new_int(1000);
-  int last_gap_start = -1;
-  int idx_offset, end_idx, gap_sum=0;
-  int block_list_idx, prev_end, next_start;
-  int first_idx=-1, last_idx=-1, free_cm=0;
+  List *block_starts = lst_new_pos(1000), *block_ends = lst_new_pos(1000);
+  phast_pos last_gap_start = -1;
+  phast_pos idx_offset, end_idx, gap_sum=0;
+  phast_pos prev_end, next_start;
+  int block_list_idx;
+  phast_pos first_idx=-1, last_idx=-1;
+  int free_cm=0;
+  PROF_BEGIN(PROF_MAF_READ);
 
   if (gff != NULL) gap_strip_mode = 1; /* for now, automatically
                                           project if GFF (see comment
@@ -73,12 +77,12 @@ MSA *maf_read_cats_subset(FILE *F, FILE *REFSEQF, int tuple_size,
      projecting on the reference sequence */
   if (store_order && gap_strip_mode == NO_STRIP) {
     map = smalloc(sizeof(msa_coord_map));
-    map->seq_list = lst_new_int(1);
-    map->msa_list = lst_new_int(1);
+    map->seq_list = lst_new_pos(1);
+    map->msa_list = lst_new_pos(1);
     /* "prime" coord map */
     /* Note: re-prime map->seq_list later if msa->idx_offset > 0 */
-    lst_push_int(map->seq_list, 1);
-    lst_push_int(map->msa_list, 1);
+    lst_push_pos(map->seq_list, 1);
+    lst_push_pos(map->msa_list, 1);
   }
                                 /* inner lists will be allocated by maf_peek */
 
@@ -160,7 +164,8 @@ MSA *maf_read_cats_subset(FILE *F, FILE *REFSEQF, int tuple_size,
   block_no = 0;
   while (maf_read_block_addseq(F, mini_msa, name_hash, &start_idx,
 			       &length, do_toupper, seqnames != NULL && seq_keep) != EOF) {
-    checkInterruptN(block_no++, 1000);
+    checkInterruptN(block_no, 1000);
+    block_no++;
 
     //sequence may have been added in maf_read_block so reset numseqs
     //do not have to reset msa->names since they are shared with mini_msa
@@ -183,10 +188,10 @@ MSA *maf_read_cats_subset(FILE *F, FILE *REFSEQF, int tuple_size,
     /* ignore if redundant block: if start_idx < last_refseqpos, need to check list to
        see if region is redundant */
     if (!keep_overlapping && start_idx <= last_refseqpos) {
-       block_list_idx = lst_bsearch_int(block_starts, start_idx);
-       prev_end = block_list_idx >=0 ? lst_get_int(block_ends, block_list_idx) : -1;
+       block_list_idx = lst_bsearch_pos(block_starts, start_idx);
+       prev_end = block_list_idx >=0 ? lst_get_pos(block_ends, block_list_idx) : -1;
        next_start = block_list_idx + 1 < lst_size(block_starts) ?
-	lst_get_int(block_starts, block_list_idx+1) : end_idx + 1;
+	lst_get_pos(block_starts, block_list_idx+1) : end_idx + 1;
        if (prev_end >= start_idx || next_start <= end_idx)  { //redundant
 	 continue;
        }
@@ -202,34 +207,35 @@ MSA *maf_read_cats_subset(FILE *F, FILE *REFSEQF, int tuple_size,
         msa->idx_offset = first_idx < 0 ? 0 : first_idx;
         /* reprime map->seq_list if necessary */
         if (map != NULL && first_idx != 0)
-          lst_set_int(map->seq_list, 0, msa->idx_offset + 1);
+          lst_set_pos(map->seq_list, 0, msa->idx_offset + 1);
       }
     }
     if (start_idx + length > last_idx)
       last_idx = start_idx + length;
 
     /* add block to list to check for redundant blocks later */
-    lst_push_int(block_starts, start_idx);
-    lst_push_int(block_ends, end_idx);
+    lst_push_pos(block_starts, start_idx);
+    lst_push_pos(block_ends, end_idx);
 
     last_refseqpos = end_idx;
 
     /* collect info on gaps for coordinate map */
     if (map != NULL) {
-      int idx = start_idx, gaplen = 0, gapsum_block=0;
+      phast_pos idx = start_idx;
+      int gaplen = 0, gapsum_block=0;
       for (i = 0; i < mini_msa->length; i++) {
 	if (mini_msa->seqs[0][i] == GAP_CHAR) gaplen++;
 	else {
 	  if (gaplen > 0) {
 	    gap_sum += gaplen;
 	    if (idx == msa->idx_offset) 
-	      lst_set_int(map->msa_list, 0, gap_sum + 1);
+	      lst_set_pos(map->msa_list, 0, gap_sum + 1);
 	    else if (idx == last_gap_start) 
-	      lst_set_int(map->msa_list, lst_size(map->msa_list)-1, 
+	      lst_set_pos(map->msa_list, lst_size(map->msa_list)-1, 
 			  idx + gap_sum + 1 - msa->idx_offset);
 	    else {
-	      lst_push_int(map->msa_list, idx + gap_sum + 1 - msa->idx_offset);
-	      lst_push_int(map->seq_list, idx + 1);
+	      lst_push_pos(map->msa_list, idx + gap_sum + 1 - msa->idx_offset);
+	      lst_push_pos(map->seq_list, idx + 1);
 	    }
 	    last_gap_start = idx;
 	  }
@@ -243,11 +249,11 @@ MSA *maf_read_cats_subset(FILE *F, FILE *REFSEQF, int tuple_size,
 	gapsum_block += gaplen;
 	gap_sum += gaplen;
 	if (idx == last_gap_start) 
-	  lst_set_int(map->msa_list, lst_size(map->msa_list)-1, 
+	  lst_set_pos(map->msa_list, lst_size(map->msa_list)-1, 
 		      idx + gap_sum + 1 - msa->idx_offset);
 	else {
-	  lst_push_int(map->msa_list, idx + gap_sum + 1 - msa->idx_offset);
-	  lst_push_int(map->seq_list, idx + 1);
+	  lst_push_pos(map->msa_list, idx + gap_sum + 1 - msa->idx_offset);
+	  lst_push_pos(map->seq_list, idx + 1);
 	}
 	last_gap_start = idx;
       }
@@ -292,7 +298,7 @@ MSA *maf_read_cats_subset(FILE *F, FILE *REFSEQF, int tuple_size,
     if (map != NULL) {
       idx_offset = msa_map_seq_to_msa(map, start_idx + 1) - 1;
       if (idx_offset < 0)
-	die("ERROR maf_read_subset: invalid idx_offset %i\n", idx_offset);
+	die("ERROR maf_read_subset: invalid idx_offset %" PHAST_POS_FMT "\n", idx_offset);
 
       /* when the reference sequence begins with gaps, 
          start_idx will actually map to the first *non-gap*
@@ -300,7 +306,7 @@ MSA *maf_read_cats_subset(FILE *F, FILE *REFSEQF, int tuple_size,
       for (i = 0; mini_msa->seqs[0][i] == GAP_CHAR; i++) idx_offset--;
 
       if (idx_offset < 0)
-	die("ERROR maf_read_subset: invalid idx_offset2 %i\n", idx_offset);
+	die("ERROR maf_read_subset: invalid idx_offset2 %" PHAST_POS_FMT "\n", idx_offset);
     }
 
     else if (store_order) idx_offset = start_idx - msa->idx_offset; 
@@ -325,7 +331,8 @@ MSA *maf_read_cats_subset(FILE *F, FILE *REFSEQF, int tuple_size,
      alignments, fill in remaining tuples */
   if (store_order) {
     char tuple_str[msa->nseqs * tuple_size + 1];
-    int offset, tuple_idx, msa_idx, map_idx, fasthash_idx;
+    int offset, tuple_idx, map_idx, fasthash_idx;
+    phast_pos msa_idx;
     String *refseq;
     int alph_size = (int)strlen(msa->alphabet), nreftuples = int_pow(alph_size, tuple_size);
     int *fasthash = smalloc(nreftuples * sizeof(int));
@@ -336,7 +343,7 @@ MSA *maf_read_cats_subset(FILE *F, FILE *REFSEQF, int tuple_size,
     if (REFSEQF != NULL) {
       refseq = msa_read_seq_fasta(REFSEQF);
       if (refseq->length != refseqlen) 
-	die("ERROR: reference sequence length (%d) does not match description in MAF file (%d).\n", 
+	die("ERROR: reference sequence length (%d) does not match description in MAF file (%" PHAST_POS_FMT ").\n", 
 	    refseq->length, refseqlen);
     }
     else {
@@ -365,8 +372,8 @@ MSA *maf_read_cats_subset(FILE *F, FILE *REFSEQF, int tuple_size,
 
       /* use the coord map but avoid a separate lookup at each position */
       if (map != NULL) {
-        if (lst_get_int(map->seq_list, map_idx) - 1 == i + msa->idx_offset) 
-          msa_idx = lst_get_int(map->msa_list, map_idx++) - 1;
+        if (lst_get_pos(map->seq_list, map_idx) - 1 == i + msa->idx_offset) 
+          msa_idx = lst_get_pos(map->msa_list, map_idx++) - 1;
       }
       else msa_idx = i;
 
@@ -374,7 +381,7 @@ MSA *maf_read_cats_subset(FILE *F, FILE *REFSEQF, int tuple_size,
 	msa_realloc(msa, msa_idx+1, msa_idx + 10000, 0, store_order);
       
       if (msa_idx < 0)
-	die("ERROR maf_read_subset: msa_idx=%i, should be >=0\n",
+	die("ERROR maf_read_subset: msa_idx=%" PHAST_POS_FMT ", should be >=0\n",
 	    msa_idx);
 
       /* simple hack to handle the case where order is stored but 
@@ -479,6 +486,7 @@ MSA *maf_read_cats_subset(FILE *F, FILE *REFSEQF, int tuple_size,
   lst_free(block_ends);
   if (map != NULL) msa_map_free(map);
   if (free_cm) cm_free(cm);
+  PROF_END(PROF_MAF_READ, block_no);
   return msa;
 }
 
@@ -522,8 +530,8 @@ MSA *maf_read_unsorted(FILE *F, FILE *REFSEQF, int tuple_size, char *alphabet,
    it has to read through the MAF file twice to build a map, which can be 
    quite slow with large MAF files */
 
-  int i, start_idx, length, max_tuples, block_no, rbl_idx, 
-    refseqlen = -1, do_toupper;
+  int i, length, max_tuples, block_no, rbl_idx, do_toupper;
+  phast_pos start_idx, refseqlen = -1;
   Hashtable *tuple_hash;
   Hashtable *name_hash = hsh_new(25);
   MSA *msa, *mini_msa;
@@ -531,6 +539,7 @@ MSA *maf_read_unsorted(FILE *F, FILE *REFSEQF, int tuple_size, char *alphabet,
   int gff_idx = 0;
   List *redundant_blocks = lst_new_int(100);
   msa_coord_map *map = NULL;
+  PROF_BEGIN(PROF_MAF_READ);
 
 
   if (gff != NULL) gap_strip_mode = 1; /* for now, automatically
@@ -616,12 +625,13 @@ MSA *maf_read_unsorted(FILE *F, FILE *REFSEQF, int tuple_size, char *alphabet,
   rbl_idx = 0;
   while (maf_read_block(F, mini_msa, name_hash, &start_idx, 
                         &length, do_toupper) != EOF) {
-    int idx_offset;
+    phast_pos idx_offset;
     checkInterruptN(block_no, 1000);
+    block_no++;
 
     /* ignore if block is marked as redundant */
     if (lst_size(redundant_blocks) > rbl_idx &&
-        lst_get_int(redundant_blocks, rbl_idx) == block_no++) {
+        lst_get_int(redundant_blocks, rbl_idx) == block_no - 1) {
       rbl_idx++;
       continue;
     }
@@ -669,7 +679,7 @@ MSA *maf_read_unsorted(FILE *F, FILE *REFSEQF, int tuple_size, char *alphabet,
       for (i = 0; mini_msa->seqs[0][i] == GAP_CHAR; i++) idx_offset--;
 
       if (idx_offset < 0)
-	die("ERROR maf_read_unsorted: idx_offset=%i\n", idx_offset);
+	die("ERROR maf_read_unsorted: idx_offset=%" PHAST_POS_FMT "\n", idx_offset);
     }
 
     else if (store_order) idx_offset = start_idx; 
@@ -692,7 +702,8 @@ MSA *maf_read_unsorted(FILE *F, FILE *REFSEQF, int tuple_size, char *alphabet,
      alignments, fill in remaining tuples */
   if (store_order) {
     char tuple_str[msa->nseqs * tuple_size + 1];
-    int offset, tuple_idx, msa_idx, map_idx, fasthash_idx;
+    int offset, tuple_idx, map_idx, fasthash_idx;
+    phast_pos msa_idx;
     String *refseq;
     int alph_size = (int)strlen(msa->alphabet), nreftuples = int_pow(alph_size, tuple_size);
     int *fasthash = smalloc(nreftuples * sizeof(int));
@@ -710,7 +721,7 @@ MSA *maf_read_unsorted(FILE *F, FILE *REFSEQF, int tuple_size, char *alphabet,
 
     if ((map == NULL && refseq->length != refseqlen) ||
         (map != NULL && refseq->length != map->seq_len)) 
-      die("ERROR: reference sequence length (%d) does not match description in MAF file (%d).\n", 
+      die("ERROR: reference sequence length (%d) does not match description in MAF file (%" PHAST_POS_FMT ").\n", 
           refseq->length, map == NULL ? refseqlen : map->seq_len);
 
     for (offset = -1 * (tuple_size-1); offset <= 0; offset++) 
@@ -725,13 +736,13 @@ MSA *maf_read_unsorted(FILE *F, FILE *REFSEQF, int tuple_size, char *alphabet,
 
       /* use the coord map but avoid a separate lookup at each position */
       if (map != NULL) {
-        if (lst_get_int(map->seq_list, map_idx) - 1 == i) 
-          msa_idx = lst_get_int(map->msa_list, map_idx++) - 1;
+        if (lst_get_pos(map->seq_list, map_idx) - 1 == i) 
+          msa_idx = lst_get_pos(map->msa_list, map_idx++) - 1;
       }
       else msa_idx = i;
 
       if (msa_idx < 0)
-	die("ERROR maf_read_unsorted: msa_idx=%i\n", msa_idx);
+	die("ERROR maf_read_unsorted: msa_idx=%" PHAST_POS_FMT "\n", msa_idx);
 
       /* simple hack to handle the case where order is stored but 
          refseq is not available: use the char from the alignment if
@@ -830,6 +841,7 @@ MSA *maf_read_unsorted(FILE *F, FILE *REFSEQF, int tuple_size, char *alphabet,
   lst_free(redundant_blocks);
   if (map != NULL) msa_map_free(map);
   
+  PROF_END(PROF_MAF_READ, block_no);
   return msa;
 }
 
@@ -851,7 +863,7 @@ MSA *maf_read_old(FILE *f, FILE *REFSEQF, int tuple_size, char *alphabet,
    sequence indices (prefix of name wrt '.' character); sequences not
    present in a block will be represented by missing-data characters. */
 int maf_read_block_addseq(FILE *F, MSA *mini_msa, Hashtable *name_hash, 
-			  int *start_idx, int *length, int do_toupper,
+			  phast_pos *start_idx, int *length, int do_toupper,
 			  int skip_new_species) {
 
   int seqidx, more_blocks = 0, i, j;
@@ -889,7 +901,7 @@ int maf_read_block_addseq(FILE *F, MSA *mini_msa, Hashtable *name_hash,
     /* if this is the reference sequence, also grab start_idx and
        length and check strand */
     if (mini_msa->length == -1 && 
-        ((start_idx != NULL && str_as_int(lst_get_ptr(l, 2), start_idx) != 0) ||
+        ((start_idx != NULL && str_as_pos(lst_get_ptr(l, 2), start_idx) != 0) ||
         (length != NULL && str_as_int(lst_get_ptr(l, 3), length) != 0) ||
         ((String*)lst_get_ptr(l, 4))->chars[0] != '+')) {
       die("ERROR: bad integers or strand in MAF (strand must be + for reference sequence) --\n\t\"%s\"\n", linebuffer->chars);
@@ -983,7 +995,7 @@ int maf_read_block_addseq(FILE *F, MSA *mini_msa, Hashtable *name_hash,
    sequence indices (prefix of name wrt '.' character); sequences not
    present in a block will be represented by missing-data characters. */
 int maf_read_block(FILE *F, MSA *mini_msa, Hashtable *name_hash,
-                   int *start_idx, int *length, int do_toupper) {
+                   phast_pos *start_idx, int *length, int do_toupper) {
 
   int seqidx, more_blocks = 0, i, j;
   String *this_seq, *linebuffer = str_new(STR_VERY_LONG_LEN);
@@ -1020,7 +1032,7 @@ int maf_read_block(FILE *F, MSA *mini_msa, Hashtable *name_hash,
     /* if this is the reference sequence, also grab start_idx and
        length and check strand */
     if (mini_msa->length == -1 && 
-        ((start_idx != NULL && str_as_int(lst_get_ptr(l, 2), start_idx) != 0) ||
+        ((start_idx != NULL && str_as_pos(lst_get_ptr(l, 2), start_idx) != 0) ||
         (length != NULL && str_as_int(lst_get_ptr(l, 3), length) != 0) ||
         ((String*)lst_get_ptr(l, 4))->chars[0] != '+'))
       die("ERROR: bad integers or strand in MAF (strand must be + for reference sequence) --\n\t\"%s\"\n", linebuffer->chars);
@@ -1093,14 +1105,14 @@ int maf_read_block(FILE *F, MSA *mini_msa, Hashtable *name_hash,
 
 /* these are used in the function below */
 struct gap_pair {
-  int idx;
+  phast_pos idx;
   int len;
 };
 
 int gap_pair_compare(const void* ptr1, const void* ptr2) {
   struct gap_pair *gp1 = *(struct gap_pair**)ptr1;
   struct gap_pair *gp2 = *(struct gap_pair**)ptr2;
-  return gp1->idx - gp2->idx;
+  return (gp1->idx > gp2->idx) - (gp1->idx < gp2->idx);
 }
 
 
@@ -1110,9 +1122,10 @@ int gap_pair_compare(const void* ptr1, const void* ptr2) {
    index.  Also get the length of refseq.  If add_seqs==0 will
    not add any new seqs to names or name_hash (but still may
    re-order names to put refseq first) */
-void maf_quick_peek(FILE *F, char ***names, Hashtable *name_hash, int *nseqs, int *refseqlen, int add_seqs) {
+void maf_quick_peek(FILE *F, char ***names, Hashtable *name_hash, int *nseqs, phast_pos *refseqlen, int add_seqs) {
   String *line = str_new(STR_VERY_LONG_LEN);
-  int count = 0, seqidx = 0, tmp, startidx, i, j, length, linenum=0;
+  int count = 0, seqidx = 0, i, j, length, linenum=0;
+  phast_pos tmp, startidx;
   String *fullname = str_new(STR_SHORT_LEN), *name = str_new(STR_SHORT_LEN);
   List *l = lst_new_ptr(7);
   fpos_t pos;
@@ -1179,9 +1192,9 @@ void maf_quick_peek(FILE *F, char ***names, Hashtable *name_hash, int *nseqs, in
 	}
         str_split(line, NULL, l);
         if (lst_size(l) != 7 || 
-            str_as_int(lst_get_ptr(l, 2), &startidx) != 0 ||
+            str_as_pos(lst_get_ptr(l, 2), &startidx) != 0 ||
             str_as_int(lst_get_ptr(l, 3), &length) != 0 ||
-            str_as_int(lst_get_ptr(l, 5), &tmp) != 0) 
+            str_as_pos(lst_get_ptr(l, 5), &tmp) != 0) 
           die("ERROR: bad line in MAF file --\n\t\"%s\"\n", line->chars);
 
         if (*refseqlen == -1) *refseqlen = tmp;
@@ -1215,15 +1228,15 @@ void maf_quick_peek(FILE *F, char ***names, Hashtable *name_hash, int *nseqs, in
    sequence (map object assumed to be preallocated).  */
 void maf_peek(FILE *F, char ***names, Hashtable *name_hash, 
               int *nseqs, msa_coord_map *map, List *redundant_blocks,
-              int keep_overlapping, int *refseqlen) {
+              int keep_overlapping, phast_pos *refseqlen) {
   String *line = str_new(STR_VERY_LONG_LEN);
-  int count = 0, seqidx = 0, gaplen, tmp, startidx, i, 
-    length, last_endidx = -1, block_no = 0, skip = 0, endidx;
+  int count = 0, seqidx = 0, gaplen, i, length, block_no = 0, skip = 0;
+  phast_pos tmp, startidx, last_endidx = -1, endidx;
   String *fullname = str_new(STR_SHORT_LEN), *name = str_new(STR_SHORT_LEN);
   String *s;
   List *gp_list = (map != NULL ? lst_new_ptr(10000) : NULL);
-  List *l = lst_new_ptr(7), *block_starts = lst_new_int(1000), 
-    *block_ends = lst_new_int(1000);
+  List *l = lst_new_ptr(7), *block_starts = lst_new_pos(1000), 
+    *block_ends = lst_new_pos(1000);
   fpos_t pos;
 
   *refseqlen = -1;
@@ -1253,9 +1266,9 @@ void maf_peek(FILE *F, char ***names, Hashtable *name_hash,
       if (seqidx == 0 && !keep_overlapping) { /* reference sequence */
         str_split(line, NULL, l);
         if (lst_size(l) != 7 || 
-            str_as_int(lst_get_ptr(l, 2), &startidx) != 0 ||
+            str_as_pos(lst_get_ptr(l, 2), &startidx) != 0 ||
             str_as_int(lst_get_ptr(l, 3), &length) != 0 ||
-            str_as_int(lst_get_ptr(l, 5), &tmp) != 0) 
+            str_as_pos(lst_get_ptr(l, 5), &tmp) != 0) 
           die("ERROR: bad line in MAF file --\n\t\"%s\"\n", line->chars);
 
         if (*refseqlen == -1) *refseqlen = tmp;
@@ -1273,24 +1286,24 @@ void maf_peek(FILE *F, char ***names, Hashtable *name_hash,
            block; check for this first */
         endidx = startidx + length - 1;
         if (!skip && startidx > last_endidx) {
-          lst_push_int(block_starts, startidx);
-          lst_push_int(block_ends, endidx);
+          lst_push_pos(block_starts, startidx);
+          lst_push_pos(block_ends, endidx);
           last_endidx = endidx;
         }
         else if (!skip) {       /* have to search list */
-          int block_list_idx = lst_bsearch_int(block_starts, startidx);
-          int prev_end = block_list_idx >= 0 ? 
-            lst_get_int(block_ends, block_list_idx) : -1;
-          int next_start = block_list_idx+1 < lst_size(block_starts) ?
-            lst_get_int(block_starts, block_list_idx+1) : endidx+1;         
+          int block_list_idx = lst_bsearch_pos(block_starts, startidx);
+          phast_pos prev_end = block_list_idx >= 0 ? 
+            lst_get_pos(block_ends, block_list_idx) : -1;
+          phast_pos next_start = block_list_idx+1 < lst_size(block_starts) ?
+            lst_get_pos(block_starts, block_list_idx+1) : endidx+1;         
           if (prev_end >= startidx || next_start <= endidx) {
 /*             fprintf(stderr, "WARNING: MAF block (%d-%d in ref. seq.) overlaps a previous block -- ignoring.\n", startidx, endidx); */
             lst_push_int(redundant_blocks, block_no);
             skip = 1;
           }
           else {
-            lst_insert_idx_int(block_starts, block_list_idx, startidx);
-            lst_insert_idx_int(block_ends, block_list_idx, endidx);
+            lst_insert_idx(block_starts, block_list_idx, &startidx);
+            lst_insert_idx(block_ends, block_list_idx, &endidx);
             if (endidx > last_endidx) last_endidx = endidx;
           }
         }
@@ -1334,17 +1347,17 @@ void maf_peek(FILE *F, char ***names, Hashtable *name_hash,
 
   /* now build coordinate map, if necessary */
   if (map != NULL) {
-    int partial_gap_sum = 0;
+    phast_pos partial_gap_sum = 0;
     struct gap_pair *gp, *nextgp;
     
     lst_qsort(gp_list, gap_pair_compare);    
 
-    map->seq_list = lst_new_int(lst_size(gp_list) + 1);
-    map->msa_list = lst_new_int(lst_size(gp_list) + 1);
+    map->seq_list = lst_new_pos(lst_size(gp_list) + 1);
+    map->msa_list = lst_new_pos(lst_size(gp_list) + 1);
 
     /* "prime" coord map */
-    lst_push_int(map->seq_list, 1); 
-    lst_push_int(map->msa_list, 1);
+    lst_push_pos(map->seq_list, 1); 
+    lst_push_pos(map->msa_list, 1);
 
     /* build coord map from gap list */
     for (i = 0; i < lst_size(gp_list); i++) {
@@ -1356,7 +1369,7 @@ void maf_peek(FILE *F, char ***names, Hashtable *name_hash,
       /* if there is a gap prior to the beginning of the reference seq,
          then the first element of map->msa_list has to be reset */
       if (i == 0 && gp->idx == 0) {
-        lst_set_int(map->msa_list, 0, partial_gap_sum + 1);
+        lst_set_pos(map->msa_list, 0, partial_gap_sum + 1);
         continue;
       }
 
@@ -1364,8 +1377,8 @@ void maf_peek(FILE *F, char ***names, Hashtable *name_hash,
          immediate successor, then they have to be merged */
       if (nextgp != NULL && nextgp->idx == gp->idx) continue;
 
-      lst_push_int(map->seq_list, gp->idx + 1);
-      lst_push_int(map->msa_list, gp->idx + partial_gap_sum + 1);
+      lst_push_pos(map->seq_list, gp->idx + 1);
+      lst_push_pos(map->msa_list, gp->idx + partial_gap_sum + 1);
                                 /* note: coord map uses 1-based indexing */
       sfree(gp);
     }
@@ -1381,8 +1394,8 @@ void maf_peek(FILE *F, char ***names, Hashtable *name_hash,
    possible (see details below).  Shifts all coords such that
    start_idx is position 1.  Assumes main gff is sorted.  Designed for
    repeated calls. */
-void maf_block_sub_gff(GFF_Set *sub_gff, GFF_Set *gff, int start_idx, 
-                       int end_idx, int *gff_idx, CategoryMap *cm,
+void maf_block_sub_gff(GFF_Set *sub_gff, GFF_Set *gff, phast_pos start_idx, 
+                       phast_pos end_idx, int *gff_idx, CategoryMap *cm,
                        int reverse_compl, int tuple_size) {
   int first_extend = -1;
   GFF_Feature *feat;
@@ -1415,7 +1428,7 @@ void maf_block_sub_gff(GFF_Set *sub_gff, GFF_Set *gff, int start_idx,
       featcpy->start = start_idx;
     }
     if (featcpy->end > end_idx) {
-      int effective_end = end_idx;
+      phast_pos effective_end = end_idx;
       if (featcpy->strand == '-' && reverse_compl) 
 	effective_end -= (tuple_size - 1);
                                 /* if we truncate a feature that is to
@@ -117,7 +117,7 @@ MafSubBlock *mafBlock_get_subBlock(String *line) {
   str_shortest_root(sub->specName, '.');
 
   //field 2: should be start
-  sub->start = atol(((String*)lst_get_ptr(l, 2))->chars);
+  sub->start = strtoll(((String*)lst_get_ptr(l, 2))->chars, NULL, 10);
   
   //field 3: should be length
   sub->size = atoi(((String*)lst_get_ptr(l, 3))->chars);
@@ -131,7 +131,7 @@ MafSubBlock *mafBlock_get_subBlock(String *line) {
   else die("ERROR: got strand %s\n", str->chars);
   
   //field 5: should be srcSize
-  sub->srcSize = atol(((String*)lst_get_ptr(l, 5))->chars);
+  sub->srcSize = strtoll(((String*)lst_get_ptr(l, 5))->chars, NULL, 10);
 
   //field 6: sequence if sLine, eStatus if eLine.
   str = (String*)lst_get_ptr(l, 6);
@@ -439,7 +439,7 @@ void mafBlock_get_fieldSizes(MafBlock *block, int fieldSize[6]) {
       fieldSize[1] = sub->src->length;
 
     //field[2] is start
-    sprintf(tempstr, "%li", sub->start);
+    sprintf(tempstr, "%" PHAST_POS_FMT, sub->start);
     if (strlen(tempstr) > fieldSize[2])
       fieldSize[2] = (int)strlen(tempstr);
 
@@ -451,7 +451,7 @@ void mafBlock_get_fieldSizes(MafBlock *block, int fieldSize[6]) {
     //field[4] is strand... skip
     
     //field[5] is srcSize
-    sprintf(tempstr, "%li", sub->srcSize);
+    sprintf(tempstr, "%" PHAST_POS_FMT, sub->srcSize);
     if (strlen(tempstr) > fieldSize[5])
       fieldSize[5] = (int)strlen(tempstr);
 
@@ -480,8 +480,9 @@ void mafBlock_print(FILE *outfile, MafBlock *block, int pretty_print) {
     for (j=0; j<sub->numLine; j++) {
       firstChar = sub->lineType[j];
       if (firstChar == 's' || firstChar == 'e') {
-	sprintf(formatstr, "%%c %%-%is %%%ii %%%ii %%c %%%ii ",
-		fieldSize[1], fieldSize[2], fieldSize[3], fieldSize[5]);
+	sprintf(formatstr, "%%c %%-%is %%%i%s %%%ii %%c %%%i%s ",
+		fieldSize[1], fieldSize[2], PHAST_POS_FMT, fieldSize[3],
+		fieldSize[5], PHAST_POS_FMT);
 	fprintf(outfile, formatstr, firstChar, sub->src->chars,
 		sub->start, sub->size, sub->strand, sub->srcSize);
 	if (firstChar == 's') {
@@ -684,7 +685,7 @@ String *mafBlock_get_refSpec(MafBlock *block) {
   return sub->specName;
 }
 
-long mafBlock_get_start(MafBlock *block, String *specName) {
+phast_pos mafBlock_get_start(MafBlock *block, String *specName) {
   int idx=0;
   if (specName != NULL) 
     idx = hsh_get_int(block->specMap, specName->chars);
@@ -777,11 +778,11 @@ void mafBlock_subAlign(MafBlock *block, int start, int end) {
 //trim mafblock to only keep columns with indcies[startcol..endcol] wrt
 //refseq.  If refseq is null use frame of entire alignment.  If endcol is -1
 //then keep everything with index >= startcol.
-int mafBlock_trim(MafBlock *block, int startcol, int endcol, String *refseq,
-		  int offset) {
+int mafBlock_trim(MafBlock *block, phast_pos startcol, phast_pos endcol, 
+                  String *refseq, phast_pos offset) {
   MafSubBlock *sub=NULL;
   int i, specIdx, first=-1, last=-1, keep, length;
-  long startIdx, lastIdx, idx;
+  phast_pos startIdx, lastIdx, idx;
   if (block->seqlen == 0) return 0;
   if (refseq == NULL) {
     startIdx = 1;
@@ -857,7 +858,7 @@ void mafBlock_mask_region(MafBlock *block, GFF_Set *mask_feats, List *speclist)
   int next_feat_idx = 1;
   char **maskseq;
   int num_mask_seq=0;
-  long coord;
+  phast_pos coord;
   if (mask_feats == NULL || lst_size(mask_feats->features) == 0L) return;
   maskseq = smalloc(lst_size(speclist)*sizeof(char*));
   for (i=0; i < lst_size(speclist); i++) {
@@ -902,11 +903,11 @@ void mafBlock_mask_bases(MafBlock *block, int cutoff, FILE *outfile) {
   MafSubBlock *sub;
   int i, j, firstMasked;
   char *refseq=NULL, *refseqName;
-  long firstCoord, lastCoord=-1, *coord;
+  phast_pos firstCoord, lastCoord=-1, *coord;
 
   sub = (MafSubBlock*)lst_get_ptr(block->data, 0);
   refseq = sub->seq->chars;
-  coord = smalloc(block->seqlen*sizeof(long));
+  coord = smalloc(block->seqlen*sizeof(phast_pos));
   firstCoord = sub->start;
   refseqName = sub->src->chars;
   for (i=0; i < block->seqlen; i++) {
@@ -930,14 +931,14 @@ void mafBlock_mask_bases(MafBlock *block, int cutoff, FILE *outfile) {
       }
       else if (firstMasked != -1) {
 	if (outfile != NULL) {
-	  fprintf(outfile, "%s\t%li\t%li\t%s\n", 
+	  fprintf(outfile, "%s\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\t%s\n", 
 		  refseqName, coord[firstMasked], coord[j], sub->src->chars);
 	}
 	firstMasked = -1;
       }
     }
     if (outfile != NULL && firstMasked != -1) 
-      fprintf(outfile, "%s\t%li\t%li\t%s\n", refseqName, coord[firstMasked], lastCoord, sub->src->chars);
+      fprintf(outfile, "%s\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\t%s\n", refseqName, coord[firstMasked], lastCoord, sub->src->chars);
   }
   sfree(coord);
 }
@@ -58,7 +58,8 @@
    them).  The alphabet, however, will be copied into newly allocated
    memory.  If the "alphabet" argument is null, the default alphabet
    will be used. */
-MSA *msa_new(char **seqs, char **names, int nseqs, int length, char *alphabet) {
+MSA *msa_new(char **seqs, char **names, int nseqs, phast_pos length, 
+             char *alphabet) {
   int i;
   MSA *msa = (MSA*)smalloc(sizeof(MSA));
   msa->seqs = seqs;
@@ -361,7 +362,7 @@ void msa_print(FILE *F, MSA *msa, msa_format_type format, int pretty_print) {
   if (msa->seqs == NULL && msa->ss != NULL) ss_to_msa(msa);
 
   if (format == PHYLIP || format == MPM)
-    fprintf(F, "  %d %d\n", msa->nseqs, msa->length);
+    fprintf(F, "  %d %" PHAST_POS_FMT "\n", msa->nseqs, msa->length);
   if (format == MPM)
     for (i = 0; i < msa->nseqs; i++) 
       fprintf(F, "%s\n", msa->names[i]);
@@ -652,19 +653,20 @@ void msa_project(MSA *msa, int refseq) {
    seqlist to NULL.  The new alignment will represent the interval
    [start_col, end_col), in a frame such that the first character has
    index 0.  (that is, the end column will not be included).  */
-MSA* msa_sub_alignment(MSA *msa, List *seqlist, int include, int start_col, 
-                       int end_col) {
+MSA* msa_sub_alignment(MSA *msa, List *seqlist, int include, 
+                       phast_pos start_col, phast_pos end_col) {
   List *include_list;
-  int i, j;
+  int i;
+  phast_pos j;
   MSA *new_msa;
 
   int new_nseqs;
   char **new_names;
   char **new_seqs=NULL;
-  int new_len = end_col - start_col;
+  phast_pos new_len = end_col - start_col;
 
   if (new_len <= 0)
-    die("ERROR msa_sub_alignment got feature of length %i\n", new_len);
+    die("ERROR msa_sub_alignment got feature of length %" PHAST_POS_FMT "\n", new_len);
   if (msa->seqs==NULL && msa->ss == NULL)
     die("ERROR msa_sub_alignment: msa->seqs and msa->ss are NULL\n");
 
@@ -740,14 +742,15 @@ MSA* msa_sub_alignment(MSA *msa, List *seqlist, int include, int start_col,
    sequence.  Indexing begins with 1. */
 msa_coord_map* msa_build_coord_map(MSA *msa, int refseq) {
 
-  int i, j, last_char_gap;
+  phast_pos i, j;
+  int last_char_gap;
   msa_coord_map* map = (msa_coord_map*)smalloc(sizeof(msa_coord_map));
 
   if (msa->seqs == NULL && msa->ss == NULL)
     die("ERROR msa_build_coord_map: msa->seqs and msa->ss are NULL\n");
 
-  map->msa_list = lst_new_int(msa->length/10 + 1);
-  map->seq_list = lst_new_int(msa->length/10 + 1);
+  map->msa_list = lst_new_pos((int)(msa->length/10 + 1));
+  map->seq_list = lst_new_pos((int)(msa->length/10 + 1));
                                 /* list library will
                                  * srealloc if necessary */
   map->msa_len = msa->length;
@@ -762,8 +765,8 @@ msa_coord_map* msa_build_coord_map(MSA *msa, int refseq) {
       last_char_gap = 1;
     else {
       if (last_char_gap) {
-        lst_push_int(map->msa_list, i+1);
-        lst_push_int(map->seq_list, j+1);
+        lst_push_pos(map->msa_list, i+1);
+        lst_push_pos(map->seq_list, j+1);
       }
       j++;
       last_char_gap = 0;
@@ -777,40 +780,42 @@ msa_coord_map* msa_build_coord_map(MSA *msa, int refseq) {
 void msa_coord_map_print(FILE *F, msa_coord_map *map) {
   int i;
   for (i = 0; i < lst_size(map->seq_list); i++)
-    fprintf(F, "%d\t%d\t%d\n", lst_get_int(map->seq_list, i), lst_get_int(map->msa_list, i), i > 0 ? lst_get_int(map->msa_list, i) - lst_get_int(map->seq_list, i) - lst_get_int(map->msa_list, i-1) + lst_get_int(map->seq_list, i-1) : -1);
+    fprintf(F, "%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\n", lst_get_pos(map->seq_list, i), lst_get_pos(map->msa_list, i), i > 0 ? lst_get_pos(map->msa_list, i) - lst_get_pos(map->seq_list, i) - lst_get_pos(map->msa_list, i-1) + lst_get_pos(map->seq_list, i-1) : -1);
 }
 
 /* Using a specified coordinate map object, converts a sequence
    coordinate to an MSA coordinate.  Indexing begins with 1. 
    Returns -1 if sequence coordinate is out of bounds. */
-int msa_map_seq_to_msa(msa_coord_map *map, int seq_pos) {
-  int idx, prec_match_msa_pos, prec_match_seq_pos;
+phast_pos msa_map_seq_to_msa(msa_coord_map *map, phast_pos seq_pos) {
+  int idx;
+  phast_pos prec_match_msa_pos, prec_match_seq_pos;
   if (seq_pos < 1 || seq_pos > map->seq_len) return -1;
-  idx = lst_bsearch_int(map->seq_list, seq_pos);
+  idx = lst_bsearch_pos(map->seq_list, seq_pos);
   if (idx < 0 || idx >= lst_size(map->msa_list))
     die("ERROR msa_map_seq_to_msa: idx=%i, should be in [0,%i)\n",
 	idx, 0, lst_size(map->msa_list));
-  prec_match_msa_pos = lst_get_int(map->msa_list, idx);
-  prec_match_seq_pos = lst_get_int(map->seq_list, idx);
+  prec_match_msa_pos = lst_get_pos(map->msa_list, idx);
+  prec_match_seq_pos = lst_get_pos(map->seq_list, idx);
   return (prec_match_msa_pos + (seq_pos - prec_match_seq_pos));
 }
 
 /* Using a specified coordinate map object, converts an MSA coordinate
    to a sequence coordinate.  Returns -1 if index is out of range.
    Indexing begins with 1. */
-int msa_map_msa_to_seq(msa_coord_map *map, int msa_pos) {
-  int idx, prec_match_msa_pos, prec_match_seq_pos, next_match_seq_pos, 
+phast_pos msa_map_msa_to_seq(msa_coord_map *map, phast_pos msa_pos) {
+  int idx;
+  phast_pos prec_match_msa_pos, prec_match_seq_pos, next_match_seq_pos, 
     seq_pos;
   if (msa_pos < 1 || msa_pos > map->msa_len) return -1;
-  idx = lst_bsearch_int(map->msa_list, msa_pos);
+  idx = lst_bsearch_pos(map->msa_list, msa_pos);
   if (idx < 0) return -1;
   if (idx >= lst_size(map->msa_list))
     die("ERROR msa_map_msa_to_seq: idx=%i, should be < %i\n",
 	idx, 0, lst_size(map->msa_list));
-  prec_match_msa_pos = lst_get_int(map->msa_list, idx);
-  prec_match_seq_pos = lst_get_int(map->seq_list, idx);
+  prec_match_msa_pos = lst_get_pos(map->msa_list, idx);
+  prec_match_seq_pos = lst_get_pos(map->seq_list, idx);
   next_match_seq_pos = (idx < lst_size(map->seq_list) - 1 ? 
-                        lst_get_int(map->seq_list, idx + 1) :
+                        lst_get_pos(map->seq_list, idx + 1) :
                         map->seq_len + 1);
 
   seq_pos = prec_match_seq_pos + (msa_pos - prec_match_msa_pos);
@@ -826,8 +831,8 @@ int msa_map_msa_to_seq(msa_coord_map *map, int msa_pos) {
 /* Create an empty coordinate map, of the specified starting size */
 msa_coord_map* msa_new_coord_map(int size) {
   msa_coord_map* map = (msa_coord_map*)smalloc(sizeof(msa_coord_map));
-  map->msa_list = lst_new_int(size);
-  map->seq_list = lst_new_int(size);
+  map->msa_list = lst_new_pos(size);
+  map->seq_list = lst_new_pos(size);
   map->msa_len = map->seq_len = -1;
   return map;
 }
@@ -843,10 +848,80 @@ void msa_map_free(msa_coord_map *map) {
 /* TODO: document "MSA" convention; provide option to specify source sequence 
    explicitly */
 /* warning: requires coordinates of GFF_Set to be in frame of ref of entire alignment */
+/* label the columns of a single feature, whose category is cat.
+   Used by msa_label_categories and msa_label_categories_compact.
+   *prev_name and *seq cache the index of the sequence named by the
+   last feature.  Returns 1 if the feature is out of range, 0
+   otherwise */
+static int msa_label_feature(MSA *msa, CategoryMap *cm, int cat,
+                             const char *seqname, phast_pos start, 
+                             phast_pos end, char strand, int frame, 
+                             const char **prev_name, int *seq) {
+  phast_pos j;
+
+  if (end < start) return 0;
+  if (start == -1 || end == -1 || end > msa->length) 
+    return 1;
+
+  if (cm->ranges[cat]->start_cat_no == cm->ranges[cat]->end_cat_no) {
+    for (j = start; j <= end; j++) {
+      int oldprec = cm->labelling_precedence[msa->categories[j-1]];
+      int newprec = cm->labelling_precedence[cat];
+      if (oldprec == -1 || (newprec != -1 && newprec < oldprec))
+        msa->categories[j-1] = cat;
+    }
+  }
+  else {
+    int range_size = cm->ranges[cat]->end_cat_no - 
+      cm->ranges[cat]->start_cat_no + 1;
+    int frm;
+
+    if (!strcasecmp(seqname, "MSA")) 
+      *seq = -1;
+    else if (*prev_name == NULL || strcmp(*prev_name, seqname) != 0) {
+      if ((*seq = msa_get_seq_idx(msa, seqname)) == -1) 
+        die("ERROR: name %s not present in MSA.\n", seqname);
+      *prev_name = seqname;
+    }
+
+    if (frame < 0 || frame > 2)
+      frm = 0;                  /* FIXME: something better here? */
+    else
+      frm = frame;
+
+    int thiscat = cm->ranges[cat]->start_cat_no + (frm % range_size);
+    phast_pos jstart, jend;
+    int jdir;
+    if (strand != '-') {
+      jstart = start;
+      jend = end + 1;
+      jdir = 1;
+    } else {
+      jstart = end;
+      jend = start - 1;
+      jdir = -1;
+    }
+    for (j = jstart; j != jend; j += jdir) {
+      int oldprec = cm->labelling_precedence[msa->categories[j-1]];
+      int thisprec = cm->labelling_precedence[thiscat];
+      if (oldprec == -1 || (thisprec != -1 && thisprec < oldprec))
+        msa->categories[j-1] = thiscat;
+      //only change cycle if source sequence does not have a gap
+      if (*seq == -1 || msa_get_char(msa, *seq, j-1) != GAP_CHAR) {
+        thiscat++;
+        if (thiscat > cm->ranges[cat]->end_cat_no)
+          thiscat = cm->ranges[cat]->start_cat_no;
+      }
+    }
+  }
+  return 0;
+}
+
 void msa_label_categories(MSA *msa, GFF_Set *gff, CategoryMap *cm) {
-  int cat, i, j, seq=-1;
+  int cat, seq=-1;
+  phast_pos i;
   GFF_Feature *feat;
-  String *prev_name = NULL;
+  const char *prev_name = NULL;
 
   if (msa->categories == NULL) 
     msa->categories = (int*)smalloc(msa->length * sizeof(int));
@@ -857,71 +932,63 @@ void msa_label_categories(MSA *msa, GFF_Set *gff, CategoryMap *cm) {
 
   for (i = 0; i < lst_size(gff->features); i++) {
     checkInterruptN(i, 100);
-    feat = (GFF_Feature*)lst_get_ptr(gff->features, i);
+    feat = (GFF_Feature*)lst_get_ptr(gff->features, (int)i);
     cat = cm_get_category(cm, feat->feature); 
 
     if (cat == 0 && !str_equals_charstr(feat->feature, BACKGD_CAT_NAME))
       continue;                 /* don't label in case of unrecognized
                                    feature */
 
-    if (feat->end < feat->start) continue;
-    if (feat->start == -1 || feat->end == -1 || feat->end > msa->length) {
+    if (msa_label_feature(msa, cm, cat, feat->seqname->chars, feat->start,
+                          feat->end, feat->strand, feat->frame, &prev_name,
+                          &seq) != 0) {
       phast_warning("WARNING: ignoring out-of-range feature\n");
       gff_print_feat(stderr, feat);
-      continue;
-    }  
-
-    if (cm->ranges[cat]->start_cat_no == cm->ranges[cat]->end_cat_no) {
-      for (j = feat->start; j <= feat->end; j++) {
-        int oldprec = cm->labelling_precedence[msa->categories[j-1]];
-        int newprec = cm->labelling_precedence[cat];
-        if (oldprec == -1 || (newprec != -1 && newprec < oldprec))
-          msa->categories[j-1] = cat;
-      }
     }
-    else {
-      int range_size = cm->ranges[cat]->end_cat_no - 
-        cm->ranges[cat]->start_cat_no + 1;
-      int frm;
+  }
+  if (msa->ss != NULL) 
+    ss_update_categories(msa);
+}
 
-      if (str_equals_nocase_charstr(feat->seqname, "MSA")) 
-	seq = -1;
-      else if (prev_name == NULL || !str_equals(prev_name, feat->seqname)) {
-	if ((seq = msa_get_seq_idx(msa, feat->seqname->chars)) == -1) 
-	  die("ERROR: name %s not present in MSA.\n", feat->seqname->chars);
-	prev_name = feat->seqname;
-      }
+/* same as msa_label_categories, but for a compact feature set.  The
+   category of each feature type is looked up only once */
+void msa_label_categories_compact(MSA *msa, GFF_CompactSet *gff, 
+                                  CategoryMap *cm) {
+  int seq=-1;
+  phast_pos i;
+  int *name_cat = smalloc(lst_size(gff->names) * sizeof(int));
+  const char *prev_name = NULL;
+  String *type = str_new(STR_SHORT_LEN);
 
-      if (feat->frame < 0 || feat->frame > 2)
-        frm = 0;                /* FIXME: something better here? */
-      else
-        frm = feat->frame;
-
-      int thiscat = cm->ranges[cat]->start_cat_no + (frm % range_size);
-      int jstart, jend, jdir;
-      if (feat->strand != '-') {
-	jstart = feat->start;
-	jend = feat->end + 1;
-	jdir = 1;
-      } else {
-	jstart = feat->end;
-	jend = feat->start - 1;
-	jdir = -1;
-      }
-      for (j = jstart; j != jend; j += jdir) {
-	int oldprec = cm->labelling_precedence[msa->categories[j-1]];
-	int thisprec = cm->labelling_precedence[thiscat];
-	if (oldprec == -1 || (thisprec != -1 && thisprec < oldprec))
-	  msa->categories[j-1] = thiscat;
-	//only change cycle if source sequence does not have a gap
-	if (seq == -1 || msa_get_char(msa, seq, j-1) != GAP_CHAR) {
-	  thiscat++;
-	  if (thiscat > cm->ranges[cat]->end_cat_no)
-	    thiscat = cm->ranges[cat]->start_cat_no;
-	}
-      }
+  if (msa->categories == NULL) 
+    msa->categories = (int*)smalloc(msa->length * sizeof(int));
+  msa->ncats = cm->ncats;
+
+  for (i = 0; i < msa->length; i++) msa->categories[i] = 0;
+
+  /* -1 for unrecognized feature types */
+  for (i = 0; i < lst_size(gff->names); i++) {
+    str_cpy_charstr(type, gffc_name(gff, i));
+    name_cat[i] = cm_get_category(cm, type);
+    if (name_cat[i] == 0 && !str_equals_charstr(type, BACKGD_CAT_NAME))
+      name_cat[i] = -1;
+  }
+
+  for (i = 0; i < gff->nfeatures; i++) {
+    int cat = name_cat[gff->feature[i]];
+    checkInterruptN(i, 1000);
+    if (cat == -1) continue;
+
+    if (msa_label_feature(msa, cm, cat, gffc_name(gff, gff->seqname[i]), 
+                          gff->start[i], gff->end[i], gff->strand[i], 
+                          gff->frame[i], &prev_name, &seq) != 0) {
+      phast_warning("WARNING: ignoring out-of-range feature\n");
+      gffc_print_feat(stderr, gff, i);
     }
   }
+
+  sfree(name_cat);
+  str_free(type);
   if (msa->ss != NULL) 
     ss_update_categories(msa);
 }
@@ -945,6 +1012,103 @@ int msa_get_seq_idx(MSA *msa, const char *name) {
   return retval;
 }
 
+/* map the coordinates of a single feature from sequence fseq to
+   sequence tseq (1-based indices, or 0 for the frame of the entire
+   alignment).  Used by msa_map_gff_coords and msa_map_gffc_coords.
+   maps caches coordinate maps by sequence index.  Updates *start,
+   *end, and *frame, and returns 0 if the feature falls outside the
+   new frame of reference and should be dropped, 1 otherwise */
+static int msa_map_feature_coords(MSA *msa, msa_coord_map **maps, int fseq, 
+                                  int tseq, phast_pos offset, 
+                                  const char *type, char strand,
+                                  phast_pos *start, phast_pos *end, 
+                                  int *frame) {
+  msa_coord_map *from_map = NULL, *to_map = NULL;
+  phast_pos j, s, e, orig_span;
+
+  if ((from_map = maps[fseq]) == NULL && fseq > 0) 
+    from_map = maps[fseq] = msa_build_coord_map(msa, fseq);
+
+  if ((to_map = maps[tseq]) == NULL && tseq > 0) 
+    to_map = maps[tseq] = msa_build_coord_map(msa, tseq);
+
+  orig_span = *end - *start;
+
+  /* from_map, to_map will be NULL iff fseq, to_seq are 0 */
+  s = msa_map_seq_to_seq(from_map, to_map, *start);
+  e = msa_map_seq_to_seq(from_map, to_map, *end);
+
+  if (s < 0 && e < 0) 
+    return 0;
+
+  /* Adjust start coordinate if element starts in gap in 
+     new reference frame (if refernece is not entire alignment). */
+  if (tseq != 0) {
+    phast_pos mstart, mend;
+    // first convert to msa coords
+    if (fseq==0) {
+      mstart=*start-1;
+      mend=*end;
+    } else {
+      mstart=msa_map_seq_to_seq(from_map, NULL, *start)-1;
+      mend=msa_map_seq_to_seq(from_map, NULL, *end);
+    }
+    for (j=mstart; j<mend; j++)
+      if (msa_get_char(msa, tseq-1, j) != GAP_CHAR)
+        break;
+    if (j==mend) 
+      return 0;
+    if (j!=mstart) 
+      s = msa_map_seq_to_seq(NULL, to_map, j+1);
+  }
+    
+  if (s < 0 && *frame != GFF_NULL_FRAME && strand != '-') {
+    //this is the coordinate of adjusted start in fseq
+    phast_pos newstart_from = msa_map_seq_to_seq(to_map, from_map, 1);
+    *frame = (*frame + newstart_from - *start)%3;
+  }
+  *start = (s < 0 ? 1 : s) + offset;
+
+  if (e < 0) {
+    phast_pos newend = (to_map != NULL ? to_map->seq_len : msa->length);
+    if (*frame != GFF_NULL_FRAME && strand == '-') {
+      //this is coordinate of adjusted end in fseq
+      phast_pos newend_from = msa_map_seq_to_seq(to_map, from_map, newend);
+      *frame = (*frame + *end - newend_from);
+    }
+    *end = newend + offset;
+  }
+  else
+    *end = e + offset;
+
+  /* TEMPORARY: Prevent overall size of "signal" (non-cyclic)
+     features from changing.  This needs to be redone in a general
+     way, e.g., using a def. in the cm of cyclic versus non-cyclic
+     categories, and a definition of an "anchor" site for non-cyclic
+     ones (acs, 1/04) */
+  if (*end - *start != orig_span) {
+    int lanchor = FALSE, ranchor = FALSE;
+
+    /* left-anchored */
+    if (!strcmp(type, "5'splice") || !strcmp(type, "start_codon") || 
+        !strcmp(type, "stop_codon") || !strcmp(type, "cds3'ss")) 
+      lanchor = TRUE;
+    /* right-anchored */
+    else if (!strcmp(type, "3'splice") || !strcmp(type, "cds5'ss") ||
+             !strcmp(type, "prestart"))
+      ranchor = TRUE;
+
+    if ((lanchor && strand == '+') || (ranchor && strand == '-'))
+      *end = *start + orig_span;
+    else if ((ranchor && strand == '+') || (lanchor && strand == '-'))
+      *start = *end - orig_span;
+  }
+
+  /* NOTE: fill precedence stuff now removed -- should take out of
+     category_map.c */
+  return 1;
+}
+
 /* converts coordinates of all features in a GFF_Set from one frame of
    reference to another.  Arguments from and to may be an index
    between 1 and nseqs, or 0 (for the frame of the entire alignment).
@@ -954,15 +1118,14 @@ int msa_get_seq_idx(MSA *msa, const char *name) {
    of range, they will be truncated. If cm is non-NULL, features
    within groups will be forced to be contiguous. */
 void msa_map_gff_coords(MSA *msa, GFF_Set *gff, int from_seq, int to_seq, 
-                        int offset) {
+                        phast_pos offset) {
 
   msa_coord_map **maps;
   int fseq = from_seq;
   int tseq = to_seq;
   String *prev_name = NULL;
-  msa_coord_map *from_map = NULL, *to_map = NULL;
   GFF_Feature *feat;
-  int i, j, s, e, orig_span;
+  int i;
   List *keepers = lst_new_ptr(lst_size(gff->features));
 
   maps = (msa_coord_map**)smalloc((msa->nseqs + 1) * 
@@ -1002,106 +1165,77 @@ void msa_map_gff_coords(MSA *msa, GFF_Set *gff, int from_seq, int to_seq,
         tseq++;                 /* need 1-based index */
       }
     }
-    if ((from_map = maps[fseq]) == NULL && fseq > 0) 
-      from_map = maps[fseq] = msa_build_coord_map(msa, fseq);
-
-    if ((to_map = maps[tseq]) == NULL && tseq > 0) 
-      to_map = maps[tseq] = msa_build_coord_map(msa, tseq);
 
-    orig_span = feat->end - feat->start;
-
-    /* from_map, to_map will be NULL iff fseq, to_seq are 0 */
-    s = msa_map_seq_to_seq(from_map, to_map, feat->start);
-    e = msa_map_seq_to_seq(from_map, to_map, feat->end);
-
-    if (s < 0 && e < 0) {
+    if (!msa_map_feature_coords(msa, maps, fseq, tseq, offset, 
+                                feat->feature->chars, feat->strand,
+                                &feat->start, &feat->end, &feat->frame)) {
       if (prev_name == feat->seqname) prev_name = NULL;
       gff_free_feature(feat);
       continue;
     }
+    lst_push_ptr(keepers, feat);
+  }
 
-    /* Adjust start coordinate if element starts in gap in 
-       new reference frame (if refernece is not entire alignment). */
-    if (tseq != 0) {
-      int mstart, mend;
-      // first convert to msa coords
-      if (fseq==0) {
-	mstart=feat->start-1;
-	mend=feat->end;
-      } else {
-	mstart=msa_map_seq_to_seq(from_map, NULL, feat->start)-1;
-	mend=msa_map_seq_to_seq(from_map, NULL, feat->end);
-      }
-      for (j=mstart; j<mend; j++)
-	if (msa_get_char(msa, tseq-1, j) != GAP_CHAR)
-	  break;
-      if (j==mend) {
-	if (prev_name == feat->seqname) prev_name = NULL;
-	gff_free_feature(feat);
-	continue;
-      }
-      if (j!=mstart) 
-        s = msa_map_seq_to_seq(NULL, to_map, j+1);
-    }
-    
-    if (s < 0 && feat->frame != GFF_NULL_FRAME && feat->strand != '-') {
-      //this is the coordinate of adjusted start in fseq
-      int newstart_from = msa_map_seq_to_seq(to_map, from_map, 1);
-      feat->frame = (feat->frame + newstart_from - feat->start)%3;
-    }
-    feat->start = (s < 0 ? 1 : s) + offset;
+  if (from_seq != to_seq) {
+    lst_free(gff->features);
+    gff->features = keepers;
+    if (gff->groups != NULL) gff_ungroup(gff);
+  }
+  else lst_free(keepers);
 
-    
-    if (e < 0) {
-      int newend = (to_map != NULL ? to_map->seq_len : msa->length);
-      if (feat->frame != GFF_NULL_FRAME && feat->strand == '-') {
-	//this is coordinate of adjusted end in fseq
-	int newend_from = msa_map_seq_to_seq(to_map, from_map, newend);
-	feat->frame = (feat->frame + feat->end - newend_from);
-      }
-      feat->end = newend + offset;
-    }
-    else
-      feat->end = e + offset;
+  for (i = 1; i <= msa->nseqs; i++)
+    if (maps[i] != NULL) msa_map_free(maps[i]);
+  sfree(maps);
+}
 
-    lst_push_ptr(keepers, feat);
+/* same as msa_map_gff_coords, but for a compact feature set */
+void msa_map_gffc_coords(MSA *msa, GFF_CompactSet *gff, int from_seq, 
+                         int to_seq, phast_pos offset) {
+  msa_coord_map **maps;
+  int fseq = from_seq, tseq = to_seq, prev_name = -1, i, frame;
+  char *keep;
 
-    /* TEMPORARY: Prevent overall size of "signal" (non-cyclic)
-       features from changing.  This needs to be redone in a general
-       way, e.g., using a def. in the cm of cyclic versus non-cyclic
-       categories, and a definition of an "anchor" site for non-cyclic
-       ones (acs, 1/04) */
-    if (feat->end - feat->start != orig_span) {
-      int lanchor = FALSE, ranchor = FALSE;
+  if (from_seq == to_seq) {
+    for (i = 0; i < gff->nfeatures; i++) {
+      gff->start[i] += offset;
+      gff->end[i] += offset;
+    }
+    gff->indexed = FALSE;
+    return;
+  }
 
-      /* left-anchored */
-      if (str_equals_charstr(feat->feature, "5'splice") || 
-          str_equals_charstr(feat->feature, "start_codon") || 
-          str_equals_charstr(feat->feature, "stop_codon") || 
-          str_equals_charstr(feat->feature, "cds3'ss")) 
-        lanchor = TRUE;
-      /* right-anchored */
-      else if (str_equals_charstr(feat->feature, "3'splice") || 
-               str_equals_charstr(feat->feature, "cds5'ss") ||
-               str_equals_charstr(feat->feature, "prestart"))
-        ranchor = TRUE;
+  maps = (msa_coord_map**)smalloc((msa->nseqs + 1) * 
+                                  sizeof(msa_coord_map*));
+  for (i = 0; i <= msa->nseqs; i++) maps[i] = NULL;
+  keep = smalloc(max(gff->nfeatures, 1) * sizeof(char));
 
-      if ((lanchor && feat->strand == '+') || (ranchor && feat->strand == '-'))
-        feat->end = feat->start + orig_span;
-      else if ((ranchor && feat->strand == '+') || (lanchor && feat->strand == '-'))
-        feat->start = feat->end - orig_span;
-    }
+  for (i = 0; i < gff->nfeatures; i++) {
+    char *name = gffc_name(gff, gff->seqname[i]);
+    int *seq = (from_seq == -1 ? &fseq : (to_seq == -1 ? &tseq : NULL));
+    checkInterruptN(i, 1000);
 
-    /* NOTE: fill precedence stuff now removed -- should take out of
-       category_map.c */
-  }
+    /* names are interned, so can compare indices */
+    if (seq != NULL && gff->seqname[i] != prev_name) {
+      if (!strcasecmp(name, "MSA")) 
+        *seq = 0;
+      else {
+        if ((*seq = msa_get_seq_idx(msa, name)) == -1)
+          die("ERROR: name %s not present in MSA.\n", name);
+        (*seq)++;               /* need 1-based index */
+      }
+      prev_name = gff->seqname[i];
+    }
 
-  if (from_seq != to_seq) {
-    lst_free(gff->features);
-    gff->features = keepers;
-    if (gff->groups != NULL) gff_ungroup(gff);
+    frame = gff->frame[i];
+    keep[i] = (char)msa_map_feature_coords(msa, maps, fseq, tseq, offset, 
+                                           gffc_name(gff, gff->feature[i]),
+                                           gff->strand[i], &gff->start[i],
+                                           &gff->end[i], &frame);
+    gff->frame[i] = (signed char)frame;
   }
+  gffc_filter(gff, keep);
 
+  sfree(keep);
   for (i = 1; i <= msa->nseqs; i++)
     if (maps[i] != NULL) msa_map_free(maps[i]);
   sfree(maps);
@@ -1113,10 +1247,11 @@ void msa_map_gff_coords(MSA *msa, GFF_Set *gff, int from_seq, int to_seq,
   MSA*/
 MSA **msa_split_by_gff(MSA *msa, GFF_Set *gff) {
   MSA **msas = NULL;
-  int *starts, i;
+  phast_pos *starts;
+  int i;
   GFF_Feature *feat;
 
-  starts = smalloc(lst_size(gff->features) * sizeof(int));
+  starts = smalloc(lst_size(gff->features) * sizeof(phast_pos));
   for (i=0; i < lst_size(gff->features); i++) {
     checkInterruptN(i, 1000);
     feat = lst_get_ptr(gff->features, i);
@@ -1146,9 +1281,9 @@ MSA **msa_split_by_gff(MSA *msa, GFF_Set *gff) {
    indicate frame of entire alignment.
    Returns -1 if out of range.
 */
-int msa_map_seq_to_seq(msa_coord_map *from_map, msa_coord_map *to_map, 
-                       int coord) { 
-  int msa_coord = (from_map == NULL ? coord : 
+phast_pos msa_map_seq_to_seq(msa_coord_map *from_map, msa_coord_map *to_map, 
+                             phast_pos coord) { 
+  phast_pos msa_coord = (from_map == NULL ? coord : 
     msa_map_seq_to_msa(from_map, coord));
   if (msa_coord == -1) return -1;
   return (to_map == NULL ? msa_coord : msa_map_msa_to_seq(to_map, msa_coord));
@@ -1227,8 +1362,8 @@ char msa_compl_char(char c) {
   return c;
 }
 
-void msa_reverse_compl_seq(char *seq, int length) {
-  int i, midpt;
+void msa_reverse_compl_seq(char *seq, phast_pos length) {
+  phast_pos i, midpt;
   if (length <= 0) return;
   midpt = (length-1)/2;
   for (i = 0; i <= midpt; i++) {
@@ -1245,8 +1380,8 @@ void msa_reverse_compl_seq(char *seq, int length) {
 /* Similar to above, but for a segment of a sequence.  Note: start and
    end both inclusive and using indexing system that begins with 1
    (*not* the system used for storage). */
-void msa_reverse_compl_seq_segment(char *seq, int start, int end) {
-  int i, midpt;
+void msa_reverse_compl_seq_segment(char *seq, phast_pos start, phast_pos end) {
+  phast_pos i, midpt;
   start--; end--;               /* switch to indexing system used for storage */
   if (end < start) return;
   midpt = start + (end-start)/2; 
@@ -1262,8 +1397,8 @@ void msa_reverse_compl_seq_segment(char *seq, int start, int end) {
 }
 
 /* Same as above, but for an auxiliary array of integers */
-void msa_reverse_data_segment(int *data, int start, int end) {
-  int i, midpt;
+void msa_reverse_data_segment(int *data, phast_pos start, phast_pos end) {
+  phast_pos i, midpt;
   start--; end--; 
   if (end < start) return;
   midpt = start + (end-start)/2; 
@@ -1312,7 +1447,7 @@ void msa_reverse_compl(MSA *msa) {
 /* Reverse complement a segment of an alignment.  Note: start and end
    both inclusive and using indexing system that begins with 1 (*not*
    the system used for storage). */
-void msa_reverse_compl_segment(MSA *msa, int start, int end) {
+void msa_reverse_compl_segment(MSA *msa, phast_pos start, phast_pos end) {
   int i;
   if (msa->ss != NULL)  //for now
     die("ERROR msa_reverse_compl_segment: got msa->ss == NULL\n");
@@ -1473,8 +1608,8 @@ void msa_partition_by_category(MSA *msa, List *submsas, List *cats_to_do,
    MSA summary (all following lines must describe MSAs having the same
    alphabet).  If start and end are *not* equal to -1, prints stats
    only for indicated interval (half-open, 0-based) */  
-void msa_print_stats(MSA *msa, FILE *F, char *label, int header, int start, 
-                     int end) {
+void msa_print_stats(MSA *msa, FILE *F, char *label, int header, 
+                     phast_pos start, phast_pos end) {
   if (header == 1) {
     int i;
     fprintf(F, "%-20s ", "descrip.");
@@ -1487,8 +1622,8 @@ void msa_print_stats(MSA *msa, FILE *F, char *label, int header, int start,
   }
   else {
     Vector *freqs = msa_get_base_freqs(msa, start, end);
-    int nallgaps = msa_num_gapped_cols(msa, STRIP_ALL_GAPS, start, end);
-    int nanygaps = msa_num_gapped_cols(msa, STRIP_ANY_GAPS, start, end);
+    phast_pos nallgaps = msa_num_gapped_cols(msa, STRIP_ALL_GAPS, start, end);
+    phast_pos nanygaps = msa_num_gapped_cols(msa, STRIP_ANY_GAPS, start, end);
     int i;
     double gc = 0;
     fprintf(F, "%-20s ", label);
@@ -1498,9 +1633,9 @@ void msa_print_stats(MSA *msa, FILE *F, char *label, int header, int start,
         gc += vec_get(freqs, i);
     }
     fprintf(F, "%10.4f ", gc);
-    fprintf(F, "%10u ", start >= 0 && end >= 0 ? end - start : msa->length);
-    fprintf(F, "%10d ", nallgaps);
-    fprintf(F, "%10d\n", nanygaps);
+    fprintf(F, "%10" PHAST_POS_FMT " ", start >= 0 && end >= 0 ? end - start : msa->length);
+    fprintf(F, "%10" PHAST_POS_FMT " ", nallgaps);
+    fprintf(F, "%10" PHAST_POS_FMT "\n", nanygaps);
   }
 }
 
@@ -1509,10 +1644,10 @@ void msa_print_stats(MSA *msa, FILE *F, char *label, int header, int start,
    consisting of base counts listed in the order of the alphabet. If
    start and end are *not* -1, freqs are based on the indicated interval
    (half-open, 0-based) */
-Vector *msa_get_base_counts(MSA *msa, int start, int end) {
+Vector *msa_get_base_counts(MSA *msa, phast_pos start, phast_pos end) {
   int i, j, size = (int)strlen(msa->alphabet);
   double sum = 0;
-  int s = start > 0 ? start : 0, e = end > 0 ? end : msa->length;
+  phast_pos p, s = start > 0 ? start : 0, e = end > 0 ? end : msa->length;
   Vector *base_freqs = vec_new(size);
   vec_zero(base_freqs);
 
@@ -1541,9 +1676,9 @@ Vector *msa_get_base_counts(MSA *msa, int start, int end) {
   }
 
   else {
-    for (i = s; i < e; i++) {
+    for (p = s; p < e; p++) {
       for (j = 0; j < msa->nseqs; j++) {
-        char c = msa_get_char(msa, j, i);
+        char c = msa_get_char(msa, j, p);
         if (c != GAP_CHAR && !msa->is_missing[(int)c]) {
           int idx = msa->inv_alphabet[(int)c];
           if (idx == -1) {
@@ -1563,7 +1698,7 @@ Vector *msa_get_base_counts(MSA *msa, int start, int end) {
    consisting of frequencies listed in the order of the alphabet. If
    start and end are *not* -1, freqs are based on the indicated interval
    (half-open, 0-based) */
-Vector *msa_get_base_freqs(MSA *msa, int start, int end) {
+Vector *msa_get_base_freqs(MSA *msa, phast_pos start, phast_pos end) {
   Vector *rv = msa_get_base_counts(msa, start, end);
   double sum = 0;
   int i;
@@ -1742,9 +1877,11 @@ int msa_seqlen(MSA *msa, int seqidx) {
 /* return number of gapped columns.  If mode == STRIP_ANY_GAPS, a
    gapped column is one containing at least one gap; if mode ==
    STRIP_ALL_GAPS, a gapped column is one containing only gaps */
-int msa_num_gapped_cols(MSA *msa, int gap_strip_mode, int start, int end) {
-  int i, j, k = 0, has_gap;
-  int s = start > 0 ? start : 0, e = end > 0 ? end : msa->length;
+phast_pos msa_num_gapped_cols(MSA *msa, int gap_strip_mode, phast_pos start, 
+                              phast_pos end) {
+  int j, has_gap;
+  phast_pos i, k = 0;
+  phast_pos s = start > 0 ? start : 0, e = end > 0 ? end : msa->length;
   
   if (!(gap_strip_mode == STRIP_ALL_GAPS || gap_strip_mode == STRIP_ANY_GAPS))
     die("ERROR msa_num_gapped_cols: bad gap_strip_mode (%i)\n", gap_strip_mode);
@@ -1840,8 +1977,8 @@ GFF_Set *msa_get_informative_feats(MSA *msa,
 				   int refseq, 
 				   int gaps_are_informative) {
   GFF_Set *rv = gff_new_set();
-  int *is_informative=NULL, *useSpec,  useSpecLen, i, j, ninf, 
-    featStart, featEnd, idx, is_inf;
+  int *is_informative=NULL, *useSpec,  useSpecLen, i, j, ninf, is_inf;
+  phast_pos featStart, featEnd, idx;
   GFF_Feature *new_feat;
   char c, *seqname;
   
@@ -1974,7 +2111,7 @@ int msa_codon_clean(MSA *msa, const char *refseq, char strand) {
   }
   
   if (msa->length % 3 != 0)
-    die("ERROR: msa_codon_clean: msa length (%i) not multiple of three after gap removal\n", msa->length);
+    die("ERROR: msa_codon_clean: msa length (%" PHAST_POS_FMT ") not multiple of three after gap removal\n", msa->length);
 
   ncodon = msa->length / 3;
 
@@ -2531,7 +2668,7 @@ void msa_reorder_rows(MSA *msa, List *target_order) {
 /* return character for specified sequence and position; provides a
    layer of indirection to handle cases where sufficient stats are and
    are not used */
-char msa_get_char(MSA *msa, int seq, int pos) {
+char msa_get_char(MSA *msa, int seq, phast_pos pos) {
   if (msa->seqs != NULL) return msa->seqs[seq][pos];
   else return ss_get_char_pos(msa, pos, seq, 0);
 }
@@ -2707,7 +2844,7 @@ void msa_find_noaln(MSA *msa, int refseqidx, int min_block_size, int *noaln) {
 
 /* Returns TRUE if alignment has missing data in all seqs but the
    reference seq at specified column; otherwise returns FALSE */
-int msa_missing_col(MSA *msa, int ref, int pos) {
+int msa_missing_col(MSA *msa, int ref, phast_pos pos) {
   int i;
   for (i = 0; i < msa->nseqs; i++) {
     if (i == ref-1) continue;
@@ -2951,8 +3088,8 @@ void msa_delete_cols(MSA *msa, int *delete_cols) {
 
 //realloc if sequence length increases
 //if the number of sequences increases, call msa_add_seq
-void msa_realloc(MSA *msa, int new_length, int new_alloclen, int do_cats,
-		 int store_order) {
+void msa_realloc(MSA *msa, phast_pos new_length, phast_pos new_alloclen, 
+                 int do_cats, int store_order) {
   int i;
   msa->length = new_length;
   if (new_length <= msa->alloc_len) return;
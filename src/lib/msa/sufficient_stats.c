@@ -11,6 +11,7 @@
 #include "sufficient_stats.h"
 #include "maf.h"
 #include "queues.h"
+#include "profile.h"
 
 #define MAX_NTUPLE_ALLOC 100000
                                 /* maximum number of tuples to
@@ -70,22 +71,24 @@
 void ss_from_msas(MSA *msa, int tuple_size, int store_order, 
                   List *cats_to_do, MSA *source_msa, 
                   Hashtable *existing_hash,
-                  int idx_offset, int non_overlapping) {
+                  phast_pos idx_offset, int non_overlapping) {
   int i, j, do_cats, idx, upper_bound;
+  phast_pos col;
   int max_tuples;
   MSA_SS *main_ss, *source_ss = NULL;
   Hashtable *tuple_hash = NULL;
   int *do_cat_number = NULL;
   char key[msa->nseqs * tuple_size + 1];
   MSA *smsa;
-  int effective_offset = (idx_offset < 0 ? 0 : idx_offset); 
+  phast_pos effective_offset = (idx_offset < 0 ? 0 : idx_offset); 
+  PROF_BEGIN(PROF_SS_BUILD);
 
   if (source_msa == NULL && 
       (msa->seqs == NULL || msa->length <= 0 || msa->ss != NULL))
     die("ERROR: with no separate source alignment, ss_from_msas expects sequences of positive length and no SS object.\n");
   if (idx_offset >= 0) 
     if (!(store_order && source_msa != NULL))
-      die("ERROR ss_from_msas: idx_offset=%i store_order=%i, source_msa=NULL=%i\n",
+      die("ERROR ss_from_msas: idx_offset=%" PHAST_POS_FMT " store_order=%i, source_msa=NULL=%i\n",
 	  idx_offset, store_order, source_msa==NULL);
                                 /* this is a little clumsy but it
                                    allows idx_offset both to signal
@@ -115,8 +118,9 @@ void ss_from_msas(MSA *msa, int tuple_size, int store_order,
   if (msa->ss == NULL) {
     if (source_msa != NULL && source_msa->ss != NULL)
       upper_bound = source_msa->ss->ntuples;
-    else if (source_msa != NULL) upper_bound = source_msa->length;
-    else upper_bound = min(msa->length, MAX_NTUPLE_ALLOC);
+    else if (source_msa != NULL) 
+      upper_bound = (int)min(source_msa->length, INT_MAX);
+    else upper_bound = (int)min(msa->length, MAX_NTUPLE_ALLOC);
     max_tuples = pow_bounded(strlen(msa->alphabet)+ (int)strlen(msa->missing) + 1,
                          msa->nseqs * tuple_size,   
                      upper_bound);
@@ -132,13 +136,13 @@ void ss_from_msas(MSA *msa, int tuple_size, int store_order,
                                    (this case), realloc to accommodate
                                    new source msa */
     //    int newlen = effective_offset + msa->length + source_msa->length;
-    int newlen = effective_offset + source_msa->length;
+    phast_pos newlen = effective_offset + source_msa->length;
     msa_realloc(msa, newlen, newlen+100000, 
 		do_cats, store_order);
     if (source_msa->ss != NULL) 
       upper_bound = msa->ss->ntuples + source_msa->ss->ntuples;
     else
-      upper_bound = msa->ss->ntuples + source_msa->length;
+      upper_bound = (int)min(msa->ss->ntuples + source_msa->length, INT_MAX);
       max_tuples = pow_bounded(strlen(msa->alphabet) + (int)strlen(msa->missing) + 1,
                          msa->nseqs * tuple_size,
                      upper_bound);
@@ -187,19 +191,19 @@ void ss_from_msas(MSA *msa, int tuple_size, int store_order,
                                    data, whether msa itself or a
                                    separate source msa */
 
-    for (i = 0; i < smsa->length; i++) { 
-      checkInterruptN(i, 1000);
-      if (non_overlapping &&  ((i+1) % tuple_size != 0)) continue;
+    for (col = 0; col < smsa->length; col++) { 
+      checkInterruptN(col, 1000);
+      if (non_overlapping &&  ((col+1) % tuple_size != 0)) continue;
       if (do_cats && cats_to_do != NULL && 
-          do_cat_number[smsa->categories[i]] == 0) {
-        if (store_order) main_ss->tuple_idx[i + effective_offset] = -1;
+          do_cat_number[smsa->categories[col]] == 0) {
+        if (store_order) main_ss->tuple_idx[col + effective_offset] = -1;
         continue;
       }
 
       if (smsa->seqs != NULL)
-        col_to_string(key, smsa, i, tuple_size);
+        col_to_string(key, smsa, col, tuple_size);
       else                      /* NOTE: must have ordered suff stats */
-        strncpy(key, smsa->ss->col_tuples[smsa->ss->tuple_idx[i]], 
+        strncpy(key, smsa->ss->col_tuples[smsa->ss->tuple_idx[col]], 
 		(msa->nseqs * tuple_size + 1));
 
       if ((idx = ss_lookup_coltuple(key, tuple_hash, msa)) == -1) {
@@ -221,13 +225,13 @@ void ss_from_msas(MSA *msa, int tuple_size, int store_order,
 
       main_ss->counts[idx]++;
       if (do_cats && smsa->categories != NULL) {
-        if (!(smsa->categories[i] >= 0 && smsa->categories[i] <= msa->ncats))
+        if (!(smsa->categories[col] >= 0 && smsa->categories[col] <= msa->ncats))
 	  die("ERROR ss_from_msas: smsa->categories[i]=%i should be in [0,%i]\n",
-	      smsa->categories[i], msa->ncats);
-        main_ss->cat_counts[smsa->categories[i]][idx]++;
+	      smsa->categories[col], msa->ncats);
+        main_ss->cat_counts[smsa->categories[col]][idx]++;
       }
       if (store_order)
-        main_ss->tuple_idx[i + effective_offset] = idx;
+        main_ss->tuple_idx[col + effective_offset] = idx;
     }
   }
 
@@ -239,6 +243,7 @@ void ss_from_msas(MSA *msa, int tuple_size, int store_order,
   }
 
   if (do_cats) sfree(do_cat_number);
+  PROF_END(PROF_SS_BUILD, source_msa != NULL ? source_msa->length : msa->length);
 }
 
 /* creates a new sufficient statistics object and links it to the
@@ -609,6 +614,7 @@ void ss_write(MSA *msa, FILE *F, int show_order) {
   MSA_SS *ss = msa->ss;
   char tmp[ss->tuple_size * msa->nseqs + (ss->tuple_size-1) + 1];
   int i, j;
+  phast_pos col;
   String *namestr;
   tmp[ss->tuple_size * msa->nseqs + (ss->tuple_size-1) + 1] = '\0';
 
@@ -618,13 +624,13 @@ void ss_write(MSA *msa, FILE *F, int show_order) {
     if (i < msa->nseqs-1) str_append_charstr(namestr, ",");
   }
                     
-  fprintf(F, "NSEQS = %d\nLENGTH = %u\nTUPLE_SIZE = %d\nNTUPLES = %d\nNAMES = %s\nALPHABET = %s\n", 
+  fprintf(F, "NSEQS = %d\nLENGTH = %" PHAST_POS_FMT "\nTUPLE_SIZE = %d\nNTUPLES = %d\nNAMES = %s\nALPHABET = %s\n", 
           msa->nseqs, msa->length, ss->tuple_size, ss->ntuples, 
           namestr->chars, msa->alphabet);
-                                /* NOTE: it's important to print
-                                   LENGTH as unsigned; can overflow
-                                   with whole mammalian genomes */
-  if (msa->idx_offset != 0) fprintf(F, "IDX_OFFSET = %d\n", msa->idx_offset);
+                                /* NOTE: LENGTH and IDX_OFFSET are
+                                   phast_pos; can exceed 2^31 with
+                                   large genomes */
+  if (msa->idx_offset != 0) fprintf(F, "IDX_OFFSET = %" PHAST_POS_FMT "\n", msa->idx_offset);
   fprintf(F, "NCATS = %d\n\n", msa->ncats);
   str_free(namestr);  
 
@@ -639,9 +645,9 @@ void ss_write(MSA *msa, FILE *F, int show_order) {
   }
   if (show_order && ss->tuple_idx != NULL) {
     fprintf(F, "\nTUPLE_IDX_ORDER:\n");
-    for (i = 0; i < msa->length; i++) {
-      checkInterruptN(i, 100);
-      fprintf(F, "%d\n", ss->tuple_idx[i]);
+    for (col = 0; col < msa->length; col++) {
+      checkInterruptN(col, 100);
+      fprintf(F, "%d\n", ss->tuple_idx[col]);
     }
   }
 }
@@ -652,11 +658,13 @@ MSA* ss_read(FILE *F, char *alphabet) {
   Regex *nseqs_re, *length_re, *tuple_size_re, *ntuples_re, *tuple_re, 
     *names_re, *alph_re, *ncats_re, *order_re, *offset_re;
   String *line, *alph = NULL;
-  int nseqs, length, tuple_size, ntuples, i, ncats = -99, header_done = 0, 
-    idx_offset = 0, idx, offset, line_no=0;
+  int nseqs, tuple_size, ntuples, i, ncats = -99, header_done = 0, 
+    idx, offset, line_no=0;
+  phast_pos length, idx_offset = 0, col;
   MSA *msa = NULL;
   List *matches;
   char **names = NULL;
+  PROF_BEGIN(PROF_SS_READ);
 
   nseqs_re = str_re_new("NSEQS[[:space:]]*=[[:space:]]*([0-9]+)");
   length_re = str_re_new("LENGTH[[:space:]]*=[[:space:]]*([0-9]+)");
@@ -685,7 +693,7 @@ MSA* ss_read(FILE *F, char *alphabet) {
         str_as_int(lst_get_ptr(matches, 1), &nseqs);
       }
       else if (str_re_match(line, length_re, matches, 1) >= 0) {
-        str_as_int(lst_get_ptr(matches, 1), &length);
+        str_as_pos(lst_get_ptr(matches, 1), &length);
       }
       else if (str_re_match(line, tuple_size_re, matches, 1) >= 0) {
         str_as_int(lst_get_ptr(matches, 1), &tuple_size);
@@ -702,7 +710,7 @@ MSA* ss_read(FILE *F, char *alphabet) {
         if (ncats < -1) ncats = -1;
       }
       else if (str_re_match(line, offset_re, matches, 1) >= 0) {
-        str_as_int(lst_get_ptr(matches, 1), &idx_offset);
+        str_as_pos(lst_get_ptr(matches, 1), &idx_offset);
         if (idx_offset < -1) idx_offset = -1;
       }
       else if (str_re_match(line, names_re, matches, 1) >= 0) {
@@ -775,13 +783,13 @@ MSA* ss_read(FILE *F, char *alphabet) {
     }
     else if (str_re_match(line, order_re, NULL, 0) >= 0) {
       msa->ss->tuple_idx = smalloc(msa->length * sizeof(int));
-      for (i = 0; str_readline(line, F) != EOF && i < msa->length; i++) {
+      for (col = 0; str_readline(line, F) != EOF && col < msa->length; col++) {
         str_trim(line);
         if (line->length == 0) continue;
-        if (str_as_int(line, &msa->ss->tuple_idx[i]) != 0) 
+        if (str_as_int(line, &msa->ss->tuple_idx[col]) != 0) 
           die("ERROR: bad integer in TUPLE_IDX_ORDER list.\n");
       }
-      if (i < msa->length) 
+      if (col < msa->length) 
         die("ERROR: too few numbers in TUPLE_IDX_ORDER list.\n");
     }
 
@@ -809,6 +817,7 @@ MSA* ss_read(FILE *F, char *alphabet) {
 /*   for (idx = 0; idx < ntuples; idx++) */
 /*     fprintf(stderr, "Tuple %d in msa: %s\n", idx, msa->ss->col_tuples[idx]); */
   
+  PROF_END(PROF_SS_READ, ntuples);
   return msa;
 }
 
@@ -841,6 +850,7 @@ void ss_free(MSA_SS *ss) {
 void ss_update_categories(MSA *msa) {
   MSA_SS *ss = msa->ss;
   int i, j;
+  phast_pos k;
   if (!(msa->ncats >= 0 && msa->categories != NULL && 
 	ss->tuple_idx != NULL))
     die("ERROR ss_update_categories: msa->ncats=%i msa->categories==NULL=%i, ss->tuple_idx==NULL=%i\n", msa->ncats, msa->categories==NULL, ss->tuple_idx==NULL);
@@ -853,11 +863,11 @@ void ss_update_categories(MSA *msa) {
   for (i = 0; i <= msa->ncats; i++) 
     for (j = 0; j < ss->ntuples; j++) 
       ss->cat_counts[i][j] = 0;
-  for (i = 0; i < msa->length; i++) {
-    checkInterruptN(i, 10000);
-    if (msa->categories[i] > msa->ncats)
-      die("ERROR ss_update_categories: msa->categories[%i]=%i, should be <= msa->ncats (%i)\n", i, msa->categories[i], msa->ncats);
-    ss->cat_counts[msa->categories[i]][ss->tuple_idx[i]]++;
+  for (k = 0; k < msa->length; k++) {
+    checkInterruptN(k, 10000);
+    if (msa->categories[k] > msa->ncats)
+      die("ERROR ss_update_categories: msa->categories[%" PHAST_POS_FMT "]=%i, should be <= msa->ncats (%i)\n", k, msa->categories[k], msa->ncats);
+    ss->cat_counts[msa->categories[k]][ss->tuple_idx[k]]++;
   }
 }
 
@@ -914,9 +924,10 @@ MSA* ss_alt_msa(MSA *orig_msa, int new_tuple_size, int store_order,
    sufficient statistics (refer to msa_sub_alignment in msa.c).  The
    new alignment will represent the interval [start_col, end_col). */
 MSA *ss_sub_alignment(MSA *msa, char **new_names, List *include_list, 
-                      int start_col, int end_col) {
+                      phast_pos start_col, phast_pos end_col) {
   MSA *retval;
   int do_cats = (msa->ncats >= 0 && msa->categories != NULL);
+  phast_pos col;
   int i, offset, seqidx, tupidx, sub_ntuples, sub_tupidx, cat;
   int *full_to_sub;
   int unordered_seqs = (msa->ss->tuple_idx == NULL && 
@@ -956,13 +967,13 @@ MSA *ss_sub_alignment(MSA *msa, char **new_names, List *include_list,
     for (tupidx = 0; tupidx < msa->ss->ntuples; tupidx++) 
       full_to_sub[tupidx] = -1; /* indicates absent from subalignment */
     sub_ntuples = 0;
-    for (i = 0; i < retval->length; i++) {
-      checkInterruptN(i, 1000);
-      if (!(msa->ss->tuple_idx[i+start_col] >= 0 && 
-	    msa->ss->tuple_idx[i+start_col] < msa->ss->ntuples))
-	die("ERROR: ss_sub_alignment: msa->ss->tuple_idx[%i]=%i, should be in [0, %i)\n", i+start_col, msa->ss->tuple_idx[i+start_col], msa->ss->ntuples);
-      if (full_to_sub[msa->ss->tuple_idx[i+start_col]] == -1) {
-        full_to_sub[msa->ss->tuple_idx[i+start_col]] = 0; /* placeholder */
+    for (col = 0; col < retval->length; col++) {
+      checkInterruptN(col, 1000);
+      if (!(msa->ss->tuple_idx[col+start_col] >= 0 && 
+	    msa->ss->tuple_idx[col+start_col] < msa->ss->ntuples))
+	die("ERROR: ss_sub_alignment: msa->ss->tuple_idx[%" PHAST_POS_FMT "]=%i, should be in [0, %i)\n", col+start_col, msa->ss->tuple_idx[col+start_col], msa->ss->ntuples);
+      if (full_to_sub[msa->ss->tuple_idx[col+start_col]] == -1) {
+        full_to_sub[msa->ss->tuple_idx[col+start_col]] = 0; /* placeholder */
         sub_ntuples++;
       }
     }
@@ -1009,16 +1020,16 @@ MSA *ss_sub_alignment(MSA *msa, char **new_names, List *include_list,
     }
   }
   else {                        /* go site by site */
-    for (i = 0; i < retval->length; i++) {
-      checkInterruptN(i, 1000);
-      ss->tuple_idx[i] = full_to_sub[msa->ss->tuple_idx[i+start_col]];
-      if (ss->tuple_idx[i] < 0) 
-	die("ERROR ss_sub_alignment: ss->tuple_idx[%i]=%i, should be >=0\n", 
-	    i, ss->tuple_idx);
-      ss->counts[ss->tuple_idx[i]]++;
+    for (col = 0; col < retval->length; col++) {
+      checkInterruptN(col, 1000);
+      ss->tuple_idx[col] = full_to_sub[msa->ss->tuple_idx[col+start_col]];
+      if (ss->tuple_idx[col] < 0) 
+	die("ERROR ss_sub_alignment: ss->tuple_idx[%" PHAST_POS_FMT "]=%i, should be >=0\n", 
+	    col, ss->tuple_idx[col]);
+      ss->counts[ss->tuple_idx[col]]++;
       if (do_cats) {
-        retval->categories[i] = msa->categories[i+start_col];
-        ss->cat_counts[retval->categories[i]][ss->tuple_idx[i]]++;
+        retval->categories[col] = msa->categories[col+start_col];
+        ss->cat_counts[retval->categories[col]][ss->tuple_idx[col]]++;
       }
     }  
   }
@@ -1030,6 +1041,173 @@ MSA *ss_sub_alignment(MSA *msa, char **new_names, List *include_list,
   return retval;
 }
 
+/* Create a new sliding window over an alignment with ordered
+   sufficient statistics.  The window is initially empty. */
+SSWindow *ss_window_new(MSA *source, int order_by_appearance) {
+  SSWindow *win;
+  char **names;
+  int i, init_ntuples;
+
+  if (source->ss == NULL || source->ss->tuple_idx == NULL)
+    die("ERROR: ss_window_new requires ordered sufficient statistics.\n");
+
+  win = smalloc(sizeof(SSWindow));
+  win->source = source;
+  win->do_cats = (source->ncats >= 0 && source->categories != NULL);
+  win->order_by_appearance = order_by_appearance;
+  win->start = win->end = 0;
+
+  names = smalloc(source->nseqs * sizeof(char*));
+  for (i = 0; i < source->nseqs; i++)
+    names[i] = copy_charstr(source->names[i]);
+  win->msa = msa_new(NULL, names, source->nseqs, 0, source->alphabet);
+  win->msa->missing = source->missing;
+  for (i = 0; i < NCHARS; i++) {
+    win->msa->inv_alphabet[i] = source->inv_alphabet[i];
+    win->msa->is_missing[i] = source->is_missing[i];
+  }
+  win->msa->idx_offset = source->idx_offset;
+  if (win->do_cats) win->msa->ncats = source->ncats;
+
+  init_ntuples = min(source->ss->ntuples, 1000);
+  if (init_ntuples < 1) init_ntuples = 1;
+  ss_new(win->msa, source->ss->tuple_size, init_ntuples, win->do_cats, 
+         FALSE);
+
+  win->full_to_win = smalloc(source->ss->ntuples * sizeof(int));
+  for (i = 0; i < source->ss->ntuples; i++) win->full_to_win[i] = -1;
+  win->win_to_full = smalloc(win->msa->ss->alloc_ntuples * sizeof(int));
+  return win;
+}
+
+/* add (delta = 1) or remove (delta = -1) column 'col' of the source
+   alignment to/from the window.  Tuples whose counts drop to zero
+   keep their slots until the next call to ss_window_compact */
+static void ss_window_update_col(SSWindow *win, int col, int delta) {
+  MSA_SS *ss = win->msa->ss;
+  int tupidx = win->source->ss->tuple_idx[col], w, cat;
+
+  if (tupidx < 0) return;       /* column excluded from source stats */
+  w = win->full_to_win[tupidx];
+  if (w == -1) {
+    if (delta < 0)
+      die("ERROR ss_window_update_col: column %i not in window\n", col);
+    if (ss->ntuples == ss->alloc_ntuples) {
+      ss_realloc(win->msa, ss->tuple_size, ss->ntuples + 1, win->do_cats,
+                 FALSE);
+      win->win_to_full = srealloc(win->win_to_full, ss->alloc_ntuples * 
+                                  sizeof(int));
+    }
+    w = ss->ntuples++;
+    win->full_to_win[tupidx] = w;
+    win->win_to_full[w] = tupidx;
+    ss->col_tuples[w] = win->source->ss->col_tuples[tupidx];
+    ss->counts[w] = 0;
+    for (cat = 0; win->do_cats && cat <= win->msa->ncats; cat++)
+      ss->cat_counts[cat][w] = 0;
+  }
+  ss->counts[w] += delta;
+  if (win->do_cats)
+    ss->cat_counts[win->source->categories[col]][w] += delta;
+}
+
+static int ss_window_compare_idx(const void *ptr1, const void *ptr2) {
+  return *((const int*)ptr1) - *((const int*)ptr2);
+}
+
+/* drop tuples with counts of zero and order the rest, either by
+   their first appearance in the window (as ss_from_msas would) or by
+   their index in the source alignment (as ss_sub_alignment would) */
+static void ss_window_compact(SSWindow *win) {
+  MSA_SS *ss = win->msa->ss;
+  int i, j, w, cat, tupidx, ntuples = 0;
+  int *slot = smalloc((ss->ntuples + 1) * sizeof(int)),
+    *new_idx = smalloc((ss->ntuples + 1) * sizeof(int));
+  double *tmpcounts = smalloc((ss->ntuples + 1) * sizeof(double));
+
+  for (w = 0; w < ss->ntuples; w++) new_idx[w] = -1;
+  if (win->order_by_appearance) {
+    for (i = win->start; i < win->end; i++) {
+      tupidx = win->source->ss->tuple_idx[i];
+      if (tupidx < 0) continue;
+      w = win->full_to_win[tupidx];
+      if (new_idx[w] == -1) {
+        new_idx[w] = ntuples;
+        slot[ntuples++] = w;
+      }
+    }
+  }
+  else {
+    for (w = 0; w < ss->ntuples; w++) 
+      if (ss->counts[w] > 0) slot[ntuples++] = win->win_to_full[w];
+    qsort(slot, ntuples, sizeof(int), ss_window_compare_idx);
+    for (j = 0; j < ntuples; j++) {
+      slot[j] = win->full_to_win[slot[j]];
+      new_idx[slot[j]] = j;
+    }
+  }
+
+  for (j = 0; j < ntuples; j++) tmpcounts[j] = ss->counts[slot[j]];
+  for (j = 0; j < ntuples; j++) ss->counts[j] = tmpcounts[j];
+  for (cat = 0; win->do_cats && cat <= win->msa->ncats; cat++) {
+    for (j = 0; j < ntuples; j++) tmpcounts[j] = ss->cat_counts[cat][slot[j]];
+    for (j = 0; j < ntuples; j++) ss->cat_counts[cat][j] = tmpcounts[j];
+  }
+  for (w = 0; w < ss->ntuples; w++)  /* tuples no longer in window */
+    if (new_idx[w] == -1) win->full_to_win[win->win_to_full[w]] = -1;
+  for (j = 0; j < ntuples; j++) slot[j] = win->win_to_full[slot[j]];
+  for (j = 0; j < ntuples; j++) {
+    ss->col_tuples[j] = win->source->ss->col_tuples[slot[j]];
+    win->win_to_full[j] = slot[j];
+    win->full_to_win[slot[j]] = j;
+  }
+  for (w = ntuples; w < ss->ntuples; w++) ss->col_tuples[w] = NULL;
+  ss->ntuples = ntuples;
+
+  sfree(slot);
+  sfree(new_idx);
+  sfree(tmpcounts);
+}
+
+/* Move a sliding window to the interval [start_col, end_col) of its
+   source alignment, updating sufficient statistics incrementally */
+void ss_window_set(SSWindow *win, int start_col, int end_col) {
+  int i;
+
+  if (start_col < 0 || end_col > (int)win->source->length || start_col > end_col)
+    die("ERROR ss_window_set: bad window [%i, %i) (alignment length %" PHAST_POS_FMT ")\n",
+        start_col, end_col, win->source->length);
+
+  /* remove columns leaving window, then add those entering it */
+  for (i = win->start; i < min(win->end, start_col); i++)
+    ss_window_update_col(win, i, -1);
+  for (i = max(win->start, end_col); i < win->end; i++)
+    ss_window_update_col(win, i, -1);
+  for (i = start_col; i < min(end_col, win->start); i++)
+    ss_window_update_col(win, i, 1);
+  for (i = max(start_col, win->end); i < end_col; i++)
+    ss_window_update_col(win, i, 1);
+
+  win->start = start_col;
+  win->end = end_col;
+  ss_window_compact(win);
+  win->msa->length = end_col - start_col;
+  win->msa->idx_offset = win->source->idx_offset + start_col;
+}
+
+/* Free a sliding window.  Column tuples belong to the source
+   alignment and are not freed */
+void ss_window_free(SSWindow *win) {
+  int w;
+  for (w = 0; w < win->msa->ss->alloc_ntuples; w++) 
+    win->msa->ss->col_tuples[w] = NULL;
+  win->msa->missing = NULL;
+  msa_free(win->msa);
+  sfree(win->full_to_win);
+  sfree(win->win_to_full);
+  sfree(win);
+}
+
 
 /* adjust sufficient statistics to reflect the reverse complement of
    an alignment.  Refer to msa_reverse_compl */
@@ -1507,6 +1685,6 @@ void ss_make_ordered(MSA *msa) {
       msa->ss->tuple_idx[idx++] = i;
   }
   if (idx != msa->length)
-    die("ERROR ss_make_ordered: idx (%i) != msa->length (%i)\n", 
+    die("ERROR ss_make_ordered: idx (%i) != msa->length (%" PHAST_POS_FMT ")\n", 
 	idx, msa->length);
 }
@@ -212,7 +212,8 @@ struct bgchmm_struct *bgchmm_struct_new(int rphast) {
 int bgcHmm(struct bgchmm_struct *b) {
   MSA *msa=b->msa;
   TreeModel **mods;
-  int i, j, numstate, nsite, *path, npar;
+  int i, j, numstate, *path, npar;
+  phast_pos nsite;
   double mu, nu,likelihood,
     **emissions, path_likelihood,
     bgc_in_rate, bgc_out_rate;
@@ -303,7 +304,7 @@ int bgcHmm(struct bgchmm_struct *b) {
 			   b->estimate_bgc, b->estimate_rho, b->estimate_scale,
 			   b->eqfreqs_from_msa, msa, &npar);
   
-  nsite = (int)msa->length;
+  nsite = msa->length;
   emissions = smalloc(hmm->nstates * sizeof(double*));
   for (i=0; i < hmm->nstates; i++)
     emissions[i] = smalloc(nsite * sizeof(double));
@@ -439,7 +440,7 @@ int bgcHmm(struct bgchmm_struct *b) {
     /* print to post_probs_f */
     if (post_probs_f != NULL) {
       if (b->post_probs == WIG) {
-	fprintf(post_probs_f, "fixedStep chrom=%s start=%d step=1\n",
+	fprintf(post_probs_f, "fixedStep chrom=%s start=%" PHAST_POS_FMT " step=1\n",
 		msa->names[0], msa->idx_offset + 1);
 	for (i=0; i < reflen; i++)
 	  fprintf(post_probs_f, "%.5g\n", prob_bgc[i]);
@@ -450,7 +451,7 @@ int bgcHmm(struct bgchmm_struct *b) {
 	    fprintf(post_probs_f, "\t%s", bgchmm_get_state_name(j, do_bgc));
 	  fprintf(post_probs_f, "\n");
 	  for (j=0; j < reflen; j++) {
-	    fprintf(post_probs_f, "%i", msa->idx_offset + 1 + j);
+	    fprintf(post_probs_f, "%" PHAST_POS_FMT, msa->idx_offset + 1 + j);
 	    for (k=0; k < hmm->nstates; k++)
 	      fprintf(post_probs_f, "\t%0.5g", postprobs[k][j]);
 	    fprintf(post_probs_f, "\n");
@@ -556,11 +557,12 @@ char *bgchmm_get_state_name(int state, int do_bgc) {
 }
 
 
-void bgchmm_output_path(int *path, int nsite, MSA *msa, int do_bgc,
+void bgchmm_output_path(int *path, phast_pos nsite, MSA *msa, int do_bgc,
 			char *name, char *outfn, ListOfLists *results) {
   GFF_Set *gff = gff_new_set();
   GFF_Feature *feat;
-  int start=-1, state=-1, coord = msa->idx_offset, i;
+  int state=-1;
+  phast_pos i, start=-1, coord = msa->idx_offset;
   FILE *outfile;
   char *feat_type=NULL;
   for (i=0; i < nsite; i++) {
@@ -730,10 +732,11 @@ void bgchmm_estimate_states(TreeModel **mods, int nmod, void *data0, double **E,
 
 
 void bgchmm_compute_emissions(double **emissions, void **models, int nmodels,
-			      void *data0, int sample, int length) {
+			      void *data0, int sample, phast_pos length) {
   struct bgchmm_data_struct *data = (struct bgchmm_data_struct*)data0;
   double *temp_emissions;
-  int state, i, j, sspos;
+  int state, sspos;
+  phast_pos i, j;
   MSA *msa;
   if (sample != 0) 
     die("bgchmm_compute_emissions got sample=%i (should always be 0)\n", sample);
@@ -759,7 +762,7 @@ void bgchmm_compute_emissions(double **emissions, void **models, int nmodels,
 }
 
 
-int bgchmm_get_obs_idx(void *data0, int i, int j) {
+int bgchmm_get_obs_idx(void *data0, int i, phast_pos j) {
   struct bgchmm_data_struct *data = (struct bgchmm_data_struct*)data0;
   if (i==-1 || j== -1) {
     return data->msa->ss->ntuples;
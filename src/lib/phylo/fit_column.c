@@ -29,23 +29,73 @@
 /* number of significant figures to which to estimate column scale
    parameters (currently affects 1d parameter estimation only) */
 
-/* Compute and return the log likelihood of a tree model with respect
-   to a single column tuple in an alignment.  This is a pared-down
-   version of tl_compute_log_likelihood for use in estimation of
-   base-by-base scale factors.  It assumes a 0th order model,
-   leaf-to-sequence mapping already available, prob matrices computed,
-   sufficient stats already available.  Note that this function uses
-   natural log rather than log2.  This function does allow for rate
-   variation. */
-double col_compute_likelihood(TreeModel *mod, MSA *msa, int tupleidx,
-                                  double **scratch) {
+#define RESCALE_THRESHOLD 1e-50
+/* partial likelihoods at a node are rescaled when all fall below this
+   value, to avoid underflow on large trees */
+
+/* If the largest partial likelihood at node 'id' (in P[0]) is below
+   RESCALE_THRESHOLD, multiply the partial likelihoods and their
+   derivatives (P[1], ..., P[nmat-1]; NULL entries are skipped) by a
+   power of two that brings it into [0.5, 1), and return the exponent
+   used; otherwise return 0.  Scaling by a power of two is exact, so
+   results are unaffected except where they would have underflowed */
+static int col_rescale_node(double ***P, int nmat, int nstates, int id) {
+  double max = 0;
+  int i, m, e;
+  for (i = 0; i < nstates; i++)
+    if (P[0][i][id] > max) max = P[0][i][id];
+  if (max >= RESCALE_THRESHOLD || max == 0) return 0;
+  frexp(max, &e);
+  for (m = 0; m < nmat; m++) {
+    if (P[m] == NULL) continue;
+    for (i = 0; i < nstates; i++)
+      P[m][i][id] = ldexp(P[m][i][id], -e);
+  }
+  return -e;
+}
+
+/* Bring the quantities accumulated over rate categories (acc[0], ...,
+   acc[nacc-1], scaled by 2^(*acc_scale)) and the terms for a new rate
+   category (scaled by 2^scale) to a common scale.  Returns the factor
+   by which the new terms must be multiplied; the accumulators and
+   *acc_scale are updated if necessary.  If 'first' is TRUE, the
+   accumulators are assumed to be empty */
+static double col_merge_scale(int *acc_scale, int scale, int first,
+                              double **acc, int nacc) {
+  int m;
+  if (first || scale == *acc_scale) {
+    *acc_scale = scale;
+    return 1;
+  }
+  if (scale > *acc_scale)
+    return ldexp(1, *acc_scale - scale);
+  for (m = 0; m < nacc; m++)
+    if (acc[m] != NULL) *acc[m] = ldexp(*acc[m], scale - *acc_scale);
+  *acc_scale = scale;
+  return 1;
+}
+
+/* Compute the likelihood of a tree model with respect to a single
+   column tuple in an alignment, as a scaled value x and exponent
+   *lscale such that the likelihood is x * 2^(-*lscale).  Partial
+   likelihoods are rescaled as needed during the pruning algorithm, so
+   the result does not underflow even on very large trees.  This is a
+   pared-down version of tl_compute_log_likelihood for use in
+   estimation of base-by-base scale factors.  It assumes a 0th order
+   model, leaf-to-sequence mapping already available, prob matrices
+   computed, sufficient stats already available.  This function does
+   allow for rate variation. */
+double col_compute_scaled_likelihood(TreeModel *mod, MSA *msa, int tupleidx,
+                                     double **scratch, int *lscale) {
 
   int i, j, k, nodeidx, rcat;
   int nstates = mod->rate_matrix->size;
   TreeNode *n;
-  double total_prob = 0;
+  double total_prob = 0, f;
   List *traversal = tr_postorder(mod->tree);
   double **pL = NULL;
+  int nscale[mod->tree->nnodes+1];  /* per-node scale exponents */
+  double *acc[1];
 
   if (msa->ss->tuple_size != 1)
     die("ERROR col_compute_likelihood: need tuple size 1, got %i\n",
@@ -65,6 +115,16 @@ double col_compute_likelihood(TreeModel *mod, MSA *msa, int tupleidx,
       pL[j] = smalloc((mod->tree->nnodes+1) * sizeof(double));
   }
 
+  acc[0] = &total_prob;
+  *lscale = 0;
+
+  /* Unlike tl_compute_log_likelihood, this function (and the
+     derivative functions below) makes one traversal per rate category
+     rather than interleaving the categories.  Each call scores a
+     single column, and the substitution matrices are recomputed for a
+     new scale before every call, so copying them into an interleaved
+     layout (as tl_interleave_P does once for a whole alignment) would
+     cost about as much as the traversal it would speed up */
   for (rcat = 0; rcat < mod->nratecats; rcat++) {
     for (nodeidx = 0; nodeidx < lst_size(traversal); nodeidx++) {
       n = lst_get_ptr(traversal, nodeidx);
@@ -79,6 +139,7 @@ double col_compute_likelihood(TreeModel *mod, MSA *msa, int tupleidx,
           else
             pL[i][n->id] = 0;
         }
+        nscale[n->id] = 0;
       }
       else {
         /* general recursive case */
@@ -96,13 +157,16 @@ double col_compute_likelihood(TreeModel *mod, MSA *msa, int tupleidx,
 
           pL[i][n->id] = totl * totr;
         }
+        nscale[n->id] = nscale[n->lchild->id] + nscale[n->rchild->id] +
+          col_rescale_node(&pL, 1, nstates, n->id);
       }
     }
 
     /* termination (for each rate cat) */
+    f = col_merge_scale(lscale, nscale[mod->tree->id], rcat == 0, acc, 1);
     for (i = 0; i < nstates; i++)
       total_prob += vec_get(mod->backgd_freqs, i) *
-        pL[i][mod->tree->id] * mod->freqK[rcat];
+        pL[i][mod->tree->id] * mod->freqK[rcat] * f;
   }
 
   if (scratch == NULL) {
@@ -113,14 +177,28 @@ double col_compute_likelihood(TreeModel *mod, MSA *msa, int tupleidx,
   return(total_prob);
 }
 
+/* See col_compute_scaled_likelihood above for notes.  The result will
+   underflow to zero for columns with very small likelihoods; use
+   col_compute_log_likelihood if possible */
+double col_compute_likelihood(TreeModel *mod, MSA *msa, int tupleidx,
+                                  double **scratch) {
+  int lscale;
+  double p = col_compute_scaled_likelihood(mod, msa, tupleidx, scratch,
+                                           &lscale);
+  return lscale == 0 ? p : ldexp(p, -lscale);
+}
+
 
 
-/* See col_compute_likelihood above for notes.
+/* See col_compute_scaled_likelihood above for notes.
    Note that this function uses natural log rather than log2
  */
 double col_compute_log_likelihood(TreeModel *mod, MSA *msa, int tupleidx,
                                   double **scratch) {
-  return log(col_compute_likelihood(mod, msa, tupleidx, scratch));
+  int lscale;
+  double p = col_compute_scaled_likelihood(mod, msa, tupleidx, scratch,
+                                           &lscale);
+  return log(p) - lscale * M_LN2;
 }
 
 
@@ -316,6 +394,12 @@ double col_scale_derivs(ColFitData *d, double *first_deriv,
                                    scale param */
   double **LLL=NULL;                 /* 2nd deriv of partial likelihoods
                                    wrt scale param */
+  int nscale[d->mod->tree->nnodes+1];  /* per-node scale exponents (see
+                                          col_rescale_node) */
+  int lscale = 0;
+  double f;
+  double **P[3];
+  double *acc[3];
   if (d->msa->ss->tuple_size != 1)
     die("ERROR col_scale_derivs: need tuple size 1, got %i\n",
 	d->msa->ss->tuple_size);
@@ -349,6 +433,9 @@ double col_scale_derivs(ColFitData *d, double *first_deriv,
 
   col_scale_derivs_subst(d);
 
+  P[0] = L; P[1] = LL; P[2] = (second_deriv != NULL ? LLL : NULL);
+  acc[0] = &total_prob; acc[1] = first_deriv; acc[2] = second_deriv;
+
   for (rcat = 0; rcat < d->mod->nratecats; rcat++) {
     for (nodeidx = 0; nodeidx < lst_size(traversal); nodeidx++) {
       n = lst_get_ptr(traversal, nodeidx);
@@ -366,6 +453,7 @@ double col_scale_derivs(ColFitData *d, double *first_deriv,
           LL[i][n->id] = 0;
           if (second_deriv != NULL) LLL[i][n->id] = 0;
         }
+        nscale[n->id] = 0;
       }
       else {
         /* general recursive case */
@@ -405,20 +493,24 @@ double col_scale_derivs(ColFitData *d, double *first_deriv,
             LLL[i][n->id] = totr*E + 2*A*B + totl*F;
           }
         }
+        /* derivatives share the scale of the partial likelihoods */
+        nscale[n->id] = nscale[n->lchild->id] + nscale[n->rchild->id] +
+          col_rescale_node(P, 3, nstates, n->id);
       }
     }
 
     /* termination (for each rate cat) */
+    f = col_merge_scale(&lscale, nscale[d->mod->tree->id], rcat == 0, acc, 3);
     for (i = 0; i < nstates; i++) {
       total_prob += L[i][d->mod->tree->id] * vec_get(d->mod->backgd_freqs, i) *
-        d->mod->freqK[rcat];
+        d->mod->freqK[rcat] * f;
 
       *first_deriv += LL[i][d->mod->tree->id] * vec_get(d->mod->backgd_freqs, i) *
-        d->mod->freqK[rcat];
+        d->mod->freqK[rcat] * f;
 
       if (second_deriv != NULL)
         *second_deriv += LLL[i][d->mod->tree->id] * vec_get(d->mod->backgd_freqs, i) *
-          d->mod->freqK[rcat];
+          d->mod->freqK[rcat] * f;
     }
   }
 
@@ -431,7 +523,7 @@ double col_scale_derivs(ColFitData *d, double *first_deriv,
                                    underflow */
 
   *first_deriv = *first_deriv / total_prob; /* deriv of log */
-  total_prob = log(total_prob);
+  total_prob = log(total_prob) - lscale * M_LN2;
 
   if (scratch == NULL) {
     for (j = 0; j < nstates; j++) {
@@ -472,6 +564,12 @@ double col_scale_derivs_subtree(ColFitData *d, Vector *gradient,
                                    wrt 2nd scale param */
   double **NNN=NULL;                 /* 2nd cross deriv (off diagonal in
                                    Hessian) of partial likelihoods */
+  int nscale[d->mod->tree->nnodes+1];  /* per-node scale exponents (see
+                                          col_rescale_node) */
+  int lscale = 0;
+  double f;
+  double **P[6];
+  double *acc[6];
 
   double *pd = gradient->data;  /* 1st partial derivatives */
   double **pd2 = (hessian == NULL ? NULL : hessian->data);
@@ -524,6 +622,15 @@ double col_scale_derivs_subtree(ColFitData *d, Vector *gradient,
 
   col_scale_derivs_subst(d);
 
+  P[0] = L; P[1] = LL; P[2] = MM;
+  P[3] = (pd2 != NULL ? LLL : NULL);
+  P[4] = (pd2 != NULL ? MMM : NULL);
+  P[5] = (pd2 != NULL ? NNN : NULL);
+  acc[0] = &total_prob; acc[1] = &pd[0]; acc[2] = &pd[1];
+  acc[3] = (pd2 != NULL ? &pd2[0][0] : NULL);
+  acc[4] = (pd2 != NULL ? &pd2[1][1] : NULL);
+  acc[5] = (pd2 != NULL ? &pd2[1][0] : NULL);
+
   for (rcat = 0; rcat < d->mod->nratecats; rcat++) {
     for (nodeidx = 0; nodeidx < lst_size(traversal); nodeidx++) {
       n = lst_get_ptr(traversal, nodeidx);
@@ -542,6 +649,7 @@ double col_scale_derivs_subtree(ColFitData *d, Vector *gradient,
           if (pd2 != NULL)
             LLL[i][n->id] = MMM[i][n->id] = NNN[i][n->id] = 0;
         }
+        nscale[n->id] = 0;
       }
       else {
         /* general recursive case */
@@ -607,26 +715,30 @@ double col_scale_derivs_subtree(ColFitData *d, Vector *gradient,
             NNN[i][n->id] = totr*I + A*D + B*C + totl*J;
           }
         }
+        /* derivatives share the scale of the partial likelihoods */
+        nscale[n->id] = nscale[n->lchild->id] + nscale[n->rchild->id] +
+          col_rescale_node(P, 6, nstates, n->id);
       }
     }
 
     /* termination (for each rate cat) */
+    f = col_merge_scale(&lscale, nscale[d->mod->tree->id], rcat == 0, acc, 6);
     for (i = 0; i < nstates; i++) {
       total_prob += L[i][d->mod->tree->id] * vec_get(d->mod->backgd_freqs, i) *
-        d->mod->freqK[rcat];
+        d->mod->freqK[rcat] * f;
 
       pd[0] += LL[i][d->mod->tree->id] * vec_get(d->mod->backgd_freqs, i) *
-        d->mod->freqK[rcat];
+        d->mod->freqK[rcat] * f;
       pd[1] += MM[i][d->mod->tree->id] * vec_get(d->mod->backgd_freqs, i) *
-        d->mod->freqK[rcat];
+        d->mod->freqK[rcat] * f;
 
       if (pd2 != NULL) {
         pd2[0][0] += LLL[i][d->mod->tree->id] * vec_get(d->mod->backgd_freqs, i) *
-          d->mod->freqK[rcat];
+          d->mod->freqK[rcat] * f;
         pd2[1][1] += MMM[i][d->mod->tree->id] * vec_get(d->mod->backgd_freqs, i) *
-          d->mod->freqK[rcat];
+          d->mod->freqK[rcat] * f;
         pd2[1][0] += NNN[i][d->mod->tree->id] * vec_get(d->mod->backgd_freqs, i) *
-          d->mod->freqK[rcat];
+          d->mod->freqK[rcat] * f;
       }
     }
  }
@@ -641,7 +753,7 @@ double col_scale_derivs_subtree(ColFitData *d, Vector *gradient,
   }
   pd[0] = pd[0] / total_prob; /* deriv of log */
   pd[1] = pd[1] / total_prob;
-  total_prob = log(total_prob);
+  total_prob = log(total_prob) - lscale * M_LN2;
 
   if (scratch == NULL) {
     for (j = 0; j < nstates; j++) {
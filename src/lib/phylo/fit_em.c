@@ -29,6 +29,7 @@
 #include <complex.h>
 #include <math.h>
 #include <dgamma.h>
+#include <profile.h>
 
 #define DERIV_EPSILON 1e-5      
                                 /* used for numerical est. of derivatives */
@@ -49,8 +50,8 @@ void remove_ratevar_from_param_map(TreeModel *mod, Vector *params);
 
 /* fit a tree model using EM */
 int tm_fit_em(TreeModel *mod, MSA *msa, Vector *params, int cat, 
-              opt_precision_type precision, int max_its, FILE *logf,
-	      FILE *error_file) {
+              opt_precision_type precision, int max_its, int accelerate,
+              FILE *logf, FILE *error_file) {
   double ll, improvement;
   Vector *lower_bounds, *upper_bounds, *opt_params;
   int retval = 0, it, i, home_stretch = 0, nratecats, npar;
@@ -60,12 +61,15 @@ int tm_fit_em(TreeModel *mod, MSA *msa, Vector *params, int cat,
   char tmp_mod_fname[STR_SHORT_LEN];
   FILE *F;
   void (*grad_func)(Vector*, Vector*, void*, Vector*, 
-                    Vector*);
+                    Vector*), (*prev_grad_func)(Vector*, Vector*, void*,
+                                                Vector*, Vector*);
   double (*likelihood_func)(Vector *, void*);
   Matrix *H;
   int opt_ratevar_freqs=0;
-  opt_precision_type bfgs_prec = OPT_LOW_PREC;
+  opt_precision_type bfgs_prec = OPT_LOW_PREC, prev_bfgs_prec;
                                 /* will be adjusted as necessary */
+  OptSquarem *sq;
+  PROF_BEGIN(PROF_EM);
 
   /* obtain sufficient statistics for MSA, if necessary */
   if (msa->ss == NULL) {
@@ -84,6 +88,7 @@ int tm_fit_em(TreeModel *mod, MSA *msa, Vector *params, int cat,
   if (mod->tree == NULL) {      /* weight matrix */
     mod->lnL = tl_compute_log_likelihood(mod, msa, NULL, NULL, cat, NULL) * 
       log(2);
+    PROF_END(PROF_EM, 0);
     return 0;
   }
 
@@ -102,7 +107,8 @@ int tm_fit_em(TreeModel *mod, MSA *msa, Vector *params, int cat,
   /* package with mod any data needed to compute likelihoods */
   mod->msa = msa;               
   mod->tree_posteriors = tl_new_tree_posteriors(mod, msa, 0, 0, 0, 1, 0, 0,
-                                                mod->empirical_rates ? 1 : 0);
+                                                mod->empirical_rates ? 1 : 0,
+                                                FALSE);
   mod->category = cat;
 
   /* in the case of rate variation, start by ignoring then reinstate
@@ -173,6 +179,14 @@ int tm_fit_em(TreeModel *mod, MSA *msa, Vector *params, int cat,
   }
 
 
+  /* the weights of empirical rate categories are updated directly
+     from the posteriors (see below) rather than by BFGS, so they are
+     not part of opt_params and cannot be extrapolated along with the
+     other parameters; use plain EM in that case */
+  if (opt_ratevar_freqs && mod->empirical_rates)
+    accelerate = FALSE;
+  sq = accelerate ? opt_squarem_new() : NULL;
+
   for (it = 1;  ; it++) {
     double tmp;
     checkInterrupt();
@@ -191,6 +205,14 @@ int tm_fit_em(TreeModel *mod, MSA *msa, Vector *params, int cat,
     ll = tl_compute_log_likelihood(mod, msa, NULL, NULL, cat, mod->tree_posteriors) 
       * log(2); 
 
+    /* if an extrapolated point (see below) has decreased the
+       likelihood, go back to the plain EM update */
+    if (sq != NULL && !opt_squarem_check(sq, opt_params, ll)) {
+      if (logf != NULL) 
+        fprintf(logf, "Rejecting extrapolation (lnl = %f).\n", ll);
+      continue;
+    }
+
     if (logf != NULL) {
       gettimeofday(&post_prob_end, NULL);
       fprintf(logf, "\nTime to collect posterior probabilities: %.4f sec.\n", 
@@ -213,6 +235,8 @@ int tm_fit_em(TreeModel *mod, MSA *msa, Vector *params, int cat,
       break;
 
     /* adjust inner optimization strategy as necessary */
+    prev_grad_func = grad_func;
+    prev_bfgs_prec = bfgs_prec;
     if (improvement < TM_EM_CONV(OPT_CRUDE_PREC)) {
       /* change gradient function first (if necessary), and use
          slightly better precision with BFGS; then on a subsequent
@@ -288,6 +312,17 @@ int tm_fit_em(TreeModel *mod, MSA *msa, Vector *params, int cat,
 	H = mat_new(npar, npar);
 	mat_set_identity(H);
       }
+      if (sq != NULL) opt_squarem_reset(sq);
+    }
+
+    /* accelerate by SQUAREM extrapolation from successive updates,
+       restarting whenever the M step itself has changed */
+    if (sq != NULL) {
+      if (grad_func != prev_grad_func || bfgs_prec != prev_bfgs_prec)
+        opt_squarem_reset(sq);
+      if (opt_squarem_update(sq, opt_params, ll, lower_bounds, upper_bounds) &&
+          logf != NULL)
+        fprintf(logf, "Extrapolating.\n");
     }
   }
 
@@ -322,16 +357,22 @@ int tm_fit_em(TreeModel *mod, MSA *msa, Vector *params, int cat,
   /* close log */
   if (logf != NULL) {
     gettimeofday(&end_time, NULL);
-    fprintf(logf, "\nNumber of iterations: %d\nTotal time: %.4f sec.\n", it, 
+    fprintf(logf, "\nNumber of iterations: %d\n", it);
+    if (sq != NULL)
+      fprintf(logf, "Number of extrapolations: %d (%d rejected)\n", 
+              sq->nextrap, sq->nrejected);
+    fprintf(logf, "Total time: %.4f sec.\n", 
             end_time.tv_sec - start_time.tv_sec + 
             (end_time.tv_usec - start_time.tv_usec)/1.0e6);
   }
+  if (sq != NULL) opt_squarem_free(sq);
 
   vec_free(lower_bounds);
   tl_free_tree_posteriors(mod, msa, mod->tree_posteriors);
   mod->tree_posteriors = NULL;
 
   vec_free(opt_params);
+  PROF_END(PROF_EM, it);
   return retval;
 }
 
@@ -430,11 +471,11 @@ void compute_grad_em_approx(Vector *grad, Vector *params, void *data,
   List *erows = lst_new_int(4), *ecols = lst_new_int(4), 
     *distinct_rows = lst_new_int(2), *distinct_cols = lst_new_int(4);
 
-  static double **q = NULL, **q2 = NULL, **q3 = NULL, 
+  static PHAST_THREAD_LOCAL double **q = NULL, **q2 = NULL, **q3 = NULL, 
     **dq = NULL, **dqq = NULL, **qdq = NULL, **dqq2 = NULL, **qdqq = NULL, 
     **q2dq = NULL, **dqq3 = NULL, **qdqq2 = NULL, **q2dqq = NULL, 
     **q3dq = NULL;
-  static Complex *diag = NULL;
+  static PHAST_THREAD_LOCAL Complex *diag = NULL;
 
   if  (Q->evals_z == NULL || Q->evec_matrix_z == NULL || Q->evec_matrix_inv_z == NULL)
     die("ERRROR: compute_grad_em_approx got NULL value in eigensystem; error diagonalizing matrix.");
@@ -913,9 +954,9 @@ void compute_grad_em_exact(Vector *grad, Vector *params, void *data,
   double t;
   double freqK[mod->nratecats], rK_tweak[mod->nratecats];
 
-  static double **dq = NULL;
-  static Complex **f = NULL, **tmpmat = NULL, **sinv_dq_s = NULL;
-  static Complex *diag = NULL;
+  static PHAST_THREAD_LOCAL double **dq = NULL;
+  static PHAST_THREAD_LOCAL Complex **f = NULL, **tmpmat = NULL, **sinv_dq_s = NULL;
+  static PHAST_THREAD_LOCAL Complex *diag = NULL;
 
   if (diag == NULL) {
     diag = (Complex*)smalloc(nstates * sizeof(Complex));
@@ -19,11 +19,15 @@
 #include <misc.h>
 #include <sufficient_stats.h>
 #include <tree_likelihoods.h>
+#include <thread_pool.h>
 
 #define SIGFIGS 4
 /* number of significant figures to which to estimate scale
    parameters (currently affects 1d parameter estimation only) */
 
+#define FEAT_CHUNK_LEN 16
+/* number of consecutive features handed to a thread at a time */
+
 /* Compute and return the log likelihood of a tree model with respect
    to a given feature.  Calls col_compute_log_likelihood for each
    column */ 
@@ -37,25 +41,38 @@ double ff_compute_log_likelihood(TreeModel *mod, MSA *msa, GFF_Feature *feat,
   return retval;
 }
 
+/* Compute the log likelihood of the current feature of d from its
+   histogram of distinct tuples */
+static double ff_hist_log_likelihood(FeatFitData *d) {
+  double retval = 0;
+  int k;
+  for (k = 0; k < d->ntuples; k++)
+    retval += d->counts[k] * 
+      col_compute_log_likelihood(d->cdata->mod, d->cdata->msa, d->tuples[k], 
+                                 d->cdata->fels_scratch[0]);
+  return retval;
+}
+
 /* Compute the first and (optionally) second derivatives with respect
    to the scale parameter for the single-feature log likelihood
    function (feat_compute_log_likelihood).  This version assumes a
    single scale parameter; see below for the subtree case.  Return
    value is log likelihood, which is computed as a by-product.  Derivs
    will be stored in *first_deriv and *second_deriv.  If second_deriv
-   == NULL, it will not be computed (saves some time).  */
+   == NULL, it will not be computed (saves some time).  Each distinct
+   tuple of the feature is considered once, weighted by its count */
 double ff_scale_derivs(FeatFitData *d, double *first_deriv,
                        double *second_deriv, double ***scratch) {
   double d1, d2, retval = 0;
   double *pd2 = (second_deriv == NULL ? NULL : &d2);
-  int i;
+  int k;
   (*first_deriv) = 0;
   if (second_deriv != NULL) (*second_deriv) = 0;
-  for (i = d->feat->start-1; i < d->feat->end; i++) { /* offset of one */
-    d->cdata->tupleidx = d->cdata->msa->ss->tuple_idx[i];
-    retval += col_scale_derivs(d->cdata, &d1, pd2, scratch);
-    (*first_deriv) += d1;
-    if (second_deriv != NULL) (*second_deriv) += d2;
+  for (k = 0; k < d->ntuples; k++) {
+    d->cdata->tupleidx = d->tuples[k];
+    retval += d->counts[k] * col_scale_derivs(d->cdata, &d1, pd2, scratch);
+    (*first_deriv) += d->counts[k] * d1;
+    if (second_deriv != NULL) (*second_deriv) += d->counts[k] * d2;
   }
   return retval;
 }
@@ -72,15 +89,22 @@ double ff_scale_derivs_subtree(FeatFitData *d, Vector *gradient,
   double retval = 0;
   Vector *d1 = vec_new(2);
   Matrix *d2 = (hessian == NULL ? NULL : mat_new(2, 2));
-  int i;
+  int k;
   vec_zero(gradient);
   if (hessian != NULL) mat_zero(hessian);
-  for (i = d->feat->start-1; i < d->feat->end; i++) { /* offset of one */
-    d->cdata->tupleidx = d->cdata->msa->ss->tuple_idx[i];
-    retval += col_scale_derivs_subtree(d->cdata, d1, d2, scratch);
+  for (k = 0; k < d->ntuples; k++) {
+    d->cdata->tupleidx = d->tuples[k];
+    retval += d->counts[k] * 
+      col_scale_derivs_subtree(d->cdata, d1, d2, scratch);
+    vec_scale(d1, d->counts[k]);
     vec_plus_eq(gradient, d1);
-    if (hessian != NULL) mat_plus_eq(hessian, d2);
+    if (hessian != NULL) {
+      mat_scale(d2, d->counts[k]);
+      mat_plus_eq(hessian, d2);
+    }
   }
+  vec_free(d1);
+  if (d2 != NULL) mat_free(d2);
   return retval;
 }
 
@@ -95,8 +119,7 @@ double ff_likelihood_wrapper(Vector *params, void *data) {
   /* reestimate subst models on edges */
   tm_set_subst_matrices(d->cdata->mod); 
 
-  return -1 * ff_compute_log_likelihood(d->cdata->mod, d->cdata->msa, 
-                                        d->feat, d->cdata->fels_scratch[0]);
+  return -1 * ff_hist_log_likelihood(d);
 }
 
 /* Wrapper for likelihood function for use in parameter estimation;
@@ -111,8 +134,7 @@ double ff_likelihood_wrapper_1d(double x, void *data) {
   /* reestimate subst models on edges */
   tm_set_subst_matrices(d->cdata->mod); 
 
-  return -1 * ff_compute_log_likelihood(d->cdata->mod, d->cdata->msa, 
-                                        d->feat, d->cdata->fels_scratch[0]);
+  return -1 * ff_hist_log_likelihood(d);
 }
 
 /* Wrapper for gradient function for use in parameter estimation */
@@ -131,34 +153,162 @@ void ff_grad_wrapper(Vector *grad, Vector *params, void *data,
   }
 }
 
-/* Perform a likelihood ratio test for each feature in a GFF,
-   comparing the given null model with an alternative model that has a
-   free scaling parameter for all branches.  Assumes a 0th order
-   model, leaf-to-sequence mapping already available, prob matrices
-   computed, sufficient stats available.  Computes p-values based
-   using the chi-sq distribution and stores them in feat_pvals.  Will
-   optionally store the individual scale factors in feat_scales and
-   raw log likelihood ratios in feat_llrs if these variables are
-   non-NULL.  Must define mode as CON (for 0 <= scale <= 1), ACC (for
-   1 <= scale), NNEUT (0 <= scale), or CONACC (0 <= scale) */ 
-void ff_lrts(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode, 
-             double *feat_pvals, double *feat_scales, double *feat_llrs, 
-             FILE *logf) {
-  int i;
-  FeatFitData *d;
-  double null_lnl, alt_lnl, delta_lnl, this_scale = 1;
+/* Per-thread state for processing features in parallel.  Thread 0
+   works with the caller's model; the others work with private
+   copies, made before any thread starts */
+typedef struct {
+  TreeModel *mod;               /* model of thread */
+  TreeModel *modcpy;            /* copy of mod without subtree, for
+                                   null model in subtree case */
+  FeatFitData *d;               /* fit data for whole-tree scale */
+  FeatFitData *d2;              /* fit data for subtree scale, if
+                                   needed */
+  Vector *grad;                 /* scratch for gradients */
+  int *has_data;                /* scratch for ff_find_missing_branches */
+} FeatThread;
+
+/* State shared by the jobs of a parallel computation over features.
+   Each job processes FEAT_CHUNK_LEN consecutive features and stores
+   results only in the entries of the output arrays for those
+   features, so results do not depend on the number of threads */
+typedef struct {
+  MSA *msa;
+  GFF_Set *gff;
+  mode_type mode;
+  FILE *logf;
+  ThreadPool *tp;
+  FeatThread *threads;
+  List *inside, *outside;       /* leaves inside and outside subtree */
+  double fim;                   /* for score tests */
+  FimGrid *grid;                /* for score tests, subtree case */
+  double *out[5];               /* output arrays (may be NULL) */
+} FeatBatch;
+
+/* Set up a thread pool and per-thread fit data for a computation
+   over the features of gff.  If subtree == TRUE, each thread gets a
+   FeatFitData object for the null model (whole-tree scale only) and
+   one of the given mode for the subtree model; otherwise it gets only
+   one, of the given mode */
+static void ff_batch_init(FeatBatch *fb, TreeModel *mod, MSA *msa, 
+                          GFF_Set *gff, mode_type mode, mode_type fit_mode,
+                          int subtree, FILE *logf, int nthreads) {
+  int t, nchunks = max(1, (lst_size(gff->features) + FEAT_CHUNK_LEN - 1) /
+                        FEAT_CHUNK_LEN);
+
+  fb->msa = msa;
+  fb->gff = gff;
+  fb->mode = mode;
+  fb->logf = logf;
+  fb->inside = fb->outside = NULL;
+  fb->grid = NULL;
+  fb->fim = 0;
+  for (t = 0; t < 5; t++) fb->out[t] = NULL;
+
+  /* the log is shared, so it requires serial execution */
+  if (logf != NULL) nthreads = 1;
+  fb->tp = tp_new(min(nthreads <= 0 ? tp_nprocessors() : nthreads, nchunks));
+  nthreads = tp_nthreads(fb->tp);
+
+  /* tm_create_copy may compute a traversal of the input tree; do it
+     here, and make all copies before the caller's model is altered
+     by ff_init_fit_data */
+  tr_postorder(mod->tree);
+  fb->threads = smalloc(nthreads * sizeof(FeatThread));
+  for (t = 0; t < nthreads; t++) {
+    FeatThread *th = &fb->threads[t];
+    th->mod = (t == 0 ? mod : tm_create_copy(mod));
+    th->modcpy = NULL;
+    th->d = th->d2 = NULL;
+    th->grad = NULL;
+    th->has_data = NULL;
+  }
 
-  /* init FeatFitData */
-  d = ff_init_fit_data(mod, msa, ALL, mode, FALSE);
+  for (t = 0; t < nthreads; t++) {
+    FeatThread *th = &fb->threads[t];
+    if (subtree) {
+      th->modcpy = tm_create_copy(th->mod);
+                                /* need separate copy of tree model
+                                   with different internal scaling
+                                   data for supertree/subtree case */
+      th->modcpy->subtree_root = NULL;
+      th->d = ff_init_fit_data(th->modcpy, msa, ALL, NNEUT, FALSE);
+      th->d2 = ff_init_fit_data(th->mod, msa, SUBTREE, fit_mode, FALSE);
+                                /* mod has the subtree info, modcpy
+                                   does not */
+      th->grad = vec_new(2);
+    }
+    else 
+      th->d = ff_init_fit_data(th->mod, msa, ALL, fit_mode, FALSE);
+    th->has_data = smalloc(th->mod->tree->nnodes * sizeof(int));
+  }
 
-  /* iterate through features  */
-  for (i = 0; i < lst_size(gff->features); i++) {
-    GFF_Feature *f = lst_get_ptr(gff->features, i);
+  /* prepare lists of leaves inside and outside root, for use in
+     checking for informative substitutions */
+  if (subtree && mod->subtree_root != NULL) {
+    fb->inside = lst_new_ptr(mod->tree->nnodes);
+    fb->outside = lst_new_ptr(mod->tree->nnodes); 
+    tr_partition_leaves(mod->tree, mod->subtree_root, fb->inside, 
+                        fb->outside);
+  }
+}
+
+/* Run a job for each chunk of FEAT_CHUNK_LEN features */
+static void ff_batch_run(FeatBatch *fb, tp_job_fn fn) {
+  tp_run(fb->tp, (lst_size(fb->gff->features) + FEAT_CHUNK_LEN - 1) / 
+         FEAT_CHUNK_LEN, fn, fb);
+}
+
+/* Free per-thread data and model copies */
+static void ff_batch_free(FeatBatch *fb) {
+  int t;
+  for (t = 0; t < tp_nthreads(fb->tp); t++) {
+    FeatThread *th = &fb->threads[t];
+    if (th->d != NULL) {
+      ff_free_fit_data(th->d);
+      sfree(th->d);
+    }
+    if (th->d2 != NULL) {
+      ff_free_fit_data(th->d2);
+      sfree(th->d2);
+    }
+    if (th->modcpy != NULL) {
+      th->modcpy->estimate_branchlens = TM_BRANCHLENS_ALL; 
+                                /* have to revert for tm_free to work
+                                   correctly */
+      tm_free(th->modcpy);
+    }
+    if (t > 0) {
+      th->mod->estimate_branchlens = TM_BRANCHLENS_ALL; 
+      tm_free(th->mod);
+    }
+    if (th->grad != NULL) vec_free(th->grad);
+    sfree(th->has_data);
+  }
+  sfree(fb->threads);
+  tp_free(fb->tp);
+  if (fb->inside != NULL) lst_free(fb->inside);
+  if (fb->outside != NULL) lst_free(fb->outside);
+}
+
+/* LRTs for a chunk of features (job of ff_lrts) */
+static void ff_lrts_chunk(void *data, int job, int thread) {
+  FeatBatch *fb = data;
+  FeatThread *th = &fb->threads[thread];
+  TreeModel *mod = th->mod;
+  FeatFitData *d = th->d;
+  mode_type mode = fb->mode;
+  double *feat_pvals = fb->out[0], *feat_scales = fb->out[1], 
+    *feat_llrs = fb->out[2];
+  double null_lnl, alt_lnl, delta_lnl, this_scale = 1;
+  int i, last = min((job+1) * FEAT_CHUNK_LEN, lst_size(fb->gff->features));
+
+  for (i = job * FEAT_CHUNK_LEN; i < last; i++) {
+    GFF_Feature *f = lst_get_ptr(fb->gff->features, i);
     checkInterrupt();
 
     /* first check for actual substitution data in feature; if none,
        don't waste time computing likelihoods */
-    if (!ff_has_data(mod, msa, f)) {
+    if (!ff_has_data(mod, fb->msa, f)) {
       delta_lnl = 0;
       this_scale = 1;
     }
@@ -168,15 +318,14 @@ void ff_lrts(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode,
       tm_set_subst_matrices(mod);
 
       /* compute log likelihoods under null and alt hypotheses */
-      null_lnl = ff_compute_log_likelihood(mod, msa, f, 
-                                           d->cdata->fels_scratch[0]);
+      ff_set_feature(d, f);
+      null_lnl = ff_hist_log_likelihood(d);
 
       vec_set(d->cdata->params, 0, d->cdata->init_scale);
-      d->feat = f;
 
       opt_newton_1d(ff_likelihood_wrapper_1d, &d->cdata->params->data[0], d, 
                     &alt_lnl, SIGFIGS, d->cdata->lb->data[0], 
-                    d->cdata->ub->data[0], logf, NULL, NULL);   
+                    d->cdata->ub->data[0], fb->logf, NULL, NULL);   
       /* turns out to be faster to use numerical rather than exact
          derivatives (judging by col case) */
 
@@ -210,49 +359,50 @@ void ff_lrts(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode,
     if (feat_scales != NULL) feat_scales[i] = this_scale;
     if (feat_llrs != NULL) feat_llrs[i] = delta_lnl;
   }
-  
-  ff_free_fit_data(d);
-  sfree(d);  //above function doesn't actually free object
 }
 
-/* Subtree version of LRT */
-void ff_lrts_sub(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode, 
-                 double *feat_pvals, double *feat_null_scales, 
-                 double *feat_scales, double *feat_sub_scales, 
-                 double *feat_llrs, FILE *logf) {
-  int i;
-  FeatFitData *d, *d2;
-  double null_lnl, alt_lnl, delta_lnl;
-  TreeModel *modcpy;
-  List *inside=NULL, *outside=NULL;
-
-  modcpy = tm_create_copy(mod);   /* need separate copy of tree model
-                                     with different internal scaling
-                                     data for supertree/subtree case */
-
-  /* init ColFitData -- one for null model, one for alt */
-  modcpy->subtree_root = NULL;
-  d = ff_init_fit_data(modcpy, msa, ALL, NNEUT, FALSE);
-  d2 = ff_init_fit_data(mod, msa, SUBTREE, mode, FALSE); 
-                                /* mod has the subtree info, modcpy
-                                   does not */
+/* Perform a likelihood ratio test for each feature in a GFF,
+   comparing the given null model with an alternative model that has a
+   free scaling parameter for all branches.  Assumes a 0th order
+   model, leaf-to-sequence mapping already available, prob matrices
+   computed, sufficient stats available.  Computes p-values based
+   using the chi-sq distribution and stores them in feat_pvals.  Will
+   optionally store the individual scale factors in feat_scales and
+   raw log likelihood ratios in feat_llrs if these variables are
+   non-NULL.  Must define mode as CON (for 0 <= scale <= 1), ACC (for
+   1 <= scale), NNEUT (0 <= scale), or CONACC (0 <= scale).  Features
+   are divided among nthreads threads */ 
+void ff_lrts(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode, 
+             double *feat_pvals, double *feat_scales, double *feat_llrs, 
+             FILE *logf, int nthreads) {
+  FeatBatch fb;
+  ff_batch_init(&fb, mod, msa, gff, mode, mode, FALSE, logf, nthreads);
+  fb.out[0] = feat_pvals;
+  fb.out[1] = feat_scales;
+  fb.out[2] = feat_llrs;
+  ff_batch_run(&fb, ff_lrts_chunk);
+  ff_batch_free(&fb);
+}
 
-  /* prepare lists of leaves inside and outside root, for use in
-     checking for informative substitutions */
-  if (mod->subtree_root != NULL) {
-    inside = lst_new_ptr(mod->tree->nnodes);
-    outside = lst_new_ptr(mod->tree->nnodes); 
-    tr_partition_leaves(mod->tree, mod->subtree_root, inside, outside);
-  }
+/* Subtree LRTs for a chunk of features (job of ff_lrts_sub) */
+static void ff_lrts_sub_chunk(void *data, int job, int thread) {
+  FeatBatch *fb = data;
+  FeatThread *th = &fb->threads[thread];
+  FeatFitData *d = th->d, *d2 = th->d2;
+  mode_type mode = fb->mode;
+  double *feat_pvals = fb->out[0], *feat_null_scales = fb->out[1], 
+    *feat_scales = fb->out[2], *feat_sub_scales = fb->out[3], 
+    *feat_llrs = fb->out[4];
+  double null_lnl, alt_lnl, delta_lnl;
+  int i, last = min((job+1) * FEAT_CHUNK_LEN, lst_size(fb->gff->features));
 
-  /* iterate through features  */
-  for (i = 0; i < lst_size(gff->features); i++) {
-    GFF_Feature *f = lst_get_ptr(gff->features, i);
+  for (i = job * FEAT_CHUNK_LEN; i < last; i++) {
+    GFF_Feature *f = lst_get_ptr(fb->gff->features, i);
     checkInterrupt();
 
     /* first check for informative substitution data in feature; if none,
        don't waste time computing likelihoods */
-    if (!ff_has_data_sub(mod, msa, f, inside, outside)) {
+    if (!ff_has_data_sub(th->mod, fb->msa, f, fb->inside, fb->outside)) {
       delta_lnl = 0;
       d->cdata->params->data[0] = d2->cdata->params->data[0] = 
         d2->cdata->params->data[1] = 1;
@@ -260,20 +410,20 @@ void ff_lrts_sub(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode,
 
     else {
       /* compute log likelihoods under null and alt hypotheses */
-      d->feat = f;
+      ff_set_feature(d, f);
       vec_set(d->cdata->params, 0, d->cdata->init_scale);
       opt_newton_1d(ff_likelihood_wrapper_1d, &d->cdata->params->data[0], d, 
                     &null_lnl, SIGFIGS, d->cdata->lb->data[0], 
-                    d->cdata->ub->data[0], logf, NULL, NULL);   
+                    d->cdata->ub->data[0], fb->logf, NULL, NULL);   
       null_lnl *= -1;
 
-      d2->feat = f;
+      ff_set_feature(d2, f);
       vec_set(d2->cdata->params, 0, d->cdata->params->data[0]); 
                                 /* init to previous estimate to save time */
       vec_set(d2->cdata->params, 1, d2->cdata->init_scale_sub);
       //      vec_set(d2->cdata->params, 1, 0.01);
       if (opt_bfgs(ff_likelihood_wrapper, d2->cdata->params, d2, &alt_lnl, 
-                   d2->cdata->lb, d2->cdata->ub, logf, NULL, 
+                   d2->cdata->lb, d2->cdata->ub, fb->logf, NULL, 
                    OPT_HIGH_PREC, NULL, NULL) != 0)
         ;                         /* do nothing; nonzero exit typically
                                      occurs when max iterations is
@@ -288,11 +438,10 @@ void ff_lrts_sub(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode,
 	 If we get a significantly negative lnL, re-initialize params
 	 so that they are identical to null model params and re-start */
       if (delta_lnl <= -0.05) {
-	d2->feat = f;
 	vec_set(d2->cdata->params, 0, d->cdata->params->data[0]); 
 	vec_set(d2->cdata->params, 1, 1.0);
 	if (opt_bfgs(ff_likelihood_wrapper, d2->cdata->params, d2, &alt_lnl, 
-		     d2->cdata->lb, d2->cdata->ub, logf, NULL, 
+		     d2->cdata->lb, d2->cdata->ub, fb->logf, NULL, 
 		     OPT_HIGH_PREC, NULL, NULL) != 0)
 	  if (delta_lnl <= -0.1)
 	    die("ERROR ff_lrts_sub: delta_lnl (%f) <= -0.1\n", delta_lnl);
@@ -327,52 +476,52 @@ void ff_lrts_sub(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode,
     if (feat_llrs != NULL) 
       feat_llrs[i] = delta_lnl;
   }
-  
-  ff_free_fit_data(d);
-  ff_free_fit_data(d2);
-  modcpy->estimate_branchlens = TM_BRANCHLENS_ALL; 
-                                /* have to revert for tm_free to work
-                                   correctly */
-  tm_free(modcpy);
-  if (inside != NULL) lst_free(inside);
-  if (outside != NULL) lst_free(outside);
 }
 
-/* Score test */
-void ff_score_tests(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode, 
-                    double *feat_pvals, double *feat_derivs, 
-                    double *feat_teststats) {
-  int i;
-  FeatFitData *d;
-  double first_deriv, teststat, fim;
-
-  /* init FeatFitData */
-  d = ff_init_fit_data(mod, msa, ALL, NNEUT, FALSE);
-
-  /* precompute FIM */
-  fim = col_estimate_fim(mod);
-
-  if (fim < 0) 
-    die("ERROR: negative fisher information in col_score_tests\n");
+/* Subtree version of LRT */
+void ff_lrts_sub(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode, 
+                 double *feat_pvals, double *feat_null_scales, 
+                 double *feat_scales, double *feat_sub_scales, 
+                 double *feat_llrs, FILE *logf, int nthreads) {
+  FeatBatch fb;
+  ff_batch_init(&fb, mod, msa, gff, mode, mode, TRUE, logf, nthreads);
+  fb.out[0] = feat_pvals;
+  fb.out[1] = feat_null_scales;
+  fb.out[2] = feat_scales;
+  fb.out[3] = feat_sub_scales;
+  fb.out[4] = feat_llrs;
+  ff_batch_run(&fb, ff_lrts_sub_chunk);
+  ff_batch_free(&fb);
+}
 
-  /* iterate through features  */
-  for (i = 0; i < lst_size(gff->features); i++) {
+/* Score tests for a chunk of features (job of ff_score_tests) */
+static void ff_score_tests_chunk(void *data, int job, int thread) {
+  FeatBatch *fb = data;
+  FeatThread *th = &fb->threads[thread];
+  FeatFitData *d = th->d;
+  mode_type mode = fb->mode;
+  double *feat_pvals = fb->out[0], *feat_derivs = fb->out[1], 
+    *feat_teststats = fb->out[2];
+  double first_deriv, teststat;
+  int i, last = min((job+1) * FEAT_CHUNK_LEN, lst_size(fb->gff->features));
+
+  for (i = job * FEAT_CHUNK_LEN; i < last; i++) {
+    GFF_Feature *f = lst_get_ptr(fb->gff->features, i);
     checkInterrupt();
-    d->feat = lst_get_ptr(gff->features, i);
 
     /* first check for actual substitution data in feature; if none,
        don't waste time computing likelihoods */
-    if (!ff_has_data(mod, msa, d->feat)) {
+    if (!ff_has_data(th->mod, fb->msa, f)) {
       teststat = 0;
       first_deriv = 1;
     }
 
     else {
-
+      ff_set_feature(d, f);
       ff_scale_derivs(d, &first_deriv, NULL, d->cdata->fels_scratch);
 
       teststat = first_deriv*first_deriv / 
-        ((d->feat->end - d->feat->start + 1) * fim);
+        ((f->end - f->start + 1) * fb->fim);
       /* scale column-by-column FIM by length of feature (expected
          values are additive) */
 
@@ -401,72 +550,71 @@ void ff_score_tests(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode,
     if (feat_derivs != NULL) feat_derivs[i] = first_deriv;
     if (feat_teststats != NULL) feat_teststats[i] = teststat;
   }
-
-  ff_free_fit_data(d);
 }
 
-/* Subtree version of score test */
-void ff_score_tests_sub(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode,
-                        double *feat_pvals, double *feat_null_scales, 
-                        double *feat_derivs, double *feat_sub_derivs, 
-                        double *feat_teststats, FILE *logf) {
-  int i;
-  FeatFitData *d, *d2;
-  Vector *grad = vec_new(2);
-  Matrix *fim = mat_new(2, 2);
-  double lnl, teststat;
-  FimGrid *grid;
-  List *inside=NULL, *outside=NULL;
-  TreeModel *modcpy = tm_create_copy(mod); /* need separate copy of tree model
-                                              with different internal scaling
-                                              data for supertree/subtree case */
-  modcpy->subtree_root = NULL;
-
-  /* init FeatFitData -- one for null model, one for alt */
-  d = ff_init_fit_data(modcpy, msa, ALL, NNEUT, FALSE);
-  d2 = ff_init_fit_data(mod, msa, SUBTREE, NNEUT, FALSE); 
-                                /* mod has the subtree info, modcpy
-                                   does not */
+/* Score test */
+void ff_score_tests(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode, 
+                    double *feat_pvals, double *feat_derivs, 
+                    double *feat_teststats, int nthreads) {
+  FeatBatch fb;
+  ff_batch_init(&fb, mod, msa, gff, mode, NNEUT, FALSE, NULL, nthreads);
+  fb.out[0] = feat_pvals;
+  fb.out[1] = feat_derivs;
+  fb.out[2] = feat_teststats;
 
-  /* precompute Fisher information matrices for a grid of scale values */
-  grid = col_fim_grid_sub(mod); 
+  /* precompute FIM */
+  fb.fim = col_estimate_fim(mod);
 
-  /* prepare lists of leaves inside and outside root, for use in
-     checking for informative substitutions */
-  if (mod->subtree_root != NULL) {
-    inside = lst_new_ptr(mod->tree->nnodes);
-    outside = lst_new_ptr(mod->tree->nnodes);
-    tr_partition_leaves(mod->tree, mod->subtree_root, inside, outside);
-  }
+  if (fb.fim < 0) 
+    die("ERROR: negative fisher information in col_score_tests\n");
 
-  /* iterate through features  */
-  for (i = 0; i < lst_size(gff->features); i++) {
+  ff_batch_run(&fb, ff_score_tests_chunk);
+  ff_batch_free(&fb);
+}
+
+/* Subtree score tests for a chunk of features (job of
+   ff_score_tests_sub) */
+static void ff_score_tests_sub_chunk(void *data, int job, int thread) {
+  FeatBatch *fb = data;
+  FeatThread *th = &fb->threads[thread];
+  FeatFitData *d = th->d, *d2 = th->d2;
+  Vector *grad = th->grad;
+  Matrix *fim;
+  mode_type mode = fb->mode;
+  double *feat_pvals = fb->out[0], *feat_null_scales = fb->out[1], 
+    *feat_derivs = fb->out[2], *feat_sub_derivs = fb->out[3], 
+    *feat_teststats = fb->out[4];
+  double lnl, teststat;
+  int i, last = min((job+1) * FEAT_CHUNK_LEN, lst_size(fb->gff->features));
+
+  for (i = job * FEAT_CHUNK_LEN; i < last; i++) {
+    GFF_Feature *f = lst_get_ptr(fb->gff->features, i);
     checkInterrupt();
-    d->feat = lst_get_ptr(gff->features, i);
 
     /* first check for informative substitution data in feature; if none,
        don't waste time computing likelihoods */
-    if (!ff_has_data_sub(mod, msa, d->feat, inside, outside)) { 
+    if (!ff_has_data_sub(th->mod, fb->msa, f, fb->inside, fb->outside)) { 
       teststat = 0;
       vec_zero(grad);
     }
 
     else {
+      ff_set_feature(d, f);
       vec_set(d->cdata->params, 0, d->cdata->init_scale);
       opt_newton_1d(ff_likelihood_wrapper_1d, &d->cdata->params->data[0], d, 
                     &lnl, SIGFIGS, d->cdata->lb->data[0], d->cdata->ub->data[0], 
-                    logf, NULL, NULL);   
+                    fb->logf, NULL, NULL);   
       /* turns out to be faster to use numerical rather than exact
          derivatives (judging by col case) */
 
-      d2->feat = d->feat;
+      ff_set_feature(d2, f);
       d2->cdata->mod->scale = d->cdata->params->data[0];
       d2->cdata->mod->scale_sub = 1;
       tm_set_subst_matrices(d2->cdata->mod);
       ff_scale_derivs_subtree(d2, grad, NULL, d2->cdata->fels_scratch);
 
-      fim = col_get_fim_sub(grid, d2->cdata->mod->scale); 
-      mat_scale(fim, d->feat->end - d->feat->start + 1);
+      fim = col_get_fim_sub(fb->grid, d2->cdata->mod->scale); 
+      mat_scale(fim, f->end - f->start + 1);
       /* scale column-by-column FIM by length of feature (expected
          values are additive) */
     
@@ -507,52 +655,56 @@ void ff_score_tests_sub(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode,
     if (feat_sub_derivs != NULL) feat_sub_derivs[i] = grad->data[1];
     if (feat_teststats != NULL) feat_teststats[i] = teststat;
   }
+}
 
-  ff_free_fit_data(d);
-  ff_free_fit_data(d2);
-  vec_free(grad); 
-  modcpy->estimate_branchlens = TM_BRANCHLENS_ALL; 
-                                /* have to revert for tm_free to work
-                                   correctly */
-  tm_free(modcpy);
-  col_free_fim_grid(grid); 
-  if (inside != NULL) lst_free(inside);
-  if (outside != NULL) lst_free(outside);
+/* Subtree version of score test */
+void ff_score_tests_sub(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode,
+                        double *feat_pvals, double *feat_null_scales, 
+                        double *feat_derivs, double *feat_sub_derivs, 
+                        double *feat_teststats, FILE *logf, int nthreads) {
+  FeatBatch fb;
+  ff_batch_init(&fb, mod, msa, gff, mode, NNEUT, TRUE, logf, nthreads);
+  fb.out[0] = feat_pvals;
+  fb.out[1] = feat_null_scales;
+  fb.out[2] = feat_derivs;
+  fb.out[3] = feat_sub_derivs;
+  fb.out[4] = feat_teststats;
+
+  /* precompute Fisher information matrices for a grid of scale values */
+  fb.grid = col_fim_grid_sub(mod); 
+
+  ff_batch_run(&fb, ff_score_tests_sub_chunk);
+  col_free_fim_grid(fb.grid); 
+  ff_batch_free(&fb);
 }
 
-/* Perform a GERP-like computation for each feature.  Computes expected
-   number of subst. under neutrality (feat_nneut), expected number
-   after rescaling by ML (feat_nobs), expected number of rejected
-   substitutions (feat_nrejected), and number of species with data
-   (feat_nspecies).  If any arrays are NULL, values will not be
-   retained.  Gaps and missing data are handled by working with
-   induced subtree.  */
-void ff_gerp(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode, 
-             double *feat_nneut, double *feat_nobs, double *feat_nrejected, 
-             double *feat_nspec, FILE *logf) { 
-  int i, j, nspec = 0;
+/* GERP-like computation for a chunk of features (job of ff_gerp) */
+static void ff_gerp_chunk(void *data, int job, int thread) {
+  FeatBatch *fb = data;
+  FeatThread *th = &fb->threads[thread];
+  TreeModel *mod = th->mod;
+  FeatFitData *d = th->d;
+  int *has_data = th->has_data;
+  double *feat_nneut = fb->out[0], *feat_nobs = fb->out[1], 
+    *feat_nrejected = fb->out[2], *feat_nspec = fb->out[3];
   double nneut, scale, lnl;
-  int *has_data = smalloc(mod->tree->nnodes * sizeof(int));
-  FeatFitData *d;
-
-  /* init FeatFitData */
-  d = ff_init_fit_data(mod, msa, ALL, NNEUT, FALSE);
+  int i, j, nspec = 0, 
+    last = min((job+1) * FEAT_CHUNK_LEN, lst_size(fb->gff->features));
 
-  /* iterate through features  */
-  for (i = 0; i < lst_size(gff->features); i++) {
-    GFF_Feature *f = lst_get_ptr(gff->features, i);
+  for (i = job * FEAT_CHUNK_LEN; i < last; i++) {
+    GFF_Feature *f = lst_get_ptr(fb->gff->features, i);
     checkInterrupt();
-    ff_find_missing_branches(mod, msa, f, has_data, &nspec);
+    ff_find_missing_branches(mod, fb->msa, f, has_data, &nspec);
 
     if (nspec < 3) 
       nneut = scale = 0;
     else {
       vec_set(d->cdata->params, 0, d->cdata->init_scale);
-      d->feat = f;
+      ff_set_feature(d, f);
 
       opt_newton_1d(ff_likelihood_wrapper_1d, &d->cdata->params->data[0], d, 
                     &lnl, SIGFIGS, d->cdata->lb->data[0], d->cdata->ub->data[0], 
-                    logf, NULL, NULL);   
+                    fb->logf, NULL, NULL);   
       /* turns out to be faster to use numerical rather than exact
          derivatives (judging by col case) */
       
@@ -567,12 +719,30 @@ void ff_gerp(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode,
     if (feat_nobs != NULL) feat_nobs[i] = scale * nneut;
     if (feat_nrejected != NULL) {
       feat_nrejected[i] = nneut * (1 - scale);
-      if (mode == ACC) feat_nrejected[i] *= -1;
-      else if (mode == NNEUT) feat_nrejected[i] = fabs(feat_nrejected[i]);
+      if (fb->mode == ACC) feat_nrejected[i] *= -1;
+      else if (fb->mode == NNEUT) feat_nrejected[i] = fabs(feat_nrejected[i]);
     }
   }
-  ff_free_fit_data(d);
-  sfree(has_data);
+}
+
+/* Perform a GERP-like computation for each feature.  Computes expected
+   number of subst. under neutrality (feat_nneut), expected number
+   after rescaling by ML (feat_nobs), expected number of rejected
+   substitutions (feat_nrejected), and number of species with data
+   (feat_nspecies).  If any arrays are NULL, values will not be
+   retained.  Gaps and missing data are handled by working with
+   induced subtree.  */
+void ff_gerp(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode, 
+             double *feat_nneut, double *feat_nobs, double *feat_nrejected, 
+             double *feat_nspec, FILE *logf, int nthreads) { 
+  FeatBatch fb;
+  ff_batch_init(&fb, mod, msa, gff, mode, NNEUT, FALSE, logf, nthreads);
+  fb.out[0] = feat_nneut;
+  fb.out[1] = feat_nobs;
+  fb.out[2] = feat_nrejected;
+  fb.out[3] = feat_nspec;
+  ff_batch_run(&fb, ff_gerp_chunk);
+  ff_batch_free(&fb);
 }
 
 /* Create object with metadata and scratch memory for fitting scale
@@ -580,14 +750,50 @@ void ff_gerp(TreeModel *mod, MSA *msa, GFF_Set *gff, mode_type mode,
 FeatFitData *ff_init_fit_data(TreeModel *mod,  MSA *msa, scale_type stype, 
                               mode_type mode, int second_derivs) {
   FeatFitData *retval = smalloc(sizeof(FeatFitData));
+  int i;
   retval->feat = NULL;
   retval->cdata = col_init_fit_data(mod, msa, stype, mode, second_derivs);
+  retval->ntuples = retval->hist_alloc = 0;
+  retval->tuples = retval->counts = NULL;
+  retval->tuple_pos = smalloc(msa->ss->ntuples * sizeof(int));
+  for (i = 0; i < msa->ss->ntuples; i++) retval->tuple_pos[i] = -1;
   return retval;
 }
 
+/* Set current feature and collapse its columns into a histogram of
+   distinct tuples */
+void ff_set_feature(FeatFitData *d, GFF_Feature *feat) {
+  MSA *msa = d->cdata->msa;
+  int i, k, len = min(feat->end - feat->start + 1, msa->ss->ntuples);
+
+  /* clear marks left by previous feature */
+  for (k = 0; k < d->ntuples; k++) d->tuple_pos[d->tuples[k]] = -1;
+
+  if (len > d->hist_alloc) {
+    d->hist_alloc = max(len, 2 * d->hist_alloc);
+    d->tuples = srealloc(d->tuples, d->hist_alloc * sizeof(int));
+    d->counts = srealloc(d->counts, d->hist_alloc * sizeof(int));
+  }
+
+  d->feat = feat;
+  d->ntuples = 0;
+  for (i = feat->start-1; i < feat->end; i++) { /* offset of one */
+    int tupleidx = msa->ss->tuple_idx[i];
+    if (d->tuple_pos[tupleidx] < 0) {
+      d->tuple_pos[tupleidx] = d->ntuples;
+      d->tuples[d->ntuples] = tupleidx;
+      d->counts[d->ntuples++] = 0;
+    }
+    d->counts[d->tuple_pos[tupleidx]]++;
+  }
+}
+
 /* Free metadata and memory for fitting scale factors */
 void ff_free_fit_data(FeatFitData *d) {
   col_free_fit_data(d->cdata);
+  sfree(d->tuples);
+  sfree(d->counts);
+  sfree(d->tuple_pos);
 }
 
 /* Identify branches wrt which a given feature is uninformative,
@@ -22,19 +22,29 @@
    in each sequence is a base, has been deleted, or is "padding"
    required for an insertion) */
 
-/* create new indel history */
+/* create new indel history; all columns are initialized to bases.
+   Columns are stored as runs of identical column histories
+   ("patterns"), so an alignment of any length with no indels requires
+   a single pattern and a single run */
 IndelHistory *ih_new(TreeNode *tree, int ncols) {
-  int i, j;
+  int i;
+  char *pattern;
   IndelHistory *ih = smalloc(sizeof(IndelHistory));
   ih->tree = tree;
-  ih->ncols = ncols;
-  ih->indel_strings = smalloc(tree->nnodes * sizeof(void*));
-
-  for (i = 0; i < tree->nnodes; i++) {
-    ih->indel_strings[i] = smalloc(ncols * sizeof(char));
-    /* initialize with base characters */
-    for (j = 0; j < ncols; j++)
-      ih->indel_strings[i][j] = BASE;
+  ih->ncols = 0;
+  ih->npatterns = ih->nruns = 0;
+  ih->alloc_patterns = 10;
+  ih->alloc_runs = 100;
+  ih->patterns = smalloc(ih->alloc_patterns * sizeof(char*));
+  ih->run_start = smalloc(ih->alloc_runs * sizeof(int));
+  ih->run_pattern = smalloc(ih->alloc_runs * sizeof(int));
+  ih->pattern_hash = hsh_new(1000);
+
+  if (ncols > 0) {
+    pattern = smalloc(tree->nnodes * sizeof(char));
+    for (i = 0; i < tree->nnodes; i++) pattern[i] = BASE;
+    ih_append_cols(ih, ih_add_pattern(ih, pattern), ncols);
+    sfree(pattern);
   }
   return ih;
 }
@@ -42,12 +52,72 @@ IndelHistory *ih_new(TreeNode *tree, int ncols) {
 /* free indel history */
 void ih_free(IndelHistory *ih) {
   int i;
-  for (i = 0; i < ih->tree->nnodes; i++)
-    sfree(ih->indel_strings[i]);
-  sfree(ih->indel_strings);
+  for (i = 0; i < ih->npatterns; i++)
+    sfree(ih->patterns[i]);
+  sfree(ih->patterns);
+  sfree(ih->run_start);
+  sfree(ih->run_pattern);
+  hsh_free(ih->pattern_hash);
   sfree(ih);
 }
 
+/* add a column history to the table of distinct patterns, if not
+   already present; returns its index */
+int ih_add_pattern(IndelHistory *ih, char *pattern) {
+  int i, p, nnodes = ih->tree->nnodes;
+  char *key = smalloc((nnodes + 1) * sizeof(char));
+
+  for (i = 0; i < nnodes; i++) key[i] = '0' + pattern[i];
+  key[nnodes] = '\0';
+
+  if ((p = hsh_get_int(ih->pattern_hash, key)) < 0) {
+    if (ih->npatterns == ih->alloc_patterns) {
+      ih->alloc_patterns *= 2;
+      ih->patterns = srealloc(ih->patterns, 
+                              ih->alloc_patterns * sizeof(char*));
+    }
+    p = ih->npatterns++;
+    ih->patterns[p] = smalloc(nnodes * sizeof(char));
+    for (i = 0; i < nnodes; i++) ih->patterns[p][i] = pattern[i];
+    hsh_put_int(ih->pattern_hash, key, p);
+  }
+
+  sfree(key);
+  return p;
+}
+
+/* append len columns with the given pattern to an indel history,
+   extending the last run if it has the same pattern */
+void ih_append_cols(IndelHistory *ih, int pattern, int len) {
+  if (len <= 0) return;
+  if (ih->nruns == 0 || ih->run_pattern[ih->nruns-1] != pattern) {
+    if (ih->nruns == ih->alloc_runs) {
+      ih->alloc_runs *= 2;
+      ih->run_start = srealloc(ih->run_start, ih->alloc_runs * sizeof(int));
+      ih->run_pattern = srealloc(ih->run_pattern, 
+                                 ih->alloc_runs * sizeof(int));
+    }
+    ih->run_start[ih->nruns] = ih->ncols;
+    ih->run_pattern[ih->nruns] = pattern;
+    ih->nruns++;
+  }
+  ih->ncols += len;
+}
+
+/* get indel character of a node in a column, by binary search over
+   runs */
+char ih_get_char(IndelHistory *ih, int node_id, int col) {
+  int lo = 0, hi = ih->nruns - 1, mid;
+  if (col < 0 || col >= ih->ncols)
+    die("ERROR ih_get_char: column %i out of range.\n", col);
+  while (lo < hi) {             /* find last run starting at or before col */
+    mid = (lo + hi + 1) / 2;
+    if (ih->run_start[mid] <= col) lo = mid;
+    else hi = mid - 1;
+  }
+  return ih->patterns[ih->run_pattern[lo]][node_id];
+}
+
 /* create new compact indel history based on alignment and tree */
 CompactIndelHistory *ih_new_compact(TreeNode *tree, int ncols) {
   int i;
@@ -71,119 +141,203 @@ void ih_free_compact(CompactIndelHistory *cih) {
   sfree(cih);
 }
 
-/* create indel history from compact indel history  */
+/* span of columns covered by an indel in a compact indel history,
+   with the order of the indel in the history (used by ih_expand) */
+typedef struct {
+  int start, end, order;
+} IndelSpan;
+
+static int indel_span_compare_start(const void *ptr1, const void *ptr2) {
+  return ((IndelSpan*)ptr1)->start - ((IndelSpan*)ptr2)->start;
+}
+
+static int indel_span_compare_end(const void *ptr1, const void *ptr2) {
+  return ((IndelSpan*)ptr1)->end - ((IndelSpan*)ptr2)->end;
+}
+
+/* create indel history from compact indel history.  Where indels
+   overlap, later indels (in order of node, then order within node)
+   take precedence over earlier ones.  The set of indels spanning a
+   column changes only at indel boundaries, so the history is built by
+   a sweep over the sorted boundaries, with one pattern per segment */
 IndelHistory *ih_expand(CompactIndelHistory *cih) {
-  int i, j, k, node_idx;
-  List *inside = lst_new_ptr(cih->tree->nnodes), 
-    *outside = lst_new_ptr(cih->tree->nnodes);
+  int i, j, k, o, nindels = 0, nactive = 0, pos, next, si, ei;
+  int nnodes = cih->tree->nnodes;
+  IndelHistory *ih = ih_new(cih->tree, 0);
+  List **inside = smalloc(nnodes * sizeof(List*)),
+    **outside = smalloc(nnodes * sizeof(List*)), *mask;
+  IndelSpan *by_start, *by_end;
+  int *order_node, *order_type, *active;
+  char *pattern = smalloc(nnodes * sizeof(char)), c;
   TreeNode *n;
-  IndelHistory *ih = ih_new(cih->tree, cih->ncols);
-  for (i = 0; i < cih->tree->nnodes; i++) {
+
+  for (i = 0; i < nnodes; i++) {
+    inside[i] = lst_new_ptr(nnodes);
+    outside[i] = lst_new_ptr(nnodes);
     tr_partition_nodes(cih->tree, lst_get_ptr(cih->tree->nodes, i), 
-                       inside, outside);
+                       inside[i], outside[i]);
+    nindels += lst_size(cih->indels[i]);
+  }
 
-    for (j = 0; j < lst_size(cih->indels[i]); j++) {
+  by_start = smalloc((nindels + 1) * sizeof(IndelSpan));
+  by_end = smalloc((nindels + 1) * sizeof(IndelSpan));
+  order_node = smalloc((nindels + 1) * sizeof(int));
+  order_type = smalloc((nindels + 1) * sizeof(int));
+  active = smalloc((nindels + 1) * sizeof(int));
+
+  for (i = 0, o = 0; i < nnodes; i++) {
+    for (j = 0; j < lst_size(cih->indels[i]); j++, o++) {
       Indel *indel = lst_get_ptr(cih->indels[i], j);
-      if (indel->type == DEL) {
-        for (node_idx = 0; node_idx < lst_size(inside); node_idx++) {
-          n = lst_get_ptr(inside, node_idx);
-          for (k = 0; k < indel->len; k++)
-            ih->indel_strings[n->id][indel->start + k] = DEL;
-        }
+      by_start[o].start = max(indel->start, 0);
+      by_start[o].end = min(indel->start + indel->len, cih->ncols);
+      by_start[o].order = o;
+      order_node[o] = i;
+      order_type[o] = indel->type;
+    }
+  }
+  /* drop empty spans */
+  for (o = 0, k = 0; o < nindels; o++) 
+    if (by_start[o].end > by_start[o].start) by_start[k++] = by_start[o];
+  nindels = k;
+  for (o = 0; o < nindels; o++) by_end[o] = by_start[o];
+  qsort(by_start, nindels, sizeof(IndelSpan), indel_span_compare_start);
+  qsort(by_end, nindels, sizeof(IndelSpan), indel_span_compare_end);
+
+  si = ei = 0;
+  for (pos = 0; pos < cih->ncols; pos = next) {
+    /* update active indels, keeping them sorted by order */
+    for (; si < nindels && by_start[si].start <= pos; si++) {
+      for (k = nactive++; k > 0 && active[k-1] > by_start[si].order; k--)
+        active[k] = active[k-1];
+      active[k] = by_start[si].order;
+    }
+    for (; ei < nindels && by_end[ei].end <= pos; ei++) {
+      for (k = 0; active[k] != by_end[ei].order; k++);
+      for (nactive--; k < nactive; k++) active[k] = active[k+1];
+    }
+
+    next = cih->ncols;
+    if (si < nindels && by_start[si].start < next) next = by_start[si].start;
+    if (ei < nindels && by_end[ei].end < next) next = by_end[ei].end;
+
+    /* deletions apply to the subtree beneath the branch; insertions
+       to everything outside it */
+    for (i = 0; i < nnodes; i++) pattern[i] = BASE;
+    for (k = 0; k < nactive; k++) {
+      o = active[k];
+      if (order_type[o] == DEL) {
+        mask = inside[order_node[o]];
+        c = DEL;
       }
-      else {                    /* indel->type == INS */
-        for (node_idx = 0; node_idx < lst_size(outside); node_idx++) {
-          n = lst_get_ptr(outside, node_idx);
-          for (k = 0; k < indel->len; k++)
-            ih->indel_strings[n->id][indel->start + k] = INS;
-        }
+      else {                    /* order_type[o] == INS */
+        mask = outside[order_node[o]];
+        c = INS;
+      }
+      for (j = 0; j < lst_size(mask); j++) {
+        n = lst_get_ptr(mask, j);
+        pattern[n->id] = c;
       }
     }
+    ih_append_cols(ih, ih_add_pattern(ih, pattern), next - pos);
   }
 
-  lst_free(inside);
-  lst_free(outside);
+  for (i = 0; i < nnodes; i++) {
+    lst_free(inside[i]);
+    lst_free(outside[i]);
+  }
+  sfree(inside);
+  sfree(outside);
+  sfree(by_start);
+  sfree(by_end);
+  sfree(order_node);
+  sfree(order_type);
+  sfree(active);
+  sfree(pattern);
 
   return ih;
 }
 
+static Indel *new_indel(indel_char type, int start, int len) {
+  Indel *indel = smalloc(sizeof(Indel));
+  indel->type = type;
+  indel->start = start;
+  indel->len = len;
+  return indel;
+}
+
 /* create compact indel history from indel history */
 CompactIndelHistory *ih_compact(IndelHistory *ih) {
-  int i, j, k;
+  int i, j, p, r, col, cur_ins = -1, ins_start = 0;
+  int nnodes = ih->tree->nnodes;
   CompactIndelHistory *cih = ih_new_compact(ih->tree, ih->ncols);
-  int *ins = smalloc(ih->ncols * sizeof(int));
-  List *postorder;
-  Indel *indel;
+  char **explicit_del = smalloc(ih->npatterns * sizeof(char*));
+  int *ins = smalloc(ih->npatterns * sizeof(int)), 
+    *del_start = smalloc(nnodes * sizeof(int));
+  List **ins_indels = smalloc(nnodes * sizeof(List*));
   TreeNode *n;
 
-  /* eliminate all deletions whose parents are deletions -- these are
-     implicit */
-  postorder = tr_postorder(ih->tree);
-  for (i = 0; i < lst_size(postorder); i++) {
-    n = lst_get_ptr(postorder, i);
-    if (n == ih->tree) continue;
-    for (j = 0; j < ih->ncols; j++) 
-      if (ih->indel_strings[n->id][j] == DEL && 
-          ih->indel_strings[n->parent->id][j] == DEL)
-        ih->indel_strings[n->id][j] = BASE + 1;
-  }
+  for (p = 0; p < ih->npatterns; p++) {
+    char *pattern = ih->patterns[p];
+
+    /* deletions whose parents are deletions are implicit */
+    explicit_del[p] = smalloc(nnodes * sizeof(char));
+    for (i = 0; i < nnodes; i++) {
+      n = lst_get_ptr(ih->tree->nodes, i);
+      explicit_del[p][i] = (pattern[i] == DEL && 
+                            (n == ih->tree || pattern[n->parent->id] != DEL));
+    }
 
-  /* find the branch of the single insertion event corresponding
-     to all insertion gaps.  This will be the branch above the node of
-     smallest id that has a base, because ids are assigned in
-     preorder */
-  for (j = 0; j < ih->ncols; j++) {
-    for (i = 0; i < ih->tree->nnodes && ih->indel_strings[i][j] != BASE; )
+    /* find the branch of the single insertion event corresponding
+       to all insertion gaps.  This will be the branch above the node of
+       smallest id that has a base, because ids are assigned in
+       preorder */
+    for (i = 0; i < nnodes && pattern[i] != BASE; ) 
       i++;
-    
-    if (i == 0 || i == ih->tree->nnodes)
-      ins[j] = -1;
-    else 
-      ins[j] = i; 
+    ins[p] = (i == 0 || i == nnodes) ? -1 : i;
   }
 
-  /* summarize remaining deletions with Indel objects */
-  for (i = 0; i < ih->tree->nnodes; i++) {
-    for (j = 0; j < ih->ncols; ) {
-      if (ih->indel_strings[i][j] == DEL) {
-        for (k = 0; 
-             j + k < ih->ncols && 
-               ih->indel_strings[i][j+k] == DEL;
-             k++);
-        indel = smalloc(sizeof(Indel));
-        indel->type = DEL;
-        indel->start = j;
-        indel->len = k;
-        lst_push_ptr(cih->indels[i], indel);
-        j += k;
+  /* summarize deletions and insertions with Indel objects, by
+     scanning the runs; a final pass with col = ncols closes any open
+     indels.  For each node, deletions are listed before insertions */
+  for (i = 0; i < nnodes; i++) {
+    del_start[i] = -1;
+    ins_indels[i] = lst_new_ptr(10);
+  }
+  for (r = 0; r <= ih->nruns; r++) {
+    col = r < ih->nruns ? ih->run_start[r] : ih->ncols;
+    p = r < ih->nruns ? ih->run_pattern[r] : -1;
+
+    for (i = 0; i < nnodes; i++) {
+      if (p >= 0 && explicit_del[p][i]) {
+        if (del_start[i] < 0) del_start[i] = col;
+      }
+      else if (del_start[i] >= 0) {
+        lst_push_ptr(cih->indels[i], 
+                     new_indel(DEL, del_start[i], col - del_start[i]));
+        del_start[i] = -1;
       }
-      else j++;
     }
-  }
 
-  /* summarize insertions with Indel objects */
-  for (j = 0; j < ih->ncols; ) {
-    if (ins[j] > 0) {
-      for (k = 0; 
-           j + k < ih->ncols && ins[j+k] == ins[j];
-           k++);
-      indel = smalloc(sizeof(Indel));
-      indel->type = INS;
-      indel->start = j;
-      indel->len = k;
-      lst_push_ptr(cih->indels[ins[j]], indel);
-      j += k;
-    }
-    else j++;
+    if ((p >= 0 ? ins[p] : -1) != cur_ins) {
+      if (cur_ins > 0)
+        lst_push_ptr(ins_indels[cur_ins], 
+                     new_indel(INS, ins_start, col - ins_start));
+      cur_ins = p >= 0 ? ins[p] : -1;
+      ins_start = col;
+    }
   }
 
-  /* restore deletions */
-  for (i = 1; i < ih->tree->nnodes; i++) {
-    for (j = 0; j < ih->ncols; j++) 
-      if (ih->indel_strings[i][j] == BASE + 1)
-        ih->indel_strings[i][j] = DEL;
+  for (i = 0; i < nnodes; i++) {
+    for (j = 0; j < lst_size(ins_indels[i]); j++)
+      lst_push_ptr(cih->indels[i], lst_get_ptr(ins_indels[i], j));
+    lst_free(ins_indels[i]);
   }
 
+  for (p = 0; p < ih->npatterns; p++)
+    sfree(explicit_del[p]);
+  sfree(explicit_del);
+  sfree(ins_indels);
+  sfree(del_start);
   sfree(ins);
   return cih;
 }
@@ -223,9 +377,10 @@ void ih_print_compact(CompactIndelHistory *cih, FILE *outf, char *msa_name, char
    insertions and '.' characters in place of '-' for deletions.
    Useful for debugging */
 MSA *ih_as_alignment(IndelHistory *ih, MSA *msa) {
-  int i, j, k, s=-1, ins=-1;
+  int i, j, k, r, end, s=-1, ins=-1;
   char **seqs = smalloc(ih->tree->nnodes * sizeof(char*));
   char **names = smalloc(ih->tree->nnodes * sizeof(char*));
+  char *pattern;
   List *inside, *outside;
   TreeNode *n, *n2;
 
@@ -246,49 +401,52 @@ MSA *ih_as_alignment(IndelHistory *ih, MSA *msa) {
         if ((s = msa_get_seq_idx(msa, n->name)) < 0)
           die("ERROR: no match for leaf \"%s\" in alignment.\n", n->name);
       }
-      for (j = 0; j < ih->ncols; j++) {
-        if (ih->indel_strings[i][j] == BASE) 
-          seqs[i][j] = msa == NULL ? 'N' : msa_get_char(msa, s, j);
-        else {
-	  if (ih->indel_strings[i][j] == INS) { /* Insertion */
-	    /* Find the node below the branch where the insertion happened */
-	    for (k = 0; 
-		 k < ih->tree->nnodes && ih->indel_strings[k][j] != BASE;
-		 k++){
-	      if (k == 0 || i == ih->tree->nnodes)
-		ins = -1;
-	      else 
-		ins = k;
-	    }
-	    /* Nodes in the subtree under the node receiving the insertion
-	       will all have a non-insertion char while those in the supertree
-	       will all have an insertion character */
-	    tr_partition_nodes(ih->tree, lst_get_ptr(ih->tree->nodes, ins), 
-			       inside, outside);
-	    for (k = 0; k < lst_size(inside); k++) {
-	      n2 = lst_get_ptr(inside, k);
-	      s = msa_get_seq_idx(msa, n2->name);
-	      seqs[n2->id][j] = (n2->lchild == NULL) ?
-		msa_get_char(msa, s, j) : 'N';
-	    }
-	    for (k = 0; k < lst_size(outside); k++) {
-	      n2 = lst_get_ptr(outside, k);
-	      seqs[n2->id][j] = '^';
-	    }
-	  } else { /* Deletion */
-	    seqs[i][j] = '.';
-	  }
-	}
+      for (r = 0; r < ih->nruns; r++) {
+        pattern = ih->patterns[ih->run_pattern[r]];
+        end = ih->run_start[r] + ih_run_len(ih, r);
+        for (j = ih->run_start[r]; j < end; j++) {
+          if (pattern[i] == BASE) 
+            seqs[i][j] = msa == NULL ? 'N' : msa_get_char(msa, s, j);
+          else if (pattern[i] == INS) { /* Insertion */
+            /* Find the node below the branch where the insertion happened */
+            for (k = 0; k < ih->tree->nnodes && pattern[k] != BASE; k++) {
+              if (k == 0 || i == ih->tree->nnodes)
+                ins = -1;
+              else 
+                ins = k;
+            }
+            /* Nodes in the subtree under the node receiving the insertion
+               will all have a non-insertion char while those in the supertree
+               will all have an insertion character */
+            tr_partition_nodes(ih->tree, lst_get_ptr(ih->tree->nodes, ins), 
+                               inside, outside);
+            for (k = 0; k < lst_size(inside); k++) {
+              n2 = lst_get_ptr(inside, k);
+              s = msa_get_seq_idx(msa, n2->name);
+              seqs[n2->id][j] = (n2->lchild == NULL) ?
+                msa_get_char(msa, s, j) : 'N';
+            }
+            for (k = 0; k < lst_size(outside); k++) {
+              n2 = lst_get_ptr(outside, k);
+              seqs[n2->id][j] = '^';
+            }
+          } 
+          else                  /* Deletion */
+            seqs[i][j] = '.';
+        }
       }
     }
 
-
     else {                      /* ancestor */
-      for (j = 0; j < ih->ncols; j++) {
-        if (ih->indel_strings[i][j] == BASE) 
-          seqs[i][j] = 'N';
-        else
-          seqs[i][j] = ih->indel_strings[i][j] == INS ? '^' : '.';
+      for (r = 0; r < ih->nruns; r++) {
+        pattern = ih->patterns[ih->run_pattern[r]];
+        end = ih->run_start[r] + ih_run_len(ih, r);
+        for (j = ih->run_start[r]; j < end; j++) {
+          if (pattern[i] == BASE) 
+            seqs[i][j] = 'N';
+          else
+            seqs[i][j] = pattern[i] == INS ? '^' : '.';
+        }
       }
     }
 
@@ -372,15 +530,21 @@ IndelHistory *ih_new_from_file(FILE* inf) {
 } 
 
 /* extract an indel history from an augmented alignment, including
-   sequences for ancestral nodes as well as leaves */
+   sequences for ancestral nodes as well as leaves.  The history of a
+   column depends only on which sequences have gaps, so it is derived
+   once for each distinct pattern of gaps */
 IndelHistory *ih_extract_from_alignment(MSA *msa, TreeNode *tree) {
-  int i, j;
+  int i, j, p = -1;
   TreeNode *n;
   List *preorder;
-  IndelHistory *ih = ih_new(tree, msa->length);
-  int *done = smalloc(tree->nnodes * sizeof(int));
+  IndelHistory *ih = ih_new(tree, 0);
+  int *done = smalloc(tree->nnodes * sizeof(int)),
+    *seq_to_node = smalloc(msa->nseqs * sizeof(int));
+  char *key = smalloc((msa->nseqs + 1) * sizeof(char)),
+    *prev_key = smalloc((msa->nseqs + 1) * sizeof(char)),
+    *pattern = smalloc(tree->nnodes * sizeof(char));
+  Hashtable *key_to_pattern = hsh_new(1000);
 
-  /* first record all gaps as insertions */
   for (i = 0; i < tree->nnodes; i++) done[i] = FALSE;
   for (i = 0; i < msa->nseqs; i++) {
     n = tr_get_node(tree, msa->names[i]);
@@ -388,12 +552,7 @@ IndelHistory *ih_extract_from_alignment(MSA *msa, TreeNode *tree) {
     if (n == NULL)
       die("ERROR: no match for sequence \"%s\" in tree.\n", msa->names[i]);    
 
-    for (j = 0; j < msa->length; j++) {
-      char c = msa_get_char(msa, i, j);
-      if (c == GAP_CHAR || c == '^' || c == '.') 
-        ih->indel_strings[n->id][j] = INS;
-    }
-
+    seq_to_node[i] = n->id;
     done[n->id] = TRUE;
   }
 
@@ -403,47 +562,72 @@ IndelHistory *ih_extract_from_alignment(MSA *msa, TreeNode *tree) {
       die("ERROR: no match for node \"%s\" in alignment.\n", 
           ((TreeNode*)lst_get_ptr(tree->nodes, i))->name);
 
-  /* now change gaps that derive from bases to deletions */
   preorder = tr_preorder(tree);
-  for (i = 0; i < lst_size(preorder); i++) {
-    n = lst_get_ptr(preorder, i);
-    if (n == tree) continue;
-    for (j = 0; j < msa->length; j++) {
-      if (ih->indel_strings[n->id][j] == INS && 
-          ih->indel_strings[n->parent->id][j] != INS)
-        ih->indel_strings[n->id][j] = DEL;
-
-      /* also check for violation of rule that bases cannot derive
-         from deletions */
-      else if (ih->indel_strings[n->id][j] == BASE && 
-               ih->indel_strings[n->parent->id][j] == DEL)
-        die("ERROR: illegal history in column %d; deletions cannot re-emerge as aligned bases.\n", j);
+  key[msa->nseqs] = '\0';
+  prev_key[0] = '\0';
+  for (j = 0; j < msa->length; j++) {
+    for (i = 0; i < msa->nseqs; i++) {
+      char c = msa_get_char(msa, i, j);
+      key[i] = (c == GAP_CHAR || c == '^' || c == '.') ? 'g' : 'b';
     }
-  }
 
-  /* special case: columns of all indels are handled as deletions */
-  for (j = 0; j < msa->length; j++) {
-    int has_bases = FALSE;
-    for (i = 0; !has_bases && i < tree->nnodes; i++) 
-      if (ih->indel_strings[i][j] == BASE) has_bases = TRUE;
-    if (!has_bases)
+    if (strcmp(key, prev_key) != 0 &&
+        (p = hsh_get_int(key_to_pattern, key)) < 0) {
+      int has_bases = FALSE;
+
+      /* first record all gaps as insertions */
+      for (i = 0; i < tree->nnodes; i++) pattern[i] = BASE;
+      for (i = 0; i < msa->nseqs; i++) 
+        if (key[i] == 'g') pattern[seq_to_node[i]] = INS;
+
+      /* now change gaps that derive from bases to deletions */
+      for (i = 0; i < lst_size(preorder); i++) {
+        n = lst_get_ptr(preorder, i);
+        if (n == tree) continue;
+        if (pattern[n->id] == INS && pattern[n->parent->id] != INS)
+          pattern[n->id] = DEL;
+
+        /* also check for violation of rule that bases cannot derive
+           from deletions */
+        else if (pattern[n->id] == BASE && pattern[n->parent->id] == DEL)
+          die("ERROR: illegal history in column %d; deletions cannot re-emerge as aligned bases.\n", j);
+      }
+
+      /* special case: columns of all indels are handled as deletions */
       for (i = 0; !has_bases && i < tree->nnodes; i++) 
-        ih->indel_strings[i][j] = DEL;
+        if (pattern[i] == BASE) has_bases = TRUE;
+      if (!has_bases)
+        for (i = 0; i < tree->nnodes; i++) 
+          pattern[i] = DEL;
+
+      p = ih_add_pattern(ih, pattern);
+      hsh_put_int(key_to_pattern, key, p);
+    }
+
+    strcpy(prev_key, key);
+    ih_append_cols(ih, p, 1);
   }
 
+  hsh_free(key_to_pattern);
+  sfree(key);
+  sfree(prev_key);
+  sfree(pattern);
+  sfree(seq_to_node);
   sfree(done);
   return ih;
 }
 
 /* reconstruct an indel history by parsimony from an alignment, given
-   a tree */
+   a tree.  The history of a column tuple depends only on which
+   sequences have gaps, missing data, or bases, so it is reconstructed
+   only for the first tuple with each such pattern */
 IndelHistory *ih_reconstruct(MSA *msa, TreeNode *tree) {
   int s, tup, i, j;
   TreeNode *n, *lca;
   char c;
   typedef enum {IGNORE, GAP, OBS_BASE, MISSING, AMBIG} label_type;
   List *postorder;
-  IndelHistory *ih = ih_new(tree, msa->length);
+  IndelHistory *ih = ih_new(tree, 0);
 
   label_type *label = smalloc(tree->nnodes * sizeof(label_type));
   List *inside = lst_new_ptr(tree->nnodes), 
@@ -451,11 +635,17 @@ IndelHistory *ih_reconstruct(MSA *msa, TreeNode *tree) {
     *ambig_cases = lst_new_ptr(tree->nnodes);
   int *seq_to_leaf = smalloc(msa->nseqs * sizeof(int)),
     *leaf_to_seq = smalloc(tree->nnodes * sizeof(int));
-  char **tup_hist = smalloc(msa->ss->ntuples * sizeof(void*));
+  char **tup_hist, *key = smalloc((msa->nseqs + 1) * sizeof(char));
+  int *tup_rep, *tup_pat;
+  Hashtable *key_to_tup = hsh_new(1000);
 
   if (!(msa->ss != NULL && msa->ss->tuple_idx != NULL))
     die("ERROR ih_reconstruct: Need ordered sufficient statistics\n");
 
+  tup_hist = smalloc(msa->ss->ntuples * sizeof(void*));
+  tup_rep = smalloc(msa->ss->ntuples * sizeof(int));
+  tup_pat = smalloc(msa->ss->ntuples * sizeof(int));
+
   /* build mappings between seqs and leaf indices in tree */
   for (s = 0; s < msa->nseqs; s++) {
     n = tr_get_node(tree, msa->names[s]);
@@ -480,6 +670,20 @@ IndelHistory *ih_reconstruct(MSA *msa, TreeNode *tree) {
       skip_root = FALSE;
     checkInterruptN(tup, 1000);
 
+    /* reuse the history of an earlier tuple with the same pattern of
+       gaps and missing data, if there is one */
+    for (s = 0; s < msa->nseqs; s++) {
+      c = ss_get_char_tuple(msa, tup, s, 0);
+      key[s] = c == GAP_CHAR ? 'g' : (msa->is_missing[(int)c] ? 'm' : 'b');
+    }
+    key[msa->nseqs] = '\0';
+    if ((tup_rep[tup] = hsh_get_int(key_to_tup, key)) >= 0) {
+      tup_hist[tup] = NULL;
+      continue;
+    }
+    tup_rep[tup] = tup;
+    hsh_put_int(key_to_tup, key, tup);
+
     /* initialize tuple history to all bases */
     tup_hist[tup] = smalloc(tree->nnodes * sizeof(char));
     for (i = 0; i < tree->nnodes; i++) tup_hist[tup][i] = BASE;
@@ -643,26 +847,31 @@ IndelHistory *ih_reconstruct(MSA *msa, TreeNode *tree) {
   }
 
   /* finally, fill out indel history using tuple histories */
-  for (i = 0; i < tree->nnodes; i++) {
-    for (j = 0; j < msa->length; j++) {
-      if (tup_hist[msa->ss->tuple_idx[j]][i] != BASE) {
-	if (leaf_to_seq[i] >= 0) 
-        {
-	  c = ss_get_char_tuple(msa, msa->ss->tuple_idx[j], leaf_to_seq[i], 0);
-	  if (!(c==GAP_CHAR || msa->is_missing[(int)c])) die("ERROR reconstructing history in indel_history.c \n");
-        }
-        ih->indel_strings[i][j] = tup_hist[msa->ss->tuple_idx[j]][i];
+  for (tup = 0; tup < msa->ss->ntuples; tup++) {
+    if (tup_rep[tup] != tup) continue;
+    for (i = 0; i < tree->nnodes; i++) {
+      if (tup_hist[tup][i] != BASE && leaf_to_seq[i] >= 0) {
+        c = ss_get_char_tuple(msa, tup, leaf_to_seq[i], 0);
+        if (!(c==GAP_CHAR || msa->is_missing[(int)c])) die("ERROR reconstructing history in indel_history.c \n");
       }
     }
+    tup_pat[tup] = ih_add_pattern(ih, tup_hist[tup]);
   }
+  for (j = 0; j < msa->length; j++)
+    ih_append_cols(ih, tup_pat[tup_rep[msa->ss->tuple_idx[j]]], 1);
 
   for (tup = 0; tup < msa->ss->ntuples; tup++)
     sfree(tup_hist[tup]);
   sfree(tup_hist);
+  sfree(tup_rep);
+  sfree(tup_pat);
+  sfree(key);
+  hsh_free(key_to_tup);
   lst_free(inside);
   lst_free(outside);
   lst_free(ambig_cases);
   sfree(seq_to_leaf);
+  sfree(leaf_to_seq);
   sfree(label);
 
   return ih;
@@ -145,61 +145,85 @@ void im_set(IndelModel *im, double *alpha, double *beta, double *tau,
 }
 
 static PHAST_INLINE
-col_type get_col_type(IndelHistory *ih, int child_id, int parent_id, int col) {
-  if (ih->indel_strings[parent_id][col] == BASE && 
-      ih->indel_strings[child_id][col] == BASE)
+col_type get_col_type(char *pattern, int child_id, int parent_id) {
+  if (pattern[parent_id] == BASE && pattern[child_id] == BASE)
     return MATCH;
-  else if (ih->indel_strings[parent_id][col] == INS && 
-           ih->indel_strings[child_id][col] == BASE)
+  else if (pattern[parent_id] == INS && pattern[child_id] == BASE)
     return CHILDINS;
-  else if (ih->indel_strings[parent_id][col] == BASE && 
-           ih->indel_strings[child_id][col] == DEL)
+  else if (pattern[parent_id] == BASE && pattern[child_id] == DEL)
     return CHILDDEL;
-  else if (ih->indel_strings[parent_id][col] == INS && 
-           ih->indel_strings[child_id][col] == INS)
+  else if (pattern[parent_id] == INS && pattern[child_id] == INS)
     return SKIP;
-  else if (ih->indel_strings[parent_id][col] == DEL && 
-           ih->indel_strings[child_id][col] == DEL)
+  else if (pattern[parent_id] == DEL && pattern[child_id] == DEL)
     return SKIP;
   else 
     return ERROR;
 }
 
+/* column type on the branch above child_id for each distinct column
+   history (pattern) of an indel history; columns need only be
+   classified once per pattern rather than once per column */
+static col_type *get_pattern_types(IndelHistory *ih, int child_id) {
+  int p;
+  int parent_id = ((TreeNode*)lst_get_ptr(ih->tree->nodes, child_id))->parent->id;
+  col_type *types = smalloc((ih->npatterns + 1) * sizeof(col_type));
+  for (p = 0; p < ih->npatterns; p++)
+    types[p] = get_col_type(ih->patterns[p], child_id, parent_id);
+  return types;
+}
+
+/* print the history of an erroneous column to stderr */
+static void print_column_error(IndelHistory *ih, int col) {
+  int j;
+  char c;
+  fprintf(stderr, "ERROR at column %d of indel history:\n", col);
+  for (j = 0; j < ih->tree->nnodes; j++) {
+    if (ih_get_char(ih, j, col) == BASE)
+      c = 'b';
+    else if (ih_get_char(ih, j, col) == INS)
+      c = '^';
+    else
+      c = '.';
+    fprintf(stderr, "%25s %c\n", 
+            ((TreeNode*)lst_get_ptr(ih->tree->nodes, j))->name, c);
+  }
+}
+
 double im_branch_column_logl(IndelHistory *ih, BranchIndelModel *bim, 
                              int child, double *col_logl) {
-  int i;
+  int r, i, end;
   col_type this_type, last_type = SKIP;
   double logl = 0;
-  int parent_id = ((TreeNode*)lst_get_ptr(ih->tree->nodes, child))->parent->id;
-
-  for (i = 0; i < ih->ncols; i++) {
-    last_type = get_col_type(ih, child, parent_id, i);
-    if (last_type == SKIP) 
-      col_logl[i] = 0;
-    else {
-      col_logl[i] = vec_get(bim->beg_log_probs, last_type);
-      break;
-    }
-  }
-  logl = col_logl[i];
-  i++;
+  col_type *types = get_pattern_types(ih, child);
+
+  /* all columns of a run have the same type, so only the first can
+     involve a change of state */
+  for (r = 0; r < ih->nruns; r++) {
+    this_type = types[ih->run_pattern[r]];
+    i = ih->run_start[r];
+    end = i + ih_run_len(ih, r);
 
-  for (; i < ih->ncols; i++) {
-    this_type = get_col_type(ih, child, parent_id, i);
-    
     if (this_type == ERROR)
       die("ERROR im_branch_column_logl\n");
 
     if (this_type == SKIP) {
-      col_logl[i] = 0;
+      for (; i < end; i++) col_logl[i] = 0;
       continue;
     }
 
-    col_logl[i] = bim->log_probs->data[last_type][this_type];
+    if (last_type == SKIP)      /* first non-skipped column */
+      col_logl[i] = vec_get(bim->beg_log_probs, this_type);
+    else
+      col_logl[i] = bim->log_probs->data[last_type][this_type];
     logl += col_logl[i];
+    for (i++; i < end; i++) {
+      col_logl[i] = bim->log_probs->data[this_type][this_type];
+      logl += col_logl[i];
+    }
     last_type = this_type;
   }
 
+  sfree(types);
   return logl;
 }
 
@@ -247,43 +271,37 @@ double im_likelihood(IndelModel *im, IndelSuffStats *iss) {
 }
 
 BranchIndelSuffStats *im_suff_stats_branch(IndelHistory *ih, int child_id) {
-  int i, j;
-  char c;
+  int r, len;
   col_type this_type, last_type = SKIP;
-  int parent_id = ((TreeNode*)lst_get_ptr(ih->tree->nodes, child_id))->parent->id;
+  col_type *types = get_pattern_types(ih, child_id);
   BranchIndelSuffStats *ss = smalloc(sizeof(BranchIndelSuffStats));
   ss->trans_counts = mat_new(NINDEL_STATES, NINDEL_STATES);
   ss->beg_counts = vec_new(NINDEL_STATES);
   mat_zero(ss->trans_counts);
   vec_zero(ss->beg_counts);
 
-  for (i = 0; last_type == SKIP && i < ih->ncols; i++)
-    last_type = get_col_type(ih, child_id, parent_id, i);
-  ss->beg_counts->data[last_type]++;
-  for (; i < ih->ncols; i++) {
-    this_type = get_col_type(ih, child_id, parent_id, i);
+  /* each run contributes one transition into its type (or the
+     beginning count) and len-1 self-transitions */
+  for (r = 0; r < ih->nruns; r++) {
+    this_type = types[ih->run_pattern[r]];
+    len = ih_run_len(ih, r);
 
     if (this_type == ERROR) {
-      fprintf(stderr, "ERROR at column %d of indel history:\n", i);
-      for (j = 0; j < ih->tree->nnodes; j++) {
-        if (ih->indel_strings[j][i] == BASE)
-          c = 'b';
-        else if (ih->indel_strings[j][i] == INS)
-          c = '^';
-        else
-          c = '.';
-        fprintf(stderr, "%25s %c\n", 
-                ((TreeNode*)lst_get_ptr(ih->tree->nodes, j))->name, c);
-      }
+      print_column_error(ih, ih->run_start[r]);
       die("ERROR im_suff_stats_branch\n");
     }
 
     else if (this_type == SKIP) continue;
 
-    ss->trans_counts->data[last_type][this_type]++;
+    if (last_type == SKIP)
+      ss->beg_counts->data[this_type]++;
+    else
+      ss->trans_counts->data[last_type][this_type]++;
+    ss->trans_counts->data[this_type][this_type] += len - 1;
     last_type = this_type;
   }
 
+  sfree(types);
   return ss;  
 }
 
@@ -422,54 +440,47 @@ void im_estimate(IndelModel *im, IndelHistory *ih, IndelSuffStats *ss,
    the specified category */
 BranchIndelSuffStats *im_suff_stats_branch_cat(IndelHistory *ih, int child_id,
                                                int *categories, int do_cat) {
-  int i, j;
-  char c;
-  col_type this_type=SKIP, last_type;
-  int parent_id = ((TreeNode*)lst_get_ptr(ih->tree->nodes, child_id))->parent->id;
+  int r, i, end, started = FALSE;
+  col_type this_type, last_type = SKIP;
+  col_type *types = get_pattern_types(ih, child_id);
   BranchIndelSuffStats *ss = smalloc(sizeof(BranchIndelSuffStats));
   ss->trans_counts = mat_new(NINDEL_STATES, NINDEL_STATES);
   ss->beg_counts = vec_new(NINDEL_STATES);
   mat_zero(ss->trans_counts);
   vec_zero(ss->beg_counts);
 
-  /* scan to first non-SKIP in category of interest */
-  for (i = 0; i < ih->ncols; i++) {
-    if (categories[i] != do_cat) continue;
-    if ((this_type = get_col_type(ih, child_id, parent_id, i)) != SKIP)
-      break;
-  }
-  if (i == ih->ncols) return ss;
-
-  ss->beg_counts->data[this_type]++;
-  last_type = this_type;
-  for (; i < ih->ncols; i++) {
-    checkInterruptN(i, 1000);
-    this_type = get_col_type(ih, child_id, parent_id, i);
+  for (r = 0; r < ih->nruns; r++) {
+    checkInterruptN(r, 1000);
+    this_type = types[ih->run_pattern[r]];
+    end = ih->run_start[r] + ih_run_len(ih, r);
+
+    for (i = ih->run_start[r]; i < end; i++) {
+      /* scan to first non-SKIP in category of interest */
+      if (!started) {
+        if (categories[i] != do_cat || this_type == SKIP) continue;
+        if (this_type != ERROR) {
+          ss->beg_counts->data[this_type]++;
+          last_type = this_type;
+        }
+        started = TRUE;
+      }
 
-    if (this_type == ERROR) {
-      fprintf(stderr, "ERROR at column %d of indel history:\n", i);
-      for (j = 0; j < ih->tree->nnodes; j++) {
-        if (ih->indel_strings[j][i] == BASE)
-          c = 'b';
-        else if (ih->indel_strings[j][i] == INS)
-          c = '^';
-        else
-          c = '.';
-        fprintf(stderr, "%25s %c\n", 
-                ((TreeNode*)lst_get_ptr(ih->tree->nodes, j))->name, c);
+      if (this_type == ERROR) {
+        print_column_error(ih, i);
+        die("ERROR im_suff_stats_branch_cat\n");
       }
-      die("ERROR im_suff_stats_branch_cat\n");
-    }
-    else if (this_type == SKIP) continue;
+      else if (this_type == SKIP) continue;
 
-    if (categories[i] == do_cat) 
-      ss->trans_counts->data[last_type][this_type]++;
+      if (categories[i] == do_cat) 
+        ss->trans_counts->data[last_type][this_type]++;
 
-    last_type = this_type;      /* need to set last_type even if not
+      last_type = this_type;    /* need to set last_type even if not
                                    in category; will use if next site
                                    is in category  */
+    }
   }
 
+  sfree(types);
   return ss;  
 }
 
@@ -18,6 +18,7 @@
 #include <dgamma.h>
 #include <tree_likelihoods.h>
 #include <maf.h>
+#include <wig.h>
 #include "phast_cons.h"
 
 
@@ -73,14 +74,441 @@ struct phastCons_struct *phastCons_struct_new(int rphast) {
   p->extrapolate_tree = NULL;
   p->cm = NULL;
   p->compute_likelihood = FALSE;
+  p->single_prec = FALSE;
+  p->no_accel = FALSE;
   p->post_probs_f = rphast ? NULL : stdout;
+  p->bigwig_fname = NULL;
   p->results_f = rphast ? stdout : stderr;
   p->progress_f = rphast ? stdout : stderr;
+  p->em_stats_f = NULL;
+  p->em_merge = NULL;
   p->results = rphast ? lol_new(2) : NULL;
   return p;
 }
 
 
+/* Distributed EM.  With --em-stats, phastCons performs a single E
+   step on its alignment and writes the expected sufficient statistics
+   to a file: the total log likelihood, the expected numbers of
+   transitions between states, and for each distinct alignment column
+   (tuple), the expected number of times it is emitted by each state.
+   Because these statistics are additive across independent portions
+   of the data, an M step on the sum over chunks (--em-merge)
+   maximizes the same expected log likelihood as an M step on the
+   chunks jointly.  The caller iterates E and M steps until the lnL
+   converges (see example 7 in phastCons.help_src).  The iterates are
+   those of plain EM: there is no SQUAREM extrapolation, and the BFGS
+   approximation to the Hessian used for the tree models is restarted
+   from the identity in each M step, so the path (but not the
+   maximum) differs from that of a single run.  Tuples are stored as
+   raw column strings, so chunks need not contain the same species;
+   species absent from a chunk are treated as missing data. */
+
+#define EM_STATS_HEADER "##PHASTCONS_EM_STATS"
+
+static int em_stats_obs_idx(void *data, int sample, phast_pos position) {
+  MSA *msa = (MSA*)data;
+  if (sample == -1 || position == -1) 
+    return msa->ss->ntuples;
+  return msa->ss->tuple_idx[position];
+}
+
+/* Run E step for two-state phylo-HMM (no indel model) and write
+   expected sufficient statistics to F.  Returns ln likelihood */
+static double write_em_stats(FILE *F, PhyloHmm *phmm, MSA *msa) {
+  double **A, **E, lnl;
+  int i, j, k, nstates = phmm->hmm->nstates;
+
+  A = smalloc(nstates * sizeof(double*));
+  E = smalloc(nstates * sizeof(double*));
+  for (k = 0; k < nstates; k++) {
+    A[k] = smalloc(nstates * sizeof(double));
+    E[k] = smalloc(max(msa->ss->ntuples, 1) * sizeof(double));
+  }
+
+  lnl = hmm_em_expected_counts(phmm->hmm, phmm->mods, msa, 1, 
+                               &phmm->alloc_len, NULL, em_stats_obs_idx,
+                               phmm->emissions, 1, A, E) * log(2);
+
+  fprintf(F, "%s\n", EM_STATS_HEADER);
+  fprintf(F, "LNL: %.17g\n", lnl);
+  fprintf(F, "NAMES: ");
+  for (j = 0; j < msa->nseqs; j++)
+    fprintf(F, "%s%s", msa->names[j], j < msa->nseqs - 1 ? "," : "\n");
+  fprintf(F, "ALPHABET: %s\n", msa->alphabet);
+  fprintf(F, "TUPLE_SIZE: %d\n", msa->ss->tuple_size);
+  fprintf(F, "TRANSITION_COUNTS: ");
+  for (k = 0; k < nstates; k++)
+    for (j = 0; j < nstates; j++)
+      fprintf(F, "%.17g%s", A[k][j], 
+              k == nstates - 1 && j == nstates - 1 ? "\n" : ",");
+  fprintf(F, "NTUPLES: %d\n", msa->ss->ntuples);
+  for (i = 0; i < msa->ss->ntuples; i++) {
+    fprintf(F, "%.*s", msa->nseqs * msa->ss->tuple_size, 
+            msa->ss->col_tuples[i]);
+    for (k = 0; k < nstates; k++)
+      fprintf(F, "\t%.17g", E[k][i]);
+    fprintf(F, "\n");
+  }
+  fflush(F);
+
+  for (k = 0; k < nstates; k++) {
+    sfree(A[k]);
+    sfree(E[k]);
+  }
+  sfree(A);
+  sfree(E);
+  return lnl;
+}
+
+/* header of a file written by write_em_stats */
+typedef struct {
+  double lnl;
+  double A[2][2];
+  List *names;
+  char *alphabet;
+  int tuple_size, ntuples;
+} EmStatsHeader;
+
+/* Read header from file written by write_em_stats, leaving F
+   positioned at the first tuple */
+static void read_em_stats_header(FILE *F, char *fname, EmStatsHeader *h) {
+  String *line = str_new(STR_LONG_LEN);
+  List *l;
+  int i, done = FALSE;
+
+  h->names = NULL;
+  h->alphabet = NULL;
+  h->tuple_size = h->ntuples = -1;
+  h->lnl = NEGINFTY;
+
+  if (str_readline(line, F) == EOF || 
+      !str_starts_with_charstr(line, EM_STATS_HEADER))
+    die("ERROR: %s is not a file of EM statistics written with --em-stats.\n",
+        fname);
+
+  while (!done && str_readline(line, F) != EOF) {
+    str_trim(line);
+    if (line->length == 0) continue;
+    if (str_starts_with_charstr(line, "LNL:"))
+      h->lnl = atof(&line->chars[4]);
+    else if (str_starts_with_charstr(line, "NAMES:")) {
+      String *tmp = str_new_charstr(&line->chars[6]);
+      str_double_trim(tmp);
+      h->names = get_arg_list(tmp->chars);
+      str_free(tmp);
+    }
+    else if (str_starts_with_charstr(line, "ALPHABET:")) {
+      String *tmp = str_new_charstr(&line->chars[9]);
+      str_double_trim(tmp);
+      h->alphabet = copy_charstr(tmp->chars);
+      str_free(tmp);
+    }
+    else if (str_starts_with_charstr(line, "TUPLE_SIZE:"))
+      h->tuple_size = atoi(&line->chars[11]);
+    else if (str_starts_with_charstr(line, "TRANSITION_COUNTS:")) {
+      l = get_arg_list_dbl(&line->chars[18]);
+      if (lst_size(l) != 4)
+        die("ERROR: bad TRANSITION_COUNTS in %s (two-state model required).\n",
+            fname);
+      for (i = 0; i < 4; i++)
+        h->A[i/2][i%2] = lst_get_dbl(l, i);
+      lst_free(l);
+    }
+    else if (str_starts_with_charstr(line, "NTUPLES:")) {
+      h->ntuples = atoi(&line->chars[8]);
+      done = TRUE;
+    }
+  }
+
+  if (h->names == NULL || h->alphabet == NULL || h->tuple_size <= 0 || 
+      h->ntuples < 0 || h->lnl == NEGINFTY)
+    die("ERROR: incomplete header in %s.\n", fname);
+
+  str_free(line);
+}
+
+static void free_em_stats_header(EmStatsHeader *h) {
+  lst_free_strings(h->names);
+  lst_free(h->names);
+  sfree(h->alphabet);
+}
+
+/* Sum sufficient statistics over the files in p->em_merge and perform
+   an M step for the two-state phylo-HMM (see comment above) */
+int phastCons_em_merge(struct phastCons_struct *p) {
+  int i, j, k, f, nseqs, tuple_size = -1, *seqmap, idx, ntotal = 0;
+  int estim_transitions = p->estim_transitions, estim_trees = p->estim_trees,
+    estim_rho = p->estim_rho, quiet = (p->results_f == NULL);
+  double lnl = 0, mu = p->mu, nu = p->nu, rho = p->rho, gamma = p->gamma;
+  double **A, e[2];
+  char *alphabet = NULL, *key;
+  Hashtable *name_hash, *tuple_hash;
+  List *names = lst_new_ptr(100), *fields = lst_new_ptr(3);
+  String *line = str_new(STR_LONG_LEN);
+  EmStatsHeader h;
+  MSA *msa;
+  HMM *hmm;
+  CategoryMap *cm;
+  PhyloHmm *phmm;
+  TreeModel **mod;
+  FILE *F;
+
+  if (!p->two_state || p->indels || p->FC)
+    die("ERROR: --em-merge can only be used with the default two-state HMM, and not with --indels.\n");
+  if (p->set_transitions && (gamma != -1 || p->omega != -1))
+    die("ERROR: --transitions and --target-coverage/--expected-length cannot be used together.\n");
+  if (p->omega != -1 && gamma == -1)
+    die("ERROR: --expected-length requires --target-coverage.\n");
+  if (p->nummod < 1 || p->nummod > 2)
+    die("ERROR: must specify either one or two tree models with default two-state model.\n");
+  if (!estim_transitions && !estim_trees && !estim_rho)
+    die("ERROR: nothing to estimate with --em-merge.\n");
+
+  A = smalloc(2 * sizeof(double*));
+  for (k = 0; k < 2; k++) {
+    A[k] = smalloc(2 * sizeof(double));
+    A[k][0] = A[k][1] = 0;
+  }
+
+  /* first pass: sum log likelihoods and transition counts, and
+     collect union of species names */
+  name_hash = hsh_new(100);
+  for (f = 0; f < lst_size(p->em_merge); f++) {
+    char *fname = ((String*)lst_get_ptr(p->em_merge, f))->chars;
+    F = phast_fopen(fname, "r");
+    read_em_stats_header(F, fname, &h);
+    phast_fclose(F);
+    if (alphabet == NULL) {
+      alphabet = copy_charstr(h.alphabet);
+      tuple_size = h.tuple_size;
+    }
+    else if (strcmp(alphabet, h.alphabet) != 0 || tuple_size != h.tuple_size)
+      die("ERROR: alphabet or tuple size of %s does not match that of %s.\n",
+          fname, ((String*)lst_get_ptr(p->em_merge, 0))->chars);
+    lnl += h.lnl;
+    for (k = 0; k < 2; k++)
+      for (j = 0; j < 2; j++)
+        A[k][j] += h.A[k][j];
+    for (j = 0; j < lst_size(h.names); j++) {
+      char *name = ((String*)lst_get_ptr(h.names, j))->chars;
+      if (hsh_get_int(name_hash, name) == -1) {
+        hsh_put_int(name_hash, name, lst_size(names));
+        lst_push_ptr(names, copy_charstr(name));
+      }
+    }
+    ntotal += h.ntuples;
+    free_em_stats_header(&h);
+  }
+
+  /* second pass: pool tuples, summing expected counts.  Sequences
+     absent from a file are represented by missing data */
+  nseqs = lst_size(names);
+  msa = msa_new(NULL, smalloc(nseqs * sizeof(char*)), nseqs, 0, alphabet);
+  for (j = 0; j < nseqs; j++)
+    msa->names[j] = lst_get_ptr(names, j);
+  msa->ncats = 1;
+  ss_new(msa, tuple_size, max(ntotal, 1), TRUE, FALSE);
+  tuple_hash = hsh_new(max(ntotal, 1000));
+  key = smalloc((nseqs * tuple_size + 1) * sizeof(char));
+  key[nseqs * tuple_size] = '\0';
+  seqmap = smalloc(nseqs * sizeof(int));
+
+  for (f = 0; f < lst_size(p->em_merge); f++) {
+    char *fname = ((String*)lst_get_ptr(p->em_merge, f))->chars;
+    int fseqs;
+    F = phast_fopen(fname, "r");
+    read_em_stats_header(F, fname, &h);
+    fseqs = lst_size(h.names);
+    for (j = 0; j < fseqs; j++)
+      seqmap[j] = hsh_get_int(name_hash, 
+                              ((String*)lst_get_ptr(h.names, j))->chars);
+    for (i = 0; i < h.ntuples; i++) {
+      checkInterruptN(i, 10000);
+      if (str_readline(line, F) == EOF)
+        die("ERROR: premature end of file in %s.\n", fname);
+      str_trim(line);
+      str_split(line, NULL, fields);
+      if (lst_size(fields) != 3 || 
+          ((String*)lst_get_ptr(fields, 0))->length != fseqs * tuple_size ||
+          str_as_dbl(lst_get_ptr(fields, 1), &e[0]) != 0 ||
+          str_as_dbl(lst_get_ptr(fields, 2), &e[1]) != 0)
+        die("ERROR: bad line in %s: '%s'.\n", fname, line->chars);
+
+      memset(key, msa->missing[0], nseqs * tuple_size);
+      for (j = 0; j < fseqs; j++)
+        strncpy(&key[seqmap[j] * tuple_size], 
+                &((String*)lst_get_ptr(fields, 0))->chars[j * tuple_size],
+                tuple_size);
+      lst_free_strings(fields);
+
+      if ((idx = hsh_get_int(tuple_hash, key)) == -1) {
+        idx = msa->ss->ntuples++;
+        msa->ss->col_tuples[idx] = copy_charstr(key);
+        hsh_put_int(tuple_hash, key, idx);
+      }
+      msa->ss->cat_counts[0][idx] += e[0];
+      msa->ss->cat_counts[1][idx] += e[1];
+      msa->ss->counts[idx] += e[0] + e[1];
+    }
+    phast_fclose(F);
+    free_em_stats_header(&h);
+  }
+  hsh_free(tuple_hash);
+  hsh_free(name_hash);
+  sfree(key);
+  sfree(seqmap);
+  sfree(alphabet);
+
+  if (!quiet)
+    fprintf(p->results_f, "Pooled %d distinct tuples from %d files (lnL = %.4f)...\n",
+            msa->ss->ntuples, lst_size(p->em_merge), lnl);
+
+  /* set up tree models as in phastCons.  The last model given is the
+     starting point for estimation (with rho); if two are given, as
+     written by a previous M step, the first is ignored */
+  for (i = 0; i < p->nummod; i++) {
+    List *pruned_names = lst_new_ptr(nseqs);
+    int old_nnodes = p->mod[i]->tree->nnodes;
+    tm_prune(p->mod[i], msa, pruned_names);
+    if (lst_size(pruned_names) == (old_nnodes + 1) / 2)
+      die("ERROR: no match for leaves of tree in alignment (leaf names must match alignment names).\n");
+    lst_free_strings(pruned_names);
+    lst_free(pruned_names);
+    if (p->mod[i]->empirical_rates)
+      die("ERROR: nonparameteric rate variation not allowed with default two-state HMM.\n");
+  }
+  mod = smalloc(2 * sizeof(TreeModel*));
+  if (p->nummod == 2 && !estim_trees && !estim_rho) {
+    mod[0] = p->mod[0];
+    mod[1] = p->mod[1];
+  }
+  else {
+    mod[1] = p->mod[p->nummod-1];
+    if (estim_trees || (p->gc != -1 && estim_rho))
+      init_eqfreqs(mod[1], msa, p->gc);
+    mod[0] = tm_create_copy(mod[1]);
+    if (!estim_rho) tm_scale_branchlens(mod[0], rho, TRUE);
+  }
+  if (p->nrates != -1 && p->nrates != mod[0]->nratecats)
+    tm_reinit(mod[0], mod[0]->subst_mod, p->nrates, mod[0]->alpha, NULL, NULL);
+  if (p->nrates2 != -1 && p->nrates2 != mod[1]->nratecats)
+    tm_reinit(mod[1], mod[1]->subst_mod, p->nrates2, mod[1]->alpha, NULL, NULL);
+
+  if (gamma != -1) {
+    nu = gamma/(1-gamma) * mu;
+    if (nu >= 1)
+      die("ERROR: mu=%f and gamma=%f imply nu >= 1.\n", mu, gamma);
+  }
+  setup_two_state(&hmm, &cm, mu, nu);
+  phmm = phmm_new(hmm, mod, cm, NULL, MISSING_DATA);
+
+  phmm->em_data = smalloc(sizeof(EmData));
+  phmm->em_data->msa = msa;
+  phmm->em_data->fix_functional = !estim_transitions;
+  phmm->em_data->fix_indel = TRUE;
+  phmm->em_data->rho = rho;
+  phmm->em_data->gamma = gamma;
+  phmm->em_data->H = NULL;
+  phmm->em_data->tree_params = NULL;
+
+  if (!quiet) {
+    fprintf(p->results_f, "Maximizing (");
+    if (estim_transitions)
+      fprintf(p->results_f, "mu, nu%s", estim_trees || estim_rho ? ", " : "");
+    if (estim_trees)
+      fprintf(p->results_f, "[tree models]");
+    else if (estim_rho)
+      fprintf(p->results_f, "rho");
+    fprintf(p->results_f, ")...\n");
+  }
+
+  /* M step, as in hmm_train_by_em */
+  if (estim_transitions) {
+    if (gamma > 0)
+      phmm_estim_trans_em_coverage(phmm->hmm, phmm, A);
+    else
+      phmm_estim_trans_em(phmm->hmm, phmm, A);
+  }
+
+  if (estim_trees) {
+    reestimate_trees(phmm->mods, phmm->nmods, phmm, msa->ss->cat_counts, 
+                     msa->ss->ntuples, p->log_f);
+    if (phmm->mods[0]->subst_mod != JC69 && phmm->mods[0]->subst_mod != F81) {
+      tm_scale_model(phmm->mods[0], NULL, 1, 0);
+      tm_scale_model(phmm->mods[1], NULL, 1, 0);
+    }
+  }
+  else if (estim_rho) {
+    phmm->mods[0]->estimate_branchlens = TM_SCALE_ONLY;
+    phmm->mods[0]->scale = rho;
+    tm_set_subst_matrices(phmm->mods[0]);
+    reestimate_rho(phmm->mods, phmm->nmods, phmm, msa->ss->cat_counts, 
+                   msa->ss->ntuples, p->log_f);
+    tm_scale_branchlens(phmm->mods[0], phmm->em_data->rho, FALSE);
+    phmm->mods[0]->scale = 1;
+  }
+
+  mu = mm_get(phmm->functional_hmm->transition_matrix, 0, 1);
+  nu = mm_get(phmm->functional_hmm->transition_matrix, 1, 0);
+  rho = phmm->em_data->rho;
+
+  /* output new parameters; lnL is for the parameters before this M
+     step, which is what is needed to test for convergence */
+  if (!quiet) {
+    fprintf(p->results_f, "(mu = %.17g. nu = %.17g", mu, nu);
+    if (estim_trees || estim_rho)
+      fprintf(p->results_f, ", rho = %.17g", rho);
+    fprintf(p->results_f, ")\n");
+  }
+  if (p->results != NULL) {
+    double temp[2];
+    temp[0] = mu;
+    temp[1] = nu;
+    lol_push_dbl(p->results, &lnl, 1, "likelihood");
+    lol_push_dbl(p->results, temp, 2, "transition.rates");
+    if (estim_trees || estim_rho)
+      lol_push_dbl(p->results, &rho, 1, "rho");
+  }
+  if (p->lnl_f != NULL) {
+    fprintf(p->lnl_f, "lnL = %.4f\n", lnl);
+    fprintf(p->lnl_f, "(mu = %.17g, nu = %.17g", mu, nu);
+    if (estim_trees || estim_rho)
+      fprintf(p->lnl_f, ", rho = %.17g", rho);
+    fprintf(p->lnl_f, ")\n");
+  }
+  if (estim_trees || estim_rho) {
+    if (p->estim_trees_fname_root != NULL) {
+      char cons_fname[STR_MED_LEN], noncons_fname[STR_MED_LEN];
+      sprintf(cons_fname, "%s.cons.mod", p->estim_trees_fname_root);
+      sprintf(noncons_fname, "%s.noncons.mod", p->estim_trees_fname_root);
+      if (!quiet)
+        fprintf(p->results_f, "Writing re-estimated tree models to %s and %s...\n",
+                cons_fname, noncons_fname);
+      tm_print(phast_fopen(cons_fname, "w+"), phmm->mods[0]);
+      tm_print(phast_fopen(noncons_fname, "w+"), phmm->mods[1]);
+    }
+    if (p->results != NULL) {
+      ListOfLists *tmplist = lol_new(2);
+      lol_push_treeModel(tmplist, phmm->mods[0], "cons.mod");
+      lol_push_treeModel(tmplist, phmm->mods[1], "noncons.mod");
+      lol_push_lol(p->results, tmplist, "tree.models");
+    }
+  }
+
+  for (k = 0; k < 2; k++) sfree(A[k]);
+  sfree(A);
+  lst_free(names);
+  lst_free(fields);
+  str_free(line);
+
+  if (!quiet)
+    fprintf(p->results_f, "Done.\n");
+
+  return 0;
+}
+
+
 int phastCons(struct phastCons_struct *p) {
   int post_probs, score, quiet, gff, FC, estim_lambda,
     estim_transitions, two_state, indels,
@@ -104,12 +532,17 @@ int phastCons(struct phastCons_struct *p) {
   MSA *msa;
 
   /* other vars */
-  int i, j, last;
+  int i, j;
+  phast_pos pos, last;
   double lnl = INFTY;
   PhyloHmm *phmm;
   char *newname;
   indel_mode_type indel_mode;
 
+  /* M step of distributed EM; no alignment */
+  if (p->em_merge != NULL)
+    return phastCons_em_merge(p);
+
   msa = p->msa;
   post_probs = p->post_probs;
   score = p->score;
@@ -195,6 +628,10 @@ int phastCons(struct phastCons_struct *p) {
   if (nrates != -1 && hmm != NULL)
     die("ERROR: --nrates currently can't be used with --hmm.\n");
 
+  if (p->em_stats_f != NULL && (!two_state || indels || estim_trees || 
+                                estim_rho))
+    die("ERROR: --em-stats can only be used with the default two-state HMM, and not with --indels,\n--estimate-trees, or --estimate-rho (use these with --em-merge).\n");
+
   if (!indels) estim_indels = FALSE;
 
   if (msa_alph_has_lowercase(msa)) msa_toupper(msa);
@@ -224,8 +661,9 @@ int phastCons(struct phastCons_struct *p) {
     if (msa->seqs == NULL) { ss_to_msa(msa); ss_free(msa->ss); msa->ss = NULL; }
     if (strlen(msa->missing) < 2)
       die("ERROR strlen(msa->missing)=%i\n", strlen(msa->missing));
-    for (i = 0; i < msa->length; i++)
-      if (msa->is_missing[(int)msa->seqs[0][i]]) msa->seqs[0][i] = msa->missing[1];
+    for (pos = 0; pos < msa->length; pos++)
+      if (msa->is_missing[(int)msa->seqs[0][pos]]) 
+        msa->seqs[0][pos] = msa->missing[1];
                                 /* msa->missing[0] is used in msa_mask_macro_indels */
     msa_mask_macro_indels(msa, max_micro_indel, 0);
   }
@@ -317,7 +755,7 @@ int phastCons(struct phastCons_struct *p) {
     if (nrates == -1) nrates = mod[0]->nratecats;
   }
 
-  if (viterbi && seqname==NULL)
+  if ((viterbi || post_probs) && seqname==NULL)
     seqname = "refseq";
 
   /* set up states */
@@ -376,9 +814,31 @@ int phastCons(struct phastCons_struct *p) {
   }
   if (free_cm) cm_free(cm);
 
+  /* use single-precision emissions if requested; parameter
+     estimation requires double precision, so in that case they are
+     converted after estimation, below */
+  if (p->single_prec && p->em_stats_f == NULL && !(FC && estim_lambda) &&
+      !(two_state && (estim_transitions || estim_indels || estim_trees ||
+                      estim_rho)) && !indels_only)
+    phmm_set_single_prec(phmm);
+
   /* compute emissions */
   phmm_compute_emissions(phmm, msa, quiet);
 
+  /* E step only, for distributed estimation (see phastCons_em_merge) */
+  if (p->em_stats_f != NULL) {
+    if (!quiet)
+      fprintf(results_f, "Computing expected sufficient statistics for EM...\n");
+    lnl = write_em_stats(p->em_stats_f, phmm, msa);
+    if (results != NULL)
+      lol_push_dbl(results, &lnl, 1, "likelihood");
+    if (lnl_f != NULL)
+      fprintf(lnl_f, "lnL = %.4f\n", lnl);
+    if (!quiet)
+      fprintf(results_f, "Done.\n");
+    return 0;
+  }
+
   /* estimate lambda, if necessary */
   if (FC && estim_lambda) {
     if (!quiet) fprintf(results_f, "Finding MLE for lambda...");
@@ -410,7 +870,7 @@ int phastCons(struct phastCons_struct *p) {
 			estim_trees, estim_rho,
                         &mu, &nu, &alpha_0, &beta_0, &tau_0,
                         &alpha_1, &beta_1, &tau_1, &rho,
-                        gamma, log_f);
+                        gamma, !p->no_accel, log_f);
     if (estim_transitions || estim_indels || estim_rho) {
       if (!quiet) {
 	fprintf(results_f, "(");
@@ -483,12 +943,14 @@ int phastCons(struct phastCons_struct *p) {
     phmm_reset(phmm);
   }
 
+  if (p->single_prec) phmm_set_single_prec(phmm);
+
   /* before output, have to restore gaps in reference sequence, for
      proper coord conversion */
   if (indels && (post_probs || viterbi)) {
     ss_free(msa->ss); msa->ss = NULL; /* msa->seqs must already exist */
-    for (i = 0; i < msa->length; i++)
-      if (msa->seqs[0][i] == msa->missing[0]) msa->seqs[0][i] = GAP_CHAR;
+    for (pos = 0; pos < msa->length; pos++)
+      if (msa->seqs[0][pos] == msa->missing[0]) msa->seqs[0][pos] = GAP_CHAR;
   }
 
   /* Viterbi */
@@ -531,14 +993,20 @@ int phastCons(struct phastCons_struct *p) {
 
   /* posterior probs */
   if (post_probs) {
-    int *coord=NULL;
+    int *coord=NULL;            /* R integer vector */
 
     if (!quiet) fprintf(results_f, "Computing posterior probabilities...\n");
+    if (results != NULL && msa->length + msa->idx_offset > INT_MAX)
+      die("ERROR: coordinates too large for posterior probability results (max %d).\n", INT_MAX);
 
     if (states == NULL) {  //this only happens if two_state==FALSE
                            //return posterior probabilites for every state
-      double **postprobs = phmm_new_postprobs(phmm), **postprobsNoMissing=NULL;
-      int idx=0, j, k, l;
+      double **postprobs = NULL, **postprobsNoMissing=NULL;
+      float **postprobs_float = NULL; /* used if single precision */
+      phast_pos idx=0, j, k;
+      int l;
+      if (phmm->single_prec) postprobs_float = phmm_new_postprobs_float(phmm);
+      else postprobs = phmm_new_postprobs(phmm);
       if (results != NULL) {
 	postprobsNoMissing = smalloc(phmm->hmm->nstates * sizeof(double*));
 	for (j=0; j < phmm->hmm->nstates; j++)
@@ -554,18 +1022,20 @@ int phastCons(struct phastCons_struct *p) {
 	  if (!msa_missing_col(msa, refidx, j)) {
 	    if (post_probs_f != NULL) {
 	      if (k > last + 1)
-		fprintf(post_probs_f, "fixedStep chrom=%s start=%d step=1\n", seqname,
+		fprintf(post_probs_f, "fixedStep chrom=%s start=%" PHAST_POS_FMT " step=1\n", seqname,
 			k + msa->idx_offset + 1);
 	      for (l=0; l < phmm->hmm->nstates; l++) {
 		if (l != 0) fprintf(post_probs_f, "\t");
-		fprintf(post_probs_f, "%.3f%c", postprobs[l][j],
+		fprintf(post_probs_f, "%.3f%c", postprobs != NULL ? 
+                        postprobs[l][j] : postprobs_float[l][j],
 			l==phmm->hmm->nstates-1 ? '\n' : '\t');
 	      }
 	    }
 	    if (results != NULL) {
 	      coord[idx] = k + msa->idx_offset + 1;
 	      for (l=0; l < phmm->hmm->nstates; l++)
-		postprobsNoMissing[l][idx] = postprobs[l][j];
+		postprobsNoMissing[l][idx] = postprobs != NULL ? 
+                  postprobs[l][j] : postprobs_float[l][j];
 	      idx++;
 	    }
 	    last = k;
@@ -582,7 +1052,7 @@ int phastCons(struct phastCons_struct *p) {
         // and/or index?
 	for (j=0; j < phmm->hmm->nstates; j++) {
 	  //	  sprintf(temp, "%s", cm_get_feature(cm, state_to_cat(phmm->j)));
-	  sprintf(temp, "state.%i", j);
+	  sprintf(temp, "state.%" PHAST_POS_FMT, j);
 	  lol_push_dbl(wigList, postprobsNoMissing[j], idx, temp);
 	}
 	lol_set_class(wigList, "data.frame");
@@ -592,39 +1062,46 @@ int phastCons(struct phastCons_struct *p) {
 	sfree(postprobsNoMissing);
 	sfree(coord);
       }
-      for (j=0; j < phmm->hmm->nstates; j++)
-	sfree(postprobs[j]);
-      sfree(postprobs);
+      for (j=0; j < phmm->hmm->nstates; j++) {
+	if (postprobs != NULL) sfree(postprobs[j]);
+        else sfree(postprobs_float[j]);
+      }
+      if (postprobs != NULL) sfree(postprobs);
+      else sfree(postprobs_float);
     } else {
       double *postprobs, *postprobsNoMissing=NULL;
-      int idx=0, j, k;
+      phast_pos idx=0, j, k;
+      WigWriter *wig = NULL;
       postprobs = phmm_postprobs_cats(phmm, states, &lnl);
       if (results != NULL) {
 	postprobsNoMissing = smalloc(msa->length*sizeof(double));
 	coord = smalloc(msa->length*sizeof(int));
       }
+      if (p->bigwig_fname != NULL)
+	wig = wig_writer_new_bigwig(p->bigwig_fname);
+      else if (post_probs_f != NULL)
+	wig = wig_writer_new(post_probs_f, 3);
 
-      /* print to post_probs_f */
-      last = -INFTY;
+      /* print to post_probs_f (or bigWig file) */
       for (j = 0, k = 0; j < msa->length; j++) {
 	checkInterruptN(j, 1000);
 	if (refidx == 0 || msa_get_char(msa, refidx-1, j) != GAP_CHAR) {
 	  if (!msa_missing_col(msa, refidx, j)) {
-	    if (post_probs_f != NULL) {
-	      if (k > last + 1)
-		fprintf(post_probs_f, "fixedStep chrom=%s start=%d step=1\n", seqname,
-			k + msa->idx_offset + 1);
-	      fprintf(post_probs_f, "%.3f\n", postprobs[j]);
-	    }
+	    if (wig != NULL)
+	      wig_writer_add(wig, seqname, k + msa->idx_offset + 1,
+			     postprobs[j]);
 	    if (results != NULL) {
 	      coord[idx] = k + msa->idx_offset + 1;
 	      postprobsNoMissing[idx++] = postprobs[j];
 	    }
-	    last = k;
 	  }
 	  k++;
 	}
       }
+      if (wig != NULL) {
+	wig_writer_set_chrom_size(wig, seqname, k + msa->idx_offset);
+	wig_writer_free(wig);
+      }
       if (results != NULL) {
         ListOfLists *wigList = lol_new(2);
         lol_push_int(wigList, coord, idx, "coord");
@@ -692,13 +1169,107 @@ void setup_two_state(HMM **hmm, CategoryMap **cm, double mu, double nu) {
    nonconserved state need not be recomputed */
 void compute_emissions_estim_rho(double **emissions, void **models,
 				 int nmodels, void *data, int sample,
-				 int length) {
+				 phast_pos length) {
   PhyloHmm *phmm = (PhyloHmm*)data;
   tl_compute_log_likelihood(phmm->mods[0], phmm->em_data->msa,
 			    phmm->emissions[0], NULL,  -1, NULL);
 }
 
 
+/* Functions for accelerated EM in fit_two_state (see EmAccel in
+   em.h).  The parameter vector consists of the tree-model parameters
+   (with --estimate-trees) or rho (with --estimate-rho), followed by
+   mu and nu if they are being estimated.  Note that extrapolation
+   preserves the linear constraint between mu and nu implied by a
+   target coverage. */
+
+/* append mu and nu to params, starting at position 'offset' */
+static void get_params_trans(PhyloHmm *phmm, Vector *params, Vector *lb, 
+                             Vector *ub, int offset) {
+  int size = offset + (phmm->em_data->fix_functional ? 0 : 2);
+  vec_realloc(params, size);
+  vec_realloc(lb, size);
+  vec_realloc(ub, size);
+  if (phmm->em_data->fix_functional) return;
+  vec_set(params, offset, 
+          mm_get(phmm->functional_hmm->transition_matrix, 0, 1));
+  vec_set(params, offset+1, 
+          mm_get(phmm->functional_hmm->transition_matrix, 1, 0));
+  vec_set(lb, offset, 0); vec_set(lb, offset+1, 0);
+  vec_set(ub, offset, 1); vec_set(ub, offset+1, 1);
+}
+
+/* set mu and nu from params, starting at position 'offset', and reset
+   the phylo-HMM */
+static void set_params_trans(PhyloHmm *phmm, Vector *params, int offset) {
+  if (!phmm->em_data->fix_functional) {
+    double mu = vec_get(params, offset), nu = vec_get(params, offset+1);
+    mm_set(phmm->functional_hmm->transition_matrix, 0, 0, 1-mu);
+    mm_set(phmm->functional_hmm->transition_matrix, 0, 1, mu);
+    mm_set(phmm->functional_hmm->transition_matrix, 1, 0, nu);
+    mm_set(phmm->functional_hmm->transition_matrix, 1, 1, 1-nu);
+    if (phmm->em_data->gamma > 0) { /* as in phmm_estim_trans_em_coverage */
+      vec_set(phmm->functional_hmm->begin_transitions, 0, nu/(mu+nu));
+      vec_set(phmm->functional_hmm->begin_transitions, 1, mu/(mu+nu));
+    }
+  }
+  phmm_reset(phmm);
+}
+
+static void get_params_two_state(Vector *params, Vector *lb, Vector *ub, 
+                                 HMM *hmm, void *models, void *data) {
+  get_params_trans(data, params, lb, ub, 0);
+}
+
+static void set_params_two_state(Vector *params, HMM *hmm, void *models, 
+                                 void *data) {
+  set_params_trans(data, params, 0);
+}
+
+static void get_params_two_state_rho(Vector *params, Vector *lb, 
+                                     Vector *ub, HMM *hmm, void *models, 
+                                     void *data) {
+  PhyloHmm *phmm = data;
+  get_params_trans(phmm, params, lb, ub, 1);
+  vec_set(params, 0, phmm->em_data->rho);
+  vec_set(lb, 0, 0);
+  vec_set(ub, 0, 1);
+}
+
+static void set_params_two_state_rho(Vector *params, HMM *hmm, 
+                                     void *models, void *data) {
+  PhyloHmm *phmm = data;
+  phmm->em_data->rho = phmm->mods[0]->scale = vec_get(params, 0);
+  tm_set_subst_matrices(phmm->mods[0]);
+  set_params_trans(phmm, params, 1);
+}
+
+static void get_params_two_state_trees(Vector *params, Vector *lb, 
+                                       Vector *ub, HMM *hmm, void *models, 
+                                       void *data) {
+  PhyloHmm *phmm = data;
+  Vector *tp = phmm->em_data->tree_params;
+  int i;
+  get_params_trans(phmm, params, lb, ub, tp->size);
+  for (i = 0; i < tp->size; i++) {
+    vec_set(params, i, vec_get(tp, i));
+    vec_set(lb, i, 0);
+    vec_set(ub, i, INFTY);
+  }
+  vec_set(ub, tp->size - 1, 1); /* 0 < rho < 1 */
+}
+
+static void set_params_two_state_trees(Vector *params, HMM *hmm, 
+                                       void *models, void *data) {
+  PhyloHmm *phmm = data;
+  Vector *tp = phmm->em_data->tree_params;
+  int i;
+  for (i = 0; i < tp->size; i++)
+    vec_set(tp, i, vec_get(params, i));
+  unpack_params_phmm(phmm, tp);
+  set_params_trans(phmm, params, tp->size);
+}
+
 /* Estimate parameters for the two-state model using an EM algorithm.
    Any or all of the parameters 'mu' and 'nu', the indel parameters, and
    the tree models themselves may be estimated.  Returns ln
@@ -707,9 +1278,11 @@ double fit_two_state(PhyloHmm *phmm, MSA *msa, int estim_func, int estim_indels,
                      int estim_trees, int estim_rho, double *mu, double *nu,
                      double *alpha_0, double *beta_0, double *tau_0,
                      double *alpha_1, double *beta_1, double *tau_1,
-                     double *rho, double gamma, FILE *logf) {
+                     double *rho, double gamma, int accelerate, FILE *logf) {
   double retval;
-  void (*compute_emissions_func)(double **, void **, int, void*, int, int);
+  void (*compute_emissions_func)(double **, void **, int, void*, int, 
+                                 phast_pos);
+  EmAccel accel, *accel_p = &accel;
 
   mm_set(phmm->functional_hmm->transition_matrix, 0, 0, 1-*mu);
   mm_set(phmm->functional_hmm->transition_matrix, 0, 1, *mu);
@@ -725,6 +1298,7 @@ double fit_two_state(PhyloHmm *phmm, MSA *msa, int estim_func, int estim_indels,
   phmm->em_data->rho = *rho;
   phmm->em_data->gamma = gamma;
   phmm->em_data->H = NULL;      /* will be defined as needed */
+  phmm->em_data->tree_params = NULL;
 
   if (phmm->indel_mode == PARAMETERIC) {
     phmm->alpha[0] = *alpha_0;
@@ -752,13 +1326,35 @@ double fit_two_state(PhyloHmm *phmm, MSA *msa, int estim_func, int estim_indels,
     compute_emissions_func = compute_emissions_estim_rho;
   else compute_emissions_func = NULL;
 
+  /* accelerate EM by extrapolation, except with the parametric indel
+     model, whose parameters are not included in the parameter vector */
   if (estim_trees) {
-    retval = hmm_train_by_em(phmm->hmm, phmm->mods, phmm, 1, &phmm->alloc_len, NULL,
-                             compute_emissions_func, reestimate_trees,
-                             gamma > 0 ?
-                             phmm_estim_trans_em_coverage : phmm_estim_trans_em,
-                             phmm_get_obs_idx_em,
-                             phmm_log_em, phmm->emissions, logf) * log(2);
+    accel.get_params = get_params_two_state_trees;
+    accel.set_params = set_params_two_state_trees;
+  }
+  else if (estim_rho) {
+    accel.get_params = get_params_two_state_rho;
+    accel.set_params = set_params_two_state_rho;
+  }
+  else {
+    accel.get_params = get_params_two_state;
+    accel.set_params = set_params_two_state;
+  }
+  if (!accelerate || phmm->indel_mode == PARAMETERIC || 
+      (!estim_func && !estim_trees && !estim_rho))
+    accel_p = NULL;
+
+  if (estim_trees) {
+    retval = hmm_train_by_em_threaded(phmm->hmm, phmm->mods, phmm, 1, 
+                                      &phmm->alloc_len, NULL,
+                                      compute_emissions_func, 
+                                      reestimate_trees,
+                                      gamma > 0 ?
+                                      phmm_estim_trans_em_coverage : 
+                                      phmm_estim_trans_em,
+                                      phmm_get_obs_idx_em,
+                                      phmm_log_em, phmm->emissions, logf,
+                                      1, accel_p) * log(2);
 
 
     /* have to do final rescaling of tree models to get units of subst/site */
@@ -776,12 +1372,16 @@ double fit_two_state(PhyloHmm *phmm, MSA *msa, int estim_func, int estim_indels,
     phmm->mods[0]->scale = phmm->em_data->rho;
     tm_set_subst_matrices(phmm->mods[0]);
 
-    retval = hmm_train_by_em(phmm->hmm, phmm->mods, phmm, 1, &phmm->alloc_len, NULL,
-                             compute_emissions_func, reestimate_rho,
-                             gamma > 0 ?
-                             phmm_estim_trans_em_coverage : phmm_estim_trans_em,
-                             phmm_get_obs_idx_em,
-                             phmm_log_em, phmm->emissions, logf) * log(2);
+    retval = hmm_train_by_em_threaded(phmm->hmm, phmm->mods, phmm, 1, 
+                                      &phmm->alloc_len, NULL,
+                                      compute_emissions_func, 
+                                      reestimate_rho,
+                                      gamma > 0 ?
+                                      phmm_estim_trans_em_coverage : 
+                                      phmm_estim_trans_em,
+                                      phmm_get_obs_idx_em,
+                                      phmm_log_em, phmm->emissions, logf,
+                                      1, accel_p) * log(2);
 
     /* do final rescaling of conserved tree */
     tm_scale_branchlens(phmm->mods[0], phmm->em_data->rho, FALSE);
@@ -791,11 +1391,13 @@ double fit_two_state(PhyloHmm *phmm, MSA *msa, int estim_func, int estim_indels,
   }
 
   else {                        /* not estimating tree models */
-    retval = hmm_train_by_em(phmm->hmm, phmm->mods, phmm, 1,
-                             &phmm->alloc_len, NULL, NULL, NULL,
-                             gamma > 0 ?
-                             phmm_estim_trans_em_coverage : phmm_estim_trans_em,
-                             NULL, phmm_log_em, phmm->emissions, logf) * log(2);
+    retval = hmm_train_by_em_threaded(phmm->hmm, phmm->mods, phmm, 1,
+                                      &phmm->alloc_len, NULL, NULL, NULL,
+                                      gamma > 0 ?
+                                      phmm_estim_trans_em_coverage : 
+                                      phmm_estim_trans_em,
+                                      NULL, phmm_log_em, phmm->emissions, 
+                                      logf, 1, accel_p) * log(2);
   }
 
   *mu = mm_get(phmm->functional_hmm->transition_matrix, 0, 1);
@@ -911,7 +1513,7 @@ void reestimate_trees(TreeModel **models, int nmodels, void *data,
   int k, obsidx, i, npar;
   Vector *params, *lower_bounds, *upper_bounds, *opt_params;
   double ll;
-  int haveratevar, orig_nratecats[2];
+  int haveratevar, orig_nratecats[2], own_cache[2];
 
   /* FIXME: what about when multiple states per model?  Need to
      collapse sufficient stats.  Could probably be done generally...
@@ -997,10 +1599,19 @@ void reestimate_trees(TreeModel **models, int nmodels, void *data,
   vec_copy(phmm->mods[0]->all_params, params);
   vec_copy(phmm->mods[1]->all_params, params);
 
+  /* reuse per-tuple partial likelihoods between evaluations that
+     change only a few branches (the tuples themselves do not change
+     between iterations of EM, only their expected counts) */
+  for (i = 0; i < 2; i++)
+    own_cache[i] = tl_attach_cache(phmm->mods[i], phmm->em_data->msa);
+
   if (opt_bfgs(likelihood_wrapper, opt_params, phmm, &ll, lower_bounds,
                NULL, logf, NULL, OPT_MED_PREC, phmm->em_data->H, NULL) != 0)
     die("ERROR returned by opt_bfgs.\n");
 
+  for (i = 0; i < 2; i++)
+    if (own_cache[i]) tl_detach_cache(phmm->mods[i]);
+
   if (logf != NULL)
     fprintf(logf, "END RE-ESTIMATION OF TREE MODEL\n\n");
 
@@ -1009,8 +1620,12 @@ void reestimate_trees(TreeModel **models, int nmodels, void *data,
   if (phmm->indel_mode == PARAMETERIC)
     phmm_set_branch_len_factors(phmm);
 
+  /* save for accelerated EM */
+  if (phmm->em_data->tree_params != NULL)
+    vec_free(phmm->em_data->tree_params);
+  phmm->em_data->tree_params = opt_params;
+
   vec_free(params);
-  vec_free(opt_params);
   vec_free(lower_bounds);
   vec_free(upper_bounds);
 }
@@ -34,6 +34,7 @@
 #include <stacks.h>
 #include <trees.h>
 #include <misc.h>
+#include <thread_pool.h>
 
 /* initialize phyloFit options to defaults (slightly different
    for rphast).
@@ -93,10 +94,14 @@ struct phyloFit_struct* phyloFit_struct_new(int rphast) {
   pf->rate_consts = NULL;
   pf->alpha = DEFAULT_ALPHA;
   pf->gff = NULL;
+  pf->gff_compact = NULL;
   pf->input_mod = NULL;
   pf->use_selection = 0;
   pf->selection = 0.0;
   pf->max_em_its = -1;
+  pf->nthreads = 1;
+  pf->window_warm_start = FALSE;
+  pf->no_accel = FALSE;
 
   pf->results = rphast ? lol_new(2) : NULL;
   return pf;
@@ -255,7 +260,7 @@ void print_post_prob_stats(TreeModel *mod, MSA *msa, char *output_fname_root,
                                                 do_expected_nsubst,
                                                 do_expected_nsubst_tot,
 						do_expected_nsubst_col,
-						0, 0);
+						0, 0, FALSE);
   tl_compute_log_likelihood(mod, msa, NULL, NULL, cat, mod->tree_posteriors);
   tr_name_ancestors(mod->tree);
 
@@ -280,7 +285,7 @@ void print_post_prob_stats(TreeModel *mod, MSA *msa, char *output_fname_root,
 	  if (do_every_site) {
 	    for (i=0; i < msa->length; i++) {
 	      for (state=0; state < mod->rate_matrix->size; state++) {
-		arr[ratecat][node_idx][state][i] = mod->tree_posteriors->base_probs[ratecat][state][n->id][msa->ss->tuple_idx[i]];
+		arr[ratecat][node_idx][state][i] = TP_BASE_PROB(mod->tree_posteriors, ratecat, state, n->id, msa->ss->tuple_idx[i]);
 	      }
 	    }
 	  } else {
@@ -289,7 +294,7 @@ void print_post_prob_stats(TreeModel *mod, MSA *msa, char *output_fname_root,
 	      for (tup=0; tup < msa->ss->ntuples; tup++) {
 		if ((cat >=0 && msa->ss->cat_counts[cat][tup] == 0) ||
 		    msa->ss->counts[tup] == 0) continue;
-		arr[ratecat][node_idx][state][tup_idx++] = mod->tree_posteriors->base_probs[ratecat][state][n->id][tup];
+		arr[ratecat][node_idx][state][tup_idx++] = TP_BASE_PROB(mod->tree_posteriors, ratecat, state, n->id, tup);
 	      }
 	    }
 	  }
@@ -358,7 +363,7 @@ void print_post_prob_stats(TreeModel *mod, MSA *msa, char *output_fname_root,
 	  if (n->lchild == NULL || n->rchild == NULL) continue;
 	  for (state = 0; state < mod->rate_matrix->size; state++)
 	    fprintf(POSTPROBF, "%6.4f ",
-		    mod->tree_posteriors->base_probs[0][state][n->id][tup]);
+		    TP_BASE_PROB(mod->tree_posteriors, 0, state, n->id, tup));
 	}
 	fprintf(POSTPROBF, "\n");
       }
@@ -394,7 +399,7 @@ void print_post_prob_stats(TreeModel *mod, MSA *msa, char *output_fname_root,
 	    checkInterruptN(tup, 1000);
 	    if ((cat >= 0 && msa->ss->cat_counts[cat][tup] == 0) ||
 		msa->ss->counts[tup] == 0) continue;
-	    arr[ratecat][node_idx][tup_idx++] = mod->tree_posteriors->expected_nsubst[ratecat][n->id][tup];
+	    arr[ratecat][node_idx][tup_idx++] = TP_EXPECTED_NSUBST(mod->tree_posteriors, ratecat, n->id, tup);
 	  }
 	  node_idx++;
 	}
@@ -438,8 +443,8 @@ void print_post_prob_stats(TreeModel *mod, MSA *msa, char *output_fname_root,
 	  n = lst_get_ptr(tr_postorder(mod->tree), node);
 	  if (n == mod->tree) continue;
 	  fprintf(EXPSUBF, "%7.4f ",
-		  mod->tree_posteriors->expected_nsubst[0][n->id][tup]);
-	  total += mod->tree_posteriors->expected_nsubst[0][n->id][tup];
+		  TP_EXPECTED_NSUBST(mod->tree_posteriors, 0, n->id, tup));
+	  total += TP_EXPECTED_NSUBST(mod->tree_posteriors, 0, n->id, tup);
 	}
 	fprintf(EXPSUBF, "%7.4f\n", total);
       }
@@ -472,7 +477,7 @@ void print_post_prob_stats(TreeModel *mod, MSA *msa, char *output_fname_root,
 	    for (state=0; state < mod->rate_matrix->size; state++) {
 	      for (state2=0; state2 < mod->rate_matrix->size; state2++) {
 		arr[ratecat][0][tuple_idx][state][state2] = cat >= 0 ? msa->ss->cat_counts[cat][tup] : msa->ss->counts[tup];
-		arr[ratecat][node_idx][tuple_idx][state][state2] = mod->tree_posteriors->expected_nsubst_col[ratecat][n->id][tup][state][state2];
+		arr[ratecat][node_idx][tuple_idx][state][state2] = TP_EXPECTED_NSUBST_COL(mod->tree_posteriors, ratecat, n->id, tup, state, state2);
 	      }
 	    }
 	    tuple_idx++;
@@ -524,7 +529,7 @@ void print_post_prob_stats(TreeModel *mod, MSA *msa, char *output_fname_root,
 		  n->name);
 	  for (state=0; state < mod->rate_matrix->size; state++) {
 	    for (state2=0; state2 < mod->rate_matrix->size; state2++) {
-	      fprintf(EXPSUBF, "\t%g", mod->tree_posteriors->expected_nsubst_col[0][n->id][tup][state][state2]);
+	      fprintf(EXPSUBF, "\t%g", TP_EXPECTED_NSUBST_COL(mod->tree_posteriors, 0, n->id, tup, state, state2));
 	    }
 	  }
 	  fprintf(EXPSUBF, "\n");
@@ -661,16 +666,746 @@ void print_window_summary(FILE* WINDOWF, List *window_coords, int win,
 
 
 
-int run_phyloFit(struct phyloFit_struct *pf) {
-  FILE *F, *WINDOWF=NULL;
-  int i, j, win, root_leaf_id = -1;
-  String *mod_fname;
+/* settings shared by all model fits in run_phyloFit */
+typedef struct {
+  struct phyloFit_struct *pf;
+  TreeNode *tree;
+  List *cats_to_do;
+  int subst_mod, root_leaf_id;
+  FILE *error_file, *parsimony_cost_file;
+} FitSetup;
+
+/* number of consecutive windows fitted as a unit (by a single thread,
+   sharing one incrementally updated window of sufficient statistics).
+   Warm starts only carry over within a chain, so results depend on
+   this constant but not on the number of threads */
+#define WINDOW_CHAIN_LEN 16
+
+/* number of chains per thread to run between printing of window
+   summaries; limits number of models held in memory */
+#define WINDOW_CHAINS_PER_BATCH 4
+
+/* result of a fit in windowed mode, kept until its line of the window
+   summary has been printed */
+typedef struct {
+  TreeModel *mod;               /* NULL if window was skipped */
+  double *gc;
+  unsigned int ninf_sites;
+} WindowFit;
+
+/* data shared by the jobs (chains of windows) of a batch */
+typedef struct {
+  FitSetup *fs;
   MSA *source_msa;
-  String *tmpstr = str_new(STR_SHORT_LEN);
+  FILE *WINDOWF;                /* window summary file */
+  int print_now;                /* if TRUE, print summaries as soon as
+                                   available (serial execution only);
+                                   otherwise store them in 'fits' */
+  int use_sswindow;             /* whether to use incremental sufficient
+                                   stats rather than msa_sub_alignment */
+  int order_by_appearance;      /* order of tuples in windows (see
+                                   ss_window_new) */
+  int split_cats;               /* if TRUE, each job fits a single
+                                   category of a chain; otherwise all
+                                   categories */
+  int first_win, nwins;         /* windows in batch (indexing pairs in
+                                   window_coords) */
+  WindowFit *fits;              /* nwins x lst_size(cats_to_do) */
+} WindowBatch;
+
+/* data shared by the jobs (categories) of pf_fit_categories */
+typedef struct {
+  FitSetup *fs;
+  TreeModel *input_mod;
+  MSA *msa;
+  int print_now;                /* if TRUE, output models as soon as
+                                   fitted (serial execution only);
+                                   otherwise store them in 'mods' */
+  int collapse;                 /* if TRUE, missing data are collapsed
+                                   before the first fit (otherwise
+                                   already done) */
+  TreeModel **mods;             /* fitted model of each category, or
+                                   NULL if skipped */
+} CategoryBatch;
+
+/* create a model for fitting to msa, or set up an existing one.  If
+   base_mod is NULL, a new model is created; otherwise base_mod is
+   reinitialized and returned */
+static TreeModel *pf_setup_model(FitSetup *fs, TreeModel *base_mod, 
+                                 MSA *msa) {
+  struct phyloFit_struct *pf = fs->pf;
+  TreeModel *mod;
+  List *pruned_names;
+  int j, old_nnodes, subst_mod = fs->subst_mod;
+
+  if (base_mod == NULL)
+    mod = tm_new(tr_create_copy(fs->tree), NULL, NULL, subst_mod,
+                 msa->alphabet, pf->nratecats == -1 ? 1 : pf->nratecats,
+                 pf->alpha, pf->rate_consts, fs->root_leaf_id);
+  else if (pf->likelihood_only)
+    mod = base_mod;
+  else {
+    List *rate_consts, *freq;
+    double alpha;
+    int nratecats;
+
+    if (pf->nratecats != -1) {
+      nratecats = pf->nratecats;
+      alpha = pf->alpha;
+      rate_consts = pf->rate_consts;
+      freq = NULL;
+    } else {
+      nratecats = base_mod->nratecats;
+      alpha = base_mod->alpha;
+      if (base_mod->rK != NULL) {
+        rate_consts = lst_new_dbl(base_mod->nratecats);
+        for (j=0; j < base_mod->nratecats; j++)
+          lst_push_dbl(rate_consts, base_mod->rK[j]);
+      } else rate_consts = NULL;
+      if (base_mod->freqK != NULL) {
+        freq = lst_new_dbl(base_mod->nratecats);
+        for (j=0; j < base_mod->nratecats; j++)
+          lst_push_dbl(freq, base_mod->freqK[j]);
+      } else freq = NULL;
+    }
+    mod = base_mod;
+    tm_reinit(mod, subst_mod, nratecats, alpha,
+              rate_consts, freq);
+    if (rate_consts != pf->rate_consts)
+      lst_free(rate_consts);
+    if (freq != NULL)
+      lst_free(freq);
+  }
+
+  if (pf->use_selection) {
+    mod->selection_idx = 0;
+    mod->selection = pf->selection;
+  }
+
+  mod->noopt_arg = pf->nooptstr == NULL ? NULL : str_new_charstr(pf->nooptstr->chars);
+  mod->eqfreq_sym = pf->symfreq || subst_mod == SSREV;
+  if (pf->bound_arg != NULL) {
+    mod->bound_arg = lst_new_ptr(lst_size(pf->bound_arg));
+    for (j=0; j < lst_size(pf->bound_arg); j++) {
+      String *tmp = lst_get_ptr(pf->bound_arg, j);
+      lst_push_ptr(mod->bound_arg, str_new_charstr(tmp->chars));
+    }
+  } else mod->bound_arg = NULL;
+
+  mod->use_conditionals = pf->use_conditionals;
+
+  if (pf->estimate_scale_only ||
+      pf->estimate_backgd ||
+      pf->no_rates ||
+      pf->assume_clock) {
+    if (pf->estimate_scale_only) {
+      mod->estimate_branchlens = TM_SCALE_ONLY;
+
+      if (pf->subtree_name != NULL) { /* estimation of subtree scale */
+        String *s1 = str_new_charstr(pf->subtree_name),
+          *s2 = str_new_charstr(pf->subtree_name);
+        str_root(s1, ':'); str_suffix(s2, ':'); /* parse string */
+        mod->subtree_root = tr_get_node(mod->tree, s1->chars);
+        if (mod->subtree_root == NULL) {
+          tr_name_ancestors(mod->tree);
+          mod->subtree_root = tr_get_node(mod->tree, s1->chars);
+          if (mod->subtree_root == NULL)
+            die("ERROR: no node named '%s'.\n", s1->chars);
+        }
+        if (s2->length > 0) {
+          if (str_equals_charstr(s2, "loss"))
+            mod->scale_sub_bound = LB;
+          else if (str_equals_charstr(s2, "gain"))
+            mod->scale_sub_bound = UB;
+          else die("ERROR: unrecognized suffix '%s'\n", s2->chars);
+        }
+        str_free(s1); str_free(s2);
+      }
+    }
+
+    else if (pf->assume_clock)
+      mod->estimate_branchlens = TM_BRANCHLENS_CLOCK;
+
+    if (pf->no_rates)
+      mod->estimate_ratemat = FALSE;
+
+    mod->estimate_backgd = pf->estimate_backgd;
+  }
+
+  if (pf->no_branchlens)
+    mod->estimate_branchlens = TM_BRANCHLENS_NONE;
+
+  if (pf->ignore_branches != NULL)
+    tm_set_ignore_branches(mod, pf->ignore_branches);
+
+  old_nnodes = mod->tree->nnodes;
+  pruned_names = lst_new_ptr(msa->nseqs);
+  tm_prune(mod, msa, pruned_names);
+  if (lst_size(pruned_names) == (old_nnodes + 1) / 2)
+    die("ERROR: no match for leaves of tree in alignment (leaf names must match alignment names).\n");
+  if (!pf->quiet && lst_size(pruned_names) > 0) {
+    fprintf(stderr, "WARNING: pruned away leaves of tree with no match in alignment (");
+    for (j = 0; j < lst_size(pruned_names); j++)
+      fprintf(stderr, "%s%s", ((String*)lst_get_ptr(pruned_names, j))->chars,
+              j < lst_size(pruned_names) - 1 ? ", " : ").\n");
+  }
+  lst_free_strings(pruned_names);
+  lst_free(pruned_names);
+
+  if (pf->alt_mod_str != NULL) {
+    for (j = 0 ; j < lst_size(pf->alt_mod_str); j++)
+      tm_add_alt_mod(mod, (String*)lst_get_ptr(pf->alt_mod_str, j));
+  }
+  return mod;
+}
+
+/* description of a fit, for messages */
+static void pf_describe_fit(FitSetup *fs, String *descr, int cat, int win) {
+  struct phyloFit_struct *pf = fs->pf;
+  str_clear(descr);
+
+  if  (pf->msa_fname != NULL)
+    str_append_charstr(descr, pf->msa_fname);
+  else str_append_charstr(descr, "alignment");
+
+  if (cat != -1 || pf->window_coords != NULL) {
+    str_append_charstr(descr, " (");
+    if (cat != -1) {
+      str_append_charstr(descr, "category ");
+      str_append_int(descr, cat);
+    }
+
+    if (pf->window_coords != NULL) {
+      if (cat != -1) str_append_charstr(descr, ", ");
+      str_append_charstr(descr, "window ");
+      str_append_int(descr, win/2 + 1);
+    }
+
+    str_append_char(descr, ')');
+  }
+}
+
+/* returns TRUE if every sequence of msa has at least one character
+   that is neither a gap nor missing data at sites of category cat.
+   Requires sufficient statistics */
+static int pf_all_seqs_have_data(MSA *msa, int cat) {
+  int i, j, found;
+  char c;
+  for (j = 0; j < msa->nseqs; j++) {
+    found = FALSE;
+    for (i = 0; i < msa->ss->ntuples && !found; i++) {
+      if ((cat >= 0 ? msa->ss->cat_counts[cat][i] : msa->ss->counts[i]) == 0)
+        continue;
+      c = ss_get_char_tuple(msa, i, j, 0);
+      if (c != GAP_CHAR && !msa->is_missing[(int)c]) found = TRUE;
+    }
+    if (!found) return FALSE;
+  }
+  return TRUE;
+}
+
+/* fit mod to msa (or just compute its likelihood, depending on
+   options).  If collapse == TRUE, missing data characters in msa are
+   collapsed first.  If warm_mod is non-NULL, parameters are
+   initialized from it rather than in the usual way.  Returns FALSE
+   if the fit was skipped and no model should be output */
+static int pf_fit_model(FitSetup *fs, TreeModel *mod, MSA *msa, int cat,
+                        int collapse, TreeModel *warm_mod, String *descr,
+                        unsigned int *ninf_sites) {
+  struct phyloFit_struct *pf = fs->pf;
+  Vector *params = NULL;
+  FILE *F;
+  int j, quiet = pf->quiet, subst_mod = fs->subst_mod;
+
+  *ninf_sites = msa_ninformative_sites(msa, cat);
+  if (*ninf_sites < pf->nsites_threshold) {
+    fprintf(stderr, "Skipping %s; insufficient informative sites ...\n",
+            descr->chars);
+    return FALSE;
+  }
+
+  if (pf->init_parsimony) {
+    double parsimony_cost = tm_params_init_branchlens_parsimony(NULL, mod, msa, cat);
+    if (fs->parsimony_cost_file != NULL)
+      fprintf(fs->parsimony_cost_file, "%f\n", parsimony_cost);
+    if (pf->parsimony_only) return FALSE;
+  }
+
+  if (pf->likelihood_only) {
+    double *col_log_probs = pf->do_column_probs ?
+      smalloc(msa->length * sizeof(double)) : NULL;
+    String *colprob_fname;
+    if (!quiet)
+      fprintf(stderr, "Computing likelihood of %s ...\n", descr->chars);
+    tm_set_subst_matrices(mod);
+    if (pf->do_column_probs && msa->ss != NULL && msa->ss->tuple_idx == NULL) {
+      msa->ss->tuple_idx = smalloc(msa->length * sizeof(int));
+      for (j = 0; j < msa->length; j++)
+        msa->ss->tuple_idx[j] = j;
+    }
+    mod->lnL = tl_compute_log_likelihood(mod, msa, col_log_probs, NULL, cat, NULL) *
+      log(2);
+    if (pf->do_column_probs) {
+      //we don't need to implement this in RPHAST because there is
+      //already a msa.likelihood function
+      if (pf->output_fname_root == NULL)
+        die("ERROR: currently do_column_probs requires output file");
+      colprob_fname = str_new_charstr(pf->output_fname_root);
+      str_append_charstr(colprob_fname, ".colprobs");
+      if (!quiet)
+        fprintf(stderr, "Writing column probabilities to %s ...\n",
+                colprob_fname->chars);
+      if (strcmp(pf->output_fname_root, "-") != 0)
+        F = phast_fopen(colprob_fname->chars, "w+");
+      else
+        F = stdout;
+      for (j = 0; j < msa->length; j++)
+        fprintf(F, "%d\t%.6f\n", j, col_log_probs[j]);
+      if (strcmp(pf->output_fname_root, "-") != 0)
+        phast_fclose(F);
+      str_free(colprob_fname);
+      sfree(col_log_probs);
+    }
+  }
+  else {                    /* fit model */
+
+    if (msa->ss == NULL) {    /* get sufficient stats if necessary */
+      if (!quiet)
+        fprintf(stderr, "Extracting sufficient statistics ...\n");
+      ss_from_msas(msa, mod->order+1, 0,
+                   pf->cats_to_do_str != NULL ? fs->cats_to_do : NULL,
+                   NULL, NULL, -1, subst_mod_is_codon_model(mod->subst_mod));
+      /* (sufficient stats obtained only for categories of interest) */
+
+      if (msa->length > 1000000) { /* throw out original data if
+                                      very large */
+        for (j = 0; j < msa->nseqs; j++) sfree(msa->seqs[j]);
+        sfree(msa->seqs);
+        msa->seqs = NULL;
+      }
+    }
+    if (pf->random_init)
+      params = tm_params_init_random(mod);
+    else if (pf->input_mod != NULL)
+      params = tm_params_new_init_from_model(mod);
+    else
+      params = tm_params_init(mod, .1, 5, pf->alpha);
+
+    if (warm_mod != NULL && !pf->random_init && 
+        pf_all_seqs_have_data(msa, cat)) {
+      /* start from optimum for previous window instead.  (Not done if
+         a sequence has no data, because parameters that can't be
+         estimated would then drift from window to window) */
+      Vector *warm_params = tm_params_new_init_from_model(warm_mod);
+      if (warm_params->size == params->size)
+        vec_copy(params, warm_params);
+      vec_free(warm_params);
+    }
+
+    if (pf->init_parsimony)
+      tm_params_init_branchlens_parsimony(params, mod, msa, cat);
+
+    if (pf->input_mod != NULL && mod->backgd_freqs != NULL && !pf->no_freqs && pf->init_backgd_from_data) {
+      /* in some cases, the eq freqs are needed for
+         initialization, but now they should be re-estimated --
+         UNLESS user specifies --no-freqs */
+      vec_free(mod->backgd_freqs);
+      mod->backgd_freqs = NULL;
+    }
+
+
+    if (collapse) {
+      if (!quiet) fprintf(stderr, "Compacting sufficient statistics ...\n");
+      ss_collapse_missing(msa, !pf->gaps_as_bases);
+                            /* reduce number of tuples as much as
+                               possible */
+    }
+
+    if (!quiet) {
+      fprintf(stderr, "Fitting tree model to %s using %s%s ...\n",
+              descr->chars, tm_get_subst_mod_string(subst_mod),
+              mod->nratecats > 1 ? " (with rate variation)" : "");
+    }
+
+    if (pf->use_em)
+      tm_fit_em(mod, msa, params, cat, pf->precision, pf->max_em_its,
+                !pf->no_accel, pf->logf, fs->error_file);
+    else
+      tm_fit(mod, msa, params, cat, pf->precision, pf->logf, pf->quiet, fs->error_file);
+  }
+  if (params != NULL) vec_free(params);
+  return TRUE;
+}
+
+/* write a fitted model and any associated output.  The window index
+   'win' is ignored if not in windowed mode */
+static void pf_output_model(FitSetup *fs, TreeModel *mod, MSA *msa, 
+                            String *mod_fname, int cat, int win) {
+  struct phyloFit_struct *pf = fs->pf;
+  FILE *F;
+
+  if (pf->output_fname_root != NULL)
+    str_cpy_charstr(mod_fname, pf->output_fname_root);
+  else str_clear(mod_fname);
+  if (pf->window_coords != NULL) {
+    if (mod_fname->length != 0)
+      str_append_char(mod_fname, '.');
+    str_append_charstr(mod_fname, "win-");
+    str_append_int(mod_fname, win/2 + 1);
+  }
+  if (cat != -1 && pf->nonoverlapping == FALSE) {
+    if (mod_fname->length != 0)
+      str_append_char(mod_fname, '.');
+    if (pf->cm != NULL)
+      str_append(mod_fname, cm_get_feature_unique(pf->cm, cat));
+    else
+      str_append_int(mod_fname, cat);
+  }
+  if (pf->output_fname_root != NULL)
+    str_append_charstr(mod_fname, ".mod");
+
+  if (pf->output_fname_root != NULL) {
+    if (!pf->quiet) fprintf(stderr, "Writing model to %s ...\n",
+                            mod_fname->chars);
+    if (strcmp(pf->output_fname_root, "-") != 0)
+      F = phast_fopen(mod_fname->chars, "w+");
+    else
+      F = stdout;
+    tm_print(F, mod);
+    if (strcmp(pf->output_fname_root, "-") != 0)
+      phast_fclose(F);
+  }
+  if (pf->results != NULL)
+    lol_push_treeModel(pf->results, mod, mod_fname->chars);
+
+  /* output posterior probabilities, if necessary */
+  if (pf->do_bases || pf->do_expected_nsubst ||
+      pf->do_expected_nsubst_tot || pf->do_expected_nsubst_col) {
+    print_post_prob_stats(mod, msa, pf->output_fname_root,
+                          pf->do_bases, pf->do_expected_nsubst,
+                          pf->do_expected_nsubst_tot,
+                          pf->do_expected_nsubst_col, 0,
+                          cat, pf->quiet, NULL);
+  }
+}
+
+/* GC content of each sequence of msa (ignoring gaps and missing
+   data), for the window summary */
+static double *pf_window_gc(MSA *msa) {
+  double *gc = smalloc(msa->nseqs * sizeof(double)), total;
+  int i, j;
+  char c;
+  for (i=0; i < msa->nseqs; i++) {
+    total = 0;
+    gc[i] = 0;
+    if (msa->seqs == NULL && msa->ss->tuple_idx == NULL) {
+      /* unordered sufficient stats; weight tuples by counts */
+      for (j = 0; j < msa->ss->ntuples; j++) {
+        c = ss_get_char_tuple(msa, j, i, 0);
+        if ((!msa->is_missing[(int)c]) && c != GAP_CHAR) {
+          total += msa->ss->counts[j];
+          if (c=='C' || c=='G') gc[i] += msa->ss->counts[j];
+        }
+      }
+    }
+    else {
+      for (j=0; j<msa->length; j++) {
+        c = msa_get_char(msa, i, j);
+        if ((!msa->is_missing[(int)c]) && c != GAP_CHAR) {
+          total++;
+          if (c=='C' || c=='G') gc[i]++;
+        }
+      }
+    }
+    gc[i] /= total;
+  }
+  return gc;
+}
+
+/* number of threads to use for independent fits.  Options that
+   write to shared files or depend on shared state require serial
+   execution */
+static int pf_nthreads(FitSetup *fs) {
+  struct phyloFit_struct *pf = fs->pf;
+  if (pf->logf != NULL || fs->error_file != NULL || 
+      fs->parsimony_cost_file != NULL || pf->results != NULL || 
+      pf->random_init || pf->do_bases || pf->do_expected_nsubst ||
+      pf->do_expected_nsubst_tot || pf->do_expected_nsubst_col ||
+      (pf->output_fname_root != NULL && 
+       strcmp(pf->output_fname_root, "-") == 0))
+    return 1;
+  return pf->nthreads;
+}
+
+/* fit models to a chain of consecutive windows (job of a thread
+   pool), for all categories or, if wb->split_cats is TRUE, for a
+   single one (the chain is then job / ncats and the category job %
+   ncats).  Each model is fitted to a private copy of the input model,
+   if any; with warm starts, parameters are instead initialized from
+   the previous window of the chain */
+static void pf_fit_window_chain(void *data, int job, int thread) {
+  WindowBatch *wb = data;
+  FitSetup *fs = wb->fs;
+  struct phyloFit_struct *pf = fs->pf;
+  int ncats = lst_size(fs->cats_to_do), i, w,
+    chain = wb->split_cats ? job / ncats : job,
+    cat_beg = wb->split_cats ? job % ncats : 0,
+    cat_end = wb->split_cats ? cat_beg + 1 : ncats,
+    first = chain * WINDOW_CHAIN_LEN, 
+    last = min(first + WINDOW_CHAIN_LEN, wb->nwins);
+  SSWindow *sswin = wb->use_sswindow ? 
+    ss_window_new(wb->source_msa, wb->order_by_appearance) : NULL;
+  TreeModel **prev_mod = smalloc(ncats * sizeof(TreeModel*));
+  String *descr = str_new(STR_SHORT_LEN), *mod_fname = str_new(STR_MED_LEN);
+
+  for (i = 0; i < ncats; i++) prev_mod[i] = NULL;
+
+  for (w = first; w < last; w++) {
+    int win = 2 * (wb->first_win + w), 
+      win_beg = lst_get_int(pf->window_coords, win),
+      win_end = lst_get_int(pf->window_coords, win+1);
+    MSA *msa;
+
+    if (win_beg < 0 || win_end < 0) continue;
+
+    /* note: msa_sub_alignment uses a funny indexing system (see docs) */
+    if (sswin != NULL) {
+      ss_window_set(sswin, win_beg-1, win_end);
+      msa = sswin->msa;
+    }
+    else msa = msa_sub_alignment(wb->source_msa, NULL, 0, win_beg-1, win_end);
+
+    for (i = cat_beg; i < cat_end; i++) {
+      WindowFit tmpfit, *wf = wb->print_now ? &tmpfit : 
+        &wb->fits[w * ncats + i];
+      int cat = lst_get_int(fs->cats_to_do, i);
+      TreeModel *mod = pf_setup_model(fs, pf->input_mod == NULL ? NULL :
+                                      tm_create_copy(pf->input_mod), msa);
+
+      pf_describe_fit(fs, descr, cat, win);
+      if (!pf_fit_model(fs, mod, msa, cat, sswin == NULL && i == 0,
+                        pf->window_warm_start ? prev_mod[i] : NULL, 
+                        descr, &wf->ninf_sites)) {
+        tm_free(mod);
+        continue;
+      }
+      pf_output_model(fs, mod, msa, mod_fname, cat, win);
+      if (wb->print_now) {
+        double *gc = pf_window_gc(msa);
+        print_window_summary(wb->WINDOWF, pf->window_coords, win, cat, mod,
+                             gc, wf->ninf_sites, msa->nseqs, FALSE);
+        sfree(gc);
+        if (prev_mod[i] != NULL) tm_free(prev_mod[i]);
+      }
+      else {
+        wf->gc = pf_window_gc(msa);
+        wf->mod = mod;
+      }
+      prev_mod[i] = mod;
+    }
+    if (sswin == NULL) msa_free(msa);
+  }
+
+  if (sswin != NULL) ss_window_free(sswin);
+  for (i = cat_beg; wb->print_now && i < cat_end; i++)
+    if (prev_mod[i] != NULL) tm_free(prev_mod[i]);
+  sfree(prev_mod);
+  str_free(descr);
+  str_free(mod_fname);
+}
+
+/* fit models to all windows of source_msa, in parallel if requested.
+   Windows are divided into chains of WINDOW_CHAIN_LEN, which are
+   processed in batches; summaries are printed in window order after
+   each batch.  When the sufficient statistics of windows are
+   maintained incrementally, the categories of a chain are fitted by
+   separate jobs */
+static void pf_fit_windows(FitSetup *fs, MSA *source_msa, FILE *WINDOWF) {
+  struct phyloFit_struct *pf = fs->pf;
+  int ncats = lst_size(fs->cats_to_do), 
+    nwins = lst_size(pf->window_coords) / 2,
+    nthreads = pf_nthreads(fs), post_probs, batch_size, w, i, nchains;
+  ThreadPool *tp;
+  WindowBatch wb;
+
+  post_probs = (pf->do_bases || pf->do_expected_nsubst ||
+                pf->do_expected_nsubst_tot || pf->do_expected_nsubst_col);
+
+  /* maintain sufficient statistics incrementally as the window
+     slides, unless options require explicit sub-alignments */
+  wb.use_sswindow = (!pf->do_column_probs && !post_probs &&
+                     !subst_mod_is_codon_model(fs->subst_mod) &&
+                     (source_msa->ss == NULL ? source_msa->seqs != NULL :
+                      source_msa->ss->tuple_idx != NULL));
+  /* order tuples as ss_from_msas would for explicit sequences, and
+     as ss_sub_alignment would for sufficient statistics */
+  wb.order_by_appearance = (source_msa->ss == NULL);
+  if (wb.use_sswindow) {
+    if (source_msa->ss == NULL) {
+      if (!pf->quiet)
+        fprintf(stderr, "Extracting sufficient statistics ...\n");
+      ss_from_msas(source_msa, tm_order(fs->subst_mod)+1, TRUE, NULL, 
+                   NULL, NULL, -1, FALSE);
+    }
+    if (!pf->likelihood_only) {
+      if (!pf->quiet) fprintf(stderr, "Compacting sufficient statistics ...\n");
+      ss_collapse_missing(source_msa, !pf->gaps_as_bases);
+    }
+  }
+
+  /* tm_create_copy may compute a traversal of the input tree; do it
+     here before the threads start */
+  if (pf->input_mod != NULL && pf->input_mod->tree != NULL)
+    tr_postorder(pf->input_mod->tree);
+
+  tp = tp_new(nthreads);
+  wb.fs = fs;
+  wb.source_msa = source_msa;
+  wb.WINDOWF = WINDOWF;
+  wb.print_now = (tp_nthreads(tp) == 1);
+  /* (with explicit sub-alignments, missing data are collapsed while
+     fitting the first category, so the categories of a window must be
+     fitted together) */
+  wb.split_cats = (!wb.print_now && wb.use_sswindow && ncats > 1);
+  batch_size = wb.print_now ? nwins : 
+    tp_nthreads(tp) * WINDOW_CHAINS_PER_BATCH * WINDOW_CHAIN_LEN;
+  wb.fits = wb.print_now ? NULL : 
+    smalloc(min(batch_size, nwins) * ncats * sizeof(WindowFit));
+
+  for (wb.first_win = 0; wb.first_win < nwins; wb.first_win += batch_size) {
+    wb.nwins = min(batch_size, nwins - wb.first_win);
+    for (w = 0; !wb.print_now && w < wb.nwins * ncats; w++) {
+      wb.fits[w].mod = NULL;
+      wb.fits[w].gc = NULL;
+    }
+
+    nchains = (wb.nwins + WINDOW_CHAIN_LEN - 1) / WINDOW_CHAIN_LEN;
+    tp_run(tp, wb.split_cats ? nchains * ncats : nchains, 
+           pf_fit_window_chain, &wb);
+
+    for (w = 0; !wb.print_now && w < wb.nwins; w++) {
+      for (i = 0; i < ncats; i++) {
+        WindowFit *wf = &wb.fits[w * ncats + i];
+        if (wf->mod == NULL) continue;
+        print_window_summary(WINDOWF, pf->window_coords, 
+                             2 * (wb.first_win + w), 
+                             lst_get_int(fs->cats_to_do, i), wf->mod, 
+                             wf->gc, wf->ninf_sites, source_msa->nseqs, 
+                             FALSE);
+        tm_free(wf->mod);
+        sfree(wf->gc);
+      }
+    }
+  }
+
+  if (wb.fits != NULL) sfree(wb.fits);
+  tp_free(tp);
+}
+
+/* fit the model of the job-th category to the whole alignment (job of
+   a thread pool) */
+static void pf_fit_category(void *data, int job, int thread) {
+  CategoryBatch *cb = data;
+  FitSetup *fs = cb->fs;
+  int cat = lst_get_int(fs->cats_to_do, job);
+  unsigned int ninf_sites;
+  String *descr = str_new(STR_SHORT_LEN), *mod_fname;
+  TreeModel *mod;
+
+  mod = pf_setup_model(fs, cb->input_mod == NULL ? NULL :
+                       tm_create_copy(cb->input_mod), cb->msa);
+  pf_describe_fit(fs, descr, cat, 0);
+  if (!pf_fit_model(fs, mod, cb->msa, cat, cb->collapse && job == 0, NULL,
+                    descr, &ninf_sites)) {
+    tm_free(mod);
+    mod = NULL;
+  }
+  else if (cb->print_now) {
+    mod_fname = str_new(STR_MED_LEN);
+    pf_output_model(fs, mod, cb->msa, mod_fname, cat, 0);
+    str_free(mod_fname);
+    tm_free(mod);
+    mod = NULL;
+  }
+  cb->mods[job] = mod;
+  str_free(descr);
+}
+
+/* fit a model for each category to msa, in parallel if requested, and
+   output the models in the order of the categories.  Each category is
+   fitted to a private copy of input_mod (if non-NULL), so that every
+   category starts from the same initial model, however many threads
+   are used */
+static void pf_fit_categories(FitSetup *fs, TreeModel *input_mod, 
+                              MSA *msa) {
+  struct phyloFit_struct *pf = fs->pf;
+  int ncats = lst_size(fs->cats_to_do), nthreads = pf_nthreads(fs), i;
+  String *mod_fname;
+  ThreadPool *tp;
+  CategoryBatch cb;
+
+  if (pf->likelihood_only)      /* (column probabilities are computed
+                                   with shared sufficient statistics) */
+    nthreads = 1;
+  tp = tp_new(ncats > 1 ? nthreads : 1);
+
+  cb.fs = fs;
+  cb.input_mod = input_mod;
+  cb.msa = msa;
+  cb.print_now = (tp_nthreads(tp) == 1);
+  cb.collapse = cb.print_now;
+  cb.mods = smalloc(ncats * sizeof(TreeModel*));
+
+  if (!cb.print_now) {
+    /* prepare the shared alignment as the first fit would in serial
+       execution: sufficient statistics are extracted, and missing data
+       are collapsed unless the first category is skipped */
+    if (msa->ss == NULL) {
+      if (!pf->quiet)
+        fprintf(stderr, "Extracting sufficient statistics ...\n");
+      ss_from_msas(msa, tm_order(fs->subst_mod)+1, 0,
+                   pf->cats_to_do_str != NULL ? fs->cats_to_do : NULL,
+                   NULL, NULL, -1, subst_mod_is_codon_model(fs->subst_mod));
+      if (msa->length > 1000000) { /* as in pf_fit_model */
+        for (i = 0; i < msa->nseqs; i++) sfree(msa->seqs[i]);
+        sfree(msa->seqs);
+        msa->seqs = NULL;
+      }
+    }
+    if (!pf->parsimony_only &&
+        msa_ninformative_sites(msa, lst_get_int(fs->cats_to_do, 0)) >=
+        pf->nsites_threshold) {
+      if (!pf->quiet) fprintf(stderr, "Compacting sufficient statistics ...\n");
+      ss_collapse_missing(msa, !pf->gaps_as_bases);
+    }
+
+    /* tm_create_copy may compute a traversal of the input tree; do it
+       here before the threads start */
+    if (input_mod != NULL && input_mod->tree != NULL)
+      tr_postorder(input_mod->tree);
+  }
+
+  tp_run(tp, ncats, pf_fit_category, &cb);
+
+  mod_fname = str_new(STR_MED_LEN);
+  for (i = 0; !cb.print_now && i < ncats; i++) {
+    if (cb.mods[i] == NULL) continue;
+    pf_output_model(fs, cb.mods[i], msa, mod_fname, 
+                    lst_get_int(fs->cats_to_do, i), 0);
+    tm_free(cb.mods[i]);
+  }
+  str_free(mod_fname);
+  sfree(cb.mods);
+  tp_free(tp);
+}
+
+int run_phyloFit(struct phyloFit_struct *pf) {
+  FILE *WINDOWF=NULL;
+  int i, j, root_leaf_id = -1;
   List *cats_to_do=NULL;
-  double *gc=NULL;
   char tmpchstr[STR_MED_LEN];
   FILE *parsimony_cost_file = NULL;
+  FitSetup fs;
   int free_cm = FALSE, free_cats_to_do_str=FALSE, free_tree=FALSE,
     free_window_coords = FALSE;
 
@@ -679,6 +1414,7 @@ int run_phyloFit(struct phyloFit_struct *pf) {
   int subst_mod = pf->subst_mod;
   TreeNode *tree = pf->tree;
   GFF_Set *gff = pf->gff;
+  GFF_CompactSet *cgff = pf->gff_compact;
   int quiet = pf->quiet;
   TreeModel *input_mod = pf->input_mod;
   FILE *error_file=NULL;
@@ -721,6 +1457,10 @@ int run_phyloFit(struct phyloFit_struct *pf) {
     pf->cm = cm_new_from_features(gff);
     free_cm = TRUE;
   }
+  else if (cgff != NULL && pf->cm == NULL) {
+    pf->cm = cm_new_from_compact_features(cgff);
+    free_cm = TRUE;
+  }
 
   if (pf->subtree_name != NULL && pf->estimate_scale_only == FALSE) {
     if (!quiet)
@@ -845,6 +1585,20 @@ int run_phyloFit(struct phyloFit_struct *pf) {
     if (!quiet) fprintf(stderr, "Labeling alignment sites by category ...\n");
     msa_label_categories(msa, gff, pf->cm);
   }
+  else if (cgff != NULL && pf->label_categories) {
+    /* same as above, without reverse complementation, for a compact
+       feature set */
+    if (msa->idx_offset > 0) {
+      for (i = 0; i < cgff->nfeatures; i++) {
+        cgff->start[i] -= msa->idx_offset;
+        cgff->end[i] -= msa->idx_offset;
+      }
+      msa->idx_offset = 0;
+    }
+    msa_map_gffc_coords(msa, cgff, 1, 0, 0);
+    if (!quiet) fprintf(stderr, "Labeling alignment sites by category ...\n");
+    msa_label_categories_compact(msa, cgff, pf->cm);
+  }
   else if (pf->nonoverlapping && pf->label_categories) {
                                 /* (already taken care of if MAF) */
     int cycle_size = tm_order(subst_mod) + 1;
@@ -924,356 +1678,22 @@ int run_phyloFit(struct phyloFit_struct *pf) {
     error_file = phast_fopen(pf->error_fname, "w");
 
   /* now estimate models (window by window, if necessary) */
-  mod_fname = str_new(STR_MED_LEN);
-  source_msa = msa;
-  for (win = 0;
-       win < (pf->window_coords == NULL ? 1 : lst_size(pf->window_coords));
-       win += 2) {
-    int win_beg, win_end;
-
-    if (pf->window_coords != NULL) {
-      win_beg = lst_get_int(pf->window_coords, win);
-      win_end = lst_get_int(pf->window_coords, win+1);
-      if (win_beg < 0 || win_end < 0) continue;
-
-      /* note: msa_sub_alignment uses a funny indexing system (see docs) */
-      msa = msa_sub_alignment(source_msa, NULL, 0, win_beg-1, win_end);
-    }
-
-    /* process each category */
-    for (i = 0; i < lst_size(cats_to_do); i++) {
-      TreeModel *mod;
-      Vector *params = NULL;
-      List *pruned_names;
-      int old_nnodes, cat = lst_get_int(cats_to_do, i);
-      unsigned int ninf_sites;
-
-      if (input_mod == NULL)
-        mod = tm_new(tr_create_copy(tree), NULL, NULL, subst_mod,
-                     msa->alphabet, pf->nratecats == -1 ? 1 : pf->nratecats,
-		     pf->alpha, pf->rate_consts, root_leaf_id);
-      else if (pf->likelihood_only)
-        mod = input_mod;
-      else {
-	List *rate_consts, *freq;
-	double alpha;
-	int nratecats;
-
-	if (pf->nratecats != -1) {
-	  nratecats = pf->nratecats;
-	  alpha = pf->alpha;
-	  rate_consts = pf->rate_consts;
-	  freq = NULL;
-	} else {
-	  nratecats = input_mod->nratecats;
-	  alpha = input_mod->alpha;
-	  if (input_mod->rK != NULL) {
-	    rate_consts = lst_new_dbl(input_mod->nratecats);
-	    for (j=0; j < input_mod->nratecats; j++)
-	      lst_push_dbl(rate_consts, input_mod->rK[j]);
-	  } else rate_consts = NULL;
-	  if (input_mod->freqK != NULL) {
-	    freq = lst_new_dbl(input_mod->nratecats);
-	    for (j=0; j < input_mod->nratecats; j++)
-	      lst_push_dbl(freq, input_mod->freqK[j]);
-	  } else freq = NULL;
-	}
-        mod = input_mod;
-        tm_reinit(mod, subst_mod, nratecats, alpha,
-		  rate_consts, freq);
-	if (rate_consts != pf->rate_consts)
-	  lst_free(rate_consts);
-	if (freq != NULL)
-	  lst_free(freq);
-      }
-
-      if (pf->use_selection) {
-	mod->selection_idx = 0;
-	mod->selection = pf->selection;
-      }
-
-      mod->noopt_arg = pf->nooptstr == NULL ? NULL : str_new_charstr(pf->nooptstr->chars);
-      mod->eqfreq_sym = pf->symfreq || subst_mod == SSREV;
-      if (pf->bound_arg != NULL) {
-	mod->bound_arg = lst_new_ptr(lst_size(pf->bound_arg));
-	for (j=0; j < lst_size(pf->bound_arg); j++) {
-	  String *tmp = lst_get_ptr(pf->bound_arg, j);
-	  lst_push_ptr(mod->bound_arg, str_new_charstr(tmp->chars));
-	}
-      } else mod->bound_arg = NULL;
-
-      mod->use_conditionals = pf->use_conditionals;
-
-      if (pf->estimate_scale_only ||
-	  pf->estimate_backgd ||
-	  pf->no_rates ||
-	  pf->assume_clock) {
-        if (pf->estimate_scale_only) {
-          mod->estimate_branchlens = TM_SCALE_ONLY;
-
-          if (pf->subtree_name != NULL) { /* estimation of subtree scale */
-            String *s1 = str_new_charstr(pf->subtree_name),
-              *s2 = str_new_charstr(pf->subtree_name);
-            str_root(s1, ':'); str_suffix(s2, ':'); /* parse string */
-            mod->subtree_root = tr_get_node(mod->tree, s1->chars);
-            if (mod->subtree_root == NULL) {
-	      tr_name_ancestors(mod->tree);
-	      mod->subtree_root = tr_get_node(mod->tree, s1->chars);
-	      if (mod->subtree_root == NULL)
-		die("ERROR: no node named '%s'.\n", s1->chars);
-	    }
-            if (s2->length > 0) {
-              if (str_equals_charstr(s2, "loss"))
-		mod->scale_sub_bound = LB;
-              else if (str_equals_charstr(s2, "gain"))
-		mod->scale_sub_bound = UB;
-              else die("ERROR: unrecognized suffix '%s'\n", s2->chars);
-            }
-            str_free(s1); str_free(s2);
-          }
-        }
-
-        else if (pf->assume_clock)
-          mod->estimate_branchlens = TM_BRANCHLENS_CLOCK;
-
-        if (pf->no_rates)
-          mod->estimate_ratemat = FALSE;
-
-        mod->estimate_backgd = pf->estimate_backgd;
-      }
-
-      if (pf->no_branchlens)
-	mod->estimate_branchlens = TM_BRANCHLENS_NONE;
-
-      if (pf->ignore_branches != NULL)
-        tm_set_ignore_branches(mod, pf->ignore_branches);
-
-      old_nnodes = mod->tree->nnodes;
-      pruned_names = lst_new_ptr(msa->nseqs);
-      tm_prune(mod, msa, pruned_names);
-      if (lst_size(pruned_names) == (old_nnodes + 1) / 2)
-        die("ERROR: no match for leaves of tree in alignment (leaf names must match alignment names).\n");
-      if (!quiet && lst_size(pruned_names) > 0) {
-        fprintf(stderr, "WARNING: pruned away leaves of tree with no match in alignment (");
-        for (j = 0; j < lst_size(pruned_names); j++)
-          fprintf(stderr, "%s%s", ((String*)lst_get_ptr(pruned_names, j))->chars,
-                  j < lst_size(pruned_names) - 1 ? ", " : ").\n");
-      }
-      lst_free_strings(pruned_names);
-      lst_free(pruned_names);
-
-      if (pf->alt_mod_str != NULL) {
-	for (j = 0 ; j < lst_size(pf->alt_mod_str); j++)
-	  tm_add_alt_mod(mod, (String*)lst_get_ptr(pf->alt_mod_str, j));
-      }
-
-      str_clear(tmpstr);
-
-      if  (pf->msa_fname != NULL)
-	str_append_charstr(tmpstr, pf->msa_fname);
-      else str_append_charstr(tmpstr, "alignment");
-
-      if (cat != -1 || pf->window_coords != NULL) {
-	str_append_charstr(tmpstr, " (");
-	if (cat != -1) {
-	  str_append_charstr(tmpstr, "category ");
-	  str_append_int(tmpstr, cat);
-	}
-
-	if (pf->window_coords != NULL) {
-	  if (cat != -1) str_append_charstr(tmpstr, ", ");
-	  str_append_charstr(tmpstr, "window ");
-	  str_append_int(tmpstr, win/2 + 1);
-	}
-
-	str_append_char(tmpstr, ')');
-      }
-
-      ninf_sites = msa_ninformative_sites(msa, cat);
-      if (ninf_sites < pf->nsites_threshold) {
-        if (input_mod == NULL) tm_free(mod);
-        fprintf(stderr, "Skipping %s; insufficient informative sites ...\n",
-                tmpstr->chars);
-        continue;
-      }
-
-      if (pf->init_parsimony) {
-	double parsimony_cost = tm_params_init_branchlens_parsimony(NULL, mod, msa, cat);
-        if (parsimony_cost_file != NULL)
-           fprintf(parsimony_cost_file, "%f\n", parsimony_cost);
-        if (pf->parsimony_only) continue;
-      }
-
-      if (pf->likelihood_only) {
-        double *col_log_probs = pf->do_column_probs ?
-          smalloc(msa->length * sizeof(double)) : NULL;
-        String *colprob_fname;
-        if (!quiet)
-          fprintf(stderr, "Computing likelihood of %s ...\n", tmpstr->chars);
-        tm_set_subst_matrices(mod);
-        if (pf->do_column_probs && msa->ss != NULL && msa->ss->tuple_idx == NULL) {
-          msa->ss->tuple_idx = smalloc(msa->length * sizeof(int));
-          for (j = 0; j < msa->length; j++)
-            msa->ss->tuple_idx[j] = j;
-        }
-        mod->lnL = tl_compute_log_likelihood(mod, msa, col_log_probs, NULL, cat, NULL) *
-          log(2);
-        if (pf->do_column_probs) {
-	  //we don't need to implement this in RPHAST because there is
-	  //already a msa.likelihood function
-	  if (pf->output_fname_root == NULL)
-	    die("ERROR: currently do_column_probs requires output file");
-          colprob_fname = str_new_charstr(pf->output_fname_root);
-          str_append_charstr(colprob_fname, ".colprobs");
-          if (!quiet)
-            fprintf(stderr, "Writing column probabilities to %s ...\n",
-                    colprob_fname->chars);
-	  if (strcmp(pf->output_fname_root, "-") != 0)
-            F = phast_fopen(colprob_fname->chars, "w+");
-	  else
-            F = stdout;
-          for (j = 0; j < msa->length; j++)
-            fprintf(F, "%d\t%.6f\n", j, col_log_probs[j]);
-	  if (strcmp(pf->output_fname_root, "-") != 0)
-	    phast_fclose(F);
-          str_free(colprob_fname);
-          sfree(col_log_probs);
-        }
-      }
-      else {                    /* fit model */
-
-        if (msa->ss == NULL) {    /* get sufficient stats if necessary */
-          if (!quiet)
-            fprintf(stderr, "Extracting sufficient statistics ...\n");
-          ss_from_msas(msa, mod->order+1, 0,
-                       pf->cats_to_do_str != NULL ? cats_to_do : NULL,
-                       NULL, NULL, -1, subst_mod_is_codon_model(mod->subst_mod));
-          /* (sufficient stats obtained only for categories of interest) */
-
-          if (msa->length > 1000000) { /* throw out original data if
-                                          very large */
-            for (j = 0; j < msa->nseqs; j++) sfree(msa->seqs[j]);
-            sfree(msa->seqs);
-            msa->seqs = NULL;
-          }
-        }
-        if (pf->random_init)
-          params = tm_params_init_random(mod);
-        else if (input_mod != NULL)
-          params = tm_params_new_init_from_model(input_mod);
-	else
-          params = tm_params_init(mod, .1, 5, pf->alpha);
-
-	if (pf->init_parsimony)
-	  tm_params_init_branchlens_parsimony(params, mod, msa, cat);
-
-        if (input_mod != NULL && mod->backgd_freqs != NULL && !pf->no_freqs && pf->init_backgd_from_data) {
-          /* in some cases, the eq freqs are needed for
-             initialization, but now they should be re-estimated --
-             UNLESS user specifies --no-freqs */
-	  vec_free(mod->backgd_freqs);
-	  mod->backgd_freqs = NULL;
-        }
-
-
-        if (i == 0) {
-          if (!quiet) fprintf(stderr, "Compacting sufficient statistics ...\n");
-          ss_collapse_missing(msa, !pf->gaps_as_bases);
-                                /* reduce number of tuples as much as
-                                   possible */
-        }
-
-        if (!quiet) {
-          fprintf(stderr, "Fitting tree model to %s using %s%s ...\n",
-                  tmpstr->chars, tm_get_subst_mod_string(subst_mod),
-                  mod->nratecats > 1 ? " (with rate variation)" : "");
-        }
-
-        if (pf->use_em)
-          tm_fit_em(mod, msa, params, cat, pf->precision, pf->max_em_its, pf->logf, error_file);
-        else
-          tm_fit(mod, msa, params, cat, pf->precision, pf->logf, pf->quiet, error_file);
-      }
-
-      if (pf->output_fname_root != NULL)
-	str_cpy_charstr(mod_fname, pf->output_fname_root);
-      else str_clear(mod_fname);
-      if (pf->window_coords != NULL) {
-	if (mod_fname->length != 0)
-	  str_append_char(mod_fname, '.');
-        str_append_charstr(mod_fname, "win-");
-        str_append_int(mod_fname, win/2 + 1);
-      }
-      if (cat != -1 && pf->nonoverlapping == FALSE) {
-	if (mod_fname->length != 0)
-	  str_append_char(mod_fname, '.');
-        if (pf->cm != NULL)
-          str_append(mod_fname, cm_get_feature_unique(pf->cm, cat));
-        else
-          str_append_int(mod_fname, cat);
-      }
-      if (pf->output_fname_root != NULL)
-	str_append_charstr(mod_fname, ".mod");
-
-      if (pf->output_fname_root != NULL) {
-	if (!quiet) fprintf(stderr, "Writing model to %s ...\n",
-			    mod_fname->chars);
-	if (strcmp(pf->output_fname_root, "-") != 0)
-          F = phast_fopen(mod_fname->chars, "w+");
-        else
-          F = stdout;
-	tm_print(F, mod);
-	if (strcmp(pf->output_fname_root, "-") != 0)
-	  phast_fclose(F);
-      }
-      if (pf->results != NULL)
-	lol_push_treeModel(pf->results, mod, mod_fname->chars);
-
-      /* output posterior probabilities, if necessary */
-      if (pf->do_bases || pf->do_expected_nsubst ||
-	  pf->do_expected_nsubst_tot || pf->do_expected_nsubst_col) {
-	print_post_prob_stats(mod, msa, pf->output_fname_root,
-			      pf->do_bases, pf->do_expected_nsubst,
-			      pf->do_expected_nsubst_tot,
-			      pf->do_expected_nsubst_col, 0,
-			      cat, quiet, NULL);
-      }
-
-      /* print window summary, if window mode */
-      if (pf->window_coords != NULL) {
-	int i, j, total=0;
-	char c;
-	if (gc == NULL)
-	  gc = smalloc(msa->nseqs*sizeof(double));
-	for (i=0; i < msa->nseqs; i++) {
-	  total=0;
-	  gc[i]=0;
-	  for (j=0; j<msa->length; j++) {
-	    c = msa_get_char(msa, i, j);
-	    if ((!msa->is_missing[(int)c]) && c != GAP_CHAR) {
-	      total++;
-	      if (c=='C' || c=='G') gc[i]++;
-	    }
-	  }
-	  gc[i] /= (double)total;
-	}
-        print_window_summary(WINDOWF, pf->window_coords, win, cat, mod, gc,
-                             ninf_sites, msa->nseqs, FALSE);
-      }
-
-      if (input_mod == NULL) tm_free(mod);
-      if (params != NULL) vec_free(params);
-    }
-    if (pf->window_coords != NULL)
-      msa_free(msa);
-  }
+  fs.pf = pf;
+  fs.tree = tree;
+  fs.cats_to_do = cats_to_do;
+  fs.subst_mod = subst_mod;
+  fs.root_leaf_id = root_leaf_id;
+  fs.error_file = error_file;
+  fs.parsimony_cost_file = parsimony_cost_file;
+  if (pf->window_coords != NULL)
+    pf_fit_windows(&fs, msa, WINDOWF);
+  else
+    pf_fit_categories(&fs, input_mod, msa);
   if (WINDOWF != NULL && strcmp(pf->output_fname_root, "-") != 0)
     phast_fclose(WINDOWF);
 
   if (error_file != NULL) phast_fclose(error_file);
   if (parsimony_cost_file != NULL) phast_fclose(parsimony_cost_file);
-  str_free(mod_fname);
-  str_free(tmpstr);
   if (free_cm) {
     cm_free(pf->cm);
     pf->cm = NULL;
@@ -1290,7 +1710,5 @@ int run_phyloFit(struct phyloFit_struct *pf) {
     lst_free(pf->window_coords);
     pf->window_coords = NULL;
   }
-  if (gc != NULL)
-    sfree(gc);
   return 0;
 }
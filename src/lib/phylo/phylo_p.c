@@ -24,6 +24,7 @@
 #include "fit_column.h"
 #include "fit_feature.h"
 #include "trees.h"
+#include "wig.h"
 
 
 /* initialize phyloP options to default (may be different for rphast) */
@@ -38,6 +39,7 @@ struct phyloP_struct *phyloP_struct_new(int rphast) {
   
   p->output_wig = FALSE;
   p->output_gff = FALSE;
+  p->bigwig_fname = NULL;
 
   p->fit_model = FALSE;
   p->base_by_base = FALSE;
@@ -49,6 +51,7 @@ struct phyloP_struct *phyloP_struct_new(int rphast) {
   p->chrom = NULL;
   p->branch_name = NULL;
   p->feats = NULL;
+  p->feats_compact = NULL;
   p->method = SPH;
   p->mode = CON;
   p->outfile = rphast ? NULL : stdout;
@@ -60,6 +63,7 @@ struct phyloP_struct *phyloP_struct_new(int rphast) {
   p->mod_fname = NULL;
   p->msa_fname = NULL;
   p->no_prune = FALSE;
+  p->nthreads = 1;
 
   p->results = rphast ? lol_new(20) : NULL;
   return p;
@@ -132,19 +136,21 @@ TreeModel* fit_tree_model(TreeModel *source_mod, MSA *msa,
 
 void phyloP(struct phyloP_struct *p) {
   /* variables for options that are passed through p */
-  int nsites, fit_model, base_by_base, refidx;
+  int nsites, fit_model, base_by_base, refidx, has_feats;
   int prior_only, post_only, quantiles_only,
     output_wig, output_gff;
   double ci, epsilon;
   char *subtree_name, *chrom;
   List *branch_name;
   GFF_Set *feats;
+  GFF_CompactSet *cfeats;
   method_type method;
   mode_type mode;
   FILE *logf;
   char *mod_fname, *msa_fname, *help;
   FILE *outfile;
   ListOfLists *results;
+  WigWriter *wig = NULL;
 
   /* other variables */
   TreeModel *mod, *mod_fitted = NULL;
@@ -173,6 +179,7 @@ void phyloP(struct phyloP_struct *p) {
   chrom = p->chrom;
   branch_name = p->branch_name;
   feats = p->feats;
+  cfeats = p->feats_compact;
   method = p->method;
   mode = p->mode;
   logf = p->logf;
@@ -204,9 +211,16 @@ void phyloP(struct phyloP_struct *p) {
     die("ERROR: --quantiles can only be used with --null or --posterior.\n");
   if (subtree_name != NULL && quantiles_only)
     die("ERROR: --quantiles cannot be used with --subtree.\n");
-  if (feats != NULL && (fit_model || prior_only || post_only))
+  /* the compact feature set is used directly only in the --features
+     case of SPH without --subtree; convert it elsewhere */
+  if (cfeats != NULL && (method != SPH || subtree_name != NULL)) {
+    if (feats == NULL) feats = gffc_to_gff_set(cfeats);
+    cfeats = NULL;
+  }
+  has_feats = (feats != NULL || cfeats != NULL);
+  if (has_feats && (fit_model || prior_only || post_only))
     die("ERROR: --features cannot be used with --null, --posterior, or --fit-model.\n");
-  if (base_by_base && (ci != -1 || feats!=NULL || prior_only || post_only))
+  if (base_by_base && (ci != -1 || has_feats || prior_only || post_only))
     die("ERROR: --wig-scores and --base-by-base cannot be used with --null, --posterior, --features, --quantiles, or --confidence-interval.\n");
   if (method == GERP && subtree_name != NULL)
     die("ERROR: --subtree not supported with --method GERP.\n");
@@ -214,10 +228,14 @@ void phyloP(struct phyloP_struct *p) {
     die("ERROR --branch not supported with --method GERP or --method SPH\n");
   if (branch_name != NULL && subtree_name != NULL)
     die("ERROR: can use only one of --subtree or --branch options\n");
-  if (method != SPH && feats==NULL && !base_by_base)
+  if (method != SPH && !has_feats && !base_by_base)
     die("ERROR: need base-by-base, wig-scores, or features unless method is SPH\n");
   if (prior_only && msa==NULL && nsites < 0)
     die("ERROR: need to specify nsites or msa to get prior");
+  if (output_wig && p->bigwig_fname != NULL)
+    wig = wig_writer_new_bigwig(p->bigwig_fname);
+  else if (output_wig && outfile != NULL)
+    wig = wig_writer_new(outfile, 3);
   if (!prior_only) {
     if (msa->ss == NULL)
       ss_from_msas(msa, 1, TRUE, NULL, NULL, NULL, -1, 0);
@@ -225,7 +243,7 @@ void phyloP(struct phyloP_struct *p) {
     if (msa_alph_has_lowercase(msa)) msa_toupper(msa);     
     msa_remove_N_from_alph(msa);
 
-    if ((feats != NULL || base_by_base) && msa->ss->tuple_idx == NULL)
+    if ((has_feats || base_by_base) && msa->ss->tuple_idx == NULL)
       die("ERROR: ordered alignment required.\n");
 
      if (p->no_prune) {
@@ -301,11 +319,18 @@ void phyloP(struct phyloP_struct *p) {
     if (lst_size(feats->features) == 0)
       die("ERROR: no features fall in alignment");
   }
+  else if (cfeats != NULL) {
+    if (msa->idx_offset > 0)
+      gffc_add_offset(cfeats, -(msa->idx_offset), msa_seqlen(msa, 0));
+    msa_map_gffc_coords(msa, cfeats, p->refidx_feat, 0, 0);
+    if (cfeats->nfeatures == 0)
+      die("ERROR: no features fall in alignment");
+  }
 
   /* SPH method */
   if (method == SPH) {
     /* fit model to whole data set if necessary */
-    if (fit_model && (!base_by_base && feats == NULL)) 
+    if (fit_model && (!base_by_base && !has_feats)) 
       mod_fitted = fit_tree_model(mod, msa, subtree_name, &scale, &sub_scale);
 
     /* set up for subtree mode */
@@ -350,8 +375,8 @@ void phyloP(struct phyloP_struct *p) {
         sub_pval_per_site(jp, msa, mode, fit_model, &prior_mean, &prior_var, 
                           pvals, post_means, post_vars, logf);
 
-        if (outfile != NULL && output_wig)
-          print_wig(outfile, msa, pvals, chrom, refidx, TRUE, NULL);
+        if (wig != NULL)
+          print_wig(wig, msa, pvals, chrom, refidx, TRUE, NULL);
 	if ((outfile != NULL && !output_wig) || results!=NULL) {
 	  char str[1000];
 	  sprintf(str, "#neutral mean = %.3f var = %.3f\n#post_mean post_var pval", 
@@ -363,7 +388,7 @@ void phyloP(struct phyloP_struct *p) {
                              "post.var", post_vars, "pval", pvals);
         }
       }
-      else if (feats == NULL) {
+      else if (!has_feats) {
         double post_mean, post_var;
 
         /* compute distributions and stats*/
@@ -389,6 +414,17 @@ void phyloP(struct phyloP_struct *p) {
                   post_mean, post_var, ci, scale, results);
 	if (prior_distrib != NULL) vec_free(prior_distrib);
       }
+      else if (cfeats != NULL) {    /* --features case, compact */
+        p_value_stats *stats = 
+          sub_p_value_many_ranges(jp, msa, cfeats->nfeatures, cfeats->start,
+                                  cfeats->end, ci);
+        msa_map_gffc_coords(msa, cfeats, 0, p->refidx_feat, 0);
+	if (msa->idx_offset > 0)
+	  gffc_add_offset(cfeats, msa->idx_offset, 0);
+        print_feats_sph_compact(outfile, stats, cfeats, mode, epsilon, 
+                                output_gff, results);
+        sfree(stats);
+      }
       else {                        /* --features case */
         p_value_stats *stats = sub_p_value_many(jp, msa, feats->features, ci);
         msa_map_gff_coords(msa, feats, 0, p->refidx_feat, 0);
@@ -419,7 +455,7 @@ void phyloP(struct phyloP_struct *p) {
                                   logf);
 
         if (output_wig) 
-          print_wig(outfile, msa, pvals, chrom, refidx, TRUE, results);
+          print_wig(wig, msa, pvals, chrom, refidx, TRUE, results);
 	if (results != NULL || !output_wig) {
           char str[1000];
           sprintf(str, "#neutral mean_sub = %.3f var_sub = %.3f mean_sup = %.3f  var_sup = %.3f\n#post_mean_sub post_var_sub post_mean_sup post_var_sup pval", 
@@ -492,7 +528,7 @@ void phyloP(struct phyloP_struct *p) {
       if (subtree_name == NULL && branch_name == NULL) { /* no subtree case */
         col_lrts(mod, msa, mode, pvals, scales, llrs, logf);
         if (output_wig) 
-          print_wig(outfile, msa, pvals, chrom, refidx, TRUE, NULL);
+          print_wig(wig, msa, pvals, chrom, refidx, TRUE, NULL);
 	if (results != NULL || !output_wig)
           print_base_by_base(output_wig ? NULL : outfile, 
 			     "#scale lnlratio pval", 
@@ -508,7 +544,7 @@ void phyloP(struct phyloP_struct *p) {
                      llrs, logf);
 
         if (output_wig) 
-          print_wig(outfile, msa, pvals, chrom, refidx, TRUE, NULL);
+          print_wig(wig, msa, pvals, chrom, refidx, TRUE, NULL);
 	if (results != NULL || !output_wig)
           print_base_by_base(output_wig ? NULL : outfile, 
 			     "#null_scale alt_scale alt_subscale lnlratio pval", 
@@ -525,7 +561,8 @@ void phyloP(struct phyloP_struct *p) {
         llrs = smalloc(lst_size(feats->features) * sizeof(double));
       }
       if (subtree_name == NULL && branch_name == NULL) {  /* no subtree case */
-        ff_lrts(mod, msa, feats, mode, pvals, scales, llrs, logf);
+        ff_lrts(mod, msa, feats, mode, pvals, scales, llrs, logf, 
+                p->nthreads);
         msa_map_gff_coords(msa, feats, 0, p->refidx_feat, 0);
 	if (msa->idx_offset > 0)
 	  gff_add_offset(feats, msa->idx_offset, 0);
@@ -543,7 +580,7 @@ void phyloP(struct phyloP_struct *p) {
           sub_scales = smalloc(lst_size(feats->features) * sizeof(double));
         }
         ff_lrts_sub(mod, msa, feats, mode, pvals, null_scales, scales, 
-                    sub_scales, llrs, logf);
+                    sub_scales, llrs, logf, p->nthreads);
         msa_map_gff_coords(msa, feats, 0, p->refidx_feat, 0);
 	if (msa->idx_offset > 0)
 	  gff_add_offset(feats, msa->idx_offset, 0);
@@ -573,7 +610,7 @@ void phyloP(struct phyloP_struct *p) {
         col_score_tests(mod, msa, mode, pvals, derivs, 
                         teststats);
         if (output_wig) 
-          print_wig(outfile, msa, pvals, chrom, refidx, TRUE, NULL);
+          print_wig(wig, msa, pvals, chrom, refidx, TRUE, NULL);
 	if (results != NULL || !output_wig)
           print_base_by_base(output_wig ? NULL : outfile, 
 			     "#deriv teststat pval", 
@@ -591,7 +628,7 @@ void phyloP(struct phyloP_struct *p) {
                             sub_derivs, teststats, logf);
 
         if (output_wig) 
-          print_wig(outfile, msa, pvals, chrom, refidx, TRUE, NULL);
+          print_wig(wig, msa, pvals, chrom, refidx, TRUE, NULL);
 	if (results != NULL || !output_wig)
           print_base_by_base(output_wig ? NULL : outfile, 
 			     "#scale deriv subderiv teststat pval", 
@@ -608,7 +645,8 @@ void phyloP(struct phyloP_struct *p) {
         derivs = smalloc(lst_size(feats->features) * sizeof(double));
       }
       if (subtree_name == NULL && branch_name == NULL) { /* no subtree case */
-        ff_score_tests(mod, msa, feats, mode, pvals, derivs, teststats);
+        ff_score_tests(mod, msa, feats, mode, pvals, derivs, teststats, 
+                       p->nthreads);
         msa_map_gff_coords(msa, feats, 0, p->refidx_feat, 0);
 	if (msa->idx_offset > 0)
 	  gff_add_offset(feats, msa->idx_offset, 0);
@@ -627,7 +665,7 @@ void phyloP(struct phyloP_struct *p) {
           sub_derivs = smalloc(lst_size(feats->features) * sizeof(double));
         }
         ff_score_tests_sub(mod, msa, feats, mode, pvals, null_scales, derivs, 
-                           sub_derivs, teststats, logf);
+                           sub_derivs, teststats, logf, p->nthreads);
         msa_map_gff_coords(msa, feats, 0, p->refidx_feat, 0);
 	if (msa->idx_offset > 0)
 	  gff_add_offset(feats, msa->idx_offset, 0);
@@ -656,7 +694,7 @@ void phyloP(struct phyloP_struct *p) {
       }
       col_gerp(mod, msa, mode, nneut, nobs, nrejected, nspec, logf);
       if (output_wig) 
-        print_wig(outfile, msa, nrejected, chrom, refidx, FALSE, NULL);
+        print_wig(wig, msa, nrejected, chrom, refidx, FALSE, NULL);
       if (results != NULL || !output_wig) {
         print_base_by_base(output_wig ? NULL : outfile, 
 			   "#nneut nobs nrej nspec", chrom, 
@@ -672,7 +710,8 @@ void phyloP(struct phyloP_struct *p) {
         nobs = smalloc(lst_size(feats->features) * sizeof(double));
         nspec = smalloc(lst_size(feats->features) * sizeof(double));
       }
-      ff_gerp(mod, msa, feats, mode, nneut, nobs, nrejected, nspec, logf);
+      ff_gerp(mod, msa, feats, mode, nneut, nobs, nrejected, nspec, logf, 
+              p->nthreads);
       msa_map_gff_coords(msa, feats, 0, p->refidx_feat, 0);
       if (msa->idx_offset > 0)
 	gff_add_offset(feats, msa->idx_offset, 0);
@@ -700,6 +739,7 @@ void phyloP(struct phyloP_struct *p) {
   if (nneut != NULL) sfree(nneut);
   if (nobs != NULL) sfree(nobs);
   if (nspec != NULL) sfree(nspec);
+  if (wig != NULL) wig_writer_free(wig);
 } 
 
 
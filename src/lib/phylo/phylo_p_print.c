@@ -424,24 +424,17 @@ void print_p_joint(FILE *outfile, char *node_name, char *mod_fname,
   }
 }
 
-/* Features output for SPH without subtree */
-void print_feats_sph(FILE *outfile, p_value_stats *stats, GFF_Set *feats,
-                     mode_type mode, double epsilon, int output_gff,
-		     ListOfLists *result) {
+/* compute p-values (according to mode) and, if post_means != NULL,
+   prior and posterior means and variances for each of n features,
+   for print_feats_sph and print_feats_sph_compact */
+static void feats_sph_stats(p_value_stats *stats, int n, mode_type mode, 
+                            double epsilon, double *pvals, 
+                            double *post_means, double *post_vars, 
+                            double *prior_means, double *prior_vars) {
   int i;
-  double *pvals = smalloc(lst_size(feats->features) * sizeof(double)),
-    *post_means = NULL, *post_vars = NULL, *prior_means = NULL,
-    *prior_vars = NULL;
-
-  if (result != NULL || !output_gff) {
-    post_means = smalloc(lst_size(feats->features) * sizeof(double));
-    post_vars = smalloc(lst_size(feats->features) * sizeof(double));
-    prior_means = smalloc(lst_size(feats->features) * sizeof(double));
-    prior_vars = smalloc(lst_size(feats->features) * sizeof(double));
-  }
-  for (i = 0; i < lst_size(feats->features); i++) {
+  for (i = 0; i < n; i++) {
     checkInterruptN(i, 100);
-    if (result != NULL || !output_gff) {
+    if (post_means != NULL) {
       post_means[i] = stats[i].post_mean;
       post_vars[i] = stats[i].post_var;
       prior_means[i] = stats[i].prior_mean;
@@ -475,6 +468,24 @@ void print_feats_sph(FILE *outfile, p_value_stats *stats, GFF_Set *feats,
          distrib */
     }
   }
+}
+
+/* Features output for SPH without subtree */
+void print_feats_sph(FILE *outfile, p_value_stats *stats, GFF_Set *feats,
+                     mode_type mode, double epsilon, int output_gff,
+		     ListOfLists *result) {
+  double *pvals = smalloc(lst_size(feats->features) * sizeof(double)),
+    *post_means = NULL, *post_vars = NULL, *prior_means = NULL,
+    *prior_vars = NULL;
+
+  if (result != NULL || !output_gff) {
+    post_means = smalloc(lst_size(feats->features) * sizeof(double));
+    post_vars = smalloc(lst_size(feats->features) * sizeof(double));
+    prior_means = smalloc(lst_size(feats->features) * sizeof(double));
+    prior_vars = smalloc(lst_size(feats->features) * sizeof(double));
+  }
+  feats_sph_stats(stats, lst_size(feats->features), mode, epsilon, pvals,
+                  post_means, post_vars, prior_means, prior_vars);
   if (output_gff && outfile != NULL)
     print_gff_scores(outfile, feats, pvals, TRUE);
   if (result != NULL || !output_gff)
@@ -493,6 +504,42 @@ void print_feats_sph(FILE *outfile, p_value_stats *stats, GFF_Set *feats,
   sfree(pvals);
 }
 
+/* same as print_feats_sph, for a compact feature set */
+void print_feats_sph_compact(FILE *outfile, p_value_stats *stats, 
+                             GFF_CompactSet *feats, mode_type mode, 
+                             double epsilon, int output_gff,
+                             ListOfLists *result) {
+  double *pvals = smalloc(max(feats->nfeatures, 1) * sizeof(double)),
+    *post_means = NULL, *post_vars = NULL, *prior_means = NULL,
+    *prior_vars = NULL;
+
+  if (result != NULL || !output_gff) {
+    post_means = smalloc(max(feats->nfeatures, 1) * sizeof(double));
+    post_vars = smalloc(max(feats->nfeatures, 1) * sizeof(double));
+    prior_means = smalloc(max(feats->nfeatures, 1) * sizeof(double));
+    prior_vars = smalloc(max(feats->nfeatures, 1) * sizeof(double));
+  }
+  feats_sph_stats(stats, feats->nfeatures, mode, epsilon, pvals,
+                  post_means, post_vars, prior_means, prior_vars);
+  if (output_gff && outfile != NULL)
+    print_gff_scores_compact(outfile, feats, pvals, TRUE);
+  if (result != NULL || !output_gff)
+    print_feats_generic_compact(output_gff ? NULL : outfile,
+                                "prior_mean\tprior_var\tpost_mean\tpost_var\tpval",
+                                feats, NULL, result, FALSE, TRUE, 5,
+                                "prior.mean", prior_means, 
+                                "prior.var", prior_vars,
+                                "post.mean", post_means,
+                                "post.var", post_vars, "pval", pvals);
+  if (result != NULL || !output_gff) {
+    sfree(post_means);
+    sfree(post_vars);
+    sfree(prior_means);
+    sfree(prior_vars);
+  }
+  sfree(pvals);
+}
+
 /* Features output for SPH with subtree */
 void print_feats_sph_subtree(FILE *outfile, p_value_joint_stats *stats,
 			     GFF_Set *feats,
@@ -583,9 +630,9 @@ void print_feats_sph_subtree(FILE *outfile, p_value_joint_stats *stats,
 }
 
 
-void print_wig(FILE *outfile, MSA *msa, double *vals, char *chrom,
+void print_wig(WigWriter *wig, MSA *msa, double *vals, char *chrom,
 	       int refidx, int log_trans, ListOfLists *result) {
-  int last, j, k;
+  int j, k;
   double val;
   List *posList=NULL, *scoreList=NULL;
 
@@ -594,16 +641,12 @@ void print_wig(FILE *outfile, MSA *msa, double *vals, char *chrom,
     scoreList = lst_new_dbl(msa->length);
   }
 
-  last = -INFTY;
   if (!(refidx >= 0 && refidx <= msa->nseqs))
     die("ERROR print_wig: bad refidx (%i)\n", refidx);
   for (j = 0, k = 0; j < msa->length; j++) {
     checkInterruptN(j, 1000);
     if (refidx == 0 || msa_get_char(msa, refidx-1, j) != GAP_CHAR) {
       if (refidx == 0 || !msa_missing_col(msa, refidx, j)) {
-        if (k > last + 1 && outfile != NULL)
-          fprintf(outfile, "fixedStep chrom=%s start=%d step=1\n", chrom,
-		  k + msa->idx_offset + 1);
         val = vals[msa->ss->tuple_idx[j]];
         if (log_trans) {
           int sign = 1;
@@ -613,16 +656,19 @@ void print_wig(FILE *outfile, MSA *msa, double *vals, char *chrom,
           }
           val = fabs(-log10(val)) * sign; /* fabs prevents -0 for val == 1 */
         }
-        if (outfile != NULL) fprintf(outfile, "%.3f\n", val);
+        if (wig != NULL)
+          wig_writer_add(wig, chrom, k + msa->idx_offset + 1, val);
 	if (result != NULL) {
 	  lst_push_int(posList, k + msa->idx_offset + 1);
 	  lst_push_dbl(scoreList, val);
 	}
-        last = k;
       }
       k++;
     }
   }
+  if (wig != NULL)     /* size of reference sequence, including any
+                          columns without scores at the end */
+    wig_writer_set_chrom_size(wig, chrom, k + msa->idx_offset);
   if (result != NULL) {
     ListOfLists *group = lol_new(2);
     lol_push(group, posList, "coord", INT_LIST);
@@ -698,7 +744,7 @@ void print_base_by_base(FILE *outfile, char *header, char *chrom, MSA *msa,
     if (refidx == 0 || msa_get_char(msa, refidx-1, j) != GAP_CHAR) {
       if (refidx == 0 || !msa_missing_col(msa, refidx, j)) {
         if (k > last + 1 && outfile != NULL)
-          fprintf(outfile, "fixedStep chrom=%s start=%d step=1\n", chrom,
+          fprintf(outfile, "fixedStep chrom=%s start=%" PHAST_POS_FMT " step=1\n", chrom,
                  k + msa->idx_offset + 1);
         tup = msa->ss->tuple_idx[j];
 	if (outfile != NULL) {
@@ -740,18 +786,23 @@ void print_base_by_base(FILE *outfile, char *header, char *chrom, MSA *msa,
 }
 
 
-/* Print a list of features and artibrary associated statistics */
-void print_feats_generic(FILE *outfile, char *header, GFF_Set *gff,
-			 char **formatstr, ListOfLists *result,
-			 int log_trans_outfile, int log_trans_results,
-			 int ncols, ...) {
-  int i, col;
-  String *name;
-  va_list ap;
+/* Print a list of features and artibrary associated statistics.
+   Features are taken from gff or, if it is NULL, from cgff; the
+   statistics are as for print_feats_generic */
+static void print_feats_generic_va(FILE *outfile, char *header, 
+                                   GFF_Set *gff, GFF_CompactSet *cgff,
+                                   char **formatstr, ListOfLists *result,
+                                   int log_trans_outfile, 
+                                   int log_trans_results,
+                                   int ncols, va_list ap) {
+  int i, col, nfeats = (gff != NULL ? lst_size(gff->features) : 
+                        cgff->nfeatures);
+  String *name, *attribute = (gff == NULL ? str_new(STR_MED_LEN) : NULL);
   double *data[ncols+1];
   Regex *tag_val_re = str_re_new("[[:alnum:]_.]+[[:space:]]+(\"[^\"]*\"|[^[:space:]]+)");
   List *l = lst_new_ptr(2);
-  char **colname;
+  char **colname, *seqname, *type;
+  phast_pos start, end;
   List **resultList=NULL;
   int get_log = (log_trans_outfile && outfile != NULL) ||
     (log_trans_results && result != NULL);
@@ -768,15 +819,14 @@ void print_feats_generic(FILE *outfile, char *header, GFF_Set *gff,
   }
   if (result != NULL) {
     resultList = smalloc(5*sizeof(List*));
-    resultList[0] = lst_new_ptr(lst_size(gff->features));
-    resultList[1] = lst_new_int(lst_size(gff->features));
-    resultList[2] = lst_new_int(lst_size(gff->features));
-    resultList[3] = lst_new_ptr(lst_size(gff->features));
-    resultList[4] = lst_new_ptr(lst_size(gff->features));
+    resultList[0] = lst_new_ptr(nfeats);
+    resultList[1] = lst_new_int(nfeats);
+    resultList[2] = lst_new_int(nfeats);
+    resultList[3] = lst_new_ptr(nfeats);
+    resultList[4] = lst_new_ptr(nfeats);
   }
 
   colname = smalloc((ncols+1)*sizeof(char*));
-  va_start(ap, ncols);
   for (col = 0; col < ncols; col++) {
     colname[col] = va_arg(ap, char*);
     data[col] = va_arg(ap, double*);
@@ -786,23 +836,37 @@ void print_feats_generic(FILE *outfile, char *header, GFF_Set *gff,
       die("ERROR print_feats_generic: expected last col to be pval, got %s\n",
 	  colname[col-1]);
     colname[col] = "score";
-    data[col] = log10_pval(data[col-1], lst_size(gff->features));
+    data[col] = log10_pval(data[col-1], nfeats);
   }
 
-  for (i = 0; i < lst_size(gff->features); i++) {
-    GFF_Feature *f = lst_get_ptr(gff->features, i);
+  for (i = 0; i < nfeats; i++) {
     checkInterruptN(i, 100);
+    if (gff != NULL) {
+      GFF_Feature *f = lst_get_ptr(gff->features, i);
+      seqname = f->seqname->chars;
+      type = f->feature == NULL ? NULL : f->feature->chars;
+      start = f->start;
+      end = f->end;
+      attribute = f->attribute;
+    }
+    else {
+      seqname = gffc_name(cgff, cgff->seqname[i]);
+      type = gffc_name(cgff, cgff->feature[i]);
+      start = cgff->start[i];
+      end = cgff->end[i];
+      str_cpy_charstr(attribute, gffc_attribute(cgff, i));
+    }
 
     /* try to extract feature name from attribute field */
     lst_clear(l);
-    if (f->attribute->length > 0 &&
-        str_re_match(f->attribute, tag_val_re, l, 1) >= 0) {
+    if (attribute->length > 0 &&
+        str_re_match(attribute, tag_val_re, l, 1) >= 0) {
       name = lst_get_ptr(l, 1);
       str_remove_quotes(name);
     } else name=NULL;
 
     if (outfile != NULL) {
-      fprintf(outfile, "%s\t%d\t%d\t%s\t", f->seqname->chars, f->start-1, f->end,
+      fprintf(outfile, "%s\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\t%s\t", seqname, start-1, end,
 	      name == NULL ? "." : name->chars);
 
       for (col = 0; col < ncols; col++) {
@@ -815,12 +879,11 @@ void print_feats_generic(FILE *outfile, char *header, GFF_Set *gff,
     }
     if (result != NULL) {
       char *tempstr;
-      tempstr = copy_charstr(f->seqname->chars);
+      tempstr = copy_charstr(seqname);
       lst_push_ptr(resultList[0], tempstr);
-      lst_push_int(resultList[1], f->start);
-      lst_push_int(resultList[2], f->end);
-      lst_push_ptr(resultList[3], copy_charstr(f->feature == NULL ? "." :
-					       f->feature->chars));
+      lst_push_int(resultList[1], start);
+      lst_push_int(resultList[2], end);
+      lst_push_ptr(resultList[3], copy_charstr(type == NULL ? "." : type));
       tempstr = copy_charstr(name == NULL ? "." : name->chars);
       lst_push_ptr(resultList[4], tempstr);
     }
@@ -836,22 +899,44 @@ void print_feats_generic(FILE *outfile, char *header, GFF_Set *gff,
     lol_push(group, resultList[4], "name", CHAR_LIST);
     sfree(resultList);
     for (col=0; col < ncols; col++)
-      lol_push_dbl(group, data[col], lst_size(gff->features),
-			   colname[col]);
+      lol_push_dbl(group, data[col], nfeats, colname[col]);
     if (log_trans_results)
-      lol_push_dbl(group, data[col], lst_size(gff->features),
-		   colname[col]);
+      lol_push_dbl(group, data[col], nfeats, colname[col]);
     lol_set_class(group, "data.frame");
     lol_push_lol(result, group, "feature.stats");
   }
 
-  va_end(ap);
+  if (gff == NULL) str_free(attribute);
   lst_free(l);
   str_re_free(tag_val_re);
   if (get_log) sfree(data[ncols]);
   sfree(colname);
 }
 
+/* Print a list of features and artibrary associated statistics */
+void print_feats_generic(FILE *outfile, char *header, GFF_Set *gff,
+			 char **formatstr, ListOfLists *result,
+			 int log_trans_outfile, int log_trans_results,
+			 int ncols, ...) {
+  va_list ap;
+  va_start(ap, ncols);
+  print_feats_generic_va(outfile, header, gff, NULL, formatstr, result,
+                         log_trans_outfile, log_trans_results, ncols, ap);
+  va_end(ap);
+}
+
+/* same as print_feats_generic, for a compact feature set */
+void print_feats_generic_compact(FILE *outfile, char *header, 
+                                 GFF_CompactSet *gff, char **formatstr, 
+                                 ListOfLists *result, int log_trans_outfile,
+                                 int log_trans_results, int ncols, ...) {
+  va_list ap;
+  va_start(ap, ncols);
+  print_feats_generic_va(outfile, header, NULL, gff, formatstr, result,
+                         log_trans_outfile, log_trans_results, ncols, ap);
+  va_end(ap);
+}
+
 /* Print GFF to stdout with feature scores defined by vals.  If
    log_trans == TRUE, take log transform (propagating negative
    signs) */
@@ -874,3 +959,24 @@ void print_gff_scores(FILE *outfile, GFF_Set *gff, double *vals, int log_trans)
   }
   if (outfile != NULL) gff_print_set(outfile, gff);
 }
+
+/* same as print_gff_scores, for a compact feature set */
+void print_gff_scores_compact(FILE *outfile, GFF_CompactSet *gff, 
+                              double *vals, int log_trans) {
+  int i;
+  for (i = 0; i < gff->nfeatures; i++) {
+    checkInterruptN(i, 100);
+    gff->score[i] = vals[i];
+    gff->score_is_null[i] = FALSE;
+    if (log_trans) {
+      int sign = 1;
+      if (gff->score[i] < 0) {
+        gff->score[i] = -gff->score[i];
+        sign = -1;          /* propagate negative sign through */
+      }
+      gff->score[i] = fabs(-log10(gff->score[i])) * sign; 
+                                /* fabs prevents -0 for val == 1 */
+    }
+  }
+  if (outfile != NULL) gffc_print_set(outfile, gff);
+}
@@ -21,6 +21,7 @@
 #include <prob_vector.h>
 #include <prob_matrix.h>
 #include <fit_column.h>
+#include <profile.h>
 
 /* (used below) compute and return a set of matrices giving p(b, n |
    j), the probability of n substitutions and a final base b given j
@@ -270,6 +271,7 @@ Vector *sub_posterior_distrib_site(JumpProcess *jp, MSA *msa, int tuple_idx) {
   int size = jp->mod->rate_matrix->size;
   Vector *retval;
   int *maxsubst = smalloc(jp->mod->tree->nnodes * sizeof(int));
+  PROF_BEGIN(PROF_SUBST_DISTRIB);
 
   if (jp->mod->order != 0)
     die("ERROR sub_posterior_distrib_site: jp->mod->order=%i, should be 0\n",
@@ -366,6 +368,7 @@ Vector *sub_posterior_distrib_site(JumpProcess *jp, MSA *msa, int tuple_idx) {
   sfree(maxsubst);
 
   pv_normalize(retval);
+  PROF_END(PROF_SUBST_DISTRIB, 1);
   return retval;
 }
 
@@ -652,6 +655,7 @@ Matrix *sub_joint_distrib_site(JumpProcess *jp, MSA *msa, int tuple_idx) {
   Matrix **d_left, **d_right;
   double sum;
   int *maxsubst = smalloc(jp->mod->tree->nnodes * sizeof(int));
+  PROF_BEGIN(PROF_SUBST_DISTRIB);
 
   if (jp->mod->order != 0)
     die("ERROR sub_joint_distrib_site: jp->mod->Order should be 0, is %i\n",
@@ -776,6 +780,7 @@ Matrix *sub_joint_distrib_site(JumpProcess *jp, MSA *msa, int tuple_idx) {
   sfree(maxsubst);
 
   pm_normalize(retval);
+  PROF_END(PROF_SUBST_DISTRIB, 1);
   return retval;
 }
 
@@ -866,32 +871,51 @@ p_value_stats *sub_p_value_many(JumpProcess *jp, MSA *msa, List *feats,
                                              -1, posterior mean will
                                              be used */
                                 ) {
+  int idx, nfeats = lst_size(feats);
+  phast_pos *starts = smalloc((nfeats + 1) * sizeof(phast_pos)), 
+    *ends = smalloc((nfeats + 1) * sizeof(phast_pos));
+  p_value_stats *stats;
+  for (idx = 0; idx < nfeats; idx++) {
+    GFF_Feature *f = lst_get_ptr(feats, idx);
+    starts[idx] = f->start;
+    ends[idx] = f->end;
+  }
+  stats = sub_p_value_many_ranges(jp, msa, nfeats, starts, ends, ci);
+  sfree(starts);
+  sfree(ends);
+  return stats;
+}
+
+/* same as sub_p_value_many, but with features described by arrays of
+   start and end coordinates (1-based, inclusive), e.g., the start and
+   end arrays of a GFF_CompactSet */
+p_value_stats *sub_p_value_many_ranges(JumpProcess *jp, MSA *msa, int nfeats,
+                                       phast_pos *starts, phast_pos *ends,
+                                       double ci) {
 
   Vector *p, *prior = NULL;
   int maxlen = -1, len, idx, i, j, logmaxlen, loglen, checksum, lastlen = -1, 
     prior_min, prior_max;
-  GFF_Feature *f;
+  phast_pos col;
   double *post_mean, *post_var;
   double this_min, this_max, prior_mean, prior_var;
-  p_value_stats *stats = smalloc(lst_size(feats) * 
-                                 sizeof(p_value_stats));
+  p_value_stats *stats = smalloc(nfeats * sizeof(p_value_stats));
   char *used = smalloc(msa->ss->ntuples * sizeof(char));
   Vector **pow_p, **pows;
 
-  if (lst_size(feats) == 0) return NULL;
+  if (nfeats == 0) return NULL;
 
 
   /* find max length of feature.  Simultaneously, figure out which
      column tuples actually used (saves time below) */
   for (i = 0; i < msa->ss->ntuples; i++) used[i] = 'N';
-  for (idx = 0; idx < lst_size(feats); idx++) {
+  for (idx = 0; idx < nfeats; idx++) {
     checkInterruptN(i, 1000);
-    f = lst_get_ptr(feats, idx);
-    len = f->end - f->start + 1;
+    len = (int)(ends[idx] - starts[idx] + 1);
     if (len > maxlen) maxlen = len;
-    for (i = f->start - 1; i < f->end; i++)
-      if (used[msa->ss->tuple_idx[i]] == 'N')
-        used[msa->ss->tuple_idx[i]] = 'Y';
+    for (col = starts[idx] - 1; col < ends[idx]; col++)
+      if (used[msa->ss->tuple_idx[col]] == 'N')
+        used[msa->ss->tuple_idx[col]] = 'Y';
   }
 
   /* compute "powers" of prior distribution, to allow fast computation
@@ -915,10 +939,9 @@ p_value_stats *sub_p_value_many(JumpProcess *jp, MSA *msa, List *feats,
   }
 
   /* now obtain stats for each feature */
-  for (idx = 0; idx < lst_size(feats); idx++) {
+  for (idx = 0; idx < nfeats; idx++) {
     checkInterruptN(idx, 100);
-    f = lst_get_ptr(feats, idx);
-    len = f->end - f->start + 1;
+    len = (int)(ends[idx] - starts[idx] + 1);
     loglen = log2_int(len);
 
     if (len != lastlen) { /* don't recompute if length doesn't change;
@@ -950,9 +973,9 @@ p_value_stats *sub_p_value_many(JumpProcess *jp, MSA *msa, List *feats,
     stats[idx].prior_max = prior_max;
 
     stats[idx].post_mean = stats[idx].post_var = 0;
-    for (i = f->start - 1; i < f->end; i++) {
-      stats[idx].post_mean += post_mean[msa->ss->tuple_idx[i]];
-      stats[idx].post_var += post_var[msa->ss->tuple_idx[i]];
+    for (col = starts[idx] - 1; col < ends[idx]; col++) {
+      stats[idx].post_mean += post_mean[msa->ss->tuple_idx[col]];
+      stats[idx].post_var += post_var[msa->ss->tuple_idx[col]];
     }
     
     if (ci != -1)
@@ -1028,6 +1051,7 @@ sub_p_value_joint_many(JumpProcess *jp, MSA *msa, List *feats,
   Matrix *p, *prior = NULL, *prior_site;
   int maxlen = -1, len, idx, i, j, logmaxlen, loglen, max_nrows=-1, max_ncols=-1,
     max_conv_len, checksum, lastlen = -1;
+  phast_pos col;
   GFF_Feature *f;
   double *post_mean_left, *post_mean_right, *post_mean_tot, *post_var_left,
     *post_var_right, *post_var_tot;
@@ -1051,11 +1075,11 @@ sub_p_value_joint_many(JumpProcess *jp, MSA *msa, List *feats,
   for (i = 0; i < msa->ss->ntuples; i++) used[i] = 'N';
   for (idx = 0; idx < lst_size(feats); idx++) {
     f = lst_get_ptr(feats, idx);
-    len = f->end - f->start + 1;
+    len = (int)(f->end - f->start + 1);
     if (len > maxlen) maxlen = len;
-    for (i = f->start - 1; i < f->end; i++)
-      if (used[msa->ss->tuple_idx[i]] == 'N')
-        used[msa->ss->tuple_idx[i]] = 'Y';
+    for (col = f->start - 1; col < f->end; col++)
+      if (used[msa->ss->tuple_idx[col]] == 'N')
+        used[msa->ss->tuple_idx[col]] = 'Y';
   }
 
   /* compute per-site prior distribution and left/right marginals */
@@ -1118,7 +1142,7 @@ sub_p_value_joint_many(JumpProcess *jp, MSA *msa, List *feats,
   for (idx = 0; idx < lst_size(feats); idx++) {
     checkInterruptN(idx, 100);
     f = lst_get_ptr(feats, idx);
-    len = f->end - f->start + 1;
+    len = (int)(f->end - f->start + 1);
     loglen = log2_int(len);
 
     if (len == lastlen) {
@@ -1203,13 +1227,13 @@ sub_p_value_joint_many(JumpProcess *jp, MSA *msa, List *feats,
     stats[idx].post_mean_left = stats[idx].post_mean_right = 
       stats[idx].post_var_left = stats[idx].post_var_right = 
       stats[idx].post_mean_tot = stats[idx].post_var_tot = 0;
-    for (i = f->start - 1; i < f->end; i++) {
-      stats[idx].post_mean_left += post_mean_left[msa->ss->tuple_idx[i]];
-      stats[idx].post_mean_right += post_mean_right[msa->ss->tuple_idx[i]];
-      stats[idx].post_mean_tot += post_mean_tot[msa->ss->tuple_idx[i]];
-      stats[idx].post_var_left += post_var_left[msa->ss->tuple_idx[i]];
-      stats[idx].post_var_right += post_var_right[msa->ss->tuple_idx[i]];
-      stats[idx].post_var_tot += post_var_tot[msa->ss->tuple_idx[i]];
+    for (col = f->start - 1; col < f->end; col++) {
+      stats[idx].post_mean_left += post_mean_left[msa->ss->tuple_idx[col]];
+      stats[idx].post_mean_right += post_mean_right[msa->ss->tuple_idx[col]];
+      stats[idx].post_mean_tot += post_mean_tot[msa->ss->tuple_idx[col]];
+      stats[idx].post_var_left += post_var_left[msa->ss->tuple_idx[col]];
+      stats[idx].post_var_right += post_var_right[msa->ss->tuple_idx[col]];
+      stats[idx].post_var_tot += post_var_tot[msa->ss->tuple_idx[col]];
     }
     
     if (ci != -1) {
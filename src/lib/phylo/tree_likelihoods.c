@@ -15,6 +15,9 @@
 #include <subst_mods.h>
 #include <dgamma.h>
 #include <sufficient_stats.h>
+#include <arena.h>
+#include <profile.h>
+#include <hashtable.h>
 
 /* Computation of likelihoods for columns of a given multiple
    alignment, according to a given tree model.  */
@@ -26,8 +29,94 @@
 /* FIXME: inside and outside computations should be in log space --
    probably only an issue when the number of leaves is large */
 
+#define TL_BATCH_SIZE 32
+/* number of column tuples whose partial likelihoods are computed
+   together with codon models (see tl_codon_batch_probs) */
+
+/* Distinct patterns of characters at the leaves below each node of
+   the tree, over a set of column tuples.  At "memoized" nodes, the
+   inside vectors are computed once per pattern (class) and copied for
+   each tuple (see tl_find_patterns) */
+typedef struct tl_patterns_struct {
+  int ntuples;                  /* number of tuples classified */
+  int *tuples;                  /* indices of those tuples */
+  int nmemo;                    /* number of memoized nodes */
+  int *memo;                    /* whether each node (by id) is
+                                   memoized */
+  int *nclasses;                /* number of classes at each memoized
+                                   node */
+  int **cls;                    /* class of each tuple (by tuple
+                                   index) at each memoized node */
+  int **kids;                   /* for each class of a memoized node,
+                                   the keys of its left and right
+                                   children (a class for an internal
+                                   node, a code for the characters of
+                                   a leaf; see tl_pattern_key) */
+  double **vals;                /* inside vectors of each memoized
+                                   node, indexed by class, state, and
+                                   rate category */
+  int *plan;                    /* pruned tree for each tuple (by
+                                   tuple index), as an index into
+                                   'pruned', or -1 for the whole tree */
+  List *pruned;                 /* pruned trees (TreeLikPruned*) */
+  int valid;                    /* whether vals and the matrices of
+                                   the pruned trees are current */
+} TreeLikPatterns;
+
+/* Tree from which the subtrees are removed in which all leaves have
+   missing data (all-ones inside vectors) in some set of tuples.
+   Remaining internal nodes left with a single child are bypassed: the
+   substitution matrices along the branches from the nearest retained
+   ancestor to the nearest retained descendant are multiplied.
+   Memoized nodes are retained as leaves (see tl_prune_tree) */
+typedef struct tl_pruned_struct {
+  int nnodes;                   /* number of nodes retained */
+  int *ids;                     /* their ids, in postorder (the root,
+                                   always retained, is last) */
+  int *lkid, *rkid;             /* ids of the retained left and right
+                                   descendants of each node, or -1
+                                   (only the root or a leaf may lack
+                                   them) */
+  int *ltop, *rtop;             /* ids of the actual children on the
+                                   paths to them */
+  double **lmat, **rmat;        /* products of the substitution
+                                   matrices along those paths, indexed
+                                   by row, column, and rate category,
+                                   or NULL if the descendant is a
+                                   child */
+} TreeLikPruned;
+
 int tuple_index_missing_data(char *tuple, int *inv_alph, int *is_missing,
                              int alph_size);
+static int tl_cache_matches(TreeLikCache *cache, TreeModel *mod, MSA *msa);
+static int tl_cache_update(TreeLikCache *cache, TreeModel *mod);
+static int tl_skip_tuple(TreeModel *mod, MSA *msa, int tupleidx);
+static void tl_codon_batch_probs(TreeModel *mod, MSA *msa, int cat,
+                                 TreeLikCache *cache, Arena *ar,
+                                 double *probs, int *done);
+static void tl_leaf_vector(TreeModel *mod, char *chars, int pass,
+                           double *vec);
+static TreeLikPatterns *tl_find_patterns(TreeModel *mod, MSA *msa,
+                                         int *tuples, int ntuples);
+static void tl_pattern_vals(TreeModel *mod, TreeLikPatterns *pat,
+                            double **Pint, int *dirty);
+static void tl_free_patterns(TreeLikPatterns *pat, int nnodes);
+static void tl_find_pruned(TreeModel *mod, MSA *msa, TreeLikPatterns *pat,
+                           double budget);
+static TreeLikPruned *tl_prune_tree(TreeModel *mod, TreeLikPatterns *pat,
+                                    int *empty, double *budget);
+static void tl_free_pruned(TreeLikPruned *pr);
+static void tl_path_product(TreeModel *mod, int top, int bottom,
+                            double *mat);
+static double **tl_interleave_P(TreeModel *mod, Arena *ar);
+static double tl_inside_prob(TreeModel *mod, MSA *msa, int tupleidx,
+                             double **Pint, double *inside,
+                             TreeLikPatterns *patterns, int *dirty);
+static void tl_inside_vector(double *out, double *lvec, double *lmat,
+                             double *rvec, double *rmat, int nstates,
+                             int nrc);
+static void tl_pruned_vector(TreeLikPruned *pr, int k, double **Pint,
+                             double *inside, int nstates, int nrc);
 
 
 
@@ -46,50 +135,50 @@ double tl_compute_log_likelihood(TreeModel *mod, MSA *msa,
   int nstates = mod->rate_matrix->size;
   int alph_size = (int)strlen(mod->rate_matrix->states);
   int npasses = (mod->order > 0 && mod->use_conditionals == 1 ? 2 : 1);
-  int pass, col_offset, k, nodeidx, rcat, /* colidx, */ tupleidx, defined;
+  int pass, col_offset, k, nodeidx, rcat, /* colidx, */ tupleidx,
+    defined;
   TreeNode *n;
   double total_prob, marg_tot;
   List *traversal;
   double **inside_joint = NULL, **inside_marginal = NULL,
     **outside_joint = NULL, **outside_marginal = NULL,
     ****subst_probs = NULL;
-  double *curr_tuple_scores=NULL;
+  double *curr_tuple_scores=NULL, *batch_probs = NULL;
+  int *batch_done = NULL, *tuples = NULL, ntup;
+  TreeLikCache *cache = NULL;
+  TreeLikPatterns *patterns = NULL;
+  double **Pint = NULL, *inside = NULL;
+  size_t inside_size = 0;
+  int incremental = FALSE, base_epoch = 0;
+  Arena *ar;
+  ArenaMark mark;
   double rcat_prob[mod->nratecats];
-  double tmp[nstates];
+  double tmp[nstates], leafvec[nstates];
+  char chars[mod->order+1];
+  if (mod->tree == NULL)        /* weight matrix */
+    return tl_compute_log_likelihood_weight_matrix(mod, msa, col_scores,
+                                                   tuple_scores, cat);
+
+  PROF_BEGIN(PROF_LIKELIHOOD);
 
   checkInterrupt();
 
-  /* allocate memory */
-  inside_joint = (double**)smalloc(nstates * sizeof(double*));
-  for (j = 0; j < nstates; j++)
-    inside_joint[j] = (double*)smalloc((mod->tree->nnodes+1) *
-                                       sizeof(double));
-  outside_joint = (double**)smalloc(nstates * sizeof(double*));
-  for (j = 0; j < nstates; j++)
-    outside_joint[j] = (double*)smalloc((mod->tree->nnodes+1) *
-                                        sizeof(double));
+  /* allocate memory (scratch space; released before returning) */
+  ar = ar_scratch_begin(&mark);
+  inside_joint = ar_alloc_dbl_matrix(ar, nstates, mod->tree->nnodes+1);
+  outside_joint = ar_alloc_dbl_matrix(ar, nstates, mod->tree->nnodes+1);
   /* only needed if post != NULL? */
-  if (mod->order > 0) {
-    inside_marginal = (double**)smalloc(nstates * sizeof(double*));
-    for (j = 0; j < nstates; j++)
-      inside_marginal[j] = (double*)smalloc((mod->tree->nnodes+1) *
-                                            sizeof(double));
-  }
-  if (mod->order > 0 && post != NULL) {
-    outside_marginal = (double**)smalloc(nstates * sizeof(double*));
-    for (j = 0; j < nstates; j++)
-      outside_marginal[j] = (double*)smalloc((mod->tree->nnodes+1) *
-                                             sizeof(double));
-  }
+  if (mod->order > 0)
+    inside_marginal = ar_alloc_dbl_matrix(ar, nstates, mod->tree->nnodes+1);
+  if (mod->order > 0 && post != NULL)
+    outside_marginal = ar_alloc_dbl_matrix(ar, nstates, mod->tree->nnodes+1);
   if (post != NULL) {
-    subst_probs = (double****)smalloc(mod->nratecats * sizeof(double***));
+    subst_probs = ar_alloc(ar, mod->nratecats * sizeof(double***));
     for (rcat = 0; rcat < mod->nratecats; rcat++) {
-      subst_probs[rcat] = (double***)smalloc(nstates * sizeof(double**));
-      for (j = 0; j < nstates; j++) {
-        subst_probs[rcat][j] = (double**)smalloc(nstates * sizeof(double*));
-        for (k = 0; k < nstates; k++)
-          subst_probs[rcat][j][k] = (double*)smalloc(mod->tree->nnodes * sizeof(double));
-      }
+      subst_probs[rcat] = ar_alloc(ar, nstates * sizeof(double**));
+      for (j = 0; j < nstates; j++)
+        subst_probs[rcat][j] = ar_alloc_dbl_matrix(ar, nstates,
+                                                   mod->tree->nnodes);
     }
   }
 
@@ -133,8 +222,70 @@ double tl_compute_log_likelihood(TreeModel *mod, MSA *msa,
   if (!defined) {
     tm_set_subst_matrices(mod);
   }
+
+  /* with codon models, the probabilities of most tuples are computed
+     in batches beforehand (see tl_codon_batch_probs); the cache, if
+     any, is used there, and the remaining tuples are computed below
+     without it */
+  if (post == NULL && npasses == 1 &&
+      subst_mod_is_codon_model(mod->subst_mod)) {
+    batch_probs = ar_alloc(ar, msa->ss->ntuples * sizeof(double));
+    batch_done = ar_alloc(ar, msa->ss->ntuples * sizeof(int));
+    tl_codon_batch_probs(mod, msa, cat,
+                         (mod->lik_cache != NULL &&
+                          tl_cache_matches(mod->lik_cache, mod, msa) ?
+                          mod->lik_cache : NULL),
+                         ar, batch_probs, batch_done);
+  }
+
+  /* otherwise use cached partial likelihoods if possible */
+  else if (mod->lik_cache != NULL && post == NULL && npasses == 1 &&
+           tl_cache_matches(mod->lik_cache, mod, msa)) {
+    cache = mod->lik_cache;
+    base_epoch = tl_cache_update(cache, mod);
+  }
+
+  /* otherwise, if posterior probabilities are not required, compute
+     the inside vectors of all rate categories in a single traversal
+     per tuple (see tl_inside_prob), with the categories interleaved in
+     the inside vectors and substitution matrices so that they are
+     updated together.  The inside vectors of nodes below which the
+     same leaf patterns recur in many tuples are computed once per
+     pattern (see tl_find_patterns); the patterns are kept with the
+     cache, if any */
+  if (batch_done == NULL && post == NULL && npasses == 1) {
+    Pint = tl_interleave_P(mod, ar);
+    inside_size = (size_t)(mod->tree->nnodes+1) * nstates * mod->nratecats;
+    if (cache == NULL)
+      inside = ar_alloc(ar, inside_size * sizeof(double));
+    tuples = ar_alloc(ar, msa->ss->ntuples * sizeof(int));
+    for (tupleidx = 0, ntup = 0; tupleidx < msa->ss->ntuples; tupleidx++)
+      if (((cat >= 0 && msa->ss->cat_counts[cat][tupleidx] > 0) ||
+           (cat < 0 && msa->ss->counts[tupleidx] > 0)) &&
+          !tl_skip_tuple(mod, msa, tupleidx))
+        tuples[ntup++] = tupleidx;
+    if (cache != NULL) {
+      if (cache->patterns == NULL || cache->patterns->ntuples != ntup ||
+          memcmp(cache->patterns->tuples, tuples, ntup * sizeof(int)) != 0) {
+        /* new set of tuples; the memoized nodes may change, so all
+           partials must be recomputed */
+        if (cache->patterns != NULL)
+          tl_free_patterns(cache->patterns, cache->nnodes);
+        cache->patterns = tl_find_patterns(mod, msa, tuples, ntup);
+        for (i = 0; i < cache->ntuples; i++) cache->stamp[i] = -1;
+      }
+      patterns = cache->patterns;
+      tl_pattern_vals(mod, patterns, Pint,
+                      patterns->valid ? cache->dirty : NULL);
+    }
+    else {
+      patterns = tl_find_patterns(mod, msa, tuples, ntup);
+      tl_pattern_vals(mod, patterns, Pint, NULL);
+    }
+  }
+
   if (col_scores != NULL && tuple_scores == NULL)
-    curr_tuple_scores = (double*)smalloc(msa->ss->ntuples * sizeof(double));
+    curr_tuple_scores = ar_alloc(ar, msa->ss->ntuples * sizeof(double));
   else if (tuple_scores != NULL)
     curr_tuple_scores = tuple_scores;
   if (curr_tuple_scores != NULL)
@@ -164,22 +315,22 @@ double tl_compute_log_likelihood(TreeModel *mod, MSA *msa,
     marg_tot = NULL_LOG_LIKELIHOOD;
 
     /* check for gaps and whether column is informative, if necessary */
-    if (!mod->allow_gaps)
-      for (j = 0; !skip_fels && j < msa->nseqs; j++)
-        if (ss_get_char_tuple(msa, tupleidx, j, 0) == GAP_CHAR)
-          skip_fels = TRUE;
-    if (!skip_fels && mod->inform_reqd) {
-      int ninform = 0;
-      for (j = 0; j < msa->nseqs; j++) {
-        if (msa->is_informative != NULL && !msa->is_informative[j])
-          continue;
-        else if (!msa->is_missing[(int)ss_get_char_tuple(msa, tupleidx, j, 0)])
-          ninform++;
+    skip_fels = tl_skip_tuple(mod, msa, tupleidx);
+
+    if (!skip_fels && batch_done != NULL && batch_done[tupleidx])
+      total_prob = batch_probs[tupleidx];
+    else if (!skip_fels && Pint != NULL) {
+      if (cache != NULL) {
+        /* partials are current except at dirty nodes only if the
+           tuple was computed after the last change */
+        incremental = (cache->stamp[tupleidx] == base_epoch);
+        cache->stamp[tupleidx] = cache->epoch;
+        inside = cache->partials + (size_t)tupleidx * inside_size;
       }
-      if (ninform < 2) skip_fels = TRUE;
+      total_prob = tl_inside_prob(mod, msa, tupleidx, Pint, inside, patterns,
+                                  incremental ? cache->dirty : NULL);
     }
-
-    if (!skip_fels) {
+    else if (!skip_fels) {
       for (pass = 0; pass < npasses; pass++) {
         double **pL = (pass == 0 ? inside_joint : inside_marginal);
         double **pLbar = (pass == 0 ? outside_joint : outside_marginal);
@@ -191,7 +342,6 @@ double tl_compute_log_likelihood(TreeModel *mod, MSA *msa,
         for (rcat = 0; rcat < mod->nratecats; rcat++) {
           traversal = tr_postorder(mod->tree);
           for (nodeidx = 0; nodeidx < lst_size(traversal); nodeidx++) {
-            int partial_match[mod->order+1][alph_size];
             n = lst_get_ptr(traversal, nodeidx);
             if (n->lchild == NULL) {
               /* leaf: base case of recursion */
@@ -201,65 +351,14 @@ double tl_compute_log_likelihood(TreeModel *mod, MSA *msa,
 	      if (thisseq < 0)
 		die("ERROR tl_compute_log_likelihood: expected a leaf node\n");
 
-              /* first figure out whether there is a match for each
-                 character in each position; we'll call this the record of
-                 "partial_matches". */
-              for (col_offset = -1*mod->order; col_offset <= 0; col_offset++) {
-                int observed_state = -1;
-                int *iupac_prob = NULL;
-
-                if (pass == 0 || col_offset < 0) {
-                  char thischar = ss_get_char_tuple(msa, tupleidx,
-						    thisseq, col_offset);
-                  observed_state = mod->rate_matrix->inv_states[(int)thischar];
-                  if (observed_state < 0)
-                    iupac_prob = mod->iupac_inv_map[(int)thischar];
-                }
-
-                /* otherwise, we're on a second pass and looking the
-                   current base, so we want to use the "missing
-                   information" principle */
-
-                if (iupac_prob != NULL) {
-                  for (i = 0; i < alph_size; i++)
-                    partial_match[mod->order+col_offset][i] = iupac_prob[i];
-                }
-                else {
-                  for (i = 0; i < alph_size; i++) {
-                    if (observed_state < 0 || i == observed_state)
-                      partial_match[mod->order+col_offset][i] = 1;
-                    else
-                      partial_match[mod->order+col_offset][i] = 0;
-                  }
-                }
-              }
-
-              /* now find the intersection of the partial matches */
-              for (i = 0; i < nstates; i++) {
-                if (mod->order == 0)  /* handle 0th order model as special
-                                         case, for efficiency.  In this case
-                                         the partial match *is* the total
-                                         match */
-                  pL[i][n->id] = partial_match[0][i];
-                else {
-                  int total_match = 1;
-                  /* figure out the "projection" of state i in the dimension
-                     of each position, and see whether there is a
-                     corresponding partial match. */
-                  /* NOTE: mod->order is approx equal to log nstates
-                     (prob no more than 2) */
-                  for (col_offset = -1*mod->order; col_offset <= 0 && total_match;
-                       col_offset++) {
-                    int projection = (i / int_pow(alph_size, -1 * col_offset)) %
-                      alph_size;
-
-                    if (!partial_match[mod->order+col_offset][projection])
-                      total_match = 0; /* must have partial matches in all
-                                          dimensions for a total match */
-                  }
-                  pL[i][n->id] = total_match;
-                }
-              }
+              /* (on a second pass the current character is not used) */
+              for (col_offset = -1*mod->order; col_offset <= 0; col_offset++)
+                if (pass == 0 || col_offset < 0)
+                  chars[mod->order+col_offset] =
+                    ss_get_char_tuple(msa, tupleidx, thisseq, col_offset);
+              tl_leaf_vector(mod, chars, pass, leafvec);
+              for (i = 0; i < nstates; i++)
+                pL[i][n->id] = leafvec[i];
             }
             else {
               /* general recursive case */
@@ -326,14 +425,14 @@ double tl_compute_log_likelihood(TreeModel *mod, MSA *msa,
                 this_total += pL[i][n->id] * pLbar[i][n->id];
 
               if (post->expected_nsubst != NULL && n->parent != NULL)
-                post->expected_nsubst[rcat][n->id][tupleidx] = 1;
+                TP_EXPECTED_NSUBST(post, rcat, n->id, tupleidx) = 1;
 
               subst_mat = mod->P[n->id][rcat];
               for (i = 0; i < nstates; i++) {
                 /* compute posterior prob of base (tuple) i at node n */
-                if (post->base_probs != NULL) {
-                  post->base_probs[rcat][i][n->id][tupleidx] =
-                    safediv(pL[i][n->id] * pLbar[i][n->id], this_total);
+                if (TP_HAS_BASE_PROBS(post)) {
+                  TP_SET_BASE_PROB(post, rcat, i, n->id, tupleidx,
+                    safediv(pL[i][n->id] * pLbar[i][n->id], this_total));
                 }
 
                 if (n->parent == NULL) continue;
@@ -354,11 +453,11 @@ double tl_compute_log_likelihood(TreeModel *mod, MSA *msa,
                     safediv(subst_probs[rcat][i][j][n->id], denom);
 
                   if (post->subst_probs != NULL)
-                    post->subst_probs[rcat][i][j][n->id][tupleidx] =
+                    TP_SUBST_PROB(post, rcat, i, j, n->id, tupleidx) =
                       subst_probs[rcat][i][j][n->id];
 
                   if (post->expected_nsubst != NULL && j == i)
-                    post->expected_nsubst[rcat][n->id][tupleidx] -=
+                    TP_EXPECTED_NSUBST(post, rcat, n->id, tupleidx) -=
                       subst_probs[rcat][i][j][n->id];
 
                 }
@@ -413,7 +512,7 @@ double tl_compute_log_likelihood(TreeModel *mod, MSA *msa,
             if (n->parent == NULL) continue;
             for (i = 0; i < nstates; i++)
               for (j = 0; j < nstates; j++)
-                post->expected_nsubst_col[rcat][n->id][tupleidx][i][j] =
+                TP_EXPECTED_NSUBST_COL(post, rcat, n->id, tupleidx, i, j) =
                   subst_probs[rcat][i][j][n->id] * rcat_post_prob;
           }
         }
@@ -442,51 +541,1217 @@ double tl_compute_log_likelihood(TreeModel *mod, MSA *msa,
 
   } /* for tupleidx */
 
-  for (j = 0; j < nstates; j++) {
-    sfree(inside_joint[j]);
-    sfree(outside_joint[j]);
-    if (mod->order > 0) sfree(inside_marginal[j]);
-    if (mod->order > 0 && post != NULL) sfree(outside_marginal[j]);
-  }
-  sfree(inside_joint);
-  sfree(outside_joint);
-  if (mod->order > 0) sfree(inside_marginal);
-  if (mod->order > 0 && post != NULL) sfree(outside_marginal);
   if (col_scores != NULL) {
+    /* (with non-overlapping tuples, e.g., codons, only the last column
+       of each tuple has a tuple index; the others score zero) */
     if (cat >= 0)
       for (i = 0; i < msa->length; i++)
-        col_scores[i] = msa->categories[i] == cat ?
-          curr_tuple_scores[msa->ss->tuple_idx[i]] :
-          NEGINFTY;
+        col_scores[i] = msa->categories[i] != cat ? NEGINFTY :
+          (msa->ss->tuple_idx[i] < 0 ? 0 :
+           curr_tuple_scores[msa->ss->tuple_idx[i]]);
     else
       for (i = 0; i < msa->length; i++)
-        col_scores[i] = curr_tuple_scores[msa->ss->tuple_idx[i]];
-    if (tuple_scores == NULL) sfree(curr_tuple_scores);
+        col_scores[i] = (msa->ss->tuple_idx[i] < 0 ? 0 :
+                         curr_tuple_scores[msa->ss->tuple_idx[i]]);
   }
-  if (post != NULL) {
+  if (patterns != NULL && cache == NULL)
+    tl_free_patterns(patterns, mod->tree->nnodes);
+  ar_scratch_end(ar, mark);
+  PROF_END(PROF_LIKELIHOOD, msa->ss->ntuples);
+  return(retval);
+}
+
+/* Copy the substitution matrices of all branches, with the rate
+   categories interleaved: the probability of a substitution from
+   state i to state j in rate category r on the branch above node id
+   is at [id][(i*nstates + j)*nratecats + r].  (The entry of the root
+   is NULL) */
+static double **tl_interleave_P(TreeModel *mod, Arena *ar) {
+  int i, j, r, id, nstates = mod->rate_matrix->size, nrc = mod->nratecats;
+  double **Pint = ar_alloc(ar, mod->tree->nnodes * sizeof(double*));
+  double *M;
+  TreeNode *n;
+
+  for (id = 0; id < mod->tree->nnodes; id++) {
+    n = lst_get_ptr(mod->tree->nodes, id);
+    Pint[n->id] = NULL;
+    if (n->parent == NULL) continue;
+    M = Pint[n->id] = ar_alloc(ar, (size_t)nstates * nstates * nrc *
+                               sizeof(double));
+    for (r = 0; r < nrc; r++)
+      for (i = 0; i < nstates; i++)
+        for (j = 0; j < nstates; j++)
+          M[((size_t)i*nstates + j)*nrc + r] = mm_get(mod->P[n->id][r], i, j);
+  }
+  return Pint;
+}
+
+/* Compute the probability of a tuple by the pruning algorithm, for
+   all rate categories in a single traversal of the tree.  The inside
+   vector of each node is stored at inside + id*nstates*nratecats,
+   with the entry of state i and rate category r at i*nratecats + r.
+   'Pint' holds the substitution matrices in the same interleaved
+   layout (see tl_interleave_P).  If 'dirty' is non-NULL, only the
+   nodes marked in it are computed; the others already have valid
+   inside vectors.  Memoized nodes and pruned trees
+   are used if 'patterns' is non-NULL.  With a single rate category
+   the order of operations is that of the general computation in
+   tl_compute_log_likelihood; with several, each category is computed
+   as it would be on its own, so results do not depend on the
+   layout */
+static double tl_inside_prob(TreeModel *mod, MSA *msa, int tupleidx,
+                             double **Pint, double *inside,
+                             TreeLikPatterns *patterns, int *dirty) {
+  int i, r, nodeidx, nvisit, col_offset, thisseq;
+  int nstates = mod->rate_matrix->size, nrc = mod->nratecats;
+  size_t vlen = (size_t)nstates * nrc;
+  List *traversal = tr_postorder(mod->tree);
+  TreeLikPruned *pruned;
+  TreeNode *n;
+  double leafvec[nstates], *vec, sum, total_prob = 0;
+  char chars[mod->order+1];
+
+  /* tree pruned of subtrees with missing data, if any */
+  pruned = (patterns != NULL && patterns->plan[tupleidx] >= 0 ?
+            lst_get_ptr(patterns->pruned, patterns->plan[tupleidx]) : NULL);
+  nvisit = (pruned != NULL ? pruned->nnodes : lst_size(traversal));
+
+  for (nodeidx = 0; nodeidx < nvisit; nodeidx++) {
+    n = (pruned != NULL ?
+         lst_get_ptr(mod->tree->nodes, pruned->ids[nodeidx]) :
+         lst_get_ptr(traversal, nodeidx));
+    if (dirty != NULL && !dirty[n->id])
+      continue;                 /* cached value still valid */
+    vec = inside + n->id * vlen;
+    if (n->lchild == NULL) {
+      /* leaf: base case of recursion */
+      if (patterns != NULL && n->parent != NULL &&
+          patterns->memo[n->parent->id])
+        continue;               /* not needed */
+
+      thisseq = mod->msa_seq_idx[n->id];
+      if (thisseq < 0)
+        die("ERROR tl_compute_log_likelihood: expected a leaf node\n");
+      for (col_offset = -1*mod->order; col_offset <= 0; col_offset++)
+        chars[mod->order+col_offset] =
+          ss_get_char_tuple(msa, tupleidx, thisseq, col_offset);
+      tl_leaf_vector(mod, chars, 0, leafvec);
+      for (i = 0; i < nstates; i++)
+        for (r = 0; r < nrc; r++)
+          vec[i*nrc + r] = leafvec[i];
+    }
+    else if (patterns != NULL && patterns->memo[n->id]) {
+      /* memoized node: copy inside vector of pattern, unless only
+         needed for a memoized parent */
+      if (patterns->memo[n->parent->id])
+        continue;
+      memcpy(vec, patterns->vals[n->id] +
+             (size_t)patterns->cls[n->id][tupleidx] * vlen,
+             vlen * sizeof(double));
+    }
+    else if (pruned != NULL)
+      tl_pruned_vector(pruned, nodeidx, Pint, inside, nstates, nrc);
+    else
+      tl_inside_vector(vec, inside + n->lchild->id * vlen,
+                       Pint[n->lchild->id], inside + n->rchild->id * vlen,
+                       Pint[n->rchild->id], nstates, nrc);
+  }
+
+  vec = inside + mod->tree->id * vlen;
+  for (r = 0; r < nrc; r++) {
+    sum = 0;
+    for (i = 0; i < nstates; i++)
+      sum += vec_get(mod->backgd_freqs, i) * vec[i*nrc + r] *
+        mod->freqK[r];
+    total_prob += sum;
+  }
+  return total_prob;
+}
+
+/* Compute the inside vector of a node ('out') from those of its
+   children and the substitution matrices of the branches to them, for
+   all rate categories (interleaved as in tl_inside_prob).  If a child
+   vector is NULL, the corresponding factor is one.  The loops over
+   rate categories are innermost and contiguous, so that the compiler
+   can vectorize them */
+static void tl_inside_vector(double *out, double *lvec, double *lmat,
+                             double *rvec, double *rmat, int nstates,
+                             int nrc) {
+  int i, j, r;
+  double totl[nrc], totr[nrc], *v, *m;
+
+  if (nrc == 1) {               /* (no lanes to fill) */
+    for (i = 0; i < nstates; i++) {
+      double tl = 1, tr = 1;
+      if (lvec != NULL)
+        for (j = 0, tl = 0; j < nstates; j++)
+          tl += lvec[j] * lmat[i*nstates + j];
+      if (rvec != NULL)
+        for (j = 0, tr = 0; j < nstates; j++)
+          tr += rvec[j] * rmat[i*nstates + j];
+      out[i] = tl * tr;
+    }
+    return;
+  }
+
+  for (i = 0; i < nstates; i++) {
+    for (r = 0; r < nrc; r++) {
+      totl[r] = (lvec != NULL ? 0 : 1);
+      totr[r] = (rvec != NULL ? 0 : 1);
+    }
+    if (lvec != NULL)
+      for (j = 0, v = lvec, m = lmat + (size_t)i * nstates * nrc;
+           j < nstates; j++, v += nrc, m += nrc)
+        for (r = 0; r < nrc; r++)
+          totl[r] += v[r] * m[r];
+    if (rvec != NULL)
+      for (j = 0, v = rvec, m = rmat + (size_t)i * nstates * nrc;
+           j < nstates; j++, v += nrc, m += nrc)
+        for (r = 0; r < nrc; r++)
+          totr[r] += v[r] * m[r];
+    for (r = 0; r < nrc; r++)
+      out[i*nrc + r] = totl[r] * totr[r];
+  }
+}
+
+/* Return TRUE if a tuple is to be skipped in the computation of the
+   likelihood, because it contains a gap and gaps are not allowed, or
+   because it is not informative and informative columns are
+   required */
+static int tl_skip_tuple(TreeModel *mod, MSA *msa, int tupleidx) {
+  int j, ninform = 0;
+  if (!mod->allow_gaps)
+    for (j = 0; j < msa->nseqs; j++)
+      if (ss_get_char_tuple(msa, tupleidx, j, 0) == GAP_CHAR)
+        return TRUE;
+  if (mod->inform_reqd) {
+    for (j = 0; j < msa->nseqs; j++) {
+      if (msa->is_informative != NULL && !msa->is_informative[j])
+        continue;
+      else if (!msa->is_missing[(int)ss_get_char_tuple(msa, tupleidx, j, 0)])
+        ninform++;
+    }
+    if (ninform < 2) return TRUE;
+  }
+  return FALSE;
+}
+
+/* Identify the states of a model that can be left out of the pruning
+   computation: those with zero equilibrium frequency and no
+   substitutions into them, in the main model and in all alternative
+   models.  Typically these are the stop codons of a codon model whose
+   frequencies were estimated from a cleaned coding alignment.  Such a
+   state has zero probability at the root and cannot be reached from
+   any other state, so it contributes nothing to the likelihood of a
+   column unless it is observed at a leaf.  The remaining states are
+   stored in 'active' (which must have room for all states), and
+   their number is returned */
+static int tl_active_states(TreeModel *mod, int *active) {
+  int i, j, k, reachable, nactive = 0, nstates = mod->rate_matrix->size;
+  AltSubstMod *altmod;
+
+  for (j = 0; j < nstates; j++) {
+    reachable = (vec_get(mod->backgd_freqs, j) != 0);
+    for (i = 0; !reachable && i < nstates; i++)
+      if (i != j && mm_get(mod->rate_matrix, i, j) != 0)
+        reachable = TRUE;
+    for (k = 0; !reachable && mod->alt_subst_mods != NULL &&
+           k < lst_size(mod->alt_subst_mods); k++) {
+      altmod = lst_get_ptr(mod->alt_subst_mods, k);
+      if (altmod->backgd_freqs != NULL &&
+          vec_get(altmod->backgd_freqs, j) != 0)
+        reachable = TRUE;
+      for (i = 0; !reachable && altmod->rate_matrix != NULL &&
+             i < nstates; i++)
+        if (i != j && mm_get(altmod->rate_matrix, i, j) != 0)
+          reachable = TRUE;
+    }
+    if (reachable) active[nactive++] = j;
+  }
+  return nactive;
+}
+
+/* Multiply the partial likelihoods of a batch of 'nrows' tuples,
+   stored row by row in 'in', by a transposed substitution matrix
+   'PT', storing the result in 'out'; that is, out[b][i] = sum_j
+   in[b][j] * PT[j][i], with all matrices of dimension 'n'.  Four rows
+   are done at a time, so that each element of PT is loaded once for
+   four tuples; the innermost loop runs over contiguous elements of
+   PT and out and can be vectorized by the compiler */
+static void tl_batch_mult(double *out, double *in, double *PT, int nrows,
+                          int n) {
+  int b, i, j;
+  double a0, a1, a2, a3, *p, *o0, *o1, *o2, *o3;
+
+  for (b = 0; b + 4 <= nrows; b += 4) {
+    o0 = out + b*n; o1 = o0 + n; o2 = o1 + n; o3 = o2 + n;
+    for (i = 0; i < n; i++) o0[i] = o1[i] = o2[i] = o3[i] = 0;
+    for (j = 0; j < n; j++) {
+      a0 = in[b*n + j]; a1 = in[(b+1)*n + j];
+      a2 = in[(b+2)*n + j]; a3 = in[(b+3)*n + j];
+      p = PT + j*n;
+      for (i = 0; i < n; i++) {
+        o0[i] += a0 * p[i];
+        o1[i] += a1 * p[i];
+        o2[i] += a2 * p[i];
+        o3[i] += a3 * p[i];
+      }
+    }
+  }
+  for (; b < nrows; b++) {
+    o0 = out + b*n;
+    for (i = 0; i < n; i++) o0[i] = 0;
+    for (j = 0; j < n; j++) {
+      a0 = in[b*n + j];
+      p = PT + j*n;
+      for (i = 0; i < n; i++) o0[i] += a0 * p[i];
+    }
+  }
+}
+
+/* Compute the probabilities of column tuples under a codon model, for
+   use by tl_compute_log_likelihood when posterior probabilities are
+   not needed.  Tuples are processed in batches of TL_BATCH_SIZE, and
+   the partial likelihoods of all tuples in a batch at a node are
+   stored together as a matrix, so that the pruning step at each
+   internal node becomes a product of two dense matrices (see
+   tl_batch_mult), rather than a matrix-vector product per tuple.
+   Only states that can be reached are considered (see
+   tl_active_states).  When a child is a leaf with a single possible
+   state or with missing data, its contribution is a column or the
+   row sums of the substitution matrix, and no product is required.
+
+   If 'cache' is non-NULL, the partial likelihoods of internal nodes
+   are kept in it, by batch, rate category, node, tuple, and state,
+   and only nodes above changed branches are recomputed (see
+   tl_cache_update), provided the same tuples and states are in use
+   as in the previous call.
+
+   On return, probs[tupleidx] is the probability of each tuple,
+   summed over rate categories, and done[tupleidx] indicates whether
+   it was computed; it is not for tuples with zero counts, tuples to
+   be skipped (see tl_skip_tuple), or tuples in which some leaf can
+   only be in a state that was left out.  The latter are left to the
+   general code.  Scratch memory is allocated from 'ar', which is
+   expected to be released by the caller */
+static void tl_codon_batch_probs(TreeModel *mod, MSA *msa, int cat,
+                                 TreeLikCache *cache, Arena *ar,
+                                 double *probs, int *done) {
+  int nstates = mod->rate_matrix->size, nnodes = mod->tree->nnodes,
+    alph_size = (int)strlen(mod->rate_matrix->states);
+  int i, j, k, b, p, nact, ntup, start, nb, nodeidx, rcat, col_offset,
+    nmatch, incremental = FALSE, base_epoch = 0;
+  int *active = ar_alloc(ar, nstates * sizeof(int));
+  int *tuples = ar_alloc(ar, msa->ss->ntuples * sizeof(int));
+  int **proj, **leaf_state;
+  double **PT, **rowsums, *leaves, *part, *tmp, *L, *out, *src;
+  size_t blocksize;
+  int partial_match[mod->order+1][alph_size];
+  List *traversal = tr_postorder(mod->tree);
+  TreeNode *n, *child;
+
+  nact = tl_active_states(mod, active);
+  blocksize = (size_t)TL_BATCH_SIZE * nact; /* one node of one batch */
+
+  /* projection of each active state on each position of the tuple */
+  proj = ar_alloc_int_matrix(ar, nact, mod->order+1);
+  for (i = 0; i < nact; i++)
+    for (p = 0; p <= mod->order; p++)
+      proj[i][p] = (active[i] / int_pow(alph_size, mod->order - p)) %
+        alph_size;
+
+  /* transposed substitution matrices restricted to the active states,
+     and their row sums, indexed by node and rate category */
+  PT = ar_alloc(ar, nnodes * mod->nratecats * sizeof(double*));
+  rowsums = ar_alloc(ar, nnodes * mod->nratecats * sizeof(double*));
+  for (nodeidx = 0; nodeidx < nnodes; nodeidx++) {
+    n = lst_get_ptr(mod->tree->nodes, nodeidx);
+    if (n->parent == NULL) continue;
     for (rcat = 0; rcat < mod->nratecats; rcat++) {
-      for (j = 0; j < nstates; j++) {
-        for (k = 0; k < nstates; k++)
-          sfree(subst_probs[rcat][j][k]);
-        sfree(subst_probs[rcat][j]);
+      double *pt = ar_alloc(ar, nact * nact * sizeof(double));
+      double *rs = ar_alloc(ar, nact * sizeof(double));
+      MarkovMatrix *P = mod->P[n->id][rcat];
+      for (i = 0; i < nact; i++) {
+        rs[i] = 0;
+        for (j = 0; j < nact; j++) {
+          pt[j*nact + i] = mm_get(P, active[i], active[j]);
+          rs[i] += pt[j*nact + i];
+        }
+      }
+      PT[n->id * mod->nratecats + rcat] = pt;
+      rowsums[n->id * mod->nratecats + rcat] = rs;
+    }
+  }
+
+  /* tuples to compute */
+  for (i = 0, ntup = 0; i < msa->ss->ntuples; i++) {
+    done[i] = FALSE;
+    if ((cat >= 0 && msa->ss->cat_counts[cat][i] == 0) ||
+        (cat < 0 && msa->ss->counts[i] == 0) ||
+        tl_skip_tuple(mod, msa, i))
+      continue;
+    tuples[ntup++] = i;
+  }
+
+  if (cache != NULL) {
+    base_epoch = tl_cache_update(cache, mod);
+    if (cache->nbatch_tuples != ntup || cache->nactive != nact ||
+        memcmp(cache->batch_tuples, tuples, ntup * sizeof(int)) != 0 ||
+        memcmp(cache->active, active, nact * sizeof(int)) != 0) {
+      /* batches have changed; invalidate all partials */
+      for (i = 0; i < cache->ntuples; i++) cache->stamp[i] = -1;
+      memcpy(cache->batch_tuples, tuples, ntup * sizeof(int));
+      memcpy(cache->active, active, nact * sizeof(int));
+      cache->nbatch_tuples = ntup;
+      cache->nactive = nact;
+    }
+    part = NULL;
+  }
+  else                          /* reused for all batches and rate
+                                   categories */
+    part = ar_alloc(ar, (nnodes+1) * blocksize * sizeof(double));
+
+  /* partial likelihoods at the leaves, which are the same for all
+     rate categories, and for each leaf and tuple, the state if it is
+     determined (>= 0), -1 for missing data, or -2 otherwise */
+  leaves = ar_alloc(ar, (nnodes+1) * blocksize * sizeof(double));
+  leaf_state = ar_alloc_int_matrix(ar, nnodes+1, TL_BATCH_SIZE);
+  tmp = ar_alloc(ar, blocksize * sizeof(double));
+
+  for (start = 0; start < ntup; start += TL_BATCH_SIZE) {
+    nb = min(TL_BATCH_SIZE, ntup - start);
+    checkInterrupt();
+
+    if (cache != NULL) {
+      /* partials are current except at dirty nodes only if all tuples
+         in the batch were computed after the last change */
+      for (b = 0, incremental = TRUE; b < nb; b++) {
+        if (cache->stamp[tuples[start+b]] != base_epoch)
+          incremental = FALSE;
+        cache->stamp[tuples[start+b]] = cache->epoch;
+      }
+    }
+
+    for (b = 0; b < nb; b++) {
+      done[tuples[start+b]] = TRUE;
+      probs[tuples[start+b]] = 0;
+    }
+
+    for (nodeidx = 0; nodeidx < nnodes; nodeidx++) {
+      n = lst_get_ptr(mod->tree->nodes, nodeidx);
+      if (n->lchild != NULL) continue;
+      if (mod->msa_seq_idx[n->id] < 0)
+        die("ERROR tl_compute_log_likelihood: expected a leaf node\n");
+      L = leaves + n->id * blocksize;
+      for (b = 0; b < nb; b++) {
+        for (col_offset = -1*mod->order; col_offset <= 0; col_offset++) {
+          char thischar = ss_get_char_tuple(msa, tuples[start+b],
+                                            mod->msa_seq_idx[n->id],
+                                            col_offset);
+          int observed_state = mod->rate_matrix->inv_states[(int)thischar];
+          int *iupac_prob = (observed_state < 0 ?
+                             mod->iupac_inv_map[(int)thischar] : NULL);
+          for (i = 0; i < alph_size; i++)
+            partial_match[mod->order+col_offset][i] =
+              (iupac_prob != NULL ? iupac_prob[i] :
+               (observed_state < 0 || i == observed_state));
+        }
+        for (i = 0, nmatch = 0; i < nact; i++) {
+          int total_match = 1;
+          for (p = 0; p <= mod->order && total_match; p++)
+            if (!partial_match[p][proj[i][p]]) total_match = 0;
+          L[b*nact + i] = total_match;
+          if (total_match) {
+            nmatch++;
+            leaf_state[n->id][b] = i;
+          }
+        }
+        if (nmatch == 0) {      /* left to general code */
+          done[tuples[start+b]] = FALSE;
+          leaf_state[n->id][b] = -2;
+        }
+        else if (nmatch == nact)
+          leaf_state[n->id][b] = -1;
+        else if (nmatch > 1)
+          leaf_state[n->id][b] = -2;
+      }
+    }
+
+    for (rcat = 0; rcat < mod->nratecats; rcat++) {
+      if (cache != NULL)
+        part = cache->partials + ((size_t)start / TL_BATCH_SIZE *
+                                  mod->nratecats + rcat) *
+          (nnodes+1) * blocksize;
+
+      for (nodeidx = 0; nodeidx < lst_size(traversal); nodeidx++) {
+        n = lst_get_ptr(traversal, nodeidx);
+        if (n->lchild == NULL) continue;
+        if (incremental && !cache->dirty[n->id])
+          continue;             /* cached value still valid */
+        L = part + n->id * blocksize;
+        for (k = 0; k < 2; k++) {
+          child = (k == 0 ? n->lchild : n->rchild);
+          out = (k == 0 ? L : tmp);
+          if (child->lchild != NULL)
+            tl_batch_mult(out, part + child->id * blocksize,
+                          PT[child->id * mod->nratecats + rcat], nb, nact);
+          else {
+            src = leaves + child->id * blocksize;
+            for (b = 0; b < nb; b++) {
+              int s = leaf_state[child->id][b];
+              if (s >= 0)
+                memcpy(out + b*nact,
+                       PT[child->id * mod->nratecats + rcat] + s*nact,
+                       nact * sizeof(double));
+              else if (s == -1)
+                memcpy(out + b*nact,
+                       rowsums[child->id * mod->nratecats + rcat],
+                       nact * sizeof(double));
+              else
+                tl_batch_mult(out + b*nact, src + b*nact,
+                              PT[child->id * mod->nratecats + rcat],
+                              1, nact);
+            }
+          }
+        }
+        for (i = 0; i < nb * nact; i++)
+          L[i] *= tmp[i];
+      }
+
+      L = part + mod->tree->id * blocksize;
+      for (b = 0; b < nb; b++) {
+        double rcat_prob = 0;
+        for (i = 0; i < nact; i++)
+          rcat_prob += vec_get(mod->backgd_freqs, active[i]) *
+            L[b*nact + i] * mod->freqK[rcat];
+        probs[tuples[start+b]] += rcat_prob;
       }
-      sfree (subst_probs[rcat]);
     }
-    sfree(subst_probs);
   }
-  return(retval);
 }
 
-/* this is retained for possible use in the future; not using weight
-   matrices for much anymore */
-void tl_compute_log_likelihood_weight_matrix(TreeModel *mod, MSA *msa,
-                                             double *col_scores, int cat) {
-  int i, seq, idx, alph_size = (int)strlen(msa->alphabet);
-  double retval = 0;
-  char tuple[mod->order + 2];
-  Vector *margfreqs =
-    get_marginal_eq_freqs(mod->rate_matrix->states, mod->order+1,
-                          mod->backgd_freqs);
+/* Compute the inside vector of a leaf from its characters in a column
+   tuple ('chars', indexed by column offset plus model order).  On a
+   second pass with conditional probabilities, the current character
+   is treated as missing */
+static void tl_leaf_vector(TreeModel *mod, char *chars, int pass,
+                           double *vec) {
+  int i, col_offset, nstates = mod->rate_matrix->size;
+  int alph_size = (int)strlen(mod->rate_matrix->states);
+  int partial_match[mod->order+1][alph_size];
+
+  /* first figure out whether there is a match for each character in
+     each position; we'll call this the record of "partial_matches". */
+  for (col_offset = -1*mod->order; col_offset <= 0; col_offset++) {
+    int observed_state = -1;
+    int *iupac_prob = NULL;
+
+    if (pass == 0 || col_offset < 0) {
+      char thischar = chars[mod->order+col_offset];
+      observed_state = mod->rate_matrix->inv_states[(int)thischar];
+      if (observed_state < 0)
+        iupac_prob = mod->iupac_inv_map[(int)thischar];
+    }
+
+    /* otherwise, we're on a second pass and looking the current base,
+       so we want to use the "missing information" principle */
+
+    if (iupac_prob != NULL) {
+      for (i = 0; i < alph_size; i++)
+        partial_match[mod->order+col_offset][i] = iupac_prob[i];
+    }
+    else {
+      for (i = 0; i < alph_size; i++) {
+        if (observed_state < 0 || i == observed_state)
+          partial_match[mod->order+col_offset][i] = 1;
+        else
+          partial_match[mod->order+col_offset][i] = 0;
+      }
+    }
+  }
+
+  /* now find the intersection of the partial matches */
+  for (i = 0; i < nstates; i++) {
+    if (mod->order == 0)  /* handle 0th order model as special case, for
+                             efficiency.  In this case the partial
+                             match *is* the total match */
+      vec[i] = partial_match[0][i];
+    else {
+      int total_match = 1;
+      /* figure out the "projection" of state i in the dimension of
+         each position, and see whether there is a corresponding
+         partial match. */
+      /* NOTE: mod->order is approx equal to log nstates (prob no more
+         than 2) */
+      for (col_offset = -1*mod->order; col_offset <= 0 && total_match;
+           col_offset++) {
+        int projection = (i / int_pow(alph_size, -1 * col_offset)) %
+          alph_size;
+
+        if (!partial_match[mod->order+col_offset][projection])
+          total_match = 0;      /* must have partial matches in all
+                                   dimensions for a total match */
+      }
+      vec[i] = total_match;
+    }
+  }
+}
+
+/* Return the key of the leaf pattern below a node for a given tuple:
+   its class, if the node is a memoized internal node, or a code for
+   its characters (one byte per column offset), if it is a leaf */
+static PHAST_INLINE
+int tl_pattern_key(TreeModel *mod, MSA *msa, TreeLikPatterns *pat,
+                   TreeNode *n, int tupleidx) {
+  int key = 0, col_offset, seq;
+  if (n->lchild != NULL) return pat->cls[n->id][tupleidx];
+  seq = mod->msa_seq_idx[n->id];
+  for (col_offset = -1*mod->order; col_offset <= 0; col_offset++)
+    key = key * 256 +
+      (unsigned char)ss_get_char_tuple(msa, tupleidx, seq, col_offset);
+  return key;
+}
+
+/* Classify the given tuples by their patterns of characters at the
+   leaves below each internal node, and choose the nodes whose inside
+   vectors will be computed once per class ("memoized" nodes).  The
+   class of a tuple at a node is determined by the keys of its
+   children (see tl_pattern_key), and is found by hashing.  A node is
+   memoized if each of its children is a leaf or a memoized node, if
+   it has at most half as many classes as there are tuples, and if
+   memory is available (at most TL_CACHE_MAX_BYTES is used for all
+   nodes and pruned trees).  The root is never memoized.  Pruned trees
+   for tuples with missing data are then found (see tl_find_pruned).
+   Returns a newly allocated object, possibly without memoized nodes
+   or pruned trees */
+static TreeLikPatterns *tl_find_patterns(TreeModel *mod, MSA *msa,
+                                         int *tuples, int ntuples) {
+  TreeLikPatterns *pat = smalloc(sizeof(TreeLikPatterns));
+  int nnodes = mod->tree->nnodes, nstates = mod->rate_matrix->size;
+  int i, t, c, l, r, nc, size, *table, *cls, *kids;
+  unsigned int h;
+  double bytes, budget = TL_CACHE_MAX_BYTES;
+  List *traversal = tr_postorder(mod->tree);
+  TreeNode *n;
+
+  pat->ntuples = ntuples;
+  pat->tuples = smalloc((ntuples+1) * sizeof(int));
+  memcpy(pat->tuples, tuples, ntuples * sizeof(int));
+  pat->nmemo = 0;
+  pat->memo = smalloc(nnodes * sizeof(int));
+  pat->nclasses = smalloc(nnodes * sizeof(int));
+  pat->cls = smalloc(nnodes * sizeof(int*));
+  pat->kids = smalloc(nnodes * sizeof(int*));
+  pat->vals = smalloc(nnodes * sizeof(double*));
+  for (i = 0; i < nnodes; i++) {
+    pat->memo[i] = FALSE;
+    pat->nclasses[i] = 0;
+    pat->cls[i] = pat->kids[i] = NULL;
+    pat->vals[i] = NULL;
+  }
+  pat->plan = NULL;
+  pat->pruned = NULL;
+  pat->valid = FALSE;
+
+  /* (codes for leaves must fit in an int) */
+  if (mod->order <= 2 && ntuples >= 2) {
+
+    for (size = 1; size < 2 * ntuples; size *= 2);
+    table = smalloc(size * sizeof(int));
+
+    for (i = 0; i < lst_size(traversal); i++) {
+      n = lst_get_ptr(traversal, i);
+      if (n->lchild == NULL || n->parent == NULL ||
+          (n->lchild->lchild != NULL && !pat->memo[n->lchild->id]) ||
+          (n->rchild->lchild != NULL && !pat->memo[n->rchild->id]))
+        continue;
+
+      cls = smalloc(msa->ss->ntuples * sizeof(int));
+      kids = smalloc(2 * (ntuples/2 + 1) * sizeof(int));
+      for (t = 0; t < size; t++) table[t] = -1;
+
+      /* give up as soon as there are too many classes */
+      for (t = 0, nc = 0; t < ntuples && 2 * nc <= ntuples; t++) {
+        l = tl_pattern_key(mod, msa, pat, n->lchild, tuples[t]);
+        r = tl_pattern_key(mod, msa, pat, n->rchild, tuples[t]);
+        h = (unsigned int)l * 2654435761U ^ (unsigned int)r * 2246822519U;
+        for (h = (h ^ (h >> 15)) & (size-1);
+             (c = table[h]) >= 0 && (kids[2*c] != l || kids[2*c+1] != r);
+             h = (h+1) & (size-1));
+        if (c < 0) {
+          c = table[h] = nc++;
+          kids[2*c] = l;
+          kids[2*c+1] = r;
+        }
+        cls[tuples[t]] = c;
+      }
+
+      bytes = (double)msa->ss->ntuples * sizeof(int) +
+        (double)nc * (2 * sizeof(int) +
+                      mod->nratecats * nstates * sizeof(double));
+      if (2 * nc > ntuples || bytes > budget) {
+        sfree(cls);
+        sfree(kids);
+        continue;
+      }
+      budget -= bytes;
+      pat->memo[n->id] = TRUE;
+      pat->nclasses[n->id] = nc;
+      pat->cls[n->id] = cls;
+      pat->kids[n->id] = srealloc(kids, 2 * nc * sizeof(int));
+      pat->vals[n->id] = smalloc((size_t)nc * mod->nratecats * nstates *
+                                 sizeof(double));
+      pat->nmemo++;
+    }
+    sfree(table);
+  }
+
+  tl_find_pruned(mod, msa, pat, budget);
+  return pat;
+}
+
+/* Compute the inside vectors of all classes at the memoized nodes, or
+   only at the nodes marked in 'dirty', if it is non-NULL ('Pint' holds
+   the substitution matrices, as in tl_inside_prob) */
+static void tl_pattern_vals(TreeModel *mod, TreeLikPatterns *pat,
+                            double **Pint, int *dirty) {
+  int i, k, c, key, rcat, nodeidx, col_offset;
+  int nstates = mod->rate_matrix->size, nrc = mod->nratecats;
+  List *traversal = tr_postorder(mod->tree);
+  TreeNode *n;
+  TreeLikPruned *pr;
+  size_t vlen = (size_t)nstates * nrc;
+  double leafvec[nstates], lleaf[vlen], rleaf[vlen], *lvec, *rvec;
+  char chars[mod->order+1];
+
+  for (nodeidx = 0; pat->nmemo > 0 && nodeidx < lst_size(traversal);
+       nodeidx++) {
+    n = lst_get_ptr(traversal, nodeidx);
+    if (!pat->memo[n->id] || (dirty != NULL && !dirty[n->id]))
+      continue;
+    for (c = 0; c < pat->nclasses[n->id]; c++) {
+      /* leaf children: decode characters (the key of the last column
+         offset is in the lowest byte) */
+      if (n->lchild->lchild == NULL) {
+        key = pat->kids[n->id][2*c];
+        for (col_offset = 0; col_offset >= -1*mod->order; col_offset--,
+               key >>= 8)
+          chars[mod->order+col_offset] = (char)(key & 255);
+        tl_leaf_vector(mod, chars, 0, leafvec);
+        for (i = 0; i < nstates; i++)
+          for (rcat = 0; rcat < nrc; rcat++)
+            lleaf[i*nrc + rcat] = leafvec[i];
+      }
+      if (n->rchild->lchild == NULL) {
+        key = pat->kids[n->id][2*c+1];
+        for (col_offset = 0; col_offset >= -1*mod->order; col_offset--,
+               key >>= 8)
+          chars[mod->order+col_offset] = (char)(key & 255);
+        tl_leaf_vector(mod, chars, 0, leafvec);
+        for (i = 0; i < nstates; i++)
+          for (rcat = 0; rcat < nrc; rcat++)
+            rleaf[i*nrc + rcat] = leafvec[i];
+      }
+
+      lvec = (n->lchild->lchild == NULL ? lleaf :
+              pat->vals[n->lchild->id] + (size_t)pat->kids[n->id][2*c] * vlen);
+      rvec = (n->rchild->lchild == NULL ? rleaf :
+              pat->vals[n->rchild->id] +
+              (size_t)pat->kids[n->id][2*c+1] * vlen);
+      tl_inside_vector(pat->vals[n->id] + (size_t)c * vlen, lvec,
+                       Pint[n->lchild->id], rvec, Pint[n->rchild->id],
+                       nstates, nrc);
+    }
+  }
+
+  /* products of substitution matrices along bypassed paths of pruned
+     trees (such a path is below the node from which it starts) */
+  for (k = 0; k < lst_size(pat->pruned); k++) {
+    pr = lst_get_ptr(pat->pruned, k);
+    if (pr == NULL) continue;
+    for (i = 0; i < pr->nnodes; i++) {
+      if (dirty != NULL && !dirty[pr->ids[i]]) continue;
+      if (pr->lmat[i] != NULL)
+        tl_path_product(mod, pr->ltop[i], pr->lkid[i], pr->lmat[i]);
+      if (pr->rmat[i] != NULL)
+        tl_path_product(mod, pr->rtop[i], pr->rkid[i], pr->rmat[i]);
+    }
+  }
+  pat->valid = TRUE;
+}
+
+static void tl_free_patterns(TreeLikPatterns *pat, int nnodes) {
+  int i;
+  for (i = 0; i < nnodes; i++) {
+    sfree(pat->cls[i]);
+    sfree(pat->kids[i]);
+    sfree(pat->vals[i]);
+  }
+  for (i = 0; i < lst_size(pat->pruned); i++)
+    tl_free_pruned(lst_get_ptr(pat->pruned, i));
+  if (pat->pruned != NULL) lst_free(pat->pruned);
+  sfree(pat->plan);
+  sfree(pat->tuples);
+  sfree(pat->memo);
+  sfree(pat->nclasses);
+  sfree(pat->cls);
+  sfree(pat->kids);
+  sfree(pat->vals);
+  sfree(pat);
+}
+
+/* Find the pruned tree for each tuple with missing data at some
+   leaves (see TreeLikPruned).  One tree is constructed for each
+   distinct set of missing leaves, unless it would not save any
+   computation or more than 'budget' bytes would be used in all */
+static void tl_find_pruned(TreeModel *mod, MSA *msa, TreeLikPatterns *pat,
+                           double budget) {
+  int alph_size = (int)strlen(mod->rate_matrix->states);
+  int nnodes = mod->tree->nnodes, i, j, t, tup, idx, col_offset, nmissing;
+  int nleaves = 0, leaf_id[nnodes], leaf_seq[nnodes], empty[nnodes];
+  int char_missing[NCHARS];
+  char key[nnodes+1];
+  List *traversal = tr_postorder(mod->tree);
+  Hashtable *ht;
+  TreeNode *n;
+
+  pat->plan = smalloc(msa->ss->ntuples * sizeof(int));
+  pat->pruned = lst_new_ptr(10);
+  for (i = 0; i < msa->ss->ntuples; i++) pat->plan[i] = -1;
+  if (nnodes < 3) return;
+
+  /* a character is missing data if its inside vector is all ones */
+  for (i = 0; i < NCHARS; i++) {
+    char_missing[i] = (mod->rate_matrix->inv_states[i] < 0);
+    for (j = 0; char_missing[i] && mod->iupac_inv_map[i] != NULL &&
+           j < alph_size; j++)
+      if (mod->iupac_inv_map[i][j] != 1) char_missing[i] = FALSE;
+  }
+
+  for (i = 0; i < lst_size(traversal); i++) {
+    n = lst_get_ptr(traversal, i);
+    if (n->lchild != NULL) continue;
+    leaf_id[nleaves] = n->id;
+    leaf_seq[nleaves++] = mod->msa_seq_idx[n->id];
+  }
+
+  /* sets of missing leaves are identified by strings of flags, in
+     postorder; the subtrees that are empty are only found for new
+     sets */
+  ht = hsh_new(pat->ntuples + 1);
+  key[nleaves] = '\0';
+  for (t = 0; t < pat->ntuples; t++) {
+    tup = pat->tuples[t];
+    for (i = 0, nmissing = 0; i < nleaves; i++) {
+      key[i] = '1';
+      for (col_offset = -1*mod->order; col_offset <= 0; col_offset++)
+        if (!char_missing[(unsigned char)ss_get_char_tuple(msa, tup,
+                                                           leaf_seq[i],
+                                                           col_offset)]) {
+          key[i] = '0';
+          break;
+        }
+      if (key[i] == '1') nmissing++;
+    }
+    if (nmissing == 0) continue;
+
+    if ((idx = hsh_get_int(ht, key)) == -1) {
+      for (i = 0; i < nleaves; i++)
+        empty[leaf_id[i]] = (key[i] == '1');
+      for (i = 0; i < lst_size(traversal); i++) {
+        n = lst_get_ptr(traversal, i);
+        if (n->lchild != NULL)
+          empty[n->id] = empty[n->lchild->id] && empty[n->rchild->id];
+      }
+      idx = lst_size(pat->pruned);
+      lst_push_ptr(pat->pruned, tl_prune_tree(mod, pat, empty, &budget));
+      hsh_put_int(ht, key, idx);
+    }
+    if (lst_get_ptr(pat->pruned, idx) != NULL)
+      pat->plan[tup] = idx;
+  }
+  hsh_free(ht);
+}
+
+/* Return the nearest retained descendant of node 'c' (possibly 'c'
+   itself) in a pruned tree, following the nonempty children of
+   bypassed nodes, and the length of the path to it */
+static TreeNode *tl_pruned_path(TreeNode *c, int *keep, int *empty,
+                                int *len) {
+  for (*len = 1; !keep[c->id]; (*len)++)
+    c = (empty[c->lchild->id] ? c->rchild : c->lchild);
+  return c;
+}
+
+/* Construct a pruned tree given the subtrees in which all leaves are
+   missing data ('empty', indexed by node id).  Returns NULL if no node
+   would be removed, or if more than *budget bytes would be required
+   (otherwise *budget is decremented) */
+static TreeLikPruned *tl_prune_tree(TreeModel *mod, TreeLikPatterns *pat,
+                                    int *empty, double *budget) {
+  int nnodes = mod->tree->nnodes, nstates = mod->rate_matrix->size;
+  int i, k, len, nkept = 0, nremoved = 0, nmats = 0, keep[nnodes];
+  size_t matsize = (size_t)mod->nratecats * nstates * nstates;
+  double bytes;
+  List *traversal = tr_postorder(mod->tree);
+  TreeNode *n, *e;
+  TreeLikPruned *pr;
+
+  /* nodes below memoized nodes are neither retained nor removed */
+  for (i = 0; i < lst_size(traversal); i++) {
+    n = lst_get_ptr(traversal, i);
+    keep[n->id] = FALSE;
+    if (n->parent != NULL && pat->memo[n->parent->id]) continue;
+    keep[n->id] = (n->parent == NULL ||
+                   (!empty[n->id] &&
+                    (n->lchild == NULL || pat->memo[n->id] ||
+                     (!empty[n->lchild->id] && !empty[n->rchild->id]))));
+    if (keep[n->id]) nkept++;
+    else nremoved++;
+  }
+  if (nremoved == 0) return NULL;
+
+  pr = smalloc(sizeof(TreeLikPruned));
+  pr->nnodes = nkept;
+  pr->ids = smalloc(nkept * sizeof(int));
+  pr->lkid = smalloc(nkept * sizeof(int));
+  pr->rkid = smalloc(nkept * sizeof(int));
+  pr->ltop = smalloc(nkept * sizeof(int));
+  pr->rtop = smalloc(nkept * sizeof(int));
+  pr->lmat = smalloc(nkept * sizeof(double*));
+  pr->rmat = smalloc(nkept * sizeof(double*));
+  for (i = 0, k = 0; i < lst_size(traversal); i++) {
+    n = lst_get_ptr(traversal, i);
+    if (!keep[n->id]) continue;
+    pr->ids[k] = n->id;
+    pr->lkid[k] = pr->rkid[k] = pr->ltop[k] = pr->rtop[k] = -1;
+    pr->lmat[k] = pr->rmat[k] = NULL;
+    if (n->lchild != NULL && !pat->memo[n->id]) {
+      if (!empty[n->lchild->id]) {
+        e = tl_pruned_path(n->lchild, keep, empty, &len);
+        pr->lkid[k] = e->id;
+        pr->ltop[k] = n->lchild->id;
+        if (len > 1) {
+          pr->lmat[k] = smalloc(matsize * sizeof(double));
+          nmats++;
+        }
+      }
+      if (!empty[n->rchild->id]) {
+        e = tl_pruned_path(n->rchild, keep, empty, &len);
+        pr->rkid[k] = e->id;
+        pr->rtop[k] = n->rchild->id;
+        if (len > 1) {
+          pr->rmat[k] = smalloc(matsize * sizeof(double));
+          nmats++;
+        }
+      }
+    }
+    k++;
+  }
+
+  bytes = sizeof(TreeLikPruned) +
+    (double)nkept * (6 * sizeof(int) + 2 * sizeof(double*)) +
+    (double)nmats * matsize * sizeof(double);
+  if (bytes > *budget) {
+    tl_free_pruned(pr);
+    return NULL;
+  }
+  *budget -= bytes;
+  return pr;
+}
+
+static void tl_free_pruned(TreeLikPruned *pr) {
+  int i;
+  if (pr == NULL) return;
+  for (i = 0; i < pr->nnodes; i++) {
+    sfree(pr->lmat[i]);
+    sfree(pr->rmat[i]);
+  }
+  sfree(pr->ids);
+  sfree(pr->lkid);
+  sfree(pr->rkid);
+  sfree(pr->ltop);
+  sfree(pr->rtop);
+  sfree(pr->lmat);
+  sfree(pr->rmat);
+  sfree(pr);
+}
+
+/* Compute the product of the substitution matrices on the path from
+   node 'top' down to its descendant 'bottom' (both inclusive), for
+   each rate category, in 'mat' (indexed by row, column, and rate
+   category, as in tl_interleave_P) */
+static void tl_path_product(TreeModel *mod, int top, int bottom,
+                            double *mat) {
+  int i, j, l, m, rcat, npath = 0, nstates = mod->rate_matrix->size;
+  int nrc = mod->nratecats;
+  TreeNode *path[mod->tree->nnodes], *n;
+  MarkovMatrix *P;
+  double tmp[nstates * nstates], M[nstates * nstates], sum;
+
+  for (n = lst_get_ptr(mod->tree->nodes, bottom); n->id != top;
+       n = n->parent)
+    path[npath++] = n;
+
+  for (rcat = 0; rcat < nrc; rcat++) {
+    P = mod->P[top][rcat];
+    for (i = 0; i < nstates; i++)
+      for (j = 0; j < nstates; j++)
+        M[i*nstates + j] = mm_get(P, i, j);
+    for (l = npath - 1; l >= 0; l--) {
+      P = mod->P[path[l]->id][rcat];
+      for (i = 0; i < nstates; i++)
+        for (j = 0; j < nstates; j++) {
+          for (m = 0, sum = 0; m < nstates; m++)
+            sum += M[i*nstates + m] * mm_get(P, m, j);
+          tmp[i*nstates + j] = sum;
+        }
+      memcpy(M, tmp, nstates * nstates * sizeof(double));
+    }
+    for (i = 0; i < nstates * nstates; i++)
+      mat[(size_t)i*nrc + rcat] = M[i];
+  }
+}
+
+/* Compute the inside vector of the k-th node of a pruned tree from
+   those of its retained descendants, for all rate categories (in the
+   layout of tl_inside_prob; if a descendant is missing, the
+   corresponding factor is one) */
+static void tl_pruned_vector(TreeLikPruned *pr, int k, double **Pint,
+                             double *inside, int nstates, int nrc) {
+  int lkid = pr->lkid[k], rkid = pr->rkid[k];
+  size_t vlen = (size_t)nstates * nrc;
+
+  tl_inside_vector(inside + pr->ids[k] * vlen,
+                   lkid >= 0 ? inside + lkid * vlen : NULL,
+                   pr->lmat[k] != NULL ? pr->lmat[k] :
+                   (lkid >= 0 ? Pint[lkid] : NULL),
+                   rkid >= 0 ? inside + rkid * vlen : NULL,
+                   pr->rmat[k] != NULL ? pr->rmat[k] :
+                   (rkid >= 0 ? Pint[rkid] : NULL),
+                   nstates, nrc);
+}
+
+TreeLikCache *tl_new_cache(TreeModel *mod, MSA *msa) {
+  TreeLikCache *cache;
+  int i, nstates, nnodes, nslots;
+  double nbytes;
+
+  if (mod->tree == NULL || msa->ss == NULL ||
+      (mod->order > 0 && mod->use_conditionals == 1))
+    return NULL;
+
+  nstates = mod->rate_matrix->size;
+  nnodes = mod->tree->nnodes;
+  nslots = msa->ss->ntuples;
+  if (subst_mod_is_codon_model(mod->subst_mod))
+                                /* partials stored by whole batches */
+    nslots = (nslots + TL_BATCH_SIZE - 1) / TL_BATCH_SIZE * TL_BATCH_SIZE;
+  nbytes = (double)nslots * mod->nratecats * nstates *
+    (nnodes+1) * sizeof(double);
+  if (nbytes > TL_CACHE_MAX_BYTES) return NULL;
+
+  cache = smalloc(sizeof(TreeLikCache));
+  cache->msa = msa;
+  cache->ss = msa->ss;
+  cache->ntuples = msa->ss->ntuples;
+  cache->nnodes = nnodes;
+  cache->nstates = nstates;
+  cache->nratecats = mod->nratecats;
+  cache->partials = smalloc((size_t)nslots * mod->nratecats *
+                            nstates * (nnodes+1) * sizeof(double));
+  cache->P_snapshot = smalloc((size_t)nnodes * mod->nratecats * nstates *
+                              nstates * sizeof(double));
+  cache->dirty = smalloc((nnodes+1) * sizeof(int));
+  cache->stamp = smalloc(cache->ntuples * sizeof(int));
+  for (i = 0; i < cache->ntuples; i++) cache->stamp[i] = -1;
+  cache->epoch = 0;
+  cache->primed = FALSE;
+  cache->batch_tuples = cache->active = NULL;
+  cache->nbatch_tuples = cache->nactive = -1;
+  cache->patterns = NULL;
+  if (subst_mod_is_codon_model(mod->subst_mod)) {
+    cache->batch_tuples = smalloc(cache->ntuples * sizeof(int));
+    cache->active = smalloc(nstates * sizeof(int));
+  }
+  return cache;
+}
+
+void tl_free_cache(TreeLikCache *cache) {
+  sfree(cache->partials);
+  sfree(cache->P_snapshot);
+  sfree(cache->dirty);
+  sfree(cache->stamp);
+  sfree(cache->batch_tuples);
+  sfree(cache->active);
+  if (cache->patterns != NULL)
+    tl_free_patterns(cache->patterns, cache->nnodes);
+  sfree(cache);
+}
+
+int tl_attach_cache(TreeModel *mod, MSA *msa) {
+  if (mod->lik_cache != NULL) return FALSE;
+  mod->lik_cache = tl_new_cache(mod, msa);
+  return (mod->lik_cache != NULL);
+}
+
+void tl_detach_cache(TreeModel *mod) {
+  if (mod->lik_cache == NULL) return;
+  tl_free_cache(mod->lik_cache);
+  mod->lik_cache = NULL;
+}
+
+/* Return TRUE if the cache can be used for the given model and
+   alignment */
+static int tl_cache_matches(TreeLikCache *cache, TreeModel *mod, MSA *msa) {
+  return (cache->msa == msa && cache->ss == msa->ss &&
+          cache->ntuples == msa->ss->ntuples &&
+          cache->nnodes == mod->tree->nnodes &&
+          cache->nstates == mod->rate_matrix->size &&
+          cache->nratecats == mod->nratecats);
+}
+
+/* Compare the substitution matrices of the model with the snapshot
+   in the cache, mark the nodes whose partial likelihoods must be
+   recomputed (those above a changed branch), and update the snapshot.
+   Returns the epoch at which a tuple must have been computed for its
+   partials to be valid at all nodes not marked dirty */
+static int tl_cache_update(TreeLikCache *cache, TreeModel *mod) {
+  int i, j, k, changed = FALSE, nstates = cache->nstates;
+  int branch_changed[cache->nnodes];
+  List *traversal = tr_postorder(mod->tree);
+  TreeNode *n;
+  double *snap;
+
+  for (i = 0; i < cache->nnodes; i++) {
+    n = lst_get_ptr(mod->tree->nodes, i);
+    branch_changed[n->id] = FALSE;
+    if (n->parent == NULL) continue;
+    for (j = 0; j < cache->nratecats; j++) {
+      snap = cache->P_snapshot +
+        ((size_t)n->id * cache->nratecats + j) * nstates * nstates;
+      for (k = 0; k < nstates; k++, snap += nstates) {
+        if (cache->primed &&
+            memcmp(snap, mod->P[n->id][j]->matrix->data[k],
+                   nstates * sizeof(double)) == 0)
+          continue;
+        branch_changed[n->id] = TRUE;
+        memcpy(snap, mod->P[n->id][j]->matrix->data[k],
+               nstates * sizeof(double));
+      }
+    }
+    if (branch_changed[n->id]) changed = TRUE;
+  }
+
+  /* a node must be recomputed if a branch below it has changed */
+  for (i = 0; i < lst_size(traversal); i++) {
+    n = lst_get_ptr(traversal, i);
+    if (n->lchild == NULL)
+      cache->dirty[n->id] = !cache->primed;
+    else
+      cache->dirty[n->id] = cache->dirty[n->lchild->id] ||
+        cache->dirty[n->rchild->id] || branch_changed[n->lchild->id] ||
+        branch_changed[n->rchild->id];
+  }
+  cache->primed = TRUE;
+
+  if (!changed) return cache->epoch;
+  return cache->epoch++;
+}
+
+/* Weight matrices are scored by table lookup.  Each character is
+   mapped to a class -- its index in the alphabet, or one of
+   alph_size (missing data), alph_size+1 (a gap not marked as missing
+   data), and alph_size+2 (anything else) -- and the score of every
+   tuple of classes is precomputed, so that a sequence's contribution
+   to a column is a single lookup */
+#define WM_NCLASSES(alph_size) ((alph_size) + 3)
+
+/* log2 probability of a single sequence's tuple (mod->order+1
+   characters, the last from the current column) under a weight
+   matrix, or NEGINFTY if the tuple is prohibited.  The tuple is
+   overwritten */
+static double tl_wm_tuple_score(TreeModel *mod, MSA *msa, Vector *margfreqs,
+                                char *tuple, int alph_size) {
+  int i, idx;
+  double prob, tmp_prob, score;
+  int last = msa->inv_alphabet[(int)tuple[mod->order]];
+
+  if (!mod->allow_gaps && last < 0 &&
+      !msa->is_missing[(int)tuple[mod->order]])
+    return NEGINFTY;            /* apply the strict penalty iff there
+                                   is an unrecognized character in the
+                                   rightmost col; missing data is a
+                                   special case */
+  if (mod->allow_but_penalize_gaps && last < 0) {
+    prob = 1;
+    for (i = 0; i < alph_size; i++) {
+      tuple[mod->order] = msa->alphabet[i];
+      idx = tuple_index_missing_data(tuple, msa->inv_alphabet,
+                                     msa->is_missing, alph_size);
+      tmp_prob = (idx < 0 ? 0 : vec_get(margfreqs, idx));
+      if (tmp_prob < prob) prob = tmp_prob;
+    }
+    if (prob == 0) prob = 0.01;
+  }
+  else {
+    idx = tuple_index_missing_data(tuple, msa->inv_alphabet,
+                                   msa->is_missing, alph_size);
+    prob = (idx < 0 ? 0 : vec_get(margfreqs, idx));
+  }
+  if (prob == 0) return NEGINFTY;
+
+  score = log2(prob);
+  if (mod->use_conditionals && mod->order > 0) {
+    tuple[mod->order] = msa->missing[0];
+    idx = tuple_index_missing_data(tuple, msa->inv_alphabet,
+                                   msa->is_missing, alph_size);
+    score -= log2(idx < 0 ? 0 : vec_get(margfreqs, idx));
+  }
+  return score;
+}
+
+/* fill in the class of every character (see above) and build the
+   table of tuple scores, indexed by class codes with the leftmost
+   character most significant */
+static double *tl_wm_table(TreeModel *mod, MSA *msa, Vector *margfreqs,
+                           int alph_size, int *cls, Arena *ar) {
+  int ncl = WM_NCLASSES(alph_size), size = int_pow(ncl, mod->order+1);
+  int c, code, k, rem;
+  char rep[ncl], tuple[mod->order + 2];
+  double *table = ar_alloc(ar, size * sizeof(double));
+
+  for (k = 0; k < ncl; k++) rep[k] = '\0';
+  for (c = NCHARS-1; c > 0; c--) {
+    if (msa->inv_alphabet[c] >= 0) cls[c] = msa->inv_alphabet[c];
+    else if (msa->is_missing[c]) cls[c] = alph_size;
+    else if (c == GAP_CHAR) cls[c] = alph_size + 1;
+    else cls[c] = alph_size + 2;
+    if (c < 128) rep[cls[c]] = (char)c;
+  }
+  cls[0] = alph_size + 2;
+
+  tuple[mod->order+1] = '\0';
+  for (code = 0; code < size; code++) {
+    for (k = mod->order, rem = code; k >= 0; k--, rem /= ncl)
+      tuple[k] = rep[rem % ncl];
+    /* a class with no characters can't occur */
+    table[code] = ((int)strlen(tuple) < mod->order+1 ? 0 :
+                   tl_wm_tuple_score(mod, msa, margfreqs, tuple, alph_size));
+  }
+  return table;
+}
+
+double tl_compute_log_likelihood_weight_matrix(TreeModel *mod, MSA *msa,
+                                               double *col_scores,
+                                               double *tuple_scores,
+                                               int cat) {
+  int i, seq, idx, code, alph_size = (int)strlen(msa->alphabet);
+  int ncl = WM_NCLASSES(alph_size), cls[NCHARS];
+  double retval = 0, *table, *tuple_vals = NULL;
+  Arena *ar;
+  ArenaMark mark;
+  Vector *margfreqs;
   int col_by_col = (col_scores != NULL || msa->ss == NULL);
                                 /* evaluate the alignment
                                    column-by-column if either
@@ -496,7 +1761,6 @@ void tl_compute_log_likelihood_weight_matrix(TreeModel *mod, MSA *msa,
                                 /* NOTE: !col_by_col -> msa->ss != NULL */
 
   checkInterrupt();
-  tuple[mod->order+1] = '\0';
 
   if (mod->tree != NULL)
     die("ERROR tl_compute_log_likelihood_weight_matrix: mod->tree should be NULL\n");
@@ -524,87 +1788,70 @@ void tl_compute_log_likelihood_weight_matrix(TreeModel *mod, MSA *msa,
   /* if using col-by-col scoring, must
      have ordered representation */
 
-  retval = 0;
+  if (msa->ss != NULL && msa->ss->tuple_size <= mod->order)
+    die("ERROR tl_compute_log_likelihood_weight_matrix: tuple_size (%i) must be greater than mod->order (%i)\n",
+        msa->ss->tuple_size, mod->order);
+
+  ar = ar_scratch_begin(&mark);
+  margfreqs = get_marginal_eq_freqs(mod->rate_matrix->states, mod->order+1,
+                                    mod->backgd_freqs);
+  table = tl_wm_table(mod, msa, margfreqs, alph_size, cls, ar);
+  vec_free(margfreqs);
+
+  /* with sufficient statistics, score each distinct tuple once */
+  if (msa->ss != NULL) {
+    tuple_vals = (tuple_scores != NULL ? tuple_scores :
+                  ar_alloc(ar, msa->ss->ntuples * sizeof(double)));
+    for (idx = 0; idx < msa->ss->ntuples; idx++) {
+      double val = 0;
+      if (!col_by_col && cat >= 0 && msa->ss->cat_counts[cat][idx] == 0) {
+        tuple_vals[idx] = 0;
+        continue;
+      }
+      for (seq = 0; seq < msa->nseqs; seq++) {
+        for (i = -mod->order, code = 0; i <= 0; i++)
+          code = code * ncl +
+            cls[(unsigned char)ss_get_char_tuple(msa, idx, seq, i)];
+        if (table[code] == NEGINFTY) { val = NEGINFTY; break; }
+        val += table[code];
+      }
+      tuple_vals[idx] = val;
+    }
+  }
+
   for (idx = 0;
        idx < (col_by_col ? msa->length : msa->ss->ntuples);
        idx++) {
-    int thisstate, col, tupleidx;
-    double col_val = 0, prob = 0;
+    double col_val = 0;
 
     /* NOTE: when evaluating col-by-col, idx is a column, but otherwise
-       idx is a tuple index.  Let's be clear about this ... */
-    col = (col_by_col ? idx : -1);
-    if (msa->ss == NULL) tupleidx = -1;
-    else if (col_by_col) tupleidx = msa->ss->tuple_idx[col];
-    else tupleidx = idx;      /* NOTE: tupleidx will be defined
-                                 whenever msa->ss != NULL */
-
-    if (cat < 0 || (col_by_col && msa->categories[col] == cat) ||
-        (!col_by_col && msa->ss->cat_counts[cat][tupleidx] > 0)) {
-
+       idx is a tuple index */
+    if (!col_by_col)            /* tuple-by-tuple scoring */
+      col_val = tuple_vals[idx] *
+        (cat >= 0 ? msa->ss->cat_counts[cat][idx] : msa->ss->counts[idx]);
+    else if (cat >= 0 && msa->categories[idx] != cat)
+      col_val = 0;
+    else if (msa->ss != NULL)
+      col_val = (msa->ss->tuple_idx[idx] < 0 ? 0 :
+                 tuple_vals[msa->ss->tuple_idx[idx]]);
+    else {
       for (seq = 0; seq < msa->nseqs; seq++) {
-
-        for (i = -mod->order; i <= 0; i++) {
-          if (msa->ss != NULL)
-            tuple[mod->order+i] = ss_get_char_tuple(msa, tupleidx, seq, i);
-          else if (col + i >= 0)
-            tuple[mod->order+i] = msa->seqs[seq][col+i];
-          else
-            tuple[mod->order+i] = msa->missing[0];
-        }
-
-        if (!mod->allow_gaps &&
-            msa->inv_alphabet[(int)tuple[mod->order]] < 0 &&
-            !msa->is_missing[(int)tuple[mod->order]]) {
-
-          col_val = NEGINFTY; /* we want to apply the strict penalty
-                                 iff there is an unrecognized
-                                 character in *this* (the rightmost)
-                                 col; missing data is a special case -- don't
-                                 penalize even if not in alphabet */
-
-                                /* FIXME: seems too complicated --
-                                   just check for gap? */
-          break;
-        }
-        else if (mod->allow_but_penalize_gaps &&
-                 msa->inv_alphabet[(int)tuple[mod->order]] < 0) {
-          /* temporary */
-          double tmp_prob;
-          prob = 1;
-          for (i = 0; i < alph_size; i++) {
-            tuple[mod->order] = msa->alphabet[i];
-            tmp_prob = vec_get(margfreqs, tuple_index_missing_data(tuple, msa->inv_alphabet, msa->is_missing, alph_size));
-            if (tmp_prob < prob) prob = tmp_prob;
-          }
-          if (prob == 0) prob = 0.01;
-        }
-        else {
-          thisstate = tuple_index_missing_data(tuple, msa->inv_alphabet,
-                                               msa->is_missing, alph_size);
-          prob = vec_get(margfreqs, thisstate);
-        }
-
-        if (prob == 0) { col_val = NEGINFTY; break; }
-
-        col_val += log2(prob);
-
-        if (mod->use_conditionals && mod->order > 0) {
-          tuple[mod->order] = msa->missing[0];
-          col_val -= log2(vec_get(margfreqs, tuple_index_missing_data(tuple, msa->inv_alphabet, msa->is_missing, alph_size)));
-        }
+        for (i = -mod->order, code = 0; i <= 0; i++)
+          code = code * ncl +
+            cls[(unsigned char)(idx + i >= 0 ? msa->seqs[seq][idx+i] :
+                                msa->missing[0])];
+        if (table[code] == NEGINFTY) { col_val = NEGINFTY; break; }
+        col_val += table[code];
       }
     }
-    if (!col_by_col)   /* tuple-by-tuple scoring */
-      col_val *= (cat >= 0 ? msa->ss->cat_counts[cat][tupleidx] :
-                  msa->ss->counts[tupleidx]);
     retval += col_val;
-    if (col_scores != NULL) col_scores[col] = col_val;
+    if (col_scores != NULL) col_scores[idx] = col_val;
   }
   if (retval < NEGINFTY) retval = NEGINFTY;
   /* must be true if any of the columns
      considered had prob NEGINFTY */
-  vec_free(margfreqs);
+  ar_scratch_end(ar, mark);
+  return retval;
 }
 
 
@@ -612,8 +1859,10 @@ TreePosteriors *tl_new_tree_posteriors(TreeModel *mod, MSA *msa, int do_bases,
                                        int do_substs, int do_expected_nsubst,
                                        int do_expected_nsubst_tot,
 				       int do_expected_nsubst_col,
-                                       int do_rate_cats, int do_rate_cats_exp) {
-  int i, j, k, r, ntuples, nnodes, nstates;
+                                       int do_rate_cats, int do_rate_cats_exp,
+                                       int float_bases) {
+  int i, j, r, ntuples, nnodes, nstates;
+  size_t nblocks;
   TreePosteriors *tp = (TreePosteriors*)smalloc(sizeof(TreePosteriors));
 
   if (mod->tree ==  NULL)
@@ -625,53 +1874,29 @@ TreePosteriors *tl_new_tree_posteriors(TreeModel *mod, MSA *msa, int do_bases,
   nnodes = mod->tree->nnodes;
   nstates = mod->rate_matrix->size;
 
-  if (do_bases) {
-    tp->base_probs = (double****)smalloc(mod->nratecats * sizeof(double***));
-    for (r = 0; r < mod->nratecats; r++) {
-      tp->base_probs[r] = (double***)smalloc(nstates * sizeof(double**));
-      for (i = 0; i < nstates; i++) {
-        tp->base_probs[r][i] = (double**)smalloc(nnodes * sizeof(double*));
-        for (j = 0; j < nnodes; j++) {
-          tp->base_probs[r][i][j] = (double*)smalloc(ntuples * sizeof(double));
-        }
-      }
-    }
-  }
-  else tp->base_probs = NULL;
+  tp->nratecats = mod->nratecats;
+  tp->nstates = nstates;
+  tp->nnodes = nnodes;
+  tp->ntuples = ntuples;
 
-  if (do_substs) {
-    tp->subst_probs = (double*****)smalloc(mod->nratecats * sizeof(double****));
-    for (r = 0; r < mod->nratecats; r++) {
-      checkInterrupt();
-      tp->subst_probs[r] = (double****)smalloc(nstates * sizeof(double***));
-      for (i = 0; i < nstates; i++) {
-        tp->subst_probs[r][i] = (double***)smalloc(nstates * sizeof(double**));
-        for (j = 0; j < nstates; j++) {
-          tp->subst_probs[r][i][j] = (double**)smalloc(nnodes * sizeof(double*));
-          for (k = 0; k < nnodes; k++)
-            if (k != mod->tree->id) /* don't need one for the root */
-              tp->subst_probs[r][i][j][k] = (double*)smalloc(ntuples *
-                                                            sizeof(double));
-            else
-              tp->subst_probs[r][i][j][k] = NULL;
-        }
-      }
-    }
-  }
+  /* per-tuple arrays are allocated as single blocks (see
+     TP_BLOCK); blocks for the root are allocated but not used */
+  nblocks = (size_t)nnodes * mod->nratecats * ntuples;
+
+  tp->base_probs = NULL;
+  tp->base_probs_f = NULL;
+  if (do_bases && float_bases)
+    tp->base_probs_f = (float*)smalloc(nblocks * nstates * sizeof(float));
+  else if (do_bases)
+    tp->base_probs = (double*)smalloc(nblocks * nstates * sizeof(double));
+
+  if (do_substs)
+    tp->subst_probs = (double*)smalloc(nblocks * nstates * nstates *
+                                       sizeof(double));
   else tp->subst_probs = NULL;
 
-  if (do_expected_nsubst) {
-    tp->expected_nsubst = (double***)smalloc(mod->nratecats * sizeof(double**));
-    for (r = 0; r < mod->nratecats; r++) {
-      tp->expected_nsubst[r] = (double**)smalloc(nnodes * sizeof(double*));
-      for (i = 0; i < nnodes; i++) {
-        if (i != mod->tree->id)
-          tp->expected_nsubst[r][i] = (double*)smalloc(ntuples * sizeof(double));
-        else
-          tp->expected_nsubst[r][i] = NULL;
-      }
-    }
-  }
+  if (do_expected_nsubst)
+    tp->expected_nsubst = (double*)smalloc(nblocks * sizeof(double));
   else tp->expected_nsubst = NULL;
 
   if (do_expected_nsubst_tot) {
@@ -689,20 +1914,9 @@ TreePosteriors *tl_new_tree_posteriors(TreeModel *mod, MSA *msa, int do_bases,
   }
   else tp->expected_nsubst_tot = NULL;
 
-  if (do_expected_nsubst_col) {
-    tp->expected_nsubst_col = (double*****)smalloc(mod->nratecats * sizeof(double****));
-    for (r=0; r < mod->nratecats; r++) {
-      tp->expected_nsubst_col[r] = (double****)smalloc(nnodes * sizeof(double***));
-      for (i=0; i < nnodes; i++) {
-	tp->expected_nsubst_col[r][i] = (double***)smalloc(ntuples * sizeof(double**));
-	for (j=0; j < ntuples; j++) {
-	  tp->expected_nsubst_col[r][i][j] = (double**)smalloc(nstates * sizeof(double*));
-	  for (k=0; k < nstates; k++)
-	    tp->expected_nsubst_col[r][i][j][k] = (double*)smalloc(nstates * sizeof(double));
-	}
-      }
-    }
-  }
+  if (do_expected_nsubst_col)
+    tp->expected_nsubst_col = (double*)smalloc(nblocks * nstates * nstates *
+                                               sizeof(double));
   else tp->expected_nsubst_col = NULL;
 
   if (do_rate_cats) {
@@ -720,52 +1934,18 @@ TreePosteriors *tl_new_tree_posteriors(TreeModel *mod, MSA *msa, int do_bases,
 }
 
 void tl_free_tree_posteriors(TreeModel *mod, MSA *msa, TreePosteriors *tp) {
-  int i, j, k, r, ntuples, nnodes, nstates;
+  int i, j, r, nstates;
 
   if (mod->tree == NULL)
     die("ERROR tl_free_tree_posteriors: mod->tree is NULL\n");
   if (msa->ss == NULL)
     die("ERROR tl_free_tree_posteriors: msa->ss is NULL\n");
-  ntuples = msa->ss->ntuples;
-  nnodes = mod->tree->nnodes;
   nstates = mod->rate_matrix->size;
 
-  if (tp->base_probs != NULL) {
-    for (r = 0; r < mod->nratecats; r++) {
-      for (i = 0; i < nstates; i++) {
-        for (j = 0; j < nnodes; j++)
-          if (tp->base_probs[r][i][j] != NULL)
-            sfree(tp->base_probs[r][i][j]);
-        sfree(tp->base_probs[r][i]);
-      }
-      sfree(tp->base_probs[r]);
-    }
-    sfree(tp->base_probs);
-  }
-  if (tp->subst_probs != NULL) {
-    for (r = 0; r < mod->nratecats; r++) {
-      for (i = 0; i < nstates; i++) {
-        for (j = 0; j < nstates; j++) {
-          for (k = 0; k < nnodes; k++)
-            if (k != mod->tree->id)
-              sfree(tp->subst_probs[r][i][j][k]);
-          sfree(tp->subst_probs[r][i][j]);
-        }
-        sfree(tp->subst_probs[r][i]);
-      }
-      sfree(tp->subst_probs[r]);
-    }
-    sfree(tp->subst_probs);
-  }
-  if (tp->expected_nsubst != NULL) {
-    for (r = 0; r < mod->nratecats; r++) {
-      for (i = 0; i < nnodes; i++)
-        if (i != mod->tree->id)
-          sfree(tp->expected_nsubst[r][i]);
-      sfree(tp->expected_nsubst[r]);
-    }
-    sfree(tp->expected_nsubst);
-  }
+  if (tp->base_probs != NULL) sfree(tp->base_probs);
+  if (tp->base_probs_f != NULL) sfree(tp->base_probs_f);
+  if (tp->subst_probs != NULL) sfree(tp->subst_probs);
+  if (tp->expected_nsubst != NULL) sfree(tp->expected_nsubst);
   if (tp->expected_nsubst_tot != NULL) {
     for (r = 0; r < mod->nratecats; r++) {
       for (i = 0; i < nstates; i++) {
@@ -777,20 +1957,7 @@ void tl_free_tree_posteriors(TreeModel *mod, MSA *msa, TreePosteriors *tp) {
     }
     sfree(tp->expected_nsubst_tot);
   }
-  if (tp->expected_nsubst_col != NULL) {
-    for (r = 0; r < mod->nratecats; r++) {
-      for (i=0; i < nnodes; i++) {
-	for (j=0; j < ntuples; j++) {
-	  for (k=0; k < nstates; k++)
-	    sfree(tp->expected_nsubst_col[r][i][j][k]);
-	  sfree(tp->expected_nsubst_col[r][i][j]);
-	}
-	sfree(tp->expected_nsubst_col[r][i]);
-      }
-      sfree(tp->expected_nsubst_col[r]);
-    }
-    sfree(tp->expected_nsubst_col);
-  }
+  if (tp->expected_nsubst_col != NULL) sfree(tp->expected_nsubst_col);
   if (tp->rcat_probs != NULL) {
     for (i = 0; i < mod->nratecats; i++)
       sfree(tp->rcat_probs[i]);
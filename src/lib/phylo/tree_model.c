@@ -26,6 +26,7 @@
 #include <dgamma.h>
 #include <math.h>
 #include <misc.h>
+#include <profile.h>
 
 #define ALPHABET_TAG "ALPHABET:"
 #define BACKGROUND_TAG "BACKGROUND:"
@@ -164,6 +165,7 @@ TreeModel *tm_new(TreeNode *tree, MarkovMatrix *rate_matrix,
   tm->bound_arg = NULL;
   tm->scale_during_opt = 0;
   tm->iupac_inv_map = NULL;
+  tm->lik_cache = NULL;
   return tm;
 }
 
@@ -303,6 +305,8 @@ void tm_free(TreeModel *tm) {
     str_free(tm->noopt_arg);
   if (tm->iupac_inv_map != NULL)
     free_iupac_inv_map(tm->iupac_inv_map);
+  if (tm->lik_cache != NULL)
+    tl_free_cache(tm->lik_cache);
   sfree(tm);
 }
 
@@ -636,7 +640,7 @@ void tm_print(FILE *F, TreeModel *tm) {
 }
 
 /* Note: does not copy msa_seq_idx, tree_posteriors, P, rate_matrix_param_row,
-   or iupac_inv_map
+   iupac_inv_map, or lik_cache
  */
 TreeModel *tm_create_copy(TreeModel *src) {
   TreeModel *retval;
@@ -997,6 +1001,7 @@ void tm_set_subst_matrices(TreeModel *tm) {
   subst_mod_type subst_mod = tm->subst_mod;
   MarkovMatrix *rate_matrix = tm->rate_matrix;
   TreeNode *n;
+  PROF_BEGIN(PROF_PMATRIX);
 
   scaling_const = -1;
 
@@ -1080,6 +1085,7 @@ void tm_set_subst_matrices(TreeModel *tm) {
       }
     }
   }
+  PROF_END(PROF_PMATRIX, tm->tree->nnodes * tm->nratecats);
 }
 
 /* version of above that can be used with specified branch length and
@@ -1943,7 +1949,7 @@ int tm_fit(TreeModel *mod, MSA *msa, Vector *params, int cat,
 	   FILE *error_file) {
   double ll;
   Vector *lower_bounds, *upper_bounds, *opt_params;
-  int i, retval = 0, npar, numeval;
+  int i, retval = 0, npar, numeval, own_cache;
 
   if (msa->ss == NULL) {
     if (msa->seqs == NULL)
@@ -2006,6 +2012,12 @@ int tm_fit(TreeModel *mod, MSA *msa, Vector *params, int cat,
   }
   
   if (!quiet) fprintf(stderr, "numpar = %i\n", opt_params->size);
+
+  /* successive evaluations often change only a few branches (e.g.,
+     when computing gradients numerically), so keep per-tuple partial
+     likelihoods between them */
+  own_cache = tl_attach_cache(mod, msa);
+
   retval = opt_bfgs(tm_likelihood_wrapper, opt_params, (void*)mod, &ll, 
                     lower_bounds, upper_bounds, logf, NULL, precision, 
 		    NULL, &numeval);
@@ -2048,6 +2060,7 @@ int tm_fit(TreeModel *mod, MSA *msa, Vector *params, int cat,
     }
   }
   
+  if (own_cache) tl_detach_cache(mod);
   if (lower_bounds != NULL) vec_free(lower_bounds);
   if (upper_bounds != NULL) vec_free(upper_bounds);
 
@@ -2658,7 +2671,7 @@ void tm_unpack_params(TreeModel *mod, Vector *params_in, int idx_offset) {
   MarkovMatrix *temp_mm;
   Vector *temp_backgd;
   double  sum;
-  static Matrix *oldMatrix=NULL;
+  static PHAST_THREAD_LOCAL Matrix *oldMatrix=NULL;
 
   if (oldMatrix != NULL && oldMatrix->nrows != mod->rate_matrix->size) {
     mat_free(oldMatrix);
@@ -16,7 +16,7 @@
 #include "stringsplus.h"
 
 
-static int idcounter = 0;
+static PHAST_THREAD_LOCAL int idcounter = 0;
 /* NOTE: when tree is parsed from Newick file, node ids are assigned
    sequentially in a preorder traversal.  Some useful properties
    result.  For example, if two nodes u and v are such that v->id >
@@ -15,6 +15,8 @@
 #include <tree_likelihoods.h>
 #include <subst_mods.h>
 #include <em.h>
+#include <profile.h>
+#include <arena.h>
 
 /* initial values for alpha, beta, tau; possibly should be passed in instead */
 #define ALPHA_INIT 0.05
@@ -97,6 +99,8 @@ PhyloHmm *phmm_new(HMM *hmm,    /* HMM.  If indel_mode ==
   phmm->autocorr_hmm = NULL;
   phmm->reflected = pivot_cats != NULL;
   phmm->emissions = NULL;
+  phmm->emissions_float = NULL;
+  phmm->single_prec = FALSE;
   phmm->forward = NULL;
   phmm->alloc_len = -1;
   phmm->state_pos = phmm->state_neg = NULL;
@@ -477,6 +481,15 @@ void phmm_free(PhyloHmm *phmm) {
         sfree(phmm->emissions[i]);
     sfree(phmm->emissions); sfree(phmm->state_pos); sfree(phmm->state_neg);
   }
+  else if (phmm->emissions_float != NULL) {
+    for (i = 0; i < phmm->hmm->nstates; i++) 
+      if (phmm->state_pos[phmm->state_to_mod[i]] == i ||
+          phmm->state_neg[phmm->state_to_mod[i]] == i || 
+          phmm->state_to_pattern[i] >= 0)
+        sfree(phmm->emissions_float[i]);
+    sfree(phmm->emissions_float); 
+    sfree(phmm->state_pos); sfree(phmm->state_neg);
+  }
 
   if (phmm->forward != NULL) {
     for (i = 0; i < phmm->hmm->nstates; i++) sfree(phmm->forward[i]);
@@ -508,6 +521,8 @@ void phmm_free(PhyloHmm *phmm) {
   if (phmm->em_data != NULL) {
     if (phmm->em_data->H != NULL) 
       mat_free(phmm->em_data->H);
+    if (phmm->em_data->tree_params != NULL) 
+      vec_free(phmm->em_data->tree_params);
     sfree(phmm->em_data);
   }
   hmm_free(phmm->hmm);
@@ -526,23 +541,32 @@ void phmm_compute_emissions(PhyloHmm *phmm,
                                    reported to stderr */
                             ) {
 
-  int i, mod, j;
+  int i, mod;
+  phast_pos j;
   MSA *msa_compl = NULL;
-  int new_alloc = (phmm->emissions == NULL); 
+  int single = phmm->single_prec;
+  int new_alloc = (single ? phmm->emissions_float == NULL :
+                   phmm->emissions == NULL); 
   /* allocate new memory if emissions is NULL; otherwise reuse */ 
+  double *row = NULL;           /* scratch row in single-precision mode */
+  PROF_BEGIN(PROF_EMISSIONS);
 
   if (new_alloc) {
-    phmm->emissions = smalloc(phmm->hmm->nstates * sizeof(double*));  
+    if (single)
+      phmm->emissions_float = smalloc(phmm->hmm->nstates * sizeof(float*));
+    else
+      phmm->emissions = smalloc(phmm->hmm->nstates * sizeof(double*));  
     phmm->alloc_len = msa->length;
   }
+  if (single) row = smalloc(msa->length * sizeof(double));
   if (phmm->alloc_len < msa->length)
-    die("ERROR phmm_compute_emissions: phmm->alloc_len (%i) < msa->length (%i)\n",
+    die("ERROR phmm_compute_emissions: phmm->alloc_len (%" PHAST_POS_FMT ") < msa->length (%" PHAST_POS_FMT ")\n",
 	phmm->alloc_len, msa->length);
 
   /* if HMM is reflected, we need the reverse complement of the
      alignment as well */
   if (phmm->reflected) {          
-    int idx1, idx2;
+    phast_pos idx1, idx2;
     msa_compl = msa_create_copy(msa, 0);
     msa_reverse_compl(msa_compl);
 
@@ -586,10 +610,26 @@ void phmm_compute_emissions(PhyloHmm *phmm,
             
     /* reuse already computed values if possible */
     mod = phmm->state_to_mod[i];
-    if (!phmm->reverse_compl[i] && phmm->state_pos[mod] != -1)
+    if (single && !phmm->reverse_compl[i] && phmm->state_pos[mod] != -1)
+      phmm->emissions_float[i] = phmm->emissions_float[phmm->state_pos[mod]];
+    else if (single && phmm->reverse_compl[i] && phmm->state_neg[mod] != -1)
+      phmm->emissions_float[i] = phmm->emissions_float[phmm->state_neg[mod]];
+    else if (!phmm->reverse_compl[i] && phmm->state_pos[mod] != -1)
       phmm->emissions[i] = phmm->emissions[phmm->state_pos[mod]]; /* saves memory */
     else if (phmm->reverse_compl[i] && phmm->state_neg[mod] != -1)
       phmm->emissions[i] = phmm->emissions[phmm->state_neg[mod]];
+    else if (single) {
+      if (new_alloc)
+	phmm->emissions_float[i] = smalloc(msa->length * sizeof(float));
+
+      tl_compute_log_likelihood(phmm->mods[mod], 
+                                phmm->reverse_compl[i] ? msa_compl : msa,
+                                row, NULL, -1, NULL);
+      for (j = 0; j < msa->length; j++) 
+        phmm->emissions_float[i][j] = (float)row[j];
+      if (!phmm->reverse_compl[i]) phmm->state_pos[mod] = i;
+      else phmm->state_neg[mod] = i;            
+    }
     else {
       if (new_alloc)
 	phmm->emissions[i] = smalloc(msa->length * sizeof(double));
@@ -602,6 +642,7 @@ void phmm_compute_emissions(PhyloHmm *phmm,
     }
   }
   if (msa_compl != NULL) msa_free(msa_compl);
+  if (row != NULL) sfree(row);
 
   /* finally, adjust for indel model, if necessary */
   if (phmm->indel_mode != MISSING_DATA) {
@@ -615,7 +656,21 @@ void phmm_compute_emissions(PhyloHmm *phmm,
                                 /* by going backwards, we ensure that
                                    the "base" state (with gap pattern
                                    == 0) is visited last */
-      if (phmm->state_to_pattern[i] >= 0) {
+      if (phmm->state_to_pattern[i] >= 0 && single) {
+        float *orig_emissions = phmm->emissions_float[i];
+
+        if (phmm->state_to_pattern[i] > 0)
+          phmm->emissions_float[i] = smalloc(msa->length * sizeof(float));
+
+        gp_tuple_matches_pattern(phmm->gpm, msa, phmm->state_to_pattern[i],
+                                 matches);
+
+        for (j = 0; j < msa->length; j++) 
+          phmm->emissions_float[i][j] = 
+            (matches[msa->ss->tuple_idx[j]] ? orig_emissions[j] : 
+             (float)NEGINFTY);
+      }
+      else if (phmm->state_to_pattern[i] >= 0) {
         double *orig_emissions = phmm->emissions[i];
 
         if (phmm->state_to_pattern[i] > 0)
@@ -633,6 +688,38 @@ void phmm_compute_emissions(PhyloHmm *phmm,
     }
     sfree(matches);
   }
+  PROF_END(PROF_EMISSIONS, (double)phmm->hmm->nstates * msa->length);
+}
+
+/** Store emissions in single precision; convert any that have
+    already been computed */
+void phmm_set_single_prec(PhyloHmm *phmm) {
+  int i, k, nstates = phmm->hmm->nstates;
+  phast_pos j;
+  int first[nstates];
+
+  if (phmm->single_prec) return;
+  phmm->single_prec = TRUE;
+  if (phmm->emissions == NULL) return;
+
+  /* convert each distinct row once, preserving the sharing of rows
+     by states (see phmm_compute_emissions) */
+  phmm->emissions_float = smalloc(nstates * sizeof(float*));
+  for (i = 0; i < nstates; i++) {
+    for (k = 0; k < i && phmm->emissions[k] != phmm->emissions[i]; k++);
+    first[i] = (k == i);
+    if (!first[i]) {
+      phmm->emissions_float[i] = phmm->emissions_float[k];
+      continue;
+    }
+    phmm->emissions_float[i] = smalloc(phmm->alloc_len * sizeof(float));
+    for (j = 0; j < phmm->alloc_len; j++)
+      phmm->emissions_float[i][j] = (float)phmm->emissions[i][j];
+  }
+  for (i = 0; i < nstates; i++)
+    if (first[i]) sfree(phmm->emissions[i]);
+  sfree(phmm->emissions);
+  phmm->emissions = NULL;
 }
 
 /** Run the Viterbi algorithm and return a set of predictions.
@@ -657,10 +744,17 @@ GFF_Set* phmm_predict_viterbi(PhyloHmm *phmm,
   int *path = (int*)smalloc(phmm->alloc_len * sizeof(int));
   GFF_Set *retval;
 
-  if (phmm->emissions == NULL)
-    die("ERROR: emissions required for phmm_viterbi_features.\n");
-          
-  hmm_viterbi(phmm->hmm, phmm->emissions, phmm->alloc_len, path);
+  if (phmm->single_prec) {
+    if (phmm->emissions_float == NULL)
+      die("ERROR: emissions required for phmm_viterbi_features.\n");
+    hmm_viterbi_float(phmm->hmm, phmm->emissions_float, phmm->alloc_len, 
+                      path);
+  }
+  else {
+    if (phmm->emissions == NULL)
+      die("ERROR: emissions required for phmm_viterbi_features.\n");
+    hmm_viterbi(phmm->hmm, phmm->emissions, phmm->alloc_len, path);
+  }
 
   retval = cm_labeling_as_gff(phmm->cm, path, phmm->alloc_len, 
                               phmm->state_to_cat, 
@@ -739,10 +833,18 @@ GFF_Set* phmm_predict_viterbi_cats(PhyloHmm *phmm,
     Emissions must have already been computed (see
     phmm_compute_emissions) */
 double phmm_lnl(PhyloHmm *phmm) {
-  double **forward = smalloc(phmm->hmm->nstates * sizeof(double*));
+  double **forward;
   int i;
   double logl;
 
+  if (phmm->single_prec) {
+    if (phmm->emissions_float == NULL)
+      die("ERROR: emissions required for phmm_lnl.\n");
+    return hmm_forward_float(phmm->hmm, phmm->emissions_float, 
+                             phmm->alloc_len) * log(2);
+  }
+
+  forward = smalloc(phmm->hmm->nstates * sizeof(double*));
   if (phmm->emissions == NULL)
     die("ERROR: emissions required for phmm_lnl.\n");
           
@@ -759,6 +861,8 @@ double phmm_lnl(PhyloHmm *phmm) {
     have already been computed (see phmm_compute_emissions).  Returns 
     log likelihood.  */
 double phmm_postprobs(PhyloHmm *phmm, double **post_probs) {
+  if (phmm->single_prec)
+    die("ERROR: phmm_postprobs requires double-precision emissions (use phmm_postprobs_float).\n");
   if (phmm->emissions == NULL)
     die("ERROR: emissions required for phmm_posterior_probs.\n");
 
@@ -778,6 +882,25 @@ double **phmm_new_postprobs(PhyloHmm *phmm) {
 }
 
 
+/** Computes single-precision posterior probabilities for a PhyloHmm
+    with single-precision emissions.  Returns log likelihood.  */
+double phmm_postprobs_float(PhyloHmm *phmm, float **post_probs) {
+  if (!phmm->single_prec || phmm->emissions_float == NULL)
+    die("ERROR: single-precision emissions required for phmm_postprobs_float.\n");
+
+  return hmm_posterior_probs_float(phmm->hmm, phmm->emissions_float, 
+                                   phmm->alloc_len, post_probs) * log(2);
+}
+
+float **phmm_new_postprobs_float(PhyloHmm *phmm) {
+  float **rv = smalloc(phmm->hmm->nstates * sizeof(float*));
+  int i;
+  for (i=0; i < phmm->hmm->nstates; i++)
+    rv[i] = smalloc(phmm->alloc_len * sizeof(float));
+  phmm_postprobs_float(phmm, rv);
+  return rv;
+}
+
 /** Computes and returns an array of length phmm->alloc_len
     representing the marginal posterior prob at every site, summed
     over states corresponding to categories in the specified list.
@@ -793,8 +916,10 @@ double* phmm_postprobs_cats(PhyloHmm *phmm,
                                 /* if non-NULL, will point to log
                                    likelihood on return */
                               ) {
-  int i, j, state;
-  double **pp = smalloc(phmm->hmm->nstates * sizeof(double*));
+  int i, state;
+  phast_pos j;
+  double **pp = NULL;
+  float **ppf = NULL;           /* used instead in single-precision mode */
   double *retval = smalloc(phmm->alloc_len * sizeof(double));
   double l;
   List *states = lst_new_int(phmm->hmm->nstates), *catnos;
@@ -810,19 +935,43 @@ double* phmm_postprobs_cats(PhyloHmm *phmm,
                                                
   /* only allocate memory for states of interest; NULLs for the others
      will cause hmm_postprobs to ignore them */
-  for (i = 0; i < phmm->hmm->nstates; i++) pp[i] = NULL;
-  for (i = 0; i < lst_size(states); i++) {
-    state = lst_get_int(states, i);
-    if (pp[state] == NULL)
-      pp[state] = smalloc(phmm->alloc_len * sizeof(double));
+  if (phmm->single_prec) {
+    ppf = smalloc(phmm->hmm->nstates * sizeof(float*));
+    for (i = 0; i < phmm->hmm->nstates; i++) ppf[i] = NULL;
+    for (i = 0; i < lst_size(states); i++) {
+      state = lst_get_int(states, i);
+      if (ppf[state] == NULL)
+        ppf[state] = smalloc(phmm->alloc_len * sizeof(float));
+    }
+
+    l = phmm_postprobs_float(phmm, ppf);
+
+    for (j = 0; j < phmm->alloc_len; j++) retval[j] = 0;
+    for (i = 0; i < lst_size(states); i++) {
+      state = lst_get_int(states, i);
+      for (j = 0; j < phmm->alloc_len; j++) retval[j] += ppf[state][j];
+    }
+    for (i = 0; i < phmm->hmm->nstates; i++) sfree(ppf[i]);
+    sfree(ppf);
   }
+  else {
+    pp = smalloc(phmm->hmm->nstates * sizeof(double*));
+    for (i = 0; i < phmm->hmm->nstates; i++) pp[i] = NULL;
+    for (i = 0; i < lst_size(states); i++) {
+      state = lst_get_int(states, i);
+      if (pp[state] == NULL)
+        pp[state] = smalloc(phmm->alloc_len * sizeof(double));
+    }
 
-  l = phmm_postprobs(phmm, pp);
+    l = phmm_postprobs(phmm, pp);
 
-  for (j = 0; j < phmm->alloc_len; j++) retval[j] = 0;
-  for (i = 0; i < lst_size(states); i++) {
-    state = lst_get_int(states, i);
-    for (j = 0; j < phmm->alloc_len; j++) retval[j] += pp[state][j];
+    for (j = 0; j < phmm->alloc_len; j++) retval[j] = 0;
+    for (i = 0; i < lst_size(states); i++) {
+      state = lst_get_int(states, i);
+      for (j = 0; j < phmm->alloc_len; j++) retval[j] += pp[state][j];
+    }
+    for (i = 0; i < phmm->hmm->nstates; i++) sfree(pp[i]);
+    sfree(pp);
   }
       
   if (lnl != NULL) *lnl = l;
@@ -845,6 +994,9 @@ double phmm_fit_lambda(PhyloHmm *phmm, double *lambda, FILE *logf) {
   double neglnl, ax, bx, cx, fa, fb, fc;
   int i;
 
+  if (phmm->single_prec)
+    die("ERROR phmm_fit_lambda: not supported with single-precision emissions.\n");
+
   /* allocate memory for forward alg */
   if (phmm->forward == NULL) {  /* otherwise assume already alloc */
     phmm->forward = smalloc(phmm->hmm->nstates * sizeof(double*));
@@ -863,6 +1015,28 @@ double phmm_fit_lambda(PhyloHmm *phmm, double *lambda, FILE *logf) {
   return -neglnl;
 }
 
+/* Version of hmm_log_odds_subset for single-precision emissions;
+   the columns in question are copied to a temporary double-precision
+   array */
+static double phmm_log_odds_subset_float(PhyloHmm *phmm, List *test_states,
+                                         List *null_states, int begidx,
+                                         int len) {
+  int i, j;
+  double retval, **emissions;
+  ArenaMark mark;
+  Arena *ar = ar_scratch_begin(&mark);
+
+  emissions = ar_alloc_dbl_matrix(ar, phmm->hmm->nstates, len);
+  for (i = 0; i < phmm->hmm->nstates; i++)
+    for (j = 0; j < len; j++)
+      emissions[i][j] = phmm->emissions_float[i][begidx + j];
+
+  retval = hmm_log_odds_subset(phmm->hmm, emissions, test_states, 
+                               null_states, 0, len);
+  ar_scratch_end(ar, mark);
+  return retval;
+}
+
 /** Score a set of predicted features using log odds scoring. */
 void phmm_score_predictions(PhyloHmm *phmm, 
                                 /* PhyloHmm object */
@@ -978,9 +1152,14 @@ void phmm_score_predictions(PhyloHmm *phmm,
       }
 
       /* score from start to end */
-      feat->score = 
-        hmm_log_odds_subset(phmm->hmm, phmm->emissions, score_states, 
-                            null_states, start - 1, end - start + 1);
+      if (phmm->single_prec)
+        feat->score = 
+          phmm_log_odds_subset_float(phmm, score_states, null_states, 
+                                     start - 1, end - start + 1);
+      else
+        feat->score = 
+          hmm_log_odds_subset(phmm->hmm, phmm->emissions, score_states, 
+                              null_states, start - 1, end - start + 1);
 
       feat->score_is_null = 0;
     }
@@ -1065,7 +1244,7 @@ void phmm_log_em(FILE *logf, double logl, HMM *hmm, void *data,
 
 /* wrapper for phmm_cmopute_emissions for use in EM */
 void phmm_compute_emissions_em(double **emissions, void **models, int nmodels,
-                               void *data, int sample, int length) {
+                               void *data, int sample, phast_pos length) {
   PhyloHmm *phmm = (PhyloHmm*)data;
   phmm_compute_emissions(phmm, phmm->em_data->msa, TRUE);
 }
@@ -1115,7 +1294,7 @@ void phmm_estim_mods_em(TreeModel **models, int nmodels, void *data,
 }
 
 /* return observation index associated with given position, here a tuple index */
-int phmm_get_obs_idx_em(void *data, int sample, int position) {
+int phmm_get_obs_idx_em(void *data, int sample, phast_pos position) {
   MSA *msa = ((PhyloHmm*)data)->em_data->msa;
   if (sample == -1 || position == -1) 
     return msa->ss->ntuples;
@@ -1139,6 +1318,8 @@ double phmm_fit_em(PhyloHmm *phmm,
                    ) {
   double retval;
 
+  if (phmm->single_prec)
+    die("ERROR (phmm_fit_em): not supported with single-precision emissions.\n");
   if (msa == NULL && phmm->emissions == NULL)
     die("ERROR (phmm_fit_em): emissions must be precomputed if not estimating tree models.\n");
 
@@ -1147,6 +1328,7 @@ double phmm_fit_em(PhyloHmm *phmm,
   phmm->em_data->fix_functional = fix_functional;
   phmm->em_data->fix_indel = fix_indel;
   phmm->em_data->H = NULL;
+  phmm->em_data->tree_params = NULL;
 
   if (msa != NULL)              /* estimating tree models */
     retval = hmm_train_by_em(phmm->hmm, phmm->mods, phmm, 1, 
@@ -64,6 +64,10 @@ LIBPATH = -L${LIB}
 # profiling and -a for monitoring of basic blocks)
 #CFLAGS += -pg
 
+# uncomment this line to compile out the timers and counters behind the
+# --profile option of the main programs (see profile.h)
+#CFLAGS += -DPHAST_NO_PROFILE
+
 # this flag tells certain routines to dump internal, debugging output.
 # Don't uncomment unless you know what you're doing.
 #CFLAGS += -DDEBUG
@@ -163,3 +167,16 @@ endif
 endif
 endif
 
+# POSIX threads, used to run independent computations in parallel
+# (see thread_pool.h).  Comment out to build without threads.
+ifneq ($(TARGETOS), Windows)
+  CFLAGS += -DUSE_PTHREADS -pthread
+  LIBS += -lpthread
+endif
+
+# zlib, used to compress bigWig output (see bigwig.h).  Comment out to
+# build without it; bigWig files are then written uncompressed.
+ifneq ($(TARGETOS), Windows)
+  CFLAGS += -DUSE_ZLIB
+  LIBS += -lz
+endif
@@ -18,6 +18,7 @@
 #include <dgamma.h>
 #include <tree_likelihoods.h>
 #include <maf.h>
+#include <profile.h>
 #include "phast_cons.h"
 #include "phastCons.help"
 
@@ -56,6 +57,8 @@ int main(int argc, char *argv[]) {
     {"require-informative", 1, 0, 'M'},
     {"not-informative", 1, 0, 'F'},
     {"lnl", 1, 0, 'L'},
+    {"em-stats", 1, 0, 'Q'},
+    {"em-merge", 1, 0, 'K'},
     {"seqname", 1, 0, 'N'},
     {"idpref", 1, 0, 'P'},
     {"score", 0, 0, 's'},
@@ -63,6 +66,10 @@ int main(int argc, char *argv[]) {
     {"indels-only", 0, 0, 'J'},
     {"alias", 1, 0, 'A'},
     {"quiet", 0, 0, 'q'},
+    {"profile", 0, 0, 0},
+    {"single-precision", 0, 0, 0},
+    {"no-accel", 0, 0, 0},
+    {"bigwig", 1, 0, 0},
     {"help", 0, 0, 'h'},
     {0, 0, 0, 0}
   };
@@ -79,7 +86,7 @@ int main(int argc, char *argv[]) {
   msa_format_type msa_format = UNKNOWN_FORMAT;
 
   while ((c = (char)getopt_long(argc, argv, 
-			  "S:H:V:ni:k:l:C:G:zt:E:R:T:O:r:xL:sN:P:g:U:c:e:IY:D:JM:F:pA:Xqh", 
+			  "S:H:V:ni:k:l:C:G:zt:E:R:T:O:r:xL:Q:K:sN:P:g:U:c:e:IY:D:JM:F:pA:Xqh", 
                           long_opts, &opt_idx)) != -1) {
     switch (c) {
     case 'S':
@@ -228,6 +235,12 @@ int main(int argc, char *argv[]) {
     case 'L':
       p->lnl_f = phast_fopen(optarg, "w+");
       break;
+    case 'Q':
+      p->em_stats_f = phast_fopen(optarg, "w+");
+      break;
+    case 'K':
+      p->em_merge = get_arg_list(optarg);
+      break;
     case 'N':
       p->seqname = optarg;
       break;
@@ -246,6 +259,16 @@ int main(int argc, char *argv[]) {
     case 'q':
       p->results_f = NULL;
       break;
+    case 0:
+      if (strcmp(long_opts[opt_idx].name, "profile") == 0)
+        prof_enable();
+      else if (strcmp(long_opts[opt_idx].name, "single-precision") == 0)
+        p->single_prec = TRUE;
+      else if (strcmp(long_opts[opt_idx].name, "no-accel") == 0)
+        p->no_accel = TRUE;
+      else if (strcmp(long_opts[opt_idx].name, "bigwig") == 0)
+        p->bigwig_fname = optarg;
+      break;
     case 'h':
       printf("%s", HELP);
       exit(0);
@@ -254,7 +277,11 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  if ((!coding_potential && optind != argc - 2) ||
+  if (p->em_merge != NULL) {    /* no alignment; only tree models */
+    if (optind != argc - 1 || coding_potential)
+      die("ERROR: extra or missing arguments.  Try '%s -h'.\n", argv[0]);
+  }
+  else if ((!coding_potential && optind != argc - 2) ||
       (coding_potential && optind != argc - 2 && optind != argc - 1))
     die("ERROR: extra or missing arguments.  Try '%s -h'.\n", argv[0]);
 
@@ -274,7 +301,8 @@ int main(int argc, char *argv[]) {
   if (p->extrapolate_tree_fname != NULL)
     p->extrapolate_tree = tr_new_from_file(phast_fopen(p->extrapolate_tree_fname, "r"));
 
-  mods_fname = (optind == argc - 2 ? argv[argc - 1] : NULL);
+  mods_fname = (optind == argc - 2 || p->em_merge != NULL ? 
+                argv[argc - 1] : NULL);
   /* if there are two args, mods are the second one; otherwise will
      use default mods for coding potential (see below) */
   
@@ -329,6 +357,12 @@ int main(int argc, char *argv[]) {
     p->mod[i]->use_conditionals = 1;     
   }
 
+  if (p->em_merge != NULL) {
+    phastCons(p);
+    if (prof_enabled) prof_print(stderr);
+    return 0;
+  }
+
   /* read alignment */
   msa_fname = argv[optind];
   infile = phast_fopen(msa_fname, "r");
@@ -348,7 +382,8 @@ int main(int argc, char *argv[]) {
     p->msa = msa_new_from_file_define_format(infile, msa_format, NULL);
 
   /* use file name root for default seqname */
-  if (p->viterbi_f != NULL && (p->seqname == NULL || p->idpref == NULL)) {
+  if ((p->viterbi_f != NULL || p->post_probs) &&
+      (p->seqname == NULL || p->idpref == NULL)) {
     String *tmp = str_new_charstr(msa_fname);
     if (!str_equals_charstr(tmp, "-")) {
       str_remove_path(tmp);
@@ -361,6 +396,7 @@ int main(int argc, char *argv[]) {
 
   phastCons(p);
 
+  if (prof_enabled) prof_print(stderr);
   return 0;
 }
 
@@ -107,6 +107,24 @@ OPTIONS:\n\
               parameters from a Dirichlet distribution defined by the\n\
               pseudocounts (see -c).  In this case, random restarts\n\
               are performed, as specified by -n.\n\
+\n\
+    -T <n>    Use <n> threads (0 means one per processor; default 1).\n\
+              Restarts and candidate initializations are trained in\n\
+              parallel.  If there is only one, sequences are instead\n\
+              divided among threads in contiguous blocks in EM\n\
+              training; in this case results may differ slightly with\n\
+              the number of threads, owing to the order of\n\
+              floating-point summation, but do not otherwise depend\n\
+              on it.\n\
+\n\
+    -A <x>    Abandon the EM training of a restart (or candidate) if,\n\
+              after %d iterations, its log likelihood trails that of\n\
+              the best one completed so far by more than <x>, which\n\
+              must be positive.  Abandoned restarts are not reported.\n\
+              Saves time with many restarts, at some risk of missing a\n\
+              motif that converges slowly.  With -T, the restarts\n\
+              abandoned may depend on the order in which they\n\
+              complete.  By default, no restart is abandoned.\n\
 \n\
     -o <pref> Use the specified prefix for all output files (dflt. \"phastm\").\n\
     -H        Produce HTML formatted output, in addition to ordinary output.\n\
@@ -121,7 +139,7 @@ OPTIONS:\n\
     -x        (For use with -H or -D) Suppress ordinary output to stdout.\n\
 \n\
     -h        Print this help message.\n\n", prog, prog, DEFAULT_SIZE, 
-         DEFAULT_NUMBER);
+         DEFAULT_NUMBER, MTF_ABANDON_MIN_ITER);
   exit(0);
 }
 
@@ -133,7 +151,7 @@ int main(int argc, char *argv[]) {
     nrestarts = 10, npseudocounts = 5, nsamples = -1, 
     nmostprevalent = -1, tuple_size = -1, nbest = -1, sample_parms = 0,
     nmotifs = DEFAULT_NUMBER, nseqs = -1, do_html = 0, do_bed = 0, 
-    suppress_stdout = 0;
+    suppress_stdout = 0, nthreads = 1;
   List *msa_name_list = NULL, *pos_examples = NULL, *init_list = NULL, *tmpl;
   List *msas, *motifs;
   SeqSet *seqset = NULL;
@@ -143,11 +161,11 @@ int main(int argc, char *argv[]) {
   Hashtable *hash=NULL;
   String *output_prefix = str_new_charstr("phastm.");
   double *has_motif = NULL;
-  double prior = PRIOR;
+  double prior = PRIOR, abandon_margin = -1;
   char c;
   GFF_Set *bedfeats = NULL;
 
-  while ((c = (char)getopt(argc, argv, "t:i:b:sk:md:pn:I:R:P:w:c:SB:o:HDxh")) != -1) {
+  while ((c = (char)getopt(argc, argv, "t:i:b:sk:md:pn:I:R:P:w:c:SB:T:A:o:HDxh")) != -1) {
     switch (c) {
     case 't':
       tree = tr_new_from_file(phast_fopen(optarg, "r"));
@@ -212,6 +230,14 @@ int main(int argc, char *argv[]) {
     case 'B':
       nmotifs = get_arg_int(optarg);
       break;
+    case 'T':
+      nthreads = get_arg_int_bounds(optarg, 0, INFTY);
+      break;
+    case 'A':
+      abandon_margin = get_arg_dbl(optarg);
+      if (abandon_margin <= 0) 
+        die("ERROR: argument to -A must be positive.\n");
+      break;
     case 'o': 
       str_free(output_prefix);
       output_prefix = str_new_charstr(optarg);
@@ -364,7 +390,7 @@ int main(int argc, char *argv[]) {
                     !meme_mode, size, nmotifs, tree,
                     meme_mode ? (void*)backgd_mnmod : (void*)backgd_mod, 
                     has_motif, prior, nrestarts, init_list, sample_parms, 
-                    npseudocounts);
+                    npseudocounts, nthreads, abandon_margin);
      
   fprintf(stderr, "\n\n");
   if (do_bed)
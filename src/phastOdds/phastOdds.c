@@ -19,6 +19,7 @@
 #include <gff.h>
 #include <bed.h>
 #include <tree_likelihoods.h>
+#include <wig.h>
 #include "phastOdds.help"
 
 #define MIN_BLOCK_SIZE 30
@@ -40,8 +41,9 @@ int main(int argc, char *argv[]) {
     *winscore_pos=NULL, *winscore_neg=NULL;
   int *no_alignment=NULL;
   List *pruned_names;
-  char *msa_fname;
+  char *msa_fname, *bigwig_fname = NULL;
   FILE *infile;
+  WigWriter *wig;
 
   int opt_idx;
   struct option long_opts[] = {
@@ -57,6 +59,7 @@ int main(int argc, char *argv[]) {
     {"refidx", 1, 0, 'r'},
     {"output-bed", 0, 0, 'd'},
     {"verbose", 0, 0, 'v'},
+    {"bigwig", 1, 0, 0},
     {"help", 0, 0, 'h'},
     {0, 0, 0, 0}
   };
@@ -116,6 +119,10 @@ int main(int argc, char *argv[]) {
     case 'v':
       verbose = 1;
       break;
+    case 0:
+      if (strcmp(long_opts[opt_idx].name, "bigwig") == 0)
+        bigwig_fname = optarg;
+      break;
     case '?':
       die("Bad argument.  Try '%s -h'.\n", argv[0]);
     }
@@ -154,6 +161,9 @@ int main(int argc, char *argv[]) {
   if (base_by_base && (backgd_nmods > 1 || feat_nmods > 1))
     die("ERROR: only single phylogenetic models (not HMMs) are supported with --base-by-base.\n");
 
+  if (bigwig_fname != NULL && !windowWig && !base_by_base)
+    die("ERROR: --bigwig can only be used with --window-wig or --base-by-base.\n");
+
   if (optind != argc - 1) 
     die("ERROR: too few arguments.  Try '%s -h'.\n", argv[0]);
 
@@ -410,26 +420,25 @@ int main(int argc, char *argv[]) {
   if (winsize != -1 && windowWig == FALSE) { /* standard windows output */
     for (i = 0, j = 0; i < msa->length; i++) {
       if (no_alignment[i] == FALSE)
-        printf("%d\t%.3f\t%.3f\n", j + msa->idx_offset + 1, winscore_pos[i], 
+        printf("%" PHAST_POS_FMT "\t%.3f\t%.3f\n", j + msa->idx_offset + 1, winscore_pos[i], 
                winscore_neg[i]);
       if (ss_get_char_pos(msa, i, 0, 0) != GAP_CHAR) j++;
     }
   }
   else if (windowWig == TRUE) { /* windows with wig output */
-    int last = NEGINFTY;
+    wig = (bigwig_fname != NULL ? wig_writer_new_bigwig(bigwig_fname) :
+           wig_writer_new(stdout, 3));
     for (i = 0, j = 0; i < msa->length; i++) {
       if (refidx == 0 || msa_get_char(msa, refidx-1, i) != GAP_CHAR) {
-        if (no_alignment[i] == FALSE && winscore_pos[i] > NEGINFTY) {
-          if (j > last + 1) 
-            printf("fixedStep chrom=%s start=%d step=1\n", 
-                   refidx > 0 ? msa->names[refidx-1] : "alignment",
-                   j + msa->idx_offset + 1);
-          printf("%.3f\n", winscore_pos[i]);
-          last = j;
-        }
+        if (no_alignment[i] == FALSE && winscore_pos[i] > NEGINFTY)
+          wig_writer_add(wig, refidx > 0 ? msa->names[refidx-1] : "alignment",
+                         j + msa->idx_offset + 1, winscore_pos[i]);
         j++;
       }
     }
+    wig_writer_set_chrom_size(wig, refidx > 0 ? msa->names[refidx-1] :
+                              "alignment", j + msa->idx_offset);
+    wig_writer_free(wig);
   }
   else if (features != NULL) {  /* features output */
     /* return to coord frame of reference seq (also, replace offset) */
@@ -450,15 +459,19 @@ int main(int argc, char *argv[]) {
   }
   else {           /* base-by-base scores */
     /* in this case, we can just output the difference between the emissions */
-    printf("fixedStep chrom=%s start=%d step=1\n", 
-           refidx > 0 ? msa->names[refidx-1] : "alignment",
-           msa->idx_offset + 1);
+    wig = (bigwig_fname != NULL ? wig_writer_new_bigwig(bigwig_fname) :
+           wig_writer_new(stdout, 3));
     for (i = 0, j = 0; i < msa->length; i++) {
       if (refidx == 0 || msa_get_char(msa, refidx-1, i) != GAP_CHAR) {
-        printf("%.3f\n", feat_emissions[0][i] - backgd_emissions[0][i]);
+        wig_writer_add(wig, refidx > 0 ? msa->names[refidx-1] : "alignment",
+                       j + msa->idx_offset + 1,
+                       feat_emissions[0][i] - backgd_emissions[0][i]);
         j++;
       }
     }
+    wig_writer_set_chrom_size(wig, refidx > 0 ? msa->names[refidx-1] :
+                              "alignment", j + msa->idx_offset);
+    wig_writer_free(wig);
   }
 
   if (verbose) fprintf(stderr, "\nDone.\n");
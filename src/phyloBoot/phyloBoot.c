@@ -464,7 +464,7 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "Estimating model for replicate %d of %d...\n", i+1, nreps);
 
       if (use_em)
-        tm_fit_em(thismod, msa, params, -1, precision, -1, NULL, NULL);
+        tm_fit_em(thismod, msa, params, -1, precision, -1, TRUE, NULL, NULL);
       else
         tm_fit(thismod, msa, params, -1, precision, NULL, quiet, NULL);
 
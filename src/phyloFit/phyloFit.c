@@ -27,11 +27,12 @@
 #include <sufficient_stats.h>
 #include <maf.h>
 #include <phylo_fit.h>
+#include <profile.h>
 #include "phyloFit.help"
 
 
 int main(int argc, char *argv[]) {
-  char *msa_fname = NULL, *alph = "ACGT";
+  char *msa_fname = NULL, *feats_fname = NULL, *alph = "ACGT";
   msa_format_type input_format = UNKNOWN_FORMAT;
   char c;
   int opt_idx, seed=-1;
@@ -77,6 +78,10 @@ int main(int argc, char *argv[]) {
     {"help", 0, 0, 'h'},
     {"windows", 1, 0, 'w'},
     {"windows-explicit", 1, 0, 'v'},
+    {"warm-start", 0, 0, 0},
+    {"no-accel", 0, 0, 0},
+    {"threads", 1, 0, 0},
+    {"profile", 0, 0, 0},
     {"ancestor", 1, 0, 'A'},
     {"post-probs", 0, 0, 'P'},
     {"expected-subs", 0, 0, 'X'},
@@ -117,7 +122,7 @@ int main(int argc, char *argv[]) {
         die("ERROR: illegal substitution model.     Type \"phyloFit -h\" for usage.\n");
       break;
     case 'g':
-      pf->gff = gff_read_set(phast_fopen(optarg, "r"));
+      feats_fname = optarg;
       break;
     case 'c':
       pf->cm = cm_new_string_or_file(optarg);
@@ -294,6 +299,17 @@ int main(int argc, char *argv[]) {
 	pf->selection = get_arg_dbl(optarg);
 	pf->use_selection = TRUE;
       }
+      else if (strcmp(long_opts[opt_idx].name, "warm-start") == 0)
+	pf->window_warm_start = TRUE;
+      else if (strcmp(long_opts[opt_idx].name, "no-accel") == 0)
+	pf->no_accel = TRUE;
+      else if (strcmp(long_opts[opt_idx].name, "threads") == 0) {
+	pf->nthreads = get_arg_int(optarg);
+	if (pf->nthreads < 0)
+	  die("ERROR: argument to --threads must be non-negative.\n");
+      }
+      else if (strcmp(long_opts[opt_idx].name, "profile") == 0)
+	prof_enable();
       else {
 	die("ERROR: unknown option.  Type 'phyloFit -h' for usage.\n");
       }
@@ -329,10 +345,20 @@ int main(int argc, char *argv[]) {
   if (input_format == UNKNOWN_FORMAT)
     input_format = msa_format_for_content(infile, 1);
 
-  if (pf->nonoverlapping && (pf->use_conditionals || pf->gff != NULL || 
+  if (pf->nonoverlapping && (pf->use_conditionals || feats_fname != NULL || 
 			     pf->cats_to_do_str || input_format == SS))
     die("ERROR: cannot use --non-overlapping with --markov, --features,\n--msa-format SS, or --do-cats.\n");
 
+  /* features are only labelled in place (no grouping or reverse
+     complementation) for non-MAF input, so a compact set suffices
+     there */
+  if (feats_fname != NULL) {
+    if (input_format != MAF && pf->reverse_group_tag == NULL)
+      pf->gff_compact = gffc_read_set(phast_fopen(feats_fname, "r"));
+    else
+      pf->gff = gff_read_set(phast_fopen(feats_fname, "r"));
+  }
+
 
   /* read alignment */
   if (!pf->quiet) fprintf(stderr, "Reading alignment from %s ...\n", msa_fname);
@@ -360,5 +386,6 @@ int main(int argc, char *argv[]) {
   if (!pf->quiet) fprintf(stderr, "Done.\n");
   sfree(pf);
   
+  if (prof_enabled) prof_print(stderr);
   return 0;
 }
@@ -10,6 +10,7 @@
 #include "phylo_p.h"
 #include "phyloP.help"
 #include <misc.h>
+#include <profile.h>
 
 
 int main(int argc, char *argv[]) {
@@ -21,6 +22,7 @@ int main(int argc, char *argv[]) {
   /* other variables */
   int opt_idx, seed = -1;
   List *cats_to_do_str=NULL;
+  char *feats_fname = NULL;
   struct timeval now;
 
   struct option long_opts[] = {
@@ -46,6 +48,9 @@ int main(int argc, char *argv[]) {
     {"catmap", 1, 0, 'M'},
     {"no-prune", 0, 0, 'P'},
     {"seed", 1, 0, 'd'},
+    {"profile", 0, 0, 0},
+    {"threads", 1, 0, 0},
+    {"bigwig", 1, 0, 0},
     {"help", 0, 0, 'h'},
     {0, 0, 0, 0}
   };
@@ -106,7 +111,7 @@ int main(int argc, char *argv[]) {
       p->branch_name = get_arg_list(optarg);
       break;
     case 'f':
-      p->feats = gff_read_set(phast_fopen(optarg, "r"));
+      feats_fname = optarg;
       break;
     case 'F':
       p->fit_model = TRUE;
@@ -151,6 +156,20 @@ int main(int argc, char *argv[]) {
     case 'h':
       printf("%s", HELP);
       exit(0);
+    case 0:
+      if (strcmp(long_opts[opt_idx].name, "profile") == 0)
+        prof_enable();
+      else if (strcmp(long_opts[opt_idx].name, "threads") == 0) {
+        p->nthreads = get_arg_int(optarg);
+        if (p->nthreads < 0)
+          die("ERROR: argument to --threads must be non-negative.\n");
+      }
+      else if (strcmp(long_opts[opt_idx].name, "bigwig") == 0) {
+        p->bigwig_fname = optarg;
+        p->base_by_base = TRUE;
+        p->output_wig = TRUE;
+      }
+      break;
     case '?':
       die("Bad argument.  Try 'phyloP -h'.\n");
     }
@@ -165,6 +184,15 @@ int main(int argc, char *argv[]) {
 
   p->mod = tm_new_from_file(phast_fopen(p->mod_fname, "r"), 1);
 
+  if (feats_fname != NULL) {
+    /* labelling of MAF by category requires a GFF_Set; otherwise use
+       the more compact representation */
+    if (cats_to_do_str != NULL)
+      p->feats = gff_read_set(phast_fopen(feats_fname, "r"));
+    else
+      p->feats_compact = gffc_read_set(phast_fopen(feats_fname, "r"));
+  }
+
   if (cats_to_do_str != NULL) {
     if (p->cm == NULL) die("ERROR: --cats-to-do requires --catmap option\n");
     p->cats_to_do = cm_get_category_list(p->cm, cats_to_do_str, FALSE);
@@ -178,7 +206,7 @@ int main(int argc, char *argv[]) {
     if (msa_format == MAF) 
       p->msa = maf_read_cats(msa_f, NULL, 1, NULL, 
 			     p->cats_to_do==NULL ? NULL : p->feats, p->cm, -1, 
-			     (p->feats == NULL && p->base_by_base==0) ? FALSE : TRUE, /* --features requires order */
+			     (feats_fname == NULL && p->base_by_base==0) ? FALSE : TRUE, /* --features requires order */
 			     NULL, NO_STRIP, FALSE, p->cats_to_do); 
     else 
       p->msa = msa_new_from_file_define_format(msa_f, msa_format, NULL);
@@ -197,6 +225,7 @@ int main(int argc, char *argv[]) {
   }
   
   phyloP(p);    
+  if (prof_enabled) prof_print(stderr);
   return 0;
 }
 
@@ -38,6 +38,7 @@ int main(int argc, char *argv[]) {
     {"encode", 1, 0, 'e'},
     {"keep-gaps", 0, 0, 'k'},
     {"gibbs", 1, 0, 'G'},
+    {"single-precision", 0, 0, 'f'},
     {"help", 0, 0, 'h'},
     {0, 0, 0, 0}
   };
@@ -48,9 +49,9 @@ int main(int argc, char *argv[]) {
   int suff_stats = FALSE, exclude = FALSE, keep_gaps = FALSE, do_probs = TRUE;
   List *seqlist = NULL;
   PbsCode *code = NULL;
-  int gibbs_nsamples = -1;
+  int gibbs_nsamples = -1, single_prec = FALSE;
 
-  while ((c = (char)getopt_long(argc, argv, "r:i:s:e:knxSh", long_opts, &opt_idx)) != -1) {
+  while ((c = (char)getopt_long(argc, argv, "r:i:s:e:knxSfh", long_opts, &opt_idx)) != -1) {
     switch (c) {
     case 'r':
       refseq_f = phast_fopen(optarg, "r");
@@ -81,6 +82,9 @@ int main(int argc, char *argv[]) {
     case 'G':
       gibbs_nsamples = get_arg_int_bounds(optarg, 1, INFTY);
       break;
+    case 'f':
+      single_prec = TRUE;
+      break;
     case 'h':
       printf("%s", HELP);
       exit(0);
@@ -147,7 +151,7 @@ int main(int argc, char *argv[]) {
 
   mod->tree_posteriors = tl_new_tree_posteriors(mod, msa, TRUE, FALSE, 
                                                 FALSE, FALSE, FALSE, FALSE,
-						FALSE);
+						FALSE, single_prec);
 
   fprintf(stderr, "Computing posterior probabilities...\n");
 
@@ -187,12 +191,12 @@ int main(int argc, char *argv[]) {
       }
 
       for (i = 0; i < msa->ss->ntuples; i++) {
-        if (mod->tree_posteriors->base_probs[0][0][node][i] == -1)
+        if (TP_BASE_PROB(mod->tree_posteriors, 0, 0, node, i) == -1)
           continue;		/* no base this node */
         fprintf(out_f, "%.0f\t", msa->ss->counts[i]);
         for (j = 0; j < mod->rate_matrix->size; j++) {
           fprintf(out_f, "%f%c", 
-                  mod->tree_posteriors->base_probs[0][j][node][i], 
+                  TP_BASE_PROB(mod->tree_posteriors, 0, j, node, i), 
                   j == mod->rate_matrix->size - 1 ? '\n' : '\t');
         }
       }
@@ -209,7 +213,7 @@ int main(int argc, char *argv[]) {
                 j == mod->rate_matrix->size - 1 ? '\n' : '\t');
 
       for (i = 0; i < msa->length; i++) {
-        if (mod->tree_posteriors->base_probs[0][0][node][msa->ss->tuple_idx[i]] == -1) {
+        if (TP_BASE_PROB(mod->tree_posteriors, 0, 0, node, msa->ss->tuple_idx[i]) == -1) {
           /* no base */
           if (keep_gaps) fprintf(out_f, "-\n"); 
           /* otherwise do nothing */
@@ -217,7 +221,7 @@ int main(int argc, char *argv[]) {
         else 
           for (j = 0; j < mod->rate_matrix->size; j++) 
             fprintf(out_f, "%f%c", 
-                    mod->tree_posteriors->base_probs[0][j][node][msa->ss->tuple_idx[i]], 
+                    TP_BASE_PROB(mod->tree_posteriors, 0, j, node, msa->ss->tuple_idx[i]), 
                     j == mod->rate_matrix->size - 1 ? '\n' : '\t');
       }
 
@@ -230,7 +234,7 @@ int main(int argc, char *argv[]) {
       int len = 0;
 
       for (i = 0; i < msa->length; i++) {
-        if (mod->tree_posteriors->base_probs[0][0][node][msa->ss->tuple_idx[i]] == -1) {
+        if (TP_BASE_PROB(mod->tree_posteriors, 0, 0, node, msa->ss->tuple_idx[i]) == -1) {
           /* no base */
           if (keep_gaps) outseq[len++] = GAP_CHAR;
           /* otherwise do nothing */
@@ -239,8 +243,8 @@ int main(int argc, char *argv[]) {
           double maxprob = 0;
           int maxidx = -1;
           for (j = 0; j < mod->rate_matrix->size; j++) {
-            if (mod->tree_posteriors->base_probs[0][j][node][msa->ss->tuple_idx[i]] > maxprob) {
-              maxprob = mod->tree_posteriors->base_probs[0][j][node][msa->ss->tuple_idx[i]];
+            if (TP_BASE_PROB(mod->tree_posteriors, 0, j, node, msa->ss->tuple_idx[i]) > maxprob) {
+              maxprob = TP_BASE_PROB(mod->tree_posteriors, 0, j, node, msa->ss->tuple_idx[i]);
               maxidx = j;
             }
           }
@@ -268,13 +272,13 @@ int main(int argc, char *argv[]) {
       v = vec_new(mod->rate_matrix->size);
       encoded = smalloc(msa->ss->ntuples * sizeof(unsigned));
       for (i = 0; i < msa->ss->ntuples; i++) {
-        if (mod->tree_posteriors->base_probs[0][0][node][i] == -1) {
+        if (TP_BASE_PROB(mod->tree_posteriors, 0, 0, node, i) == -1) {
           encoded[i] = code->gap_code;
           ngaps += msa->ss->counts[i];
         }
         else {
           for (j = 0; j < mod->rate_matrix->size; j++) 
-            vec_set(v, j, mod->tree_posteriors->base_probs[0][j][node][i]);
+            vec_set(v, j, TP_BASE_PROB(mod->tree_posteriors, 0, j, node, i));
           encoded[i] = pbs_get_index(code, v, &error); 
           tot_error += error * msa->ss->counts[i];	 
         }
@@ -357,7 +361,7 @@ void do_indels(MSA *msa, TreeModel *mod) {
         if (n->lchild == NULL || n->rchild == NULL) 
           continue;               /* ignore leaves */
         for (j = 0; j < mod->rate_matrix->size; j++)
-          mod->tree_posteriors->base_probs[0][j][n->id][tup] = -1;
+          TP_SET_BASE_PROB(mod->tree_posteriors, 0, j, n->id, tup, -1);
 	/* mark as gap */
       }
       continue;
@@ -395,7 +399,7 @@ void do_indels(MSA *msa, TreeModel *mod) {
       if (n == mod->tree && skip_root) 
         continue;               /* skip root if condition above */
       for (j = 0; j < mod->rate_matrix->size; j++)
-        mod->tree_posteriors->base_probs[0][j][n->id][tup] = -1;
+        TP_SET_BASE_PROB(mod->tree_posteriors, 0, j, n->id, tup, -1);
       /* mark as gap */
     }
 
@@ -469,7 +473,7 @@ void do_indels(MSA *msa, TreeModel *mod) {
       if (n->lchild == NULL || n->rchild == NULL) continue;
       if (label[n->id] == GAP) 
         for (j = 0; j < mod->rate_matrix->size; j++)
-          mod->tree_posteriors->base_probs[0][j][n->id][tup] = -1;
+          TP_SET_BASE_PROB(mod->tree_posteriors, 0, j, n->id, tup, -1);
     }
   }
 
@@ -699,7 +699,7 @@ void write_log(FILE *logf, GFF_FeatureGroup *group, status_type status,
       die("ERROR in write_log: unknown problem->status %i\n", problem->status);
     }
 
-    fprintf(logf, "%s (%d-%d):\n", reason,
+    fprintf(logf, "%s (%" PHAST_POS_FMT "-%" PHAST_POS_FMT "):\n", reason,
             msa_map_msa_to_seq(map, problem->feat->start), 
             msa_map_msa_to_seq(map, problem->feat->end));
 
@@ -774,7 +774,7 @@ void write_machine_problem(FILE *mlogf, GFF_FeatureGroup *group,
     start = group->start;
     end = group->end;
   }
-  fprintf(mlogf, "%s\t%s\t%d\t%d\t%s\t%d\t%d\n",
+  fprintf(mlogf, "%s\t%s\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\t%s\t%" PHAST_POS_FMT "\t%" PHAST_POS_FMT "\n",
           group->name->chars, featName,
           msa_map_msa_to_seq(map, start)-1, 
           msa_map_msa_to_seq(map, end),
@@ -1132,14 +1132,14 @@ int main(int argc, char *argv[]) {
     int newstart, newend;
  
     if (f->start < 0 || f->end < f->start)
-      die("ERROR: bad feature in GFF (start=%d, end=%d).\n",
+      die("ERROR: bad feature in GFF (start=%" PHAST_POS_FMT ", end=%" PHAST_POS_FMT ").\n",
           f->start, f->end);
 
     newstart = msa_map_seq_to_msa(map, f->start);
     newend = msa_map_seq_to_msa(map, f->end);
 
     if (newstart < 0 || newend < newstart)
-      die("ERROR: unable to map coordinates for feature (start=%d, end=%d).\n",
+      die("ERROR: unable to map coordinates for feature (start=%" PHAST_POS_FMT ", end=%" PHAST_POS_FMT ").\n",
           f->start, f->end);
 
     f->start = newstart;
@@ -1223,7 +1223,7 @@ int main(int argc, char *argv[]) {
           feat = lst_get_ptr(gfeatures, j);
 
           if (feat->end - 1 >= msa->length) 
-            die("ERROR: feature extends beyond alignment (%d >= %d).\n",
+            die("ERROR: feature extends beyond alignment (%" PHAST_POS_FMT " >= %" PHAST_POS_FMT ").\n",
                 feat->end - 1, msa->length);
         
           if (check_start && str_equals_charstr(feat->feature, GFF_START_TYPE)) {
@@ -159,7 +159,7 @@ void dump(char *prefix, GFF_Feature *real, GFF_Feature *pred, pred_type t,
 
   /* also write per-prediction summary, with scores */
   if (t != ME) 
-    fprintf(SUMF, "%-12s %12d %12d %12.3f %10s %10.4f\n", pred->feature->chars, 
+    fprintf(SUMF, "%-12s %12" PHAST_POS_FMT " %12" PHAST_POS_FMT " %12.3f %10s %10.4f\n", pred->feature->chars, 
             pred->start, pred->end, pred->score_is_null ? -1 : pred->score, 
             type, pct_correct);
 }
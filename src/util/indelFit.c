@@ -154,7 +154,7 @@ int main(int argc, char *argv[]) {
 int *get_cats(IndelHistory *ih, GFF_Set *feats, CategoryMap *cm,
               char *reference) {
   int *retval;
-  int i;
+  int i, r;
   TreeNode *node;
   char *seq = smalloc(ih->ncols * sizeof(char));
   MSA *dummy_msa;
@@ -165,9 +165,12 @@ int *get_cats(IndelHistory *ih, GFF_Set *feats, CategoryMap *cm,
       die("ERROR: node '%s' not found in tree.\n", reference);
 
     /* make a dummy MSA based on the indel history */  
-    for (i = 0; i < ih->ncols; i++) {
-      if (ih->indel_strings[node->id][i] == BASE) seq[i] = 'A';
-      else seq[i] = GAP_CHAR;
+    for (r = 0; r < ih->nruns; r++) {
+      char c = ih->patterns[ih->run_pattern[r]][node->id] == BASE ? 
+        'A' : GAP_CHAR;
+      for (i = ih->run_start[r]; i < ih->run_start[r] + ih_run_len(ih, r); 
+           i++)
+        seq[i] = c;
     }
     dummy_msa = msa_new(&seq, NULL, 1, ih->ncols, NULL);
 
@@ -265,14 +265,15 @@ void close_outfiles(List *outfileList, Hashtable *outfileHash) {
 int main(int argc, char* argv[]) {
   char *maf_fname = NULL, *out_root_fname = "maf_parse", *masked_fn = NULL;
   String *refseq = NULL, *currRefseq;
-  int opt_idx, startcol = 1, endcol = -1, include = 1, splitInterval = -1;
+  int opt_idx, include = 1, splitInterval = -1;
+  phast_pos startcol = 1, endcol = -1;
   char c, outfilename[1000], splitFormat[100]="%s%.1i.maf", *group_tag = NULL;
   List *order_list = NULL, *seqlist_str = NULL, *cats_to_do_str=NULL, *cats_to_do=NULL;
   MafBlock *block;
   FILE *mfile, *outfile=NULL, *masked_file=NULL;
   int useRefseq=TRUE, currLen=-1, blockIdx=0, currSize, sortWarned=0;
-  int lastIdx = 0, currStart=0, by_category = FALSE, i, pretty_print = FALSE;
-  int lastStart = -1, gffSearchIdx=0;
+  int by_category = FALSE, i, pretty_print = FALSE, gffSearchIdx=0;
+  phast_pos lastIdx = 0, currStart = 0, lastStart = -1;
   GFF_Set *gff = NULL, *gffSub;
   GFF_Feature *feat;
   CategoryMap *cm = NULL;
@@ -313,10 +314,10 @@ int main(int argc, char* argv[]) {
   while ((c = (char)getopt_long(argc, argv, "s:e:l:O:r:S:d:g:c:P:b:o:m:M:pLnxEIh", long_opts, &opt_idx)) != -1) {
     switch(c) {
     case 's':
-      startcol = get_arg_int(optarg);
+      startcol = get_arg_pos(optarg);
       break;
     case 'e':
-      endcol = get_arg_int(optarg);
+      endcol = get_arg_pos(optarg);
       break;
     case 'l':
       seqlist_str = get_arg_list(optarg);
@@ -490,7 +491,7 @@ int main(int argc, char* argv[]) {
     if (useRefseq) {
       currStart = mafBlock_get_start(block, refseq);
       if (currStart < lastIdx && sortWarned == 0) {
-	fprintf(stderr, "Warning: input MAF not sorted with respect to refseq.  Output files may not represent contiguous alignments. (%i, %i)\n", lastIdx, currStart);
+	fprintf(stderr, "Warning: input MAF not sorted with respect to refseq.  Output files may not represent contiguous alignments. (%" PHAST_POS_FMT ", %" PHAST_POS_FMT ")\n", lastIdx, currStart);
 	sortWarned = 1;
       }
     }
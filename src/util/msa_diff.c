@@ -116,7 +116,7 @@ int main(int argc, char *argv[]) {
 
   len = min(msa1->length, msa2->length);
   if (msa1->length != msa2->length) 
-    printf("Lengths differ (msa1: %d, msa2: %d); comparing common part only\n",
+    printf("Lengths differ (msa1: %" PHAST_POS_FMT ", msa2: %" PHAST_POS_FMT "); comparing common part only\n",
            msa1->length, msa2->length);
 
   ndiffs = 0;
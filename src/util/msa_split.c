@@ -622,7 +622,7 @@ int main(int argc, char* argv[]) {
     }
   }
   if (msa->length <= 0) 
-    die("ERROR: msa->length is %i\n", msa->length);
+    die("ERROR: msa->length is %" PHAST_POS_FMT "\n", msa->length);
 
   if (gff != NULL) {
     if (!quiet_mode)
@@ -404,7 +404,8 @@ int main(int argc, char* argv[]) {
   List *seqlist_str = NULL, *l = NULL, *tmpl = NULL;
   char *infname = NULL, *clean_seqname = NULL, *rseq_fname = NULL,
     *reverse_groups_tag = NULL, *alphabet = NULL;
-  int i, opt_idx, startcol = 1, endcol = -1, include = 1, gap_strip_mode = NO_STRIP,
+  phast_pos startcol = 1, endcol = -1;
+  int i, opt_idx, include = 1, gap_strip_mode = NO_STRIP,
     pretty_print = FALSE, refseq = 0, tuple_size = 1, 
     ordered_stats = TRUE, indel_clean_nseqs = -1, cats_done = FALSE,
     rand_perm = FALSE, reverse_compl = FALSE, stats_only = FALSE, win_size = -1, 
@@ -468,10 +469,10 @@ int main(int argc, char* argv[]) {
       if (input_format == UNKNOWN_FORMAT) die("ERROR: bad input format.  Try 'msa_view -h' for help.\n");
       break;
     case 's':
-      startcol = get_arg_int(optarg);
+      startcol = get_arg_pos(optarg);
       break;
     case 'e':
-      endcol = get_arg_int(optarg);
+      endcol = get_arg_pos(optarg);
       break;
     case 'l':
       seqlist_str = get_arg_list(optarg);
@@ -0,0 +1,132 @@
+#!/usr/bin/perl -w
+use Compress::Zlib;
+
+# script to check bigWig output against the fixedStep wig text of the
+# same scores (used by test_phast.sh).  Reads the chromosome index and
+# the data sections of a bigWig file written by PHAST (fixedStep
+# sections, in native byte order) and compares them with the wig
+# file.  Values must agree up to the three decimal places of the wig
+# text.  Chromosome sizes given as chrom=size arguments are checked
+# too.  Differences are reported on stdout as "ERROR: ..." lines, and
+# the exit status is the number of differences (at most 255).
+#
+# usage: perl bigwig_cmp.pl file.bw file.wig [chrom=size ...]
+
+if (scalar(@ARGV) < 2) {
+    die "usage: perl bigwig_cmp.pl file.bw file.wig [chrom=size ...]";
+}
+my $bwFile = shift @ARGV;
+my $wigFile = shift @ARGV;
+my $numerror = 0;
+
+sub report {
+    print "ERROR: $_[0]\n";
+    $numerror++;
+}
+
+open(BW, $bwFile) or die "error opening $bwFile";
+binmode(BW);
+my $bw = do { local $/; <BW> };
+close(BW);
+
+my ($magic, $version, $nzoom, $chromTree, $data, $index, $fieldCount,
+    $definedCount, $autoSql, $summary, $uncompressBuf) =
+    unpack("L S S Q Q Q S S Q Q L", $bw);
+die "$bwFile is not a bigWig file" if ($magic != 0x888FFC26);
+
+# chromosome B+ tree: names and sizes by id
+my ($treeMagic, $blockSize, $keySize) = unpack("L L L", substr($bw, $chromTree, 12));
+die "bad chromosome tree in $bwFile" if ($treeMagic != 0x78CA8C91);
+my (@chromName, @chromSize);
+sub read_chrom_node {
+    my $offset = $_[0];
+    my ($isLeaf, $reserved, $count) = unpack("C C S", substr($bw, $offset, 4));
+    $offset += 4;
+    for (my $i = 0; $i < $count; $i++) {
+	my $key = unpack("Z*", substr($bw, $offset, $keySize));
+	if ($isLeaf) {
+	    my ($id, $size) = unpack("L L", substr($bw, $offset + $keySize, 8));
+	    $chromName[$id] = $key;
+	    $chromSize[$id] = $size;
+	} else {
+	    read_chrom_node(unpack("Q", substr($bw, $offset + $keySize, 8)));
+	}
+	$offset += $keySize + 8;
+    }
+}
+read_chrom_node($chromTree + 32);
+
+# R-tree index of data sections; values are stored by "chrom:pos"
+# (pos 0-based)
+my %bwVals;
+sub read_section {
+    my ($offset, $size) = @_;
+    my $block = substr($bw, $offset, $size);
+    if ($uncompressBuf > 0) {
+	$block = uncompress($block);
+	die "bad compressed section in $bwFile" if (!defined($block));
+    }
+    my ($id, $start, $end, $step, $span, $type, $reserved, $count) =
+	unpack("L L L L L C C S", $block);
+    die "unexpected section type $type in $bwFile" if ($type != 3);
+    my @vals = unpack("f$count", substr($block, 24, 4 * $count));
+    for (my $i = 0; $i < $count; $i++) {
+	$bwVals{"$chromName[$id]:" . ($start + $i * $step)} = $vals[$i];
+    }
+}
+sub read_index_node {
+    my $offset = $_[0];
+    my ($isLeaf, $reserved, $count) = unpack("C C S", substr($bw, $offset, 4));
+    $offset += 4;
+    for (my $i = 0; $i < $count; $i++) {
+	if ($isLeaf) {
+	    my @item = unpack("L L L L Q Q", substr($bw, $offset, 32));
+	    read_section($item[4], $item[5]);
+	    $offset += 32;
+	} else {
+	    my @item = unpack("L L L L Q", substr($bw, $offset, 24));
+	    read_index_node($item[4]);
+	    $offset += 24;
+	}
+    }
+}
+die "bad index in $bwFile" if (unpack("L", substr($bw, $index, 4)) != 0x2468ACE0);
+read_index_node($index + 48);
+
+# compare with wig text
+open(WIG, $wigFile) or die "error opening $wigFile";
+my ($chrom, $pos, $nwig) = ("", 0, 0);
+while (<WIG>) {
+    chomp;
+    if (/^fixedStep/) {
+	($chrom) = /chrom=(\S+)/;
+	($pos) = /start=(\d+)/;
+	$pos--;
+	next;
+    }
+    my $key = "$chrom:$pos";
+    if (!exists($bwVals{$key})) {
+	report("$key missing from $bwFile");
+    } elsif (abs($bwVals{$key} - $_) > 0.0005 + 1e-6) {
+	report("$key is $bwVals{$key} in $bwFile but $_ in $wigFile");
+    }
+    $pos++;
+    $nwig++;
+}
+close(WIG);
+if (scalar(keys %bwVals) != $nwig) {
+    report(scalar(keys %bwVals) . " values in $bwFile but $nwig in $wigFile");
+}
+
+foreach my $arg (@ARGV) {
+    my ($name, $size) = split('=', $arg);
+    my $found = 0;
+    for (my $i = 0; $i < scalar(@chromName); $i++) {
+	next if ($chromName[$i] ne $name);
+	$found = 1;
+	report("size of $name is $chromSize[$i] in $bwFile, expected $size")
+	    if ($chromSize[$i] != $size);
+    }
+    report("$name missing from $bwFile") if (!$found);
+}
+exit($numerror > 255 ? 255 : $numerror);
@@ -0,0 +1,94 @@
+#!/usr/bin/perl -w
+
+# script to check phastCons --em-stats/--em-merge against a single run
+# on the whole alignment (used by test_phast.sh).  Runs the iteration
+# of example 7 of the phastCons help page on the given chunks until the
+# likelihood improves by less than 0.07, writing emIter.cons.mod,
+# emIter.noncons.mod and emIter.lnl, then runs phastCons --no-accel on
+# the whole alignment (emSingle.*).  The likelihoods must agree within
+# 0.5, the transition rates and the branch lengths of both trees within
+# 5% and 1%.  The phastCons in the PATH is used, and the --em-stats
+# files are named after the chunks (chunk1.ss -> chunk1.stats).
+# Differences are reported on stdout as "ERROR: ..." lines, and the
+# exit status is the number of differences.
+#
+# usage: perl em_merge_check.pl --estimate-trees|--estimate-rho init.mod
+#            whole.ss chunk.ss ...
+
+if (scalar(@ARGV) < 4 || $ARGV[0] !~ /^--estimate-(trees|rho)$/) {
+    die "usage: perl em_merge_check.pl --estimate-trees|--estimate-rho init.mod whole.ss chunk.ss ...";
+}
+my $estimate = shift @ARGV;
+my $initMod = shift @ARGV;
+my $wholeSS = shift @ARGV;
+my @chunks = @ARGV;
+my $numerror = 0;
+
+sub report {
+    print "ERROR: --em-merge $estimate $_[0]\n";
+    $numerror++;
+}
+
+sub run {
+    system("$_[0] 2>/dev/null") == 0 or die "error running '$_[0]'";
+}
+
+# values of a --lnl file, e.g. "lnL = -123.4 (mu = 0.01, nu = 0.01,
+# rho = 0.3)", by name
+sub read_lnl {
+    open(LNL, $_[0]) or die "error opening $_[0]";
+    my $line = join(" ", <LNL>);
+    close(LNL);
+    my %vals = ($line =~ /(\w+)\s*=\s*([-+\d.eE]+)/g);
+    die "no likelihood in $_[0]" if (!exists($vals{lnL}));
+    return %vals;
+}
+
+# branch lengths of the tree in a .mod file
+sub read_branchlens {
+    open(MOD, $_[0]) or die "error opening $_[0]";
+    my @bl;
+    while (<MOD>) {
+	push(@bl, /:([-+\d.eE]+)/g) if (/^TREE:/);
+    }
+    close(MOD);
+    return @bl;
+}
+
+my ($mu, $nu, $rho, $mods, $prev) = (0.01, 0.01, 0.3, $initMod, -1e300);
+my @stats = map { my $s = $_; $s =~ s/\.ss$//; "$s.stats" } @chunks;
+my %iter;
+for (my $it = 0; $it < 100; $it++) {
+    for (my $i = 0; $i < scalar(@chunks); $i++) {
+	run("phastCons --transitions $mu,$nu --rho $rho --em-stats $stats[$i] --no-post-probs $chunks[$i] $mods");
+    }
+    run("phastCons --em-merge " . join(",", @stats) . " $estimate emIter --rho $rho --lnl emIter.lnl $mods");
+    %iter = read_lnl("emIter.lnl");
+    ($mu, $nu, $rho) = ($iter{mu}, $iter{nu}, $iter{rho});
+    $mods = "emIter.cons.mod,emIter.noncons.mod";
+    last if ($iter{lnL} - $prev < 0.07);
+    $prev = $iter{lnL};
+}
+
+run("phastCons --no-accel $estimate emSingle --transitions ~0.01,0.01 --rho 0.3 --no-post-probs --lnl emSingle.lnl $wholeSS $initMod");
+my %single = read_lnl("emSingle.lnl");
+
+report("likelihood is $iter{lnL}, $single{lnL} in single run")
+    if (abs($iter{lnL} - $single{lnL}) > 0.5);
+foreach my $par ("mu", "nu") {
+    report("$par is $iter{$par}, $single{$par} in single run")
+	if (abs($iter{$par} / $single{$par} - 1) > 0.05);
+}
+foreach my $tree ("cons", "noncons") {
+    my @blIter = read_branchlens("emIter.$tree.mod");
+    my @blSingle = read_branchlens("emSingle.$tree.mod");
+    if (scalar(@blIter) != scalar(@blSingle)) {
+	report("$tree tree has a different number of branches than in single run");
+	next;
+    }
+    for (my $i = 0; $i < scalar(@blIter); $i++) {
+	report("$tree branch length $i is $blIter[$i], $blSingle[$i] in single run")
+	    if (abs($blIter[$i] / $blSingle[$i] - 1) > 0.01);
+    }
+}
+exit($numerror > 255 ? 255 : $numerror);
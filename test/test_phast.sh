@@ -71,6 +71,29 @@ tree_doctor --name-ancestors phyloFit.mod > phyloFit-named.mod
 @phyloP  --seed 123 --method SPH --subtree mouse-rat --mode CONACC --base-by-base phyloFit-named.mod hmrc.ss
 @phyloP  --seed 123 --method SPH --subtree mouse-rat --mode CONACC --features temp.bed phyloFit-named.mod hmrc.ss
 
+# features of the chr22 alignment, fitted in parallel (output must not
+# depend on the number of threads)
+msa_view chr22.14500000-15500000.maf --refseq chr22.14500000-15500000.fa -o SS > temp_chr22.ss
+phyloFit --subst-mod F81 --tree "(((hg17,(mm5,rn3)),galGal2),fr1)" -o temp_chr22 --quiet temp_chr22.ss
+tree_doctor --name-ancestors temp_chr22.mod > temp_chr22-named.mod
+refeature chr22.14500000-15500000.gp | awk -v OFS="\t" '$5 >= $4 {start=$4-14500000; end=$5-14500000; print "hg17."$1,$2,$3,start,end,$6,$7,$8,$9}' > temp_chr22.gff
+@phyloP --method LRT --mode CONACC --features temp_chr22.gff --threads 4 temp_chr22.mod chr22.14500000-15500000.maf
+@phyloP --method SCORE --features temp_chr22.gff -g --threads 4 temp_chr22.mod chr22.14500000-15500000.maf
+@phyloP --method GERP --features temp_chr22.gff --threads 4 temp_chr22.mod chr22.14500000-15500000.maf
+@phyloP --method LRT --subtree mm5-rn3 --features temp_chr22.gff --threads 4 temp_chr22-named.mod chr22.14500000-15500000.maf
+@phyloP --method SPH --features temp_chr22.gff --threads 4 temp_chr22.mod chr22.14500000-15500000.maf
+phyloP --method LRT --mode CONACC --features temp_chr22.gff --threads 1 temp_chr22.mod chr22.14500000-15500000.maf > temp_threads1.out 2> /dev/null
+phyloP --method LRT --mode CONACC --features temp_chr22.gff --threads 4 temp_chr22.mod chr22.14500000-15500000.maf > temp_threads4.out 2> /dev/null
+cmp -s temp_threads1.out temp_threads4.out || echo "ERROR: phyloP --features output differs with --threads 4"
+rm -f temp_threads1.out temp_threads4.out temp_chr22-named.mod temp_chr22.gff
+
+# --bigwig must hold the same scores as --wig-scores, and the size of the
+# whole reference sequence (the alignment ends with bases without scores)
+phyloP --wig-scores temp_chr22.mod temp_chr22.ss > temp_chr22.wig
+phyloP --wig-scores --bigwig temp_chr22.bw temp_chr22.mod temp_chr22.ss
+perl bigwig_cmp.pl temp_chr22.bw temp_chr22.wig temp_chr22=1000001 || echo "ERROR: --bigwig output differs from --wig-scores"
+rm -f temp_chr22.ss temp_chr22.mod temp_chr22.wig temp_chr22.bw
+
 rm -f hmrc_short.ss phyloFit.mod phyloFit-named.mod temp.bed
 
 
@@ -124,6 +147,23 @@ phyloFit --quiet --tree "((hg16, panTro1), (mm3, rn3))" -o hpmr-ratevar --alpha
 #--log.  But don't compare the log files because they include runtime information.
 !tempTree.cons.mod !tempTree.noncons.mod  @phastCons --estimate-trees tempTree --log log.txt hpmrc_short.ss hpmr.mod
 rm -f log.txt
+#--no-accel (plain EM, without SQUAREM extrapolation)
+@phastCons --no-accel --target-coverage 0.25 --expected-length 12 hpmrc.ss hpmr.mod
+!tempRho.cons.mod !tempRho.noncons.mod @phastCons --no-accel --estimate-rho tempRho --no-post-probs hpmrc.ss hpmr.mod
+!tempTree.cons.mod !tempTree.noncons.mod @phastCons --no-accel --estimate-trees tempTree --no-post-probs hpmrc_short.ss hpmr.mod
+#--em-stats and --em-merge: EM distributed over three chunks of hpmrc.ss
+msa_view --end 7000 -o SS hpmrc.ss > chunk1.ss
+msa_view --start 7001 --end 14000 -o SS hpmrc.ss > chunk2.ss
+msa_view --start 14001 -o SS hpmrc.ss > chunk3.ss
+!chunk1.stats @phastCons --transitions 0.01,0.01 --rho 0.3 --em-stats chunk1.stats --no-post-probs chunk1.ss hpmr.mod
+for c in 1 2 3; do phastCons --transitions 0.01,0.01 --rho 0.3 --em-stats chunk$c.stats --no-post-probs chunk$c.ss hpmr.mod 2>/dev/null; done
+!emIter.cons.mod !emIter.noncons.mod !emIter.lnl @phastCons --em-merge chunk1.stats,chunk2.stats,chunk3.stats --estimate-trees emIter --rho 0.3 --lnl emIter.lnl hpmr.mod
+!emIter.cons.mod !emIter.noncons.mod !emIter.lnl @phastCons --em-merge chunk1.stats,chunk2.stats,chunk3.stats --estimate-rho emIter --rho 0.3 --lnl emIter.lnl hpmr.mod
+# iterate to convergence as in example 7 of the help page; estimates
+# should agree with a single run on the whole alignment
+perl em_merge_check.pl --estimate-trees hpmr.mod hpmrc.ss chunk1.ss chunk2.ss chunk3.ss || echo "ERROR: --em-merge --estimate-trees estimates differ from single run"
+perl em_merge_check.pl --estimate-rho hpmr.mod hpmrc.ss chunk1.ss chunk2.ss chunk3.ss || echo "ERROR: --em-merge --estimate-rho estimates differ from single run"
+rm -f chunk1.* chunk2.* chunk3.* emIter.* emSingle.*
 #--refidx
 @phastCons --refidx 0 hpmrc_short.ss hpmr.mod
 @phastCons --refidx 2 hpmrc_short.ss hpmr.mod
@@ -211,6 +251,8 @@ seed=124
 !phyloFit.mod @phyloFit hmrc.ss -D 12345 --subst-mod REV --EM --tree "(human, (mouse,rat))"
 !phyloFit.mod @phyloFit -D 12345 hpmrc.fa --EM --tree "(((hg16,panTro2),(rn3,mm3)),galGal2)"
 !phyloFit.mod @phyloFit -D 12345 hpmrc.fa --EM --nrates 3 --tree "(((hg16,panTro2),(rn3,mm3)),galGal2)"
+!phyloFit.mod @phyloFit hmrc.ss --EM --no-accel --subst-mod F81 --tree "(human, (mouse,rat), cow)"
+!phyloFit.mod @phyloFit hmrc.ss --EM --no-accel --subst-mod JC69 --tree "(human, (mouse,rat), cow)" -k 4
 
 # test some of the higher order models (they are slow so use small simulated data set)
 base_evolve --nsites 100 rev.mod > simulated.fa
@@ -269,6 +311,10 @@ tree_doctor --name-ancestors rev-em.mod --scale 2.0 > rev-em-scaled-named.mod
 !phyloFit.mod @phyloFit hmrc.ss --init-mod rev-em.mod --nrates 4 --alpha 5.2
 #--rate-constants
 !phyloFit.mod @phyloFit hmrc.ss --init-mod rev-em.mod --nrates 4 --rate-constants 10.0,6.0,1.0,0.1
+phyloFit hmrc.ss --init-mod rev-em.mod --nrates 4 --rate-constants 10.0,6.0,1.0,0.1 -o temp_accel 2>/dev/null
+phyloFit hmrc.ss --init-mod rev-em.mod --nrates 4 --rate-constants 10.0,6.0,1.0,0.1 --no-accel -o temp_noaccel 2>/dev/null
+cat temp_accel.mod temp_noaccel.mod | awk '$1 == "TRAINING_LNL:" {l[n++] = $2} END {exit (n != 2 || l[0] < l[1])}' || echo "ERROR: --rate-constants likelihood is lower than with --no-accel"
+rm -f temp_accel.mod temp_noaccel.mod
 
 #--features
 !phyloFit.bed_feature.mod !phyloFit.background.mod @phyloFit hpmrc.ss -D 12345 --tree "(((hg16,panTro2),(rn3,mm3)),galGal2)" --features elements_correct.bed
@@ -304,6 +350,20 @@ tree_doctor --name-ancestors rev-em.mod --scale 2.0 > rev-em-scaled-named.mod
 echo -e "1\t20\n25\t45" > windows.txt
 !phyloFit.win-1.mod !phyloFit.win-2.mod @phyloFit  --tree "((human,(mouse,rat)mouse-rat),cow)" --windows-explicit '*windows.txt' simulated.fa --min-informative 15 -D 12345
 rm -f windows.txt
+# overlapping windows, out of order (the window statistics must be
+# moved backwards as well as forwards)
+!phyloFit.win-1.mod !phyloFit.win-2.mod !phyloFit.win-3.mod @phyloFit --tree "((hg16,panTro1),(mm3,rn3),galGal2)" --subst-mod F81 --windows-explicit 3001,6000,1,4000,2001,3000 hpmrc.fa --min-informative 15
+#--warm-start
+!phyloFit.win-1.mod !phyloFit.win-2.mod !phyloFit.win-3.mod @phyloFit --tree "((hg16,panTro1),(mm3,rn3),galGal2)" --subst-mod F81 --windows-explicit 1,4000,2001,6000,4001,8000 hpmrc.fa --min-informative 15 --warm-start
+#--threads (output must not depend on the number of threads)
+!phyloFit.win-1.mod !phyloFit.win-2.mod !phyloFit.win-3.mod @phyloFit --tree "((hg16,panTro1),(mm3,rn3),galGal2)" --subst-mod F81 --windows-explicit 3001,6000,1,4000,2001,3000 hpmrc.fa --min-informative 15 --threads 4
+phyloFit --tree "((hg16,panTro1),(mm3,rn3),galGal2)" --subst-mod F81 --windows 1000,500 hpmrc.fa --min-informative 15 --quiet --threads 1 -o threads1
+phyloFit --tree "((hg16,panTro1),(mm3,rn3),galGal2)" --subst-mod F81 --windows 1000,500 hpmrc.fa --min-informative 15 --quiet --threads 4 -o threads4
+for f in threads1.win-*; do cmp -s $f threads4${f#threads1} || echo "ERROR: $f differs with --threads 4"; done
+phyloFit --tree "((hg16,panTro1),(mm3,rn3),galGal2)" --subst-mod F81 --windows 1000,500 hpmrc.fa --min-informative 15 --quiet --warm-start --threads 1 -o threads1
+phyloFit --tree "((hg16,panTro1),(mm3,rn3),galGal2)" --subst-mod F81 --windows 1000,500 hpmrc.fa --min-informative 15 --quiet --warm-start --threads 4 -o threads4
+for f in threads1.win-*; do cmp -s $f threads4${f#threads1} || echo "ERROR: $f differs with --warm-start --threads 4"; done
+rm -f threads1.win-* threads4.win-*
 
 
 rm -f phyloFit.mod phyloFit.postprob hmr.ss hm.ss rev-em-scaled-named.mod simulated.fa
@@ -362,7 +422,23 @@ refeature chr22.14500000-15500000.gp | awk -v OFS="\t" '{start=$4-14500000; end=
 @msa_view -o SS --features temp.gff chr22.14500000-15500000.maf
 @msa_view -o SS --features temp.gff --4d chr22.14500000-15500000.maf
 
-rm -f hmrc.fa hmrc.ph hmrc.mpm hmrc_short_a.ss temp.gff
+# features labelled and scored through the compact feature store
+msa_view -o FASTA chr22.14500000-15500000.maf > chr22_aln.fa
+!phyloFit.background.mod !phyloFit.exon.mod !phyloFit.CDS.mod @phyloFit --subst-mod F81 --tree "(((hg17,(mm5,rn3)),galGal2),fr1)" --features temp.gff chr22_aln.fa
+!phyloFit.background.mod !phyloFit.CDS-1.mod !phyloFit.CDS-2.mod !phyloFit.CDS-3.mod @phyloFit --subst-mod F81 --tree "(((hg17,(mm5,rn3)),galGal2),fr1)" --features temp.gff --catmap "NCATS = 3; CDS 1-3" chr22_aln.fa
+phyloFit --subst-mod F81 --tree "(((hg17,(mm5,rn3)),galGal2),fr1)" -o chr22 --quiet chr22.14500000-15500000.maf
+# each category starts from the --init-model, whatever the number of threads
+# (progress messages on stderr come in the order the fits run)
+!phyloFit.CDS-1.mod !phyloFit.CDS-2.mod !phyloFit.CDS-3.mod -stderr @phyloFit --init-model chr22.mod --features temp.gff --catmap "NCATS = 3; CDS 1-3" --do-cats 1,2,3 chr22_aln.fa --threads 4
+phyloFit --init-model chr22.mod --features temp.gff --catmap "NCATS = 3; CDS 1-3" --do-cats 1,2,3 chr22_aln.fa --quiet --threads 1 -o threads1
+phyloFit --init-model chr22.mod --features temp.gff --catmap "NCATS = 3; CDS 1-3" --do-cats 1,2,3 chr22_aln.fa --quiet --threads 4 -o threads4
+for f in threads1.CDS-*; do cmp -s $f threads4${f#threads1} || echo "ERROR: $f differs with --init-model --threads 4"; done
+rm -f threads1.CDS-* threads4.CDS-*
+awk '$5 >= $4' temp.gff > temp_nz.gff
+@phyloP --features temp_nz.gff chr22.mod chr22.14500000-15500000.maf
+@phyloP --features temp_nz.gff -g --mode CONACC chr22.mod chr22.14500000-15500000.maf
+
+rm -f hmrc.fa hmrc.ph hmrc.mpm hmrc_short_a.ss temp.gff temp_nz.gff chr22_aln.fa chr22.mod
 
 
 ******************** tree_doctor ********************
@@ -384,3 +460,20 @@ phyloFit hmrc.ss --tree "(human, (mouse,rat), cow)" --quiet
 @tree_doctor --name-ancestors --label-subtree mouse-rat+:MR phyloFit.mod
 
 rm -f phyloFit.mod tree.nh
+
+******************** phastMotif ********************
+
+# candidates trained in parallel; only the order of progress messages
+# (stderr) may depend on the number of threads
+msa_view hpmrc.fa --start 1001 --end 2000 > temp_motif1.fa
+msa_view hpmrc.fa --start 2001 --end 3000 > temp_motif2.fa
+msa_view hpmrc.fa --start 3001 --end 4000 > temp_motif3.fa
+msa_view hpmrc.fa --start 4001 --end 5000 > temp_motif4.fa
+echo '((hg16,panTro1),(mm3,rn3))' > temp_motif.nh
+-stderr @phastMotif -t temp_motif.nh -k 8 -P 10,6 -B 2 -T 4 temp_motif1.fa,temp_motif2.fa,temp_motif3.fa,temp_motif4.fa
+phastMotif -t temp_motif.nh -k 8 -P 10,6 -B 2 -T 1 temp_motif1.fa,temp_motif2.fa,temp_motif3.fa,temp_motif4.fa > temp_threads1.out 2> /dev/null
+phastMotif -t temp_motif.nh -k 8 -P 10,6 -B 2 -T 4 temp_motif1.fa,temp_motif2.fa,temp_motif3.fa,temp_motif4.fa > temp_threads4.out 2> /dev/null
+cmp -s temp_threads1.out temp_threads4.out || echo "ERROR: phastMotif output differs with -T 4"
+phastMotif -t temp_motif.nh -k 8 -P 10,6 -A 0 temp_motif1.fa > /dev/null 2>&1 && echo "ERROR: phastMotif accepted -A 0"
+
+rm -f temp_motif1.fa temp_motif2.fa temp_motif3.fa temp_motif4.fa temp_motif.nh temp_threads1.out temp_threads4.out